@@ -10,33 +10,54 @@ void Converter::convert(const IImageData& imageData, PixelImage& pixelImage) {
         extractColorMap(unrestrictedImage, pixelImage.colorMaps[i], static_cast<int>(i), pixelImage);
     }
 
-    for (int y = 0; y < pixelImage.mode.height; ++y) {
-        for (int x = 0; x < pixelImage.mode.width; ++x) {
-            if (pixelImage.pixelIndex[y][x] == -1) {
-                mapToExistingColorMap(pixelImage, x, y, peek(imageData, x, y));
-            }
-        }
-    }
+    mapToExistingColorMaps(imageData, pixelImage);
 }
 
-void Converter::mapToExistingColorMap(PixelImage& image, int x, int y, const std::vector<int>& realColor) {
-    int closestMap = 0;
-    double minDistance = std::numeric_limits<double>::max();
-
-    for (size_t i = 0; i < image.colorMaps.size(); ++i) {
-        auto paletteIndexOpt = image.colorMaps[i].get(x, y);
-        if (paletteIndexOpt.has_value()) {
-            int paletteIndex = paletteIndexOpt.value();
-            if (paletteIndex != -1) {
-                double distance = quantizer.distanceSquared(realColor, paletteIndex);
-                if (distance < minDistance) {
-                    minDistance = distance;
-                    closestMap = static_cast<int>(i);
-                }
+// The pixel peek() would return, packed as RGBA without the vector.
+static uint32_t rgbaAt(const IImageData& imageData, int x, int y) {
+    const size_t index = static_cast<size_t>(coordsToIndex(imageData, x, y));
+    if (index + 4 > imageData.data.size()) return 0;
+
+    const uint8_t* p = imageData.data.data() + index;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+void Converter::mapToExistingColorMaps(const IImageData& imageData, PixelImage& image) {
+    // Pixels no colour map claimed go to whichever map's colour at that spot
+    // is nearest, matched a batch at a time so each pixel is converted once
+    // rather than once per map.
+    const size_t maps = image.colorMaps.size();
+    uint32_t colors[QUANTIZER_BATCH];
+    int xs[QUANTIZER_BATCH];
+    int ys[QUANTIZER_BATCH];
+    int closest[QUANTIZER_BATCH];
+    std::vector<int> candidates(QUANTIZER_BATCH * maps);
+    size_t pending = 0;
+
+    auto flush = [&]() {
+        quantizer.nearestCandidate(colors, pending, candidates.data(), maps, closest);
+        for (size_t k = 0; k < pending; ++k) {
+            image.pixelIndex[ys[k]][xs[k]] = closest[k];
+        }
+        pending = 0;
+    };
+
+    for (int y = 0; y < image.mode.height; ++y) {
+        for (int x = 0; x < image.mode.width; ++x) {
+            if (image.pixelIndex[y][x] != -1) continue;
+
+            int* mine = candidates.data() + pending * maps;
+            for (size_t i = 0; i < maps; ++i) {
+                auto paletteIndexOpt = image.colorMaps[i].get(x, y);
+                mine[i] = paletteIndexOpt.has_value() ? paletteIndexOpt.value() : -1;
             }
+            colors[pending] = rgbaAt(imageData, x, y);
+            xs[pending] = x;
+            ys[pending] = y;
+            if (++pending == QUANTIZER_BATCH) flush();
         }
     }
-    image.pixelIndex[y][x] = closestMap;
+    if (pending > 0) flush();
 }
 
 int Converter::reduceToMax(const std::vector<int>& colors) {
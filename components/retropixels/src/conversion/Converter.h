@@ -13,7 +13,7 @@ class Converter {
   private:
       Quantizer quantizer;
 
-      void mapToExistingColorMap(PixelImage& image, int x, int y, const std::vector<int>& realColor);
+      void mapToExistingColorMaps(const IImageData& imageData, PixelImage& image);
       static int reduceToMax(const std::vector<int>& colors);
       static void extractColorMap(std::vector<int>& quantizedImage, ColorMap& toColorMap, int colorMapIndex, PixelImage& pixelImage);
 
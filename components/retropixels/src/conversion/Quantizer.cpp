@@ -1,11 +1,19 @@
 #include "Quantizer.h"
 
 Quantizer::Quantizer(const Palette& palette, const std::function<std::vector<double>(const std::vector<int>&)>& colorspace)
-    : colorspace(colorspace), palette(palette), cacheInitialized(false) {}
+    : colorspace(colorspace), palette(palette), cacheInitialized(false), channels(0), lookupBits(0),
+      convertPixel(4), convertColor(0), convertValid(false) {}
+
+void Quantizer::setLookupBits(int bits) {
+    if (bits < 0 || bits > 24 || bits % 3 != 0) bits = 0;
+    lookupBits = bits;
+    lookupColor.clear();
+    lookupIndex.clear();
+}
 
 void Quantizer::initializePaletteCache() const {
     if (cacheInitialized) return;
-    
+
     // Pre-convert all palette colors to the target colorspace
     paletteCache.resize(palette.colors.size());
     for (size_t i = 0; i < palette.colors.size(); ++i) {
@@ -14,14 +22,64 @@ void Quantizer::initializePaletteCache() const {
     cacheInitialized = true;
 }
 
+void Quantizer::preparePlanes() const {
+    initializePaletteCache();
+    if (batchBest.size() == QUANTIZER_BATCH && enabledIndices == palette.enabled) return;
+
+    // The enabled set changed (or this is the first image): lay it out again
+    // and forget every answer given for the old one.
+    enabledIndices = palette.enabled;
+    lookupColor.clear();
+    lookupIndex.clear();
+
+    channels = enabledIndices.empty() ? 0 : paletteCache[enabledIndices[0]].size();
+    for (int index : enabledIndices) {
+        if (paletteCache[index].size() != channels) channels = 0;
+    }
+    if (channels > QUANTIZER_MAX_CHANNELS) channels = 0;
+
+    for (size_t c = 0; c < QUANTIZER_MAX_CHANNELS; ++c) {
+        enabledPlanes[c].clear();
+        batchPlanes[c].clear();
+        if (c >= channels) continue;
+
+        for (int index : enabledIndices) {
+            enabledPlanes[c].push_back(paletteCache[index][c]);
+        }
+        batchPlanes[c].resize(QUANTIZER_BATCH);
+    }
+    batchBest.resize(QUANTIZER_BATCH);
+}
+
+size_t Quantizer::lookupSlot(uint32_t rgba) const {
+    const int bits = lookupBits / 3;
+    const uint32_t r = (rgba & 0xff) >> (8 - bits);
+    const uint32_t g = ((rgba >> 8) & 0xff) >> (8 - bits);
+    const uint32_t b = ((rgba >> 16) & 0xff) >> (8 - bits);
+    return (r << (bits * 2)) | (g << bits) | b;
+}
+
+const std::vector<double>& Quantizer::convert(uint32_t rgba) const {
+    if (convertValid && convertColor == rgba) return convertResult;
+
+    convertPixel[0] = rgba & 0xff;
+    convertPixel[1] = (rgba >> 8) & 0xff;
+    convertPixel[2] = (rgba >> 16) & 0xff;
+    convertPixel[3] = rgba >> 24;
+    convertResult = colorspace(convertPixel);
+    convertColor = rgba;
+    convertValid = true;
+    return convertResult;
+}
+
 double Quantizer::distanceSquared(const std::vector<int>& realPixel, int paletteIndex) const {
     if (!cacheInitialized) {
         initializePaletteCache();
     }
-    
+
     // Convert input pixel once
     const std::vector<double> realPixelConverted = colorspace(realPixel);
-    
+
     // Use cached converted palette color
     const std::vector<double>& palettePixelConverted = paletteCache[paletteIndex];
 
@@ -39,14 +97,24 @@ int Quantizer::quantizePixel(const std::vector<int>& pixel) const {
     if (!cacheInitialized) {
         initializePaletteCache();
     }
-    
+
+    // Convert the pixel once for the whole palette, not once per entry
+    const std::vector<double> converted = colorspace(pixel);
+
     int bestIndex = 0;
     double minDistSq = std::numeric_limits<double>::max();
 
     // Loop over enabled palette indices
     for (size_t i = 0; i < palette.enabled.size(); ++i) {
         const int index = palette.enabled[i];
-        const double distSq = distanceSquared(pixel, index);
+        const std::vector<double>& entry = paletteCache[index];
+
+        double distSq = 0.0;
+        for (size_t c = 0; c < converted.size() && c < entry.size(); ++c) {
+            const double diff = converted[c] - entry[c];
+            distSq += diff * diff;
+        }
+
         if (distSq < minDistSq) {
             minDistSq = distSq;
             bestIndex = index;
@@ -56,20 +124,138 @@ int Quantizer::quantizePixel(const std::vector<int>& pixel) const {
     return bestIndex;
 }
 
-std::vector<int> Quantizer::quantizeImage(const IImageData& image) const {
-    if (!cacheInitialized) {
-        initializePaletteCache();
+void Quantizer::searchBatch(const uint32_t* colors, size_t count, int* out) const {
+    size_t batched[QUANTIZER_BATCH];
+    size_t n = 0;
+
+    // Convert each pixel into the batch planes before searching. One whose
+    // conversion is shorter than the palette's would compare fewer channels;
+    // it takes the per-pixel path so the answer stays the same.
+    for (size_t k = 0; k < count; ++k) {
+        const std::vector<double>& converted = convert(colors[k]);
+        if (channels == 0 || converted.size() < channels) {
+            out[k] = quantizePixel(convertPixel);
+            continue;
+        }
+
+        for (size_t c = 0; c < channels; ++c) {
+            batchPlanes[c][n] = converted[c];
+        }
+        batched[n++] = k;
+    }
+
+    if (n == 0) return;
+
+    // Palette outer, pixels inner: each inner loop is the same arithmetic on
+    // contiguous doubles, and runs the channels in the order distanceSquared()
+    // sums them, so the distances (and ties) come out identical.
+    double* best = batchBest.data();
+    for (size_t k = 0; k < n; ++k) {
+        best[k] = std::numeric_limits<double>::max();
+        out[batched[k]] = 0;
+    }
+
+    for (size_t j = 0; j < enabledIndices.size(); ++j) {
+        const int index = enabledIndices[j];
+        for (size_t k = 0; k < n; ++k) {
+            double distSq = 0.0;
+            for (size_t c = 0; c < channels; ++c) {
+                const double diff = batchPlanes[c][k] - enabledPlanes[c][j];
+                distSq += diff * diff;
+            }
+            if (distSq < best[k]) {
+                best[k] = distSq;
+                out[batched[k]] = index;
+            }
+        }
+    }
+}
+
+void Quantizer::nearestCandidate(const uint32_t* colors, size_t count, const int* candidates, size_t perPixel, int* out) const {
+    initializePaletteCache();
+
+    for (size_t k = 0; k < count; ++k) {
+        const std::vector<double>& converted = convert(colors[k]);
+        const int* mine = candidates + k * perPixel;
+
+        int closest = 0;
+        double minDistSq = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < perPixel; ++i) {
+            if (mine[i] == -1) continue;
+
+            const std::vector<double>& entry = paletteCache[mine[i]];
+            double distSq = 0.0;
+            for (size_t c = 0; c < converted.size() && c < entry.size(); ++c) {
+                const double diff = converted[c] - entry[c];
+                distSq += diff * diff;
+            }
+            if (distSq < minDistSq) {
+                minDistSq = distSq;
+                closest = static_cast<int>(i);
+            }
+        }
+        out[k] = closest;
     }
-    
-    std::vector<int> result(image.width * image.height);
+}
+
+std::vector<int> Quantizer::quantizeImage(const IImageData& image) const {
+    preparePlanes();
+
     const int totalPixels = image.width * image.height;
+    std::vector<int> result(totalPixels);
+    if (totalPixels <= 0 || image.data.size() < static_cast<size_t>(totalPixels) * 4) {
+        // Not laid out as width * height RGBA; peek() knows what to do.
+        for (int y = 0; y < image.height; ++y) {
+            for (int x = 0; x < image.width; ++x) {
+                result[y * image.width + x] = quantizePixel(peek(image, x, y));
+            }
+        }
+        return result;
+    }
 
-    for (int y = 0; y < image.height; ++y) {
-        for (int x = 0; x < image.width; ++x) {
-            const int index = quantizePixel(peek(image, x, y));
-            result[y * image.width + x] = index;
+    const bool useLookup = (lookupBits > 0 && palette.colors.size() < 0xff);
+    if (useLookup && lookupIndex.empty()) {
+        lookupColor.assign(static_cast<size_t>(1) << lookupBits, 0);
+        lookupIndex.assign(static_cast<size_t>(1) << lookupBits, 0xff);
+    }
+
+    uint32_t batchColors[QUANTIZER_BATCH];
+    int batchPixels[QUANTIZER_BATCH];
+    int batchResults[QUANTIZER_BATCH];
+    size_t pending = 0;
+
+    auto flush = [&]() {
+        searchBatch(batchColors, pending, batchResults);
+        for (size_t k = 0; k < pending; ++k) {
+            result[batchPixels[k]] = batchResults[k];
+            if (useLookup) {
+                const size_t slot = lookupSlot(batchColors[k]);
+                lookupColor[slot] = batchColors[k];
+                lookupIndex[slot] = static_cast<uint8_t>(batchResults[k]);
+            }
         }
+        pending = 0;
+    };
+
+    // Straight off the RGBA buffer, no per-pixel vector from peek()
+    const uint8_t* data = image.data.data();
+    for (int i = 0; i < totalPixels; ++i) {
+        const uint8_t* p = data + static_cast<size_t>(i) * 4;
+        const uint32_t rgba = p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+
+        if (useLookup) {
+            const size_t slot = lookupSlot(rgba);
+            if (lookupIndex[slot] != 0xff && lookupColor[slot] == rgba) {
+                result[i] = lookupIndex[slot];
+                continue;
+            }
+        }
+
+        batchColors[pending] = rgba;
+        batchPixels[pending] = i;
+        if (++pending == QUANTIZER_BATCH) flush();
     }
+    if (pending > 0) flush();
 
     return result;
 }
@@ -5,12 +5,19 @@
 #include <functional>
 #include <limits>
 #include <cmath>
+#include <cstdint>
 #include "../model/IImageData.h"
 #include "../model/Palette.h"
 #include "../model/Pixels.h"
 
 std::vector<double> convertColorSpace(const std::vector<int>& color);
 
+// Pixels converted and matched against the palette together by quantizeImage().
+#define QUANTIZER_BATCH 64
+
+// Colour channels compared; the palette is RGBA, so rgb compares four.
+#define QUANTIZER_MAX_CHANNELS 4
+
 class Quantizer {
 private:
     const std::function<std::vector<double>(const std::vector<int>&)> colorspace;
@@ -18,14 +25,55 @@ private:
     mutable std::vector<std::vector<double>> paletteCache; // Cache converted palette colors
     mutable bool cacheInitialized;
 
+    // Enabled palette entries in the target colorspace, one plane per channel,
+    // in palette.enabled order so ties still go to the earliest entry.
+    // channels is 0 when the palette can't be laid out that way (entries of
+    // differing length), and everything goes through quantizePixel().
+    mutable std::vector<int> enabledIndices;
+    mutable std::vector<double> enabledPlanes[QUANTIZER_MAX_CHANNELS];
+    mutable size_t channels;
+
+    // Scratch for one batch: converted pixels, one plane per channel, and the
+    // best distance so far for each.
+    mutable std::vector<double> batchPlanes[QUANTIZER_MAX_CHANNELS];
+    mutable std::vector<double> batchBest;
+
+    // RGBA -> palette index memo, indexed by the top lookupBits/3 bits of
+    // R, G and B. A slot remembers the full RGBA it was filled for, so a hit
+    // is always the answer the search would have given.
+    int lookupBits;
+    mutable std::vector<uint32_t> lookupColor;
+    mutable std::vector<uint8_t> lookupIndex;
+
+    // The last colour run through the colorspace, and what came out. Runs of
+    // one colour (flat areas, borders) convert once, not once per pixel.
+    mutable std::vector<int> convertPixel;
+    mutable std::vector<double> convertResult;
+    mutable uint32_t convertColor;
+    mutable bool convertValid;
+
     void initializePaletteCache() const;
+    const std::vector<double>& convert(uint32_t rgba) const;
+    void preparePlanes() const;
+    size_t lookupSlot(uint32_t rgba) const;
+    void searchBatch(const uint32_t* colors, size_t count, int* out) const;
 
 public:
     Quantizer(const Palette& palette, const std::function<std::vector<double>(const std::vector<int>&)>& colorspace);
 
+    // Size the RGBA lookup: 0 disables it, otherwise a multiple of 3 up to 24
+    // (15 -> 160 KB, 18 -> 1.25 MB). Off by default.
+    void setLookupBits(int bits);
+
     double distanceSquared(const std::vector<int>& realPixel, int paletteIndex) const;
     int quantizePixel(const std::vector<int>& pixel) const;
     std::vector<int> quantizeImage(const IImageData& image) const;
+
+    // For each of count RGBA colours, which of its perPixel candidates
+    // (palette indices, -1 for none) is nearest: out[k] is the position in
+    // that pixel's candidates, 0 if none qualifies. Same distances and ties
+    // as calling distanceSquared() on each candidate in turn.
+    void nearestCandidate(const uint32_t* colors, size_t count, const int* candidates, size_t perPixel, int* out) const;
 };
 
 #endif // QUANTIZER_H
@@ -186,6 +186,7 @@ int main(int argc, char* argv[]) {
             };
 
         Quantizer quantizer(*palette, colorspaceWrapper);
+        quantizer.setLookupBits(18);
         Converter converter(quantizer);
 
         // Convert scale string to enum
@@ -17,6 +17,10 @@
 
 #include "utils.h"
 
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
 
 // ESTALE, ENOSTR and ENODATA not in errno.h on Windows/MinGW
 #ifndef ESTALE
@@ -53,6 +57,8 @@ int _tnfs_tcp_recv(tnfsMountInfo *m_info, tnfsPacket &pkt);
 _tnfs_send_recv_result _tnfs_send_recv(fnUDP &udp, tnfsMountInfo *m_info, tnfsPacket &req_pkt, uint16_t payload_size, tnfsPacket &res_pkt);
 _tnfs_recv_result _tnfs_recv_and_validate(fnUDP &udp, tnfsMountInfo *m_info, tnfsPacket &req_pkt, uint16_t payload_size, tnfsPacket &res_pkt);
 uint8_t _tnfs_session_recovery(tnfsMountInfo *m_info, uint8_t command);
+int _tnfs_fill_cache_pipelined(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI);
+int _tnfs_drop_prefetch(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, bool restore);
 
 int _tnfs_adjust_with_full_path(tnfsMountInfo *m_info, char *buffer, const char *source, int bufflen);
 
@@ -222,6 +228,7 @@ int tnfs_open(tnfsMountInfo *m_info, const char *filepath, uint16_t open_mode, u
             // Since everything went okay, save our file info
             pFileInf->handle_id = packet.payload[1];
             pFileInf->file_position = pFileInf->cached_pos = 0;
+            pFileInf->cache_size = m_info->cache_size > 0 ? m_info->cache_size : TNFS_FILE_CACHE_SIZE;
 
             *file_handle = pFileInf->handle_id;
 
@@ -260,6 +267,9 @@ int tnfs_close(tnfsMountInfo *m_info, int16_t file_handle)
     if (pFileInf == nullptr)
         return TNFS_RESULT_BAD_FILE_DESCRIPTOR;
 
+    // Replies to READs sent ahead are of no use now
+    _tnfs_drop_prefetch(m_info, pFileInf, false);
+
     tnfsPacket packet;
     packet.command = TNFS_CMD_CLOSE;
     packet.payload[0] = file_handle;
@@ -373,14 +383,38 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
     Debug_printf("_TNFS_FILL_CACHE fh=%d, file_position=%lu\r\n", pFHI->handle_id, pFHI->file_position);
     #endif
 
-    int error = 0;
+    if (pFHI->cache == nullptr)
+    {
+        // PSRAM first, then the ordinary heap
+#ifdef ESP_PLATFORM
+        pFHI->cache = (uint8_t *)heap_caps_malloc(pFHI->cache_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (pFHI->cache == nullptr)
+            pFHI->cache = (uint8_t *)heap_caps_malloc(pFHI->cache_size, MALLOC_CAP_8BIT);
+#else
+        pFHI->cache = (uint8_t *)malloc(pFHI->cache_size);
+#endif
+        if (pFHI->cache == nullptr)
+            return TNFS_RESULT_OUT_OF_MEMORY;
+    }
+
+    // Keep several READs in flight over UDP; over TCP the stream already
+    // does that, and a window of 1 is the protocol's one-at-a-time rule.
+    // A handle whose pipeline has ever seen a mismatch stays on that rule.
+    if (m_info->protocol == TNFS_PROTOCOL_UDP && m_info->read_window > 1 && !pFHI->pipeline_fallback)
+        return _tnfs_fill_cache_pipelined(m_info, pFHI);
+
+    // Settle anything sent ahead before the window was turned down
+    int error = _tnfs_drop_prefetch(m_info, pFHI, true);
+    if (error != 0)
+        return error;
+    pFHI->sequential_fills = 0;
 
     // Reset the current cache values so it's invalid if we fail below
     pFHI->cache_available = 0;
     pFHI->cache_start = pFHI->file_position;
 
     // How many bytes until we finish loading the cache
-    uint32_t bytes_remaining_to_load = sizeof(pFHI->cache);
+    uint32_t bytes_remaining_to_load = pFHI->cache_size;
 
     // Keep making TNFS READ calls as long as we still have bytes to read
     while (bytes_remaining_to_load > 0)
@@ -416,7 +450,7 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
                     break;
                 }
 
-                memcpy(pFHI->cache + (sizeof(pFHI->cache) - bytes_remaining_to_load),
+                memcpy(pFHI->cache + (pFHI->cache_size - bytes_remaining_to_load),
                        packet.payload + 3, bytes_read);
 
                 // Keep track of our file position
@@ -459,12 +493,12 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
 #ifdef ESP_PLATFORM
     if (error == 0)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
+        pFHI->cache_available = pFHI->cache_size - bytes_remaining_to_load;
 #else
 // TODO review EOF handling
     if (error == 0 || error == TNFS_RESULT_END_OF_FILE)
     {
-        pFHI->cache_available = sizeof(pFHI->cache) - bytes_remaining_to_load;
+        pFHI->cache_available = pFHI->cache_size - bytes_remaining_to_load;
         if (pFHI->cache_available > 0) error = 0; // neutralize EOF
 #endif
 #ifdef DEBUG
@@ -475,6 +509,366 @@ int _tnfs_fill_cache(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
     return error;
 }
 
+// Milliseconds before an unanswered pipelined READ counts as lost: a few
+// round trips once we've measured one, never longer than the mount's timeout.
+static uint32_t _tnfs_read_timeout(tnfsMountInfo *m_info)
+{
+    uint32_t rto = m_info->read_rtt_ms * 4;
+    if (rto < TNFS_READ_MIN_TIMEOUT)
+        rto = TNFS_READ_MIN_TIMEOUT;
+    if (m_info->read_rtt_ms == 0 || rto > (uint32_t)m_info->timeout_ms)
+        rto = m_info->timeout_ms;
+    return rto;
+}
+
+static void _tnfs_pipeline_wait()
+{
+#ifdef ESP_PLATFORM
+    fnSystem.yield();
+#else
+    fnSystem.delay_microseconds(250);
+#endif
+}
+
+/*
+ Sends one READ of len bytes on the handle's pipeline socket without waiting
+ for the reply. The sequence number used is stored in seq.
+*/
+static bool _tnfs_send_read(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, uint16_t len, uint8_t *seq)
+{
+    if (pFHI->pipeline_udp == nullptr)
+        pFHI->pipeline_udp = new fnUDP();
+
+    tnfsPacket packet;
+    packet.session_idl = TNFS_LOBYTE_FROM_UINT16(m_info->session);
+    packet.session_idh = TNFS_HIBYTE_FROM_UINT16(m_info->session);
+    packet.sequence_num = *seq = m_info->current_sequence_num++;
+    packet.command = TNFS_CMD_READ;
+    packet.payload[0] = pFHI->handle_id;
+    packet.payload[1] = TNFS_LOBYTE_FROM_UINT16(len);
+    packet.payload[2] = TNFS_HIBYTE_FROM_UINT16(len);
+
+    return _tnfs_udp_send(pFHI->pipeline_udp, m_info, packet, 3);
+}
+
+/*
+ Waits until every one of the count READs in seqs has been answered, or
+ until the pipeline timeout passes without a reply. Afterwards nothing we
+ sent is still on its way to the server.
+*/
+static void _tnfs_drain_reads(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, const uint8_t *seqs, int count)
+{
+    bool answered[TNFS_MAX_READ_WINDOW] = { false };
+    int outstanding = count;
+    uint64_t last_reply = fnSystem.millis();
+    uint32_t rto = _tnfs_read_timeout(m_info);
+
+    while (outstanding > 0 && (fnSystem.millis() - last_reply) < rto)
+    {
+        tnfsPacket res;
+        if (_tnfs_udp_recv(pFHI->pipeline_udp, m_info, res) < TNFS_HEADER_SIZE)
+        {
+            _tnfs_pipeline_wait();
+            continue;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            if (!answered[i] && seqs[i] == res.sequence_num)
+            {
+                answered[i] = true;
+                outstanding--;
+                last_reply = fnSystem.millis();
+                break;
+            }
+        }
+    }
+}
+
+/*
+ Moves the server's file pointer to an absolute position without touching
+ what the client sees (cached_pos) or the cache itself.
+ Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+*/
+static int _tnfs_seek_server(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, uint32_t position)
+{
+    tnfsPacket packet;
+    packet.command = TNFS_CMD_LSEEK;
+    packet.payload[0] = pFHI->handle_id;
+    packet.payload[1] = SEEK_SET;
+    TNFS_UINT32_TO_LOHI_BYTEPTR(position, packet.payload + 2);
+
+    if (!_tnfs_transaction(m_info, packet, 6))
+        return -1;
+    if (packet.payload[0] == TNFS_RESULT_SUCCESS)
+        pFHI->file_position = position;
+    return packet.payload[0];
+}
+
+/*
+ Forgets READs sent ahead by the last pipelined fill. The server has moved
+ its file pointer past file_position for each one it answered; with restore
+ set it's put back there so the next command on the handle starts from the
+ position we think it does.
+ Returns: 0: success, -1: failed to deliver/receive packet, other: TNFS error result code
+*/
+int _tnfs_drop_prefetch(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI, bool restore)
+{
+    if (pFHI->prefetch_count == 0)
+        return 0;
+
+    std::lock_guard<std::recursive_mutex> lock(m_info->transaction_mutex);
+
+    _tnfs_drain_reads(m_info, pFHI, pFHI->prefetch_seq, pFHI->prefetch_count);
+    pFHI->prefetch_count = 0;
+    pFHI->sequential_fills = 0;
+
+    if (restore)
+        return _tnfs_seek_server(m_info, pFHI, pFHI->file_position);
+    return 0;
+}
+
+/*
+ _tnfs_fill_cache() for UDP mounts with a read_window above 1: keeps up to
+ read_window READs in flight instead of waiting out a round trip per packet.
+
+ READ carries no offset - each returns the bytes at the server's file pointer
+ and moves it on - so a reply is only accepted if it answers the oldest READ
+ still in flight. Any mismatch (a later sequence number answered first, no
+ answer within a few round trips, TRY_AGAIN) means a datagram was lost or
+ reordered, and from the client's side it can't be told which bytes went
+ where. The fill then waits out whatever is still in flight, LSEEKs the
+ server back to the first byte it has for certain, and finishes one READ at
+ a time; the handle stays on single READs until it's closed.
+ Returns: 0: success; -1: failed to deliver/receive packet; other: TNFS error result code
+*/
+int _tnfs_fill_cache_pipelined(tnfsMountInfo *m_info, tnfsFileHandleInfo *pFHI)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_info->transaction_mutex);
+
+    int window = m_info->read_window > TNFS_MAX_READ_WINDOW ? TNFS_MAX_READ_WINDOW : m_info->read_window;
+
+    // Sequential access: this fill picks up exactly where the last one ended
+    if (pFHI->cache_available > 0 && pFHI->file_position == pFHI->cache_start + pFHI->cache_available)
+    {
+        if (pFHI->sequential_fills < 255)
+            pFHI->sequential_fills++;
+    }
+    else
+        pFHI->sequential_fills = 0;
+
+    pFHI->cache_available = 0;
+    pFHI->cache_start = pFHI->file_position;
+
+    const uint32_t wanted = pFHI->cache_size;
+    uint32_t received = 0;  // Bytes in the cache so far
+    uint32_t requested = 0; // Bytes asked for by the READs in flight
+
+    // READs in flight, oldest first
+    uint8_t seqs[TNFS_MAX_READ_WINDOW];
+    uint16_t lens[TNFS_MAX_READ_WINDOW];
+    uint64_t sent[TNFS_MAX_READ_WINDOW];
+    int inflight = 0;
+
+    // Pick up whatever the previous fill sent ahead for this one
+    for (int i = 0; i < pFHI->prefetch_count; i++)
+    {
+        seqs[inflight] = pFHI->prefetch_seq[i];
+        lens[inflight] = pFHI->prefetch_len[i];
+        sent[inflight] = pFHI->prefetch_sent_ms;
+        requested += lens[inflight];
+        inflight++;
+    }
+    pFHI->prefetch_count = 0;
+
+    int error = 0;
+    bool eof = false;
+    int resyncs = 0;
+
+    while (error == 0)
+    {
+        // Keep the window full
+        while (!eof && inflight < window && received + requested < wanted)
+        {
+            uint32_t remaining = wanted - received - requested;
+            uint16_t len = remaining > TNFS_READ_CHUNK ? TNFS_READ_CHUNK : remaining;
+            if (!_tnfs_send_read(m_info, pFHI, len, &seqs[inflight]))
+            {
+                Debug_println("_tnfs_fill_cache_pipelined failed to send READ");
+                error = -1;
+                break;
+            }
+            lens[inflight] = len;
+            sent[inflight] = fnSystem.millis();
+            requested += len;
+            inflight++;
+        }
+        if (error != 0 || inflight == 0)
+            break;
+
+        if (SYSTEM_BUS.getShuttingDown())
+        {
+            error = -1;
+            break;
+        }
+
+        bool gap = false;
+        tnfsPacket res;
+        int l = _tnfs_udp_recv(pFHI->pipeline_udp, m_info, res);
+        if (l < TNFS_HEADER_SIZE + 1)
+        {
+            if ((fnSystem.millis() - sent[0]) < _tnfs_read_timeout(m_info))
+            {
+                _tnfs_pipeline_wait();
+                continue;
+            }
+            Debug_printf("_tnfs_fill_cache_pipelined no reply to seq %x\r\n", seqs[0]);
+            gap = true;
+            inflight = 0; // Nothing sent that long ago is still coming
+        }
+        else
+        {
+            int slot = -1;
+            for (int i = 0; i < inflight; i++)
+            {
+                if (seqs[i] == res.sequence_num)
+                {
+                    slot = i;
+                    break;
+                }
+            }
+            if (slot < 0)
+                continue; // Stale reply to a READ already given up on
+
+            if (slot > 0)
+            {
+                Debug_printf("_tnfs_fill_cache_pipelined seq %x answered before %x\r\n", seqs[slot], seqs[0]);
+                gap = true;
+            }
+            else
+            {
+                uint8_t tnfs_result = res.payload[0];
+                if (tnfs_result == TNFS_RESULT_SUCCESS)
+                {
+                    uint16_t bytes_read = TNFS_UINT16_FROM_LOHI_BYTEPTR(res.payload + 1);
+                    if (bytes_read > lens[0] || l < TNFS_HEADER_SIZE + 3 + bytes_read)
+                    {
+                        Debug_printf("_tnfs_fill_cache_pipelined bogus read length %u > requested %u; rejecting\r\n",
+                                     bytes_read, lens[0]);
+                        error = -1;
+                        break;
+                    }
+                    memcpy(pFHI->cache + received, res.payload + 3, bytes_read);
+                    received += bytes_read;
+
+                    uint32_t sample = (uint32_t)(fnSystem.millis() - sent[0]);
+                    m_info->read_rtt_ms = m_info->read_rtt_ms == 0 ? (sample ? sample : 1)
+                                                                   : (m_info->read_rtt_ms * 7 + sample) / 8;
+
+                    // A short read means the server hit the end of the file;
+                    // everything behind it will come back EOF.
+                    if (bytes_read < lens[0])
+                        eof = true;
+                }
+                else if (tnfs_result == TNFS_RESULT_END_OF_FILE)
+                {
+                    eof = true;
+                }
+                else if (tnfs_result == TNFS_RESULT_TRY_AGAIN)
+                {
+                    // This one wasn't served, but the ones behind it may have been
+                    uint16_t backoffms = TNFS_UINT16_FROM_LOHI_BYTEPTR(res.payload + 1);
+                    if (backoffms > TNFS_MAX_BACKOFF_DELAY)
+                        backoffms = TNFS_MAX_BACKOFF_DELAY;
+                    fnSystem.delay(backoffms);
+                    gap = true;
+                }
+                else if (tnfs_result == TNFS_RESULT_INVALID_HANDLE)
+                {
+                    // Expired session: a file handle doesn't survive the remount
+                    error = _tnfs_session_recovery(m_info, TNFS_CMD_READ);
+                    break;
+                }
+                else
+                {
+                    Debug_printf("_tnfs_fill_cache_pipelined unexepcted result: %u\r\n", tnfs_result);
+                    error = tnfs_result;
+                    break;
+                }
+
+                if (!gap)
+                {
+                    requested -= lens[0];
+                    inflight--;
+                    memmove(seqs, seqs + 1, inflight * sizeof(seqs[0]));
+                    memmove(lens, lens + 1, inflight * sizeof(lens[0]));
+                    memmove(sent, sent + 1, inflight * sizeof(sent[0]));
+                }
+            }
+        }
+
+        if (gap)
+        {
+            if (++resyncs > m_info->max_retries)
+            {
+                Debug_println("_tnfs_fill_cache_pipelined giving up");
+                error = -1;
+                break;
+            }
+            m_info->read_resyncs++;
+
+            _tnfs_drain_reads(m_info, pFHI, seqs, inflight);
+            inflight = 0;
+            requested = 0;
+            eof = false;
+
+            // No more than one READ in flight from here on, so the next
+            // reply can only be an answer to it
+            window = 1;
+            pFHI->pipeline_fallback = true;
+
+            // Back to the first byte we don't have
+            int result = _tnfs_seek_server(m_info, pFHI, pFHI->cache_start + received);
+            if (result != 0)
+                error = result;
+        }
+    }
+
+    if (error == 0)
+    {
+        pFHI->file_position = pFHI->cache_start + received;
+        pFHI->cache_available = received;
+
+        // Nothing left at all: say so, rather than hand tnfs_read() an empty
+        // cache it would only ask us to fill again
+        if (eof && received == 0)
+            error = TNFS_RESULT_END_OF_FILE;
+
+        // Reading straight through: send the start of the next fill now, so
+        // it's on its way while the caller works through this one
+        if (!eof && received == wanted && pFHI->sequential_fills > 0 && window > 1)
+        {
+            int ahead = wanted / TNFS_READ_CHUNK;
+            if (ahead > window)
+                ahead = window;
+            for (int i = 0; i < ahead; i++)
+            {
+                if (!_tnfs_send_read(m_info, pFHI, TNFS_READ_CHUNK, &pFHI->prefetch_seq[i]))
+                    break;
+                pFHI->prefetch_len[i] = TNFS_READ_CHUNK;
+                pFHI->prefetch_count++;
+            }
+            pFHI->prefetch_sent_ms = fnSystem.millis();
+        }
+    }
+    else
+    {
+        // The server's pointer is wherever the last answered READ left it
+        pFHI->file_position = pFHI->cache_start + received;
+    }
+
+    return error;
+}
+
 /*
  Reads from an open file.
  Max bufflen is TNFS_PAYLOAD_SIZE - 3; any larger size will return an error
@@ -548,6 +942,11 @@ int tnfs_write(tnfsMountInfo *m_info, int16_t file_handle, uint8_t *buffer, uint
     if (pFileInf == nullptr)
         return TNFS_RESULT_BAD_FILE_DESCRIPTOR;
 
+    // Put the server's pointer back from any READs sent ahead
+    int dropped = _tnfs_drop_prefetch(m_info, pFileInf, true);
+    if (dropped != 0)
+        return dropped;
+
     // For now, invalidate our cache and seek to the current position in the file before writing
     pFileInf->cache_available = 0;
     if(pFileInf->cached_pos != pFileInf->file_position)
@@ -654,6 +1053,12 @@ int tnfs_lseek(tnfsMountInfo *m_info, int16_t file_handle, int32_t position, uin
     // Cache seek failed - invalidate the internal cache
     pFileInf->cache_available = 0;
 
+    // READs sent ahead have moved the server's pointer on; only SEEK_CUR
+    // needs it back where we think it is
+    int dropped = _tnfs_drop_prefetch(m_info, pFileInf, type == SEEK_CUR);
+    if (dropped != 0)
+        return dropped;
+
     // Go ahead and execute a new TNFS SEEK request
     tnfsPacket packet;
     packet.command = TNFS_CMD_LSEEK;
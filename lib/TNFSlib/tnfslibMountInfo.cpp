@@ -1,7 +1,18 @@
 
 #include "tnfslibMountInfo.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
 #include "compat_string.h"
+#include "fnUDP.h"
+
+tnfsFileHandleInfo::~tnfsFileHandleInfo()
+{
+    free(cache);
+    delete pipeline_udp;
+}
 
 
 tnfsMountInfo::tnfsMountInfo(const char *host_name, uint16_t host_port)
@@ -16,6 +27,39 @@ tnfsMountInfo::tnfsMountInfo(in_addr_t host_address, uint16_t host_port)
 {
 }
 
+/*
+ Apply the options in a URL query, e.g. "window=8&cache=8192":
+   window - READs kept in flight per cache fill over UDP, 1 to TNFS_MAX_READ_WINDOW
+            (1 is stop-and-wait, for a server or network that reorders datagrams)
+   cache  - read cache for files opened from now on, TNFS_READ_CHUNK to TNFS_MAX_FILE_CACHE_SIZE
+ Anything else in the query, and values out of range, are ignored.
+*/
+void tnfsMountInfo::set_options(const char *query)
+{
+    if (query == nullptr)
+        return;
+
+    const char *p = query;
+    while (*p != '\0')
+    {
+        size_t len = strcspn(p, "&");
+        const char *eq = (const char *)memchr(p, '=', len);
+        if (eq != nullptr)
+        {
+            std::string name(p, eq - p);
+            unsigned long value = strtoul(eq + 1, nullptr, 10);
+
+            if (name == "window" && value >= 1 && value <= TNFS_MAX_READ_WINDOW)
+                read_window = (uint8_t)value;
+            else if (name == "cache" && value >= TNFS_READ_CHUNK && value <= TNFS_MAX_FILE_CACHE_SIZE)
+                cache_size = (uint32_t)value;
+        }
+        p += len;
+        if (*p == '&')
+            p++;
+    }
+}
+
 // Make sure to clean up any memory we allocated
 tnfsMountInfo::~tnfsMountInfo()
 {
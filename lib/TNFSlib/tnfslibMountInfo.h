@@ -7,6 +7,8 @@
 #include "fnDNS.h"
 #include "fnTcpClient.h"
 
+class fnUDP;
+
 
 #define TNFS_DEFAULT_PORT 16384
 #define TNFS_RETRIES 8 // Number of times to retry if we fail to send/receive a packet
@@ -16,7 +18,12 @@
 #define TNFS_MAX_FILE_HANDLES 8 // Max number of file handles we'll open to the server
 #define TNFS_MAX_FILELEN 256
 
-#define TNFS_FILE_CACHE_SIZE 512 // 4 * 128 fits in a single packet when TNFS_MAX_READWRITE_PAYLOAD is 512
+#define TNFS_FILE_CACHE_SIZE 2048 // Default per-handle read cache; tnfsMountInfo::cache_size overrides it
+#define TNFS_MAX_FILE_CACHE_SIZE 65536
+#define TNFS_READ_CHUNK 512 // Bytes asked for by each READ while filling the cache (4 * 128 fits in a single packet)
+#define TNFS_READ_WINDOW 4 // READs kept in flight while filling the cache over UDP; more relies on the server answering in order, 1 (?window=1) is strict stop-and-wait
+#define TNFS_MAX_READ_WINDOW 16
+#define TNFS_READ_MIN_TIMEOUT 100 // Floor for the pipeline's round-trip based timeout (ms)
 
 #define TNFS_INVALID_HANDLE -1
 #define TNFS_INVALID_SESSION 0 // We're assuming a '0' is never a valid session ID
@@ -52,8 +59,22 @@ struct tnfsFileHandleInfo
 
     bool cache_modified = false; // Notes if we've written to the cache
 
-    uint8_t cache[TNFS_FILE_CACHE_SIZE];
+    uint8_t *cache = nullptr; // cache_size bytes, allocated by the first read
+    uint32_t cache_size = TNFS_FILE_CACHE_SIZE;
     char filename[TNFS_MAX_FILELEN];
+
+    // Read pipeline (UDP only). A fill that starts where the previous one
+    // ended counts as sequential; after two in a row the first READs of the
+    // next fill are sent as soon as a fill completes, and collected by it.
+    uint8_t sequential_fills = 0;
+    uint8_t prefetch_count = 0; // Pre-issued READs not yet collected
+    uint8_t prefetch_seq[TNFS_MAX_READ_WINDOW];
+    uint16_t prefetch_len[TNFS_MAX_READ_WINDOW];
+    uint64_t prefetch_sent_ms = 0;
+    fnUDP *pipeline_udp = nullptr; // The socket pipelined READs go out on, so their replies come back to it
+    bool pipeline_fallback = false; // A reply didn't match its READ; this handle reads one at a time from now on
+
+    ~tnfsFileHandleInfo();
 };
 
 // A place to store each directory entry we cache from a response to TNFS_READDIRX
@@ -89,6 +110,9 @@ public:
     void delete_filehandleinfo(uint8_t filehandle);
     void delete_filehandleinfo(tnfsFileHandleInfo * pFilehandle);
 
+    // Mount options from a URL query ("window=8&cache=8192"); see tnfslibMountInfo.cpp
+    void set_options(const char *query);
+
     tnfsDirCacheEntry * new_dircache_entry();
     tnfsDirCacheEntry * next_dircache_entry();
 
@@ -116,6 +140,11 @@ public:
     int timeout_ms = TNFS_TIMEOUT;
     uint8_t current_sequence_num = 0; // Updated with each transaction to the server
 
+    uint8_t read_window = TNFS_READ_WINDOW; // READs in flight per cache fill (UDP); see _tnfs_fill_cache_pipelined()
+    uint32_t cache_size = TNFS_FILE_CACHE_SIZE; // Read cache given to files opened from now on
+    uint32_t read_rtt_ms = 0; // Smoothed READ round trip, 0 until measured
+    uint32_t read_resyncs = 0; // Times a pipelined fill had to LSEEK back over a lost request or reply
+
     int16_t dir_handle = TNFS_INVALID_HANDLE; // Stored from server's response to TNFS_OPENDIR
     uint16_t dir_entries = 0; // Stored from server's response to TNFS_OPENDIRX
     std::recursive_mutex transaction_mutex;
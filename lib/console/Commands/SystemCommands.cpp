@@ -8,6 +8,8 @@
 
 #include "mlConfig.h"
 #include "../../device/iec/meatloaf.h"
+#include "meat_media.h"
+#include "fnScheduler.h"
 
 static inline void *psram_malloc(size_t sz) {
     void *p = heap_caps_malloc(sz, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
@@ -182,6 +184,14 @@ static int meminfo(int argc, char **argv)
 #endif
 #endif
 
+    Serial.printf("Image cache: %u streams, %u KB of %u KB, %lu hits, %lu misses, %lu evictions\r\n",
+                  (unsigned)ImageBroker::count(), (unsigned)(ImageBroker::bytes() / 1024),
+                  (unsigned)(ImageBroker::limit() / 1024), (unsigned long)ImageBroker::hits,
+                  (unsigned long)ImageBroker::misses, (unsigned long)ImageBroker::evictions);
+    Serial.printf("Directory cache: %u listings, %lu hits, %lu misses\r\n",
+                  (unsigned)DirectoryCache::count(), (unsigned long)DirectoryCache::hits,
+                  (unsigned long)DirectoryCache::misses);
+
     Debug_memory();
     return EXIT_SUCCESS;
 }
@@ -198,6 +208,30 @@ static int taskinfo(int argc, char **argv)
     return EXIT_SUCCESS;
 }
 
+static int jobinfo(int argc, char **argv)
+{
+    static const char *prio_names[JOB_PRIORITIES] = { "high", "normal", "bg" };
+
+    if (!jobScheduler.running())
+        Serial.printf("Job scheduler is not running\r\n");
+
+    Serial.printf("Queued: high %u, normal %u, bg %u\r\n",
+                  (unsigned)jobScheduler.pending(JOB_HIGH),
+                  (unsigned)jobScheduler.pending(JOB_NORMAL),
+                  (unsigned)jobScheduler.pending(JOB_BACKGROUND));
+    Serial.printf("Job Name\tPrio\tRuns\tCancel\tLate\tYields\tCPU ms\tMax ms\tAvg lat\tMax lat\r\n");
+    for (auto &s : jobScheduler.stats())
+    {
+        uint64_t avg_latency = s.runs ? s.latency_us / s.runs : 0;
+        Serial.printf("%-15s\t%s\t%lu\t%lu\t%lu\t%lu\t%llu\t%llu\t%llu\t%llu\r\n",
+                      s.name.c_str(), prio_names[s.priority],
+                      (unsigned long)s.runs, (unsigned long)s.cancelled, (unsigned long)s.late, (unsigned long)s.yields,
+                      (unsigned long long)(s.cpu_us / 1000), (unsigned long long)(s.max_run_us / 1000),
+                      (unsigned long long)(avg_latency / 1000), (unsigned long long)(s.max_latency_us / 1000));
+    }
+    return EXIT_SUCCESS;
+}
+
 static int date(int argc, char **argv)
 {
     bool set_time = false;
@@ -414,6 +448,11 @@ namespace ESP32Console::Commands
         return ConsoleCommand("ps", &taskinfo, "Shows information about running tasks");
     }
 
+    const ConsoleCommand getJobInfoCommand()
+    {
+        return ConsoleCommand("jobs", &jobinfo, "Shows queue depths and per-job timing of the background job scheduler");
+    }
+
     const ConsoleCommand getDateCommand()
     {
         return ConsoleCommand("date", &date, "Shows and modify the system time");
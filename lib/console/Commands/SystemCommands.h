@@ -10,6 +10,8 @@ namespace ESP32Console::Commands
 
     const ConsoleCommand getTaskInfoCommand();
 
+    const ConsoleCommand getJobInfoCommand();
+
     const ConsoleCommand getDateCommand();
 
     const ConsoleCommand getConfigCommand();
@@ -16,6 +16,7 @@
 #include <zlib.h>
 #include "../../meatloaf/network/http.h"
 #include "../../meatloaf/media/hd/partition_select.h"
+#include "../../meatloaf/meat_copy.h"
 
 // Defined further down; cp() needs it and sits above the definition.
 static std::string resolve_path(const char *arg);
@@ -427,10 +428,11 @@ int partition(int argc, char **argv)
 
 // Shared by cp and mv. Resolves both sides through MFSOwner, so either end may
 // be inside a disk image or an archive, or a URL. Returns false having already
-// printed the reason. 'verb' only names the caller in messages.
+// printed the reason. 'verb' only names the caller in messages; 'verify' reads
+// the copy back before it is trusted.
 static bool copy_via_mfile(const char *verb,
                            const std::string &src, std::string &dst,
-                           size_t *out_total)
+                           size_t *out_total, bool verify = false)
 {
     std::unique_ptr<MFile> srcFile(MFSOwner::File(src));
     if (!srcFile || !srcFile->exists())
@@ -466,48 +468,36 @@ static bool copy_via_mfile(const char *verb,
         }
     }
 
-    auto in = srcFile->getSourceStream(std::ios_base::in);
-    if (!in || !in->isOpen())
-    {
-        Serial.printf("%s: cannot read '%s'\r\n", verb, src.c_str());
-        return false;
-    }
-
     std::unique_ptr<MFile> dstFile(MFSOwner::File(dst));
-    auto out = dstFile ? dstFile->getSourceStream(std::ios_base::out) : nullptr;
-    if (!out || !out->isOpen())
+    if (!dstFile)
     {
         Serial.printf("%s: cannot create '%s'\r\n", verb, dst.c_str());
         return false;
     }
 
-    const uint32_t bufSize = 4096;
-    uint8_t *buf = (uint8_t *)psram_malloc(bufSize);
-    if (!buf)
+    MCopyOptions options;
+    options.verify = verify;
+    MCopyResult result = MCopy::file(srcFile.get(), dstFile.get(), options);
+    switch (result.status)
     {
+    case MCopyResult::OK:
+        break;
+    case MCopyResult::NO_SOURCE:
+        Serial.printf("%s: cannot read '%s'\r\n", verb, src.c_str());
+        return false;
+    case MCopyResult::NO_DESTINATION:
+        Serial.printf("%s: cannot create '%s'\r\n", verb, dst.c_str());
+        return false;
+    case MCopyResult::NO_MEMORY:
         Serial.printf("%s: out of memory\r\n", verb);
         return false;
+    default:
+        Serial.printf("%s: %s after %lu bytes\r\n", verb, result.message(), (unsigned long)result.copied);
+        return false;
     }
 
-    size_t total = 0;
-    bool ok = true;
-    uint32_t n;
-    while ((n = in->read(buf, bufSize)) > 0)
-    {
-        if (out->write(buf, n) != n)
-        {
-            Serial.printf("%s: write failed after %zu bytes\r\n", verb, total);
-            ok = false;
-            break;
-        }
-        total += n;
-    }
-
-    free(buf);
-    out->close();
-
-    if (out_total) *out_total = total;
-    return ok;
+    if (out_total) *out_total = result.copied;
+    return true;
 }
 
 int mv(int argc, char **argv)
@@ -541,11 +531,11 @@ int mv(int argc, char **argv)
     // a disk image or an archive - is a copy followed by a delete. rename(2)
     // cannot move data across those boundaries at all.
     size_t total = 0;
-    if (!copy_via_mfile("mv", src, dst, &total))
+    if (!copy_via_mfile("mv", src, dst, &total, true))
         return EXIT_FAILURE;
 
-    // Only unlink the source once the copy has fully succeeded, so a failed
-    // move never destroys the original.
+    // Only unlink the source once the copy has fully succeeded and read back
+    // the same, so a failed move never destroys the original.
     std::unique_ptr<MFile> srcFile(MFSOwner::File(src));
     if (!srcFile || !srcFile->remove())
     {
@@ -845,15 +835,21 @@ int auth(int argc, char **argv)
 int wget(int argc, char **argv)
 {
     bool insecure = false;
+    bool resume = false;
     const char *url_arg = nullptr;
 
-    if (argc == 2) {
-        url_arg = argv[1];
-    } else if (argc == 3 && strcmp(argv[1], "-k") == 0) {
-        insecure = true;
-        url_arg = argv[2];
-    } else {
-        Serial.printf("wget [-k] {url}\r\n");
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-k") == 0)
+            insecure = true;
+        else if (strcmp(argv[i], "-c") == 0)
+            resume = true;
+        else if (url_arg == nullptr)
+            url_arg = argv[i];
+        else
+            url_arg = "";
+    }
+    if (url_arg == nullptr || !*url_arg) {
+        Serial.printf("wget [-k] [-c] {url}\r\n");
         return EXIT_SUCCESS;
     }
 
@@ -905,50 +901,46 @@ int wget(int argc, char **argv)
         Debug_printv("size[%lu] name[%s] url[%s] outfile[%s]", f->size, outname.c_str(), s->url.c_str(), outfile.c_str());
 
 
-        FILE *file = fopen(outfile.c_str(), "w");
-        if (file == nullptr)
+        // -c continues a partial download left by an earlier attempt, when
+        // the server takes range requests
+        std::unique_ptr<MFile> out(MFSOwner::File(outfile));
+        if (out == nullptr)
         {
             Serial.printf("2 Error: Can't open file!\r\n");
             return 2;
         }
 
-        // Receive File
-        int count = 0;
-        size_t total_written = 0;
-        uint8_t *bytes = (uint8_t *)psram_malloc(256);
-        while (true)
-        {
-            int bytes_read = s->read(bytes, 256);
-            if (bytes_read < 1)
-                break;
-
-            int bytes_written = fwrite(bytes, 1, bytes_read, file);
-            if (bytes_written != bytes_read)
-            {
-                Serial.printf("\nError writing '%s'\r", outname.c_str());
-                break;
-            }
-            total_written += bytes_written;
-
-            // Show percentage complete in stdout
-            uint8_t percent = (f->size > 0) ? (s->position() * 100) / f->size : 0;
+        MCopyOptions options;
+        options.resume = resume;
+        options.progress = [&](const MCopyProgress &p) {
 #ifdef ENABLE_DISPLAY
-            LEDS.progress = percent;
+            LEDS.progress = p.percent();
 #endif
-            Serial.printf("Downloading '%s' %d%% [%lu]\r", outname.c_str(), percent, s->position());
-            count++;
+            Serial.printf("Downloading '%s' %d%% [%lu] %lu KB/s\r", outname.c_str(), p.percent(),
+                          (unsigned long)p.copied, (unsigned long)(p.rate / 1024));
+        };
+
+        MCopyResult result = MCopy::file(s.get(), out.get(), options);
+        if (result.status == MCopyResult::NO_DESTINATION)
+        {
+            Serial.printf("2 Error: Can't open file!\r\n");
+            return 2;
         }
-        free(bytes);
-        fclose(file);
+        if (result.resumed)
+            Serial.printf("\nResumed at %lu bytes", (unsigned long)result.resumed);
 
-        if (total_written == 0)
+        if (result.resumed + result.copied == 0)
         {
             Serial.printf("\nError: Download failed, removing empty file '%s'\r\n", outfile.c_str());
-            remove(outfile.c_str());
+            out->remove();
             if (http_had_tls_error())
                 Serial.printf("TLS: %s\r\n     Retry with 'wget -k' to skip verification.\r\n",
                               http_last_tls_error().c_str());
         }
+        else if (!result.ok())
+        {
+            Serial.printf("\nError: %s '%s'\r\n", result.message(), outname.c_str());
+        }
         else
         {
             Serial.printf("\n");
@@ -1045,9 +1037,18 @@ static int df(int argc, char **argv)
 #include <ctime>
 
 #include "string_utils.h"
+#include "../../meatloaf/scanner/content_index.h"
 
 #define LOCATE_DB_PATH "/sd/.locate"
 
+// containers: the size and mtime each disk image or archive was last indexed at.
+#define CONTAINERS_SCHEMA                       \
+    "CREATE TABLE IF NOT EXISTS containers ("   \
+    "  path  TEXT    PRIMARY KEY,"              \
+    "  size  INTEGER NOT NULL,"                 \
+    "  mtime INTEGER NOT NULL"                  \
+    ")"
+
 /* Volatile scan state — written by the scan task, read by locate/updatedb. */
 static volatile int    s_scan_running = 0;
 static volatile int    s_scan_stop    = 0;  // set to 1 to request cancellation
@@ -1065,6 +1066,8 @@ static volatile int    s_scan_resume  = 0;  // set to 1 to resume from existing
 static volatile int    s_scan_files   = 0;
 static volatile int    s_scan_dirs    = 0;
 static volatile int    s_scan_errors  = 0;
+static volatile int    s_scan_containers = 0;  // disk images and archives indexed
+static volatile int    s_scan_entries    = 0;  // entries found inside them
 static volatile time_t s_scan_start   = 0;
 static volatile time_t s_scan_end     = 0;
 static std::string     s_scan_last_folder;  // last completed directory path
@@ -1097,6 +1100,25 @@ struct PsramPath {
     PsramPath &operator=(const PsramPath &) = delete;
 };
 
+// Commit the rows written so far and open the next transaction.
+static void updatedb_next_batch(sqlite3 *db)
+{
+    if (!sqlite3_get_autocommit(db)) {
+        char *cerr = nullptr;
+        if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, &cerr) != SQLITE_OK) {
+            Serial.printf("  commit failed: %s\r\n",
+                          cerr ? cerr : sqlite3_errmsg(db));
+            sqlite3_free(cerr);
+        }
+    }
+    char *berr = nullptr;
+    if (sqlite3_exec(db, "BEGIN", nullptr, nullptr, &berr) != SQLITE_OK) {
+        Serial.printf("  BEGIN failed: %s\r\n",
+                      berr ? berr : sqlite3_errmsg(db));
+        sqlite3_free(berr);
+    }
+}
+
 // dir_ins_stmt : INSERT OR IGNORE INTO dirs (path) VALUES (?)
 // dir_id_stmt  : SELECT id FROM dirs WHERE path = ?
 // file_ins_stmt: INSERT OR REPLACE INTO files (dir_id, name, size, mtime, is_dir) VALUES (?,?,?,?,?)
@@ -1192,20 +1214,7 @@ static void updatedb_scan(sqlite3 *db,
             }
 
             if (++batch >= 1000) {
-                if (!sqlite3_get_autocommit(db)) {
-                    char *cerr = nullptr;
-                    if (sqlite3_exec(db, "COMMIT", nullptr, nullptr, &cerr) != SQLITE_OK) {
-                        Serial.printf("  commit failed: %s\r\n",
-                                      cerr ? cerr : sqlite3_errmsg(db));
-                        sqlite3_free(cerr);
-                    }
-                }
-                char *berr = nullptr;
-                if (sqlite3_exec(db, "BEGIN", nullptr, nullptr, &berr) != SQLITE_OK) {
-                    Serial.printf("  BEGIN failed: %s\r\n",
-                                  berr ? berr : sqlite3_errmsg(db));
-                    sqlite3_free(berr);
-                }
+                updatedb_next_batch(db);
                 batch = 0;
             }
 
@@ -1243,6 +1252,242 @@ static void apply_pragmas(sqlite3 *d)
     sqlite3_exec(d, "PRAGMA cache_size = 128",      nullptr, nullptr, nullptr);
 }
 
+// Databases from before the content index lack its columns and table.
+// ALTER TABLE fails harmlessly where a column is already there.
+static void updatedb_migrate(sqlite3 *db)
+{
+    sqlite3_exec(db, "ALTER TABLE dirs ADD COLUMN container INTEGER NOT NULL DEFAULT 0",
+                 nullptr, nullptr, nullptr);
+    sqlite3_exec(db, "ALTER TABLE files ADD COLUMN type TEXT NOT NULL DEFAULT ''",
+                 nullptr, nullptr, nullptr);
+    sqlite3_exec(db, CONTAINERS_SCHEMA, nullptr, nullptr, nullptr);
+}
+
+// The locate database as a ContentCatalog. A container's entries go in
+// `files` under a `dirs` row named by the container's path, so locate finds
+// them with its usual FTS and LIKE queries and prints a path Meatloaf opens
+// ("/sd/games/collection.zip/elite.d64/ELITE").
+class LocateCatalog : public ContentCatalog
+{
+public:
+    explicit LocateCatalog(sqlite3 *db) : m_db(db) {}
+
+    ~LocateCatalog() override
+    {
+        sqlite3_finalize(m_unchanged);
+        sqlite3_finalize(m_forget_files);
+        sqlite3_finalize(m_forget_dirs);
+        sqlite3_finalize(m_dir_ins);
+        sqlite3_finalize(m_dir_id);
+        sqlite3_finalize(m_file_ins);
+        sqlite3_finalize(m_stamp);
+    }
+
+    bool prepare()
+    {
+        // "path" to "path0" is everything under "path/": '0' follows '/'.
+        // Written as a range so the dirs UNIQUE index answers it.
+        return prep(&m_unchanged, "SELECT 1 FROM containers WHERE path=? AND size=? AND mtime=?")
+            && prep(&m_forget_files,
+                    "DELETE FROM files WHERE dir_id IN (SELECT id FROM dirs"
+                    " WHERE path=?1 OR (path > ?1 || '/' AND path < ?1 || '0'))")
+            && prep(&m_forget_dirs,
+                    "DELETE FROM dirs WHERE path=?1 OR (path > ?1 || '/' AND path < ?1 || '0')")
+            && prep(&m_dir_ins, "INSERT OR IGNORE INTO dirs (path, scanned, container) VALUES (?, 1, 1)")
+            && prep(&m_dir_id, "SELECT id FROM dirs WHERE path=?")
+            && prep(&m_file_ins,
+                    "INSERT OR REPLACE INTO files (dir_id, name, size, mtime, is_dir, type)"
+                    " VALUES (?, ?, ?, 0, ?, ?)")
+            && prep(&m_stamp, "INSERT OR REPLACE INTO containers (path, size, mtime) VALUES (?, ?, ?)");
+    }
+
+    bool unchanged(const std::string &path, uint32_t size, time_t mtime) override
+    {
+        sqlite3_reset(m_unchanged);
+        sqlite3_bind_text(m_unchanged, 1, path.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(m_unchanged, 2, (sqlite3_int64)size);
+        sqlite3_bind_int64(m_unchanged, 3, (sqlite3_int64)mtime);
+        return sqlite3_step(m_unchanged) == SQLITE_ROW;
+    }
+
+    void forget(const std::string &path) override
+    {
+        // Nothing was ever recorded inside it: skip the two deletes, which
+        // is every container of a fresh scan.
+        if (dirId(path, false) == 0)
+            return;
+        for (sqlite3_stmt *st : { m_forget_files, m_forget_dirs }) {
+            sqlite3_reset(st);
+            sqlite3_bind_text(st, 1, path.c_str(), -1, SQLITE_STATIC);
+            sqlite3_step(st);
+        }
+        m_dir_path.clear();
+    }
+
+    bool add(const ContentEntry &e) override
+    {
+        if (e.container != m_dir_path) {
+            m_dir = dirId(e.container, true);
+            m_dir_path = e.container;
+        }
+
+        sqlite3_reset(m_file_ins);
+        sqlite3_bind_int64(m_file_ins, 1, m_dir);
+        sqlite3_bind_text(m_file_ins, 2, e.name.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(m_file_ins, 3, (sqlite3_int64)e.size);
+        sqlite3_bind_int(m_file_ins, 4, e.is_dir ? 1 : 0);
+        sqlite3_bind_text(m_file_ins, 5, e.type.c_str(), -1, SQLITE_STATIC);
+        int rc = sqlite3_step(m_file_ins);
+        if (rc != SQLITE_DONE) {
+            s_scan_errors = s_scan_errors + 1;
+            if (s_scan_errors <= 3)
+                Serial.printf("  insert error %d: %s — %s/%s\r\n",
+                              rc, sqlite3_errmsg(m_db), e.container.c_str(), e.name.c_str());
+        }
+        s_scan_entries = s_scan_entries + 1;
+
+        if (++m_batch >= 1000) {
+            updatedb_next_batch(m_db);
+            m_batch = 0;
+        }
+        return true;
+    }
+
+    void stamp(const std::string &path, uint32_t size, time_t mtime) override
+    {
+        sqlite3_reset(m_stamp);
+        sqlite3_bind_text(m_stamp, 1, path.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(m_stamp, 2, (sqlite3_int64)size);
+        sqlite3_bind_int64(m_stamp, 3, (sqlite3_int64)mtime);
+        sqlite3_step(m_stamp);
+    }
+
+private:
+    bool prep(sqlite3_stmt **st, const char *sql)
+    {
+        return sqlite3_prepare_v2(m_db, sql, -1, st, nullptr) == SQLITE_OK;
+    }
+
+    sqlite3_int64 dirId(const std::string &path, bool create)
+    {
+        if (create) {
+            sqlite3_reset(m_dir_ins);
+            sqlite3_bind_text(m_dir_ins, 1, path.c_str(), -1, SQLITE_STATIC);
+            sqlite3_step(m_dir_ins);
+        }
+        sqlite3_reset(m_dir_id);
+        sqlite3_bind_text(m_dir_id, 1, path.c_str(), -1, SQLITE_STATIC);
+        sqlite3_int64 id = 0;
+        if (sqlite3_step(m_dir_id) == SQLITE_ROW)
+            id = sqlite3_column_int64(m_dir_id, 0);
+        return id;
+    }
+
+    sqlite3 *m_db;
+    sqlite3_stmt *m_unchanged = nullptr;
+    sqlite3_stmt *m_forget_files = nullptr;
+    sqlite3_stmt *m_forget_dirs = nullptr;
+    sqlite3_stmt *m_dir_ins = nullptr;
+    sqlite3_stmt *m_dir_id = nullptr;
+    sqlite3_stmt *m_file_ins = nullptr;
+    sqlite3_stmt *m_stamp = nullptr;
+    std::string m_dir_path;         // container the last entry went into
+    sqlite3_int64 m_dir = 0;        // and its dirs id
+    int m_batch = 0;
+};
+
+// Second pass of a scan: index what is inside every disk image and archive
+// the directory pass recorded, skipping those whose size and mtime are what
+// they were last time. Candidates are read from `files` a page at a time, so
+// the list is never held in memory, and each is stat()ed again because a
+// resumed scan does not revisit the folders it already has.
+//
+// This runs on the console task like the rest of updatedb (see the comment
+// on updatedb_run()), but at just above idle priority for its duration:
+// listing an archive is CPU-bound, and the bus and web server come first.
+static void updatedb_content_scan(sqlite3 *db)
+{
+    LocateCatalog catalog(db);
+    sqlite3_stmt *page_stmt = nullptr;
+    if (!catalog.prepare() || sqlite3_prepare_v2(db,
+            "SELECT files.id, dirs.path || '/' || files.name"
+            " FROM files JOIN dirs ON dirs.id = files.dir_id"
+            " WHERE files.id > ? AND files.is_dir = 0 AND dirs.container = 0"
+            " ORDER BY files.id LIMIT 64",
+            -1, &page_stmt, nullptr) != SQLITE_OK) {
+        Serial.printf("updatedb: content index unavailable: %s\r\n", sqlite3_errmsg(db));
+        sqlite3_finalize(page_stmt);
+        return;
+    }
+
+    ContentIndexer indexer(catalog);
+    indexer.stopRequested = [] { return s_scan_stop != 0; };
+    indexer.yield = [] { vTaskDelay(1); };
+
+    UBaseType_t priority = uxTaskPriorityGet(nullptr);
+    vTaskPrioritySet(nullptr, tskIDLE_PRIORITY + 1);
+
+    Serial.printf("updatedb: indexing disk images and archives...\r\n");
+
+    char full[PATH_MAX];
+    int unchanged = 0;
+    sqlite3_int64 after = 0;
+    std::vector<PsramPath> page;
+    while (!s_scan_stop) {
+        // Copy the page out before indexing writes to the same tables.
+        page.clear();
+        int rows = 0;
+        sqlite3_reset(page_stmt);
+        sqlite3_bind_int64(page_stmt, 1, after);
+        while (sqlite3_step(page_stmt) == SQLITE_ROW) {
+            rows++;
+            after = sqlite3_column_int64(page_stmt, 0);
+            const char *rel = (const char *)sqlite3_column_text(page_stmt, 1);
+            const char *name = rel ? strrchr(rel, '/') : nullptr;
+            if (name && ContentIndexer::isContainer(name + 1))
+                page.emplace_back(rel);
+        }
+        sqlite3_reset(page_stmt);
+        if (rows == 0)
+            break;
+
+        for (auto &rel : page) {
+            if (s_scan_stop || !rel.s)
+                break;
+            snprintf(full, sizeof(full), "/sd%s", rel.s);
+            struct stat st;
+            if (stat(full, &st) != 0)
+                continue;
+
+            switch (indexer.index(full, rel.s, (uint32_t)st.st_size, st.st_mtime)) {
+            case ContentIndexer::INDEXED:
+                s_scan_containers = s_scan_containers + 1;
+                if (s_scan_containers % 25 == 0)
+                    Serial.printf("  %d containers, %d entries\r\n",
+                                  (int)s_scan_containers, (int)s_scan_entries);
+                break;
+            case ContentIndexer::UNCHANGED:
+                unchanged++;
+                break;
+            case ContentIndexer::FAILED:
+                Serial.printf("  cannot list %s\r\n", full);
+                break;
+            case ContentIndexer::STOPPED:
+                break;
+            }
+        }
+    }
+
+    sqlite3_finalize(page_stmt);
+    vTaskPrioritySet(nullptr, priority);
+
+    Serial.printf("updatedb: %d containers indexed (%d entries), %d unchanged",
+                  (int)s_scan_containers, (int)s_scan_entries, unchanged);
+    if (indexer.truncated())
+        Serial.printf(", %u listings cut short by the memory budget", (unsigned)indexer.truncated());
+    Serial.printf("\r\n");
+}
+
 static void updatedb_compress_gz(void);
 
 // Rebuild the FTS5 index from the existing files+dirs tables.
@@ -1449,11 +1694,14 @@ static void updatedb_run(void)
             "DROP TABLE IF EXISTS files_fts;"
             "DROP TABLE IF EXISTS files;"
             "DROP TABLE IF EXISTS dirs;"
+            "DROP TABLE IF EXISTS containers;"
             // dirs: one row per unique directory path; scanned=1 once all children are indexed.
+            // container=1 for the inside of a disk image or archive ("/games/collection.zip").
             "CREATE TABLE dirs ("
-            "  id      INTEGER PRIMARY KEY,"
-            "  path    TEXT    NOT NULL UNIQUE,"
-            "  scanned INTEGER NOT NULL DEFAULT 0"
+            "  id        INTEGER PRIMARY KEY,"
+            "  path      TEXT    NOT NULL UNIQUE,"
+            "  scanned   INTEGER NOT NULL DEFAULT 0,"
+            "  container INTEGER NOT NULL DEFAULT 0"
             ");"
             // files: every entry (file or subdir) stored under its parent dir_id.
             // UNIQUE(dir_id,name) lets INSERT OR REPLACE handle re-scans cleanly.
@@ -1464,9 +1712,11 @@ static void updatedb_run(void)
             "  size    INTEGER NOT NULL DEFAULT 0,"
             "  mtime   INTEGER NOT NULL DEFAULT 0,"
             "  is_dir  INTEGER NOT NULL DEFAULT 0,"
+            "  type    TEXT    NOT NULL DEFAULT '',"
             "  UNIQUE(dir_id, name)"
             ");"
             "CREATE INDEX files_dir_idx ON files(dir_id);"
+            CONTAINERS_SCHEMA ";"
             // FTS5 with content='' stores only the inverted token index, not the
             // original text — the full path is reconstructed via JOIN at query time.
             "CREATE VIRTUAL TABLE files_fts USING fts5("
@@ -1521,6 +1771,8 @@ static void updatedb_run(void)
             }
         }
 
+        updatedb_migrate(db);
+
         // Migrate: add status table if absent.
         sqlite3_exec(db,
             "CREATE TABLE IF NOT EXISTS status ("
@@ -1537,7 +1789,7 @@ static void updatedb_run(void)
         {
             sqlite3_stmt *q = nullptr;
             if (sqlite3_prepare_v2(db,
-                    "SELECT path FROM dirs WHERE scanned=1",
+                    "SELECT path FROM dirs WHERE scanned=1 AND container=0",
                     -1, &q, nullptr) == SQLITE_OK) {
                 while (sqlite3_step(q) == SQLITE_ROW) {
                     const char *p = (const char *)sqlite3_column_text(q, 0);
@@ -1611,6 +1863,8 @@ static void updatedb_run(void)
     }
     updatedb_scan(db, dir_ins_stmt, dir_id_stmt, file_ins_stmt, mark_stmt,
                   std::move(initial_dirs), skip_dirs);
+    if (!s_scan_stop)
+        updatedb_content_scan(db);
 
     // Commit whatever the last partial batch left in-transaction.
     if (!sqlite3_get_autocommit(db)) {
@@ -1664,8 +1918,9 @@ static void updatedb_run(void)
         Serial.printf("updatedb: stopped — %d directories, %d files, last folder: %s\r\n",
                       (int)s_scan_dirs, (int)s_scan_files, s_scan_last_folder.c_str());
     else
-        Serial.printf("updatedb: done — %d directories, %d files, %d errors, %s.\r\n",
+        Serial.printf("updatedb: done — %d directories, %d files, %d inside %d containers, %d errors, %s.\r\n",
                       (int)s_scan_dirs, (int)s_scan_files,
+                      (int)s_scan_entries, (int)s_scan_containers,
                       (int)s_scan_errors, mstr::formatDuration(s_scan_end - s_scan_start).c_str());
 
     // Restore explicitly rather than relying on updatedb_fts_rebuild() having
@@ -1676,6 +1931,41 @@ static void updatedb_run(void)
     return;
 }
 
+// "updatedb deep": only the content pass, over the database as it stands.
+// Containers whose size and mtime have not changed are skipped, so after
+// copying a few images to the card this is seconds rather than a full scan.
+static void updatedb_deep_run(void)
+{
+    sqlite_one_time_init();
+    sqlite3_esp32_psram_malloc_enter();
+
+    sqlite3 *db = nullptr;
+    if (sqlite3_open_v2(LOCATE_DB_PATH, &db, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+        Serial.printf("updatedb: cannot open database: %s\r\n",
+                      db ? sqlite3_errmsg(db) : "out of memory");
+        if (db) sqlite3_close(db);
+        s_scan_running = 0;
+        sqlite3_esp32_psram_malloc_exit();
+        return;
+    }
+    apply_pragmas(db);
+    updatedb_migrate(db);
+
+    sqlite3_exec(db, "BEGIN", nullptr, nullptr, nullptr);
+    updatedb_content_scan(db);
+    if (!sqlite3_get_autocommit(db))
+        sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr);
+    sqlite3_close(db);
+
+    // Nothing new: the FTS index already covers every row.
+    if (!s_scan_stop && s_scan_containers > 0)
+        updatedb_fts_rebuild();
+
+    s_scan_end = time(nullptr);
+    s_scan_running = 0;
+    sqlite3_esp32_psram_malloc_exit();
+}
+
 int updatedb(int argc, char **argv)
 {
     // -- updatedb status -- persistent status read back from the database ----
@@ -1684,6 +1974,9 @@ int updatedb(int argc, char **argv)
             time_t elapsed = time(nullptr) - s_scan_start;
             Serial.printf("Scan in progress: %d directories, %d files (%s elapsed)\r\n",
                           (int)s_scan_dirs, (int)s_scan_files, mstr::formatDuration(elapsed).c_str());
+            if (s_scan_containers > 0)
+                Serial.printf("Containers:       %d indexed, %d entries\r\n",
+                              (int)s_scan_containers, (int)s_scan_entries);
             if (!s_scan_last_folder.empty())
                 Serial.printf("Last folder:      /sd%s\r\n", s_scan_last_folder.c_str());
             return EXIT_SUCCESS;
@@ -1754,6 +2047,8 @@ int updatedb(int argc, char **argv)
         s_scan_files        = 0;
         s_scan_dirs         = 0;
         s_scan_errors       = 0;
+        s_scan_containers   = 0;
+        s_scan_entries      = 0;
         s_scan_stop         = 0;
         s_scan_resume       = 1;
         s_scan_start        = time(nullptr);
@@ -1781,6 +2076,8 @@ int updatedb(int argc, char **argv)
         s_scan_files        = 0;
         s_scan_dirs         = 0;
         s_scan_errors       = 0;
+        s_scan_containers   = 0;
+        s_scan_entries      = 0;
         s_scan_stop         = 0;
         s_scan_resume       = 0;
         s_scan_start        = time(nullptr);
@@ -1792,6 +2089,33 @@ int updatedb(int argc, char **argv)
         return EXIT_SUCCESS;
     }
 
+    // ── updatedb deep ────────────────────────────────────────────────────────
+    if (argc > 1 && strcmp(argv[1], "deep") == 0) {
+        if (!fnSDFAT.running()) {
+            Serial.printf("updatedb: SD card not mounted\r\n");
+            return EXIT_FAILURE;
+        }
+        if (s_scan_running) {
+            Serial.printf("updatedb: scan already in progress — wait for it to finish\r\n");
+            return EXIT_FAILURE;
+        }
+        struct stat dbst;
+        if (stat(LOCATE_DB_PATH, &dbst) != 0) {
+            Serial.printf("updatedb: no database — run 'updatedb start' first\r\n");
+            return EXIT_FAILURE;
+        }
+        s_scan_errors       = 0;
+        s_scan_containers   = 0;
+        s_scan_entries      = 0;
+        s_scan_stop         = 0;
+        s_scan_start        = time(nullptr);
+        s_scan_end          = 0;
+        s_scan_running      = 1;
+        Serial.printf("Re-indexing changed disk images and archives (console blocked; 'updatedb stop' to cancel)...\r\n");
+        updatedb_deep_run();   // on console_exec's stack - see the comment above
+        return EXIT_SUCCESS;
+    }
+
     // ── updatedb fts ─────────────────────────────────────────────────────────
     if (argc > 1 && strcmp(argv[1], "fts") == 0) {
         if (!fnSDFAT.running()) {
@@ -1813,7 +2137,7 @@ int updatedb(int argc, char **argv)
         return EXIT_SUCCESS;
     }
 
-    Serial.printf("Usage: updatedb [start|status|stop|resume|fts]  (no argument = start)\r\n");
+    Serial.printf("Usage: updatedb [start|status|stop|resume|deep|fts]  (no argument = start)\r\n");
     return EXIT_FAILURE;
 }
 
@@ -2431,7 +2755,7 @@ namespace ESP32Console::Commands
 
     const ConsoleCommand getWgetCommand()
     {
-        return ConsoleCommand("wget", &wget, "Download url to file (-k skips TLS cert verification)");
+        return ConsoleCommand("wget", &wget, "Download url to file (-k skips TLS cert verification, -c resumes a partial file)");
     }
 
     const ConsoleCommand getUpdateCommand()
@@ -2466,7 +2790,7 @@ namespace ESP32Console::Commands
     const ConsoleCommand getUpdatedbCommand()
     {
         return ConsoleCommand("updatedb", &updatedb,
-            "Build the locate database from the SD card. Usage: updatedb [start|status|stop|resume|fts]");
+            "Build the locate database from the SD card. Usage: updatedb [start|status|stop|resume|deep|fts]");
     }
 
     const ConsoleCommand getLocateCommand()
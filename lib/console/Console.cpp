@@ -180,6 +180,7 @@ namespace ESP32Console
         registerCommand(getSysInfoCommand());
         registerCommand(getMemInfoCommand());
         registerCommand(getTaskInfoCommand());
+        registerCommand(getJobInfoCommand());
         registerCommand(getDateCommand());
         registerCommand(getConfigCommand());
     }
@@ -481,8 +482,9 @@ namespace ESP32Console
         auto session = SessionBroker::find<MSession>(ConsoleExecMSession::sessionKey());
         if (session == nullptr)
         {
-            session = std::make_shared<ConsoleExecMSession>(this);
-            SessionBroker::add(ConsoleExecMSession::sessionKey(), session);
+            // another task may have registered one first; add() returns it
+            session = SessionBroker::add(ConsoleExecMSession::sessionKey(),
+                                         std::make_shared<ConsoleExecMSession>(this));
         }
         return session;
     }
@@ -7,6 +7,7 @@
 
 #include "../Console.h"
 #include "../Commands/IECCommands.h"
+#include "meat_lease.h"
 
 #include <mutex>
 
@@ -16,9 +17,12 @@ namespace ESP32Console
 
     MFile* currentPath = nullptr;
 
-    // Guards currentPath replacement vs. cross-task readers (SessionBroker)
+    // Guards currentPath replacement vs. cross-task readers
     static std::mutex s_path_mutex;
 
+    // Keeps what the console is working in cached, as a drive's does
+    static MLease s_lease;
+
     MFile* getCurrentPath() {
         if(currentPath == nullptr) {
             currentPath = MFSOwner::File("/");
@@ -37,6 +41,7 @@ namespace ESP32Console
             std::lock_guard<std::mutex> lock(s_path_mutex);
             old = currentPath;
             currentPath = path;
+            s_lease.hold(url);
         }
         // Delete outside the lock: media MFile destructors can do real work
         if (old != nullptr && old != path)
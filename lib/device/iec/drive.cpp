@@ -59,6 +59,14 @@
 // To be safe, BUFFER_SIZE should always be >=256
 #define BUFFER_SIZE 512
 
+// Read-ahead for LOAD/GET# channels: how many BUFFER_SIZE chunks the producer
+// task may hold ready beyond the one being clocked out, and its stack. The
+// stack has to carry a full stream read -- down through a media image into
+// esp_http_client and mbedTLS for an HTTPS container.
+#define READ_AHEAD_CHUNKS    3
+#define READ_AHEAD_STACKSIZE 12288
+#define READ_AHEAD_PRIORITY  5
+
 static inline void *psram_malloc(size_t sz) {
     void *p = heap_caps_malloc(sz, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
     return p ? p : malloc(sz);
@@ -146,6 +154,7 @@ uint8_t iecChannelHandler::read(uint8_t *data, uint8_t n)
 
         m_ptr = 0;
         m_len = 0;
+        m_lent = nullptr;
 
         uint8_t st = readBufferData();
         if( st!=ST_OK )
@@ -167,10 +176,11 @@ uint8_t iecChannelHandler::read(uint8_t *data, uint8_t n)
     // read data from buffer
     if( m_ptr < m_len )
     {
+        const uint8_t *src = m_lent ? m_lent : m_data;
         if( n==1 )
         {
             // common case during regular (non-fastloader) load
-            data[0] = m_data[m_ptr++];
+            data[0] = src[m_ptr++];
             m_position++;
             return 1;
         }
@@ -178,7 +188,7 @@ uint8_t iecChannelHandler::read(uint8_t *data, uint8_t n)
         {
             // copy as much data as possible
             n = std::min((size_t) n, (size_t) (m_len - m_ptr));
-            memcpy(data, m_data + m_ptr, n);
+            memcpy(data, src + m_ptr, n);
             m_ptr += n;
             m_position += n;
             return n;
@@ -193,6 +203,9 @@ uint8_t iecChannelHandler::read(uint8_t *data, uint8_t n)
 
 uint8_t iecChannelHandler::write(uint8_t *data, uint8_t n)
 {
+    // Writes build up in m_data; whatever a read borrowed is no longer current
+    m_lent = nullptr;
+
     // if buffer is full then empty it
     if( m_len+n > BUFFER_SIZE )
     {
@@ -240,6 +253,14 @@ iecChannelHandlerFile::iecChannelHandlerFile(iecDrive *drive, std::shared_ptr<MS
 
 iecChannelHandlerFile::~iecChannelHandlerFile()
 {
+    // The producer must be out of m_stream before anything below touches it.
+    stopReadAhead();
+    for( auto &c : m_chunks )
+        free(c.data);
+    if( m_free )   vSemaphoreDelete(m_free);
+    if( m_filled ) vSemaphoreDelete(m_filled);
+    if( m_idle )   vSemaphoreDelete(m_idle);
+
     double seconds = (esp_timer_get_time()-m_timeStart) / 1000000.0;
 
     if( m_stream->mode == std::ios_base::out && m_len>0 )
@@ -310,6 +331,7 @@ uint8_t iecChannelHandlerFile::write(uint8_t *data, uint8_t n) {
         // internal _responseBufPos — stale m_data bytes must be discarded.
         m_ptr = 0;
         m_len = 0;
+        m_lent = nullptr;
         m_eos = false;
         // Zero the buffer so stale "Co" bytes from a prior response
         // can't leak into the next readBufferData refill.
@@ -345,6 +367,200 @@ uint8_t iecChannelHandlerFile::writeBufferData()
 }
 
 
+// Fill one buffer from the stream: as many reads as it takes to get
+// BUFFER_SIZE bytes or reach the end. Runs on the IEC task when reading
+// synchronously and on the read-ahead task otherwise -- never on both at once.
+uint8_t iecChannelHandlerFile::fillChunk(uint8_t *data, uint32_t &len)
+{
+    len = 0;
+    do
+    {
+        uint32_t got = m_stream->read(data+len, BUFFER_SIZE-len);
+
+        if (got == 0) {
+            // Network streams in full-mode HTTP may return 0 when a
+            // mode region is exhausted (headers done, body waiting).
+            // Just break — the C64's next mode-switch command will
+            // clear m_eos and trigger a fresh refill.
+            break;
+        }
+        len += got;
+
+        // if m_fixLoadAddress is set, adjust the first two bytes
+        if( m_fixLoadAddress>=0 && m_stream->position()==0 && len>=2 )
+        {
+            data[0] = (m_fixLoadAddress & 0x00FF);
+            data[1] = (m_fixLoadAddress & 0xFF00) >> 8;
+            m_fixLoadAddress = -1;
+        }
+
+        if (m_stream->error()) {
+            Debug_printv("Error: read failed: got[%d]", got);
+            return ST_DRIVE_NOT_READY;
+        }
+    } while( len<BUFFER_SIZE && !m_stream->eos() );
+
+    return ST_OK;
+}
+
+
+// Borrowing is the read-ahead rules less the size one (below): lent
+// memory is read-only, so no load-address fix, and it ignores the size a
+// block window imposes, so no direct-access channel either.
+bool iecChannelHandlerFile::lendEligible()
+{
+    return !(m_stream->mode & std::ios_base::out) &&
+           m_fixLoadAddress < 0 &&
+           !m_has_block;
+}
+
+
+// Reading ahead is only safe where nothing but this channel's reads moves the
+// stream, and only worth a task where there is more than a buffer to read:
+//   - read-only: a read-write stream (full-mode HTTP) answers PRINT#
+//     commands, and its data depends on what was written last.
+//   - no load-address fix: fillChunk() applies it by stream position.
+//   - not a direct-access block window: B-R/U1 redefine the readable extent
+//     per block, and a block is a single buffer anyway.
+//   - a known size: unknown-length streams (TCP, IRC, WebSocket) are
+//     interactive, and reading ahead would consume input early.
+// startReadAhead() adds the last rule: the stream must be this channel's
+// alone (ImageBroker::checkout()). An image stream is shared by every drive,
+// WebDAV and the console reading that image, and the producer must not move
+// it under them.
+bool iecChannelHandlerFile::readAheadEligible()
+{
+    return !m_aheadFailed &&
+           !(m_stream->mode & std::ios_base::out) &&
+           m_fixLoadAddress < 0 &&
+           !m_has_block &&
+           m_stream->size() > BUFFER_SIZE;
+}
+
+
+// The producer. Owns m_stream from startReadAhead() until it exits; fills
+// free slots in order and hands each one to the IEC task through m_filled.
+// A chunk that ends the stream (short, empty or failed) is the last one; a
+// stream that ends exactly on a chunk boundary is followed by an empty chunk,
+// the same extra 0-byte read the synchronous path makes.
+void iecChannelHandlerFile::readAheadTask(void *arg)
+{
+    auto *self = (iecChannelHandlerFile *) arg;
+
+    for(;;)
+    {
+        xSemaphoreTake(self->m_free, portMAX_DELAY);
+        if( self->m_stop )
+            break;
+
+        ReadAheadChunk &c = self->m_chunks[self->m_tail];
+        c.status = self->fillChunk(c.data, c.len);
+        self->m_tail = (self->m_tail + 1) % self->m_chunks.size();
+        xSemaphoreGive(self->m_filled);
+
+        if( c.status != ST_OK || c.len < BUFFER_SIZE )
+            break;
+    }
+
+    xSemaphoreGive(self->m_idle);
+    vTaskDelete(NULL);
+}
+
+
+bool iecChannelHandlerFile::startReadAhead()
+{
+    if( m_chunks.empty() )
+    {
+        for( int i = 0; i < READ_AHEAD_CHUNKS; i++ )
+        {
+            uint8_t *data = (uint8_t *) psram_malloc(BUFFER_SIZE);
+            if( data == nullptr )
+                break;
+            m_chunks.push_back({ data, 0, ST_OK });
+        }
+        if( m_chunks.size() < 2 )
+        {
+            m_aheadFailed = true;
+            return false;
+        }
+    }
+
+    // Not m_aheadFailed: whoever else holds the stream may let it go, and
+    // the next refill asks again.
+    if( !ImageBroker::checkout(m_stream) )
+        return false;
+
+    // Taken while nothing reads the stream: a read may refine size() (a D64
+    // chain learns its exact length at its last block), so the IEC task does
+    // not ask the stream again while the producer owns it.
+    m_aheadSize = m_stream->size();
+
+    // Fresh semaphores per run: a stop leaves m_free with an extra count.
+    if( m_free )   vSemaphoreDelete(m_free);
+    if( m_filled ) vSemaphoreDelete(m_filled);
+    if( m_idle )   vSemaphoreDelete(m_idle);
+    m_free   = xSemaphoreCreateCounting(m_chunks.size(), m_chunks.size());
+    m_filled = xSemaphoreCreateCounting(m_chunks.size(), 0);
+    m_idle   = xSemaphoreCreateBinary();
+    m_head = m_tail = 0;
+    m_stop = false;
+
+    // Core 0, below the bus: the reads are network/SD work and must never
+    // compete with the IEC task's timing on core 1.
+    if( m_free == nullptr || m_filled == nullptr || m_idle == nullptr ||
+        xTaskCreatePinnedToCore(readAheadTask, "iec_readahead", READ_AHEAD_STACKSIZE, this,
+                                READ_AHEAD_PRIORITY, &m_task, 0) != pdTRUE )
+    {
+        Debug_printv("Could not start read-ahead task, reading synchronously");
+        ImageBroker::checkin(m_stream);
+        m_task = nullptr;
+        m_aheadFailed = true;
+        return false;
+    }
+    return true;
+}
+
+
+// Stop the producer and wait until it is out of m_stream. A read already in
+// progress is allowed to finish -- MStream has no way to abandon one -- and
+// whatever it filled stays queued, still valid: the stream sits right after
+// it. Chunks are dropped only when the stream is moved (discardReadAhead()).
+void iecChannelHandlerFile::stopReadAhead()
+{
+    if( m_task == nullptr )
+        return;
+
+    m_stop = true;
+    xSemaphoreGive(m_free);
+    xSemaphoreTake(m_idle, portMAX_DELAY);
+    m_task = nullptr;
+    ImageBroker::checkin(m_stream);
+}
+
+
+void iecChannelHandlerFile::discardReadAhead()
+{
+    stopReadAhead();
+    if( m_filled )
+        while( xSemaphoreTake(m_filled, 0) == pdTRUE );
+    m_head = m_tail = 0;
+}
+
+
+std::shared_ptr<MStream> iecChannelHandlerFile::acquireStream()
+{
+    stopReadAhead();
+    return m_stream;
+}
+
+
+void iecChannelHandlerFile::repositioned(size_t position)
+{
+    discardReadAhead();
+    iecChannelHandler::repositioned(position);
+}
+
+
 uint8_t iecChannelHandlerFile::readBufferData()
 {
     /*
@@ -353,6 +569,73 @@ uint8_t iecChannelHandlerFile::readBufferData()
         return ST_FILE_TYPE_MISMATCH;
     else
     */
+
+    bool queued = m_filled != nullptr && uxSemaphoreGetCount(m_filled) > 0;
+
+    // A resident stream (RAM-cached file) hands out its own memory: the bus
+    // reads straight from it, with no copy and no read-ahead task to feed.
+    if( m_task == nullptr && !queued && lendEligible() )
+    {
+        const uint8_t *lent;
+        uint32_t len = m_stream->borrow(lent, BUFFER_SIZE);
+        if( len > 0 || m_lends )
+        {
+            fnLedManager.toggle(eLed::LED_BUS);
+            m_lends = true;
+            m_lent = lent;
+            m_len = len;
+            m_byteCount += len;
+            if( len == 0 )
+                m_eos = true;
+            return ST_OK;
+        }
+    }
+
+    if( m_task == nullptr && !queued && readAheadEligible() )
+        queued = startReadAhead();
+
+    if( m_task != nullptr || queued )
+    {
+        // Asynchronous path: the stream belongs to the producer, so nothing
+        // here may query it, not even size(); progress uses the copy
+        // startReadAhead() took.
+#ifdef ENABLE_DISPLAY
+        if( m_aheadSize > 0 )
+            LEDS.progress = (m_position * 100) / m_aheadSize;
+#endif
+        fnLedManager.toggle(eLed::LED_BUS);
+
+        // Only the time the bus actually stood waiting counts as transport:
+        // with the producer keeping up this goes to zero, and the two rates
+        // in the close log converge.
+        uint64_t t = esp_timer_get_time();
+        xSemaphoreTake(m_filled, portMAX_DELAY);
+        m_transportTimeUS += (esp_timer_get_time()-t);
+
+        // Swap buffers rather than copy: the slot takes the one the bus just
+        // finished with.
+        ReadAheadChunk &c = m_chunks[m_head];
+        std::swap(m_data, c.data);
+        m_len = c.len;
+        uint8_t st = c.status;
+        bool last = st != ST_OK || c.len < BUFFER_SIZE;
+        m_head = (m_head + 1) % m_chunks.size();
+        xSemaphoreGive(m_free);
+
+        // The producer exits after the last chunk; reap it so the next read
+        // (after a reposition) can start a new one.
+        if( last )
+            stopReadAhead();
+
+        if( st != ST_OK )
+            return st;
+
+        m_byteCount += m_len;
+        if( m_len == 0 )
+            m_eos = true;
+        return ST_OK;
+    }
+
     {
         //Debug_printv("size[%lu] avail[%lu] pos[%lu] eos[%d] error[%d] m_len=%d m_eos=%d", m_stream->size(), m_stream->available(), m_stream->position(), m_stream->eos(), m_stream->error(), m_len, m_eos);
         Debug_printv("size[%lu] avail[%lu] pos[%lu]", m_stream->size(), m_stream->available(), m_stream->position());
@@ -376,35 +659,13 @@ uint8_t iecChannelHandlerFile::readBufferData()
         fnLedManager.toggle(eLed::LED_BUS);
 
         // try to fill buffer
-        m_len = 0;
-        do 
-        {
-            uint64_t t = esp_timer_get_time();
-            uint32_t got = m_stream->read(m_data+m_len, BUFFER_SIZE-m_len);
-            m_transportTimeUS += (esp_timer_get_time()-t);
-
-            if (got == 0) {
-                // Network streams in full-mode HTTP may return 0 when a
-                // mode region is exhausted (headers done, body waiting).
-                // Just break — the C64's next mode-switch command will
-                // clear m_eos and trigger a fresh refill.
-                break;
-            }
-            m_len += got;
-
-            // if m_fixLoadAddress is set, adjust the first two bytes
-            if( m_fixLoadAddress>=0 && m_stream->position()==0 && m_len>=2 )
-            {
-                m_data[0] = (m_fixLoadAddress & 0x00FF);
-                m_data[1] = (m_fixLoadAddress & 0xFF00) >> 8;
-                m_fixLoadAddress = -1;
-            }
-
-            if (m_stream->error()) {
-                Debug_printv("Error: read failed: got[%d]", got);
-                return ST_DRIVE_NOT_READY;
-            }
-        } while( m_len<BUFFER_SIZE && !m_stream->eos() );
+        uint64_t t = esp_timer_get_time();
+        uint32_t len = 0;
+        uint8_t st = fillChunk(m_data, len);
+        m_transportTimeUS += (esp_timer_get_time()-t);
+        m_len = len;
+        if( st != ST_OK )
+            return st;
 
         m_byteCount += m_len;
 
@@ -534,9 +795,8 @@ uint8_t iecChannelHandlerDir::readBufferData()
         std::string name = m_dir->media_header.size() ? m_dir->media_header : "meatloaf cbm";
         if ( !m_dir->isCBM )
             name = U8Char::encodeACE(name);
-        name = mstr::toPETSCII2( name );
-        size_t n = std::min(16, (int) name.size());
-        memcpy(m_data+8, name.data(), n);
+        // Transcoded straight into the 16 byte field
+        size_t n = U8Char::utf8ToPetscii(name.data(), name.size(), m_data+8, 16);
         while( n<16 ) { m_data[8+n] = ' '; n++; }
         m_data[24] = '"';
         m_data[25] = ' ';
@@ -1469,7 +1729,7 @@ bool iecDrive::positionChannel(uint32_t chan, uint32_t pos, bool within_block)
     }
 
     // A directory channel generates its listing and has no stream.
-    auto stream = channel->getStream();
+    auto stream = channel->acquireStream();
     if( stream == nullptr )
     {
         setStatusCode(ST_SYNTAX_INVALID);
@@ -1560,7 +1820,7 @@ bool iecDrive::seekChannelToBlock(uint8_t channel_num, uint8_t track, uint8_t se
     }
 
     // A directory channel generates its listing and has no stream.
-    auto stream = channel->getStream();
+    auto stream = channel->acquireStream();
     if( stream == nullptr )
     {
         setStatusCode(ST_SYNTAX_INVALID);
@@ -2387,11 +2647,12 @@ void iecDrive::executeData(const uint8_t *data, uint8_t dataLen)
                 }
                 Debug_printv("position channel[%d] hi[%d] mid[%d] low[%d]", pti[0], pti[1], pti[2], pti[3]);
                 auto channel = m_channels[(uint8_t)pti[0]];
-                if ( channel != nullptr )
+                if ( channel != nullptr && channel->getStream() != nullptr )
                 {
-                    auto stream = channel->getStream();
+                    auto stream = channel->acquireStream();
                     uint32_t pos = (pti[1] * 65536) + (pti[2] * 256) + pti[3];
-                    stream->seek( pos );
+                    if ( stream->seek( pos ) )
+                        channel->repositioned( pos );
                 }
                 else
                 {
@@ -3093,6 +3354,7 @@ void iecDrive::set_cwd(std::string path, bool verified)
         MFile *n = MFSOwner::File(path);
         if (n != nullptr) {
             m_cwd.reset(n);
+            m_lease.hold(m_cwd->url);
             setStatusCode(ST_OK);
             persistConfig();
             notify_activity(activitySource(), "path", m_cwd->url);
@@ -3166,6 +3428,8 @@ void iecDrive::set_cwd(std::string path, bool verified)
     else
         setStatusCode(ST_SYNTAX_INVALID);
 
+    m_lease.hold(m_cwd->url);
+
     // Don't persist if new working directory is OTHER
     // QR://, HASH://, etc. are not persistent across reboots
     if (m_cwd->type != MFILE_OTHER)
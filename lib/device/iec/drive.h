@@ -27,6 +27,9 @@
 #include <vector>
 #include <esp_rom_crc.h>
 #include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 
 #include "../../bus/iec/IECFileDevice.h"
 #define SystemFileDevice IECFileDevice
@@ -35,6 +38,7 @@
 #include "drive/ram.h"
 #include "../../media/media.h"
 #include "../meatloaf/meatloaf.h"
+#include "meat_lease.h"
 #include "../meatloaf/meat_buffer.h"
 #include "../meatloaf/wrapper/iec_buffer.h"
 #include "../meatloaf/wrapper/directory_stream.h"
@@ -64,6 +68,11 @@ public:
   virtual uint8_t readBufferData()  = 0;
   virtual std::shared_ptr<MStream> getStream() { return nullptr; };
 
+  // getStream() for a caller about to seek or read the stream itself (B-P,
+  // B-R, U1, P). A handler that reads the stream from another task must
+  // stop doing so first; everything else just hands the stream over.
+  virtual std::shared_ptr<MStream> acquireStream() { return getStream(); }
+
   // What this channel has open, for the console "channels" listing.  Set by
   // iecDrive::open() from the MFile's fullUrl(), because the stream cannot
   // answer it: MStream carries only `url`, which for anything inside a
@@ -96,10 +105,11 @@ public:
   // Note this drops anything pending in a BUFFERED write (the
   // iecChannelHandler::write() path). The file handler writes straight
   // through, so in practice there is nothing to lose.
-  void repositioned(size_t position)
+  virtual void repositioned(size_t position)
   {
     m_ptr = 0;
     m_len = 0;
+    m_lent = nullptr;
     m_eos = false;
     m_position = position;
   }
@@ -141,6 +151,9 @@ public:
 protected:
   iecDrive *m_drive;
   uint8_t  *m_data;
+  // When set, read() serves m_len bytes from here instead of m_data: memory
+  // the stream lent (MStream::borrow()), so a resident file is not copied.
+  const uint8_t *m_lent = nullptr;
   size_t    m_len, m_ptr;
   size_t    m_position = 0;
   uint32_t  m_block_base = 0;
@@ -161,12 +174,45 @@ public:
   virtual uint8_t writeBufferData();
   virtual uint8_t write(uint8_t *data, uint8_t n) override;
   virtual std::shared_ptr<MStream> getStream() override { return m_stream; };
+  virtual std::shared_ptr<MStream> acquireStream() override;
+  virtual void repositioned(size_t position) override;
 
 private:
   std::shared_ptr<MStream> m_stream;
   int       m_fixLoadAddress;
   uint32_t  m_byteCount;
   uint64_t  m_timeStart, m_transportTimeUS;
+
+  // Read-ahead: a producer task fills chunks from m_stream while the bus
+  // clocks out the current one. See readAheadTask() in drive.cpp.
+  struct ReadAheadChunk
+  {
+    uint8_t *data;
+    uint32_t len;
+    uint8_t  status;
+  };
+
+  static void readAheadTask(void *arg);
+  bool    lendEligible();
+  bool    readAheadEligible();
+  bool    startReadAhead();
+  void    stopReadAhead();
+  void    discardReadAhead();
+  uint8_t fillChunk(uint8_t *data, uint32_t &len);
+
+  // The stream lends its memory (a RAM-cached file): refills borrow instead
+  // of reading, and need neither the copy nor the read-ahead task.
+  bool      m_lends = false;
+
+  std::vector<ReadAheadChunk> m_chunks;
+  size_t            m_head = 0, m_tail = 0;      // consumer / producer slot
+  SemaphoreHandle_t m_free = nullptr;            // slots the producer may fill
+  SemaphoreHandle_t m_filled = nullptr;          // slots waiting for the bus
+  SemaphoreHandle_t m_idle = nullptr;            // given once as the task exits
+  TaskHandle_t      m_task = nullptr;
+  volatile bool     m_stop = false;
+  bool              m_aheadFailed = false;       // task could not be created
+  uint32_t          m_aheadSize = 0;             // m_stream->size() at start
 };
 
 
@@ -327,6 +373,7 @@ protected:
   void tapeCommand(std::string command);  // "T-C"/"T-I" on a mounted tape image
 
   std::unique_ptr<MFile> m_cwd;   // current working directory
+  MLease m_lease;                 // keeps m_cwd's image and session cached
   iecChannelHandler *m_channels[16];
   uint8_t m_statusCode, m_statusTrk, m_statusSec, m_numOpenChannels;
   std::string m_statusMessage;   // when non-empty, replaces getStatus()'s canned text
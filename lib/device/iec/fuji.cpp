@@ -28,6 +28,7 @@
 #include "utils.h"
 #include "status_error_codes.h"
 #include "display.h"
+#include "meat_copy.h"
 
 #define ADDITIONAL_DETAILS_BYTES 10
 #define FF_DIR 0x01
@@ -986,55 +987,24 @@ void iecFuji::copy_file(std::string source, std::string destination)
         out_file.reset(MFSOwner::File(destination));
     }
 
-    // Create streams and copy file
-    {
-        auto in_stream = in_file->getSourceStream(std::ios_base::in);
-        if (in_stream == nullptr)
-        {
-            Serial.printf("2 Error: Can't open source!\r\n");
-            set_fuji_iec_status(62, "can't open source stream");
-            return;
-        }
-
-        auto out_stream = out_file->getSourceStream(std::ios_base::out);
-        if (out_stream == nullptr)
-        {
-            Serial.printf("2 Error: Can't open destination!\r\n");
-            set_fuji_iec_status(62, "can't open destination stream");
-            return;
-        }
-
-        Debug_printv("size[%lu] name[%s] url[%s] destination[%s]", in_file->size, in_file->name.c_str(), in_stream->url.c_str(), destination.c_str());
-
-        // Receive File
-        int count = 0;
-        uint8_t bytes[255];
-        while (true)
-        {
-            int bytes_read = in_stream->read(bytes, 255);
-            if (bytes_read < 1)
-            {
-                if (in_stream->available())
-                    Serial.printf("\nError reading '%s'\r", in_file->name.c_str());
-                break;
-            }
-
-            int bytes_written = out_stream->write(bytes, bytes_read);
-            if (bytes_written != bytes_read)
-            {
-                Serial.printf("\nError writing '%s'\r", out_file->name.c_str());
-                break;
-            }
+    Debug_printv("size[%lu] name[%s] url[%s] destination[%s]", in_file->size, in_file->name.c_str(), in_file->url.c_str(), destination.c_str());
 
-            // Show percentage complete in stdout
-            uint8_t percent = (in_stream->position() * 100) / in_stream->size();
+    // Show percentage complete in stdout, a few times a second
+    MCopyOptions options;
+    options.progress = [&](const MCopyProgress &p) {
 #ifdef ENABLE_DISPLAY
-            LEDS.progress = percent;
+        LEDS.progress = p.percent();
 #endif
-            Serial.printf("Downloading '%s' %d%% [%lu]\r", in_file->name.c_str(), percent, in_stream->position());
-            count++;
-        }
-        Serial.printf("\n");
+        Serial.printf("Downloading '%s' %d%% [%lu]\r", in_file->name.c_str(), p.percent(), (unsigned long)p.copied);
+    };
+
+    MCopyResult result = MCopy::file(in_file.get(), out_file.get(), options);
+    Serial.printf("\n");
+    if (!result.ok())
+    {
+        Serial.printf("2 Error: %s!\r\n", result.message());
+        set_fuji_iec_status(62, result.message());
+        return;
     }
 
     set_fuji_iec_status(0, "");
@@ -110,6 +110,9 @@ void iecNetwork::iec_open()
         return;
     }
 
+    // Read no further ahead than the channel's ring can take
+    channel_data.protocol->receiveWindow = channel_data.receiveRing.capacity();
+
     // Set login and password if they exist
     if (!channel_data.login.empty()) {
         // TODO: Change the NetworkProtocol password and login to STRINGS FFS
@@ -162,7 +165,7 @@ void iecNetwork::iec_close()
     // Close protocol and clean up
     channel_data.protocol->close();
     channel_data.protocol = nullptr;
-    channel_data.receiveBuffer.clear();
+    channel_data.clearReceived();
     channel_data.transmitBuffer.clear();
     channel_data.specialBuffer.clear();
 
@@ -237,6 +240,8 @@ void iecNetwork::parse_json()
     channel = atoi(pt[1].c_str());
     auto& channel_data = network_data_map[channel];
 
+    // The parser reads what was received from the protocol's receiveBuffer
+    channel_data.unstageReceived();
     if (channel_data.protocol)
         channel_data.protocol->status(&ns);
 
@@ -285,7 +290,7 @@ void iecNetwork::query_json()
 
     // Clear stale data so the JSON query result isn't appended after
     // previously buffered bytes (e.g. "Co" from "Content-Type" header).
-    channel_data.receiveBuffer.clear();
+    channel_data.clearReceived();
 
     channel_data.json->setReadQuery(s, 0);
 
@@ -335,6 +340,8 @@ void iecNetwork::parse_bite()
         Debug_printv("bite_size[%d]", bite_size);
     }
 
+    // Bites are cut from everything received, read into the ring or not
+    channel_data.unstageReceived();
     if (channel_data.protocol)
         channel_data.protocol->status(&ns);
 
@@ -1030,8 +1037,7 @@ bool iecNetwork::transmit(NetworkData &channel_data)
     Debug_printf("Received %u bytes. Transmitting.", channel_data.transmitBuffer.length());
     
     channel_data.protocol->write(channel_data.transmitBuffer.length());
-    channel_data.transmitBuffer.clear();
-    channel_data.transmitBuffer.shrink_to_fit();
+    channel_data.transmitBuffer.clear();   // keeps its capacity for the next chunk
     return true;
 }
 
@@ -1052,22 +1058,16 @@ bool iecNetwork::receive(NetworkData &channel_data, uint16_t rxBytes)
         return false;
         }
     
-    // Get status
-    channel_data.protocol->status(&ns);
-    if( ns.rxBytesWaiting>0 )
+    // Get status, and read if the ring has room
+    if( !channel_data.receive(ns, rxBytes) )
         {
-        uint16_t blockSize = std::min(ns.rxBytesWaiting, rxBytes);
-        Debug_printf("bytes waiting: %u / blockSize: %u / connected: %u / error: %u ", ns.rxBytesWaiting, blockSize, ns.connected, ns.error);
-        if( channel_data.protocol->read(blockSize) )
-            {
-            // protocol adapter returned error
-            iecStatus.error = NETWORK_ERROR_GENERAL;
-            iecStatus.msg = "read error";
-            iecStatus.connected = ns.connected;
-            iecStatus.channel = commanddata.channel;
-            Debug_printv("Read Error");
-            return false;
-            }
+        // protocol adapter returned error
+        iecStatus.error = NETWORK_ERROR_GENERAL;
+        iecStatus.msg = "read error";
+        iecStatus.connected = ns.connected;
+        iecStatus.channel = commanddata.channel;
+        Debug_printv("Read Error");
+        return false;
         }
 
     return true;
@@ -1083,7 +1083,7 @@ uint8_t iecNetwork::write(uint8_t channel, uint8_t *buffer, uint8_t bufferSize,
     //int channelId = commanddata.channel;
     auto& channel_data = network_data_map[channel];
 
-    channel_data.transmitBuffer = string((char *) buffer, bufferSize);
+    channel_data.transmitBuffer.assign((char *) buffer, bufferSize);
     return transmit(channel_data) ? bufferSize : 0;
 }
 
@@ -1093,13 +1093,14 @@ uint8_t iecNetwork::read(uint8_t channel, uint8_t *buffer, uint8_t bufferSize, b
     //int channelId = commanddata.channel;
     auto& channel_data = network_data_map[channel];
 
-    if( channel_data.receiveBuffer.size() < bufferSize )
+    // A JSON query result lands in receiveBuffer without a protocol read
+    channel_data.stageReceived();
+
+    if( channel_data.receiveRing.size() < bufferSize )
         if( !receive(channel_data, 2048) )
         return 0;
 
-    uint8_t n = std::min((int) channel_data.receiveBuffer.size(), (int) bufferSize);
-    memcpy(buffer, channel_data.receiveBuffer.data(), n);
-    channel_data.receiveBuffer.erase(0, n);
+    uint8_t n = channel_data.receiveRing.read(buffer, bufferSize);
 
     //if( n>0 ) Debug_printv("iecNetwork::read(#%d, %d, %d)", m_devnr, channel, bufferSize);
     return n;
@@ -1167,6 +1168,8 @@ uint8_t iecNetwork::getStatusData(char *buffer, uint8_t bufferSize, bool *eoi)
 
         if (channel_data.channelMode == NetworkData::PROTOCOL) {
             channel_data.protocol->status(&ns);
+            // The protocol only counts what it has not handed to the ring
+            ns.rxBytesWaiting = std::min<size_t>(ns.rxBytesWaiting + channel_data.receiveRing.size(), 65535);
         } else {
             channel_data.json->status(&ns);
         }
@@ -1224,8 +1227,11 @@ void iecNetwork::task()
             auto& protocol = it->second.protocol;
             if( protocol && protocol->interruptEnable )
             {
-            protocol->status(&ns);
-            if( ns.rxBytesWaiting > 0 /*|| ns.connected == 0*/ )
+            // Data already in the ring needs no status call, and a full ring
+            // must not prompt the protocol to read more
+            if( it->second.receiveRing.empty() )
+                protocol->status(&ns);
+            if( ns.rxBytesWaiting > 0 || !it->second.receiveRing.empty() /*|| ns.connected == 0*/ )
                 {
                     sendSRQ();
                     nextSRQ = fnSystem.millis() + 10;
@@ -45,6 +45,14 @@
 #include "profiles/GraphicModes.h"
 #include "profiles/ColorSpaces.h"
 
+// Size of the quantizer's RGBA -> palette index lookup (see Quantizer.h):
+// 160 KB in PSRAM, 20 KB of internal heap without it.
+#ifdef CONFIG_SPIRAM
+#define RETROPIXELS_LOOKUP_BITS 15
+#else
+#define RETROPIXELS_LOOKUP_BITS 12
+#endif
+
 // External palette declarations
 extern Palette colodore;
 extern Palette pepto;
@@ -399,6 +407,7 @@ bool RetroPixelsMStream::convertImage()
         // Create quantizer and converter
         Debug_printv("Creating quantizer and converter...");
         Quantizer quantizer(palette, colorspaceWrapper);
+        quantizer.setLookupBits(RETROPIXELS_LOOKUP_BITS);
         Converter converter(quantizer);
         
         // Convert the image
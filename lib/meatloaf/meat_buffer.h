@@ -207,7 +207,10 @@ namespace Meat
                 // no more characters are available, size == 0.
                 // auto buffer = reader->read();
 
-                int readCount = mstream->read((uint8_t *)gbuffer, gbuffer_size);
+                // A resident stream lends its bytes and the get area points
+                // straight at them; anything else is read into gbuffer.
+                const uint8_t *data;
+                int readCount = mstream->readSpan(data, (uint8_t *)gbuffer, gbuffer_size);
 
                 //Debug_printv("meat buffer underflow, readCount=%d", readCount);
 
@@ -234,7 +237,8 @@ namespace Meat
 
                     // Debug_printv("--mfilebuf underflow, read bytes=%d--", readCount);
                     // beg, curr, end <=> eback, gptr, egptr
-                    this->setg(gbuffer, gbuffer, gbuffer + readCount);
+                    char *area = (char *)data;
+                    this->setg(area, area, area + readCount);
                 }
             }
             // eback = beginning of get area
@@ -351,10 +355,11 @@ namespace Meat
                 // !!!
 
                 std::streampos delta = __pos - currBuffStart;
-                // TODO - check if eback == gbuffer!!!
+                // eback, not gbuffer: the get area may be lent memory
                 // TODO - check if pbase == pbuffer!!!
-                this->setg(this->eback(), gbuffer + delta, this->egptr());
+                this->setg(this->eback(), this->eback() + delta, this->egptr());
                 this->setp(this->pbase(), pbuffer + delta);
+                __ret = __pos;
             }
             else if (mstream->seek(__pos))
             {
@@ -0,0 +1,443 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "meat_copy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+#include <esp_heap_caps.h>
+#ifndef TEST_NATIVE
+#include <esp_rom_crc.h>
+#endif
+
+#include "../task/fnScheduler.h"
+
+static inline void *psram_malloc(size_t sz) {
+    void *p = heap_caps_malloc(sz, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    return p ? p : malloc(sz);
+}
+
+static uint32_t elapsed_ms(std::chrono::steady_clock::time_point since)
+{
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - since).count();
+}
+
+const char *MCopyResult::message() const
+{
+    switch (status)
+    {
+    case OK:                return "ok";
+    case NO_SOURCE:         return "can't open source";
+    case NO_DESTINATION:    return "can't open destination";
+    case NO_MEMORY:         return "out of memory";
+    case READ_ERROR:        return "read failed";
+    case WRITE_ERROR:       return "write failed";
+    case VERIFY_FAILED:     return "verify failed";
+    }
+    return "?";
+}
+
+/********************************************************
+ * CRC-32
+ ********************************************************/
+
+#ifdef TEST_NATIVE
+namespace {
+
+// The IEEE polynomial, reflected, as the ROM's crc32_le and zlib use it
+struct Crc32Table
+{
+    uint32_t entry[256];
+};
+
+constexpr Crc32Table buildCrc32Table()
+{
+    Crc32Table t = {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        t.entry[i] = c;
+    }
+    return t;
+}
+
+constexpr Crc32Table crc32_table = buildCrc32Table();
+
+} // namespace
+#endif
+
+uint32_t MCopy::crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+#ifndef TEST_NATIVE
+    return esp_rom_crc32_le(crc, data, len);
+#else
+    crc = ~crc;
+    while (len--)
+        crc = crc32_table.entry[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+#endif
+}
+
+bool MCopy::crc(MStream *in, uint32_t &crc, uint32_t limit, uint32_t buffer_size)
+{
+    std::unique_ptr<uint8_t, decltype(&free)> buf((uint8_t *)psram_malloc(buffer_size), &free);
+    if (!buf)
+        return false;
+
+    while (limit > 0)
+    {
+        const uint8_t *data;
+        uint32_t n = in->readSpan(data, buf.get(), std::min(limit, buffer_size));
+        if (n == 0)
+            return false;
+        crc = crc32(crc, data, n);
+        limit -= n;
+    }
+    return true;
+}
+
+/********************************************************
+ * Copy
+ ********************************************************/
+
+namespace {
+
+// The two buffers and who holds them. The reader fills a slot and marks it
+// full; the writer empties it and marks it free again, in slot order.
+struct CopyPipe
+{
+    std::mutex mutex;
+    std::condition_variable changed;
+
+    uint8_t *buf[2] = { nullptr, nullptr };
+    const uint8_t *data[2] = { nullptr, nullptr };     // buf, or bytes the source lent
+    uint32_t len[2] = { 0, 0 };
+    bool full[2] = { false, false };
+
+    bool eof = false;           // the reader has queued its last slot
+    bool failed = false;        // a write came up short
+    bool writer_started = false;
+    bool writer_done = false;
+    uint32_t written = 0;
+
+    ~CopyPipe()
+    {
+        free(buf[0]);
+        free(buf[1]);
+    }
+};
+
+// Whoever claims the pipe first writes it: the writer job, or the reader
+// when the job is slow to start. Caller holds the mutex.
+bool claim(CopyPipe &pipe)
+{
+    if (pipe.writer_started)
+        return false;
+    pipe.writer_started = true;
+    return true;
+}
+
+// Empty the slots in order until the reader is done or a write fails
+void drain(CopyPipe &pipe, MStream *out)
+{
+    int slot = 0;
+    while (true)
+    {
+        std::unique_lock<std::mutex> lock(pipe.mutex);
+        pipe.changed.wait(lock, [&] { return pipe.full[slot] || pipe.eof; });
+        if (!pipe.full[slot])
+            break;
+        const uint8_t *data = pipe.data[slot];
+        uint32_t len = pipe.len[slot];
+        lock.unlock();
+
+        uint32_t n = out->write(data, len);
+
+        lock.lock();
+        pipe.written += n;
+        if (n != len)
+        {
+            pipe.failed = true;
+            pipe.changed.notify_all();
+            break;
+        }
+        pipe.full[slot] = false;
+        pipe.changed.notify_all();
+        slot ^= 1;
+    }
+
+    std::lock_guard<std::mutex> lock(pipe.mutex);
+    pipe.writer_done = true;
+    pipe.changed.notify_all();
+}
+
+// Two entries of one disk image, or an image and a file inside it, go
+// through the same container stream and its one position. A writer moving
+// that under the reader would scramble both, so such a copy runs in turns.
+bool sameContainer(const MStream *in, const MStream *out)
+{
+    auto inside = [](const std::string &outer, const std::string &inner) {
+        return inner.size() > outer.size() && inner[outer.size()] == '/' &&
+               inner.compare(0, outer.size(), outer) == 0;
+    };
+    if (in->url.empty() || out->url.empty())
+        return false;
+    return in->url == out->url || inside(in->url, out->url) || inside(out->url, in->url);
+}
+
+} // namespace
+
+MCopyResult MCopy::stream(MStream *in, MStream *out, const MCopyOptions &options,
+                          uint32_t resumed, uint32_t resumed_crc)
+{
+    MCopyResult result;
+    result.resumed = resumed;
+    result.crc = resumed_crc;
+    auto started = std::chrono::steady_clock::now();
+
+    uint32_t buffer_size = options.buffer_size ? options.buffer_size : MCOPY_BUFFER_SIZE;
+
+    // Shared with the writer job: one still queued when the copy is over
+    // (the reader claimed the pipe instead) runs later, finds it claimed
+    // and returns, and the pipe has to be there for it to look at
+    auto shared = std::make_shared<CopyPipe>();
+    CopyPipe &pipe = *shared;
+    pipe.buf[0] = (uint8_t *)psram_malloc(buffer_size);
+    pipe.buf[1] = (uint8_t *)psram_malloc(buffer_size);
+    if (!pipe.buf[0] || !pipe.buf[1])
+    {
+        result.status = MCopyResult::NO_MEMORY;
+        return result;
+    }
+
+    // The writer is a job; with no scheduler to run it, take turns instead
+    fnCancelToken writer;
+    auto write_job = [shared, out](fnJobContext &) {
+        {
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            if (!claim(*shared))
+                return;
+        }
+        drain(*shared, out);
+    };
+    bool overlap = options.overlap && !sameContainer(in, out) && jobScheduler.running() &&
+                   jobScheduler.submit("copy_write", JOB_NORMAL, write_job, 0, writer) != 0;
+
+    // Waits for 'ready'. A writer job that has not started when the reader
+    // needs it (the worker is busy, is this very caller, or was stopped)
+    // may never come: write what is queued here and carry on without one.
+    auto wait = [&](std::unique_lock<std::mutex> &lock, const std::function<bool()> &ready) {
+        while (!ready())
+        {
+            if (pipe.changed.wait_for(lock, std::chrono::milliseconds(50)) == std::cv_status::timeout &&
+                overlap && claim(pipe))
+            {
+                writer.cancel();
+                pipe.eof = true;
+                lock.unlock();
+                drain(pipe, out);
+                lock.lock();
+                pipe.eof = false;
+                pipe.writer_done = false;
+                overlap = false;
+            }
+        }
+    };
+
+    MCopyProgress progress;
+    progress.total = in->size();
+    progress.resumed = resumed;
+    auto report = [&](bool force) {
+        if (!options.progress)
+            return;
+        uint32_t ms = elapsed_ms(started);
+        if (!force && ms - progress.elapsed_ms < options.progress_ms)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(pipe.mutex);
+            progress.copied = resumed + pipe.written;
+        }
+        progress.elapsed_ms = ms;
+        progress.rate = ms ? (uint32_t)((uint64_t)(progress.copied - resumed) * 1000 / ms) : 0;
+        options.progress(progress);
+    };
+
+    uint32_t crc = resumed_crc;
+    bool short_read = false;
+    int slot = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pipe.mutex);
+            wait(lock, [&] { return !pipe.full[slot] || pipe.failed; });
+            if (pipe.failed)
+                break;
+        }
+
+        const uint8_t *data;
+        uint32_t n = in->readSpan(data, pipe.buf[slot], buffer_size);
+        if (n == 0)
+        {
+            // A source that knows its size and stops short of it has failed.
+            // Asked again now: a file in a disk image only knows its exact
+            // size once its last block has been read (blocks * 254 before).
+            progress.total = in->size();
+            short_read = progress.total && in->position() < progress.total;
+            break;
+        }
+        crc = crc32(crc, data, n);
+
+        if (overlap)
+        {
+            std::lock_guard<std::mutex> lock(pipe.mutex);
+            pipe.data[slot] = data;
+            pipe.len[slot] = n;
+            pipe.full[slot] = true;
+            pipe.changed.notify_all();
+            slot ^= 1;
+        }
+        else
+        {
+            uint32_t w = out->write(data, n);
+            std::lock_guard<std::mutex> lock(pipe.mutex);
+            pipe.written += w;
+            if (w != n)
+            {
+                pipe.failed = true;
+                break;
+            }
+        }
+
+        report(false);
+    }
+
+    if (overlap)
+    {
+        std::unique_lock<std::mutex> lock(pipe.mutex);
+        pipe.eof = true;
+        pipe.changed.notify_all();
+        wait(lock, [&] { return pipe.writer_done || !overlap; });
+    }
+
+    result.copied = pipe.written;
+    result.crc = crc;
+    if (pipe.failed)
+        result.status = MCopyResult::WRITE_ERROR;
+    else if (short_read)
+        result.status = MCopyResult::READ_ERROR;
+
+    report(true);
+    result.elapsed_ms = elapsed_ms(started);
+    return result;
+}
+
+uint32_t MCopy::resumeAt(MStream *in, uint32_t partial)
+{
+    if (partial == 0 || in->size() <= partial)
+        return 0;
+    if (in->position(partial))
+        return partial;
+    in->position(0);
+    return 0;
+}
+
+MCopyResult MCopy::file(MFile *src, MFile *dst, const MCopyOptions &options)
+{
+    auto in = src->getSourceStream(std::ios_base::in);
+    if (in == nullptr || !in->isOpen())
+    {
+        MCopyResult result;
+        result.status = MCopyResult::NO_SOURCE;
+        return result;
+    }
+    return file(in.get(), dst, options);
+}
+
+MCopyResult MCopy::file(MStream *in, MFile *dst, const MCopyOptions &options)
+{
+    MCopyResult result;
+    in->setSequentialAccess(true);
+
+    // Appending only makes sense to a file of its own, not to an entry
+    // inside a disk image or archive
+    uint32_t resumed = 0, resumed_crc = 0;
+    std::shared_ptr<MStream> out;
+    if (options.resume && dst->pathInStream.empty() && dst->exists())
+    {
+        auto partial = dst->getSourceStream(std::ios_base::in);
+        if (partial != nullptr && partial->isOpen())
+        {
+            resumed = resumeAt(in, partial->size());
+            // The bytes kept are checked against themselves: reading them
+            // from the source again would undo the point of resuming
+            if (resumed && options.verify && !crc(partial.get(), resumed_crc, resumed, options.buffer_size))
+            {
+                in->position(0);
+                resumed = 0;
+                resumed_crc = 0;
+            }
+            partial->close();
+        }
+        if (resumed)
+        {
+            Debug_printv("resuming [%s] at %lu", dst->url.c_str(), (unsigned long)resumed);
+            out = dst->getSourceStream(std::ios_base::app);
+        }
+    }
+    if (out == nullptr)
+    {
+        if (resumed)
+            in->position(0);
+        resumed = 0;
+        resumed_crc = 0;
+        out = dst->getSourceStream(std::ios_base::out);
+    }
+    if (out == nullptr || !out->isOpen())
+    {
+        in->setSequentialAccess(false);
+        result.status = MCopyResult::NO_DESTINATION;
+        return result;
+    }
+
+    result = stream(in, out.get(), options, resumed, resumed_crc);
+    out->close();
+    in->setSequentialAccess(false);
+
+    if (result.ok() && options.verify)
+    {
+        std::unique_ptr<MFile> check(MFSOwner::File(dst->url));
+        auto back = check ? check->getSourceStream(std::ios_base::in) : nullptr;
+        uint32_t crc_back = 0;
+        if (back == nullptr || !back->isOpen() ||
+            !crc(back.get(), crc_back, result.resumed + result.copied, options.buffer_size) ||
+            crc_back != result.crc)
+        {
+            Debug_printv("verify failed [%s] crc[%08lX] read back[%08lX]", dst->url.c_str(),
+                         (unsigned long)result.crc, (unsigned long)crc_back);
+            result.status = MCopyResult::VERIFY_FAILED;
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,121 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// Copy engine shared by MFSOwner::Copy(), the Fuji COPY command and the
+// console's cp, mv and wget.
+//
+// Two buffers: while the destination writes one, the source fills the
+// other. The writes run as a job on jobScheduler's normal priority worker
+// and the reads on the caller, so a network source and an SD card
+// destination wait on each other only when one is much slower. Without a
+// running scheduler the copy is done in turn on the caller.
+//
+// A copy can resume into a partial destination when the source can seek
+// (a local file, or HTTP with range requests), and can verify the result by
+// reading the destination back against a CRC-32 taken as the bytes went by.
+
+#ifndef MEATLOAF_COPY
+#define MEATLOAF_COPY
+
+#include <cstdint>
+#include <functional>
+
+#include "meatloaf.h"
+
+// Size of each of the two copy buffers
+#ifndef MCOPY_BUFFER_SIZE
+#ifdef CONFIG_SPIRAM
+#define MCOPY_BUFFER_SIZE       (64 * 1024)
+#else
+#define MCOPY_BUFFER_SIZE       (8 * 1024)
+#endif
+#endif
+
+// Least time between two progress reports
+#ifndef MCOPY_PROGRESS_MS
+#define MCOPY_PROGRESS_MS       250
+#endif
+
+struct MCopyProgress
+{
+    uint32_t copied = 0;        // bytes in the destination, resumed ones included
+    uint32_t total = 0;         // source size, 0 when it is not known
+    uint32_t resumed = 0;       // bytes the destination already had
+    uint32_t elapsed_ms = 0;
+    uint32_t rate = 0;          // bytes per second this copy has moved
+
+    uint8_t percent() const { return total ? (uint8_t)((uint64_t)copied * 100 / total) : 0; }
+};
+
+struct MCopyOptions
+{
+    uint32_t buffer_size = MCOPY_BUFFER_SIZE;
+    bool overlap = true;        // write on a jobScheduler worker while reading; not within one container
+    bool resume = false;        // continue a partial destination if the source can seek
+    bool verify = false;        // read the destination back and check its CRC
+    uint32_t progress_ms = MCOPY_PROGRESS_MS;
+    std::function<void(const MCopyProgress &)> progress;    // on the caller, and once at the end
+};
+
+struct MCopyResult
+{
+    enum Status
+    {
+        OK = 0,
+        NO_SOURCE,
+        NO_DESTINATION,
+        NO_MEMORY,
+        READ_ERROR,             // the source ended before its size
+        WRITE_ERROR,
+        VERIFY_FAILED,
+    };
+
+    Status status = OK;
+    uint32_t copied = 0;        // bytes this copy wrote
+    uint32_t resumed = 0;       // bytes kept from a partial destination
+    uint32_t crc = 0;           // CRC-32 of the whole destination
+    uint32_t elapsed_ms = 0;
+
+    bool ok() const { return status == OK; }
+    const char *message() const;
+};
+
+class MCopy
+{
+public:
+    // Copy what is left of 'in' to 'out', both open. 'resumed' bytes are
+    // already in the destination and 'in' is positioned past them; their
+    // CRC, if a verify is to cover them, is 'resumed_crc'.
+    static MCopyResult stream(MStream *in, MStream *out, const MCopyOptions &options,
+                              uint32_t resumed = 0, uint32_t resumed_crc = 0);
+
+    // Where a copy into a destination already holding 'partial' bytes can
+    // carry on: 'partial' when the source is longer and seeks there, else 0
+    static uint32_t resumeAt(MStream *in, uint32_t partial);
+
+    // Continue 'crc' over up to 'limit' bytes of 'in'; false on a short read
+    static bool crc(MStream *in, uint32_t &crc, uint32_t limit, uint32_t buffer_size = MCOPY_BUFFER_SIZE);
+    static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len);
+
+    // File to file: opens both, resumes and verifies as 'options' ask
+    static MCopyResult file(MFile *src, MFile *dst, const MCopyOptions &options);
+
+    // The same from a source the caller has opened already
+    static MCopyResult file(MStream *in, MFile *dst, const MCopyOptions &options);
+};
+
+#endif /* MEATLOAF_COPY */
@@ -0,0 +1,165 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "meat_lease.h"
+
+#include <cstdlib>
+
+std::atomic<uint16_t> LeaseTable::slots[LEASE_TABLE_SLOTS];
+std::atomic<uint32_t> LeaseTable::leases{0};
+
+// scheme://host:port/path, any part missing. A user@ is dropped from the
+// host, and a bracketed IPv6 host keeps its colons.
+static void split_url(const std::string& url, std::string& scheme, std::string& host,
+                      bool& authority, uint16_t& port)
+{
+    scheme.clear();
+    host.clear();
+    authority = false;
+    port = 0;
+
+    size_t colon = url.find(':');
+    size_t slash = url.find('/');
+    if (colon == std::string::npos || colon == 0 || (slash != std::string::npos && slash < colon))
+        return;
+    scheme = url.substr(0, colon);
+    if (url.compare(colon, 3, "://") != 0)
+        return;
+
+    authority = true;
+    size_t start = colon + 3;
+    size_t end = url.find('/', start);
+    if (end == std::string::npos)
+        end = url.size();
+    size_t at = url.rfind('@', end);
+    if (at != std::string::npos && at >= start)
+        start = at + 1;
+
+    size_t port_at = url.rfind(':', end);
+    size_t bracket = url.rfind(']', end);
+    if (port_at != std::string::npos && port_at >= start &&
+        (bracket == std::string::npos || bracket < start || port_at > bracket))
+    {
+        port = (uint16_t)strtoul(url.substr(port_at + 1, end - port_at - 1).c_str(), nullptr, 10);
+        end = port_at;
+    }
+    host = url.substr(start, end - start);
+}
+
+static uint32_t fnv1a(const std::string& s)
+{
+    uint32_t h = 2166136261u;
+    for (unsigned char c : s)
+        h = (h ^ c) * 16777619u;
+    return h;
+}
+
+void LeaseTable::names(const std::string& url, std::vector<std::string>& out)
+{
+    std::string path = url;
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+
+    // The directory and everything it is inside: an image stays held while
+    // a drive is in one of its directories or partitions. Nothing above a
+    // root ("sd:/", "/") can be an image.
+    size_t end = path.size();
+    while (end > 0 && path[end - 1] != ':' && path[end - 1] != '/')
+    {
+        out.push_back("i" + path.substr(0, end));
+        size_t slash = path.rfind('/', end - 1);
+        if (slash == std::string::npos)
+            break;
+        end = slash;
+    }
+
+    std::string scheme, host;
+    bool authority;
+    uint16_t port;
+    split_url(url, scheme, host, authority, port);
+    if (scheme.empty())
+        return;
+    if (!host.empty())
+        out.push_back("h" + host);
+    else
+        out.push_back("b" + scheme);
+    if (authority)
+        out.push_back("s" + scheme);
+}
+
+void LeaseTable::add(const std::string& name, int delta)
+{
+    uint32_t h = fnv1a(name);
+    slots[h % LEASE_TABLE_SLOTS] += delta;
+    slots[(h >> 16) % LEASE_TABLE_SLOTS] += delta;
+}
+
+bool LeaseTable::leased(const std::string& name)
+{
+    uint32_t h = fnv1a(name);
+    return slots[h % LEASE_TABLE_SLOTS] > 0 && slots[(h >> 16) % LEASE_TABLE_SLOTS] > 0;
+}
+
+bool LeaseTable::image(const std::string& source)
+{
+    std::string path = source;
+    while (path.size() > 1 && path.back() == '/')
+        path.pop_back();
+    return leased("i" + path);
+}
+
+bool LeaseTable::session(const std::string& key)
+{
+    std::string scheme, host;
+    bool authority;
+    uint16_t port;
+    split_url(key, scheme, host, authority, port);
+    if (!host.empty() && leased("h" + host))
+        return true;
+    if (scheme.empty())
+        return false;
+    return leased("b" + scheme) || (port == 0 && leased("s" + scheme));
+}
+
+void MLease::hold(const std::string& url)
+{
+    std::vector<std::string> names;
+    LeaseTable::names(url, names);
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& name : names)
+        LeaseTable::add(name, 1);
+    for (auto& name : _names)
+        LeaseTable::add(name, -1);
+    if (_url.empty() && !url.empty())
+        LeaseTable::leases++;
+    else if (!_url.empty() && url.empty())
+        LeaseTable::leases--;
+    _url = url;
+    _names.swap(names);
+}
+
+void MLease::release()
+{
+    hold("");
+}
+
+std::string MLease::url()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _url;
+}
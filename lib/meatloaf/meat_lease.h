@@ -0,0 +1,89 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MEATLOAF_LEASE
+#define MEATLOAF_LEASE
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/********************************************************
+ * Leases
+ ********************************************************/
+
+// Counters LeaseTable hashes leased names into. Each name takes two, and
+// there are a few names per lease (a working directory and its parents, its
+// host and its scheme), so 23 drives and the console stay well clear of
+// collisions. A collision only keeps an entry cached a little longer.
+#define LEASE_TABLE_SLOTS 512
+
+// What a drive or the console is working in, held for ImageBroker and
+// SessionBroker. They used to work this out for every entry they meant to
+// drop, by matching the entry against each drive's CWD; now the owner says
+// so when its CWD changes, and keeping an entry is a lookup.
+class MLease {
+public:
+    MLease() {}
+    ~MLease() { release(); }
+    MLease(const MLease&) = delete;
+    MLease& operator=(const MLease&) = delete;
+
+    // Hold url, giving up what was held before. The new lease is taken first,
+    // so moving within an image never lets it go.
+    void hold(const std::string& url);
+    void release();
+
+    std::string url();
+
+private:
+    std::mutex _mutex;
+    std::string _url;
+    std::vector<std::string> _names;
+};
+
+// Every lease held, as a counting filter: reading it takes no lock, so the
+// brokers can ask it for every entry while holding their own.
+class LeaseTable {
+public:
+    // An ImageBroker entry read from source: held by a lease on source itself
+    // or on anything inside it.
+    static bool image(const std::string& source);
+
+    // A SessionBroker entry, keyed scheme://host:port: held by a lease on the
+    // same host under any scheme (sessions for https:// are keyed http://),
+    // on a hostless path in its scheme (they use the session's default
+    // host), or, for a port 0 session, on anything in its scheme.
+    static bool session(const std::string& key);
+
+    // Leases held
+    static uint32_t count() { return leases; }
+
+private:
+    friend class MLease;
+
+    static std::atomic<uint16_t> slots[LEASE_TABLE_SLOTS];
+    static std::atomic<uint32_t> leases;
+
+    static void names(const std::string& url, std::vector<std::string>& out);
+    static void add(const std::string& name, int delta);
+    static bool leased(const std::string& name);
+};
+
+#endif // MEATLOAF_LEASE
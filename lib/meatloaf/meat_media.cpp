@@ -17,14 +17,372 @@
 
 #include "meat_media.h"
 #ifndef TEST_NATIVE
+#include <esp_heap_caps.h>
 #include <esp_task_wdt.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #endif
 
-std::unordered_map<std::string, std::shared_ptr<MMediaStream>>ImageBroker::image_repo;
-std::vector<ImageBroker::LRUEntry> ImageBroker::lru_order;
-std::chrono::steady_clock::time_point ImageBroker::last_cleanup = std::chrono::steady_clock::now();
+ImageBroker::Shard ImageBroker::shards[IMAGE_BROKER_SHARDS];
+size_t ImageBroker::byte_budget = 0;
+std::atomic<size_t> ImageBroker::total_bytes{0};
+std::atomic<size_t> ImageBroker::total_entries{0};
+std::atomic<uint32_t> ImageBroker::hits{0};
+std::atomic<uint32_t> ImageBroker::misses{0};
+std::atomic<uint32_t> ImageBroker::evictions{0};
+
+/********************************************************
+ * ImageBroker
+ ********************************************************/
+
+size_t ImageBroker::budget()
+{
+    if (byte_budget == 0)
+    {
+#if defined(TEST_NATIVE)
+        size_t free = IMAGE_BROKER_BUDGET_MAX * IMAGE_BROKER_BUDGET_SHARE;
+#elif defined(CONFIG_SPIRAM)
+        size_t free = heap_caps_get_free_size(MALLOC_CAP_SPIRAM);
+#else
+        size_t free = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+#endif
+        byte_budget = std::min<size_t>(std::max<size_t>(free / IMAGE_BROKER_BUDGET_SHARE,
+                                                        IMAGE_BROKER_BUDGET_MIN),
+                                       IMAGE_BROKER_BUDGET_MAX);
+    }
+    return byte_budget;
+}
+
+void ImageBroker::account(Shard& s, LRUEntry& e)
+{
+    uint32_t bytes = e.stream->footprint();
+    s.bytes_cached = s.bytes_cached - e.bytes + bytes;
+    total_bytes += bytes;
+    total_bytes -= e.bytes;
+    e.bytes = bytes;
+}
+
+void ImageBroker::erase(Shard& s, std::list<LRUEntry>::iterator it, std::list<LRUEntry>& released)
+{
+    s.bytes_cached -= it->bytes;
+    total_bytes -= it->bytes;
+    total_entries--;
+    s.repo.erase(it->key);
+    released.splice(released.end(), s.lru_order, it);
+}
+
+void ImageBroker::evict_lru_if_needed(Shard& s, size_t incoming, std::list<LRUEntry>& released,
+                                      bool adding)
+{
+    size_t limit = budget();
+    size_t entries = adding ? max_entries : SIZE_MAX;
+
+    auto it = s.lru_order.end();
+    while (it != s.lru_order.begin() &&
+           (total_bytes + incoming > limit || total_entries >= entries))
+    {
+        --it;
+        // A hit keeps the entry it has just moved to the front.
+        if ((!adding && it == s.lru_order.begin()) || is_in_use(*it))
+            continue;
+
+        Debug_printv("LRU evicting: %s [%u bytes]", it->key.c_str(), (unsigned)it->bytes);
+        evictions++;
+        auto victim = it++;
+        erase(s, victim, released);
+    }
+
+    // Entries of this shard still over the limit are all in use, or the
+    // bytes are in other shards; the newcomer goes in regardless, as it
+    // always has, and whichever shard is used next makes room.
+    if (total_bytes + incoming > limit || total_entries >= entries) {
+        Debug_printv("LRU: nothing left to evict in this shard");
+    }
+}
+
+void ImageBroker::cleanup_old_entries(Shard& s, std::list<LRUEntry>& released)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - s.last_cleanup).count();
+    if (elapsed < cleanup_interval_ms) return;
+
+    s.last_cleanup = now;
+    auto it = s.lru_order.end();
+    while (it != s.lru_order.begin())
+    {
+        --it;
+        auto age = std::chrono::duration_cast<std::chrono::milliseconds>(now - it->last_access).count();
+        if (age < cleanup_interval_ms)
+            break;
+        if (is_in_use(*it))
+            continue;
+
+        Debug_printv("LRU stale evicting: %s", it->key.c_str());
+        evictions++;
+        auto victim = it++;
+        erase(s, victim, released);
+    }
+}
+
+std::shared_ptr<MMediaStream> ImageBroker::find(const std::string& key)
+{
+    Shard& s = shard(key);
+    std::list<LRUEntry> released;
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.repo.find(key);
+    if (it == s.repo.end())
+        return nullptr;
+
+    // Lent to one reader: the caller opens its own, as on a miss.
+    if (it->second->checked_out)
+        return nullptr;
+
+    hits++;
+    auto e = it->second;
+    if (e != s.lru_order.begin())
+        s.lru_order.splice(s.lru_order.begin(), s.lru_order, e);
+    e->last_access = std::chrono::steady_clock::now();
+
+    // A stream's buffers fill as it is used: one that has grown can take the
+    // broker over budget, and nothing else would bring it back under.
+    account(s, *e);
+    if (total_bytes > budget())
+        evict_lru_if_needed(s, 0, released, false);
+    return e->stream;
+}
+
+std::shared_ptr<MMediaStream> ImageBroker::insert(const std::string& key, size_t type_length,
+                                                  std::shared_ptr<MMediaStream> stream)
+{
+    // Measured once it is open, when it knows what it has buffered.
+    uint32_t bytes = stream->footprint();
+
+    Shard& s = shard(key);
+    std::list<LRUEntry> released;
+    std::lock_guard<std::mutex> lock(s.mutex);
+    auto it = s.repo.find(key);
+    if (it != s.repo.end())
+    {
+        // Opened because the cached one is checked out: used once, not kept.
+        if (it->second->checked_out)
+            return stream;
+        return it->second->stream;
+    }
+
+    cleanup_old_entries(s, released);
+    evict_lru_if_needed(s, bytes, released);
+
+    s.lru_order.emplace_front(key, type_length, stream);
+    s.lru_order.front().bytes = bytes;
+    s.bytes_cached += bytes;
+    total_bytes += bytes;
+    total_entries++;
+    s.repo[key] = s.lru_order.begin();
+    return stream;
+}
+
+bool ImageBroker::mark(MStream* stream, long users, bool on, bool& cached)
+{
+    cached = false;
+    for (auto& s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for (auto& e : s.lru_order)
+        {
+            if (e.stream.get() != stream)
+                continue;
+            cached = true;
+            // Checked under the shard's lock, which find() takes too: nobody
+            // can obtain the stream between this and the mark.
+            if (on && e.stream.use_count() > users + 1)
+                return false;
+            e.checked_out = on;
+            return true;
+        }
+    }
+    return true;
+}
+
+bool ImageBroker::checkout(const std::shared_ptr<MStream>& stream)
+{
+    // Walked down through each container, with `s` itself one more holder:
+    // the caller holds the first stream, its reader each one below.
+    std::vector<std::shared_ptr<MStream>> marked;
+    bool exclusive = true;
+    for (auto s = stream; s != nullptr && exclusive; s = s->container())
+    {
+        bool cached;
+        exclusive = mark(s.get(), 2, true, cached);
+        if (!cached)
+            exclusive = s.use_count() <= 2;
+        else if (exclusive)
+            marked.push_back(s);
+    }
+    if (exclusive)
+        return true;
+
+    for (auto& s : marked)
+    {
+        bool cached;
+        mark(s.get(), 0, false, cached);
+    }
+    return false;
+}
+
+void ImageBroker::checkin(const std::shared_ptr<MStream>& stream)
+{
+    for (auto s = stream; s != nullptr; s = s->container())
+    {
+        bool cached;
+        mark(s.get(), 0, false, cached);
+    }
+}
+
+void ImageBroker::validate()
+{
+    for (auto& s : shards)
+    {
+        std::list<LRUEntry> released;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.lru_order.begin();
+        while (it != s.lru_order.end())
+        {
+            auto e = it++;
+            if (!is_in_use(*e)) {
+                Debug_printv("DISPOSING key[%s] stream[%s]", e->key.c_str(), e->stream->url.c_str());
+                erase(s, e, released);
+            }
+        }
+    }
+}
+
+void ImageBroker::clear()
+{
+    for (auto& s : shards)
+    {
+        std::list<LRUEntry> released;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.repo.clear();
+        total_bytes -= s.bytes_cached;
+        total_entries -= s.lru_order.size();
+        released.swap(s.lru_order);
+        s.bytes_cached = 0;
+    }
+}
+
+size_t ImageBroker::count()
+{
+    size_t n = 0;
+    for (auto& s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        n += s.lru_order.size();
+    }
+    return n;
+}
+
+size_t ImageBroker::bytes()
+{
+    size_t n = 0;
+    for (auto& s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        n += s.bytes_cached;
+    }
+    return n;
+}
+
+void ImageBroker::dump()
+{
+    Debug_printv("streams[%u] bytes[%u/%u] hits[%lu] misses[%lu] evictions[%lu] leases[%lu]",
+                 (unsigned)count(), (unsigned)bytes(), (unsigned)budget(),
+                 (unsigned long)hits, (unsigned long)misses, (unsigned long)evictions,
+                 (unsigned long)LeaseTable::count());
+    for (auto& s : shards)
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        for ([[maybe_unused]] auto& e : s.lru_order) {
+            Debug_printv("key[%s] stream[%s] size[%u]", e.key.c_str(), e.stream->url.c_str(), (unsigned)e.bytes);
+        }
+    }
+}
+
+/********************************************************
+ * DirectoryCache
+ ********************************************************/
+
+std::list<DirectoryCache::Slot> DirectoryCache::lru_order;
+std::mutex DirectoryCache::mutex;
+std::atomic<uint32_t> DirectoryCache::unverified_ms{DIRECTORY_CACHE_UNVERIFIED_MS};
+std::atomic<uint32_t> DirectoryCache::hits{0};
+std::atomic<uint32_t> DirectoryCache::misses{0};
+
+std::shared_ptr<const DirectoryListing> DirectoryCache::find(const std::string& key, uint32_t size, time_t mtime)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = lru_order.begin(); it != lru_order.end(); ++it)
+    {
+        if (it->key != key)
+            continue;
+
+        bool stale = (it->size != size || it->mtime != mtime);
+        if (!stale && mtime == 0)
+        {
+            auto age = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - it->stored).count();
+            stale = (age >= unverified_ms);
+        }
+        if (stale)
+        {
+            Debug_printv("stale listing key[%s]", key.c_str());
+            lru_order.erase(it);
+            break;
+        }
+
+        hits++;
+        if (it != lru_order.begin())
+            lru_order.splice(lru_order.begin(), lru_order, it);
+        return it->listing;
+    }
+
+    misses++;
+    return nullptr;
+}
+
+void DirectoryCache::store(const std::string& key, const std::string& container, uint32_t size, time_t mtime,
+                           std::shared_ptr<const DirectoryListing> listing)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lru_order.remove_if([&](const Slot& s) { return s.key == key; });
+    while (lru_order.size() >= DIRECTORY_CACHE_MAX_LISTINGS)
+        lru_order.pop_back();
+
+    lru_order.push_front({ key, container, size, mtime, std::chrono::steady_clock::now(), std::move(listing) });
+}
+
+void DirectoryCache::invalidate(const std::string& container)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lru_order.remove_if([&](const Slot& s) {
+        if (s.container == container)
+            return true;
+        // A listing inside it: "<container>/<path>"
+        return s.key.size() > container.size() && s.key[container.size()] == '/' &&
+               s.key.compare(0, container.size(), container) == 0;
+    });
+}
+
+void DirectoryCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    lru_order.clear();
+}
+
+size_t DirectoryCache::count()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return lru_order.size();
+}
 
 // Utility Functions
 
@@ -341,6 +699,9 @@ uint32_t MMediaStream::write(const uint8_t *buf, uint32_t size) {
         _position += bytesWritten;
         return bytesWritten;
     }
+
+    // Raw block writes (U2, B-W) can land on the directory or the BAM
+    DirectoryCache::invalidate(url);
     return containerStream->write(buf, size);
 }
 
@@ -22,18 +22,23 @@
 
 #include <map>
 #include <bitset>
+#include <list>
 #include <unordered_map>
 #include <sstream>
 #include <chrono>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #include "../../include/debug.h"
 
 #ifndef TEST_NATIVE
+#include "sdkconfig.h"
 #include "../device/iec/meatloaf.h"
 #include "../device/iec/fuji.h"
 #endif
 #include "string_utils.h"
+#include "meat_lease.h"
 
 
 /********************************************************
@@ -69,6 +74,7 @@ public:
     bool isBrowsable() override { return false; };
     // Random access streams might call seekPath to jump to a specific file
     bool isRandomAccess() override { return true; };
+    std::shared_ptr<MStream> container() override { return containerStream; }
 
     bool open(std::ios_base::openmode mode) override;
     void close() override;
@@ -95,6 +101,11 @@ public:
 
     virtual uint32_t seekFileSize( uint8_t start_track, uint8_t start_sector );
 
+    // Bytes this stream keeps hold of while ImageBroker caches it: the object
+    // itself plus whatever track, sector or entry buffers it has filled. A
+    // format that buffers more than its own members adds that on top.
+    virtual uint32_t footprint() { return sizeof(MMediaStream); }
+
 
 protected:
 
@@ -226,101 +237,113 @@ private:
 /********************************************************
  * Utility implementations
  ********************************************************/
+// Bytes of cached image streams ImageBroker may hold. The budget is taken
+// from the heap the streams' buffers come from, once, on first use - so a
+// board with PSRAM keeps many decoded images warm and one without keeps a few.
+#define IMAGE_BROKER_BUDGET_MIN (32 * 1024)
+#ifdef CONFIG_SPIRAM
+#define IMAGE_BROKER_BUDGET_MAX (2 * 1024 * 1024)
+#define IMAGE_BROKER_BUDGET_SHARE 8     // 1/8th of free PSRAM
+#else
+#define IMAGE_BROKER_BUDGET_MAX (128 * 1024)
+#define IMAGE_BROKER_BUDGET_SHARE 16    // 1/16th of free heap
+#endif
+
+// ImageBroker keeps its streams in this many shards, each with its own lock,
+// so drives working in different images don't wait on each other. The budget
+// and max_entries are for all of them together: a shard that several busy
+// images hash to may use what the others leave.
+#define IMAGE_BROKER_SHARDS 4
+
 class ImageBroker {
-    // LRU entry: stores key + last access timestamp for eviction
+    // Most recently used at the front of lru_order; repo maps a key to its
+    // node, so a hit is a lookup and a splice rather than a scan.
     struct LRUEntry {
         std::string key;
+        std::string source;  // the key without its type: what a lease holds
+        std::shared_ptr<MMediaStream> stream;
+        uint32_t bytes;     // footprint() as last measured
+        bool checked_out;   // lent to one reader; see checkout()
         std::chrono::steady_clock::time_point last_access;
-        LRUEntry(std::string k) : key(std::move(k)), last_access(std::chrono::steady_clock::now()) {}
+        LRUEntry(std::string k, size_t type_length, std::shared_ptr<MMediaStream> s)
+            : key(std::move(k)), source(key.substr(type_length)), stream(std::move(s)), bytes(0),
+              checked_out(false), last_access(std::chrono::steady_clock::now()) {}
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<LRUEntry> lru_order;
+        std::unordered_map<std::string, std::list<LRUEntry>::iterator> repo;
+        size_t bytes_cached = 0;
+        std::chrono::steady_clock::time_point last_cleanup = std::chrono::steady_clock::now();
     };
 
-    static std::unordered_map<std::string, std::shared_ptr<MMediaStream>> image_repo;
-    static std::vector<LRUEntry> lru_order;  // oldest-first LRU list
-    static std::chrono::steady_clock::time_point last_cleanup;
+    static Shard shards[IMAGE_BROKER_SHARDS];
+    static size_t byte_budget;                              // 0 until first use
+
+    // Sums of every shard's bytes_cached and entries, which each shard keeps
+    // up to date under its own lock and checks against the limits. A shard
+    // over them evicts its own entries; it never takes another's lock.
+    static std::atomic<size_t> total_bytes;
+    static std::atomic<size_t> total_entries;
 
-    static constexpr size_t max_entries = 50;              // Max cached streams
+    // Every cached stream also pins its container: an open file (the SD card
+    // mounts with 16 handles) or a connection. The budget bounds memory; this
+    // still bounds those.
+    static constexpr size_t max_entries = 50;
     static constexpr unsigned int cleanup_interval_ms = 60000; // Cleanup every 60s
 
-    // Check if an entry is currently in use by any active drive
-    static bool is_in_use(const std::string& key) {
-#ifdef TEST_NATIVE
-        return false;
-#else
-        for (int i = 0; i < MAX_DISK_DEVICES; i++) {
-            auto drive = Meatloaf.get_disks(i);
-            if (drive != nullptr) {
-                auto cwd = drive->disk_dev.getCWD();
-                if (cwd.empty()) continue;
-                if (cwd.back() == '/') cwd.pop_back();
-                if (!cwd.empty() && mstr::endsWith(key, cwd.c_str())) {
-                    return true;
-                }
-            }
-        }
-        // Check the Meatloaf device (#30) — it is not in the _fnDisks array
-        auto cwd = Meatloaf.getCWD();
-        if (!cwd.empty()) {
-            if (cwd.back() == '/') cwd.pop_back();
-            if (!cwd.empty() && mstr::endsWith(key, cwd.c_str()))
-                return true;
-        }
-        return false;
-#endif
+    static Shard& shard(const std::string& key) {
+        return shards[std::hash<std::string>()(key) % IMAGE_BROKER_SHARDS];
     }
 
-    // Evict oldest entries if over limit (skip entries that are in use)
-    static void evict_lru_if_needed() {
-        while (lru_order.size() >= max_entries) {
-            // Find oldest entry that is NOT in use
-            auto it = lru_order.begin();
-            for (; it != lru_order.end(); ++it) {
-                if (!is_in_use(it->key)) {
-                    Debug_printv("LRU evicting: %s", it->key.c_str());
-                    image_repo.erase(it->key);
-                    lru_order.erase(it);
-                    break;
-                }
-            }
-            // If all entries are in use, cannot evict - exit loop
-            if (it == lru_order.end()) {
-                Debug_printv("LRU: all entries in use, cannot evict");
-                break;
-            }
-        }
+    // An entry is in use while a drive or the console holds a lease on it,
+    // or on a directory inside it (see meat_lease.h).
+    static bool is_in_use(const LRUEntry& e) {
+        return LeaseTable::image(e.source);
     }
 
-    // Periodic cleanup: remove entries with stale timestamps (skip entries that are in use)
-    static void cleanup_old_entries() {
-        auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_cleanup).count();
-        if (elapsed < cleanup_interval_ms) return;
-
-
-        last_cleanup = now;
-        auto it = lru_order.begin();
-        while (it != lru_order.end()) {
-            auto age = std::chrono::duration_cast<std::chrono::milliseconds>(now - it->last_access).count();
-            if (age >= cleanup_interval_ms && !is_in_use(it->key)) {
-                Debug_printv("LRU stale evicting: %s", it->key.c_str());
-                image_repo.erase(it->key);
-                it = lru_order.erase(it);
-            } else {
-                ++it;
-            }
-        }
-    }
+    static size_t budget();
 
-    // Move existing key to back (most-recently-used)
-    static void touch_entry(const std::string& key) {
-        for (auto& e : lru_order) {
-            if (e.key == key) {
-                e.last_access = std::chrono::steady_clock::now();
-                return;
-            }
-        }
-    }
+    // Re-measure an entry; a stream's buffers fill as it is used.
+    static void account(Shard& s, LRUEntry& e);
+
+    // Take an entry out of its shard and into `released`. Dropping a stream
+    // can close a file or a connection, so callers declare `released` before
+    // taking the shard's lock: it is destroyed, and the streams with it,
+    // once the lock is let go.
+    static void erase(Shard& s, std::list<LRUEntry>::iterator it, std::list<LRUEntry>& released);
+
+    // Evict least recently used entries of a shard (skipping those in use)
+    // until `incoming` more bytes and, when adding, one more entry fit the
+    // broker's limits.
+    static void evict_lru_if_needed(Shard& s, size_t incoming, std::list<LRUEntry>& released,
+                                    bool adding = true);
+
+    // Periodic cleanup: remove entries not touched for cleanup_interval_ms
+    // (skipping those in use). Oldest are at the back, so this stops at the
+    // first entry young enough to keep.
+    static void cleanup_old_entries(Shard& s, std::list<LRUEntry>& released);
+
+    // The cached stream for key, counted as a hit, or null.
+    static std::shared_ptr<MMediaStream> find(const std::string& key);
+
+    // Cache a stream opened for key and return the one to use: if another
+    // drive cached one while this was opening, theirs, so both share it.
+    static std::shared_ptr<MMediaStream> insert(const std::string& key, size_t type_length,
+                                                std::shared_ptr<MMediaStream> stream);
+
+    // Set or clear checked_out on the entry caching `stream`, if any, and
+    // say in `cached` whether there was one. Setting it is refused (false)
+    // while anyone but the broker and `users` others holds the stream.
+    static bool mark(MStream* stream, long users, bool on, bool& cached);
 
 public:
+    // Counters for the console's meminfo.
+    static std::atomic<uint32_t> hits;
+    static std::atomic<uint32_t> misses;
+    static std::atomic<uint32_t> evictions;
+
     template<class T> static std::shared_ptr<T> obtain(std::string type, std::string url)
     {
         auto newFile = std::unique_ptr<MFile>(MFSOwner::File(url));
@@ -345,25 +368,19 @@ public:
         if ( newFile->sourceFile->pathInStream.size() && newFile->sourceFile->pathInStream != "/" )
             key += "/" + newFile->sourceFile->pathInStream;
 
-        auto it = image_repo.find(key);
-        if (it != image_repo.end()) {
-            touch_entry(key);
-            return std::static_pointer_cast<T>(it->second);
-        }
+        auto cached = find(key);
+        if (cached != nullptr)
+            return std::static_pointer_cast<T>(cached);
 
-        cleanup_old_entries();
-        evict_lru_if_needed();
+        misses++;
 
+        // Opened without a lock held: a slow container (HTTP, an archive to
+        // unpack) keeps only this drive waiting.
         std::shared_ptr<T> newStream = std::static_pointer_cast<T>(newFile->getSourceStream());
+        if ( newStream == nullptr )
+            return nullptr;
 
-        if ( newStream != nullptr )
-        {
-            image_repo.insert(std::make_pair(key, newStream));
-            lru_order.emplace_back(key);
-            return newStream;
-        }
-
-        return nullptr;
+        return std::static_pointer_cast<T>(insert(key, type.size(), newStream));
     }
 
     static std::shared_ptr<MMediaStream> obtain(std::string type, std::string url) {
@@ -371,19 +388,18 @@ public:
     }
 
     static bool exists(std::string url) {
-        return image_repo.find(url) != image_repo.end();
+        Shard& s = shard(url);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        return s.repo.find(url) != s.repo.end();
     }
 
     static void dispose(std::string url) {
-        auto it = image_repo.find(url);
-        if (it != image_repo.end()) {
-            lru_order.erase(
-                std::remove_if(lru_order.begin(), lru_order.end(),
-                    [&url](const LRUEntry& e) { return e.key == url; }),
-                lru_order.end()
-            );
-            image_repo.erase(it);
-        }
+        Shard& s = shard(url);
+        std::list<LRUEntry> released;
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.repo.find(url);
+        if (it != s.repo.end())
+            erase(s, it->second, released);
     }
 
     // Drop whatever obtain(type, url) would have returned. The key is derived
@@ -400,31 +416,104 @@ public:
         dispose(key);
     }
 
-    static void validate() {
-        // Collect first: dispose() erases from image_repo, which would
-        // invalidate the iterator if done while iterating.
-        std::vector<std::string> stale;
-        for (auto& pair : image_repo) {
-            if (!is_in_use(pair.first)) {
-                Debug_printv("DISPOSING key[%s] stream[%s]", pair.first.c_str(), pair.second->url.c_str());
-                stale.push_back(pair.first);
-            }
-        }
-        for (auto& key : stale)
-            dispose(key);
-    }
+    // Lend `stream` to the caller alone, e.g. for a drive to read it ahead
+    // from another task. Refused while anyone but the broker and the caller
+    // holds it, or any container it reads through. Until checkin(), obtain()
+    // opens a fresh, uncached stream for anyone else asking for the image.
+    static bool checkout(const std::shared_ptr<MStream>& stream);
+    static void checkin(const std::shared_ptr<MStream>& stream);
 
-    static void clear() {
-        image_repo.clear();
-        lru_order.clear();
-    }
+    // Drop every entry no drive holds a lease on.
+    static void validate();
 
-    static void dump() {
-        Debug_printv("streams[%d]", image_repo.size());
-        for (auto& pair : image_repo) {
-            Debug_printv("key[%s] stream[%s] size[%d]", pair.first.c_str(), pair.second->url.c_str(), sizeof(*pair.second));
-        }
-    }
+    static void clear();
+
+    static size_t count();
+    static size_t bytes();
+    static size_t limit() { return budget(); }
+
+    // Override the budget derived from free memory; 0 derives it again.
+    static void setBudget(size_t b) { byte_budget = b; }
+
+    static void dump();
+};
+
+
+/********************************************************
+ * DirectoryCache
+ ********************************************************/
+
+// Rendered directory listings DirectoryCache keeps. A full 144-entry D64
+// listing is around 8 KB of strings.
+#ifdef CONFIG_SPIRAM
+#define DIRECTORY_CACHE_MAX_LISTINGS 32
+#else
+#define DIRECTORY_CACHE_MAX_LISTINGS 8
+#endif
+
+// A container that reports no modification time (HTTP, an image inside an
+// archive) can't be checked for changes made elsewhere, so its listing is
+// only trusted this long.
+#define DIRECTORY_CACHE_UNVERIFIED_MS (5 * 60 * 1000)
+
+// One directory of an image as getNextFileInDir() hands it out: names already
+// UTF-8, types already decoded, sizes in bytes.
+struct DirectoryListing {
+    struct Entry {
+        std::string name;
+        std::string extension;
+        uint32_t size;
+        bool is_dir;
+        bool is_hidden;
+    };
+
+    std::string header;
+    std::string id;
+    uint16_t blocks_free = 0;
+    uint16_t block_size = 256;
+    std::vector<Entry> entries;
+};
+
+// Listings outlive the ImageBroker stream they were read through, so a
+// directory browsed again - by the drive, the console or WebDAV - is replayed
+// rather than re-walked sector by sector. An entry is keyed by the listed
+// directory's URL and only answers while the container still has the size
+// and modification time it had when the listing was read. Anything that
+// writes the directory drops the container's listings with invalidate().
+class DirectoryCache {
+    struct Slot {
+        std::string key;
+        std::string container;
+        uint32_t size;
+        time_t mtime;
+        std::chrono::steady_clock::time_point stored;
+        std::shared_ptr<const DirectoryListing> listing;
+    };
+
+    // Most recently used at the front; small enough that a scan is fine.
+    // The drive, the console and WebDAV list from tasks of their own, so
+    // every use of it holds mutex.
+    static std::list<Slot> lru_order;
+    static std::mutex mutex;
+    static std::atomic<uint32_t> unverified_ms;
+
+public:
+    static std::atomic<uint32_t> hits;
+    static std::atomic<uint32_t> misses;
+
+    static std::shared_ptr<const DirectoryListing> find(const std::string& key, uint32_t size, time_t mtime);
+    static void store(const std::string& key, const std::string& container, uint32_t size, time_t mtime,
+                      std::shared_ptr<const DirectoryListing> listing);
+
+    // Drop every listing read from container, including subdirectories and
+    // partitions of it.
+    static void invalidate(const std::string& container);
+
+    static void clear();
+    static size_t count();
+
+    // Override DIRECTORY_CACHE_UNVERIFIED_MS; 0 restores it.
+    static void setUnverifiedAge(uint32_t ms) { unverified_ms = ms ? ms : DIRECTORY_CACHE_UNVERIFIED_MS; }
 };
 
 #endif // MEATLOAF_MEDIA
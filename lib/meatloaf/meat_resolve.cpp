@@ -0,0 +1,264 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "meat_resolve.h"
+
+#include "meatloaf.h"
+#include "string_utils.h"
+
+MPathResolver::MPathResolver(std::vector<MFileSystem*>& filesystems, size_t capacity)
+    : _filesystems(filesystems), _capacity(capacity ? capacity : 1)
+{
+}
+
+MResolvedPath MPathResolver::resolve(const std::string& path, bool use_vdrive)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_suspended)
+        return compute(path, use_vdrive, false);
+
+    std::string key = (use_vdrive ? "v" : "-") + path;
+    Entry* e = find(key);
+    if (e != nullptr)
+    {
+        hits++;
+        return e->resolved;
+    }
+
+    misses++;
+    MResolvedPath resolved = compute(path, use_vdrive, true);
+    insert(key, resolved);
+    return resolved;
+}
+
+bool MPathResolver::redirect(const std::string& path, bool use_vdrive, uint64_t now_ms, std::string* url)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_suspended)
+        return false;
+
+    Entry* e = find((use_vdrive ? "v" : "-") + path);
+    if (e == nullptr || !e->resolved.redirect_known)
+        return false;
+
+    if ((now_ms - e->resolved.redirect_ms) >= MFS_RESOLVE_REDIRECT_TTL_MS)
+    {
+        e->resolved.redirect_known = false;
+        return false;
+    }
+
+    *url = e->resolved.redirect;
+    return true;
+}
+
+void MPathResolver::setRedirect(const std::string& path, bool use_vdrive, uint64_t now_ms, const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (_suspended)
+        return;
+
+    // Only ever recorded against a path resolve() has just cached; one that
+    // has been evicted since simply gets probed again next time.
+    Entry* e = find((use_vdrive ? "v" : "-") + path);
+    if (e == nullptr)
+        return;
+
+    e->resolved.redirect_known = true;
+    e->resolved.redirect = url;
+    e->resolved.redirect_ms = now_ms;
+}
+
+MFileSystem* MPathResolver::findParentFS(std::vector<std::string>::iterator& begin,
+                                         std::vector<std::string>::iterator& pathIterator,
+                                         bool use_vdrive)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    bool cached = (_suspended == 0);
+    while (pathIterator != begin)
+    {
+        pathIterator--;
+
+        auto fs = segmentOwner(*pathIterator, use_vdrive, cached);
+        if (fs != nullptr)
+        {
+            pathIterator++;
+            return fs;
+        }
+    }
+
+    // The first filesystem in the list is the default
+    pathIterator++;
+    return _filesystems.front();
+}
+
+void MPathResolver::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _entries.clear();
+    _index.clear();
+    _tokens.clear();
+}
+
+void MPathResolver::suspend()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _suspended++;
+}
+
+void MPathResolver::resume()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_suspended > 0)
+        _suspended--;
+}
+
+size_t MPathResolver::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+MFileSystem* MPathResolver::segmentOwner(std::string part, bool use_vdrive, bool cached)
+{
+    mstr::toLower(part);
+    if (part.empty())
+        return nullptr;
+
+    // What a filesystem's handles() actually looks at: a scheme is matched
+    // on the whole segment ("http:", "mdns:..."), everything else on its
+    // extension, so "game.d64" and "demo.d64" share one table entry. Hidden
+    // names and names without an extension are keyed whole.
+    std::string token;
+    size_t dot = part.find_last_of('.');
+    if (part.find(':') == std::string::npos && part[0] != '.' && dot != std::string::npos)
+        token = "*" + part.substr(dot);
+    else
+        token = part;
+
+    if (cached)
+    {
+        auto it = _tokens.find(token);
+        if (it != _tokens.end())
+            return use_vdrive ? it->second.native : it->second.any;
+    }
+
+    Owner owner;
+    for (auto i = _filesystems.begin() + 1; i < _filesystems.end(); i++)
+    {
+        auto fs = (*i);
+        if (!fs->handles(part))
+            continue;
+
+        if (owner.any == nullptr)
+            owner.any = fs;
+
+        // With vdrive in use a vdrive compatible filesystem is skipped - the
+        // image is handed to vdrive instead.
+        if (!fs->vdrive_compatible)
+        {
+            owner.native = fs;
+            break;
+        }
+    }
+
+    if (cached)
+    {
+        // Names without an extension are unbounded; start over rather than
+        // grow without limit, as readLocalConfig() does with its cache.
+        if (_tokens.size() >= MFS_RESOLVE_CACHE_TOKENS)
+            _tokens.clear();
+        _tokens[token] = owner;
+    }
+
+    return use_vdrive ? owner.native : owner.any;
+}
+
+MResolvedPath MPathResolver::compute(const std::string& path, bool use_vdrive, bool cached)
+{
+    MResolvedPath r;
+
+    std::vector<std::string> paths = mstr::split(path, '/');
+    auto pathIterator = paths.end();
+    auto begin = paths.begin();
+    auto end = paths.end();
+
+    // The same walk findParentFS() does, minus the lock already held.
+    auto parentFS = [&](std::vector<std::string>::iterator& it) -> MFileSystem* {
+        while (it != begin)
+        {
+            it--;
+            auto fs = segmentOwner(*it, use_vdrive, cached);
+            if (fs != nullptr)
+            {
+                it++;
+                return fs;
+            }
+        }
+        it++;
+        return _filesystems.front();
+    };
+
+    r.target_fs = parentFS(pathIterator);
+    r.target_path = mstr::joinToString(&begin, &pathIterator, "/");
+    r.target_in_stream = mstr::joinToString(&pathIterator, &end, "/");
+
+    end = pathIterator;
+    pathIterator--;
+
+    if (begin == pathIterator)
+    {
+        // The target filesystem takes the whole path.
+        r.target_path = path;
+        r.target_in_stream.clear();
+        return r;
+    }
+
+    r.nested = true;
+    r.source_path = mstr::joinToString(&begin, &pathIterator, "/");
+    r.source_in_stream = mstr::joinToString(&pathIterator, &end, "/");
+    r.source_fs = parentFS(pathIterator);
+    return r;
+}
+
+MPathResolver::Entry* MPathResolver::find(const std::string& key)
+{
+    auto it = _index.find(key);
+    if (it == _index.end())
+        return nullptr;
+
+    // Most recently used to the front, so eviction takes the stalest.
+    if (it->second != _entries.begin())
+        _entries.splice(_entries.begin(), _entries, it->second);
+    return &_entries.front();
+}
+
+void MPathResolver::insert(const std::string& key, const MResolvedPath& resolved)
+{
+    _entries.push_front({ key, resolved });
+    _index[key] = _entries.begin();
+
+    while (_entries.size() > _capacity)
+    {
+        _index.erase(_entries.back().key);
+        _entries.pop_back();
+    }
+}
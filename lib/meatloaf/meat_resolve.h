@@ -0,0 +1,157 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// Path resolution for MFSOwner::File().
+//
+// Every File() call split the path, asked every filesystem in availableFS
+// whether it handles each segment - right to left, twice for a file inside a
+// container - and then walked up the tree probing for .config files. A
+// directory listing, ImageBroker::obtain() and WebDAV's PROPFIND all resolve
+// the same prefixes over and over, and the answer never changes between them.
+//
+// MPathResolver memoizes that work at two levels:
+//
+//   - a segment table mapping a path segment's scheme or extension to the
+//     filesystem that claims it, replacing the linear handles() scan, and
+//   - a bounded LRU of whole resolutions keyed by path, holding the target
+//     and container filesystems, the split into source path and path in
+//     stream, and the .config base_url redirect (if any) for local paths.
+//
+// Nothing here constructs an MFile: File() still calls getFile() on every
+// call, so what comes back is always a fresh object. The cache is cleared by
+// MFSOwner::invalidateConfigCache() and by mount()/umount(), and suspended
+// while a disk image registry probes raw image bytes - the filesystems that
+// decline a path during a probe would otherwise be memoized as declining it.
+//
+// Kept free of the filesystem registry in meatloaf.cpp so that
+// test/native/test_path_resolve can drive it with stand-in filesystems.
+
+#ifndef MEATLOAF_RESOLVE
+#define MEATLOAF_RESOLVE
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef TEST_NATIVE
+#include "sdkconfig.h"
+#endif
+
+class MFileSystem;
+
+// Whole-path resolutions kept, and segment tokens remembered before the
+// segment table is reset.
+#ifdef CONFIG_SPIRAM
+#define MFS_RESOLVE_CACHE_PATHS 128
+#else
+#define MFS_RESOLVE_CACHE_PATHS 32
+#endif
+#define MFS_RESOLVE_CACHE_TOKENS 256
+
+// How long a memoized .config redirect (or its absence) is trusted, the same
+// TTL readLocalConfig() gives the files themselves.
+#define MFS_RESOLVE_REDIRECT_TTL_MS 10000
+
+struct MResolvedPath {
+    // Filesystem that owns the path, and the split of the path at the segment
+    // it claimed: target_path is what its getFile() is handed, target_in_stream
+    // what is left over inside it.
+    MFileSystem* target_fs = nullptr;
+    std::string target_path;
+    std::string target_in_stream;
+
+    // Set when the path goes through a container: the filesystem and split of
+    // the part in front of the target's segment.
+    bool nested = false;
+    MFileSystem* source_fs = nullptr;
+    std::string source_path;
+    std::string source_in_stream;
+
+    // .config redirect for local paths, valid while redirect_known.
+    bool redirect_known = false;
+    std::string redirect;
+    uint64_t redirect_ms = 0;
+};
+
+class MPathResolver
+{
+public:
+    MPathResolver(std::vector<MFileSystem*>& filesystems, size_t capacity = MFS_RESOLVE_CACHE_PATHS);
+
+    // Splits path into target and container the way MFSOwner::File() always
+    // has, served from the cache when the path was resolved before.
+    MResolvedPath resolve(const std::string& path, bool use_vdrive);
+
+    // The memoized redirect for path: true with *url set (empty for "no
+    // redirect") when one is known and younger than the TTL.
+    bool redirect(const std::string& path, bool use_vdrive, uint64_t now_ms, std::string* url);
+    void setRedirect(const std::string& path, bool use_vdrive, uint64_t now_ms, const std::string& url);
+
+    // Right-to-left search for the filesystem that claims a segment of
+    // [begin, pathIterator), leaving pathIterator just past that segment. The
+    // first filesystem in the list is the default and never matched by name.
+    MFileSystem* findParentFS(std::vector<std::string>::iterator& begin,
+                              std::vector<std::string>::iterator& pathIterator,
+                              bool use_vdrive);
+
+    // Forget everything, e.g. after a mount or a .config edit.
+    void clear();
+
+    // While suspended nothing is looked up in or added to either table.
+    // Nests; see the disk image registries' probing().
+    void suspend();
+    void resume();
+
+    size_t size();
+
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+
+private:
+    struct Entry {
+        std::string key;
+        MResolvedPath resolved;
+    };
+
+    // First filesystem claiming a token, with and without vdrive-compatible
+    // filesystems taking part; nullptr for none.
+    struct Owner {
+        MFileSystem* any = nullptr;
+        MFileSystem* native = nullptr;
+    };
+
+    MFileSystem* segmentOwner(std::string part, bool use_vdrive, bool cached);
+    MResolvedPath compute(const std::string& path, bool use_vdrive, bool cached);
+    Entry* find(const std::string& key);
+    void insert(const std::string& key, const MResolvedPath& resolved);
+
+    std::vector<MFileSystem*>& _filesystems;
+    size_t _capacity;
+    int _suspended = 0;
+
+    // Front is most recently used.
+    std::list<Entry> _entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> _index;
+    std::unordered_map<std::string, Owner> _tokens;
+
+    std::mutex _mutex;
+};
+
+#endif /* MEATLOAF_RESOLVE */
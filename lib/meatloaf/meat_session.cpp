@@ -34,11 +34,11 @@ static inline void *psram_malloc(size_t sz) {
 }
 
 // Initialize static members — SessionBroker
-std::unordered_map<std::string, std::shared_ptr<MSession>> SessionBroker::session_repo;
+SessionBroker::Shard SessionBroker::shards[SESSION_BROKER_SHARDS];
 std::chrono::steady_clock::time_point SessionBroker::last_keep_alive_check = std::chrono::steady_clock::now();
 bool SessionBroker::task_running = false;
 bool SessionBroker::system_shutdown = false;
-SemaphoreHandle_t SessionBroker::_mutex = nullptr;
+uint32_t SessionBroker::service_job = 0;
 
 // Initialize static members — CachedFile HIMEM
 #if defined(CONFIG_IDF_TARGET_ESP32) && defined(CONFIG_SPIRAM)
@@ -76,6 +76,14 @@ public:
         return n;
     }
 
+    uint32_t borrow(const uint8_t*& data, uint32_t count) override {
+        data = nullptr;
+        if (!m_cf) return 0;
+        uint32_t n = m_cf->span(_position, count, data);
+        _position += n;
+        return n;
+    }
+
     uint32_t write(const uint8_t* buf, uint32_t count) override {
         if (!m_cf) return 0;
         uint32_t n = m_cf->write(_position, buf, count);
@@ -347,6 +355,18 @@ uint32_t MSession::CachedFile::read(uint32_t offset, uint8_t* buf, uint32_t coun
     return count;
 }
 
+uint32_t MSession::CachedFile::span(uint32_t offset, uint32_t count, const uint8_t*& data) const {
+    data = nullptr;
+    if (m_store != Store::RAM || m_data == nullptr) return 0;
+#if defined(CONFIG_IDF_TARGET_ESP32) && defined(CONFIG_SPIRAM)
+    if (m_useHimem) return 0;
+#endif
+    if (offset >= size) return 0;
+    if (count > size - offset) count = size - offset;
+    data = m_data + offset;
+    return count;
+}
+
 uint32_t MSession::CachedFile::write(uint32_t offset, const uint8_t* buf, uint32_t count) {
     if (m_store == Store::SD) {
         if (m_sdPath.empty() || count == 0) return 0;
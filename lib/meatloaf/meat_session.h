@@ -24,12 +24,14 @@
 #include <list>
 #include <vector>
 #include <chrono>
+#include <ctime>
 #include <cstdlib>
 #include <cstring>
 #include <ios>
 #include <algorithm>
 #include <atomic>
 #include <functional>
+#include <mutex>
 #include <freertos/FreeRTOS.h>
 #include <freertos/semphr.h>
 #include <freertos/task.h>
@@ -41,6 +43,8 @@
 #include "../device/iec/meatloaf.h"
 #include "../console/Helpers/PWDHelpers.h"
 #endif
+#include "../task/fnScheduler.h"
+#include "meat_lease.h"
 
 #ifdef CONFIG_SPIRAM
 #include <esp_psram.h>
@@ -85,6 +89,12 @@ public:
         uint32_t read(uint32_t offset, uint8_t* buf, uint32_t count);
         uint32_t write(uint32_t offset, const uint8_t* buf, uint32_t count);
 
+        // Point 'data' at up to 'count' bytes from 'offset' in place, without
+        // copying. Only heap-backed RAM storage is addressable like this;
+        // HIMEM pages are mapped per access and SD is not memory, so those
+        // return 0 and the caller falls back to read().
+        uint32_t span(uint32_t offset, uint32_t count, const uint8_t*& data) const;
+
         // Load data from any MStream into backing store.
         // For SD-backed files: fileSize=0 streams until EOF.
         bool loadFromStream(MStream* stream, uint32_t fileSize = 0);
@@ -287,6 +297,137 @@ public:
         }
     }
 
+    // Attribute (stat) cache - what the server last said about a path on this
+    // session, shared by every MFile that uses it. isDirectory(), exists(),
+    // getLastWrite() and getCreationTime() each used to stat the path on their
+    // own, so a single IEC open() cost three to five round trips for the same
+    // answer. Directory listings fill it for free; remove, rename, mkdir and
+    // stream writes drop what they change. Entries live for the attribute TTL
+    // at most, so a change made by another client is seen that much later.
+    struct Attributes {
+        bool exists = false;
+        bool is_dir = false;
+        uint64_t size = 0;
+        time_t mtime = 0;
+        time_t ctime = 0;
+    };
+
+    static constexpr size_t max_attribute_cache_entries = 128;
+
+    // Attribute TTL in milliseconds (0 = cache nothing)
+    uint32_t getAttributeTTL() const { return attribute_ttl; }
+    void setAttributeTTL(uint32_t ms) { attribute_ttl = ms; }
+
+    // What a stat round trip found. Only Found and Missing are answers about
+    // the path; Error (a timeout, a dropped connection) says nothing about it
+    // and is never cached, or a file that is there would read as FILE NOT
+    // FOUND for a whole TTL.
+    enum class StatResult { Found, Missing, Error };
+
+    // The attributes of `path`, from the cache or from `stat` - a callable
+    // StatResult(Attributes&) that does the real round trip and fills what it
+    // can. A missing path is cached too: a LOAD of a name that is not there
+    // probes it several times. The stat runs without the lock, so an answer
+    // that an invalidation overtook meanwhile is handed back but not kept.
+    template<typename StatFn>
+    Attributes statCached(const std::string& path, StatFn&& stat) {
+        Attributes a;
+        if (getCachedAttributes(path, a))
+            return a;
+        uint32_t generation = attributeGeneration();
+        StatResult r = stat(a);
+        a.exists = (r == StatResult::Found);
+        if (r != StatResult::Error)
+            cacheAttributes(path, a, generation);
+        return a;
+    }
+
+    // Bumped by every invalidation; what was read before one is stale.
+    uint32_t attributeGeneration() const {
+        std::lock_guard<std::mutex> lock(attribute_mutex);
+        return attribute_generation;
+    }
+
+    bool getCachedAttributes(const std::string& path, Attributes& out) {
+        std::lock_guard<std::mutex> lock(attribute_mutex);
+        auto it = attribute_cache.find(attributeKey(path));
+        if (it == attribute_cache.end()) {
+            attribute_misses++;
+            return false;
+        }
+        auto age = std::chrono::steady_clock::now() - it->second.stored;
+        if (age >= std::chrono::milliseconds(attribute_ttl)) {
+            attribute_order.erase(it->second.order);
+            attribute_cache.erase(it);
+            attribute_misses++;
+            return false;
+        }
+        attribute_order.splice(attribute_order.begin(), attribute_order, it->second.order);
+        attribute_hits++;
+        out = it->second.attributes;
+        return true;
+    }
+
+    void cacheAttributes(const std::string& path, const Attributes& attributes) {
+        cacheAttributes(path, attributes, attributeGeneration());
+    }
+
+    // Stores what was read at `generation`, unless an invalidation has come
+    // in since.
+    void cacheAttributes(const std::string& path, const Attributes& attributes, uint32_t generation) {
+        std::string k = attributeKey(path);
+        std::lock_guard<std::mutex> lock(attribute_mutex);
+        if (generation != attribute_generation)
+            return;
+        auto it = attribute_cache.find(k);
+        if (it != attribute_cache.end()) {
+            attribute_order.splice(attribute_order.begin(), attribute_order, it->second.order);
+        } else {
+            while (attribute_cache.size() >= max_attribute_cache_entries) {
+                attribute_cache.erase(attribute_order.back());
+                attribute_order.pop_back();
+            }
+            attribute_order.push_front(k);
+            it = attribute_cache.emplace(k, AttributeSlot()).first;
+            it->second.order = attribute_order.begin();
+        }
+        it->second.attributes = attributes;
+        it->second.stored = std::chrono::steady_clock::now();
+    }
+
+    // Drops `path`, everything below it, and its parent directory, whose
+    // modification time the change has just moved.
+    void invalidateAttributes(const std::string& path) {
+        std::string k = attributeKey(path);
+        std::string below = (k == "/") ? k : k + "/";
+        size_t slash = k.find_last_of('/');
+        std::string parent = (slash == 0 || slash == std::string::npos) ? "/" : k.substr(0, slash);
+        std::lock_guard<std::mutex> lock(attribute_mutex);
+        attribute_generation++;
+        for (auto it = attribute_cache.begin(); it != attribute_cache.end(); ) {
+            if (it->first == k || it->first == parent || it->first.compare(0, below.size(), below) == 0) {
+                attribute_order.erase(it->second.order);
+                it = attribute_cache.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    void clearAttributeCache() {
+        std::lock_guard<std::mutex> lock(attribute_mutex);
+        attribute_generation++;
+        attribute_cache.clear();
+        attribute_order.clear();
+    }
+
+    size_t attributeCacheCount() const {
+        std::lock_guard<std::mutex> lock(attribute_mutex);
+        return attribute_cache.size();
+    }
+    uint32_t attributeHits() const { return attribute_hits; }
+    uint32_t attributeMisses() const { return attribute_misses; }
+
 protected:
     std::string key;  // scheme://host:port
     std::string host;
@@ -300,6 +441,31 @@ protected:
     std::unordered_map<std::string, std::shared_ptr<CachedFile>> file_cache;
     std::list<std::string> cache_order;  // LRU order (front = most recent)
     std::atomic<uint32_t> io_active{0};
+
+    struct AttributeSlot {
+        Attributes attributes;
+        std::chrono::steady_clock::time_point stored;
+        std::list<std::string>::iterator order;
+    };
+    // The session is shared by every drive, WebDAV and the console, so the
+    // attribute cache is only touched with attribute_mutex held. The stat
+    // itself runs without it; attribute_generation is how a store finds out
+    // it was overtaken.
+    mutable std::mutex attribute_mutex;
+    uint32_t attribute_generation = 0;
+    std::unordered_map<std::string, AttributeSlot> attribute_cache;
+    std::list<std::string> attribute_order;  // LRU order (front = most recent)
+    uint32_t attribute_ttl = 3000;  // ms
+    std::atomic<uint32_t> attribute_hits{0};
+    std::atomic<uint32_t> attribute_misses{0};
+
+    // "/a/b/" and "/a/b" are the same path; "" is the root.
+    static std::string attributeKey(const std::string& path) {
+        std::string k = path.empty() ? "/" : path;
+        while (k.size() > 1 && k.back() == '/')
+            k.pop_back();
+        return k;
+    }
 };
 
 
@@ -307,162 +473,66 @@ protected:
  * Session Broker
  ********************************************************/
 
+// SessionBroker keeps its sessions in this many shards, each with its own
+// lock, so a drive finding its session never waits on another's.
+#define SESSION_BROKER_SHARDS 4
+
 class SessionBroker {
 private:
-    static std::unordered_map<std::string, std::shared_ptr<MSession>> session_repo;
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<MSession>> repo;
+    };
+
+    static Shard shards[SESSION_BROKER_SHARDS];
     static std::chrono::steady_clock::time_point last_keep_alive_check;
     static bool task_running;
     static bool system_shutdown;  // Flag to indicate system is shutting down
-    static SemaphoreHandle_t _mutex;
-
-    static void lock() {
-        if (_mutex) xSemaphoreTake(_mutex, portMAX_DELAY);
-    }
-    static void unlock() {
-        if (_mutex) xSemaphoreGive(_mutex);
-    }
-
-    // Extract scheme://host from session key (e.g., "tnfs://host:16384" -> "tnfs://host")
-    static std::string session_host_key(const std::string& key) {
-        // Find the last colon (after port)
-        size_t last_colon = key.rfind(':');
-        if (last_colon == std::string::npos) return key;
-        // Return scheme://host (without port)
-        return key.substr(0, last_colon);
-    }
+    static uint32_t service_job;  // jobScheduler ID of the periodic service()
 
-    // Check if path matches session key (comparing host, tolerating scheme differences)
-    static bool path_matches_session(const std::string& path, const std::string& key) {
-        std::string hostKey = session_host_key(key);
-        // Strip trailing slash from path for comparison
-        std::string p = path;
-        if (!p.empty() && p.back() == '/') p.pop_back();
-        // Check if path starts with scheme://host (ignoring port)
-        if (!p.empty() && mstr::startsWith(p.c_str(), hostKey.c_str())) {
-            return true;
-        }
-        // HTTP/HTTPS equivalence: session keys always use "http://" (from getScheme())
-        // but CWD paths use the original scheme ("https://"). Compare hosts directly.
-        auto keyParsed = PeoplesUrlParser::parseURL(key);
-        auto pathParsed = PeoplesUrlParser::parseURL(path);
-        if (!keyParsed->host.empty() && !pathParsed->host.empty() &&
-            keyParsed->host == pathParsed->host) {
-            return true;
-        }
-        // Also match when path is just the scheme root (e.g. "mdns://" matches "mdns://mdns:0")
-        auto schemeEnd = key.find("://");
-        if (schemeEnd != std::string::npos) {
-            std::string schemeRoot = key.substr(0, schemeEnd + 3); // e.g. "mdns://"
-            if (path == schemeRoot) {
-                return true;
-            }
-            // Hostless paths in the same scheme use the session's default host
-            // (e.g. console cwd "csip:/" after "cd csip://" keeps the
-            // "csip://commodoreserver.com:1541" session alive). Note the cwd
-            // may be normalized to a single slash ("csip:/...").
-            std::string schemePrefix = key.substr(0, schemeEnd + 1); // e.g. "csip:"
-            if (pathParsed != nullptr && pathParsed->host.empty() &&
-                mstr::startsWith(path.c_str(), schemePrefix.c_str())) {
-                return true;
-            }
-            // Port-0 sessions use a dummy host (e.g. "mdns://mdns:0") and serve the whole
-            // scheme namespace — any path starting with the same scheme keeps them alive.
-            size_t last_colon = key.rfind(':');
-            if (last_colon != std::string::npos && key.substr(last_colon + 1) == "0" &&
-                mstr::startsWith(path.c_str(), schemeRoot.c_str())) {
-                return true;
-            }
-        }
-        return false;
+    static Shard& shard(const std::string& key) {
+        return shards[std::hash<std::string>()(key) % SESSION_BROKER_SHARDS];
     }
 
-    // Check if a session is currently in use by any active drive or console
+    // A session is in use while a drive or the console holds a lease on a
+    // path it serves (see meat_lease.h).
     static bool is_session_in_use(const std::string& key) {
-#ifdef TEST_NATIVE
-        // The native test build has no drives and no console, so nothing can
-        // be holding a session (the device layer isn't compiled — see the
-        // include guard above, and the same pattern in meat_media.h).
-        (void)key;
-        return false;
-#else
-        // Check fuji disk slots (devices 4-11 etc.)
-        for (int i = 0; i < MAX_DISK_DEVICES; i++) {
-            auto drive = Meatloaf.get_disks(i);
-            if (drive != nullptr) {
-                auto cwd = drive->disk_dev.getCWD();
-                if (path_matches_session(cwd, key)) {
-                    return true;
-                }
-            }
-        }
-        // Check the Meatloaf device (#30) — not in _fnDisks array
-        if (path_matches_session(Meatloaf.getCWD(), key)) {
-            return true;
-        }
-        // Check console current path (URL copy - the console may replace
-        // its path object concurrently on another task)
-        auto consoleUrl = ESP32Console::getCurrentPathUrl();
-        if (!consoleUrl.empty() && path_matches_session(consoleUrl, key)) {
-            return true;
-        }
-        return false;
-#endif
-    }
-
-    // FreeRTOS task function
-    static void session_service_task(void* arg) {
-        //Debug_printv("SessionBroker task started on core %d", xPortGetCoreID());
-        while (task_running) {
-            if (system_shutdown) break;  // Fast exit on shutdown
-            service();
-            vTaskDelay(pdMS_TO_TICKS(1000)); // Check every 1 second
-        }
-        vTaskDelete(NULL);
+        return LeaseTable::session(key);
     }
 
-    // Internal dispose by key (no lock, caller must hold mutex)
-    static void disposeByKey(const std::string& key) {
-        auto it = session_repo.find(key);
-        if (it != session_repo.end()) {
+    // Internal dispose by key (no lock, caller must hold the shard's mutex)
+    static void disposeByKey(Shard& s, const std::string& key) {
+        auto it = s.repo.find(key);
+        if (it != s.repo.end()) {
             //Debug_printv("Disposing session: %s", key.c_str());
             // Disconnect explicitly: a stale shared_ptr held elsewhere would
             // otherwise keep the destructor (and the socket close) from
             // running when the repo entry is erased
             if (it->second != nullptr && !it->second->isBusy())
                 it->second->disconnect();
-            session_repo.erase(it);
+            s.repo.erase(it);
         }
         Debug_memory();
     }
 
 public:
-    // Initialize and start the SessionBroker service task
-    // This creates a FreeRTOS task on CPU0 to periodically call service()
+    // Initialize and start the SessionBroker service
+    // service() runs once a second as a background job on jobScheduler
     static void setup() {
         if (task_running) {
             Debug_printv("SessionBroker task already running");
             return;
         }
 
-        if (!_mutex) {
-            _mutex = xSemaphoreCreateMutex();
-        }
-
         task_running = true;
-        //Debug_printv("Starting SessionBroker service task");
-
-        // Create task on CPU0 (same core as WiFi)
-        // Lower priority than IEC bus task
-        // Increased stack size to 8192 for HTTP/TNFS network session operations
-        xTaskCreatePinnedToCore(
-            session_service_task,    // Task function
-            "session_broker",        // Task name
-            8192,                    // Stack size
-            NULL,                    // Parameters
-            5,                       // Priority (lower than IEC bus priority 17)
-            NULL,                    // Task handle
-            0                        // Core 0 (WiFi core)
-        );
+        //Debug_printv("Starting SessionBroker service");
+
+        // The background worker is on CPU0 (same core as WiFi), below the
+        // IEC bus task, with the 8192 byte stack HTTP/TNFS reconnects need
+        service_job = jobScheduler.every("session_broker", JOB_BACKGROUND, 1000, [](fnJobContext&) {
+            if (!system_shutdown)  // Fast exit on shutdown
+                service();
+        });
     }
 
     // Stop the SessionBroker service task
@@ -470,9 +540,8 @@ public:
         Debug_printv("Stopping SessionBroker service task");
         system_shutdown = true;  // Set shutdown flag BEFORE clearing sessions
         task_running = false;
-        lock();
-        session_repo.clear();
-        unlock();
+        jobScheduler.cancel(service_job);
+        clear();
     }
 
     // Check if system is shutting down
@@ -483,24 +552,25 @@ public:
     // Find an existing session by key (does not create)
     template<class T>
     static std::shared_ptr<T> find(const std::string& key) {
-        lock();
-        auto it = session_repo.find(key);
-        if (it != session_repo.end()) {
+        Shard& s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto it = s.repo.find(key);
+        if (it != s.repo.end()) {
             auto session = std::static_pointer_cast<T>(it->second);
             session->updateActivity();  // Keep session alive while in use
-            unlock();
             return session;
         }
-        unlock();
         return nullptr;
     }
 
-    // Add a session to the repo
-    static void add(const std::string& key, std::shared_ptr<MSession> session) {
-        lock();
-        session_repo.insert(std::make_pair(key, session));
-        session->updateActivity();
-        unlock();
+    // Add a session to the repo. Returns the session kept under key: if
+    // another drive added one first, that one.
+    static std::shared_ptr<MSession> add(const std::string& key, std::shared_ptr<MSession> session) {
+        Shard& s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto kept = s.repo.insert(std::make_pair(key, session)).first->second;
+        kept->updateActivity();
+        return kept;
     }
 
     // Obtain a session (creates if doesn't exist, returns existing if found)
@@ -516,11 +586,15 @@ public:
             return existing;
         }
 
-        // Create and connect new session
+        // Create and connect new session, without a lock held: a slow
+        // connect keeps only this drive waiting. Two drives connecting to
+        // the same server at once both end up on the first one added.
         auto newSession = std::make_shared<T>(host, port);
         if (newSession->connect()) {
-            add(key, newSession);
-            return newSession;
+            auto kept = add(key, newSession);
+            if (kept != newSession)
+                newSession->disconnect();
+            return std::static_pointer_cast<T>(kept);
         }
 
         Debug_printv("Failed to create session: %s", key.c_str());
@@ -529,9 +603,9 @@ public:
 
     // Dispose of a session by key
     static void dispose(const std::string& key) {
-        lock();
-        disposeByKey(key);
-        unlock();
+        Shard& s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        disposeByKey(s, key);
     }
 
     // Process keep-alive for all sessions
@@ -550,41 +624,44 @@ public:
         std::vector<std::string> to_remove;
         std::vector<std::pair<std::string, std::shared_ptr<MSession>>> to_check;
 
-        lock();
-        for (auto& pair : session_repo) {
-            auto& session = pair.second;
-            const std::string& key = pair.first;
-
-            // If session is NOT in use by any drive or console, consider removal
-            if (!is_session_in_use(key)) {
-                // Grace period: keep sessions alive if busy or recently active,
-                // since CWD isn't updated until after file loading completes.
-                // Per-session so e.g. the console exec session can linger 3 min.
-                if (session->isBusy() || session->getIdleTime() < session->getIdleGracePeriod()) {
+        // One shard at a time: a drive finding its session waits at most for
+        // one shard's worth of these checks
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for (auto& pair : s.repo) {
+                auto& session = pair.second;
+                const std::string& key = pair.first;
+
+                // If session is NOT in use by any drive or console, consider removal
+                if (!is_session_in_use(key)) {
+                    // Grace period: keep sessions alive if busy or recently active,
+                    // since CWD isn't updated until after file loading completes.
+                    // Per-session so e.g. the console exec session can linger 3 min.
+                    if (session->isBusy() || session->getIdleTime() < session->getIdleGracePeriod()) {
+                        continue;
+                    }
+                    //Debug_printv("Session not in use, removing: %s", key.c_str());
+                    to_remove.push_back(key);
                     continue;
                 }
-                //Debug_printv("Session not in use, removing: %s", key.c_str());
-                to_remove.push_back(key);
-                continue;
-            }
 
-            if (session->isBusy()) {
-                continue;  // Skip busy sessions
-            }
+                if (session->isBusy()) {
+                    continue;  // Skip busy sessions
+                }
 
-            if (!session->isConnected()) {
-                to_remove.push_back(key);
-                continue;
-            }
+                if (!session->isConnected()) {
+                    to_remove.push_back(key);
+                    continue;
+                }
 
-            // Session is in use - check if it needs keep-alive
-            uint32_t idle_time = session->getIdleTime();
-            uint32_t keep_alive_interval = session->getKeepAliveInterval();
-            if (idle_time >= keep_alive_interval && keep_alive_interval > 0) {
-                to_check.push_back(pair);
+                // Session is in use - check if it needs keep-alive
+                uint32_t idle_time = session->getIdleTime();
+                uint32_t keep_alive_interval = session->getKeepAliveInterval();
+                if (idle_time >= keep_alive_interval && keep_alive_interval > 0) {
+                    to_check.push_back(pair);
+                }
             }
         }
-        unlock();
 
         // Run keep-alive checks outside the lock (network I/O)
         for (auto& pair : to_check) {
@@ -605,36 +682,42 @@ public:
 
         // Remove failed sessions
         if (!to_remove.empty()) {
-            lock();
             for (const auto& key : to_remove) {
                 Debug_printv("Removing session: %s", key.c_str());
-                disposeByKey(key);
+                Shard& s = shard(key);
+                std::lock_guard<std::mutex> lock(s.mutex);
+                disposeByKey(s, key);
             }
-            Debug_printv("Active sessions: %d", session_repo.size());
-            unlock();
+            Debug_printv("Active sessions: %d", (int)count());
         }
     }
 
     // Get session count
     static size_t count() {
-        lock();
-        size_t c = session_repo.size();
-        unlock();
+        size_t c = 0;
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            c += s.repo.size();
+        }
         return c;
     }
 
     // Clear all sessions
     static void clear() {
-        lock();
         Debug_printv("Clearing all sessions");
-        session_repo.clear();
-        unlock();
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.repo.clear();
+        }
     }
 
     static void dump() {
-        Debug_printv("sessions[%d]", session_repo.size());
-        for(auto& pair : session_repo) {
-            Debug_printv("key[%s] size[%d]", pair.first.c_str(), sizeof(*pair.second));
+        Debug_printv("sessions[%d] leases[%lu]", (int)count(), (unsigned long)LeaseTable::count());
+        for (auto& s : shards) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            for([[maybe_unused]] auto& pair : s.repo) {
+                Debug_printv("key[%s] size[%d]", pair.first.c_str(), sizeof(*pair.second));
+            }
         }
     }
 };
@@ -42,6 +42,8 @@
 
 #include "meat_broker.h"
 #include "meat_buffer.h"
+#include "meat_copy.h"
+#include "meat_resolve.h"
 
 #include "string_utils.h"
 #include "peoples_url_parser.h"
@@ -542,10 +544,17 @@ std::vector<MFileSystem*> MFSOwner::availableOther {
 #endif
 };
 
+// Path resolutions, memoized; see meat_resolve.h.
+static MPathResolver s_resolver(MFSOwner::availableFS);
+
 bool MFSOwner::mount(std::string name) {
     Debug_print("MFSOwner::mount fs:");
     Debug_println(name.c_str());
 
+    // What a path resolves to - and whether a .config redirects it - can
+    // change with what is mounted.
+    s_resolver.clear();
+
     for(auto i = availableFS.begin() + 1; i < availableFS.end() ; i ++) {
         auto fs = (*i);
 
@@ -568,6 +577,8 @@ bool MFSOwner::mount(std::string name) {
 }
 
 bool MFSOwner::umount(std::string name) {
+    s_resolver.clear();
+
     for(auto i = availableFS.begin() + 1; i < availableFS.end() ; i ++) {
         auto fs = (*i);
 
@@ -596,8 +607,23 @@ static std::mutex s_configCacheMutex;
 
 void MFSOwner::invalidateConfigCache()
 {
-    std::lock_guard<std::mutex> lock(s_configCacheMutex);
-    s_configCache.clear();
+    {
+        std::lock_guard<std::mutex> lock(s_configCacheMutex);
+        s_configCache.clear();
+    }
+
+    // Resolutions carry the base_url redirect read from those files.
+    s_resolver.clear();
+}
+
+void MFSOwner::suspendResolveCache()
+{
+    s_resolver.suspend();
+}
+
+void MFSOwner::resumeResolveCache()
+{
+    s_resolver.resume();
 }
 
 // Read key=value pairs from a local .config file using raw POSIX I/O.
@@ -664,6 +690,27 @@ static std::string localParentDir(const std::string& path)
     return p.substr(0, slash);
 }
 
+// File() with default_fs: every segment belongs to the default filesystem, so
+// there is no container to find and nothing worth caching.
+static MResolvedPath resolveDefault(const std::string& path)
+{
+    MResolvedPath r;
+    r.target_fs = MFSOwner::availableFS.front();
+
+    std::vector<std::string> paths = mstr::split(path,'/');
+    if ( paths.size() <= 1 )
+    {
+        r.target_path = path;
+        return r;
+    }
+
+    r.nested = true;
+    r.target_path = mstr::joinToString(paths, "/");
+    r.source_fs = r.target_fs;
+    r.source_path = r.target_path;
+    return r;
+}
+
 MFile* MFSOwner::File(std::string path, bool default_fs) {
 
     if ( path.empty() )
@@ -690,6 +737,8 @@ MFile* MFSOwner::File(std::string path, bool default_fs) {
         if ( mlFS.handles(path) )
         {
             path = mlFS.resolve(path);
+            if ( path.empty() )
+                return nullptr;
         }
         else
         {
@@ -709,78 +758,52 @@ MFile* MFSOwner::File(std::string path, bool default_fs) {
     //Debug_println("vvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvvv");
     //Debug_printv("targetPath[%s]", path.c_str());
 
-    std::vector<std::string> paths = mstr::split(path,'/');
-    auto pathIterator = paths.end();
-    auto begin = paths.begin();
-    auto end = paths.end();
-
-    MFile* targetFile = nullptr;
-    MFileSystem *targetFileSystem = &defaultFS;
+    // Which filesystem owns the path, and where it splits into a container
+    // and a path inside it. Memoized, so the handles() scan over availableFS
+    // runs once per path rather than on every call.
+    MResolvedPath resolved;
     if ( !default_fs )
     {
         //Debug_printv("Finding Target FS for path[%s]", path.c_str());
-        targetFileSystem = findParentFS(begin, pathIterator);
+        resolved = s_resolver.resolve(path, Meatloaf.use_vdrive);
+    }
+    else
+    {
+        resolved = resolveDefault(path);
     }
 
-    // targetFile is for access to the file in the container stream
-    auto sourcePath = mstr::joinToString(&begin, &pathIterator, "/");
-    auto sourcePathInStream = mstr::joinToString(&pathIterator, &end, "/");
-
-    end = pathIterator;
-    pathIterator--;
+    MFile* targetFile = nullptr;
+    MFileSystem *targetFileSystem = resolved.target_fs;
 
-    if( begin == pathIterator )
+    if( !resolved.nested )
     {
         //Debug_printv("** LOOK UP PATH NOT NEEDED   path[%s]", path.c_str());
         targetFile = targetFileSystem->getFile(path);
-        //targetFile->pathInStream = sourcePathInStream;
-        //targetFile->type = targetFileSystem->symbol;
         //Debug_printv( ANSI_WHITE_BOLD "targetPathInStream[%s] is in sourcePath[%s][%s]", targetFile->pathInStream.c_str(), path.c_str(), targetFileSystem->symbol);
     } 
     else
     {
-        targetFile = targetFileSystem->getFile(sourcePath);
-        //targetFile->type = targetFileSystem->symbol;
-        targetFile->pathInStream = sourcePathInStream;
-        //Debug_printv( ANSI_WHITE_BOLD "targetPathInStream[%s] is in sourcePath[%s][%s]", targetFile->pathInStream.c_str(), sourcePath.c_str(), targetFileSystem->symbol);
-
-        //Debug_printv("** LOOK UP PATH: %s", sourcePath.c_str());
+        targetFile = targetFileSystem->getFile(resolved.target_path);
+        targetFile->pathInStream = resolved.target_in_stream;
+        //Debug_printv( ANSI_WHITE_BOLD "targetPathInStream[%s] is in sourcePath[%s][%s]", targetFile->pathInStream.c_str(), resolved.target_path.c_str(), targetFileSystem->symbol);
 
-        // Find the container filesystem
-        MFileSystem *sourceFileSystem = &defaultFS;
-        if ( !default_fs )
-        {
-            sourcePath = mstr::joinToString(&begin, &pathIterator, "/");
-            sourcePathInStream = mstr::joinToString(&pathIterator, &end, "/");
-            //Debug_printv("Finding Source FS for sourcePath[%s]", sourcePath.c_str());
-            sourceFileSystem = findParentFS(begin, pathIterator);
-        }
+        // The container filesystem
+        MFileSystem *sourceFileSystem = resolved.source_fs;
 
         // If the target is a root filesystem, then the sourcePathInStream is part of the sourcePath
-        if( (targetFileSystem->isRootFS) && sourcePathInStream.size() )
+        if( (targetFileSystem->isRootFS) && resolved.source_in_stream.size() )
         {
-            //sourcePath += "/" + sourcePathInStream;
-            //sourcePathInStream.clear();
-            targetFile->sourceFile = sourceFileSystem->getFile(sourcePath);
+            targetFile->sourceFile = sourceFileSystem->getFile(resolved.source_path);
         }
         else
         {
             // Recursively set the source file
-            targetFile->sourceFile = File(sourcePath);
-            targetFile->sourceFile->pathInStream = sourcePathInStream;
+            targetFile->sourceFile = File(resolved.source_path);
+            targetFile->sourceFile->pathInStream = resolved.source_in_stream;
         }
-        //Debug_printv( ANSI_RED_BOLD "sourcePath[%s] sourcePathInStream[%s]", sourcePath.c_str(), sourcePathInStream.c_str());
+        //Debug_printv( ANSI_RED_BOLD "sourcePath[%s] sourcePathInStream[%s]", resolved.source_path.c_str(), resolved.source_in_stream.c_str());
 
-        //targetFile->sourceFile->type = sourceFileSystem->symbol;
         targetFile->isWritable = targetFile->sourceFile->isWritable;   // This stream is writable if the container is writable
-        //Debug_printv( ANSI_WHITE_BOLD "sourcePathInStream[%s] is in sourcePath[%s][%s]", sourcePathInStream.c_str(), sourcePath.c_str(), sourceFileSystem->symbol);
-
-        // if (targetFile->sourceFile != nullptr)
-        // {
-        //     Debug_printv("source good rootfs[%d][%s][%s]", sourceFileSystem->isRootFS, targetFile->sourceFile->url.c_str(), targetFile->sourceFile->pathInStream.c_str());
-        // }
-        // else
-        //     Debug_printv("source bad");
     }
 
     // if (targetFile != nullptr)
@@ -800,6 +823,19 @@ MFile* MFSOwner::File(std::string path, bool default_fs) {
         targetFile->name != ".config" &&
         path.find("://") == std::string::npos)
     {
+        // The outcome of the walk below is memoized with the resolution, so
+        // only the first File() of a path pays for the .config probes.
+        uint64_t now = esp_timer_get_time() / 1000ULL;
+        std::string redirect;
+        if (!default_fs && s_resolver.redirect(path, Meatloaf.use_vdrive, now, &redirect))
+        {
+            if (redirect.empty())
+                return targetFile;
+
+            delete targetFile;
+            return File(redirect);
+        }
+
         std::string currentDir = path;
         // A .config can never exist on a path segment inside a container image,
         // so start probing at the container itself. This keeps directory listings
@@ -827,6 +863,9 @@ MFile* MFSOwner::File(std::string path, bool default_fs) {
                 if (cacheIt != cfg.end() && !cacheIt->second.empty())
                     remoteUrl += "#cache=" + cacheIt->second;
 
+                if (!default_fs)
+                    s_resolver.setRedirect(path, Meatloaf.use_vdrive, now, remoteUrl);
+
                 delete targetFile;
                 return File(remoteUrl);
             }
@@ -840,6 +879,9 @@ MFile* MFSOwner::File(std::string path, bool default_fs) {
                 break;
             currentDir = parent;
         }
+
+        if (!default_fs)
+            s_resolver.setRedirect(path, Meatloaf.use_vdrive, now, "");
     }
 
     return targetFile;
@@ -874,32 +916,13 @@ bool MFSOwner::Copy(std::string sourcePath, std::string destPath) {
         return false;
     }
 
-    auto sourceStream = sourceFile->getSourceStream(std::ios_base::in);
-    if (sourceStream == nullptr || !sourceStream->isOpen()) {
-        Debug_printv("Failed to open source file for reading [%s]", sourcePath.c_str());
-        delete sourceFile;
-        delete destFile;
-        return false;
-    }
-
-    auto destStream = destFile->getSourceStream(std::ios_base::out);
-    if (destStream == nullptr || !destStream->isOpen()) {
-        Debug_printv("Failed to open destination file for writing [%s]", destPath.c_str());
-        delete sourceFile;
-        delete destFile;
-        return false;
-    }
-
-    const uint32_t bufferSize = 512;
-    uint8_t buffer[bufferSize];
-    uint32_t bytesRead;
-    while ((bytesRead = sourceStream->read(buffer, bufferSize)) > 0) {
-        destStream->write(buffer, bytesRead);
-    }
+    MCopyResult result = MCopy::file(sourceFile, destFile, MCopyOptions());
+    if (!result.ok())
+        Debug_printv("Copy [%s] to [%s] failed: %s", sourcePath.c_str(), destPath.c_str(), result.message());
 
     delete sourceFile;
     delete destFile;
-    return true;
+    return result.ok();
 }
 
 
@@ -942,42 +965,7 @@ std::string MFSOwner::existsLocal( std::string path )
 }
 
 MFileSystem* MFSOwner::findParentFS(std::vector<std::string>::iterator &begin, std::vector<std::string>::iterator &pathIterator) {
-    while (pathIterator != begin)
-    {
-        pathIterator--;
-
-        auto part = *pathIterator;
-        mstr::toLower(part);
-        //Debug_printv("part[%s]", part.c_str());
-        if ( part.size() )
-        {
-            auto foundFS=std::find_if(availableFS.begin() + 1, availableFS.end(), [&part](MFileSystem* fs){ 
-                //Debug_printv("symbol[%s]", fs->symbol);
-                bool found = fs->handles(part);
-                if ( !found )
-                    return false;
-
-                //Debug_printv("found[%d] part[%s] use_vdrive[%d] vdrive_compatible[%d]", found, part.c_str(), Meatloaf.use_vdrive, fs->vdrive_compatible);
-
-                // If we're using vdrive, and this filesystem is vdrive compatible, skip it
-                if (Meatloaf.use_vdrive && fs->vdrive_compatible)
-                    return false;
-                else
-                    return true;
-            });
-
-            if(foundFS != availableFS.end()) {
-                //Debug_printv("matched[%s] foundFS[%s]", part.c_str(), (*foundFS)->symbol);
-                pathIterator++;
-                return (*foundFS);
-            }
-        }
-    };
-
-    auto fs = *availableFS.begin();  // The first filesystem in the list is the default
-    pathIterator++;
-    //Debug_printv("default[%s]", fs->symbol);
-    return fs;
+    return s_resolver.findParentFS(begin, pathIterator, Meatloaf.use_vdrive);
 }
 
 /********************************************************
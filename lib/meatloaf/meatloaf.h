@@ -119,6 +119,12 @@ public:
         return _size;
     };
 
+    // False while size() is only an upper bound: a file in a disk image
+    // counts whole blocks until its last one has been read.
+    virtual bool isSizeExact() {
+        return true;
+    };
+
     // Declare the extent of a stream that cannot work it out for itself. A
     // media stream opened with NO entry selected (direct access, "#") is the
     // raw container, and nothing sets _size for that view -- which leaves
@@ -177,6 +183,10 @@ public:
     virtual bool isRandomAccess() { return false; };
     virtual bool isNetwork() { return false; }; // Override to true in network stream classes
 
+    // The stream this one reads its bytes through, if any: a disk image's
+    // container file. ImageBroker::checkout() follows it.
+    virtual std::shared_ptr<MStream> container() { return nullptr; }
+
     // Hint that the caller will read this stream sequentially in bulk (e.g.
     // archive extraction reading the whole container forward). Network streams
     // can use this to fetch one continuous response instead of many small
@@ -189,6 +199,27 @@ public:
     virtual uint32_t read(uint8_t* buf, uint32_t size) = 0;
     virtual uint32_t write(const uint8_t *buf, uint32_t size) = 0;
 
+    // Zero-copy read: point 'data' at up to 'size' contiguous bytes at the
+    // current position, held in the stream's OWN memory, and move past them.
+    // Only a stream whose content is already resident can do this (a RAM
+    // CachedFile); everything else returns 0 and the caller read()s instead,
+    // so 0 does not by itself mean end of stream. The bytes are read-only and
+    // stay valid while the stream is open and nothing writes to it.
+    virtual uint32_t borrow(const uint8_t*& data, uint32_t size) {
+        data = nullptr;
+        return 0;
+    }
+
+    // The next run of up to 'size' bytes: borrowed when the stream can lend
+    // them, otherwise read() into 'buf'. 'data' points at wherever they are.
+    uint32_t readSpan(const uint8_t*& data, uint8_t* buf, uint32_t size) {
+        uint32_t n = borrow(data, size);
+        if ( n > 0 )
+            return n;
+        data = buf;
+        return read(buf, size);
+    }
+
     virtual bool seek(uint32_t pos, int mode) {
         uint32_t previous = _position;
         if(mode == SEEK_SET) {
@@ -718,6 +749,12 @@ public:
     // effect immediately instead of after the cache TTL.
     static void invalidateConfigCache();
 
+    // Path resolutions are memoized (meat_resolve.h). A disk image registry
+    // suspends that while it probes raw image bytes, since its filesystem
+    // declines every path for the duration.
+    static void suspendResolveCache();
+    static void resumeResolveCache();
+
 
     static bool mount(std::string name);
     static bool umount(std::string name);
@@ -53,6 +53,8 @@ public:
         block_size = 254;
     };
 
+    uint32_t footprint() override { return sizeof(ARCMStream) + data.capacity(); }
+
 protected:
     // One entry's header, as it sits in the container. The fixed part is
     // version..fnlen, then the name, then two more fields on version 2, then
@@ -476,6 +476,22 @@ bool ArchiveMStream::isOpen() {
     return (m_archive && m_archive->isOpen()) || (m_cachedEntry && m_cachedEntry->isAllocated());
 }
 
+// Find or create ArchiveMSession via SessionBroker
+std::shared_ptr<ArchiveMSession> ArchiveMStream::obtainSession() {
+    std::string sessionKey = "archive:" + url;
+    auto session = SessionBroker::find<ArchiveMSession>(sessionKey);
+    if (!session) {
+        auto newSession = std::make_shared<ArchiveMSession>(url);
+        newSession->connect();
+        // Another drive may have opened it first: use theirs
+        auto kept = SessionBroker::add(sessionKey, newSession);
+        if (kept != newSession)
+            newSession->disconnect();
+        session = std::static_pointer_cast<ArchiveMSession>(kept);
+    }
+    return session;
+}
+
 bool ArchiveMStream::ensureData() {
     if (m_cachedEntry && m_cachedEntry->isAllocated()) {
         return true;
@@ -507,14 +523,7 @@ bool ArchiveMStream::ensureData() {
         return false;
     }
 
-    // Find or create ArchiveMSession via SessionBroker
-    std::string sessionKey = "archive:" + url;
-    m_session = SessionBroker::find<ArchiveMSession>(sessionKey);
-    if (!m_session) {
-        m_session = std::make_shared<ArchiveMSession>(url);
-        m_session->connect();
-        SessionBroker::add(sessionKey, m_session);
-    }
+    m_session = obtainSession();
     m_session->acquireIO();
 
     // Get or extract the entry data
@@ -904,6 +913,37 @@ bool ArchiveMStream::seekCachedFile(const std::string sessionKey, const std::str
     return false;
 }
 
+bool ArchiveMStream::seekIndexedEntry(const std::string &path) {
+    if (!containerStream || !ZipIndex::handles(url)) return false;
+
+    auto session = obtainSession();
+    ZipIndex::Entry found;
+    if (!session->findIndexed(containerStream.get(), path, found) || !ZipIndex::canExtract(found)) {
+        Debug_printv("not in zip index, or not extractable from it: path[%s]", path.c_str());
+        return false;
+    }
+
+    auto cf = ZipIndex::extract(containerStream.get(), found);
+    if (!cf) return false;
+
+    entry.filename = found.filename();
+    entry.pathname = found.pathname;
+    entry.size = found.size;
+    _size = found.size;
+    _position = 0;
+
+    session->cacheFile(entry.filename, cf);
+    m_session = session;
+    m_cachedEntry = cf;
+    m_session->acquireIO();
+
+    // Same as ensureData(): the data is cached, let go of the source chain
+    delete m_archive;
+    m_archive = nullptr;
+    containerStream.reset();
+    return true;
+}
+
 bool ArchiveMStream::nextEntrySimple() {
     if (!m_archive || !m_archive->isOpen()) return false;
 
@@ -944,6 +984,12 @@ bool ArchiveMStream::seekPath(std::string path) {
         return true;
     }
 
+    // Zip: straight to the entry through the central directory
+    if (seekIndexedEntry(path)) {
+        Debug_printv("entry[%s] from zip index (%lu bytes)", entry.filename.c_str(), (unsigned long)_size);
+        return true;
+    }
+
     if (seekEntry(path)) {
         Debug_printv("entry[%s]", entry.filename.c_str());
         _size = entry.size;
@@ -28,11 +28,13 @@
 #include <archive_entry.h>
 
 #include <functional>
+#include <mutex>
 
 #include "../../../include/debug.h"
 #include "meat_media.h"
 #include "meatloaf.h"
 #include "meat_session.h"
+#include "zip_index.h"
 
 
 class Archive {
@@ -130,6 +132,10 @@ public:
 
     void disconnect() override {
         clearFileCache();
+        {
+            std::lock_guard<std::mutex> lock(zipIndexMutex);
+            zipIndex.clear();
+        }
         connected = false;
     }
 
@@ -215,6 +221,26 @@ public:
         cacheFile(entryPath, cf);
         return cf;
     }
+
+    // The index entry for path, building the index from src first if no
+    // drive has yet. Drives opening entries of one archive at once share the
+    // index, so it is built and looked up under zipIndexMutex, and the entry
+    // is copied out: a disconnect() can clear the index once this returns.
+    bool findIndexed(MStream* src, const std::string& path, ZipIndex::Entry& out) {
+        std::lock_guard<std::mutex> lock(zipIndexMutex);
+        if (!zipIndex.isBuilt())
+            zipIndex.build(src);
+        const ZipIndex::Entry* found = zipIndex.find(path);
+        if (!found)
+            return false;
+        out = *found;
+        return true;
+    }
+
+    // Central directory of the container, built on first use by
+    // findIndexed() (zip only)
+    ZipIndex zipIndex;
+    std::mutex zipIndexMutex;
 };
 
 
@@ -287,6 +313,12 @@ class ArchiveMStream : public MMediaStream {
 
    private:
     bool ensureData();
+    std::shared_ptr<ArchiveMSession> obtainSession();
+
+    // Find path in the session's zip index and extract it straight from the
+    // container, without walking libarchive's headers. False whenever the
+    // index can't answer; the caller then falls back to seekEntry().
+    bool seekIndexedEntry(const std::string &path);
 
     Archive *m_archive;
     std::ios_base::openmode m_mode;
@@ -70,6 +70,8 @@ public:
     // listing and the lookup have to agree with it exactly.
     static std::string decodeName(const std::string &raw);
 
+    uint32_t footprint() override { return sizeof(WRAMStream) + data.capacity(); }
+
 protected:
     struct Entry {
         std::string filename;       // as stored; see wra.cpp on its encoding
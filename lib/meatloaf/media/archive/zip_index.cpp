@@ -0,0 +1,329 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "zip_index.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <zlib.h>
+
+#include "meatloaf.h"
+#include "../../../include/debug.h"
+
+#define ZIP_SIG_LOCAL     0x04034b50
+#define ZIP_SIG_CENTRAL   0x02014b50
+#define ZIP_SIG_EOCD      0x06054b50
+
+#define ZIP_LOCAL_HEADER_SIZE   30
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_EOCD_SIZE           22
+#define ZIP_MAX_COMMENT         0xFFFF
+
+#define ZIP_FLAG_ENCRYPTED        0x0001
+#define ZIP_FLAG_STRONG_ENCRYPTED 0x0040
+
+#define ZIP_METHOD_STORED  0
+#define ZIP_METHOD_DEFLATE 8
+
+static inline uint16_t le16(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static inline uint32_t le32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24); }
+
+// Read exactly size bytes at pos, however the source splits them up
+static bool readAt(MStream *src, uint32_t pos, uint8_t *buf, uint32_t size)
+{
+    if (!src->seek(pos))
+        return false;
+    uint32_t got = 0;
+    while (got < size) {
+        uint32_t n = src->read(buf + got, size - got);
+        if (n == 0)
+            return false;
+        got += n;
+    }
+    return true;
+}
+
+bool ZipIndex::handles(const std::string &url)
+{
+    // The same extensions Archive::open() registers only the zip reader for
+    return mstr::endsWith(url, ".zip", false) || mstr::endsWith(url, ".jar", false) ||
+           mstr::endsWith(url, ".rp9", false);
+}
+
+void ZipIndex::clear()
+{
+    m_entries.clear();
+    m_byName.clear();
+    m_built = false;
+}
+
+bool ZipIndex::build(MStream *src)
+{
+    clear();
+    m_built = true;
+
+    if (src == nullptr)
+        return false;
+    const uint32_t total = src->size();
+    if (total < ZIP_EOCD_SIZE)
+        return false;
+
+    // The end of central directory record is the last thing in the file,
+    // followed only by a comment of up to 64 KB. Look in the last 1 KB
+    // first - there's rarely a comment at all - and only then in all of it.
+    std::vector<uint8_t> tail;
+    int32_t eocd = -1;
+    uint32_t tailStart = 0;
+    const uint32_t tries[] = { 1024, ZIP_EOCD_SIZE + ZIP_MAX_COMMENT };
+    for (uint32_t want : tries) {
+        uint32_t len = std::min(want, total);
+        if (len <= tail.size())
+            break;
+        tail.resize(len);
+        tailStart = total - len;
+        if (!readAt(src, tailStart, tail.data(), len)) {
+            Debug_printv("zip index: failed to read the last %lu bytes", (unsigned long)len);
+            return false;
+        }
+        for (int32_t i = (int32_t)len - ZIP_EOCD_SIZE; i >= 0; i--) {
+            if (le32(&tail[i]) == ZIP_SIG_EOCD &&
+                (uint32_t)i + ZIP_EOCD_SIZE + le16(&tail[i + 20]) <= len) {
+                eocd = i;
+                break;
+            }
+        }
+        if (eocd >= 0)
+            break;
+    }
+    if (eocd < 0) {
+        Debug_printv("zip index: no end of central directory record");
+        return false;
+    }
+
+    const uint8_t *e = &tail[eocd];
+    const uint16_t disk = le16(e + 4);
+    const uint16_t cdDisk = le16(e + 6);
+    const uint16_t entries = le16(e + 10);
+    const uint32_t cdSize = le32(e + 12);
+    const uint32_t cdOffset = le32(e + 16);
+
+    // Spanned archives and ZIP64 (0xFFFF.. placeholders) are left to libarchive
+    if (disk != 0 || cdDisk != 0 || entries == 0xFFFF || cdSize == 0xFFFFFFFF || cdOffset == 0xFFFFFFFF) {
+        Debug_printv("zip index: multi-disk or ZIP64 archive, not indexed");
+        return false;
+    }
+    if (cdSize > ZIP_INDEX_MAX_DIRECTORY || entries > ZIP_INDEX_MAX_ENTRIES) {
+        Debug_printv("zip index: directory too large (%u entries, %lu bytes)", entries, (unsigned long)cdSize);
+        return false;
+    }
+
+    // The directory sits right before the record. Anything between where it
+    // says it starts and where it is was prepended (a self-extractor stub),
+    // and every offset in it is off by the same amount.
+    const uint32_t eocdPos = tailStart + eocd;
+    if (cdSize > eocdPos || eocdPos - cdSize < cdOffset) {
+        Debug_printv("zip index: directory offset out of range");
+        return false;
+    }
+    const uint32_t cdStart = eocdPos - cdSize;
+    const uint32_t bias = cdStart - cdOffset;
+
+    std::vector<uint8_t> cd(cdSize);
+    if (cdSize > 0 && !readAt(src, cdStart, cd.data(), cdSize)) {
+        Debug_printv("zip index: failed to read the central directory");
+        return false;
+    }
+
+    m_entries.reserve(entries);
+    uint32_t at = 0;
+    for (uint16_t n = 0; n < entries; n++) {
+        if (at + ZIP_CENTRAL_HEADER_SIZE > cdSize || le32(&cd[at]) != ZIP_SIG_CENTRAL) {
+            Debug_printv("zip index: bad central directory entry %u", n);
+            m_entries.clear();
+            return false;
+        }
+        const uint8_t *h = &cd[at];
+        const uint16_t nameLen = le16(h + 28);
+        const uint32_t next = at + ZIP_CENTRAL_HEADER_SIZE + nameLen + le16(h + 30) + le16(h + 32);
+        if (next > cdSize) {
+            Debug_printv("zip index: central directory entry %u runs past the directory", n);
+            m_entries.clear();
+            return false;
+        }
+
+        std::string pathname((const char *)h + ZIP_CENTRAL_HEADER_SIZE, nameLen);
+        at = next;
+
+        // Directories, and anything a Unix zip marks as other than a regular
+        // file (symlinks), aren't entries seekEntry() would ever match
+        if (pathname.empty() || pathname.back() == '/')
+            continue;
+        const uint8_t host = h[5];
+        const uint32_t mode = le32(h + 38) >> 16;
+        if (host == 3 && (mode & 0170000) != 0 && (mode & 0170000) != 0100000)
+            continue;
+
+        Entry entry;
+        size_t slash = pathname.find_last_of('/');
+        entry.nameOffset = (slash == std::string::npos) ? 0 : (uint16_t)(slash + 1);
+        entry.pathname = std::move(pathname);
+        entry.flags = le16(h + 8);
+        entry.method = le16(h + 10);
+        entry.crc = le32(h + 16);
+        entry.compressedSize = le32(h + 20);
+        entry.size = le32(h + 24);
+        entry.offset = le32(h + 42);
+        if (entry.offset != 0xFFFFFFFF)
+            entry.offset += bias;
+        m_entries.push_back(std::move(entry));
+    }
+
+    // libarchive's seekable reader hands entries out in local header order,
+    // so "first match" has to mean the same here
+    std::stable_sort(m_entries.begin(), m_entries.end(),
+                     [](const Entry &a, const Entry &b) { return a.offset < b.offset; });
+
+    m_byName.reserve(m_entries.size());
+    for (uint32_t i = 0; i < m_entries.size(); i++)
+        m_byName.emplace(m_entries[i].filename(), i);
+
+    Debug_printv("zip index: %u files, directory %lu bytes at %lu", (unsigned)m_entries.size(),
+                 (unsigned long)cdSize, (unsigned long)cdStart);
+    return true;
+}
+
+const ZipIndex::Entry *ZipIndex::find(const std::string &name) const
+{
+    if (name.empty())
+        return nullptr;
+
+    bool wildcard = (name.find('*') != std::string::npos || name.find('?') != std::string::npos);
+    if (!wildcard) {
+        auto it = m_byName.find(name);
+        return (it == m_byName.end()) ? nullptr : &m_entries[it->second];
+    }
+
+    for (const Entry &e : m_entries) {
+        std::string entryName = e.filename();
+        std::string pattern = name;
+        if (mstr::compareFilename(entryName, pattern, true))
+            return &e;
+    }
+    return nullptr;
+}
+
+bool ZipIndex::canExtract(const Entry &e)
+{
+    if (e.flags & (ZIP_FLAG_ENCRYPTED | ZIP_FLAG_STRONG_ENCRYPTED))
+        return false;
+    if (e.compressedSize == 0xFFFFFFFF || e.size == 0xFFFFFFFF || e.offset == 0xFFFFFFFF)
+        return false;
+    // Empty entries take getEntry()'s unknown-size path; not worth a special case
+    if (e.size == 0)
+        return false;
+    if (e.method == ZIP_METHOD_STORED)
+        return e.compressedSize == e.size;
+    return e.method == ZIP_METHOD_DEFLATE;
+}
+
+std::shared_ptr<MSession::CachedFile> ZipIndex::extract(MStream *src, const Entry &e)
+{
+    if (src == nullptr || !canExtract(e))
+        return nullptr;
+
+    // The local header repeats the name and carries its own extra field,
+    // which can differ in length from the central directory's copy
+    uint8_t local[ZIP_LOCAL_HEADER_SIZE];
+    if (!readAt(src, e.offset, local, sizeof(local)) || le32(local) != ZIP_SIG_LOCAL) {
+        Debug_printv("zip index: no local header for [%s] at %lu", e.pathname.c_str(), (unsigned long)e.offset);
+        return nullptr;
+    }
+    const uint32_t dataStart = e.offset + ZIP_LOCAL_HEADER_SIZE + le16(local + 26) + le16(local + 28);
+    if (dataStart + (uint64_t)e.compressedSize > src->size() || !src->seek(dataStart)) {
+        Debug_printv("zip index: data for [%s] runs past the archive", e.pathname.c_str());
+        return nullptr;
+    }
+
+    std::vector<uint8_t> in(ZIP_INDEX_READ_BLOCK);
+    uint32_t remaining = e.compressedSize;  // Compressed bytes not yet read
+    uint32_t crc = crc32(0L, Z_NULL, 0);
+    bool failed = false;
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (e.method == ZIP_METHOD_DEFLATE && inflateInit2(&zs, -MAX_WBITS) != Z_OK)
+        return nullptr;
+
+    // Called for each page of the CachedFile; the source is read front to
+    // back exactly once
+    auto reader = [&](uint8_t *buf, uint32_t n) -> uint32_t {
+        uint32_t produced = 0;
+        if (e.method == ZIP_METHOD_STORED) {
+            while (produced < n) {
+                uint32_t r = src->read(buf + produced, n - produced);
+                if (r == 0)
+                    break;
+                produced += r;
+            }
+        } else {
+            zs.next_out = buf;
+            zs.avail_out = n;
+            while (zs.avail_out > 0) {
+                if (zs.avail_in == 0 && remaining > 0) {
+                    uint32_t r = src->read(in.data(), std::min<uint32_t>(remaining, in.size()));
+                    if (r == 0)
+                        break;
+                    remaining -= r;
+                    zs.next_in = in.data();
+                    zs.avail_in = r;
+                }
+                int ret = inflate(&zs, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END)
+                    break;
+                if (ret != Z_OK) {
+                    Debug_printv("zip index: inflate error %d on [%s]", ret, e.pathname.c_str());
+                    failed = true;
+                    break;
+                }
+            }
+            produced = n - zs.avail_out;
+        }
+        crc = crc32(crc, buf, produced);
+        return produced;
+    };
+
+    // One continuous read of just this entry's bytes
+    src->setSequentialAccess(true);
+    auto cf = std::make_shared<MSession::CachedFile>(e.size);
+    bool ok = cf->loadViaReader(e.size, reader) && !failed;
+    src->setSequentialAccess(false);
+
+    if (e.method == ZIP_METHOD_DEFLATE)
+        inflateEnd(&zs);
+
+    if (!ok) {
+        Debug_printv("zip index: failed to extract [%s]", e.pathname.c_str());
+        return nullptr;
+    }
+    if (crc != e.crc) {
+        Debug_printv("zip index: CRC mismatch on [%s] (%08lx, expected %08lx)", e.pathname.c_str(),
+                     (unsigned long)crc, (unsigned long)e.crc);
+        return nullptr;
+    }
+    return cf;
+}
@@ -0,0 +1,114 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// .ZIP central directory index
+//
+// https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+//
+// Finding one entry through libarchive means walking archive_read_next_header()
+// from the first entry until the name matches - and the seekable zip reader
+// visits every local header on the way, which over HTTP is a range request per
+// entry. The central directory at the end of the file already lists every
+// name with its offset, sizes and method, so it is read once per container
+// (a couple of requests), kept on the ArchiveMSession, and an entry is then
+// extracted by seeking straight to its data.
+//
+// Only what can be extracted here is served from the index: stored or
+// deflated, unencrypted, non-ZIP64 entries. Anything else - and any archive
+// whose directory can't be read - falls back to libarchive.
+//
+
+#ifndef MEATLOAF_ARCHIVE_ZIP_INDEX
+#define MEATLOAF_ARCHIVE_ZIP_INDEX
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef TEST_NATIVE
+#include "sdkconfig.h"
+#endif
+
+#include "meat_session.h"
+
+class MStream;
+
+// Largest central directory / entry count we're willing to hold in memory.
+// A 2,000 entry zip of C64 files has a directory of roughly 120 KB.
+#ifndef ZIP_INDEX_MAX_ENTRIES
+#ifdef CONFIG_SPIRAM
+#define ZIP_INDEX_MAX_DIRECTORY (1024 * 1024)
+#define ZIP_INDEX_MAX_ENTRIES   8192
+#else
+#define ZIP_INDEX_MAX_DIRECTORY (32 * 1024)
+#define ZIP_INDEX_MAX_ENTRIES   512
+#endif
+#endif
+
+// Compressed bytes pulled from the source per read while extracting
+#define ZIP_INDEX_READ_BLOCK 4096
+
+class ZipIndex {
+   public:
+    struct Entry {
+        std::string pathname;     // As stored, e.g. "games/ELITE.D64"
+        uint16_t nameOffset;      // Start of the basename within pathname
+        uint16_t method;          // 0 = stored, 8 = deflate, others not extracted here
+        uint16_t flags;           // General purpose bit flags
+        uint32_t crc;
+        uint32_t compressedSize;
+        uint32_t size;
+        uint32_t offset;          // Local header, absolute in the source
+
+        std::string filename() const { return pathname.substr(nameOffset); }
+    };
+
+    // True for the containers an index is built for
+    static bool handles(const std::string &url);
+
+    // Read the end of central directory record and the directory itself.
+    // Only tried once: afterwards isBuilt() is true whether it worked or not,
+    // and a failed build leaves the index empty.
+    bool build(MStream *src);
+    bool isBuilt() const { return m_built; }
+    void clear();
+
+    size_t count() const { return m_entries.size(); }
+    const Entry &at(size_t i) const { return m_entries[i]; }
+
+    // First regular file, in archive order, whose basename matches - the
+    // same answer ArchiveMStream::seekEntry(filename) gives, except that a
+    // wildcard never lands on a directory entry. Wildcards ('*', '?') follow
+    // mstr::compareFilename().
+    const Entry *find(const std::string &name) const;
+
+    // Whether extract() can produce this entry
+    static bool canExtract(const Entry &e);
+
+    // Seek to the entry's data and decode it into a new CachedFile, checking
+    // the CRC. nullptr on any failure.
+    static std::shared_ptr<MSession::CachedFile> extract(MStream *src, const Entry &e);
+
+   private:
+    std::vector<Entry> m_entries;                    // Regular files, by offset
+    std::unordered_map<std::string, uint32_t> m_byName;  // Basename -> first index in m_entries
+    bool m_built = false;
+};
+
+#endif // MEATLOAF_ARCHIVE_ZIP_INDEX
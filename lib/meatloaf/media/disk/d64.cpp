@@ -167,6 +167,8 @@ std::string D64MStream::readBlock(uint8_t track, uint8_t sector)
 
 bool D64MStream::writeBlock(uint8_t track, uint8_t sector, std::string data)
 {
+    // Any block may be a directory or BAM sector
+    DirectoryCache::invalidate(url);
     if (!seekSector(track, sector, 0))
         return false;
 
@@ -221,6 +223,8 @@ bool D64MStream::readBAMRecord(uint8_t track, BAMRecord *rec, uint8_t *buf)
 
 bool D64MStream::setBlockAllocation(uint8_t track, uint8_t sector, bool allocate)
 {
+    // Blocks free is part of every listing
+    DirectoryCache::invalidate(url);
     BAMRecord rec;
     uint8_t buf[32]; // largest byte_count in use is 32 (DNP/DHD native: 256 sectors/track)
     if (!readBAMRecord(track, &rec, buf))
@@ -273,6 +277,8 @@ bool D64MStream::deallocateBlock(uint8_t track, uint8_t sector)
 
 bool D64MStream::validateBAM()
 {
+    DirectoryCache::invalidate(url);
+
     // TODO: Walk each files blocks to ensure the BAM accurately reflects the allocation.
     // Correct the BAM if it is not accurate.
     // Make safe for REL and VLIR files.
@@ -551,6 +557,18 @@ bool D64MStream::isBlockFree(uint8_t track, uint8_t sector)
     return (buf[byte_index] & bitmask) == bitmask;
 }
 
+// A directory entry's name as UTF-8: its 16 bytes up to the first $A0 pad
+// (or NUL), transcoded straight from the entry into 'name'
+static void entryNameToUTF8(const char (&filename)[16], std::string &name)
+{
+    size_t len = 0;
+    while (len < 16 && filename[len] != '\0' && (uint8_t)filename[len] != 0xA0)
+        len++;
+
+    char utf8[16 * U8Char::UTF8_PER_PETSCII];
+    name.assign(utf8, U8Char::petsciiToUtf8((const uint8_t *)filename, len, utf8, sizeof(utf8)));
+}
+
 bool D64MStream::seekEntry( std::string filename )
 {
     // Read Directory Entries
@@ -559,6 +577,7 @@ bool D64MStream::seekEntry( std::string filename )
         uint16_t index = 1;
         mstr::replaceAll(filename, "\\", "/");
         bool wildcard = (mstr::contains(filename, "*") || mstr::contains(filename, "?"));
+        std::string entryFilename;
         while (seekEntry(index))
         {
             if (entry.file_type == 0x00) // Skip deleted/never-used entries
@@ -573,11 +592,7 @@ bool D64MStream::seekEntry( std::string filename )
                 continue;
             }
 
-            std::string entryFilename = entry.filename;
-            size_t i = entryFilename.find_first_of(0xA0);
-            if (i == std::string::npos || i > 16) i = 16;
-            entryFilename = entryFilename.substr(0, i);
-            entryFilename = mstr::toUTF8(entryFilename);
+            entryNameToUTF8(entry.filename, entryFilename);
 
             //Debug_printv("index[%d] track[%d] sector[%d] filename[%s] entry.filename[%.16s]", index, track, sector, filename.c_str(), entryFilename.c_str());
             //Debug_printv("filename[%s] entry[%s]", filename.c_str(), entryFilename.c_str());
@@ -706,6 +721,8 @@ bool D64MStream::readEntry( uint16_t index ) {
     return seekEntry(index);
 }
 bool D64MStream::writeEntry( uint16_t index) {
+    // Any listing of this image read so far no longer describes it
+    DirectoryCache::invalidate(url);
     if ( seekEntry(index - 1) ) {
         return writeContainer((uint8_t*)&entry, sizeof(entry));
     }
@@ -799,6 +816,7 @@ uint32_t D64MStream::writeFileNew(uint8_t *buf, uint32_t size)
 bool D64MStream::finalizeFileWrite()
 {
     creating = false;
+    DirectoryCache::invalidate(url);
 
     // Write the final block: link track 0, "sector" = offset of last used byte
     std::string block(block_size, '\0');
@@ -911,7 +929,9 @@ bool D64MStream::finalizeFileWrite()
 
 void D64MStream::rollbackFileWrite()
 {
-    // Free every block claimed for this file; no directory entry was written
+    // Free every block claimed for this file; no directory entry was written,
+    // but blocks free goes back up
+    DirectoryCache::invalidate(url);
     for (auto &b : create_allocated)
         deallocateBlock(b.track, b.sector);
     create_allocated.clear();
@@ -947,6 +967,7 @@ bool D64MStream::seekScratchedEntry(std::string filename)
     bool wildcard = (mstr::contains(filename, "*") || mstr::contains(filename, "?"));
 
     uint16_t index = 1;
+    std::string entryFilename;
     while (seekEntry(index))
     {
         // Only scratched entries are candidates. A never-used slot is also
@@ -957,10 +978,7 @@ bool D64MStream::seekScratchedEntry(std::string filename)
             continue;
         }
 
-        std::string entryFilename = entry.filename;
-        size_t i = entryFilename.find_first_of(0xA0);
-        if (i == std::string::npos || i > 16) i = 16;
-        entryFilename = mstr::toUTF8(entryFilename.substr(0, i));
+        entryNameToUTF8(entry.filename, entryFilename);
 
         if (!entryFilename.empty() &&
             mstr::compareFilename(entryFilename, filename, wildcard))
@@ -974,6 +992,7 @@ bool D64MStream::seekScratchedEntry(std::string filename)
 
 bool D64MStream::unscratchEntry()
 {
+    DirectoryCache::invalidate(url);
     uint8_t dir_track = track;
     uint8_t dir_sector = sector;
     uint8_t slot = (entry_index - 1) % 8;
@@ -1065,6 +1084,7 @@ bool D64MStream::removeFile(std::string path)
 // 'entry' holds the file and track/sector point at its directory sector.
 bool D64MStream::scratchEntry()
 {
+    DirectoryCache::invalidate(url);
     uint8_t dir_track = track;
     uint8_t dir_sector = sector;
     uint8_t slot = (entry_index - 1) % 8;
@@ -1098,6 +1118,7 @@ void D64MStream::close()
     if (creating && !_error)
         finalizeFileWrite();
     creating = false;
+    dropPrefetch();
     MMediaStream::close();
 }
 
@@ -1148,6 +1169,103 @@ uint16_t D64MStream::blocksFree()
     return free_count;
 }
 
+void D64MStream::dropPrefetch()
+{
+    file_blocks.clear();
+    file_blocks.shrink_to_fit();
+    run.clear();
+    run.shrink_to_fit();
+    run_count = 0;
+    chained = false;
+}
+
+// The block at track/sector, from the run in memory when it holds it and
+// otherwise by reading a new run that starts there. The 1541's file
+// interleave of 10 puts two blocks of a file in each run, and the
+// track-to-track hops usually land in the run before it is dropped, so a
+// file costs a few reads per track rather than one per block. The GCR
+// formats decode each sector from track data: their run is the one sector.
+const uint8_t *D64MStream::blockData(uint8_t track, uint8_t sector)
+{
+    if (run_count && track == run_track && sector >= run_sector && sector < run_sector + run_count)
+        return &run[(sector - run_sector) * block_size];
+
+    uint16_t count = getSectorCount(track);
+    run_count = 1;
+    if (sectorsAreLinear() && sector < count)
+        run_count = std::min<uint32_t>(count - sector, D64_PREFETCH_RUN);
+    run.resize(run_count * block_size);
+    if (run_count > 1 && (!seekSector(track, sector) || readContainer(run.data(), run.size()) != run.size()))
+    {
+        // Truncated image: the run reached past its end. The block itself
+        // may still be there.
+        run_count = 1;
+        run.resize(block_size);
+    }
+    if (run_count == 1 && (!seekSector(track, sector) || readContainer(run.data(), block_size) != block_size))
+    {
+        run_count = 0;
+        return nullptr;
+    }
+    run_track = track;
+    run_sector = sector;
+    return run.data();
+}
+
+// Block 'index' of the selected file, following links from the last block
+// already known. Null past the end of the chain or where it breaks. Bounded
+// by the entry's own block count where it has one, so a corrupt link cannot
+// spin forever on the IEC task.
+const uint8_t *D64MStream::chainBlock(uint32_t index)
+{
+    if (file_blocks.empty())
+        file_blocks.push_back({ entry.start_track, entry.start_sector });
+
+    const uint32_t guard = entry.blocks ? (uint32_t)entry.blocks + 2 : 10000;
+    while (file_blocks.size() <= index)
+    {
+        const uint8_t *data = blockData(file_blocks.back().track, file_blocks.back().sector);
+        if (data == nullptr || data[0] == 0 || file_blocks.size() >= guard)
+            return nullptr;
+        file_blocks.push_back({ data[0], data[1] });
+    }
+    return blockData(file_blocks[index].track, file_blocks[index].sector);
+}
+
+// A zero link track marks the last block; its sector byte is then the offset
+// of the last used byte, so it holds that minus one bytes of data.
+// seekFileSize() and readFile() count it the same way.
+static uint32_t blockBytes(const uint8_t *data, uint32_t data_per_block)
+{
+    if (data[0] != 0)
+        return data_per_block;
+    return std::min<uint32_t>(data[1] > 1 ? data[1] - 1 : 0, data_per_block);
+}
+
+uint32_t D64MStream::readChained(uint8_t *buf, uint32_t size)
+{
+    const uint32_t data_per_block = block_size - 2;
+    const uint32_t index = _position / data_per_block;
+    const uint32_t offset = _position % data_per_block;
+
+    const uint8_t *data = chainBlock(index);
+    if (data == nullptr)
+        return 0;
+
+    const uint32_t used = blockBytes(data, data_per_block);
+    if (data[0] == 0)
+    {
+        _size = index * data_per_block + used;   // exact once the end is seen
+        size_exact = true;
+    }
+    if (offset >= used)
+        return 0;
+
+    size = std::min(size, used - offset);
+    memcpy(buf, data + 2 + offset, size);
+    return size;
+}
+
 bool D64MStream::seek(uint32_t offset)
 {
     // No file selected: the stream is the raw image, and MMediaStream::seek()
@@ -1162,15 +1280,42 @@ bool D64MStream::seek(uint32_t offset)
     // the next block -- so 254 bytes of FILE data per block on a 1541.
     const uint32_t data_per_block = block_size - 2;
 
-    uint8_t t = entry.start_track;
-    uint8_t s = entry.start_sector;
-    uint32_t remaining = offset;
+    uint32_t index = offset / data_per_block;
+    uint32_t remaining = offset % data_per_block;
+
+    if ( chained )
+    {
+        // An offset just past a last block that is full has no block of
+        // its own; it is the end of the file.
+        const uint8_t *data = chainBlock( index );
+        if ( data == nullptr )
+        {
+            if ( remaining || index == 0 )
+                return false;
+            data = chainBlock( index - 1 );
+            if ( data == nullptr || data[0] != 0 || blockBytes( data, data_per_block ) != data_per_block )
+                return false;
+        }
+        else if ( data[0] == 0 && remaining > blockBytes( data, data_per_block ) )
+            return false;
+
+        _position = offset;
+        return true;
+    }
+
+    // Start from the furthest block already known on the way to the target,
+    // so only the links past it are walked -- none at all once the chain has
+    // been resolved. Bounded by the entry's own block count where it has one,
+    // so a corrupt link cannot spin forever on the IEC task.
+    if ( file_blocks.empty() )
+        file_blocks.push_back( { entry.start_track, entry.start_sector } );
+
+    uint32_t at = std::min<uint32_t>( index, file_blocks.size() - 1 );
+    uint8_t t = file_blocks[at].track;
+    uint8_t s = file_blocks[at].sector;
 
-    // Walk the chain from the file's first block. Bounded by the entry's own
-    // block count where it has one, so a corrupt link cannot spin forever on
-    // the IEC task.
     uint32_t guard = entry.blocks ? (uint32_t) entry.blocks + 2 : 10000;
-    while ( remaining >= data_per_block )
+    while ( at < index )
     {
         if ( !seekSector( t, s ) )
             return false;
@@ -1185,9 +1330,10 @@ bool D64MStream::seek(uint32_t offset)
 
         t = link_track;
         s = link_sector;
-        remaining -= data_per_block;
+        file_blocks.push_back( { t, s } );
+        at++;
 
-        if ( guard-- == 0 )
+        if ( file_blocks.size() > guard )
             return false;
     }
 
@@ -1216,6 +1362,9 @@ bool D64MStream::seek(uint32_t offset)
 uint32_t D64MStream::readFile(uint8_t *buf, uint32_t size)
 {
     //Debug_printv("readFile(%lu) sector_offset[%d] pos[%lu]", size, sector_offset, _position);
+    if (chained)
+        return readChained(buf, size);
+
     if (sector_offset % block_size == 0)
     {
         // If we previously read a block header with next_track==0 (EOF) and the last block
@@ -1224,6 +1373,10 @@ uint32_t D64MStream::readFile(uint8_t *buf, uint32_t size)
         if (sector_offset > 0 && next_track == 0)
             return 0;
 
+        // Entering block n of the file: remember where it lives for seek().
+        if (file_blocks.size() == _position / (block_size - 2))
+            file_blocks.push_back({ track, sector });
+
         // We are at the beginning of the block
         // Read track/sector link
         readContainer((uint8_t *)&next_track, 1);
@@ -1249,6 +1402,7 @@ uint32_t D64MStream::readFile(uint8_t *buf, uint32_t size)
                 _size += lastBlockBytes;
                 //Debug_printv("End of file reached with 0 available bytes, adjusting size to [%lu]", _size);
             }
+            size_exact = true;
         }
         else if ( available() == 0 )
         {
@@ -1439,6 +1593,8 @@ bool D64MStream::seekPath(std::string path)
     next_sector = 0;
     sector_offset = 0;
     _position = 0;
+    size_exact = true;
+    dropPrefetch();
 
     entry_index = 0;
 
@@ -1509,11 +1665,16 @@ bool D64MStream::seekPath(std::string path)
             // entry.blocks * (block_size-2) always >= actual byte size, so the chain-end
             // marker (track=0) fires before _size is reached — safe upper bound.
             _size = (uint32_t)entry.blocks * (block_size - 2);
+            size_exact = false;
             //Debug_printv("Network stream: using blocks[%d] → size[%lu]", entry.blocks, _size);
         //} else {
         //    _size = seekFileSize(t, s);
         //}
 
+        // Read in runs when reading; a write stream must see the image as
+        // it changes instead.
+        chained = !(mode & std::ios_base::out);
+
         // Set position to beginning of file
         bool r = seekSector(t, s);
 
@@ -1535,6 +1696,8 @@ bool D64MStream::seekPath(std::string path)
 
 bool D64MStream::formatImage(std::string name, std::string id, size_t track_count, bool error_info)
 {
+    DirectoryCache::invalidate(url);
+
     // Settle the geometry BEFORE anything is laid out: initializeBlocks() fills
     // every track and initializeBlockAllocationMap() writes one BAM entry per
     // track, and both read end_track. A non-zero track_count is how a 40- or
@@ -1658,9 +1821,37 @@ bool D64MFile::format(std::string header_info)
 }
 
 
+void D64MFile::listingValidator(uint32_t& size, time_t& mtime)
+{
+    size = (sourceFile != nullptr) ? sourceFile->size : 0;
+    mtime = (sourceFile != nullptr) ? sourceFile->getLastWrite() : 0;
+}
+
 bool D64MFile::rewindDirectory()
 {
     dirIsOpen = true;
+    m_listing.reset();
+    m_recording.reset();
+
+    uint32_t sourceSize;
+    time_t sourceTime;
+    listingValidator(sourceSize, sourceTime);
+    auto listing = DirectoryCache::find(brokerUrl(), sourceSize, sourceTime);
+    if (listing)
+    {
+        media_header = listing->header;
+        media_id = listing->id;
+        media_blocks_free = listing->blocks_free;
+        media_block_size = listing->block_size;
+        media_image = name;
+        if ( sourceFile != nullptr && !sourceFile->media_archive.empty() )
+            media_archive = sourceFile->media_archive;
+
+        m_listing = listing;
+        m_listingPos = 0;
+        return true;
+    }
+
     //Debug_printv("url[%s] sourceFile->url[%s]", url.c_str(), sourceFile->url.c_str());
     auto image = ImageBroker::obtain<D64MStream>("d64", brokerUrl());
     if (image == nullptr)
@@ -1696,6 +1887,13 @@ bool D64MFile::rewindDirectory()
     if ( !sourceFile->media_archive.empty() )
         media_archive = sourceFile->media_archive;
 
+    // Recorded as getNextFileInDir() walks it; kept only if walked to the end
+    m_recording = std::make_shared<DirectoryListing>();
+    m_recording->header = media_header;
+    m_recording->id = media_id;
+    m_recording->blocks_free = media_blocks_free;
+    m_recording->block_size = media_block_size;
+
     return true;
 }
 
@@ -1721,25 +1919,43 @@ MFile* D64MFile::getNextFileInDir()
     if (!dirIsOpen && !rewindDirectory())
         return nullptr;
 
+    if (m_listing)
+    {
+        if (m_listingPos < m_listing->entries.size())
+        {
+            const DirectoryListing::Entry& e = m_listing->entries[m_listingPos++];
+            auto file = MFSOwner::File(entryUrlFor(e.name));
+            file->name = e.name;
+            file->extension = e.extension;
+            file->size = e.size;
+            file->is_dir = e.is_dir;
+            if (e.is_hidden)
+                file->is_hidden = 1;
+            return file;
+        }
+        m_listing.reset();
+        dirIsOpen = false;
+        return nullptr;
+    }
+
     // Get entry pointed to by containerStream
     auto image = ImageBroker::obtain<D64MStream>("d64", brokerUrl());
     if (image == nullptr)
+    {
+        m_recording.reset();
         goto exit;
+    }
 
     r = image->getNextImageEntry();
 
     if (r)
     {
-        std::string filename = image->entry.filename;
-        size_t i = filename.find_first_of(0xA0);
-        if (i == std::string::npos || i > 16) i = 16;
-        filename = filename.substr(0, i);
-        // mstr::rtrimA0(filename);
         // The directory holds PETSCII. Convert HERE, before the entry URL is
         // built from it, so the name a listing shows is the name seekEntry()
         // matches (it converts the on-disk name the same way) and the name
         // that can be typed back.
-        filename = mstr::toUTF8(filename);
+        std::string filename;
+        entryNameToUTF8(image->entry.filename, filename);
         mstr::replaceAll(filename, "/", "\\");
         //Debug_printv( "entry[%s]", (url + "/" + filename).c_str() );
 
@@ -1754,9 +1970,23 @@ MFile* D64MFile::getNextFileInDir()
 
         //Debug_printv("name[%s] ext[%s][%02X] size[%lu] is_dir[%d] is_hidden[%d]", file->name.c_str(), file->extension.c_str(), image->entry.file_type, file->size, file->is_dir, file->is_hidden);
 
+        if (m_recording)
+            m_recording->entries.push_back({ file->name, file->extension, file->size,
+                                             file->is_dir == 1, file->is_hidden == 1 });
         return file;
     }
 
+    if (m_recording)
+    {
+        uint32_t sourceSize;
+        time_t sourceTime;
+        listingValidator(sourceSize, sourceTime);
+        // Filed under the url the image stream was opened with: the one its
+        // writes invalidate
+        DirectoryCache::store(brokerUrl(), image->url, sourceSize, sourceTime, m_recording);
+        m_recording.reset();
+    }
+
 exit:
     // Debug_printv( "END OF DIRECTORY");
     dirIsOpen = false;
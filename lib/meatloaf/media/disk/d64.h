@@ -46,6 +46,14 @@
 #include "utils.h"
 
 
+// Most sectors fetched with one container read while reading a file. A CMD
+// native track is 256 sectors, so the run is capped rather than "to the end
+// of the track".
+#ifndef D64_PREFETCH_RUN
+#define D64_PREFETCH_RUN        32
+#endif
+
+
 /********************************************************
  * Streams
  ********************************************************/
@@ -323,6 +331,8 @@ public:
 
     virtual bool seekPath(std::string path) override;
     uint32_t readFile(uint8_t* buf, uint32_t size) override;
+    uint32_t footprint() override { return sizeof(D64MStream) + bufferedBytes(); }
+    bool isSizeExact() override { return size_exact; }
 
     // Seek to any byte offset within the SELECTED file, by walking its block
     // chain -- the base class seeks the container, which is meaningless for a
@@ -405,6 +415,45 @@ public:
 
 protected:
 
+    // Whether _size is the file's: seekPath() can only count its blocks,
+    // and the last one says how much of it is used
+    bool size_exact = true;
+
+    // The selected file's block chain as far as it is known: file_blocks[i]
+    // holds the i-th block, so seek() is an index lookup for any block already
+    // visited and only walks the links past the last one.
+    BlockChain file_blocks;
+
+    // A stream opened for reading reads its file a run of sectors at a time,
+    // from the wanted one to the end of its track (D64_PREFETCH_RUN at most),
+    // and keeps only the last run: later blocks of the file that landed in it
+    // need no further container read. Nothing is read before the first
+    // readFile() or seek() asks for it.
+    bool chained = false;
+    std::vector<uint8_t> run;
+    uint8_t run_track = 0;
+    uint8_t run_sector = 0;
+    uint16_t run_count = 0;
+
+    const uint8_t *blockData(uint8_t track, uint8_t sector);
+    const uint8_t *chainBlock(uint32_t index);
+    uint32_t readChained(uint8_t *buf, uint32_t size);
+    void dropPrefetch();
+
+    // What every stream of the family holds beyond its own members: the
+    // partitions, the file's chain and the run read last. A format's
+    // footprint() adds this to its own size and buffers.
+    uint32_t bufferedBytes()
+    {
+        return (partitions.size() * sizeof(Partition))
+             + (file_blocks.capacity() * sizeof(Block)) + run.capacity();
+    }
+
+    // True when sector n+1 of a track follows sector n in the container, so a
+    // run of them can be fetched with a single read. The GCR formats decode
+    // every sector from its track's bitstream and say no.
+    virtual bool sectorsAreLinear() { return true; }
+
     virtual bool readHeader() override
     {
         memset(&header, 0, sizeof(header));
@@ -860,6 +909,14 @@ public:
 
     bool isDir = true;
     bool dirIsOpen = false;
+
+private:
+    // What DirectoryCache checks a listing of this image against
+    void listingValidator(uint32_t& size, time_t& mtime);
+
+    std::shared_ptr<const DirectoryListing> m_listing;  // Being replayed from DirectoryCache
+    size_t m_listingPos = 0;
+    std::shared_ptr<DirectoryListing> m_recording;      // Being filled by a walk of the image
 };
 
 
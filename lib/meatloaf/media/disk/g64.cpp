@@ -34,12 +34,62 @@ static uint8_t gcr_decode_low[32] = {
 	0xff, 0x09, 0x0a, 0x0b, 0xff, 0x0d, 0x0e, 0xff
 };
 
+// MStream::read() returns at most one block, so a caller wanting `len` bytes
+// has to loop until it has them or the stream stops giving.
+static bool g64_read_at(MStream *stream, uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    if (stream == nullptr || !stream->seek(offset))
+        return false;
+
+    uint32_t got = 0;
+    while (got < len)
+    {
+        uint32_t n = stream->read(buf + got, len - got);
+        if (n == 0)
+            return false;
+        got += n;
+    }
+    return true;
+}
+
+// A track is a loop: the bytes at its end run on into the bytes at its start,
+// and a sector the mastering put across that seam is still a sector. Reads
+// past `size` therefore wrap.
+static inline uint8_t g64_byte(const uint8_t *gcr, uint32_t size, uint32_t p)
+{
+    return gcr[p % size];
+}
+
+// Byte-wise scan for a sync mark in [p, end), returning the offset of the first
+// byte after it, or -1. The same rule the stream-based scan used.
+static int g64_find_sync(const uint8_t *gcr, uint32_t size, uint32_t p, uint32_t end)
+{
+    uint8_t previous = 0x00;
+
+    while (p < end)
+    {
+        uint8_t current = g64_byte(gcr, size, p++);
+
+        // The sync flag goes up after the tenth 1 bit.
+        if ((previous & 0x03) == 0x03 && current == 0xff)
+        {
+            // Step over the rest of the sync.
+            while (p < end && g64_byte(gcr, size, p) == 0xff)
+                p++;
+            return (p < end) ? (int)p : -1;
+        }
+
+        previous = current;
+    }
+
+    return -1;
+}
+
+
 // GCR Utility Functions
 
 bool G64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
 {
-    uint32_t sectorOffset = 0;
-
     //Debug_printv("track[%d] sector[%d] offset[%d]", track, sector, offset);
 
     // Is this a valid track?
@@ -60,67 +110,33 @@ bool G64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
         return false;
     }
 
+    DecodedTrack *t = decodedTrack(track);
+    if (t == nullptr)
+        return false;
 
-    track--;
-
-    uint8_t gcr_track = (track * 2);
-    uint32_t gcr_track_offset = TRACK_TABLE_OFFSET + (gcr_track * 4);
-    containerStream->seek(gcr_track_offset);
-    containerStream->read((uint8_t *)&gcr_track_offset, sizeof(gcr_track_offset));
-
-    uint16_t gcr_track_size = 0x00;
-    containerStream->seek(gcr_track_offset);
-    containerStream->read((uint8_t *)&gcr_track_size, sizeof(gcr_track_size));
-    gcr_track_offset += 2;
-    uint32_t gcr_track_end = gcr_track_offset + gcr_track_size;
-
-    track++;
-
-    sectorOffset = gcr_track_offset + (sector * 360);
-    containerStream->seek( sectorOffset );
-
-    // This loop used to be a do/while that ignored findSync()'s result and
-    // spun until the header matched. When the sector is not on the track that
-    // never happens: findSync() seeks BACK to gcr_track_end and returns false,
-    // so the stream position stops advancing, the same bytes are re-read, and
-    // the comparison never changes - a hang, on the IEC task. The bound is a
-    // track's 21 sectors plus slack for false syncs in the gaps.
-    bool found = false;
-    for ( uint8_t guard = 0; guard < 64; guard++ )
+    uint8_t status = (sector < G64_MAX_SECTORS) ? t->status[sector] : 0;
+    if ( !(status & SECTOR_HEADER_OK) )
     {
-        //Debug_printv("track[%d] gcr_track[%d] gcr_track_offset[%04X] gcr_track_size[%d]", track, (gcr_track + 2), gcr_track_offset, gcr_track_size);
-        //Debug_printv("gcr_track_end[%04X] sector_offset[%04X]", gcr_track_end, sectorOffset);
-
-        if ( !findSync( gcr_track_end ) )
-            break;
-
-        //Debug_printv( "Read Sector Header [%04X]", containerStream->position() );
-        bool header_ok = readSectorHeader();
-
-        // The next sync is this sector's data block whether or not the header
-        // was usable, and stepping over it is what leaves the stream on the
-        // FOLLOWING header when this is not the sector being looked for.
-        if ( !findSync( gcr_track_end ) )
-            break;
-
-        //Debug_printv( "Read Sector Data [%04X]", containerStream->position() );
-        if ( header_ok && sector == gcr_sector_header.sector )
-        {
-            found = true;
-            break;
-        }
+        Debug_printv("track[%d] sector[%d] not found", track, sector);
+        return false;
     }
 
-    if ( !found )
+    // A data block whose id is not $07 means the sync led somewhere that is
+    // not a data block. Serving the buffer anyway would hand the caller the
+    // PREVIOUS sector's bytes as this one's.
+    if ( !(status & SECTOR_DATA_OK) )
     {
-        Debug_printv("track[%d] sector[%d] not found", track, sector);
+        Debug_printv("track[%d] sector[%d] bad data block", track, sector);
         return false;
     }
 
-    //Debug_printv( "Start Sector Data [%04lX]", containerStream->position() );
-    if ( !readSector() )
-        return false;
+    std::memcpy(sector_buffer, t->data[sector], sizeof(sector_buffer));
 
+    // Block number is the same linear count a .d64 would give. It used to be
+    // derived from the raw GCR offset, which a cached track no longer reads.
+    uint16_t sectorOffset = 0;
+    for (uint8_t index = 1; index < track; ++index)
+        sectorOffset += getSectorCount(index);
     sectorOffset += sector;
 
     this->block = sectorOffset;
@@ -133,141 +149,177 @@ bool G64MStream::seekSector(uint8_t track, uint8_t sector, uint8_t offset)
     return true;
 }
 
-
- uint32_t G64MStream::readContainer(uint8_t *buf, uint32_t size)
+G64MStream::DecodedTrack* G64MStream::decodedTrack(uint8_t track)
 {
-    // The sector is already decoded in RAM, so reads walk it the way the D64
-    // layer walks the container after a seek - which means the cursor is
-    // sector_pos, NOT _position. _position is the position in the FILE being
-    // read: it keeps growing across blocks, so using it here read past the end
-    // of sector_buffer for anything longer than one block, and returned
-    // whatever followed the buffer in memory as file content.
-    if (sector_pos >= block_size)
-        return 0;
+    for (auto it = track_cache.begin(); it != track_cache.end(); ++it)
+    {
+        if (it->track != track)
+            continue;
+
+        // Most recently used to the front, so eviction takes the stalest.
+        if (it != track_cache.begin())
+            track_cache.splice(track_cache.begin(), track_cache, it);
+        track_hits++;
+        return &track_cache.front();
+    }
 
-    uint32_t remaining = (uint32_t)block_size - sector_pos;
-    if (size > remaining)
-        size = remaining;
+    // The track table holds one 32-bit offset per half track, and track N is
+    // half track N * 2 - so entry (N - 1) * 2 counting from the table's start.
+    uint8_t entry[4];
+    uint32_t gcr_track = (uint32_t)(track - 1) * 2;
+    if (!g64_read_at(containerStream.get(), TRACK_TABLE_OFFSET + (gcr_track * 4), entry, sizeof(entry)))
+    {
+        Debug_printv("cannot read the track table entry for track[%d]", track);
+        return nullptr;
+    }
+    uint32_t gcr_track_offset = entry[0] | (entry[1] << 8) | (entry[2] << 16) | ((uint32_t)entry[3] << 24);
+    if (gcr_track_offset == 0)
+    {
+        Debug_printv("track[%d] is not present in the image", track);
+        return nullptr;
+    }
 
-    std::memcpy(buf, sector_buffer + sector_pos, size);
-    sector_pos += size;
-    return size;
-}
+    uint8_t length[2];
+    if (!g64_read_at(containerStream.get(), gcr_track_offset, length, sizeof(length)))
+    {
+        Debug_printv("cannot read the length of track[%d]", track);
+        return nullptr;
+    }
+    uint16_t gcr_track_size = length[0] | (length[1] << 8);
 
-bool G64MStream::readSectorHeader()
-{
-    uint8_t buf[5] = { 0x00 };
-    uint8_t data[4] = { 0x00 };
-
-    containerStream->read(buf, sizeof(buf));
-    convert4BytesFromGCR(buf, data);
-    gcr_sector_header.code = data[0];
-    gcr_sector_header.checksum = data[1];
-    gcr_sector_header.sector = data[2];
-    gcr_sector_header.track = data[3];
-
-    containerStream->read(buf, sizeof(buf));
-    convert4BytesFromGCR(buf, data);
-    gcr_sector_header.id1 = data[0];
-    gcr_sector_header.id0 = data[1];
-
-    // These three lines used to be unconditional printf()s - one per header, so
-    // a single directory listing printed a screenful and every file read printed
-    // more. They are gone rather than converted to Debug_printv: seekSector()
-    // runs from the IEC task, where printing at all is the hazard.
-
-    // The header block id, and the checksum the drive verifies it against. Both
-    // were computed and thrown away before; checking them is what lets the
-    // caller tell a real header from a false sync in a gap.
-    if ( gcr_sector_header.code != 0x08 )
-        return false;
+    // The header states the largest track the image holds; a length past it
+    // is a damaged table, not a track to allocate for.
+    if (gcr_track_size == 0 || (gcr_header.track_size && gcr_track_size > gcr_header.track_size))
+    {
+        Debug_printv("track[%d] has an invalid length [%d]", track, gcr_track_size);
+        return nullptr;
+    }
+
+    // The raw track is only needed while it is decoded.
+    std::vector<uint8_t> gcr(gcr_track_size);
+    if (!g64_read_at(containerStream.get(), gcr_track_offset + 2, gcr.data(), gcr_track_size))
+    {
+        Debug_printv("cannot read track[%d]", track);
+        return nullptr;
+    }
 
-    uint8_t checksum = gcr_sector_header.checksum ^ gcr_sector_header.sector
-                     ^ gcr_sector_header.track ^ gcr_sector_header.id1
-                     ^ gcr_sector_header.id0;
+    // Reuse the stalest slot once the cache is full rather than freeing it
+    // and allocating the same 5.5 KB again.
+    if (track_cache.size() >= G64_TRACK_CACHE_TRACKS)
+        track_cache.splice(track_cache.begin(), track_cache, std::prev(track_cache.end()));
+    else
+        track_cache.emplace_front();
 
-    return ( checksum == 0 );
+    DecodedTrack &t = track_cache.front();
+    t.track = track;
+    decodeTrack(gcr.data(), gcr_track_size, t);
+    track_decodes++;
+
+    return &t;
 }
 
-bool G64MStream::readSector()
+void G64MStream::decodeTrack(const uint8_t *gcr, uint32_t size, DecodedTrack &t)
 {
-    uint8_t buf[5] = { 0x00 };
-    uint8_t data[4] = { 0x00 };
-    uint8_t *d = sector_buffer;
+    std::memset(t.status, 0, sizeof(t.status));
+
+    // Scan one full revolution, plus the header and data block of a sector
+    // that starts just before the seam.
+    const uint32_t end = size + 10 + 325 + 8;
 
-    containerStream->read(buf, sizeof(buf));
-    convert4BytesFromGCR(buf, data);
+    uint8_t buf[5];
+    uint8_t header[8];
+    uint8_t block[260];
 
-    // Data Header 0x07. Anything else means the sync led somewhere that is not
-    // a data block, and returning true there left sector_buffer holding the
-    // PREVIOUS sector's bytes for the caller to serve as this one's.
-    if ( data[0] != 0x07 )
+    uint32_t p = 0;
+    while (p < end)
     {
-        Debug_printv("track[%d] sector[%d] data block id [%02X]", track, sector, data[0]);
-        return false;
-    }
+        int h = g64_find_sync(gcr, size, p, end);
+        if (h < 0)
+            break;
 
-    uint8_t *h = data + 1;
-    std::memcpy(d, h, 3);  // skip the header byte
-    d += 3;
+        for (int i = 0; i < 2; i++)
+        {
+            for (int j = 0; j < 5; j++)
+                buf[j] = g64_byte(gcr, size, h + (i * 5) + j);
+            convert4BytesFromGCR(buf, header + (i * 4));
+        }
 
-    for ( int i = 0; i< 64; i++ )
-    {
-        containerStream->read(buf, sizeof(buf));
-        convert4BytesFromGCR(buf, data);
-        std::memcpy(d, &data, 4);
-        d += 4;
-    }
+        // The next sync is this sector's data block whether or not the header
+        // was usable, and scanning on from there is what lands on the
+        // FOLLOWING header.
+        int d = g64_find_sync(gcr, size, h + 10, end);
+        if (d < 0)
+            break;
+        p = d;
 
-    // A util_dump_bytes() of all 260 bytes used to run here, on every single
-    // sector read.
+        // The header block id, and the checksum the drive verifies it
+        // against - what tells a real header from a false sync in a gap.
+        uint8_t sector = header[2];
+        if (header[0] != 0x08 || sector >= G64_MAX_SECTORS)
+            continue;
 
-    return true;
-}
+        t.status[sector] |= SECTOR_HEADER;
 
+        uint8_t checksum = header[1] ^ header[2] ^ header[3] ^ header[4] ^ header[5];
+        if (checksum != 0)
+            continue;
 
-bool G64MStream::findSync(uint32_t track_end)
-{
-    uint8_t gcr_byte0 = 0x00;
-    uint8_t gcr_byte1 = 0x00;
-
-    //Debug_printv( "start[%04X]", containerStream->position() );
-	while (1)
-	{
-		if (containerStream->position() + 1 >= track_end)
-		{
-			containerStream->position(track_end);
-            //Debug_printv("sync not found");
-			return false;	/* not found */
-		}
-
-        containerStream->read((uint8_t *)&gcr_byte1, sizeof(gcr_byte1));
-        //Debug_printf("%02X ", gcr_byte1);
-
-		// sync flag goes up after the 10th bit
-		if ((gcr_byte0 & 0x03) == 0x03 && (gcr_byte1 == 0xff))
-			break;
-        
-        gcr_byte0 = gcr_byte1;
-	}
-
-    //Debug_print("[sync!] ");
-
-    do
-    {
-        //Debug_printf("%02X ", gcr_byte1);
-	    containerStream->read((uint8_t *)&gcr_byte1, sizeof(gcr_byte1));
-    } while (containerStream->position() < track_end && gcr_byte1 == 0xff);
-    containerStream->seek(containerStream->position() - 1);
+        // A sector seen twice - the wrapped tail of the scan - keeps the
+        // first good copy.
+        if (t.status[sector] & SECTOR_DATA_OK)
+            continue;
 
-    //Debug_printf("\r\n");
+        t.status[sector] |= SECTOR_HEADER_OK;
 
-    //Debug_printv( "end[%04X]", containerStream->position() );
+        for (int i = 0; i < 65; i++)
+        {
+            for (int j = 0; j < 5; j++)
+                buf[j] = g64_byte(gcr, size, d + (i * 5) + j);
+            convert4BytesFromGCR(buf, block + (i * 4));
+        }
 
-	return true;
+        // Data Header 0x07.
+        if (block[0] != 0x07)
+            continue;
+
+        // The data checksum, the XOR of its 256 bytes. A block that fails it
+        // is damaged, and the drive answers 23,READ ERROR rather than serve
+        // it; a later copy in the wrapped tail may still be good.
+        uint8_t sum = 0;
+        for (int i = 1; i <= 256; i++)
+            sum ^= block[i];
+        if (sum != block[257])
+            continue;
+
+        // sector_buffer layout: the 256 bytes after the id (link bytes
+        // first, as the D64 layer expects), then the data checksum.
+        std::memcpy(t.data[sector], block + 1, sizeof(block) - 1);
+        t.data[sector][sizeof(block) - 1] = 0x00;
+        t.status[sector] |= SECTOR_DATA_OK;
+    }
 }
 
 
+ uint32_t G64MStream::readContainer(uint8_t *buf, uint32_t size)
+{
+    // The sector is already decoded in RAM, so reads walk it the way the D64
+    // layer walks the container after a seek - which means the cursor is
+    // sector_pos, NOT _position. _position is the position in the FILE being
+    // read: it keeps growing across blocks, so using it here read past the end
+    // of sector_buffer for anything longer than one block, and returned
+    // whatever followed the buffer in memory as file content.
+    if (sector_pos >= block_size)
+        return 0;
+
+    uint32_t remaining = (uint32_t)block_size - sector_pos;
+    if (size > remaining)
+        size = remaining;
+
+    std::memcpy(buf, sector_buffer + sector_pos, size);
+    sector_pos += size;
+    return size;
+}
+
 int G64MStream::convert4BytesFromGCR(uint8_t * gcr, uint8_t * plain)
 {
 	uint8_t hnibble, lnibble;
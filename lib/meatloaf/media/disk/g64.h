@@ -34,6 +34,13 @@
 #include "endianness.h"
 
 #include <cstring>
+#include <iterator>
+#include <list>
+#include <vector>
+
+#ifndef TEST_NATIVE
+#include "sdkconfig.h"
+#endif
 
 // Format codes:
 // ID	Description
@@ -71,6 +78,18 @@
 #define TRACK_TABLE_OFFSET 0x000C
 #define SPEED_ZONE_OFFSET  0x015C
 
+// Most sectors a GCR track carries (zone 3, tracks 1-17 and 36-52 of a G71).
+#define G64_MAX_SECTORS    21
+
+// Decoded tracks each open image keeps. A track is ~5.5 KB decoded, so a board
+// without PSRAM holds just enough for the directory track and the track a
+// file's chain is on; with PSRAM the tracks either side stay as well.
+#ifdef CONFIG_SPIRAM
+#define G64_TRACK_CACHE_TRACKS 8
+#else
+#define G64_TRACK_CACHE_TRACKS 2
+#endif
+
 
 /********************************************************
  * Streams
@@ -87,15 +106,6 @@ protected:
         uint16_t track_size;
     };
 
-    struct SectorHeader {
-        uint8_t code; // 0x08
-        uint8_t checksum;
-        uint8_t sector;
-        uint8_t track;
-        uint8_t id1;
-        uint8_t id0;
-    };
-
 public:
     G64MStream(std::shared_ptr<MStream> is) : D64MStream(is) 
     {
@@ -113,8 +123,7 @@ public:
         // Debug_printv("signature[%s] version[%d] track_count[%d] track_size[%d]", gcr_header.signature, gcr_header.version, gcr_header.track_count, gcr_header.track_size);
     };
 
-    MediaHeader gcr_header;
-    SectorHeader gcr_sector_header;
+    MediaHeader gcr_header = {};
 
     // The 8-byte signature this stream accepts. A .g71 is the same container
     // with a different signature and a 1571's geometry - see g71.h.
@@ -156,6 +165,9 @@ public:
     bool seekSector( uint8_t track, uint8_t sector, uint8_t offset = 0 ) override;
 
     uint32_t readContainer(uint8_t *buf, uint32_t size) override;
+    bool sectorsAreLinear() override { return false; }
+
+    uint32_t footprint() override { return sizeof(G64MStream) + bufferedBytes() + (track_cache.size() * sizeof(DecodedTrack)); }
 
     // Read-only, enforced here rather than assumed. D64MStream's whole write
     // path reaches the container through writeContainer() and addresses it as a
@@ -170,12 +182,41 @@ public:
         return 0;
     }
 
-    bool readSectorHeader();
-    bool readSector();
-    bool findSync(uint32_t gcr_end);
     int convert4BytesFromGCR(uint8_t * gcr, uint8_t * plain);
 
+    // Track cache counters, for diagnostics and test/native/test_g64_read.
+    uint32_t track_hits = 0;      // seeks served from an already decoded track
+    uint32_t track_decodes = 0;   // raw tracks read and decoded
+
 protected:
+    // Per-sector state of a decoded track.
+    enum {
+        SECTOR_HEADER = 0x01,     // a header block with this sector number was seen
+        SECTOR_HEADER_OK = 0x02,  // ... with a $08 id and a good checksum
+        SECTOR_DATA_OK = 0x04     // its data block had a $07 id and a good checksum
+    };
+
+    // One track, GCR-decoded in a single pass. data[] holds each sector in the
+    // layout of sector_buffer, so a seek to a decoded track is a memcpy.
+    struct DecodedTrack {
+        uint8_t track = 0;
+        uint8_t status[G64_MAX_SECTORS] = { 0 };
+        uint8_t data[G64_MAX_SECTORS][260];
+    };
+
+    // Returns the decoded track, reading and decoding it on first touch.
+    // seekSector() used to rescan the raw GCR for every sector it was asked
+    // for, one containerStream->read() per byte - thousands of reads per
+    // sector, and over HTTP each of them a seek. Now a track costs one bulk
+    // read, and every later seek on it is served from memory.
+    DecodedTrack* decodedTrack( uint8_t track );
+
+    // Scans a raw track and fills t. Pure RAM, no container access.
+    void decodeTrack( const uint8_t *gcr, uint32_t size, DecodedTrack &t );
+
+    // Most recently used at the front; at most G64_TRACK_CACHE_TRACKS.
+    std::list<DecodedTrack> track_cache;
+
     uint8_t sector_buffer[260];
 
     // Read cursor WITHIN sector_buffer. It cannot be _position: that is the
@@ -92,6 +92,8 @@ public:
     using D81MStream::seekSector;
 
     uint32_t readContainer(uint8_t *buf, uint32_t size) override;
+    bool sectorsAreLinear() override { return false; }
+    uint32_t footprint() override { return sizeof(G81MStream) + bufferedBytes() + mfm_track.capacity(); }
 
     // Read-only. D81MStream's write path addresses the container as a linear
     // .d81, which on a bitstream lands in the middle of encoded cells, and
@@ -89,6 +89,9 @@ public:
     using D64MStream::seekSector;
 
     uint32_t readContainer(uint8_t *buf, uint32_t size) override;
+    bool sectorsAreLinear() override { return false; }
+    // A .nbz is inflated whole into image_buffer.
+    uint32_t footprint() override { return sizeof(NIBMStream) + bufferedBytes() + image_buffer.capacity() + track_buffer.capacity(); }
 
     // Read-only. D64MStream's write path addresses the container as a linear
     // .d64, which on a raw GCR capture lands in the middle of encoded data, and
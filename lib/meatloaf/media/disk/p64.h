@@ -115,6 +115,8 @@ public:
     using D64MStream::seekSector;
 
     uint32_t readContainer(uint8_t *buf, uint32_t size) override;
+    bool sectorsAreLinear() override { return false; }
+    uint32_t footprint() override { return sizeof(P64MStream) + bufferedBytes() + gcr_track.capacity(); }
 
     // Read-only, and this is where that is enforced rather than assumed.
     // D64MStream's whole write path - new files, directory entries, BAM
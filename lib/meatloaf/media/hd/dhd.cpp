@@ -122,8 +122,10 @@ bool DHDImageRegistry::parse(const std::string &containerUrl, Image &img)
     // Open the raw image bytes: the probing flag makes the CMD media
     // filesystems decline the path so the underlying filesystem serves it
     s_probing = true;
+    MFSOwner::suspendResolveCache();
     std::unique_ptr<MFile> f(MFSOwner::File(containerUrl));
     std::shared_ptr<MStream> s = (f != nullptr) ? f->getSourceStream() : nullptr;
+    MFSOwner::resumeResolveCache();
     s_probing = false;
 
     if (s == nullptr || !s->isOpen())
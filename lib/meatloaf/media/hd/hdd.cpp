@@ -975,8 +975,10 @@ bool HDDImageRegistry::parse(const std::string &containerUrl, Image &img)
     // the path so the underlying filesystem serves it, rather than handing
     // back another HDDMFile whose stream is already decoded.
     s_probing = true;
+    MFSOwner::suspendResolveCache();
     std::unique_ptr<MFile> f(MFSOwner::File(containerUrl));
     std::shared_ptr<MStream> s = (f != nullptr) ? f->getSourceStream() : nullptr;
+    MFSOwner::resumeResolveCache();
     s_probing = false;
 
     if (s == nullptr || !s->isOpen())
@@ -195,6 +195,8 @@ public:
 
     std::unordered_map<std::string, std::string> info() override;
 
+    uint32_t footprint() override { return sizeof(TAPMStream) + (idx_entries.capacity() * sizeof(IdxEntry)); }
+
 protected:
     uint32_t readFile(uint8_t* buf, uint32_t size) override;
     uint32_t writeFile(uint8_t* buf, uint32_t size) override { return 0; };
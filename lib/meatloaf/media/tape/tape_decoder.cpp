@@ -17,6 +17,7 @@
 
 #include "tape_decoder.h"
 
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 #include <mutex>
@@ -30,6 +31,26 @@
 #include <esp_heap_caps.h>
 #endif
 
+// Tapes longer than this are analyzed through a window of about this size
+// sliding along the tape, not in one buffer the size of the tape. Soft: a
+// single program longer than the window still gets a window that holds it.
+#ifndef TAPE_SCAN_WINDOW
+#ifdef CONFIG_SPIRAM
+#define TAPE_SCAN_WINDOW        (2 * 1024 * 1024)
+#else
+#define TAPE_SCAN_WINDOW        (256 * 1024)
+#endif
+#endif
+
+// Largest Kernal boot block replayed ahead of a slice (header and data,
+// both copies, in pulses)
+#ifndef TAPE_SCAN_CONTEXT_MAX
+#define TAPE_SCAN_CONTEXT_MAX   (128 * 1024)
+#endif
+
+// Pulses past an indexed program's last one that its scanner may look at
+#define TAPE_INDEX_SLACK        4096
+
 extern "C" {
 #include "tapclean_api.h"
 }
@@ -114,12 +135,21 @@ std::string TapeDecoder::videoName() const
     return video ? "NTSC" : "PAL";
 }
 
+TapeDecoder::TapeDecoder()
+{
+    window_limit = TAPE_SCAN_WINDOW;
+#ifdef TAPE_INDEX_DIR
+    index_dir = TAPE_INDEX_DIR;
+#endif
+}
+
 bool TapeDecoder::open(MStream *container)
 {
     stream = container;
     opened = false;
     win_len = 0;
     entries.clear();
+    scans.clear();
     total_ms = 0;
     fully_scanned = false;
     converting = false;
@@ -129,6 +159,13 @@ bool TapeDecoder::open(MStream *container)
     fetched = 0;
     conv_pos = 0;
     conv_eof = false;
+    slice_start = 20;
+    slice_base = 20;
+    slice_ms = 0;
+    confirmed = 0;
+    context.clear();
+    ctx_start = ctx_end = 0;
+    indexed = false;
 
     if (stream == nullptr)
         return false;
@@ -190,6 +227,13 @@ bool TapeDecoder::open(MStream *container)
     converting = !(kind == TAPE_KIND_TAP && !halfwaves);
     len = container_len;   // refined as conversion progresses
     opened = true;
+
+    // Scanned before: list from the index, decode programs as they're asked for
+    if (!converting)
+        loadIndex();
+    if (indexed) {
+        Debug_printv("Tape index: %u programs, %lu ms", (unsigned)entries.size(), (unsigned long)total_ms);
+    }
     return true;
 }
 
@@ -282,8 +326,10 @@ bool TapeDecoder::nextValue(uint32_t *p, uint32_t *cycles)
  * TAPClean scan
  ********************************************************/
 
-// Engine PRG database -> entries, with listing filters applied
-void TapeDecoder::harvestEntries(int nprg)
+// Engine PRG database -> entries, with listing filters applied. Programs
+// that start ahead of 'base' (the replayed boot block) are not taken.
+void TapeDecoder::harvestEntries(int nprg, uint32_t base, uint32_t origin, uint32_t origin_ms,
+                                 std::vector<TapeEntry> &out, std::vector<bool> &is_cbm)
 {
     // Copy programs out of the engine, in tape order. Loader-internal
     // header blocks (CBM and turbo headers) are folded into the following
@@ -293,15 +339,16 @@ void TapeDecoder::harvestEntries(int nprg)
     std::string pending_name;
     uint32_t pending_start = 0;
     bool have_pending = false;
-    uint32_t prev_off = 20;
-    uint32_t prev_ms = 0;
-    std::vector<bool> entry_is_cbm;   // parallel to 'entries'
+    uint32_t prev_off = base;   // buffer offsets from here on
+    uint32_t prev_ms = origin_ms;
 
     for (int i = 0; i < nprg; i++)
     {
         tapclean_prg_t p;
         if (!tapclean_get_prg(i, &p))
             break;
+        if (p.tap_start < (int)base)
+            continue;
 
         bool is_header = p.is_cbm_header ||
             (p.type_name != nullptr && strstr(p.type_name, "HEADER") != nullptr);
@@ -319,15 +366,15 @@ void TapeDecoder::harvestEntries(int nprg)
 
         // Skip repeat copies: same memory range and identical content as
         // the previous program
-        if (!entries.empty())
+        if (!out.empty())
         {
-            TapeEntry &prev = entries.back();
+            TapeEntry &prev = out.back();
             size_t datalen = (size_t)p.size;
             if (prev.start_addr == p.start_addr && prev.end_addr == p.end_addr &&
                 prev.prg.size() == datalen + 2 && p.data != nullptr &&
                 memcmp(prev.prg.data() + 2, p.data, datalen) == 0)
             {
-                prev.tape_end_offset = p.tap_end;
+                prev.tape_end_offset = origin + p.tap_end - base;
                 prev.end_time_ms = prev_ms +
                     tapclean_duration_ms((int)prev_off, p.tap_end);
                 prev_ms = prev.end_time_ms;
@@ -361,14 +408,15 @@ void TapeDecoder::harvestEntries(int nprg)
         e.start_addr = (uint16_t)p.start_addr;
         e.end_addr = (uint16_t)p.end_addr;
         // The program starts at its header (if one preceded it)
-        e.tape_offset = have_pending ? pending_start : (uint32_t)p.tap_start;
-        e.tape_end_offset = (uint32_t)p.tap_end;
+        uint32_t first = have_pending ? pending_start : (uint32_t)p.tap_start;
+        e.tape_offset = origin + first - base;
+        e.tape_end_offset = origin + (uint32_t)p.tap_end - base;
         e.checksum_ok = (p.read_errors == 0);
 
-        e.start_time_ms = prev_ms + tapclean_duration_ms((int)prev_off, (int)e.tape_offset);
+        e.start_time_ms = prev_ms + tapclean_duration_ms((int)prev_off, (int)first);
         e.end_time_ms = e.start_time_ms +
-            tapclean_duration_ms((int)e.tape_offset, (int)e.tape_end_offset);
-        prev_off = e.tape_end_offset;
+            tapclean_duration_ms((int)first, p.tap_end);
+        prev_off = p.tap_end;
         prev_ms = e.end_time_ms;
 
         e.prg.resize((size_t)p.size + 2);
@@ -383,8 +431,8 @@ void TapeDecoder::harvestEntries(int nprg)
                      (unsigned long)e.tape_offset, (unsigned long)e.tape_end_offset,
                      (unsigned long)e.start_time_ms, (unsigned long)e.end_time_ms);
 
-        entries.push_back(std::move(e));
-        entry_is_cbm.push_back(p.is_cbm_data != 0);
+        out.push_back(std::move(e));
+        is_cbm.push_back(p.is_cbm_data != 0);
         have_pending = false;
     }
 
@@ -413,20 +461,36 @@ void TapeDecoder::harvestEntries(int nprg)
  * Progressive scanning (plain TAP)
  ********************************************************/
 
-// Append one pulse in TAP v1 encoding to the converted image
-bool TapeDecoder::appendValue(uint32_t cycles)
+// Grow the image buffer to hold at least n bytes, keeping its contents
+bool TapeDecoder::reserve(uint32_t n)
 {
-    if (fetched + 4 > image_cap)
+    if (n <= image_cap)
+        return true;
+
+    uint32_t ncap = image_cap + image_cap / 2;
+    if (ncap < n)
+        ncap = n;
+    uint8_t *nbuf = image_alloc(ncap);
+    if (nbuf == nullptr)
     {
-        uint32_t ncap = image_cap + image_cap / 2;
-        uint8_t *nbuf = image_alloc(ncap);
-        if (nbuf == nullptr)
-            return false;
-        memcpy(nbuf, image, fetched);
-        free(image);
-        image = nbuf;
-        image_cap = ncap;
+        Debug_printv("No memory for tape image (%lu bytes)", (unsigned long)ncap);
+        return false;
     }
+    if (image != nullptr)
+        memcpy(nbuf, image, fetched);
+    free(image);
+    image = nbuf;
+    image_cap = ncap;
+    if (image_cap > buffer_peak)
+        buffer_peak = image_cap;
+    return true;
+}
+
+// Append one pulse in TAP v1 encoding to the converted image
+bool TapeDecoder::appendValue(uint32_t cycles)
+{
+    if (!reserve(fetched + 4))
+        return false;
 
     if (cycles >= 8 && cycles <= 255 * 8)
     {
@@ -450,14 +514,14 @@ bool TapeDecoder::fetchTo(uint32_t target)
 {
     if (image == nullptr)
     {
-        image_cap = container_len + 4096;
-        image = image_alloc(image_cap);
-        if (image == nullptr)
-        {
-            Debug_printv("No memory for tape image (%lu bytes)", image_cap);
-            return false;
-        }
+        // A tape that fits the window is read whole into one buffer; a
+        // longer one never needs more than about a window
         fetched = 0;
+        if (!reserve((sliding() ? window_limit : container_len) + 4096))
+            return false;
+        slice_start = 20;
+        slice_base = 20;
+        slice_ms = 0;
 
         if (converting)
         {
@@ -468,9 +532,13 @@ bool TapeDecoder::fetchTo(uint32_t target)
             image[0x0C] = 1;
             image[0x0D] = platform;
             image[0x0E] = video;
-            fetched = 20;
             conv_pos = data_start;
         }
+        else if (!readBytes(0, image, 20))
+        {
+            return false;
+        }
+        fetched = 20;
     }
 
     if (target > container_len)
@@ -479,33 +547,35 @@ bool TapeDecoder::fetchTo(uint32_t target)
     if (!converting)
     {
         // Raw TAP: bulk sequential read straight into the buffer
-        if (fetched >= target)
+        if (sliceEnd() >= target)
             return true;
-        if (stream == nullptr || !stream->seek(fetched))
+        if (!reserve(slice_base + (target - slice_start)))
+            return false;
+        if (stream == nullptr || !stream->seek(sliceEnd()))
             return false;
 
         uint32_t next_report = 0;
-        while (fetched < target)
+        while (sliceEnd() < target)
         {
             // Capped chunks so progress ticks even when the underlying
             // stream would satisfy one huge read
-            uint32_t chunk = target - fetched;
+            uint32_t chunk = target - sliceEnd();
             if (chunk > 32 * 1024)
                 chunk = 32 * 1024;
             uint32_t got = stream->read(image + fetched, chunk);
             if (got == 0)
             {
-                Debug_printv("Tape image read failed at %lu of %lu", fetched, target);
+                Debug_printv("Tape image read failed at %lu of %lu", sliceEnd(), target);
                 return false;
             }
             fetched += got;
 
-            if (fetched >= next_report || fetched >= target)
+            if (sliceEnd() >= next_report || sliceEnd() >= target)
             {
                 Serial.printf("Reading tape image: %lu/%lu KB\r\n",
-                              (unsigned long)(fetched / 1024),
+                              (unsigned long)(sliceEnd() / 1024),
                               (unsigned long)(container_len / 1024));
-                next_report = fetched + 64 * 1024;
+                next_report = sliceEnd() + 64 * 1024;
             }
         }
         return true;
@@ -556,37 +626,78 @@ bool TapeDecoder::fetchTo(uint32_t target)
                       (unsigned long)(container_len / 1024),
                       (unsigned long)(container_len / 1024));
 
-    len = fetched;   // converted length known so far
+    len = sliceEnd();   // converted length known so far
     return true;
 }
 
-bool TapeDecoder::scanWindow(uint32_t win)
+// A pause in the image's own encoding, to keep the replayed boot block
+// apart from the slice it is put in front of
+std::vector<uint8_t> TapeDecoder::pauseBytes() const
+{
+    if (!converting && version == 0)
+        return { 0 };
+    uint32_t cycles = machineClock() / 2;
+    return { 0, (uint8_t)(cycles & 0xFF), (uint8_t)((cycles >> 8) & 0xFF), (uint8_t)((cycles >> 16) & 0xFF) };
+}
+
+// First pulse boundary at or after buffer offset 'local' (a v1 long pulse
+// is four bytes, and cutting into one would misread the rest)
+uint32_t TapeDecoder::pulseBoundary(uint32_t local) const
+{
+    bool v1 = converting || version != 0;
+    uint32_t p = slice_base;
+    while (p < local && p < fetched)
+        p += (image[p] == 0 && v1) ? 4 : 1;
+    return p < fetched ? p : fetched;
+}
+
+// Start the slice at buffer offset 'local' (tape time 'ms'): what comes
+// before it goes, what follows moves down behind the header and the
+// replayed boot block
+void TapeDecoder::slideTo(uint32_t local, uint32_t ms)
+{
+    uint32_t keep = fetched - local;
+    uint32_t base = 20 + (uint32_t)context.size();
+    if (!reserve(base + keep))
+        return;
+
+    memmove(image + base, image + local, keep);
+    if (!context.empty())
+        memcpy(image + 20, context.data(), context.size());
+
+    slice_start += local - slice_base;
+    slice_base = base;
+    slice_ms = ms;
+    fetched = base + keep;
+
+    Debug_printv("Tape window slides to %lu (%lu ms), %lu bytes kept",
+                 (unsigned long)slice_start, (unsigned long)ms, (unsigned long)keep);
+}
+
+bool TapeDecoder::scanWindow()
 {
     std::lock_guard<std::mutex> lock(s_tapclean_mutex);
 
-    bool complete = converting ? conv_eof : (win >= container_len);
+    bool complete = converting ? conv_eof : (sliceEnd() >= container_len);
 
     int machine = TAPCLEAN_MACHINE_C64;
     if (platform == 1) machine = TAPCLEAN_MACHINE_VIC20;
     if (platform == 2) machine = TAPCLEAN_MACHINE_C16;
 
     Serial.printf("Analyzing tape: %lu/%lu KB\r\n",
-                  (unsigned long)((converting ? conv_pos : win) / 1024),
+                  (unsigned long)((converting ? conv_pos : sliceEnd()) / 1024),
                   (unsigned long)(container_len / 1024));
 
-    if (converting)
-    {
-        // Patch the synthesized header's size field for this window
-        uint32_t dlen = win - 20;
-        image[0x10] = dlen & 0xFF;
-        image[0x11] = (dlen >> 8) & 0xFF;
-        image[0x12] = (dlen >> 16) & 0xFF;
-        image[0x13] = (dlen >> 24) & 0xFF;
-    }
+    // Patch the header's size field for this window
+    uint32_t dlen = fetched - 20;
+    image[0x10] = dlen & 0xFF;
+    image[0x11] = (dlen >> 8) & 0xFF;
+    image[0x12] = (dlen >> 16) & 0xFF;
+    image[0x13] = (dlen >> 24) & 0xFF;
 
     // The engine borrows 'image' - no copy, and it stays ours for the
-    // next (larger) window
-    if (!tapclean_load_buffer_ref(image, win, machine, video ? 1 : 0))
+    // next (larger or slid) window
+    if (!tapclean_load_buffer_ref(image, fetched, machine, video ? 1 : 0))
     {
         tapclean_shutdown();
         return false;
@@ -602,45 +713,132 @@ bool TapeDecoder::scanWindow(uint32_t win)
     Serial.printf("\r\n%d programs found, %d%% of tape recognized%s\r\n",
                   nprg, tapclean_detected_percent(),
                   complete ? "" : " (partial scan)");
-    Debug_printv("TAPClean: recognized[%d%%] programs[%d] window[%lu] complete[%d]",
+    Debug_printv("TAPClean: recognized[%d%%] programs[%d] window[%lu-%lu] complete[%d]",
                  tapclean_detected_percent(), nprg,
-                 (unsigned long)win, complete ? 1 : 0);
+                 (unsigned long)slice_start, (unsigned long)sliceEnd(), complete ? 1 : 0);
 
-    entries.clear();
-    harvestEntries(nprg);
+    // Entries already confirmed are final; everything after them is
+    // taken from this window afresh
+    entries.resize(confirmed);
+    scans.resize(confirmed);
+    std::vector<bool> is_cbm;
+    harvestEntries(nprg, slice_base, slice_start, slice_ms, entries, is_cbm);
 
     // A partial window cannot confirm its last entry (the window edge may
-    // have truncated it): withhold it until a later entry or the tape end
-    // proves it complete
-    if (!complete && !entries.empty())
-        entries.pop_back();
+    // have truncated it) - nor the one before when that last one is broken:
+    // it may be the repeat copy, which only folds in once complete
+    size_t keep = entries.size();
+    if (!complete && keep > confirmed)
+    {
+        keep--;
+        if (keep > confirmed && !entries[keep].checksum_ok)
+            keep--;
+    }
+
+    for (size_t i = confirmed; i < keep; i++)
+    {
+        // Turbo programs remember the boot block they were found after
+        EntryScan sc;
+        if (!is_cbm[i - confirmed])
+        {
+            sc.ctx_start = ctx_start;
+            sc.ctx_end = ctx_end;
+        }
+        scans.push_back(sc);
+
+        // The latest Kernal boot block goes ahead of later slices
+        const TapeEntry &e = entries[i];
+        uint32_t span = e.tape_end_offset + 1 - e.tape_offset;
+        if (is_cbm[i - confirmed] && span <= TAPE_SCAN_CONTEXT_MAX && span <= window_limit / 2)
+        {
+            ctx_start = e.tape_offset;
+            ctx_end = e.tape_end_offset + 1;
+            if (sliding())
+            {
+                const uint8_t *from = image + slice_base + (e.tape_offset - slice_start);
+                context.assign(from, from + span);
+                std::vector<uint8_t> pause = pauseBytes();
+                context.insert(context.end(), pause.begin(), pause.end());
+            }
+        }
+    }
+
+    // Long tape: move the window on past what it confirmed - or, when a
+    // whole window held nothing recognizable, by half of it
+    uint32_t slide_to = 0;
+    uint32_t slide_ms = 0;
+    if (!complete && sliding())
+    {
+        if (keep > confirmed)
+        {
+            slide_to = slice_base + (entries[keep].tape_offset - slice_start);
+            slide_ms = entries[keep].start_time_ms;
+        }
+        else if (entries.size() == confirmed && fetched - slice_base >= window_limit)
+        {
+            slide_to = pulseBoundary(slice_base + (fetched - slice_base) / 2);
+            slide_ms = slice_ms + tapclean_duration_ms((int)slice_base, (int)slide_to);
+        }
+    }
+    entries.resize(keep);
+    confirmed = keep;
 
     if (complete)
-        total_ms = tapclean_tap_time_ms();
+    {
+        total_ms = (slice_base == 20 && slice_start == 20)
+            ? tapclean_tap_time_ms()
+            : slice_ms + tapclean_duration_ms((int)slice_base, (int)fetched);
+    }
 
     tapclean_shutdown();
+
+    if (slide_to > slice_base)
+        slideTo(slide_to, slide_ms);
     return true;
 }
 
 bool TapeDecoder::extendScan()
 {
-    // Window growth is measured in CONTAINER bytes (what actually gets
-    // transferred); for conversion formats that is the read cursor
-    uint32_t progress = converting ? conv_pos : fetched;
-    uint32_t target = (progress == 0) ? (512u * 1024) : (progress * 2);
-    // Don't leave a tiny tail for one more round trip
-    if (target > container_len || (container_len - target) < 128u * 1024)
+    // Window growth is measured in bytes of the slice: 512 KB first, then
+    // doubling - up to the window limit (less the replayed boot block) on
+    // a long tape, after a slide straight to it, and past it only while a
+    // single program needs more
+    uint32_t span = (image != nullptr) ? fetched - slice_base : 0;
+    uint32_t limit = window_limit - (slice_base - 20);
+    uint32_t want;
+    if (span == 0)
+        want = 512u * 1024;
+    else if (slice_start > 20 && span < limit)
+        want = limit;
+    else
+        want = span * 2;
+    if (sliding() && span < limit && want > limit)
+        want = limit;
+
+    // ... in CONTAINER bytes (what actually gets transferred); for
+    // conversion formats that is the read cursor
+    uint32_t target;
+    if (!converting)
+        target = slice_start + want;
+    else if (!sliding())
+        target = (conv_pos == 0) ? (512u * 1024) : (conv_pos * 2);
+    else
+        target = ((conv_pos == 0) ? data_start : conv_pos) + (want - span);
+    // Don't leave a tiny tail for one more round trip (unless that
+    // would overrun the window)
+    if (target > container_len || (!sliding() && (container_len - target) < 128u * 1024))
         target = container_len;
 
     // On failure (e.g. network error) leave state as-is: the next
     // directory request retries from where the fetch stopped
-    if (!fetchTo(target) || !scanWindow(fetched))
+    if (!fetchTo(target) || !scanWindow())
         return false;
 
-    if (converting ? conv_eof : (fetched >= container_len))
+    if (converting ? conv_eof : (sliceEnd() >= container_len))
     {
         fully_scanned = true;
         finishScan();
+        saveIndex();
     }
     return true;
 }
@@ -650,6 +848,9 @@ void TapeDecoder::finishScan()
     // The whole image has been analyzed and every entry copied out
     free(image);
     image = nullptr;
+    image_cap = 0;
+    context.clear();
+    context.shrink_to_fit();
 }
 
 TapeDecoder::~TapeDecoder()
@@ -657,6 +858,213 @@ TapeDecoder::~TapeDecoder()
     free(image);
 }
 
+/********************************************************
+ * Scan index
+ ********************************************************/
+
+// One file per image URL; the image size recorded in it catches most
+// replacements, and decodeEntry() the rest
+std::string TapeDecoder::indexPath() const
+{
+    if (index_dir.empty() || stream == nullptr || stream->url.empty())
+        return "";
+    return index_dir + "/tape-" + mstr::crc32(stream->url) + ".tix";
+}
+
+// "TIX1\t<image size>\t<total ms>", then per program:
+// "<offset>\t<end>\t<start ms>\t<end ms>\t<start addr>\t<end addr>\t
+//  <checksum ok>\t<size>\t<boot block start>\t<boot block end>\t<loader>\t<name>"
+bool TapeDecoder::loadIndex()
+{
+    std::string path = indexPath();
+    if (path.empty())
+        return false;
+    FILE *f = fopen(path.c_str(), "r");
+    if (f == nullptr)
+        return false;
+
+    char line[512];
+    unsigned long size = 0, total = 0;
+    if (fgets(line, sizeof(line), f) == nullptr ||
+        sscanf(line, "TIX1\t%lu\t%lu", &size, &total) != 2 || size != container_len)
+    {
+        fclose(f);
+        return false;
+    }
+
+    std::vector<TapeEntry> loaded;
+    std::vector<EntryScan> loaded_scans;
+    while (fgets(line, sizeof(line), f) != nullptr)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        unsigned long v[10];
+        char *p = line;
+        int n = 0;
+        for (; n < 10; n++)
+        {
+            char *end = nullptr;
+            v[n] = strtoul(p, &end, 10);
+            if (end == p || *end != '\t')
+                break;
+            p = end + 1;
+        }
+        char *name = strchr(p, '\t');
+        if (n < 10 || name == nullptr)
+            continue;
+        *name++ = '\0';
+
+        TapeEntry e;
+        e.tape_offset = v[0];
+        e.tape_end_offset = v[1];
+        e.start_time_ms = v[2];
+        e.end_time_ms = v[3];
+        e.start_addr = (uint16_t)v[4];
+        e.end_addr = (uint16_t)v[5];
+        e.checksum_ok = (v[6] != 0);
+        e.loader = p;
+        e.name = name;
+
+        EntryScan sc;
+        sc.size = v[7];
+        sc.ctx_start = v[8];
+        sc.ctx_end = v[9];
+        if (e.tape_end_offset >= container_len || sc.size < 2 ||
+            (!loaded.empty() && e.tape_offset < loaded.back().tape_end_offset))
+            continue;
+        loaded.push_back(std::move(e));
+        loaded_scans.push_back(sc);
+    }
+    fclose(f);
+
+    if (loaded.empty())
+        return false;
+
+    entries = std::move(loaded);
+    scans = std::move(loaded_scans);
+    confirmed = entries.size();
+    total_ms = total;
+    fully_scanned = true;
+    indexed = true;
+    return true;
+}
+
+void TapeDecoder::saveIndex()
+{
+    std::string path = indexPath();
+    if (converting || indexed || entries.empty() || path.empty())
+        return;
+
+    for (auto &e : entries)
+    {
+        if (e.name.find_first_of("\t\r\n") != std::string::npos ||
+            e.loader.find_first_of("\t\r\n") != std::string::npos)
+            return;
+    }
+
+    FILE *f = fopen(path.c_str(), "w");
+    if (f == nullptr)
+    {
+        Debug_printv("Cannot write tape index [%s]", path.c_str());
+        return;
+    }
+    fprintf(f, "TIX1\t%lu\t%lu\n", (unsigned long)container_len, (unsigned long)total_ms);
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const TapeEntry &e = entries[i];
+        const EntryScan &sc = scans[i];
+        fprintf(f, "%lu\t%lu\t%lu\t%lu\t%u\t%u\t%d\t%u\t%lu\t%lu\t%s\t%s\n",
+                (unsigned long)e.tape_offset, (unsigned long)e.tape_end_offset,
+                (unsigned long)e.start_time_ms, (unsigned long)e.end_time_ms,
+                e.start_addr, e.end_addr, e.checksum_ok ? 1 : 0, (unsigned)e.prg.size(),
+                (unsigned long)sc.ctx_start, (unsigned long)sc.ctx_end,
+                e.loader.c_str(), e.name.c_str());
+    }
+    fclose(f);
+    Debug_printv("Wrote tape index [%s]: %u programs", path.c_str(), (unsigned)entries.size());
+}
+
+// Decode one program known from the index: just its own stretch of tape,
+// behind the boot block it was found after
+bool TapeDecoder::decodeEntry(size_t i)
+{
+    TapeEntry &want = entries[i];
+    const EntryScan &sc = scans[i];
+
+    std::vector<uint8_t> pause = pauseBytes();
+    uint32_t ctx_len = (sc.ctx_end > sc.ctx_start) ? sc.ctx_end - sc.ctx_start : 0;
+    uint32_t base = 20 + (ctx_len ? ctx_len + (uint32_t)pause.size() : 0);
+    uint32_t end = want.tape_end_offset + 1 + TAPE_INDEX_SLACK;
+    if (end > container_len)
+        end = container_len;
+    uint32_t n = base + (end - want.tape_offset);
+
+    uint8_t *buf = image_alloc(n);
+    if (buf == nullptr)
+        return false;
+    if (n > buffer_peak)
+        buffer_peak = n;
+
+    bool ok = readBytes(0, buf, 20) &&
+              (ctx_len == 0 || readBytes(sc.ctx_start, buf + 20, ctx_len)) &&
+              readBytes(want.tape_offset, buf + base, end - want.tape_offset);
+    if (ctx_len)
+        memcpy(buf + 20 + ctx_len, pause.data(), pause.size());
+    uint32_t dlen = n - 20;
+    buf[0x10] = dlen & 0xFF;
+    buf[0x11] = (dlen >> 8) & 0xFF;
+    buf[0x12] = (dlen >> 16) & 0xFF;
+    buf[0x13] = (dlen >> 24) & 0xFF;
+
+    std::vector<TapeEntry> found;
+    if (ok)
+    {
+        std::lock_guard<std::mutex> lock(s_tapclean_mutex);
+
+        int machine = TAPCLEAN_MACHINE_C64;
+        if (platform == 1) machine = TAPCLEAN_MACHINE_VIC20;
+        if (platform == 2) machine = TAPCLEAN_MACHINE_C16;
+
+        if (tapclean_load_buffer_ref(buf, n, machine, video ? 1 : 0))
+        {
+            int nprg = tapclean_analyze_tap(1);
+            std::vector<bool> is_cbm;
+            if (nprg > 0)
+                harvestEntries(nprg, base, want.tape_offset, want.start_time_ms, found, is_cbm);
+        }
+        tapclean_shutdown();
+    }
+    free(buf);
+
+    for (auto &e : found)
+    {
+        if (e.tape_offset == want.tape_offset && e.prg.size() == sc.size && e.name == want.name)
+        {
+            want.prg = std::move(e.prg);
+            want.checksum_ok = e.checksum_ok;
+            return true;
+        }
+    }
+    Debug_printv("Indexed program at %lu did not decode; rescanning", (unsigned long)want.tape_offset);
+    return false;
+}
+
+// The index no longer matches the image: forget it and scan
+void TapeDecoder::restartScan()
+{
+    std::string path = indexPath();
+    if (!path.empty())
+        remove(path.c_str());
+
+    entries.clear();
+    scans.clear();
+    confirmed = 0;
+    total_ms = 0;
+    fully_scanned = false;
+    indexed = false;
+    context.clear();
+    ctx_start = ctx_end = 0;
+}
+
 /********************************************************
  * Entry serving
  ********************************************************/
@@ -668,14 +1076,24 @@ bool TapeDecoder::nextProgram(uint32_t from_offset, TapeEntry &out)
 
     while (true)
     {
-        for (auto &e : entries)
+        bool rescan = false;
+        for (size_t i = 0; i < entries.size(); i++)
         {
+            TapeEntry &e = entries[i];
             if (e.tape_end_offset > from_offset)
             {
+                if (e.prg.empty() && !decodeEntry(i))
+                {
+                    restartScan();
+                    rescan = true;
+                    break;
+                }
                 out = e;
                 return true;
             }
         }
+        if (rescan)
+            continue;
         if (fully_scanned)
             return false;
         if (!extendScan())
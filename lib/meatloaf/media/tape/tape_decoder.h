@@ -26,11 +26,23 @@
 // programs list long before a large image has been downloaded. DMP/HTAP/
 // TAP-v2 sources are converted to TAP v1 on the fly as they stream in
 // (entry offsets then refer to the converted image). An entry found in a
-// partial window is only served once a later entry (or the tape end)
-// confirms it complete. When the whole image has been analyzed the pulse
+// partial window is only served once later entries (or the tape end)
+// confirm it complete. When the whole image has been analyzed the pulse
 // buffer is freed; what remains resident is the decoded program data
 // (typically well under 1 MB).
 //
+// Tapes longer than the scan window (TAPE_SCAN_WINDOW) are not held whole:
+// once a window has confirmed some programs it slides up to the first one
+// it could not confirm, so memory stays at about one window however long
+// the tape is. Turbo loaders take their parameters from the Kernal-loaded
+// boot block ahead of them, so the last such block is replayed in front of
+// each slice for the engine to find.
+//
+// A fully scanned plain TAP leaves an index (offsets, times, names) in
+// TAPE_INDEX_DIR. The next open() of the same image lists from it at once
+// and decodes each program from its own stretch of tape when it is asked
+// for, instead of scanning the tape again.
+//
 // Formats (auto-detected by signature):
 //  .tap  - "C64-TAPE-RAW", v0/v1 pulses (v2 = halfwaves, converted)
 //  .dmp  - "DC2N-TAP-RAW", 16-bit samples at counter_rate (usually 2 MHz),
@@ -47,6 +59,13 @@
 #include <string>
 #include <vector>
 
+#include "../../../../include/global_defines.h"
+
+// Where scan results are kept between mounts; unset = not kept
+#if !defined(TAPE_INDEX_DIR) && defined(SD_CARD)
+#define TAPE_INDEX_DIR "/sd" CACHE_DIR
+#endif
+
 class MStream;
 
 struct TapeEntry {
@@ -64,6 +83,7 @@ struct TapeEntry {
 
 class TapeDecoder {
 public:
+    TapeDecoder();
     ~TapeDecoder();
 
     // Parse the header; false if the stream is not a supported tape.
@@ -96,24 +116,53 @@ public:
     std::string platformName() const;
     std::string videoName() const;
 
+    // Tapes longer than this are analyzed through a sliding window of
+    // about this size (default TAPE_SCAN_WINDOW). Before open().
+    void setWindowLimit(uint32_t bytes) { window_limit = bytes; }
+
+    // Directory the scan index is kept in (default TAPE_INDEX_DIR; empty:
+    // none). Before open().
+    void setIndexDir(const std::string &dir) { index_dir = dir; }
+
+    // Largest pulse buffer this decoder has held
+    uint32_t bufferPeak() const { return buffer_peak; }
+
 private:
     bool readBytes(uint32_t pos, uint8_t *dst, uint32_t n);
     bool nextValue(uint32_t *pos, uint32_t *cycles);  // one (half)wave at *pos
     uint32_t machineClock() const;
 
-    // Progressive scanning: fetch/convert a prefix of the image, scan it,
-    // rebuild 'entries'. The LAST entry found in a partial window is
-    // withheld until a later entry (or the tape end) confirms it
-    // complete, so a window-truncated block is never served. DMP/HTAP/
-    // TAP-v2 sources are converted to TAP v1 on the fly as they stream
-    // in; entry offsets then refer to the converted image.
-    bool extendScan();                  // grow the window by one step
+    // Progressive scanning: fetch/convert the next stretch of the image,
+    // scan the window, take the entries it confirms. The LAST entry found
+    // in a partial window (and the one before, when the last is broken and
+    // may be its cut-off repeat copy) is withheld until later entries (or
+    // the tape end) confirm it complete, so a window-truncated block is
+    // never served. DMP/HTAP/TAP-v2 sources are converted to TAP v1 on the fly as
+    // they stream in; entry offsets then refer to the converted image.
+    bool extendScan();                  // grow or slide the window one step
     bool fetchTo(uint32_t target);      // raw fetch or streamed conversion
     bool appendValue(uint32_t cycles);  // encode one v1 pulse into 'image'
-    bool scanWindow(uint32_t win);
-    void harvestEntries(int nprg);      // engine PRG db -> entries (+filter)
+    bool reserve(uint32_t n);           // grow 'image' to hold n bytes
+    bool scanWindow();
+    void slideTo(uint32_t local, uint32_t ms);
+    uint32_t pulseBoundary(uint32_t local) const;
+    std::vector<uint8_t> pauseBytes() const;
+    // engine PRG db -> entries (+filter); buffer offset 'base' is tape
+    // offset 'origin' at tape time 'origin_ms'
+    void harvestEntries(int nprg, uint32_t base, uint32_t origin, uint32_t origin_ms,
+                        std::vector<TapeEntry> &out, std::vector<bool> &is_cbm);
     void finishScan();                  // full image analyzed: free it
 
+    bool sliding() const { return container_len > window_limit; }
+    uint32_t sliceEnd() const { return slice_start + (fetched - slice_base); }
+
+    // Scan index (plain TAP only)
+    std::string indexPath() const;
+    bool loadIndex();
+    void saveIndex();
+    bool decodeEntry(size_t i);         // one indexed program, on its own
+    void restartScan();                 // index didn't match: scan after all
+
     MStream *stream = nullptr;
     bool opened = false;
     uint32_t len = 0;          // analyzed (possibly converted) image length
@@ -138,14 +187,39 @@ private:
     std::vector<TapeEntry> entries;
     uint32_t total_ms = 0;
 
+    // Per entry: the Kernal boot block scanned ahead of it (where its
+    // loader found its parameters), and the program's size while only
+    // known from the index
+    struct EntryScan {
+        uint32_t ctx_start = 0;
+        uint32_t ctx_end = 0;
+        uint32_t size = 0;
+    };
+    std::vector<EntryScan> scans;       // parallel to 'entries'
+
     // Progressive scan state
     bool fully_scanned = false;
     bool converting = false;    // source needs TAP v1 conversion
-    uint8_t *image = nullptr;   // (converted) image prefix, PSRAM
+    uint8_t *image = nullptr;   // header + context + slice of the image, PSRAM
     uint32_t image_cap = 0;     // allocated size of 'image'
-    uint32_t fetched = 0;       // valid bytes of 'image' (== bytes scanned)
+    uint32_t buffer_peak = 0;
+    uint32_t fetched = 0;       // valid bytes of 'image'
     uint32_t conv_pos = 0;      // container read cursor (converting only)
     bool conv_eof = false;      // container exhausted (converting only)
+
+    // Sliding window: 'image' holds the 20-byte header, the replayed boot
+    // block, then the image from slice_start on (at buffer offset slice_base)
+    uint32_t window_limit = 0;
+    uint32_t slice_start = 20;  // image offset of the slice
+    uint32_t slice_base = 20;   // where the slice starts in 'image'
+    uint32_t slice_ms = 0;      // tape time at slice_start
+    size_t confirmed = 0;       // entries no later window can change
+    std::vector<uint8_t> context;   // boot block pulses (+ a pause)
+    uint32_t ctx_start = 0;     // ... and where they are on the tape
+    uint32_t ctx_end = 0;
+
+    std::string index_dir;
+    bool indexed = false;       // entries came from the index
 };
 
 #endif /* MEATLOAF_MEDIA_TAPE_DECODER */
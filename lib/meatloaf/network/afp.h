@@ -140,8 +140,11 @@ public:
             if (!user.empty() || !password.empty())
                 newSession->setCredentials(user, password);
             if (newSession->connect()) {
-                SessionBroker::add(key, newSession);
-                _session = newSession;
+                // Another drive may have connected first: use theirs
+                auto kept = SessionBroker::add(key, newSession);
+                if (kept != newSession)
+                    newSession->disconnect();
+                _session = std::static_pointer_cast<AFPMSession>(kept);
             }
         }
 
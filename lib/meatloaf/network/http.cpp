@@ -452,8 +452,9 @@ bool HTTPMStream::handleCommand(const std::string& cmd) {
 // (port == 443 ? "https://" : "http://"), so an HTTPS session was created as
 // "https://host:443" and stored as "http://host:443".
 // HTTPS is deliberately NOT a separate scheme here: one session is pooled per
-// host:port and the port already distinguishes the two (ml.h disposes
-// "http://api.meatloaf.cc:443" by that exact spelling).
+// host:port and the port already distinguishes the two (ml.h obtains the
+// api.meatloaf.cc session by host and port and relies on getting the one
+// HTTPMFile uses).
 HTTPMSession::HTTPMSession(std::string host, uint16_t port)
     : MSession(getScheme() + "://" + host + ":" + std::to_string(port), host, port)
 {
@@ -707,6 +708,8 @@ bool HTTPMStream::open(std::ios_base::openmode mode) {
     // 5 s grace period got its session disconnected out from under it.
     acquireSessionIO();
 
+    _ranged.reset(false);
+
     if(mode == (std::ios_base::out | std::ios_base::app))
         r = client.PUT(url);
     else if(mode == std::ios_base::out)
@@ -731,6 +734,19 @@ bool HTTPMStream::open(std::ios_base::openmode mode) {
     if ( client.wasRedirected )
         url = client.url;
 
+    // Whatever this stream writes makes the windows cached for the URL stale.
+    // A fresh GET drops them too: re-opening is the one point where a reader
+    // can expect to see the resource as it is now.
+    std::string cacheKey = url;
+    mstr::replaceAll(cacheKey, " ", "%20");
+    _session->invalidateRangeCache(cacheKey);
+
+    // A 206 to the probe with the total in Content-Range means every byte of
+    // the resource can be asked for by offset, which is all HTTPRangeCache
+    // needs. A restored POST response answers 200 and stays on the old path.
+    _ranged.reset(r && !(mode & std::ios_base::out) && client.lastRC == 206 &&
+                  client._range_size > 0 && client.postResponse.empty());
+
     //Debug_printv("r[%d] size[%d] url[%s] hurl[%s]", r, _size, url.c_str(), client.url.c_str());
 
     // On success the hold stays until close(); on failure release it here,
@@ -772,7 +788,44 @@ bool HTTPMStream::seek(uint32_t pos, int mode) {
     return seek( target );
 }
 
+bool HTTPMStream::useRangeCache() {
+    // Everything that gives _position a meaning other than "offset into the
+    // resource" - full mode, a queued send, a JSON result - or that wants one
+    // long response instead of windows - sequential access - keeps the
+    // streaming path.
+    return _ranged.ranged() && _session && _session->client &&
+           !(mode & std::ios_base::out) && fullMode == FullModeState::SIMPLE &&
+           !_queuedSend && !_jsonQueryRequested && _responseBuffer.empty() &&
+           !_session->client->_sequentialAccess;
+}
+
+void HTTPMStream::setSequentialAccess(bool on) {
+    if ( !_session || !_session->client )
+        return;
+
+    _session->client->_sequentialAccess = on;
+
+    // A bulk reader is better served by one open-ended response than by
+    // windows. Leave the cache until sequential access ends, and put the
+    // shared client where this stream is, since it has not been tracking us
+    // while the cache was in use. Coming back needs nothing: a seek on the
+    // cache is bookkeeping.
+    if ( _ranged.setSequential(on) )
+        seek( _position );
+}
+
 bool HTTPMStream::seek(uint32_t pos) {
+    // Ranged resource: a seek costs nothing. D64MStream and friends seek
+    // before nearly every sector they read, and each of those used to be a
+    // fresh range request; now the read that follows decides whether the
+    // network is needed at all.
+    if ( useRangeCache() ) {
+        if ( pos > _size )
+            return false;
+        _position = pos;
+        return true;
+    }
+
     if ( !_session->client->_is_open )
     {
         if ( !_session->client->reopen() ) {
@@ -1009,6 +1062,31 @@ uint32_t HTTPMStream::read(uint8_t* buf, uint32_t size) {
         _position = 0;
     }
 
+    if ( useRangeCache() ) {
+        auto client = _session->client;
+        std::string target = url;
+        mstr::replaceAll(target, " ", "%20");
+
+        auto cache = _session->rangeCache(target);
+        bytesRead = cache->read(_position, buf, size, _size,
+            [&](uint32_t pos, uint8_t* dst, uint32_t n) {
+                return client->fetchRange(target, pos, dst, n);
+            });
+        if ( bytesRead > 0 || _position >= _size ) {
+            _position += bytesRead;
+            _error = 0;
+            return bytesRead;
+        }
+
+        // The server stopped honouring ranges (or the connection is gone for
+        // good). Drop to the streaming path, which knows how to restart from
+        // 0 and skip forward, rather than report a short file.
+        Debug_printv("range fetch failed at pos[%u], falling back to streaming", _position);
+        _ranged.fail();
+        if ( !seek( _position ) )
+            return 0;
+    }
+
     if (size > available())
         size = available();
 
@@ -1712,6 +1790,53 @@ uint32_t MeatHttpClient::read(uint8_t* buf, uint32_t size) {
     return 0;
 };
 
+uint32_t MeatHttpClient::fetchRange(const std::string& dstUrl, uint32_t pos, uint8_t* buf, uint32_t size) {
+    if (size == 0 || !postResponse.empty())
+        return 0;
+
+    // The response open() left behind (the probe) may start exactly here; its
+    // bytes are already on the wire, so take them instead of asking again.
+    // It is only HTTP_BLOCK_SIZE long - the cache copes with a short window.
+    bool inFlight = _is_open && dstUrl == url && lastMethod == HTTP_METHOD_GET &&
+                    lastRC == 206 && pos == _position && !complete();
+
+    if (!inFlight) {
+        // Same drain-or-rebuild rule as seek(): re-using a handle whose
+        // previous response is still outstanding sends a stale request.
+        if (_is_open && !flush(0)) {
+            Debug_printv("response not fully drained — rebuilding the client handle");
+            init();
+        }
+
+        url = dstUrl;
+        lastMethod = HTTP_METHOD_GET;
+        if (!processRedirectsAndOpen(pos, size))
+            return 0;
+        if (lastRC != 206) {
+            // Served from 0 regardless of the Range header: nothing here is
+            // at `pos`, so it is of no use to the cache.
+            _position = 0;
+            return 0;
+        }
+    }
+
+    uint32_t got = 0;
+    while (got < size) {
+        int rc = esp_http_client_read(_http, (char *)buf + got, (int)(size - got));
+        if (rc <= 0)
+            break;
+        got += (uint32_t)rc;
+    }
+    _position = pos + got;
+
+    // Finish the response (the +5 lookahead openAndFetchHeaders() asks for)
+    // so the next request on this connection starts clean.
+    if (!flush(0))
+        init();
+
+    return got;
+}
+
 uint32_t MeatHttpClient::write(const uint8_t* buf, uint32_t size) {
     Debug_printv("MeatHttpClient::write called, _is_open=%d, size=%u", _is_open, size);
     if (!_is_open)
@@ -33,9 +33,11 @@ void http_set_insecure(bool v);
 #include "meatloaf.h"
 #include "meat_session.h"
 #include "service/mdns.h"
+#include "http_range.h"
 
 #include <esp_http_client.h>
 #include <functional>
+#include <list>
 #include <map>
 
 #include "../../../include/global_defines.h"
@@ -154,6 +156,10 @@ public:
     bool flush(uint32_t numBytes = 0); // Flush all remaining bytes if 0
     uint32_t read(uint8_t* buf, uint32_t size);
     uint32_t write(const uint8_t* buf, uint32_t size);
+    // One ranged GET of [pos, pos + size) of dstUrl into buf, response drained
+    // afterwards. Returns the bytes received; 0 on failure or when the server
+    // ignored the Range header. The fetcher behind HTTPRangeCache.
+    uint32_t fetchRange(const std::string& dstUrl, uint32_t pos, uint8_t* buf, uint32_t size);
 
     bool _is_open = false;
     bool _exists = false;
@@ -220,6 +226,17 @@ public:
     bool isSecure() const { return this->port == 443; }
 
     std::shared_ptr<MeatHttpClient> client;
+
+    // Range windows of the last HTTP_RANGE_CACHE_URLS resources read through
+    // this session. Held here rather than by the stream so the total stays
+    // bounded however many streams ImageBroker keeps open, and so it goes
+    // away with the session once the host has been idle. Hold the returned
+    // cache for the whole read; another drive may evict it meanwhile.
+    std::shared_ptr<HTTPRangeCache> rangeCache(const std::string& url) { return _rangeCaches.get(url); }
+    void invalidateRangeCache(const std::string& url) { _rangeCaches.invalidate(url); }
+
+private:
+    HTTPRangeCacheSet _rangeCaches;
 };
 
 
@@ -335,9 +352,7 @@ public:
     virtual bool seek(uint32_t pos, int mode) override;
     virtual bool seekPath(std::string path) override { return false; }
 
-    void setSequentialAccess(bool on) override {
-        if (_session && _session->client) _session->client->_sequentialAccess = on;
-    }
+    void setSequentialAccess(bool on) override;
 
     bool handleCommand(const std::string& cmd);
     void performJsonQuery(const std::string& pointer);
@@ -363,6 +378,13 @@ private:
 
     bool _io_held = false;
 
+    // Set by open() when the server answered the probe with 206 and a known
+    // total: seeks are then pure bookkeeping and reads go through the
+    // session's HTTPRangeCache. Off while sequential access is on, and for
+    // good once a range fetch fails.
+    HTTPRangeMode _ranged;
+    bool useRangeCache();
+
     HTTPRequestContext ctx;
     FullModeState fullMode = FullModeState::SIMPLE;
     bool _statusRequested = false;
@@ -0,0 +1,219 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "http_range.h"
+
+#include <algorithm>
+#include <cstring>
+
+HTTPRangeCache::HTTPRangeCache(uint32_t budget, uint32_t max_window)
+    : _budget(budget), _max_window(max_window)
+{
+    // A window bigger than the whole budget would evict itself on insert.
+    if (_max_window > _budget)
+        _max_window = _budget;
+    if (_max_window < HTTP_RANGE_WINDOW_MIN)
+        _max_window = HTTP_RANGE_WINDOW_MIN;
+}
+
+uint32_t HTTPRangeCache::read(uint32_t position, uint8_t* buf, uint32_t size, uint32_t total, const Fetcher& fetch)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    if (total > 0)
+    {
+        if (position >= total)
+            return 0;
+        if (size > total - position)
+            size = total - position;
+    }
+
+    uint32_t done = 0;
+    while (done < size)
+    {
+        uint32_t at = position + done;
+        uint32_t n = lookup(at, buf + done, size - done);
+        if (n > 0)
+        {
+            hits++;
+            done += n;
+            continue;
+        }
+
+        misses++;
+
+        // Start the window on a block boundary: the bytes in front of `at`
+        // belong to the same sector, and the next read of a media stream is
+        // as likely to want the link bytes at its head as anything after it.
+        uint32_t start = at - (at % HTTP_RANGE_WINDOW_MIN);
+        uint32_t w = nextWindow(at, (at - start) + (size - done));
+        if (total > 0)
+        {
+            if (start >= total)
+                break;
+            w = std::min(w, total - start);
+        }
+
+        Window win;
+        win.start = start;
+        win.data.resize(w);
+
+        requests++;
+        uint32_t got = fetch(start, win.data.data(), w);
+
+        // Nothing usable came back (connection failure, EOF). Report the
+        // short read rather than spinning on a fetch that will not succeed.
+        if (got == 0 || start + got <= at)
+            break;
+
+        win.data.resize(got);
+        insert(std::move(win));
+    }
+
+    if (done > 0)
+        touch(position, position + done);
+
+    return done;
+}
+
+void HTTPRangeCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _windows.clear();
+    _bytes = 0;
+    _window = HTTP_RANGE_WINDOW_MIN;
+    _have_last = false;
+}
+
+uint32_t HTTPRangeCache::lookup(uint32_t position, uint8_t* buf, uint32_t size)
+{
+    for (auto it = _windows.begin(); it != _windows.end(); ++it)
+    {
+        if (position < it->start || position >= it->end())
+            continue;
+
+        uint32_t n = std::min(size, it->end() - position);
+        memcpy(buf, it->data.data() + (position - it->start), n);
+
+        // Most recently used to the front, so eviction takes the stalest.
+        if (it != _windows.begin())
+            _windows.splice(_windows.begin(), _windows, it);
+        return n;
+    }
+    return 0;
+}
+
+uint32_t HTTPRangeCache::nextWindow(uint32_t position, uint32_t wanted)
+{
+    bool near = _have_last &&
+                (uint64_t)position + HTTP_RANGE_LOCALITY >= _last_start &&
+                (uint64_t)position <= (uint64_t)_last_end + HTTP_RANGE_LOCALITY;
+
+    // Staying in the neighbourhood of the last access - following a sector
+    // chain, walking a directory track, streaming forward - is what makes a
+    // bigger window pay off. Each step is 16x so a sequential reader reaches
+    // the ceiling on its second miss. A far jump starts over at one block:
+    // it is usually a one-off lookup, and guessing big there only wastes
+    // bandwidth and evicts windows that are still in use.
+    //
+    // The very first miss has nothing to judge by and starts on the middle
+    // step: it is the header of a disk image or the start of a file, and what
+    // is read next - BAM, directory, the rest of the track - lies right after.
+    if (!_have_last)
+        _window = std::min((uint32_t)HTTP_RANGE_WINDOW_MIN * 16, _max_window);
+    else if (near)
+        _window = std::min(_window * 16, _max_window);
+    else
+        _window = HTTP_RANGE_WINDOW_MIN;
+
+    // A single read bigger than the window is fetched in one go rather than
+    // as several back-to-back misses.
+    uint32_t w = _window;
+    if (wanted > w)
+    {
+        w = ((wanted + HTTP_RANGE_WINDOW_MIN - 1) / HTTP_RANGE_WINDOW_MIN) * HTTP_RANGE_WINDOW_MIN;
+        w = std::min(w, _max_window);
+    }
+    return w;
+}
+
+void HTTPRangeCache::insert(Window&& w)
+{
+    // A new window swallows any older one it covers completely - keeping
+    // both would only spend the budget on the same bytes twice.
+    for (auto it = _windows.begin(); it != _windows.end(); )
+    {
+        if (it->start >= w.start && it->end() <= w.end())
+        {
+            _bytes -= (uint32_t)it->data.size();
+            it = _windows.erase(it);
+        }
+        else
+            ++it;
+    }
+
+    _bytes += (uint32_t)w.data.size();
+    _windows.push_front(std::move(w));
+
+    // Never evict the window just fetched: the read that caused it has not
+    // been served from it yet.
+    while (_bytes > _budget && _windows.size() > 1)
+    {
+        _bytes -= (uint32_t)_windows.back().data.size();
+        _windows.pop_back();
+    }
+}
+
+void HTTPRangeCache::touch(uint32_t start, uint32_t end)
+{
+    _have_last = true;
+    _last_start = start;
+    _last_end = end;
+}
+
+std::shared_ptr<HTTPRangeCache> HTTPRangeCacheSet::get(const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto it = _caches.begin(); it != _caches.end(); ++it)
+    {
+        if (it->first == url)
+        {
+            if (it != _caches.begin())
+                _caches.splice(_caches.begin(), _caches, it);
+            return _caches.front().second;
+        }
+    }
+
+    _caches.emplace_front(url, std::make_shared<HTTPRangeCache>());
+    while (_caches.size() > _urls)
+        _caches.pop_back();
+    return _caches.front().second;
+}
+
+void HTTPRangeCacheSet::invalidate(const std::string& url)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _caches.remove_if([&](const std::pair<std::string, std::shared_ptr<HTTPRangeCache>>& e) {
+        return e.first == url;
+    });
+}
+
+size_t HTTPRangeCacheSet::size() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _caches.size();
+}
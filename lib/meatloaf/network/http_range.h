@@ -0,0 +1,184 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// Adaptive range windows for random-access reads over HTTP.
+//
+// A media stream seeks before nearly every read - D64MStream::seekSector() per
+// sector, per BAM record, per directory entry - and MeatHttpClient answered
+// each of those seeks with a fresh "bytes=pos-(pos+HTTP_BLOCK_SIZE+5)" request.
+// A LOAD"$" of a remote D64 was therefore dozens of ~260-byte round trips, most
+// of them for bytes that had been on the wire a moment earlier.
+//
+// HTTPRangeCache sits between HTTPMStream and the client. Seeks become pure
+// bookkeeping; a read is served from recently fetched windows when it can be,
+// and only a miss goes to the network. The window for a miss grows while the
+// reader stays local (256 B -> 4 KB -> 64 KB) and drops back to the smallest
+// step after a far jump, so a directory walk or a file chain costs a handful of
+// requests while a random block after a jump still costs only a small one.
+//
+// Deliberately free of esp_http_client: the fetch itself is handed in, which is
+// what lets test/native/test_http_range drive it against a stand-in server.
+
+#ifndef MEATLOAF_NETWORK_HTTP_RANGE
+#define MEATLOAF_NETWORK_HTTP_RANGE
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef TEST_NATIVE
+#include "sdkconfig.h"
+#endif
+
+// Smallest window; the same figure as HTTP_BLOCK_SIZE, which a window start
+// is also aligned down to so a sector of a D64/D71/D81 never straddles two.
+#define HTTP_RANGE_WINDOW_MIN 256
+
+// Largest window, the byte budget of one URL's cache, and how many URLs an
+// HTTPMSession keeps caches for. A board without PSRAM cannot afford 64 KB
+// reads, so it stops one step earlier and holds less.
+#ifdef CONFIG_SPIRAM
+#define HTTP_RANGE_WINDOW_MAX  (64 * 1024)
+#define HTTP_RANGE_CACHE_BYTES (128 * 1024)
+#define HTTP_RANGE_CACHE_URLS  4
+#else
+#define HTTP_RANGE_WINDOW_MAX  (4 * 1024)
+#define HTTP_RANGE_CACHE_BYTES (8 * 1024)
+#define HTTP_RANGE_CACHE_URLS  2
+#endif
+
+// How far from the previous access a miss may land and still count as "the
+// same neighbourhood". A little more than one zone-1 track of a 1541 image
+// (21 x 256 bytes), since a file's chain hops between adjacent tracks.
+#define HTTP_RANGE_LOCALITY (8 * 1024)
+
+class HTTPRangeCache
+{
+public:
+    // Performs ONE ranged GET of up to `size` bytes at `position` into `buf`
+    // and returns how many bytes arrived (0 on failure or at EOF).
+    using Fetcher = std::function<uint32_t(uint32_t position, uint8_t* buf, uint32_t size)>;
+
+    HTTPRangeCache(uint32_t budget = HTTP_RANGE_CACHE_BYTES,
+                   uint32_t max_window = HTTP_RANGE_WINDOW_MAX);
+
+    // Copy [position, position + size) into buf, fetching what is not cached.
+    // total is the resource length (0 = unknown) and bounds every fetch, so
+    // a window never asks the server for bytes past EOF. Two streams on one
+    // URL take turns; they would share the session's client anyway.
+    uint32_t read(uint32_t position, uint8_t* buf, uint32_t size, uint32_t total, const Fetcher& fetch);
+
+    // Forget every window, e.g. after the resource was written.
+    void clear();
+
+    // Window the next miss would use, exposed for diagnostics and tests.
+    uint32_t window() const { return _window; }
+    uint32_t bytes() const { return _bytes; }
+
+    uint32_t requests = 0;  // fetches issued
+    uint32_t hits = 0;      // reads (or parts of reads) served from memory
+    uint32_t misses = 0;
+
+private:
+    struct Window {
+        uint32_t start;
+        std::vector<uint8_t> data;
+
+        uint32_t end() const { return start + (uint32_t)data.size(); }
+    };
+
+    std::mutex _mutex;
+
+    // Front is most recently used.
+    std::list<Window> _windows;
+    uint32_t _bytes = 0;
+    uint32_t _budget;
+    uint32_t _max_window;
+    uint32_t _window = HTTP_RANGE_WINDOW_MIN;
+
+    // Extent of the previous access, hit or miss, for the locality test.
+    bool _have_last = false;
+    uint32_t _last_start = 0;
+    uint32_t _last_end = 0;
+
+    uint32_t lookup(uint32_t position, uint8_t* buf, uint32_t size);
+    uint32_t nextWindow(uint32_t position, uint32_t wanted);
+    void insert(Window&& w);
+    void touch(uint32_t start, uint32_t end);
+};
+
+// The caches of the last `urls` resources read through one HTTPMSession.
+// Every stream on a host shares the session, and drives read concurrently,
+// so the list is only touched under a lock and a reader keeps the cache it
+// got for the whole read: eviction drops the list's reference, not the
+// reader's, and a cache goes away with its last user.
+class HTTPRangeCacheSet
+{
+public:
+    HTTPRangeCacheSet(size_t urls = HTTP_RANGE_CACHE_URLS) : _urls(urls) {}
+
+    std::shared_ptr<HTTPRangeCache> get(const std::string& url);
+    void invalidate(const std::string& url);
+    size_t size() const;
+
+private:
+    mutable std::mutex _mutex;
+    size_t _urls;
+
+    // Front is most recently used.
+    std::list<std::pair<std::string, std::shared_ptr<HTTPRangeCache>>> _caches;
+};
+
+// Whether an HTTPMStream reads through its HTTPRangeCache. open() decides;
+// a bulk reader (a copy, an archive being unpacked) turns the cache off while
+// it wants one long response, and turning sequential access off again puts
+// back what open() decided. Only a server that stops honouring ranges turns
+// it off for good.
+class HTTPRangeMode
+{
+public:
+    void reset(bool ranged) { _ranged = ranged; _resume = false; }
+    void fail() { _ranged = false; _resume = false; }
+
+    // True when this turns the cache off: the shared client has not been
+    // following the stream, and must be put where it is.
+    bool setSequential(bool on)
+    {
+        if ( on && _ranged ) {
+            _ranged = false;
+            _resume = true;
+            return true;
+        }
+        if ( !on && _resume ) {
+            _ranged = true;
+            _resume = false;
+        }
+        return false;
+    }
+
+    bool ranged() const { return _ranged; }
+
+private:
+    bool _ranged = false;
+    bool _resume = false;   // ranged before sequential access began
+};
+
+#endif /* MEATLOAF_NETWORK_HTTP_RANGE */
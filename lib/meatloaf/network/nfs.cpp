@@ -111,17 +111,32 @@ bool NFSMFile::isDirectory()
     if(file_path=="/" || file_path.empty())
         return true;
 
-    auto nfs = getNFS();
-    if (!nfs) {
-        return false;
-    }
+    return stat().is_dir;
+}
 
-    struct nfs_stat_64 st;
-    if (nfs_stat64(nfs, std::string(basepath + file_path).c_str(), &st) < 0) {
-        return false;
+MSession::Attributes NFSMFile::stat()
+{
+    auto nfs = getNFS();
+    if (!_session || !nfs) {
+        return MSession::Attributes();
     }
 
-    return S_ISDIR(st.nfs_mode);
+    return _session->statCached(path, [&](MSession::Attributes& a) {
+        struct nfs_stat_64 st;
+        int rc = nfs_stat64(nfs, std::string(basepath + file_path).c_str(), &st);
+        if (rc == -ENOENT || rc == -ENOTDIR) {
+            return MSession::StatResult::Missing;
+        }
+        if (rc < 0) {
+            Debug_printv("stat failed: %s", nfs_get_error(nfs));
+            return MSession::StatResult::Error;
+        }
+        a.is_dir = S_ISDIR(st.nfs_mode);
+        a.size = st.nfs_size;
+        a.mtime = st.nfs_mtime;
+        a.ctime = st.nfs_ctime;
+        return MSession::StatResult::Found;
+    });
 }
 
 std::shared_ptr<MStream> NFSMFile::getSourceStream(std::ios_base::openmode mode) {
@@ -151,32 +166,12 @@ std::shared_ptr<MStream> NFSMFile::createStream(std::ios_base::openmode mode)
 
 time_t NFSMFile::getLastWrite()
 {
-    auto nfs = getNFS();
-    if (!nfs) {
-        return 0;
-    }
-
-    struct nfs_stat_64 st;
-    if (nfs_stat64(nfs, std::string(basepath + file_path).c_str(), &st) < 0) {
-        return 0;
-    }
-
-    return st.nfs_mtime;
+    return stat().mtime;
 }
 
 time_t NFSMFile::getCreationTime()
 {
-    auto nfs = getNFS();
-    if (!nfs) {
-        return 0;
-    }
-
-    struct nfs_stat_64 st;
-    if (nfs_stat64(nfs, std::string(basepath + file_path).c_str(), &st) < 0) {
-        return 0;
-    }
-
-    return st.nfs_ctime;
+    return stat().ctime;
 }
 
 uint64_t NFSMFile::getAvailableSpace()
@@ -213,6 +208,7 @@ bool NFSMFile::mkDir()
     }
 
     int rc = nfs_mkdir(nfs, std::string(basepath + file_path).c_str());
+    _session->invalidateAttributes(path);
     return (rc == 0);
 }
 
@@ -226,9 +222,7 @@ bool NFSMFile::exists()
         return true;
     }
 
-    struct nfs_stat_64 st;
-    int rc = nfs_stat64(nfs, std::string(basepath + file_path).c_str(), &st);
-    return (rc == 0);
+    return stat().exists;
 }
 
 
@@ -239,11 +233,14 @@ bool NFSMFile::remove() {
     }
 
     // Check if it's a directory or file
+    int rc;
     if (isDirectory()) {
-        return nfs_rmdir(nfs, std::string(basepath + file_path).c_str()) == 0;
+        rc = nfs_rmdir(nfs, std::string(basepath + file_path).c_str());
     } else {
-        return nfs_unlink(nfs, std::string(basepath + file_path).c_str()) == 0;
+        rc = nfs_unlink(nfs, std::string(basepath + file_path).c_str());
     }
+    _session->invalidateAttributes(path);
+    return (rc == 0);
 }
 
 
@@ -254,6 +251,8 @@ bool NFSMFile::rename(std::string pathTo) {
     }
 
     int rc = nfs_rename(nfs, std::string(basepath + file_path).c_str(), std::string(basepath + pathTo).c_str());
+    _session->invalidateAttributes(path);
+    _session->invalidateAttributes("/" + export_path + (pathTo[0] == '/' ? "" : "/") + pathTo);
     return (rc == 0);
 }
 
@@ -340,6 +339,8 @@ MFile* NFSMFile::getNextFileInDir()
     std::string ent_name = "";
     uint32_t ent_mode = 0;
     uint64_t ent_size = 0;
+    time_t ent_mtime = 0;
+    time_t ent_ctime = 0;
     
     if (!export_path.empty()) {
         // Verify we have a valid directory handle
@@ -359,6 +360,8 @@ MFile* NFSMFile::getNextFileInDir()
             ent_name = ent->name;
             ent_mode = ent->mode;
             ent_size = ent->size;
+            ent_mtime = ent->mtime.tv_sec;
+            ent_ctime = ent->ctime.tv_sec;
             // Skip current/parent directory entries
         } while (ent->name[0] == '.' && (ent->name[1] == '\0' || (ent->name[1] == '.' && ent->name[2] == '\0')));
     } else {
@@ -385,6 +388,18 @@ MFile* NFSMFile::getNextFileInDir()
         }
         file->is_dir = S_ISDIR(ent_mode);
 
+        // The listing already carries what a stat would return. Exports come
+        // from the mount list and have no times.
+        if (!export_path.empty() && _session) {
+            MSession::Attributes a;
+            a.exists = true;
+            a.is_dir = file->is_dir;
+            a.size = ent_size;
+            a.mtime = ent_mtime;
+            a.ctime = ent_ctime;
+            _session->cacheAttributes(file->path, a);
+        }
+
         return file;
     }
 
@@ -583,6 +598,12 @@ bool NFSMStream::open(std::ios_base::openmode mode) {
         return false;
     }
 
+    // Whatever was cached about this path is about to change
+    if (mode & std::ios_base::out) {
+        _written_path = parser->path;
+        _session->invalidateAttributes(_written_path);
+    }
+
     // Get file size using NFS stat
     struct nfs_stat_64 st;
     if (nfs_fstat64(nfs, _handle, &st) == 0) {
@@ -610,6 +631,10 @@ void NFSMStream::close() {
         _size = 0;
     }
     if (_session) {
+        if (!_written_path.empty()) {
+            _session->invalidateAttributes(_written_path);
+            _written_path.clear();
+        }
         _session->releaseIO();
     }
 };
@@ -255,6 +255,9 @@ public:
 protected:
     bool dirOpened = false;
 
+    // This path's attributes, through the session's stat cache
+    MSession::Attributes stat();
+
     std::shared_ptr<NFSMSession> _session;
     struct nfs_context* _export_context = nullptr;  // Export-specific context owned by session
     struct nfsdir *_handle_dir = nullptr;
@@ -345,6 +348,7 @@ protected:
     std::shared_ptr<NFSMSession> _session;
     struct nfsfh *_handle = nullptr;
     std::string _export;  // Store the export path for context selection
+    std::string _written_path;  // Opened for writing: dropped from the stat cache on close
     struct nfs_context* _export_context = nullptr;  // Export-specific context owned by this stream
 
     struct nfs_context* getNFS() { 
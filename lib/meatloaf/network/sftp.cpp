@@ -253,7 +253,12 @@ SFTPMFile::SFTPMFile(std::string path): MFile(path) {
             m_isNull = true;
             return;
         }
-        SessionBroker::add(key, _session);
+        // Another drive may have connected first: use theirs
+        auto kept = SessionBroker::add(key, _session);
+        if (kept != _session) {
+            _session->disconnect();
+            _session = std::static_pointer_cast<SFTPMSession>(kept);
+        }
     }
 
     // Validate path
@@ -288,6 +293,13 @@ bool SFTPMFile::pathValid(std::string path) {
         return false;
     }
 
+    // Every entry of a listing is constructed here, so the listing's own
+    // attributes answering saves one round trip per entry
+    MSession::Attributes cached;
+    if (_session->getCachedAttributes(path, cached) && cached.exists) {
+        return true;
+    }
+
     sftp_session sftp = getSFTPSession();
     if (!sftp) {
         return false;
@@ -306,13 +318,17 @@ bool SFTPMFile::pathValid(std::string path) {
 
 bool SFTPMFile::isDirectory() {
     if (is_dir > -1) return is_dir;
+    return stat().is_dir;
+}
+
+MSession::Attributes SFTPMFile::stat() {
     if (!_session || !_session->connect()) {
-        return false;
+        return MSession::Attributes();
     }
 
     sftp_session sftp = getSFTPSession();
     if (!sftp) {
-        return false;
+        return MSession::Attributes();
     }
 
     std::string full_path = path;
@@ -320,15 +336,23 @@ bool SFTPMFile::isDirectory() {
         full_path = "/";
     }
 
-    sftp_attributes attrs = sftp_stat(sftp, full_path.c_str());
-    if (attrs == nullptr) {
-        return false;
-    }
-
-    bool is_dir = (attrs->type == SSH_FILEXFER_TYPE_DIRECTORY);
-    sftp_attributes_free(attrs);
-    
-    return is_dir;
+    return _session->statCached(full_path, [&](MSession::Attributes& a) {
+        sftp_attributes attrs = sftp_stat(sftp, full_path.c_str());
+        if (attrs == nullptr) {
+            int err = sftp_get_error(sftp);
+            if (err == SSH_FX_NO_SUCH_FILE || err == SSH_FX_NO_SUCH_PATH) {
+                return MSession::StatResult::Missing;
+            }
+            Debug_printv("stat failed: sftp error %d", err);
+            return MSession::StatResult::Error;
+        }
+        a.is_dir = (attrs->type == SSH_FILEXFER_TYPE_DIRECTORY);
+        a.size = attrs->size;
+        a.mtime = attrs->mtime;
+        a.ctime = attrs->atime;
+        sftp_attributes_free(attrs);
+        return MSession::StatResult::Found;
+    });
 }
 
 bool SFTPMFile::exists() {
@@ -336,45 +360,12 @@ bool SFTPMFile::exists() {
 }
 
 time_t SFTPMFile::getLastWrite() {
-    if (!_session || !_session->connect()) {
-        return 0;
-    }
-
-    sftp_session sftp = getSFTPSession();
-    if (!sftp) {
-        return 0;
-    }
-
-    sftp_attributes attrs = sftp_stat(sftp, path.c_str());
-    if (attrs == nullptr) {
-        return 0;
-    }
-
-    time_t mtime = attrs->mtime;
-    sftp_attributes_free(attrs);
-    
-    return mtime;
+    return stat().mtime;
 }
 
 time_t SFTPMFile::getCreationTime() {
-    if (!_session || !_session->connect()) {
-        return 0;
-    }
-
-    sftp_session sftp = getSFTPSession();
-    if (!sftp) {
-        return 0;
-    }
-
-    sftp_attributes attrs = sftp_stat(sftp, path.c_str());
-    if (attrs == nullptr) {
-        return 0;
-    }
-
-    time_t atime = attrs->atime;
-    sftp_attributes_free(attrs);
-    
-    return atime;
+    // SFTP v3 has no creation time; the access time has always stood in
+    return stat().ctime;
 }
 
 uint64_t SFTPMFile::getAvailableSpace() {
@@ -470,6 +461,16 @@ MFile* SFTPMFile::getNextFileInDir() {
     }
     entry_path += attrs->name;
 
+    // Cached before the entry is constructed: its constructor checks that
+    // the path exists, which this answers
+    MSession::Attributes a;
+    a.exists = true;
+    a.is_dir = (attrs->type == SSH_FILEXFER_TYPE_DIRECTORY);
+    a.size = attrs->size;
+    a.mtime = attrs->mtime;
+    a.ctime = attrs->atime;
+    _session->cacheAttributes((mstr::endsWith(path, "/") ? path : path + "/") + attrs->name, a);
+
     //Debug_printv("Directory entry: %s (type=%d)", entry_path.c_str(), attrs->type);
 
     SFTPMFile* file = new SFTPMFile(entry_path);
@@ -496,6 +497,7 @@ bool SFTPMFile::mkDir() {
     }
 
     int rc = sftp_mkdir(sftp, path.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    _session->invalidateAttributes(path);
     if (rc != SSH_OK) {
         Debug_printv("Failed to create directory: %s - error: %d", 
                      path.c_str(), sftp_get_error(sftp));
@@ -522,6 +524,7 @@ bool SFTPMFile::remove() {
     } else {
         rc = sftp_unlink(sftp, path.c_str());
     }
+    _session->invalidateAttributes(path);
 
     if (rc != SSH_OK) {
         Debug_printv("Failed to remove: %s - error: %d", 
@@ -544,6 +547,8 @@ bool SFTPMFile::rename(std::string dest) {
     }
 
     int rc = sftp_rename(sftp, path.c_str(), dest.c_str());
+    _session->invalidateAttributes(path);
+    _session->invalidateAttributes(dest);
     if (rc != SSH_OK) {
         Debug_printv("Failed to rename %s to %s - error: %d", 
                      path.c_str(), dest.c_str(), sftp_get_error(sftp));
@@ -672,7 +677,11 @@ bool SFTPMStream::open(std::ios_base::openmode mode) {
             Debug_printv("Failed to connect SFTP session");
             return false;
         }
-        SessionBroker::add(key, _session);
+        auto kept = SessionBroker::add(key, _session);
+        if (kept != _session) {
+            _session->disconnect();
+            _session = std::static_pointer_cast<SFTPMSession>(kept);
+        }
     } else if (!_session->isConnected()) {
         if (!_session->connect()) {
             Debug_printv("Failed to reconnect SFTP session");
@@ -701,6 +710,12 @@ bool SFTPMStream::open(std::ios_base::openmode mode) {
     this->mode = mode;
     _position = 0;
 
+    // Whatever was cached about this path is about to change
+    if ((mode & std::ios_base::out) && _session) {
+        _written_path = parser->path;
+        _session->invalidateAttributes(_written_path);
+    }
+
     // Get file size
     sftp_attributes attrs = sftp_fstat(_file_handle);
     if (attrs) {
@@ -785,6 +800,10 @@ void SFTPMStream::close() {
     Debug_printv("Closing SFTP stream");
 
     if (_session) {
+        if (!_written_path.empty()) {
+            _session->invalidateAttributes(_written_path);
+            _written_path.clear();
+        }
         _session->releaseIO();
     }
 
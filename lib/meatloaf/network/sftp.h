@@ -112,6 +112,9 @@ private:
     void openDir(std::string path);
     void closeDir();
     bool pathValid(std::string path);
+
+    // This path's attributes, through the session's stat cache
+    MSession::Attributes stat();
     
     sftp_attributes current_attrs = nullptr;
 };
@@ -159,6 +162,7 @@ protected:
     static constexpr uint32_t BUFFER_THRESHOLD = 1024 * 1024; // 1MB
     std::shared_ptr<MSession::CachedFile> _cached_file;
     bool _buffered = false;
+    std::string _written_path;  // Opened for writing: dropped from the stat cache on close
     bool bufferEntireFile();
 
 private:
@@ -77,17 +77,32 @@ bool SMBMFile::isDirectory()
     if(share_path=="/" || share_path.empty())
         return true;
 
-    auto smb = getSMB();
-    if (!smb) {
-        return false;
-    }
+    return stat().is_dir;
+}
 
-    struct smb2_stat_64 st;
-    if (smb2_stat(smb, std::string(basepath + share_path).c_str(), &st) < 0) {
-        return false;
+MSession::Attributes SMBMFile::stat()
+{
+    auto smb = getSMB();
+    if (!_session || !smb) {
+        return MSession::Attributes();
     }
 
-    return st.smb2_type == SMB2_TYPE_DIRECTORY;
+    return _session->statCached(path, [&](MSession::Attributes& a) {
+        struct smb2_stat_64 st;
+        int rc = smb2_stat(smb, std::string(basepath + share_path).c_str(), &st);
+        if (rc == -ENOENT || rc == -ENOTDIR) {
+            return MSession::StatResult::Missing;
+        }
+        if (rc < 0) {
+            Debug_printv("stat failed: %s", smb2_get_error(smb));
+            return MSession::StatResult::Error;
+        }
+        a.is_dir = (st.smb2_type == SMB2_TYPE_DIRECTORY);
+        a.size = st.smb2_size;
+        a.mtime = st.smb2_mtime;
+        a.ctime = st.smb2_ctime;
+        return MSession::StatResult::Found;
+    });
 }
 
 std::shared_ptr<MStream> SMBMFile::getSourceStream(std::ios_base::openmode mode) {
@@ -117,32 +132,12 @@ std::shared_ptr<MStream> SMBMFile::createStream(std::ios_base::openmode mode)
 
 time_t SMBMFile::getLastWrite()
 {
-    auto smb = getSMB();
-    if (!smb) {
-        return 0;
-    }
-
-    struct smb2_stat_64 st;
-    if (smb2_stat(smb, std::string(basepath + share_path).c_str(), &st) < 0) {
-        return 0;
-    }
-
-    return st.smb2_mtime;
+    return stat().mtime;
 }
 
 time_t SMBMFile::getCreationTime()
 {
-    auto smb = getSMB();
-    if (!smb) {
-        return 0;
-    }
-
-    struct smb2_stat_64 st;
-    if (smb2_stat(smb, std::string(basepath + share_path).c_str(), &st) < 0) {
-        return 0;
-    }
-
-    return st.smb2_ctime;
+    return stat().ctime;
 }
 
 uint64_t SMBMFile::getAvailableSpace()
@@ -174,6 +169,7 @@ bool SMBMFile::mkDir()
     }
 
     int rc = smb2_mkdir(smb, std::string(basepath + share_path).c_str());
+    _session->invalidateAttributes(path);
     return (rc == 0);
 }
 
@@ -187,9 +183,7 @@ bool SMBMFile::exists()
         return true;
     }
 
-    struct smb2_stat_64 st;
-    int rc = smb2_stat(smb, std::string(basepath + share_path).c_str(), &st);
-    return (rc == 0);
+    return stat().exists;
 }
 
 
@@ -200,11 +194,14 @@ bool SMBMFile::remove() {
     }
 
     // Check if it's a directory or file
+    int rc;
     if (isDirectory()) {
-        return smb2_rmdir(smb, std::string(basepath + share_path).c_str()) == 0;
+        rc = smb2_rmdir(smb, std::string(basepath + share_path).c_str());
     } else {
-        return smb2_unlink(smb, std::string(basepath + share_path).c_str()) == 0;
+        rc = smb2_unlink(smb, std::string(basepath + share_path).c_str());
     }
+    _session->invalidateAttributes(path);
+    return (rc == 0);
 }
 
 
@@ -215,6 +212,8 @@ bool SMBMFile::rename(std::string pathTo) {
     }
 
     int rc = smb2_rename(smb, std::string(basepath + share_path).c_str(), std::string(basepath + pathTo).c_str());
+    _session->invalidateAttributes(path);
+    _session->invalidateAttributes("/" + share + (pathTo[0] == '/' ? "" : "/") + pathTo);
     return (rc == 0);
 }
 
@@ -304,6 +303,8 @@ MFile* SMBMFile::getNextFileInDir()
     std::string ent_name = "";
     uint32_t ent_type = 0;
     uint64_t ent_size = 0;
+    time_t ent_mtime = 0;
+    time_t ent_ctime = 0;
     if (!share.empty()) {
         auto smb = getSMB();
         struct smb2dirent *ent;
@@ -316,6 +317,8 @@ MFile* SMBMFile::getNextFileInDir()
             ent_name = ent->name;
             ent_type = ent->st.smb2_type;
             ent_size = ent->st.smb2_size;
+            ent_mtime = ent->st.smb2_mtime;
+            ent_ctime = ent->st.smb2_ctime;
             // Skip hidden files and current/parent directory entries
         } while (ent->name[0] == '.' && (ent->name[1] == '\0' || (ent->name[1] == '.' && ent->name[2] == '\0')));
         //Debug_printv("FILES ent_name[%s] ent_type[%d] ent_size[%llu]", ent_name.c_str(), ent_type, ent_size);
@@ -347,6 +350,19 @@ MFile* SMBMFile::getNextFileInDir()
         }
         file->is_dir = (ent_type == SMB2_TYPE_DIRECTORY) ? 1 : 0;
 
+        // The listing already carries what a stat would return, so the
+        // isDirectory()/getLastWrite() that follow a directory-then-load cost
+        // nothing. Shares come from enumeration and have no times.
+        if (!share.empty() && _session) {
+            MSession::Attributes a;
+            a.exists = true;
+            a.is_dir = file->is_dir;
+            a.size = ent_size;
+            a.mtime = ent_mtime;
+            a.ctime = ent_ctime;
+            _session->cacheAttributes(file->path, a);
+        }
+
         return file;
     }
 
@@ -554,6 +570,12 @@ bool SMBMStream::open(std::ios_base::openmode mode) {
         return false;
     }
 
+    // Whatever was cached about this path is about to change
+    if (mode & std::ios_base::out) {
+        _written_path = parser->path;
+        _session->invalidateAttributes(_written_path);
+    }
+
     // Get file size using SMB2 stat
     struct smb2_stat_64 st;
     if (smb2_fstat(smb, _handle, &st) == 0) {
@@ -565,6 +587,12 @@ bool SMBMStream::open(std::ios_base::openmode mode) {
     }
 
     _position = 0;
+
+    // Reads of a read-only stream are served ahead of the reader
+    if (!(mode & std::ios_base::out) && _size > 0) {
+        _read_ahead.begin(smb, _handle, _size);
+    }
+
     if (_session) {
         _session->acquireIO();
     }
@@ -574,6 +602,7 @@ bool SMBMStream::open(std::ios_base::openmode mode) {
 void SMBMStream::close() {
     if(isOpen()) {
         auto smb = getSMB();
+        _read_ahead.end();
         if (smb && _handle) {
             smb2_close(smb, _handle);
         }
@@ -582,6 +611,10 @@ void SMBMStream::close() {
         _size = 0;
     }
     if (_session) {
+        if (!_written_path.empty()) {
+            _session->invalidateAttributes(_written_path);
+            _written_path.clear();
+        }
         _session->releaseIO();
     }
 };
@@ -604,6 +637,21 @@ uint32_t SMBMStream::read(uint8_t* buf, uint32_t size) {
         return 0;
     }
 
+    if (_read_ahead.active()) {
+        int bytesRead = _read_ahead.read(_position, buf, size);
+        if (bytesRead < 0) {
+            Debug_printv("SMB read error: %s (rc=%d)", smb2_get_error(smb), bytesRead);
+            _error = -bytesRead;
+            return 0;
+        }
+        _position += bytesRead;
+
+        // Reads ahead don't move the handle's offset; keep it in step for
+        // seek(SEEK_CUR) and the write path. SEEK_SET is local to libsmb2.
+        smb2_lseek(smb, _handle, _position, SEEK_SET, NULL);
+        return bytesRead;
+    }
+
     int bytesRead = smb2_read(smb, _handle, buf, size);
 
     if (bytesRead < 0) {
@@ -631,6 +679,7 @@ bool SMBMStream::seek(uint32_t pos) {
         return false;
     }
 
+    _read_ahead.seek(pos);
     _position = pos;
     return true;
 };
@@ -651,6 +700,7 @@ bool SMBMStream::seek(uint32_t pos, int mode) {
     }
 
     // Update position based on actual result from lseek
+    _read_ahead.seek(result);
     _position = (uint32_t)result;
 
     return true;
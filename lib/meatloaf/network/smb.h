@@ -26,6 +26,7 @@
 #include "meatloaf.h"
 #include "meat_session.h"
 #include "service/mdns.h"
+#include "smb_readahead.h"
 
 #include <smb2.h>
 #include <libsmb2.h>
@@ -417,6 +418,9 @@ public:
 protected:
     bool dirOpened = false;
 
+    // This path's attributes, through the session's stat cache
+    MSession::Attributes stat();
+
     std::shared_ptr<SMBMSession> _session;
     struct smb2_context* _share_context = nullptr;  // Share-specific context owned by session
     struct smb2dir *_handle_dir = nullptr;
@@ -510,6 +514,8 @@ protected:
     struct smb2fh *_handle = nullptr;
     std::string _share;  // Store the share name for context selection
     struct smb2_context* _share_context = nullptr;  // Share-specific context owned by this stream
+    std::string _written_path;  // Opened for writing: dropped from the stat cache on close
+    SMBReadAhead _read_ahead;   // Read-only streams: READs kept in flight ahead of the reader
 
     struct smb2_context* getSMB() { 
         if (_share_context) {
@@ -0,0 +1,231 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "smb_readahead.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#include <sys/poll.h>   // only for the POLLIN/POLLOUT libsmb2 speaks in
+#endif
+
+void SMBReadAhead::begin(struct smb2_context* smb, struct smb2fh* fh, uint64_t size)
+{
+    reset();
+    _smb = smb;
+    _fh = fh;
+    _size = size;
+
+    // A READ larger than the server's MaxReadSize is refused outright
+    _max_chunk = SMB_READAHEAD_CHUNK;
+    uint32_t server_max = smb2_get_max_read_size(smb);
+    if (server_max > 0 && server_max < _max_chunk)
+        _max_chunk = server_max;
+
+    restart(0);
+}
+
+void SMBReadAhead::completed(struct smb2_context* smb, int status, void* command_data, void* private_data)
+{
+    (void)smb;
+    (void)command_data;
+    Request* r = (Request*)private_data;
+    if (r->orphaned) {
+        delete r;
+        return;
+    }
+    r->status = status;
+    r->done = true;
+}
+
+void SMBReadAhead::reset()
+{
+    for (Request* r : _window) {
+        if (r->done)
+            delete r;
+        else
+            r->orphaned = true;   // completed() frees it
+    }
+    _window.clear();
+}
+
+void SMBReadAhead::restart(uint64_t offset)
+{
+    reset();
+    _next = offset;
+    _chunk = std::min<uint32_t>(SMB_READAHEAD_FIRST, _max_chunk);
+    _slots = 1;
+}
+
+bool SMBReadAhead::issue()
+{
+    if (_next >= _size)
+        return false;
+
+    Request* r = new Request();
+    r->offset = _next;
+    r->count = (uint32_t)std::min<uint64_t>(_chunk, _size - _next);
+    r->data.resize(r->count);
+
+    if (smb2_pread_async(_smb, _fh, r->data.data(), r->count, r->offset, completed, r) < 0) {
+        delete r;
+        return false;
+    }
+
+    _window.push_back(r);
+    _next += r->count;
+    requests++;
+    return true;
+}
+
+void SMBReadAhead::fill()
+{
+    while (_window.size() < _slots && issue())
+        ;
+}
+
+// One round of the context's event loop: send what is queued, take in what
+// has arrived. Returns 1 if there was something to do, 0 on timeout, -1 if
+// the context has failed.
+int SMBReadAhead::service(int timeout_ms)
+{
+    int fd = smb2_get_fd(_smb);
+    int events = smb2_which_events(_smb);
+
+    fd_set rfds, wfds;
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    if (events & POLLIN)
+        FD_SET(fd, &rfds);
+    if (events & POLLOUT)
+        FD_SET(fd, &wfds);
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+    int rc = select(fd + 1, &rfds, &wfds, nullptr, &tv);
+    if (rc < 0)
+        return -1;
+    if (rc == 0)
+        return 0;
+
+    int revents = 0;
+    if (FD_ISSET(fd, &rfds))
+        revents |= POLLIN;
+    if (FD_ISSET(fd, &wfds))
+        revents |= POLLOUT;
+    return (smb2_service(_smb, revents) < 0) ? -1 : 1;
+}
+
+// Service the context until r has its answer. Other requests' answers -
+// ours or another stream's on the same share - are handled on the way.
+bool SMBReadAhead::wait(Request* r)
+{
+    uint32_t idle_ms = 0;
+    while (!r->done) {
+        int rc = service(100);
+        if (rc < 0)
+            return false;
+        if (rc == 0) {
+            idle_ms += 100;
+            if (idle_ms >= SMB_READAHEAD_TIMEOUT_MS)
+                return false;
+        } else {
+            idle_ms = 0;
+        }
+    }
+    return true;
+}
+
+void SMBReadAhead::seek(uint64_t offset)
+{
+    if (_window.empty())
+        return;
+    if (offset < _window.front()->offset || offset >= _next)
+        restart(offset);
+}
+
+int SMBReadAhead::read(uint64_t offset, uint8_t* buf, uint32_t size)
+{
+    if (!_smb)
+        return -EBADF;
+    if (offset >= _size)
+        return 0;
+    if (size > _size - offset)
+        size = (uint32_t)(_size - offset);
+
+    // Forget what the reader has moved past; anything not ahead of it
+    // starts over from where it is.
+    while (!_window.empty() && _window.front()->done &&
+           offset >= _window.front()->offset + _window.front()->count) {
+        delete _window.front();
+        _window.pop_front();
+    }
+    if (_window.empty() ? offset != _next : offset < _window.front()->offset || offset >= _next)
+        restart(offset);
+
+    uint32_t total = 0;
+    while (total < size) {
+        fill();
+        if (_window.empty())
+            break;
+
+        Request* r = _window.front();
+        if (!wait(r)) {
+            restart(offset + total);
+            return total ? (int)total : -EIO;
+        }
+        if (r->status < 0) {
+            int err = r->status;
+            restart(offset + total);
+            return total ? (int)total : err;
+        }
+
+        uint64_t at = offset + total;
+        uint64_t end = r->offset + (uint32_t)r->status;
+        if (at >= end) {
+            // The file ended short of the size it was opened with
+            _size = end;
+            restart(at);
+            break;
+        }
+
+        uint32_t n = (uint32_t)std::min<uint64_t>(size - total, end - at);
+        memcpy(buf + total, r->data.data() + (at - r->offset), n);
+        total += n;
+
+        if (at + n >= r->offset + r->count) {
+            // Consumed to its end: the reader is sequential
+            delete r;
+            _window.pop_front();
+            _chunk = std::min<uint32_t>(_chunk * 2, _max_chunk);
+            _slots = SMB_READAHEAD_SLOTS;
+        }
+    }
+
+    // Put the new READs on the wire now, so they travel while the caller
+    // works through what it was just handed
+    fill();
+    if (!_window.empty())
+        service(0);
+    return (int)total;
+}
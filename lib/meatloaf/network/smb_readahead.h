@@ -0,0 +1,129 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// Pipelined read-ahead for SMB2 file reads.
+//
+// SMBMStream::read() used to hand every caller read to a blocking smb2_read(),
+// so the 256-byte sector reads of the media layer and the 2 KB refills of
+// mfilebuf each cost a full SMB2 round trip. SMBReadAhead keeps READs in
+// flight with libsmb2's async API instead and serves reads from them.
+//
+// After an open or a seek away from what is buffered, one small READ goes out
+// (SMB_READAHEAD_FIRST), so a random sector costs little more than it did.
+// Every READ the reader then consumes to its end doubles the size of the next,
+// up to SMB_READAHEAD_CHUNK or the server's MaxReadSize, and opens the window
+// to SMB_READAHEAD_SLOTS requests in flight - a sequential LOAD or copy soon
+// runs at link speed rather than at one round trip per read.
+//
+// Requests are owned by their completion callback once abandoned, so dropping
+// the window never waits for the network: a response that arrives after the
+// stream has moved on is freed by whichever call services the context next.
+
+#ifndef MEATLOAF_NETWORK_SMB_READAHEAD
+#define MEATLOAF_NETWORK_SMB_READAHEAD
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <smb2.h>
+#include <libsmb2.h>
+
+#ifndef TEST_NATIVE
+#include "sdkconfig.h"
+#endif
+
+// Requests in flight once a reader is sequential, and the largest of them.
+// Without PSRAM the window has to stay within internal RAM.
+#ifndef SMB_READAHEAD_SLOTS
+#ifdef CONFIG_SPIRAM
+#define SMB_READAHEAD_SLOTS     4
+#define SMB_READAHEAD_CHUNK     (64 * 1024)
+#else
+#define SMB_READAHEAD_SLOTS     2
+#define SMB_READAHEAD_CHUNK     (8 * 1024)
+#endif
+#endif
+
+// The first READ after an open or a far seek
+#define SMB_READAHEAD_FIRST     4096
+
+// How long a READ may go unanswered before the read fails
+#define SMB_READAHEAD_TIMEOUT_MS 10000
+
+class SMBReadAhead
+{
+public:
+    SMBReadAhead() = default;
+    ~SMBReadAhead() { reset(); }
+
+    SMBReadAhead(const SMBReadAhead&) = delete;
+    SMBReadAhead& operator=(const SMBReadAhead&) = delete;
+
+    // Start serving reads of fh, which is `size` bytes long
+    void begin(struct smb2_context* smb, struct smb2fh* fh, uint64_t size);
+
+    // Read up to `size` bytes at `offset`. Returns the byte count, 0 at end
+    // of file, or -errno.
+    int read(uint64_t offset, uint8_t* buf, uint32_t size);
+
+    // The reader is moving to `offset`: keep the window if it covers it,
+    // drop it otherwise.
+    void seek(uint64_t offset);
+
+    // Abandon everything in flight
+    void reset();
+
+    // Stop serving fh, before it is closed
+    void end() { reset(); _smb = nullptr; _fh = nullptr; }
+
+    bool active() const { return _smb != nullptr; }
+
+    // READs sent, for the curious
+    uint32_t requests = 0;
+
+private:
+    struct Request {
+        uint64_t offset = 0;
+        uint32_t count = 0;
+        int status = 0;
+        bool done = false;
+        bool orphaned = false;
+        std::vector<uint8_t> data;
+    };
+
+    static void completed(struct smb2_context* smb, int status, void* command_data, void* private_data);
+
+    bool issue();
+    void fill();
+    int service(int timeout_ms);
+    bool wait(Request* r);
+    void restart(uint64_t offset);
+
+    struct smb2_context* _smb = nullptr;
+    struct smb2fh* _fh = nullptr;
+    uint64_t _size = 0;
+    uint32_t _max_chunk = SMB_READAHEAD_CHUNK;
+
+    std::deque<Request*> _window;   // in offset order, contiguous
+    uint64_t _next = 0;             // offset the next READ asks for
+    uint32_t _chunk = SMB_READAHEAD_FIRST;
+    uint32_t _slots = 1;
+};
+
+#endif // MEATLOAF_NETWORK_SMB_READAHEAD
@@ -545,8 +545,9 @@ void TNFSHandle::obtain(std::string m_url, std::ios_base::openmode mode) {
 
     Debug_printv("Connecting to server[%s] port[%d] filepath[%s]", server.c_str(), port, filepath.c_str());
 
-    // Initialize mount info
+    // Initialize mount info, with any ?window= or ?cache= from the URL
     _mountinfo = std::make_unique<tnfsMountInfo>(server.c_str(), port);
+    _mountinfo->set_options(parser->query.c_str());
 
     // Mount the server
     int result = tnfs_mount(_mountinfo.get());
@@ -656,8 +657,10 @@ bool TNFSMStream::open(std::ios_base::openmode mode) {
 
     Debug_printv("Opening file[%s] mode[0x%X] perms[0x%X]", parser->path.c_str(), tnfs_mode, create_perms);
 
-    // Open the file using the shared session's mountinfo
+    // Open the file using the shared session's mountinfo. A ?window= or
+    // ?cache= in the URL tunes the mount for files opened from now on.
     tnfsMountInfo* mountinfo = _session->getMountInfo();
+    mountinfo->set_options(parser->query.c_str());
     int result = tnfs_open(mountinfo, parser->path.c_str(), tnfs_mode, create_perms, &_handle);
     if (result != TNFS_RESULT_SUCCESS) {
         Debug_printv("Failed to open file %s: error %d", parser->path.c_str(), result);
@@ -0,0 +1,106 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "content_index.h"
+
+#include <memory>
+
+#include "meatloaf.h"
+
+bool ContentIndexer::isContainer(const std::string &name)
+{
+    // The first filesystem is the default one, which takes any path. The
+    // network ones match on a scheme, which a bare file name never has.
+    for (auto i = MFSOwner::availableFS.begin() + 1; i < MFSOwner::availableFS.end(); i++)
+    {
+        if ((*i)->handles(name))
+            return true;
+    }
+    return false;
+}
+
+ContentIndexer::Result ContentIndexer::index(const std::string &url, const std::string &path, uint32_t size, time_t mtime)
+{
+    if (m_catalog.unchanged(path, size, mtime))
+        return UNCHANGED;
+
+    m_catalog.forget(path);
+
+    std::unique_ptr<MFile> root(MFSOwner::File(url));
+    if (root == nullptr || !root->isDirectory())
+    {
+        Debug_printv("not a container [%s]", url.c_str());
+        m_catalog.stamp(path, size, mtime);
+        return FAILED;
+    }
+
+    uint32_t count = 0;
+    if (!walk(root.get(), path, 0, count))
+        return STOPPED;
+
+    m_catalog.stamp(path, size, mtime);
+    return INDEXED;
+}
+
+bool ContentIndexer::walk(MFile *dir, const std::string &path, uint8_t depth, uint32_t &count)
+{
+    dir->rewindDirectory();
+
+    MFile *next;
+    while ((next = dir->getNextFileInDir()) != nullptr)
+    {
+        std::unique_ptr<MFile> entry(next);
+        if (entry->name.empty() || entry->name == "." || entry->name == "..")
+            continue;
+        if (stopRequested && stopRequested())
+            return false;
+        if (count >= m_budget.max_entries)
+        {
+            m_truncated++;
+            break;
+        }
+
+        ContentEntry e;
+        e.container = path;
+        e.name = entry->name;
+        e.type = entry->extension;
+        e.size = entry->size;
+        e.is_dir = entry->isDirectory();
+        if (!m_catalog.add(e))
+            return false;
+        count++;
+        m_entries++;
+
+        // Only nested images and archives are entered. A directory or
+        // partition inside an image shares the image's stream with the
+        // listing in progress here; archives already list their folders'
+        // files by full name.
+        if (!e.is_dir || !isContainer(e.name))
+            continue;
+        if (depth + 1 >= m_budget.max_depth || e.size > m_budget.max_nested_size)
+        {
+            m_truncated++;
+            continue;
+        }
+        if (!walk(entry.get(), path + "/" + e.name, depth + 1, count))
+            return false;
+    }
+
+    if (yield)
+        yield();
+    return true;
+}
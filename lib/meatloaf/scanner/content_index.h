@@ -0,0 +1,129 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// Deep content index: what is inside the disk images and archives on a
+// volume, for updatedb/locate.
+//
+// updatedb walks SD directories with opendir()/readdir(), and to it a disk
+// image or archive is one file. ContentIndexer lists what is in those files
+// through MFSOwner::File()/getNextFileInDir(), the path a LOAD or a directory
+// listing takes, and descends into containers nested in containers (elite.d64
+// inside collection.zip). Where the entries go is up to the ContentCatalog it
+// is given; the console keeps them in the locate database (VFSCommands.cpp).
+//
+// Memory stays bounded however large the volume: one listing is open per
+// nesting level, there are at most ContentBudget::max_depth levels, and each
+// entry is handed to the catalog and dropped before the next one is read.
+
+#ifndef MEATLOAF_SCANNER_CONTENT_INDEX
+#define MEATLOAF_SCANNER_CONTENT_INDEX
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+
+class MFile;
+
+// Containers inside containers, counting the outermost one as level 0
+#define CONTENT_INDEX_MAX_DEPTH 3
+
+// Entries recorded for one container on the volume, nested ones included.
+// A tape or ISO with more than this is indexed up to here.
+#define CONTENT_INDEX_MAX_ENTRIES 4096
+
+// A container inside another one is opened by extracting it whole into the
+// session cache. Bigger than this, it is recorded but not looked into.
+#define CONTENT_INDEX_MAX_NESTED_SIZE (1024 * 1024)
+
+struct ContentEntry
+{
+    std::string container;  // where it is, relative to the volume: "/games/collection.zip/elite.d64"
+    std::string name;
+    std::string type;       // CBM file type (PRG, SEQ, ...) on CBM media, the extension elsewhere
+    uint32_t size = 0;      // bytes
+    bool is_dir = false;    // a nested container, directory or partition
+};
+
+// Where indexed entries are kept
+class ContentCatalog
+{
+public:
+    virtual ~ContentCatalog() {}
+
+    // Was the container at 'path' indexed when it had this size and mtime?
+    virtual bool unchanged(const std::string &path, uint32_t size, time_t mtime) = 0;
+
+    // Drop everything an earlier index of 'path' recorded
+    virtual void forget(const std::string &path) = 0;
+
+    // Record one entry; false stops the indexer
+    virtual bool add(const ContentEntry &entry) = 0;
+
+    // 'path' is completely indexed at this size and mtime
+    virtual void stamp(const std::string &path, uint32_t size, time_t mtime) = 0;
+};
+
+struct ContentBudget
+{
+    uint8_t  max_depth = CONTENT_INDEX_MAX_DEPTH;
+    uint32_t max_entries = CONTENT_INDEX_MAX_ENTRIES;
+    uint32_t max_nested_size = CONTENT_INDEX_MAX_NESTED_SIZE;
+};
+
+class ContentIndexer
+{
+public:
+    enum Result
+    {
+        INDEXED,    // listed and stamped
+        UNCHANGED,  // the catalog already has it at this size and mtime
+        FAILED,     // could not be opened or listed (stamped all the same, see index())
+        STOPPED,    // stopRequested() or the catalog ended it; not stamped
+    };
+
+    ContentIndexer(ContentCatalog &catalog, ContentBudget budget = ContentBudget())
+        : m_catalog(catalog), m_budget(budget) {}
+
+    // Is 'name' a disk image or archive, by the extension a media filesystem
+    // in MFSOwner::availableFS claims it with?
+    static bool isContainer(const std::string &name);
+
+    // Index the container at 'url' under 'path' unless the catalog has it
+    // at this size and mtime. An image that does not open is stamped too:
+    // it would fail the same way next time, until it changes.
+    Result index(const std::string &url, const std::string &path, uint32_t size, time_t mtime);
+
+    // Polled before each entry
+    std::function<bool()> stopRequested;
+
+    // Called after each listing, so a long pass lets other tasks run
+    std::function<void()> yield;
+
+    uint32_t entries() const { return m_entries; }
+    uint32_t truncated() const { return m_truncated; }
+
+private:
+    bool walk(MFile *dir, const std::string &path, uint8_t depth, uint32_t &count);
+
+    ContentCatalog &m_catalog;
+    ContentBudget m_budget;
+    uint32_t m_entries = 0;     // recorded since construction
+    uint32_t m_truncated = 0;   // listings cut short or not entered because of the budget
+};
+
+#endif // MEATLOAF_SCANNER_CONTENT_INDEX
@@ -26,8 +26,7 @@
  ********************************************************/
 
 CSIPMSession::CSIPMSession(std::string host, uint16_t port)
-    : MSession("csip://" + host + ":" + std::to_string(port), host, port),
-      std::iostream(&buf), buf(host, port), currentDir("csip:/")
+    : MSession("csip://" + host + ":" + std::to_string(port), host, port)
 {
     Debug_printv("CSIPMSession created for %s:%d", host.c_str(), port);
 }
@@ -43,13 +42,10 @@ bool CSIPMSession::connect() {
         return true;
     }
 
-    if (!buf.is_open()) {
-        currentDir = "csip:/";
-        if (!buf.open()) {
-            Debug_printv("Failed to open connection to %s:%d", host.c_str(), port);
-            connected = false;
-            return false;
-        }
+    if (!establish()) {
+        Debug_printv("Failed to open connection to %s:%d", host.c_str(), port);
+        connected = false;
+        return false;
     }
 
     Debug_printv("Successfully connected to %s:%d", host.c_str(), port);
@@ -72,30 +68,25 @@ bool CSIPMSession::connect() {
 
 void CSIPMSession::disconnect() {
     // Only attempt the polite quit while the session is believed healthy,
-    // but ALWAYS close the stream - 'connected' may already be false (e.g.
+    // but ALWAYS close the socket - 'connected' may already be false (e.g.
     // after a failed keep-alive) while the TCP socket is still open
     if (connected) {
         Debug_printv("Disconnecting from %s:%d", host.c_str(), port);
         sendCommand("quit");
     }
-    if (buf.is_open()) {
-        buf.close();
-    }
+    client.close();
     connected = false;
 }
 
 bool CSIPMSession::keep_alive() {
-    if (!connected || !buf.is_open()) {
+    if (!connected || !client.isOpen()) {
         return false;
     }
 
-    // Send a lightweight command and consume its response to keep the stream in sync
-    if (sendCommand("cf /")) {
-        bool ok = isOK();
-        if (ok) {
-            updateActivity();
-            return true;
-        }
+    // A lightweight command, its response consumed to keep the stream in sync
+    if (client.ping()) {
+        updateActivity();
+        return true;
     }
 
     Debug_printv("Keep-alive failed for %s:%d", host.c_str(), port);
@@ -104,155 +95,67 @@ bool CSIPMSession::keep_alive() {
 }
 
 bool CSIPMSession::establish() {
-    if(!buf.is_open()) {
-        currentDir = "csip:/";
-        buf.open();
+    if (!client.isOpen()) {
+        bool ok = client.open(host, port);
+        printf("CSIP: connect to %s:%d %s\r\n", host.c_str(), port, ok ? "ok" : "failed");
     }
 
-    return buf.is_open();
+    return client.isOpen();
 }
 
 std::string CSIPMSession::readLn() {
-    char buffer[80];
     std::string line;
-    // telnet line ends with 10;
-    for (int attempt = 0; attempt < 3; ++attempt) {
-        getline(buffer, 80, 10);
-        line = buffer;
-        if (!line.empty()) {
-            break;
-        }
-        fnSystem.delay(50);
-    }
-
-    if (!line.empty() && line.back() == '\r') {
-        line.pop_back();
-    }
-
-    if (!line.empty()) {
+    if (client.readLine(line)) {
         updateActivity();
-    } else {
-        line = '\x04';
+        return line;
     }
-
-    //Debug_printv("Inside readln got: '%s'", buffer);
-    return line;
+    return "\x04";
 }
 
 bool CSIPMSession::sendCommand(const std::string& command) {
-    std::string c = mstr::toPETSCII2(command);
     // 13 (CR) sends the command
-    if(establish()) {
-        Debug_printv("command[%s]", c.c_str());
-        (*this) << (c+'\r');
-        (*this).flush();
-        (*this).sync();
+    if (establish() && client.command(command)) {
         updateActivity();
-        sleep(1);
         return true;
     }
-    else
-        return false;
+    return false;
 }
 
 bool CSIPMSession::isOK() {
-    auto trimReply = [](const std::string& line) {
-        size_t start = 0;
-        while (start < line.size()) {
-            char c = line[start];
-            if (c != ' ' && c != '\t' && c != '\r' && c != '>') {
-                break;
-            }
-            ++start;
-        }
-        size_t end = line.size();
-        while (end > start) {
-            char c = line[end - 1];
-            if (c != ' ' && c != '\t' && c != '\r') {
-                break;
-            }
-            --end;
-        }
-        return line.substr(start, end - start);
-    };
-
-    std::string reply;
-    for (int attempt = 0; attempt < 10; ++attempt) {
-        reply = readLn();
-        if (reply.size() == 1 && reply[0] == '\x04') {
-            continue;
-        }
-
-        auto trimmed = trimReply(reply);
-        if (trimmed.empty()) {
-            continue;
-        }
-
-        if (trimmed.find("00 - OK") != std::string::npos) {
-            Debug_printv("ok[%s]", reply.c_str());
-            return true;
-        }
-
-        if (trimmed.find("00 - WELCOME") != std::string::npos) {
-            Debug_printv("ok[%s]", reply.c_str());
-            reply = readLn();
-            Debug_printv("ok[%s]", reply.c_str());
-            reply = readLn();
-            Debug_printv("ok[%s]", reply.c_str());
-            return true;
-        }
-    }
-
-    Debug_printv("ok[%s]", reply.c_str());
-
-    // If reply is empty, read the rest of the lines to clear the buffer
-    if (reply.empty()) {
-        for (int i = 0; i < 5; ++i) {
-            reply = readLn();
-            if (reply.empty() || (reply.size() == 1 && reply[0] == '\x04')) {
-                break;
-            }
-            Debug_printv("ok[%s]", reply.c_str());
-        }
-    }
-
-    return false;
+    return client.isOK();
 }
 
 bool CSIPMSession::traversePath(std::string path) {
-
     Debug_printv("Traversing path: path[%s]", path.c_str());
+    if (!establish())
+        return false;
 
-    if(mstr::endsWith(path, ".d64", false))
-    {
-        // Already mounted? Skip INSERT
-        if (mstr::equals(currentDir, path, false)) {
-            Debug_printv("D64 already inserted: [%s]", path.c_str());
-            return true;
-        }
+    // CF only what's below the current folder; INSERT a .d64 unless it's in
+    // already. Fails with ?500 - CANNOT CHANGE TO ... / ?500 - DISK NOT FOUND.
+    bool ok = client.changeTo(path);
+    if (ok)
+        updateActivity();
+    return ok;
+}
 
-        // THEN we have to mount the image INSERT image_name
-        sendCommand("insert " + path);
+bool CSIPMSession::list(const std::string& path, CSIPListing& listing) {
+    if (!establish())
+        return false;
 
-        // disk image is the end, so return
-        if(isOK()) {
-            currentDir = path;
-            return true;
-        }
-        else {
-            // or: ?500 - DISK NOT FOUND.
-            return false;
-        }
-    }
+    acquireIO();
+    bool ok = client.list(path, listing);
+    releaseIO();
+    return ok;
+}
 
-    // CF xxx - to browse into subsequent dirs
-    sendCommand("cf " + path);
-    if(!isOK()) {
-        // or: ?500 - CANNOT CHANGE TO dupa
+bool CSIPMSession::load(const std::string& path, uint32_t& size) {
+    if (!establish())
         return false;
-    }
 
-    return true;
+    bool ok = client.load(path, size);
+    if (ok)
+        updateActivity();
+    return ok;
 }
 
 /********************************************************
@@ -275,7 +178,12 @@ CSIPMFile::CSIPMFile(std::string path, size_t filesize): MFile(path) {
         _session->user = host;
         _session->password = port;
         if (_session->connect()) {
-            SessionBroker::add(sessionKey, _session);
+            // Another drive may have connected first: use theirs
+            auto kept = SessionBroker::add(sessionKey, _session);
+            if (kept != _session) {
+                _session->disconnect();
+                _session = std::static_pointer_cast<CSIPMSession>(kept);
+            }
         } else {
             _session.reset();
         }
@@ -301,6 +209,14 @@ CSIPMFile::CSIPMFile(std::string path, size_t filesize): MFile(path) {
         if (!ok) {
             Debug_printv("LOGIN/LOGOUT failed!");
         }
+        _session->forget();
+    }
+
+    // Opened by name rather than from a listing: the size from the folder's
+    // listing, if it's been read
+    uint32_t listed;
+    if (this->size == 0 && _session->cachedSize(this->path, listed)) {
+        this->size = listed;
     }
 
     isCBM = true;
@@ -309,10 +225,6 @@ CSIPMFile::CSIPMFile(std::string path, size_t filesize): MFile(path) {
 
 CSIPMFile::~CSIPMFile() {
     // Session is managed by SessionBroker, don't disconnect here
-    if (dirHoldsIo && _session) {
-        _session->releaseIO();
-        dirHoldsIo = false;
-    }
     _session.reset();
 }
 
@@ -342,7 +254,11 @@ bool CSIPMStream::open(std::ios_base::openmode mode) {
     if (!_session) {
         _session = std::make_shared<CSIPMSession>("commodoreserver.com", 1541);
         if (_session->connect()) {
-            SessionBroker::add(sessionKey, _session);
+            auto kept = SessionBroker::add(sessionKey, _session);
+            if (kept != _session) {
+                _session->disconnect();
+                _session = std::static_pointer_cast<CSIPMSession>(kept);
+            }
         } else {
             _session.reset();
         }
@@ -371,41 +287,18 @@ bool CSIPMStream::open(std::ios_base::openmode mode) {
     // trim spaces from right of name too (rtrimA0() is $A0-only)
     mstr::rtrimPad(full_path);
 
-    // Check if path goes through a D64 container image - must INSERT it first
-    std::string load_target = full_path;
-    std::string lower_path = full_path;
-    for (auto& c : lower_path) c = tolower(c);
-    size_t d64_sep = lower_path.find(".d64/");
-    if (d64_sep != std::string::npos) {
-        std::string container_path = full_path.substr(0, d64_sep + 4);
-        load_target = full_path.substr(d64_sep + 5);
-        if (!_session->traversePath(container_path)) {
-            Debug_printv("CSIP: failed to mount image [%s]", container_path.c_str());
-            if (_holds_io) {
-                _session->releaseIO();
-                _holds_io = false;
-            }
-            return false;
-        }
-    }
-
-    _session->sendCommand("load " + load_target);
-    // read first 2 bytes with size, low first, but may also reply with: ?500 - ERROR
-    uint8_t buffer[2] = { 0, 0 };
-    read(buffer, 2);
-    // hmmm... should we check if they're "?5" for error?!
-    if(buffer[0]=='?' && buffer[1]=='5') {
-        Debug_printv("CSIP: open file failed");
-        _session->readLn();
-        _is_open = false;
-    }
-    else {
-        _size = buffer[0] + buffer[1]*256; // put len here
+    // Through a D64 container image, the session INSERTs it first (unless
+    // it's in already); the size comes back ahead of the file's bytes
+    uint32_t size = 0;
+    if (_session->load(full_path, size)) {
+        _size = size;
         _position = 0;
-        // if everything was ok
         printf("CSIP: file open, size: %lu\r\n", _size);
         _is_open = true;
     }
+    else {
+        Debug_printv("CSIP: open file failed");
+    }
 
     if (!_is_open && _holds_io) {
         _session->releaseIO();
@@ -498,10 +391,7 @@ std::shared_ptr<MStream> CSIPMFile::createStream(std::ios_base::openmode mode)
 
 bool CSIPMFile::rewindDirectory() {
     dirIsOpen = false;
-    if (dirHoldsIo && _session) {
-        _session->releaseIO();
-        dirHoldsIo = false;
-    }
+    entry_index = 0;
 
     // Strip trailing slash for proper D64 detection (but preserve root "/")
     while (path.size() > 1 && path.back() == '/') {
@@ -516,198 +406,44 @@ bool CSIPMFile::rewindDirectory() {
         return false;
     }
 
-    //Debug_printv("pre traverse path");
-
-    if(!_session->traversePath(path)) return false;
-
-    //Debug_printv("post traverse path");
-
-    if(mstr::endsWith(path, ".d64", false))
-    {
-        dirIsImage = true;
-        // to list image contents we have to run
-        Debug_printv("cserver: this is a d64 img, sending $ command!");
-        _session->sendCommand("$");
-        auto line = _session->readLn(); // mounted image name
-        if(_session->isConnected() && line.size()) {
-            dirIsOpen = true;
-            if (!dirHoldsIo) {
-                _session->acquireIO();
-                dirHoldsIo = true;
-            }
-            if (line.size() > 5) {
-                media_image = line.substr(5);
-            } else {
-                media_image.clear();
-            }
-            line = _session->readLn(); // dir header
-            auto last_quote = line.find_last_of("\"");
-            if (last_quote != std::string::npos && last_quote >= 2) {
-                // The server speaks PETSCII; Meatloaf carries UTF-8.
-                media_header = mstr::toUTF8(line.substr(2, last_quote - 1));
-                if (last_quote + 2 <= line.size()) {
-                    media_id = mstr::toUTF8(line.substr(last_quote + 2));
-                } else {
-                    media_id.clear();
-                }
-            } else {
-                media_header.clear();
-                media_id.clear();
-            }
-            return true;
-        }
-        else
-            return false;
-    }
-    else
-    {
-        dirIsImage = false;
-        // to list directory contents we use
-        Debug_printv("cserver: this is a directory!");
-        _session->sendCommand("disks");
-        auto line = _session->readLn(); // dir header
-        //Debug_printv("line[%s]", line.c_str());
-        if(_session->isConnected() && line.size()) {
-            auto last_bracket = line.find_last_of("]");
-            if (last_bracket != std::string::npos && last_bracket >= 2) {
-                media_header = mstr::toUTF8(line.substr(2, last_bracket - 1));
-            } else {
-                media_header.clear();
-            }
-            media_id = "c=svr";
-            dirIsOpen = true;
-            if (!dirHoldsIo) {
-                _session->acquireIO();
-                dirHoldsIo = true;
-            }
+    // A .d64 is INSERTed and listed with $, a folder changed into and listed
+    // with DISKS - or both come from the session's listing cache
+    if (!_session->list(path, listing))
+        return false;
 
-            return true;
-        }
-        else
-            return false;
+    if (listing.is_image) {
+        media_image = listing.image;
+        media_blocks_free = listing.blocks_free;
     }
+    media_header = listing.header;
+    media_id = listing.id;
+    dirIsOpen = true;
+    return true;
 }
 
 MFile* CSIPMFile::getNextFileInDir() {
 
-    //Debug_printv("pre rewind");
-
     if(!dirIsOpen)
         rewindDirectory();
 
-    //Debug_printv("pre dir is open");
-
     if(!dirIsOpen)
         return nullptr;
 
-    if (!_session || !_session->isConnected()) {
+    if (entry_index >= listing.entries.size()) {
+        Debug_printv("No more!");
+        dirIsOpen = false;
         return nullptr;
     }
 
-    std::string name;
-    size_t size;
-    std::string new_url = url;
+    const CSIPEntry& entry = listing.entries[entry_index++];
 
+    std::string new_url = url;
     if(url.size()>8) // If we are not at root then add additional "/"
         new_url += "/";
+    new_url += entry.name;
 
-    //Debug_printv("pre dir is image");
-
-    auto line = _session->readLn();
-    //Debug_printv("line[%s]", line.c_str());
-
-    if(dirIsImage) {
-        //Debug_printv("next file in dir got %s", line.c_str());
-        // 'ot line:'0 ␒"CIE�������������" 00�2A�
-        // 'ot line:'2   "CIE+SERIAL      " PRG   2049
-        // 'ot line:'1   "CIE-SYS31801    " PRG   2049
-        // 'ot line:'1   "CIE-SYS31801S   " PRG   2049
-        // 'ot line:'1   "CIE-SYS52281    " PRG   2049
-        // 'ot line:'1   "CIE-SYS52281S   " PRG   2049
-        // 'ot line:'658 BLOCKS FREE.
-
-        if(line.find('\x04')!=std::string::npos) {
-            Debug_printv("No more!");
-            dirIsOpen = false;
-            if (dirHoldsIo && _session) {
-                _session->releaseIO();
-                dirHoldsIo = false;
-            }
-            return nullptr;
-        }
-        if(line.find("BLOCKS FREE.")!=std::string::npos) {
-            media_blocks_free = atoi(line.substr(0, line.find_first_of(" ")).c_str());
-            dirIsOpen = false;
-            if (dirHoldsIo && _session) {
-                _session->releaseIO();
-                dirHoldsIo = false;
-            }
-            return nullptr;
-        }
-        else {
-            name = line.substr(5,16);
-            size = atoi(line.substr(0, line.find_first_of(" ")).c_str());
-            size = size * 256; // convert blocks to bytes
-            mstr::rtrim(name);
-            // The server speaks PETSCII, Meatloaf carries UTF-8; converted
-            // before the entry URL is built from it.
-            name = mstr::toUTF8(name);
-            mstr::replaceAll(name, "/", "\\");
-            //Debug_printv("xx: %s -- %s %d", line.c_str(), name.c_str(), size);
-            //return new CSIPMFile(path() +"/"+ name);
-            new_url += name;
-            return new CSIPMFile(new_url, size);
-        }
-    } else {
-        // Got line:''
-        // Got line:''
-        // 'ot line:'FAST-TESTER DELUXE EXCESS.D64
-        // 'ot line:'EMPTY.D64
-        // 'ot line:'CMD UTILITIES D1.D64
-        // 'ot line:'CBMCMD22.D64
-        // 'ot line:'NAV96.D64
-        // 'ot line:'NAV92.D64
-        // 'ot line:'SINGLE DISKCOPY 64 (1983)(KEVIN PICKELL).D64
-        // 'ot line:'LYNX (19XX)(-).D64
-        // 'ot line:'GEOS DISK EDITOR (1990)(GREG BADROS).D64
-        // 'ot line:'FLOPPY REPAIR KIT (1984)(ORCHID SOFTWARE LABORATOR
-        // 'ot line:'1541 DEMO DISK (19XX)(-).D64
-
-        // 32 62 91 68 73 83 75 32 84 79 79 76 83 93 13 No more! = > [DISK TOOLS]
-
-        //Debug_printv("line[%s]", line.c_str());
-        if(line.find('\x04')!=std::string::npos) {
-            Debug_printv("No more!");
-            dirIsOpen = false;
-            if (dirHoldsIo && _session) {
-                _session->releaseIO();
-                dirHoldsIo = false;
-            }
-            return nullptr;
-        }
-        else {
-
-            if((*line.begin())=='[') {
-                name = line.substr(1,line.length()-2);
-                size = 0;
-            }
-            else {
-                name = line;
-                size = (683 * 256);
-            }
-            mstr::rtrim(name);
-            name = mstr::toUTF8(name);  // PETSCII from the server, UTF-8 here
-            //Debug_printv("url[%s] name[%s] size[%d]", url.c_str(), name.c_str(), size);
-            if(name.size() > 0)
-            {
-                new_url += name;
-                //Debug_printv("new_url[%s]", new_url.c_str());
-                return new CSIPMFile(new_url, size);
-            }
-            else
-                return nullptr;
-        }
-    }
+    //Debug_printv("url[%s] name[%s] size[%d]", url.c_str(), entry.name.c_str(), entry.size);
+    return new CSIPMFile(new_url, entry.size);
 };
 
 bool CSIPMFile::exists() {
@@ -24,164 +24,18 @@
 
 #include "meatloaf.h"
 #include "meat_session.h"
-#include "network/tcp.h"
-
-#include "fnSystem.h"
+#include "service/csip_client.h"
 
 #include "utils.h"
 #include "string_utils.h"
 
 #include "make_unique.h"
 
-#include <streambuf>
-#include <istream>
-
-/********************************************************
- * Telnet buffer
- ********************************************************/
-
-class csstreambuf : public std::streambuf {
-    char* gbuf = nullptr;
-    char* pbuf = nullptr;
-    std::string server_host;
-    uint16_t server_port;
-
-protected:
-    MeatSocket m_wifi;
-
-public:
-    csstreambuf(std::string host = "commodoreserver.com", uint16_t port = 1541)
-        : server_host(host), server_port(port) {}
-
-    ~csstreambuf() {
-        close();
-    }
-
-    bool is_open() {
-        return (m_wifi.isOpen());
-    }
-
-    bool open() {
-        //Debug_printv("csstreambuf: open");
-        if(m_wifi.isOpen())
-            return true;
-
-        int rc = m_wifi.open(server_host.c_str(), server_port);
-        printf("csstreambuf: connect to %s:%d returned: %d\r\n",
-               server_host.c_str(), server_port, rc);
-
-        if(rc == 1) {
-            if(gbuf == nullptr)
-                gbuf = new char[512];
-            if(pbuf == nullptr)
-                pbuf = new char[512];
-        }
-
-        setp(pbuf, pbuf+512);
-
-        return rc == 1;
-    }
-
-    void close() {
-        printf("csstreambuf: closing\r\n");
-        if(m_wifi.isOpen()) {
-            m_wifi.close();
-        }
-        if(gbuf != nullptr) {
-            delete[] gbuf;
-            gbuf = nullptr;
-        }
-        if(pbuf != nullptr) {
-            delete[] pbuf;
-            pbuf = nullptr;
-        }
-    }
-
-    int underflow() override {
-        //Debug_printv("In underflow");
-        if (!m_wifi.isOpen()) {
-            Debug_printv("In connection closed");
-            close();
-            return std::char_traits<char>::eof();
-        }
-        else if (this->gptr() == this->egptr()) {
-            int readCount = 0;
-            int attempts = 5;
-            int wait = 500;
-            
-            readCount = m_wifi.read((uint8_t*)gbuf, 512);
-
-            while( readCount <= 0 && (attempts--)>0 && m_wifi.isOpen()) {
-                Debug_printv("got rc: %d, retrying", readCount);
-                fnSystem.delay(wait);
-                wait+=100;
-                readCount = m_wifi.read((uint8_t*)gbuf, 512);
-            } 
-            //Debug_printv("read success: %d", readCount);
-            this->setg(gbuf, gbuf, gbuf + readCount);
-        }
-        else {
-            //Debug_printv("else: %d - %d, (%d)", this->gptr(), this->egptr(), this->gbuf);
-        }
-
-        return this->gptr() == this->egptr()
-            ? std::char_traits<char>::eof()
-            : std::char_traits<char>::to_int_type(*this->gptr());
-    };
-
-
-    int overflow(int ch  = traits_type::eof()) override
-    {
-        //Debug_printv("in overflow");
-
-        if (!m_wifi.isOpen()) {
-            close();
-            return EOF;
-        }
-
-        char* end = pptr();
-        if ( ch != EOF ) {
-            *end ++ = ch;
-        }
-
-        uint8_t* pBase = (uint8_t*)pbase();
-
-        if ( m_wifi.write( pBase, end - pbase() ) == 0 ) {
-            ch = EOF;
-        } else if ( ch == EOF ) {
-            ch = 0;
-        }
-        setp(pbuf, pbuf+512);
-        
-        return ch;
-    };
-
-    int sync() { 
-
-        if (!m_wifi.isOpen()) {
-            close();
-            return 0;
-        }
-        if(pptr() == pbase()) {
-            return 0;
-        }
-        else {
-            //Debug_printv("in sync, written %d", pptr()-pbase());
-            uint8_t* buffer = (uint8_t*)pbase();
-            auto result = m_wifi.write(buffer, pptr()-pbase()); 
-            setp(pbuf, pbuf+512);
-            return (result != 0) ? 0 : -1;  
-        }  
-    };
-
-    friend class CSIPMSession;
-};
-
 /********************************************************
  * Session manager
  ********************************************************/
 
-class CSIPMSession : public MSession, public std::iostream {
+class CSIPMSession : public MSession {
 public:
     CSIPMSession(std::string host = "commodoreserver.com", uint16_t port = 1541);
     ~CSIPMSession() override;
@@ -200,34 +54,35 @@ public:
     bool isOK();
     std::string readLn();
 
+    // Folder and image listings, cached per path (see csip_client.h)
+    bool list(const std::string& path, CSIPListing& listing);
+    bool cachedSize(const std::string& path, uint32_t& size) { return client.cachedSize(path, size); }
+    bool load(const std::string& path, uint32_t& size);
+
+    // The user changed: what the server showed before no longer holds
+    void forget() { client.forget(); }
+
     // Stream access methods for CSIPMStream
     size_t receive(uint8_t* buffer, size_t size) {
-        if (buf.is_open()) {
-            size_t readCount = buf.m_wifi.read(buffer, size);
-            if (readCount > 0) {
-                updateActivity();
-            }
-            return readCount;
+        size_t readCount = client.read(buffer, size);
+        if (readCount > 0) {
+            updateActivity();
         }
-        return 0;
+        return readCount;
     }
 
     size_t send(const uint8_t* buffer, size_t size) {
-        if (buf.is_open()) {
-            size_t written = buf.m_wifi.write(buffer, size);
-            if (written > 0) {
-                updateActivity();
-            }
-            return written;
+        size_t written = client.write(buffer, size);
+        if (written > 0) {
+            updateActivity();
         }
-        return 0;
+        return written;
     }
 
-    std::string getCurrentDir() const { return currentDir; }
+    std::string getCurrentDir() const { return "csip:" + client.folder(); }
 
 protected:
-    csstreambuf buf;  // Must be declared first for initialization order
-    std::string currentDir;
+    CSIPClient client;
 
     bool establish();
 
@@ -261,8 +116,8 @@ public:
 protected:
     std::shared_ptr<CSIPMSession> _session;
     bool dirIsOpen = false;
-    bool dirIsImage = false;
-    bool dirHoldsIo = false;
+    CSIPListing listing;
+    size_t entry_index = 0;
 
     friend class CSIPMStream;
 };
@@ -0,0 +1,483 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "service/csip_client.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/select.h>
+#endif
+
+#include "compat_inet.h"
+#include "string_utils.h"
+
+#include "../../include/debug.h"
+
+bool CSIPClient::open(const std::string& host, uint16_t port)
+{
+    close();
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* res = nullptr;
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &res) != 0 || res == nullptr) {
+        Debug_printv("CSIP: can't resolve %s", host.c_str());
+        return false;
+    }
+
+    int sock = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+    if (sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0) {
+        Debug_printv("CSIP: connect to %s:%d failed: errno %d", host.c_str(), port, errno);
+        closesocket(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if (sock < 0)
+        return false;
+
+    _sock = sock;
+    _rhead = _rtail = 0;
+    _skip_lf = false;
+    _load_left = 0;
+
+    // A new connection starts at the root with nothing inserted
+    forget();
+    _cwd_known = true;
+    return true;
+}
+
+void CSIPClient::close()
+{
+    if (_sock >= 0) {
+        closesocket(_sock);
+        _sock = -1;
+    }
+    _rhead = _rtail = 0;
+    _load_left = 0;
+}
+
+// Wait for the socket to be readable, then take what's there
+bool CSIPClient::fill(uint32_t timeout_ms)
+{
+    if (_sock < 0)
+        return false;
+    if (_rhead == _rtail)
+        _rhead = _rtail = 0;
+    if (_rtail == sizeof(_rbuf))
+        return true;
+
+    fd_set rfds;
+    FD_ZERO(&rfds);
+    FD_SET(_sock, &rfds);
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    int ready = select(_sock + 1, &rfds, nullptr, nullptr, &tv);
+    if (ready <= 0)
+        return false;
+
+    int n = recv(_sock, _rbuf + _rtail, sizeof(_rbuf) - _rtail, 0);
+    if (n <= 0) {
+        Debug_printv("CSIP: connection closed");
+        close();
+        return false;
+    }
+    _rtail += n;
+    return true;
+}
+
+bool CSIPClient::readLine(std::string& line, uint32_t timeout_ms)
+{
+    line.clear();
+    while (true) {
+        while (_rhead < _rtail) {
+            char c = (char)_rbuf[_rhead++];
+            if (_skip_lf) {
+                _skip_lf = false;
+                if (c == '\n')
+                    continue;
+            }
+            // The server ends lines with CR LF, and its prompt with a bare CR
+            if (c == '\r' || c == '\n') {
+                _skip_lf = (c == '\r');
+                return true;
+            }
+            line += c;
+        }
+        if (!fill(timeout_ms))
+            return !line.empty();
+    }
+}
+
+size_t CSIPClient::read(uint8_t* buf, size_t size, uint32_t timeout_ms)
+{
+    if (_rhead == _rtail && !fill(timeout_ms))
+        return 0;
+
+    size_t n = std::min(size, _rtail - _rhead);
+    memcpy(buf, _rbuf + _rhead, n);
+    _rhead += n;
+    _load_left -= std::min<uint32_t>(_load_left, (uint32_t)n);
+    return n;
+}
+
+size_t CSIPClient::write(const uint8_t* buf, size_t size)
+{
+    size_t done = 0;
+    while (_sock >= 0 && done < size) {
+        int n = send(_sock, buf + done, size - done, 0);
+        if (n <= 0) {
+            close();
+            break;
+        }
+        done += n;
+    }
+    return done;
+}
+
+// The rest of a LOAD nobody read would be taken for the next reply
+void CSIPClient::skipLoad()
+{
+    while (_load_left > 0) {
+        if (_rhead == _rtail && !fill(CSIP_REPLY_TIMEOUT_MS)) {
+            _load_left = 0;
+            break;
+        }
+        size_t n = std::min<size_t>(_load_left, _rtail - _rhead);
+        _rhead += n;
+        _load_left -= n;
+    }
+}
+
+bool CSIPClient::command(const std::string& command)
+{
+    if (_sock < 0)
+        return false;
+
+    skipLoad();
+    _rhead = _rtail = 0;
+    while (fill(0))
+        _rhead = _rtail = 0;
+    _skip_lf = false;
+    if (_sock < 0)
+        return false;
+
+    Debug_printv("command[%s]", command.c_str());
+    std::string c = mstr::toPETSCII2(command) + '\r';
+    _commands++;
+    return write((const uint8_t*)c.data(), c.size()) == c.size();
+}
+
+bool CSIPClient::isOK()
+{
+    auto trimReply = [](const std::string& line) {
+        size_t start = line.find_first_not_of(" \t\r>");
+        if (start == std::string::npos)
+            return std::string();
+        size_t end = line.find_last_not_of(" \t\r");
+        return line.substr(start, end - start + 1);
+    };
+
+    std::string reply;
+    while (readLine(reply)) {
+        std::string trimmed = trimReply(reply);
+        if (trimmed.empty())
+            continue;
+
+        if (trimmed.find("00 - OK") != std::string::npos) {
+            Debug_printv("ok[%s]", reply.c_str());
+            return true;
+        }
+        if (trimmed.find("00 - WELCOME") != std::string::npos) {
+            // and two lines of greeting
+            Debug_printv("ok[%s]", reply.c_str());
+            readLine(reply, CSIP_LISTING_IDLE_MS);
+            readLine(reply, CSIP_LISTING_IDLE_MS);
+            return true;
+        }
+        if (trimmed[0] == '?') {
+            // ?500 - CANNOT CHANGE TO ..., ?500 - DISK NOT FOUND.
+            Debug_printv("error[%s]", reply.c_str());
+            return false;
+        }
+    }
+    Debug_printv("no reply");
+    return false;
+}
+
+std::vector<std::string> CSIPClient::split(const std::string& path)
+{
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (pos <= path.size()) {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos)
+            end = path.size();
+        if (end > pos)
+            parts.push_back(path.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return parts;
+}
+
+std::string CSIPClient::join(const std::vector<std::string>& parts, size_t from)
+{
+    std::string path;
+    for (size_t i = from; i < parts.size(); i++) {
+        if (i > from)
+            path += '/';
+        path += parts[i];
+    }
+    return path;
+}
+
+bool CSIPClient::isImage(const std::string& path)
+{
+    return mstr::endsWith(path, ".d64", false);
+}
+
+std::string CSIPClient::folder() const
+{
+    return "/" + join(_cwd);
+}
+
+bool CSIPClient::changeTo(const std::string& path)
+{
+    std::vector<std::string> parts = split(path);
+    std::string absolute = "/" + join(parts);
+
+    if (isImage(absolute)) {
+        if (mstr::equals(_image, absolute, false)) {
+            Debug_printv("D64 already inserted: [%s]", absolute.c_str());
+            return true;
+        }
+        if (!command("insert " + absolute))
+            return false;
+        bool ok = isOK();
+        _image = ok ? absolute : "";
+        return ok;
+    }
+
+    // Already there costs nothing; anywhere else is one CF with the whole
+    // path, so a folder tracked wrongly can't send the server astray
+    if (_cwd_known && parts == _cwd)
+        return true;
+
+    if (!command("cf " + absolute))
+        return false;
+    if (!isOK()) {
+        // Somewhere, or nowhere, along the way
+        _cwd_known = false;
+        return false;
+    }
+    _cwd = parts;
+    _cwd_known = true;
+    return true;
+}
+
+bool CSIPClient::ping()
+{
+    bool ok = command("cf /") && isOK();
+    _cwd.clear();
+    _cwd_known = ok;
+    return ok;
+}
+
+void CSIPClient::forget()
+{
+    _cwd.clear();
+    _cwd_known = false;
+    _image.clear();
+    _listings.clear();
+}
+
+bool CSIPClient::list(const std::string& path, CSIPListing& listing)
+{
+    std::string key = "/" + join(split(path));
+    time_t now = time(nullptr);
+
+    auto it = _listings.find(key);
+    if (it != _listings.end()) {
+        if (it->second.expires > now) {
+            _hits++;
+            listing = it->second;
+            return true;
+        }
+        _listings.erase(it);
+    }
+
+    bool is_image = isImage(key);
+    if (!changeTo(key))
+        return false;
+    if (!command(is_image ? "$" : "disks"))
+        return false;
+
+    listing = CSIPListing();
+    if (!readListing(is_image, listing))
+        return false;
+
+    listing.expires = now + CSIP_LISTING_TTL;
+    _listings[key] = listing;
+    while (_listings.size() > CSIP_LISTING_ENTRIES) {
+        auto oldest = _listings.begin();
+        for (auto i = _listings.begin(); i != _listings.end(); ++i) {
+            if (i->second.expires < oldest->second.expires)
+                oldest = i;
+        }
+        _listings.erase(oldest);
+    }
+    return true;
+}
+
+bool CSIPClient::readListing(bool is_image, CSIPListing& listing)
+{
+    listing.is_image = is_image;
+    std::string line;
+
+    // The first line comes when the server has it; after that, the prompt
+    // or a pause ends the listing
+    do {
+        if (!readLine(line))
+            return false;
+    } while (line.empty());
+
+    if (is_image) {
+        // 0 ␒"CIE            " 00 2A
+        // 2   "CIE+SERIAL      " PRG   2049
+        // 658 BLOCKS FREE.
+        listing.image = (line.size() > 5) ? line.substr(5) : "";
+        if (!readLine(line, CSIP_LISTING_IDLE_MS))
+            return true;
+        size_t last_quote = line.find_last_of('"');
+        if (last_quote != std::string::npos && last_quote >= 2) {
+            // The server speaks PETSCII; Meatloaf carries UTF-8.
+            listing.header = mstr::toUTF8(line.substr(2, last_quote - 1));
+            if (last_quote + 2 <= line.size())
+                listing.id = mstr::toUTF8(line.substr(last_quote + 2));
+        }
+    } else {
+        //  >[DISK TOOLS]
+        size_t last_bracket = line.find_last_of(']');
+        if (last_bracket != std::string::npos && last_bracket >= 2)
+            listing.header = mstr::toUTF8(line.substr(2, last_bracket - 1));
+        listing.id = "c=svr";
+    }
+
+    while (readLine(line, CSIP_LISTING_IDLE_MS)) {
+        size_t start = line.find_first_not_of(' ');
+        if (start == std::string::npos)
+            continue;
+        if (line[start] == '>')
+            break;
+
+        CSIPEntry entry;
+        if (is_image) {
+            if (line.find("BLOCKS FREE.") != std::string::npos) {
+                listing.blocks_free = (uint16_t)atoi(line.c_str());
+                break;
+            }
+            if (line.size() <= 5)
+                continue;
+            entry.name = line.substr(5, 16);
+            entry.size = (uint32_t)atoi(line.c_str()) * 256;
+            mstr::rtrim(entry.name);
+            entry.name = mstr::toUTF8(entry.name);
+            mstr::replaceAll(entry.name, "/", "\\");
+        } else if (line[0] == '[') {
+            // FAST-TESTER DELUXE EXCESS.D64
+            // [GAMES]
+            entry.name = line.substr(1, line.length() - 2);
+            entry.is_dir = true;
+            mstr::rtrim(entry.name);
+            entry.name = mstr::toUTF8(entry.name);
+        } else {
+            entry.name = line;
+            entry.size = 683 * 256;
+            mstr::rtrim(entry.name);
+            entry.name = mstr::toUTF8(entry.name);
+        }
+        if (!entry.name.empty())
+            listing.entries.push_back(entry);
+    }
+    return true;
+}
+
+bool CSIPClient::cachedSize(const std::string& path, uint32_t& size)
+{
+    std::vector<std::string> parts = split(path);
+    if (parts.empty())
+        return false;
+
+    std::string name = parts.back();
+    parts.pop_back();
+    auto it = _listings.find("/" + join(parts));
+    if (it == _listings.end() || it->second.expires <= time(nullptr))
+        return false;
+
+    for (auto& entry : it->second.entries) {
+        if (!entry.is_dir && mstr::equals(entry.name, name, false)) {
+            size = entry.size;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CSIPClient::load(const std::string& path, uint32_t& size)
+{
+    // Through a D64 container image: INSERT it first
+    std::string target = path;
+    std::string lower = path;
+    mstr::toLower(lower);
+    size_t sep = lower.find(".d64/");
+    if (sep != std::string::npos) {
+        if (!changeTo(path.substr(0, sep + 4))) {
+            Debug_printv("CSIP: failed to mount image [%s]", path.substr(0, sep + 4).c_str());
+            return false;
+        }
+        target = path.substr(sep + 5);
+    }
+
+    if (!command("load " + target))
+        return false;
+
+    // Two bytes of size, low first - or "?500 - ..."
+    uint8_t len[2];
+    size_t got = 0;
+    while (got < 2) {
+        size_t n = read(len + got, 2 - got);
+        if (n == 0)
+            return false;
+        got += n;
+    }
+    if (len[0] == '?' && len[1] == '5') {
+        std::string error;
+        readLine(error, CSIP_LISTING_IDLE_MS);
+        Debug_printv("CSIP: load failed [?5%s]", error.c_str());
+        return false;
+    }
+
+    size = len[0] + len[1] * 256;
+    _load_left = size;
+    return true;
+}
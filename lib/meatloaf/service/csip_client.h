@@ -0,0 +1,158 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// CommodoreServer Internet Protocol client: the telnet-style connection
+// CSIPMSession talks over, kept free of the MFile layer.
+//
+// Replies are read through one buffer, waiting on select() for the socket
+// to become readable rather than polling it with sleeps. A reply's first
+// line may take CSIP_REPLY_TIMEOUT_MS; once a listing is flowing, the
+// server's prompt ends it, or failing that CSIP_LISTING_IDLE_MS of silence.
+//
+// The server keeps a current folder and an inserted image per connection.
+// Both are tracked here, so returning to the folder (or image) it is in
+// sends nothing at all; any other folder is one CF with the absolute path.
+// Sending only the part below the current folder would be no cheaper - it
+// is the same single round trip - and a relative CF trusts the tracked
+// folder to match the server's: if it ever didn't, the client would end up
+// somewhere else without knowing. Listings are kept per path for
+// CSIP_LISTING_TTL seconds: browsing back and forth, or opening a file whose
+// size the listing already gave, costs no round trips.
+
+#ifndef MEATLOAF_SERVICE_CSIP_CLIENT
+#define MEATLOAF_SERVICE_CSIP_CLIENT
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifndef CSIP_REPLY_TIMEOUT_MS
+#define CSIP_REPLY_TIMEOUT_MS   5000
+#endif
+
+#ifndef CSIP_LISTING_IDLE_MS
+#define CSIP_LISTING_IDLE_MS    500
+#endif
+
+#ifndef CSIP_LISTING_TTL
+#define CSIP_LISTING_TTL        120     // seconds
+#endif
+
+#ifndef CSIP_LISTING_ENTRIES
+#define CSIP_LISTING_ENTRIES    16      // paths
+#endif
+
+#define CSIP_RECV_BUFFER        512
+
+struct CSIPEntry
+{
+    std::string name;       // UTF-8
+    uint32_t size = 0;      // bytes (blocks * 256 in an image)
+    bool is_dir = false;
+};
+
+struct CSIPListing
+{
+    bool is_image = false;
+    std::string image;      // the server's name for an inserted image
+    std::string header;     // UTF-8
+    std::string id;
+    uint16_t blocks_free = 65535;
+    std::vector<CSIPEntry> entries;
+    time_t expires = 0;
+};
+
+class CSIPClient
+{
+public:
+    ~CSIPClient() { close(); }
+
+    bool open(const std::string& host, uint16_t port);
+    void close();
+    bool isOpen() const { return _sock >= 0; }
+
+    // Send one command line (converted to PETSCII, CR-terminated). Whatever
+    // is left unread of an earlier reply is discarded first.
+    bool command(const std::string& command);
+
+    // Read replies up to "00 - OK" (true) or a "?nnn" error (false)
+    bool isOK();
+
+    // One reply line without its CR/LF; false if none came in time
+    bool readLine(std::string& line, uint32_t timeout_ms = CSIP_REPLY_TIMEOUT_MS);
+
+    // Raw bytes, e.g. a LOAD; waits up to timeout_ms for the first of them
+    size_t read(uint8_t* buf, size_t size, uint32_t timeout_ms = CSIP_REPLY_TIMEOUT_MS);
+    size_t write(const uint8_t* buf, size_t size);
+
+    // Make 'path' ("/", "/GAMES/ACTION") the server's current folder, or
+    // insert 'path' when it names a .D64
+    bool changeTo(const std::string& path);
+
+    // The folder or image at 'path', from the cache when it's still fresh
+    bool list(const std::string& path, CSIPListing& listing);
+
+    // The size of the file at 'path' as its folder's listing gave it
+    bool cachedSize(const std::string& path, uint32_t& size);
+
+    // LOAD a file; 'size' from the two length bytes the server sends first.
+    // The file's bytes follow through read().
+    bool load(const std::string& path, uint32_t& size);
+
+    // A round trip that leaves the server at its root ("cf /")
+    bool ping();
+
+    // Server-side state is no longer what was tracked (login, logout):
+    // forget the folder, the image and the listings
+    void forget();
+
+    // The server's current folder as tracked, "/" at the root
+    std::string folder() const;
+    const std::string& image() const { return _image; }
+
+    uint32_t commandsSent() const { return _commands; }
+    uint32_t listingHits() const { return _hits; }
+
+    static std::vector<std::string> split(const std::string& path);
+    static std::string join(const std::vector<std::string>& parts, size_t from = 0);
+    static bool isImage(const std::string& path);
+
+private:
+    bool fill(uint32_t timeout_ms);
+    bool readListing(bool is_image, CSIPListing& listing);
+    void skipLoad();
+
+    int _sock = -1;
+    uint8_t _rbuf[CSIP_RECV_BUFFER];
+    size_t _rhead = 0;
+    size_t _rtail = 0;
+    bool _skip_lf = false;  // last line ended on CR; an LF right after it belongs to it
+    uint32_t _load_left = 0;
+
+    std::vector<std::string> _cwd;
+    bool _cwd_known = true;
+    std::string _image;
+
+    std::map<std::string, CSIPListing> _listings;
+    uint32_t _commands = 0;
+    uint32_t _hits = 0;
+};
+
+#endif // MEATLOAF_SERVICE_CSIP_CLIENT
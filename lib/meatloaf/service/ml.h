@@ -23,8 +23,20 @@
 #define MEATLOAF_SCHEME_ML
 
 #include "network/http.h"
+#include "service/ml_cache.h"
 
 #include "peoples_url_parser.h"
+#include "global_defines.h"
+
+#include "fnFsSD.h"
+#include "fsFlash.h"
+
+// Resolved codes survive a reboot here, on the SD card or else in flash
+#define ML_RESOLVE_CACHE_FILE       SYSTEM_DIR "/ml_codes"
+
+// How long the api.meatloaf.cc session stays open after a lookup. A new one
+// costs a TLS handshake (~3 s); an open one, one round trip.
+#define ML_SESSION_GRACE_MS         (2 * 60 * 1000)
 
 
 /********************************************************
@@ -96,20 +108,63 @@ public:
             ml_url += "#" + urlParser->fragment;
         Debug_printv("code[%s] code_path[%s] ml_url[%s]", code.c_str(), code_path.c_str(), ml_url.c_str());
 
-        MFile* http = new HTTPMFile(ml_url);
-        auto reader = http->getSourceStream();
-        auto url = reader->url;
+        std::call_once(_codes_placed, [this] { placeCodes(); });
+        auto url = _codes.resolve(ml_url, [this](const std::string& key) { return fetch(key); });
+        if ( url.empty() )
+            return "";
         if ( code_path.size() > 0)
             url += code_path;
-        delete http;
-
-        // Release session for api.meatloaf.cc
-        // Key format matches SessionBroker::obtain() which uses HTTPMSession::getScheme() ("http")
-        SessionBroker::dispose("http://api.meatloaf.cc:443");
 
         Debug_printv("target url[%s]", url.c_str());
         return url;
     }
+
+private:
+    MLResolveCache _codes;
+    std::once_flag _codes_placed;
+
+    // The file goes where mlConfig keeps its own. Not decided until the
+    // first lookup: when this is constructed the SD card isn't mounted yet.
+    void placeCodes() {
+        FileSystem &fs = fnSDFAT.running() ? static_cast<FileSystem &>(fnSDFAT)
+                                           : static_cast<FileSystem &>(fsFlash);
+        if (fnSDFAT.running())
+            fnSDFAT.create_path(SYSTEM_DIR);
+        else
+            fsFlash.create_path(SYSTEM_DIR);
+        _codes.setPersistPath(std::string(fs.basepath()) + ML_RESOLVE_CACHE_FILE);
+    }
+
+    // Ask api.meatloaf.cc where a code points
+    MLResolveCache::Answer fetch(const std::string& ml_url) {
+        MLResolveCache::Answer answer;
+        answer.definitive = false;
+
+        // The same session HTTPMFile picks up below, left open for the next
+        // lookup rather than disposed
+        auto session = SessionBroker::obtain<HTTPMSession>("api.meatloaf.cc", 443);
+        if ( !session || !session->client )
+            return answer;
+        session->setIdleGracePeriod(ML_SESSION_GRACE_MS);
+
+        // The shortest lifetime any response on the way to the target allows
+        uint32_t max_age = ML_RESOLVE_DEFAULT_TTL;
+        session->client->setOnHeader([&max_age](char* key, char* value) -> int {
+            if ( key && value && mstr::equals("Cache-Control", key, false) )
+                max_age = std::min(max_age, MLResolveCache::maxAge(value));
+            return 0;
+        });
+
+        // The stream has its url whether or not it opened; only the stream
+        // and the status code say whether the API answered
+        MFile* http = new HTTPMFile(ml_url);
+        auto reader = http->getSourceStream();
+        answer = MLResolveCache::answer(reader, session->client->lastRC, max_age);
+        session->client->setOnHeader([](char*, char*) { return 0; });
+        delete http;
+
+        return answer;
+    }
 };
 
 
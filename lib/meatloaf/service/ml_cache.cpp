@@ -0,0 +1,253 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "service/ml_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+std::string MLResolveCache::resolve(const std::string& key, const Fetch& fetch, time_t now)
+{
+    bool loaded;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        loaded = _loaded;
+    }
+    if (!loaded)
+        load(now);
+
+    Answer answer;
+    if (lookup(key, answer, now))
+        return answer.found ? answer.url : "";
+
+    // Not under the lock: the round trip can take seconds, and another
+    // task resolving a different code shouldn't wait for it
+    answer = fetch(key);
+    store(key, answer, now);
+    return answer.found ? answer.url : "";
+}
+
+bool MLResolveCache::lookup(const std::string& key, Answer& answer, time_t now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto it = _entries.find(key);
+    if (it == _entries.end() || it->second.expires <= now) {
+        if (it != _entries.end())
+            _entries.erase(it);
+        _misses++;
+        return false;
+    }
+    answer.found = it->second.found;
+    answer.url = it->second.url;
+    answer.max_age = (uint32_t)(it->second.expires - now);
+    _hits++;
+    return true;
+}
+
+void MLResolveCache::store(const std::string& key, const Answer& answer, time_t now)
+{
+    if (!answer.definitive)
+        return;
+
+    uint32_t ttl = answer.found ? answer.max_age : std::min<uint32_t>(answer.max_age, ML_RESOLVE_NEGATIVE_TTL);
+    if (ttl == 0 || (answer.found && answer.url.empty()))
+        return;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    Entry& entry = _entries[key];
+    bool was_found = entry.found;
+    entry = { answer.found, answer.url, now + (time_t)ttl };
+
+    // Only what resolved is worth the flash write; an unknown code is
+    // remembered for a minute, not across a reboot
+    if (answer.found)
+        appendLocked(key, &entry);
+    else if (was_found)
+        appendLocked(key, nullptr);
+    evict(now);
+}
+
+void MLResolveCache::invalidate(const std::string& key)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_entries.erase(key))
+        appendLocked(key, nullptr);
+}
+
+void MLResolveCache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _entries.clear();
+    _hits = 0;
+    _misses = 0;
+    saveLocked();
+}
+
+size_t MLResolveCache::size()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _entries.size();
+}
+
+// Over the limit: expired entries go first, then those closest to expiring
+void MLResolveCache::evict(time_t now)
+{
+    for (auto it = _entries.begin(); it != _entries.end() && _entries.size() > ML_RESOLVE_CACHE_ENTRIES;) {
+        if (it->second.expires <= now)
+            it = _entries.erase(it);
+        else
+            ++it;
+    }
+    while (_entries.size() > ML_RESOLVE_CACHE_ENTRIES) {
+        auto oldest = _entries.begin();
+        for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+            if (it->second.expires < oldest->second.expires)
+                oldest = it;
+        }
+        _entries.erase(oldest);
+    }
+}
+
+void MLResolveCache::setPersistPath(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _persist_path = path;
+    _loaded = false;
+}
+
+// One line per answer: "<expires>\t<key>\t<url>", newer lines after older
+// ones. A line with no url is a code taken out.
+bool MLResolveCache::load(time_t now)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    _loaded = true;
+    _persist_lines = 0;
+    if (_persist_path.empty())
+        return false;
+
+    FILE* f = fopen(_persist_path.c_str(), "r");
+    if (!f)
+        return false;
+
+    std::map<std::string, Entry> saved;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        _persist_lines++;
+        char* key = strchr(line, '\t');
+        if (!key)
+            continue;
+        *key++ = '\0';
+        char* url = strchr(key, '\t');
+        if (!url)
+            continue;
+        *url++ = '\0';
+        url[strcspn(url, "\r\n")] = '\0';
+
+        if (!*key)
+            continue;
+
+        time_t expires = (time_t)strtoll(line, nullptr, 10);
+        if (expires <= now || !*url)
+            saved.erase(key);
+        else
+            saved[key] = { true, url, expires };
+    }
+    fclose(f);
+
+    // What's already here is newer than anything in the file
+    _entries.insert(saved.begin(), saved.end());
+    evict(now);
+    if (_persist_lines >= ML_RESOLVE_CACHE_LINES)
+        saveLocked();
+    return true;
+}
+
+bool MLResolveCache::save()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return saveLocked();
+}
+
+// A tab or line break in either would split the line wrongly on load
+static bool fits_line(const std::string& key, const std::string& url)
+{
+    return key.find_first_of("\t\r\n") == std::string::npos &&
+           url.find_first_of("\t\r\n") == std::string::npos;
+}
+
+bool MLResolveCache::saveLocked()
+{
+    if (_persist_path.empty())
+        return false;
+
+    FILE* f = fopen(_persist_path.c_str(), "w");
+    if (!f)
+        return false;
+
+    _persist_lines = 0;
+    for (auto& e : _entries) {
+        if (!e.second.found || !fits_line(e.first, e.second.url))
+            continue;
+        fprintf(f, "%lld\t%s\t%s\n", (long long)e.second.expires, e.first.c_str(), e.second.url.c_str());
+        _persist_lines++;
+    }
+    fclose(f);
+    return true;
+}
+
+// One answer, or with no entry the code's removal, added to the end of the
+// file - unless the file has grown long enough to start over
+bool MLResolveCache::appendLocked(const std::string& key, const Entry* entry)
+{
+    if (_persist_path.empty())
+        return false;
+    if (_persist_lines >= ML_RESOLVE_CACHE_LINES)
+        return saveLocked();
+    if (!fits_line(key, entry ? entry->url : ""))
+        return false;
+
+    FILE* f = fopen(_persist_path.c_str(), "a");
+    if (!f)
+        return false;
+    fprintf(f, "%lld\t%s\t%s\n", entry ? (long long)entry->expires : 0LL, key.c_str(),
+            entry ? entry->url.c_str() : "");
+    fclose(f);
+    _persist_lines++;
+    return true;
+}
+
+uint32_t MLResolveCache::maxAge(const std::string& cache_control, uint32_t fallback)
+{
+    std::string cc = cache_control;
+    for (auto& c : cc)
+        c = (char)tolower((unsigned char)c);
+
+    if (cc.find("no-store") != std::string::npos || cc.find("no-cache") != std::string::npos)
+        return 0;
+
+    // s-maxage is meant for shared caches, which is what this is
+    for (const char* directive : { "s-maxage=", "max-age=" }) {
+        size_t pos = cc.find(directive);
+        if (pos == std::string::npos)
+            continue;
+        return (uint32_t)strtoul(cc.c_str() + pos + strlen(directive), nullptr, 10);
+    }
+    return fallback;
+}
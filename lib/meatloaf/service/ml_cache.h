@@ -0,0 +1,140 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+// Short code -> target URL cache for ML://
+//
+// Every lookup of an ml: path asks api.meatloaf.cc where the code points,
+// and MFSOwner::File() resolves the same path again each time it is opened -
+// a LOAD, its directory refresh and the next LOAD of the same code all paid
+// for a round trip, and for the TLS handshake too when the session had gone.
+// The answers change rarely, so they are kept here for as long as the API's
+// Cache-Control allows (ML_RESOLVE_DEFAULT_TTL when it says nothing), and
+// codes it doesn't know are remembered for ML_RESOLVE_NEGATIVE_TTL.
+//
+// Entries expire by wall clock and are written to a file, so a code resolved
+// before a reboot still resolves without the network after it. Each new
+// answer is appended to the file; it is only written over, with just the
+// live entries, once it has grown to ML_RESOLVE_CACHE_LINES.
+
+#ifndef MEATLOAF_SERVICE_ML_CACHE
+#define MEATLOAF_SERVICE_ML_CACHE
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+#ifndef ML_RESOLVE_CACHE_ENTRIES
+#define ML_RESOLVE_CACHE_ENTRIES    64
+#endif
+
+// Seconds an answer is kept when the API sends no Cache-Control
+#ifndef ML_RESOLVE_DEFAULT_TTL
+#define ML_RESOLVE_DEFAULT_TTL      (60 * 60)
+#endif
+
+// Lines the cache file may grow to before it is written over
+#ifndef ML_RESOLVE_CACHE_LINES
+#define ML_RESOLVE_CACHE_LINES      (ML_RESOLVE_CACHE_ENTRIES * 4)
+#endif
+
+// Seconds an unknown code is remembered as unknown
+#ifndef ML_RESOLVE_NEGATIVE_TTL
+#define ML_RESOLVE_NEGATIVE_TTL     60
+#endif
+
+class MLResolveCache
+{
+public:
+    // What the API said about a code
+    struct Answer {
+        bool found = false;         // the code points somewhere
+        bool definitive = true;     // false: no answer (network, server error) - not cached
+        std::string url;            // where it points
+        uint32_t max_age = ML_RESOLVE_DEFAULT_TTL;  // seconds; 0 = don't keep
+    };
+    using Fetch = std::function<Answer(const std::string& key)>;
+
+    // The target for `key`, from the cache or else from fetch(). Empty when
+    // the code is unknown or the API could not be reached.
+    std::string resolve(const std::string& key, const Fetch& fetch, time_t now = time(nullptr));
+
+    bool lookup(const std::string& key, Answer& answer, time_t now);
+    void store(const std::string& key, const Answer& answer, time_t now);
+    void invalidate(const std::string& key);
+    void clear();
+
+    // Where resolved codes are kept across reboots: a full VFS path, whose
+    // directory must exist. Loaded on the first resolve(), appended to
+    // whenever a new code resolves.
+    void setPersistPath(const std::string& path);
+    bool load(time_t now);
+    bool save();
+
+    // What an API response says about a code. Found only when the stream
+    // opened on a 2xx/3xx; a 4xx means the API doesn't know it. Anything
+    // else - not connected, timed out, 5xx - is no answer at all. `reader`
+    // is the stream, by pointer or shared_ptr.
+    template <class StreamPtr>
+    static Answer answer(const StreamPtr& reader, int rc, uint32_t max_age)
+    {
+        Answer answer;
+        answer.definitive = false;
+        bool opened = reader && reader->isOpen();
+        if (opened && rc >= 200 && rc < 400 && !reader->url.empty()) {
+            answer.found = true;
+            answer.url = reader->url;
+            answer.max_age = max_age;
+            answer.definitive = true;
+        } else if (rc >= 400 && rc < 500) {
+            answer.max_age = max_age;
+            answer.definitive = true;
+        }
+        return answer;
+    }
+
+    // Seconds Cache-Control lets a response be reused: max-age (s-maxage
+    // where given), 0 for no-store/no-cache, `fallback` when it says neither
+    static uint32_t maxAge(const std::string& cache_control, uint32_t fallback = ML_RESOLVE_DEFAULT_TTL);
+
+    size_t size();
+    uint32_t hits() const { return _hits; }
+    uint32_t misses() const { return _misses; }
+
+private:
+    struct Entry {
+        bool found;
+        std::string url;
+        time_t expires;
+    };
+
+    void evict(time_t now);
+    bool saveLocked();
+    bool appendLocked(const std::string& key, const Entry* entry);
+
+    std::mutex _mutex;
+    std::map<std::string, Entry> _entries;
+    std::string _persist_path;
+    bool _loaded = false;
+    uint32_t _persist_lines = 0;    // lines in the file, live or not
+    uint32_t _hits = 0;
+    uint32_t _misses = 0;
+};
+
+#endif // MEATLOAF_SERVICE_ML_CACHE
@@ -184,8 +184,8 @@ bool NetworkProtocol::status(NetworkStatus *status)
     if (fromInterrupt)   
         return false;
  
-    if (!is_write && receiveBuffer->length() == 0 && status->rxBytesWaiting > 0)
-        read(status->rxBytesWaiting);
+    if (!is_write && receiveBuffer->length() == 0 && status->rxBytesWaiting > 0 && receiveWindow > 0)
+        read(std::min(status->rxBytesWaiting, receiveWindow));
 
     status->rxBytesWaiting = receiveBuffer->length();
 
@@ -193,53 +193,151 @@ bool NetworkProtocol::status(NetworkStatus *status)
 }
 
 /**
- * Perform end of line translation on receive buffer. based on translation_mode.
- * @param rx_buf The receive buffer to transform
- * @param len The length of the receive buffer
- * @return length after transformation.
-  */
-void NetworkProtocol::translate_receive_buffer()
+ * Byte for byte translation tables, one per direction and line ending mode.
+ * Entry 0 carries only the platform's own substitutions (Atari BELL/BS/TAB),
+ * for the modes that add none of their own (PETSCII and anything unknown).
+ */
+namespace {
+
+struct TranslationTable
 {
-#ifdef VERBOSE_PROTOCOL
-    Debug_printf("#### Translating receive buffer, mode: %u\r\n", translation_mode);
-#endif
-    if (translation_mode == 0)
-        return;
+    uint8_t to[256];
+    bool identity;
+};
 
-    #ifdef BUILD_ATARI
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BELL, ATASCII_BUZZER);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_BACKSPACE, ATASCII_DEL);
-    replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_TAB, ATASCII_TAB);
-    #endif   
+constexpr TranslationTable receiveTable(uint8_t mode)
+{
+    TranslationTable t = {};
+    for (int c = 0; c < 256; c++)
+        t.to[c] = (uint8_t)c;
+
+#ifdef BUILD_ATARI
+    t.to[ASCII_BELL] = ATASCII_BUZZER;
+    t.to[ASCII_BACKSPACE] = ATASCII_DEL;
+    t.to[ASCII_TAB] = ATASCII_TAB;
+#endif
 
-    switch (translation_mode)
+    switch (mode)
     {
     case TRANSLATION_MODE_CR:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
+        t.to[ASCII_CR] = EOL;
         break;
     case TRANSLATION_MODE_LF:
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_LF, EOL);
+        t.to[ASCII_LF] = EOL;
         break;
     case TRANSLATION_MODE_CRLF:
-    #ifndef BUILD_APPLE
+#ifndef BUILD_APPLE
         // With Apple2, we would be translating CR to CR; a waste of CPU
-        replace(receiveBuffer->begin(), receiveBuffer->end(), ASCII_CR, EOL);
-    #endif
+        t.to[ASCII_CR] = EOL;
+#endif
         break;
-    case TRANSLATION_MODE_PETSCII:
-#ifdef VERBOSE_PROTOCOL
-        Debug_printf("!!! PETSCII !!!\r\n");
+    }
+
+    t.identity = true;
+    for (int c = 0; c < 256; c++)
+        if (t.to[c] != c)
+            t.identity = false;
+    return t;
+}
+
+// EOL to CR+LF is not byte for byte: the CRLF entry maps EOL to itself and
+// translate_transmit_buffer() expands it
+constexpr TranslationTable transmitTable(uint8_t mode)
+{
+    TranslationTable t = {};
+    for (int c = 0; c < 256; c++)
+        t.to[c] = (uint8_t)c;
+
+#ifdef BUILD_ATARI
+    t.to[ATASCII_BUZZER] = ASCII_BELL;
+    t.to[ATASCII_DEL] = ASCII_BACKSPACE;
+    t.to[ATASCII_TAB] = ASCII_TAB;
 #endif
-        *receiveBuffer = mstr::toUTF8(*receiveBuffer);
+
+    switch (mode)
+    {
+    case TRANSLATION_MODE_CR:
+        t.to[EOL] = ASCII_CR;
+        break;
+    case TRANSLATION_MODE_LF:
+        t.to[EOL] = ASCII_LF;
         break;
     }
 
+    t.identity = true;
+    for (int c = 0; c < 256; c++)
+        if (t.to[c] != c)
+            t.identity = false;
+    return t;
+}
+
+constexpr TranslationTable receive_tables[4] = {
+    receiveTable(TRANSLATION_MODE_NONE),
+    receiveTable(TRANSLATION_MODE_CR),
+    receiveTable(TRANSLATION_MODE_LF),
+    receiveTable(TRANSLATION_MODE_CRLF),
+};
+
+constexpr TranslationTable transmit_tables[4] = {
+    transmitTable(TRANSLATION_MODE_NONE),
+    transmitTable(TRANSLATION_MODE_CR),
+    transmitTable(TRANSLATION_MODE_LF),
+    transmitTable(TRANSLATION_MODE_CRLF),
+};
+
+inline const TranslationTable &tableFor(const TranslationTable (&tables)[4], uint8_t mode)
+{
+    return tables[mode <= TRANSLATION_MODE_CRLF ? mode : TRANSLATION_MODE_NONE];
+}
+
+} // namespace
+
+/**
+ * Perform end of line translation on receive buffer. based on translation_mode.
+ * One pass over the buffer, in place: every mode maps byte for byte, and
+ * CRLF only drops bytes (the LFs).
+ */
+void NetworkProtocol::translate_receive_buffer()
+{
+#ifdef VERBOSE_PROTOCOL
+    Debug_printf("#### Translating receive buffer, mode: %u\r\n", translation_mode);
+#endif
+    if (translation_mode == 0 || receiveBuffer->empty())
+        return;
+
+    const TranslationTable &table = tableFor(receive_tables, translation_mode);
+    uint8_t *p = (uint8_t *)&(*receiveBuffer)[0];
+    size_t len = receiveBuffer->length();
+
     if (translation_mode == TRANSLATION_MODE_CRLF)
-        receiveBuffer->erase(std::remove(receiveBuffer->begin(), receiveBuffer->end(), '\n'), receiveBuffer->end());
+    {
+        size_t out = 0;
+        for (size_t i = 0; i < len; i++)
+        {
+            uint8_t c = p[i];
+            if (c != ASCII_LF)
+                p[out++] = table.to[c];
+        }
+        receiveBuffer->resize(out);
+    }
+    else if (!table.identity)
+    {
+        for (size_t i = 0; i < len; i++)
+            p[i] = table.to[p[i]];
+    }
+
+    if (translation_mode == TRANSLATION_MODE_PETSCII)
+    {
+#ifdef VERBOSE_PROTOCOL
+        Debug_printf("!!! PETSCII !!!\r\n");
+#endif
+        *receiveBuffer = mstr::toUTF8(*receiveBuffer);
+    }
 }
 
 /**
  * Perform end of line translation on transmit buffer. based on translation_mode
+ * In place; CRLF first counts the EOLs, then expands from the end backwards.
  * @return new length after translation
  */
 unsigned short NetworkProtocol::translate_transmit_buffer()
@@ -247,30 +345,41 @@ unsigned short NetworkProtocol::translate_transmit_buffer()
 #ifdef VERBOSE_PROTOCOL
     Debug_printf("#### Translating transmit buffer, mode: %u\r\n", translation_mode);
 #endif
-    if (translation_mode == 0)
+    if (translation_mode == 0 || transmitBuffer->empty())
         return transmitBuffer->length();
 
-    #ifdef BUILD_ATARI
-    util_replaceAll(*transmitBuffer, STR_ATASCII_BUZZER, STR_ASCII_BELL);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_DEL, STR_ASCII_BACKSPACE);
-    util_replaceAll(*transmitBuffer, STR_ATASCII_TAB, STR_ASCII_TAB);
-    #endif
+    const TranslationTable &table = tableFor(transmit_tables, translation_mode);
+    size_t len = transmitBuffer->length();
 
-    switch (translation_mode)
+    if (translation_mode == TRANSLATION_MODE_CRLF)
     {
-    case TRANSLATION_MODE_CR:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CR);
-        break;
-    case TRANSLATION_MODE_LF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_LF);
-        break;
-    case TRANSLATION_MODE_CRLF:
-        util_replaceAll(*transmitBuffer, STR_EOL, STR_ASCII_CRLF);
-        break;
-    case TRANSLATION_MODE_PETSCII:
-        *transmitBuffer = mstr::toUTF8(*transmitBuffer);
-        break;
+        size_t eols = std::count(transmitBuffer->begin(), transmitBuffer->end(), (char)EOL);
+        transmitBuffer->resize(len + eols);
+        uint8_t *p = (uint8_t *)&(*transmitBuffer)[0];
+        size_t out = len + eols;
+        for (size_t i = len; i-- > 0;)
+        {
+            uint8_t c = p[i];
+            if (c == EOL)
+            {
+                p[--out] = ASCII_LF;
+                p[--out] = ASCII_CR;
+            }
+            else
+            {
+                p[--out] = table.to[c];
+            }
+        }
     }
+    else if (!table.identity)
+    {
+        uint8_t *p = (uint8_t *)&(*transmitBuffer)[0];
+        for (size_t i = 0; i < len; i++)
+            p[i] = table.to[p[i]];
+    }
+
+    if (translation_mode == TRANSLATION_MODE_PETSCII)
+        *transmitBuffer = mstr::toUTF8(*transmitBuffer);
 
     return transmitBuffer->length();
 }
@@ -101,6 +101,12 @@ public:
      */
     unsigned short bytesWaiting = 0;
 
+    /**
+     * @brief Most bytes status() reads ahead into receiveBuffer; the channel
+     * sets it to the room it has left, so a full channel stops the reading
+     */
+    unsigned short receiveWindow = 0xFFFF;
+
     /**
      * @brief Error code to return in status
      */
@@ -0,0 +1,55 @@
+/**
+ * Network channel data: the receive path from protocol to bus
+ */
+
+#include "network_data.h"
+
+#include <algorithm>
+
+#include "../../include/debug.h"
+
+#include "Protocol.h"
+
+bool NetworkData::receive(NetworkStatus &ns, uint16_t limit)
+{
+    // Whatever is still in receiveBuffer after this is waiting for room in
+    // the ring; asking the protocol for more would only pile up behind it
+    stageReceived();
+    if (receiveRing.full())
+        return true;
+
+    protocol->status(&ns);
+    if (ns.rxBytesWaiting > 0)
+    {
+        uint16_t blockSize = std::min<size_t>({ ns.rxBytesWaiting, limit, receiveRing.space() });
+        Debug_printf("bytes waiting: %u / blockSize: %u / connected: %u / error: %u ", ns.rxBytesWaiting, blockSize, ns.connected, ns.error);
+        if (protocol->read(blockSize))
+            return false;
+    }
+
+    stageReceived();
+    return true;
+}
+
+size_t NetworkData::stageReceived()
+{
+    size_t n = receiveRing.write((const uint8_t *)receiveBuffer.data(), receiveBuffer.size());
+    if (n == receiveBuffer.size())
+        receiveBuffer.clear();      // keeps its capacity for the next read
+    else if (n > 0)
+        receiveBuffer.erase(0, n);
+
+    if (protocol)
+        protocol->receiveWindow = std::min<size_t>(receiveRing.space(), 0xFFFF);
+    return n;
+}
+
+void NetworkData::unstageReceived()
+{
+    if (receiveRing.empty())
+        return;
+
+    std::string held(receiveRing.size(), '\0');
+    receiveRing.read((uint8_t *)&held[0], held.size());
+    receiveBuffer.insert(0, held);
+}
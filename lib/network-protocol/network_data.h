@@ -7,14 +7,20 @@
 #include <memory>
 #include <string>
 
+#include "network_ring.h"
+
 class NetworkProtocol;
+class NetworkStatus;
 class FNJSON;
 class PeoplesUrlParser;
 
 struct NetworkData {
     std::unique_ptr<NetworkProtocol> protocol;
     std::unique_ptr<FNJSON> json;
+    // The protocol appends what it reads to receiveBuffer; the bus reads
+    // from receiveRing, which receive() moves it into.
     std::string receiveBuffer;
+    NetworkRing receiveRing;
     std::string transmitBuffer;
     std::string specialBuffer;
     std::string deviceSpec;
@@ -24,6 +30,39 @@ struct NetworkData {
     uint8_t translationMode = 0;
     std::string login;
     std::string password;
+
+    /**
+     * @brief Ask the protocol for up to limit more bytes, if receiveRing has
+     * room for them, and move what it has into the ring. With the ring full
+     * the protocol is left alone, and so is its socket.
+     * @param ns status as the protocol reported it
+     * @return false if the protocol reported a read error
+     */
+    bool receive(NetworkStatus &ns, uint16_t limit);
+
+    /**
+     * @brief Move what fits of receiveBuffer into receiveRing, and set the
+     * protocol's receiveWindow to the room left
+     * @return the number of bytes moved
+     */
+    size_t stageReceived();
+
+    /**
+     * @brief Put what receiveRing holds back in front of receiveBuffer, for
+     * commands that rework the whole of what has been received
+     */
+    void unstageReceived();
+
+    /**
+     * @brief Received bytes the host has not read yet
+     */
+    size_t received() const { return receiveRing.size() + receiveBuffer.size(); }
+
+    void clearReceived()
+    {
+        receiveRing.clear();
+        receiveBuffer.clear();
+    }
 };
 
 #endif // NETWORK_DATA_H
\ No newline at end of file
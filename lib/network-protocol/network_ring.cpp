@@ -0,0 +1,53 @@
+/**
+ * Fixed capacity byte ring for network channels
+ */
+
+#include "network_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+size_t NetworkRing::write(const uint8_t *data, size_t len)
+{
+    len = std::min(len, space());
+    if (len == 0)
+        return 0;
+    if (!_data)
+        _data.reset(new uint8_t[_capacity]);
+
+    // Up to the end of the storage, then from its start
+    size_t tail = (_head + _size) % _capacity;
+    size_t first = std::min(len, _capacity - tail);
+    memcpy(_data.get() + tail, data, first);
+    memcpy(_data.get(), data + first, len - first);
+    _size += len;
+    return len;
+}
+
+size_t NetworkRing::read(uint8_t *data, size_t len)
+{
+    len = std::min(len, _size);
+    if (len == 0)
+        return 0;
+
+    size_t first = std::min(len, _capacity - _head);
+    memcpy(data, _data.get() + _head, first);
+    memcpy(data + first, _data.get(), len - first);
+    consume(len);
+    return len;
+}
+
+const uint8_t *NetworkRing::front(size_t &len) const
+{
+    len = std::min(_size, _capacity - _head);
+    return _data.get() + _head;
+}
+
+void NetworkRing::consume(size_t len)
+{
+    len = std::min(len, _size);
+    _head = (_head + len) % _capacity;
+    _size -= len;
+    if (_size == 0)
+        _head = 0;
+}
@@ -0,0 +1,72 @@
+// network_ring.h
+#ifndef NETWORK_RING_H
+#define NETWORK_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Bytes a channel holds between the protocol and the bus. A host reading
+ * 254 bytes at a time gets each read as one or two memcpy()s, and the
+ * protocol is not read from again until there is room for what it brings.
+ */
+#ifndef NETWORK_RING_SIZE
+#define NETWORK_RING_SIZE 4096
+#endif
+
+/**
+ * @brief Fixed capacity FIFO of bytes. The storage is allocated by the first
+ * write and kept until the ring is destroyed; nothing after that allocates.
+ */
+class NetworkRing
+{
+public:
+    explicit NetworkRing(size_t capacity = NETWORK_RING_SIZE) : _capacity(capacity) {}
+
+    size_t capacity() const { return _capacity; }
+    size_t size() const { return _size; }
+    size_t space() const { return _capacity - _size; }
+    bool empty() const { return _size == 0; }
+    bool full() const { return _size == _capacity; }
+
+    /**
+     * @brief Drop everything held, keeping the storage
+     */
+    void clear()
+    {
+        _head = 0;
+        _size = 0;
+    }
+
+    /**
+     * @brief Append up to len bytes
+     * @return the number appended, less than len when the ring fills
+     */
+    size_t write(const uint8_t *data, size_t len);
+
+    /**
+     * @brief Take up to len bytes from the front
+     * @return the number taken
+     */
+    size_t read(uint8_t *data, size_t len);
+
+    /**
+     * @brief The oldest bytes held that lie in one piece, without taking them
+     * @param len set to how many there are
+     */
+    const uint8_t *front(size_t &len) const;
+
+    /**
+     * @brief Take len bytes from the front without copying them
+     */
+    void consume(size_t len);
+
+private:
+    std::unique_ptr<uint8_t[]> _data;
+    size_t _capacity;
+    size_t _head = 0;   // index of the oldest byte
+    size_t _size = 0;
+};
+
+#endif // NETWORK_RING_H
@@ -0,0 +1,244 @@
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../../include/debug.h"
+
+// https://www.w3.org/TR/png/
+
+static void put32(uint8_t *dest, uint32_t v)
+{
+    dest[0] = (uint8_t)(v >> 24);
+    dest[1] = (uint8_t)(v >> 16);
+    dest[2] = (uint8_t)(v >> 8);
+    dest[3] = (uint8_t)v;
+}
+
+// zlib's table-driven CRC-32 (the PNG polynomial), a word at a time
+uint32_t PngWriter::crc(uint32_t crc, const uint8_t *buf, size_t len)
+{
+    return (uint32_t)::crc32(crc, buf, (uInt)len);
+}
+
+PngWriter::~PngWriter()
+{
+    if (_open)
+        deflateEnd(&_z);
+}
+
+bool PngWriter::chunk(FILE *f, const char type[4], const uint8_t *data, uint32_t len)
+{
+    uint8_t head[8];
+    put32(head, len);
+    memcpy(&head[4], type, 4);
+
+    uint32_t c = crc(0, &head[4], 4);
+    if (len)
+        c = crc(c, data, len);
+    uint8_t tail[4];
+    put32(tail, c);
+
+    // Three writes into stdio's buffer, not one per byte
+    if (fwrite(head, 1, 8, f) != 8)
+        return false;
+    if (len && fwrite(data, 1, len, f) != len)
+        return false;
+    return fwrite(tail, 1, 4, f) == 4;
+}
+
+bool PngWriter::begin(FILE *f, uint32_t width, uint32_t height, uint8_t bit_depth,
+                      const uint8_t *palette, uint16_t colors)
+{
+    if (_open) {
+        deflateEnd(&_z);
+        _open = false;
+    }
+    if (f == nullptr || width == 0 || height == 0)
+        return false;
+    if (bit_depth != 1 && bit_depth != 2 && bit_depth != 4 && bit_depth != 8)
+        return false;
+    if (palette && (colors == 0 || colors > (1u << bit_depth)))
+        return false;
+
+    _width = width;
+    _height = height;
+    _bit_depth = bit_depth;
+    _row = 0;
+    _stride = (width * bit_depth + 7) / 8;
+    _prev.assign(_stride, 0);
+    _cur.assign(_stride, 0);
+    _filtered.assign(_stride + 1, 0);
+    _idat.clear();
+    _idat.reserve(PNG_IDAT_CHUNK_SIZE);
+
+    _z = {};
+    if (deflateInit2(&_z, PNG_DEFLATE_LEVEL, Z_DEFLATED, PNG_DEFLATE_WINDOW_BITS,
+                     PNG_DEFLATE_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK) {
+        Debug_printv("deflateInit2 failed");
+        return false;
+    }
+    _open = true;
+
+    const uint8_t sig[] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (fwrite(sig, 1, sizeof(sig), f) != sizeof(sig))
+        return false;
+
+    uint8_t ihdr[13];
+    put32(&ihdr[0], width);
+    put32(&ihdr[4], height);
+    ihdr[8] = bit_depth;
+    ihdr[9] = palette ? 3 : 0; // indexed color or greyscale
+    ihdr[10] = 0;              // deflate
+    ihdr[11] = 0;              // adaptive filtering
+    ihdr[12] = 0;              // no interlace
+    if (!chunk(f, "IHDR", ihdr, sizeof(ihdr)))
+        return false;
+
+    if (palette)
+        return chunk(f, "PLTE", palette, colors * 3);
+    return true;
+}
+
+// Pack one byte per pixel into the row's bit depth, MSB first
+static void pack(uint8_t *dest, const uint8_t *pixels, uint32_t width, uint8_t bit_depth)
+{
+    if (bit_depth == 8) {
+        memcpy(dest, pixels, width);
+        return;
+    }
+
+    uint8_t mask = (uint8_t)((1u << bit_depth) - 1);
+    uint8_t acc = 0;
+    int bits = 0;
+    for (uint32_t x = 0; x < width; x++) {
+        acc = (uint8_t)((acc << bit_depth) | (pixels[x] & mask));
+        bits += bit_depth;
+        if (bits == 8) {
+            *dest++ = acc;
+            acc = 0;
+            bits = 0;
+        }
+    }
+    if (bits)
+        *dest = (uint8_t)(acc << (8 - bits));
+}
+
+// Sum of the filtered bytes as signed values: the usual "minimum sum of
+// absolute differences" guess at which filter deflate will like best
+static uint32_t cost(const uint8_t *row, uint32_t len)
+{
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < len; i++)
+        sum += (row[i] < 128) ? row[i] : 256 - row[i];
+    return sum;
+}
+
+bool PngWriter::addRow(FILE *f, const uint8_t *pixels)
+{
+    if (!_open || _row >= _height)
+        return _open;
+
+    pack(_cur.data(), pixels, _width, _bit_depth);
+
+    const uint32_t n = _stride;
+    uint8_t *out = &_filtered[1];
+
+    // Up: a printed line repeated, or a blank one under a blank one,
+    // filters to all zeros
+    for (uint32_t i = 0; i < n; i++)
+        out[i] = (uint8_t)(_cur[i] - _prev[i]);
+    uint32_t best = (_row > 0) ? cost(out, n) : UINT32_MAX;
+    uint8_t type = 2;
+
+    uint32_t none = cost(_cur.data(), n);
+    if (none <= best) {
+        best = none;
+        type = 0;
+    }
+
+    // Sub looks one byte back: one pixel at 8 bits, a whole byte below
+    uint32_t sub = 0;
+    for (uint32_t i = 0; i < n && sub < best; i++) {
+        uint8_t d = (uint8_t)(_cur[i] - (i ? _cur[i - 1] : 0));
+        sub += (d < 128) ? d : 256 - d;
+    }
+    if (sub < best)
+        type = 1;
+
+    switch (type) {
+    case 0:
+        memcpy(out, _cur.data(), n);
+        break;
+    case 1:
+        out[0] = _cur[0];
+        for (uint32_t i = 1; i < n; i++)
+            out[i] = (uint8_t)(_cur[i] - _cur[i - 1]);
+        break;
+    default:
+        break; // already holds Up
+    }
+    _filtered[0] = type;
+
+    _prev.swap(_cur);
+    _row++;
+
+    _z.next_in = _filtered.data();
+    _z.avail_in = n + 1;
+    return deflateRow(f, (_row == _height) ? Z_FINISH : Z_NO_FLUSH);
+}
+
+// Feed deflate what's in next_in, writing an IDAT chunk each time the
+// output buffer fills
+bool PngWriter::deflateRow(FILE *f, int flush)
+{
+    uint8_t out[512];
+    int ret;
+    do {
+        _z.next_out = out;
+        _z.avail_out = sizeof(out);
+        ret = deflate(&_z, flush);
+        if (ret == Z_STREAM_ERROR)
+            return false;
+
+        size_t have = sizeof(out) - _z.avail_out;
+        size_t done = 0;
+        while (done < have) {
+            size_t take = std::min(have - done, (size_t)PNG_IDAT_CHUNK_SIZE - _idat.size());
+            _idat.insert(_idat.end(), out + done, out + done + take);
+            done += take;
+            if (_idat.size() == PNG_IDAT_CHUNK_SIZE && !flushIdat(f))
+                return false;
+        }
+    } while (_z.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+
+    if (flush == Z_FINISH)
+        return flushIdat(f);
+    return true;
+}
+
+bool PngWriter::flushIdat(FILE *f)
+{
+    if (_idat.empty())
+        return true;
+    bool ok = chunk(f, "IDAT", _idat.data(), (uint32_t)_idat.size());
+    _idat.clear();
+    return ok;
+}
+
+bool PngWriter::end(FILE *f)
+{
+    if (!_open)
+        return false;
+
+    bool ok = true;
+    if (_row < _height) {
+        std::vector<uint8_t> blank(_width, 0);
+        while (ok && _row < _height)
+            ok = addRow(f, blank.data());
+    }
+
+    deflateEnd(&_z);
+    _open = false;
+    return ok && chunk(f, "IEND", nullptr, 0);
+}
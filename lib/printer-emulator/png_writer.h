@@ -0,0 +1,79 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include <zlib.h>
+
+// Streaming PNG encoder for printer output: rows go in one at a time, are
+// filtered (None, Sub or Up - whichever leaves the most zero bytes, which
+// for dithered or text rows and repeated lines is nearly always Up) and
+// deflated with a small window, and the compressed stream leaves as
+// IDAT chunks of PNG_IDAT_CHUNK_SIZE bytes. Nothing is held but the
+// previous row, the deflate state and one chunk.
+//
+// The output file is passed to each call rather than kept: the printer
+// emulators close and reopen it between buffers.
+
+// Deflate window: 2^n bytes (1 KB reaches back three 320-pixel rows)
+#ifndef PNG_DEFLATE_WINDOW_BITS
+#define PNG_DEFLATE_WINDOW_BITS 10
+#endif
+
+// Deflate hash memory: 2^(n+9) bytes
+#ifndef PNG_DEFLATE_MEM_LEVEL
+#define PNG_DEFLATE_MEM_LEVEL   3
+#endif
+
+#ifndef PNG_DEFLATE_LEVEL
+#define PNG_DEFLATE_LEVEL       6
+#endif
+
+#ifndef PNG_IDAT_CHUNK_SIZE
+#define PNG_IDAT_CHUNK_SIZE     4096
+#endif
+
+class PngWriter
+{
+public:
+    ~PngWriter();
+
+    // Signature, IHDR and, when 'palette' (3 bytes per color) is given,
+    // PLTE. Pixels are palette indices then, grey levels otherwise; either
+    // way 1, 2, 4 or 8 bits deep, passed to addRow() one byte per pixel.
+    bool begin(FILE *f, uint32_t width, uint32_t height, uint8_t bit_depth = 8,
+               const uint8_t *palette = nullptr, uint16_t colors = 0);
+
+    // One row of 'width' pixels. Rows past 'height' are ignored.
+    bool addRow(FILE *f, const uint8_t *pixels);
+
+    // Pad any missing rows with pixel 0, flush the stream, write IEND
+    bool end(FILE *f);
+
+    bool isOpen() const { return _open; }
+    uint32_t rowsWritten() const { return _row; }
+
+    static uint32_t crc(uint32_t crc, const uint8_t *buf, size_t len);
+
+private:
+    bool chunk(FILE *f, const char type[4], const uint8_t *data, uint32_t len);
+    bool deflateRow(FILE *f, int flush);
+    bool flushIdat(FILE *f);
+
+    bool _open = false;
+    z_stream _z = {};
+    uint32_t _width = 0;
+    uint32_t _height = 0;
+    uint32_t _row = 0;
+    uint8_t _bit_depth = 8;
+    uint32_t _stride = 0;           // packed bytes per row
+
+    std::vector<uint8_t> _prev;     // previous packed row
+    std::vector<uint8_t> _cur;      // this packed row
+    std::vector<uint8_t> _filtered; // filter type byte + filtered row
+    std::vector<uint8_t> _idat;     // compressed bytes not yet written
+};
+
+#endif // PNG_WRITER_H
@@ -7,28 +7,33 @@
 #include "ReciterTabs.h"
 #include "samdebug.h"
 
-unsigned char rA, rX, rY;
 extern int debug;
 
-static unsigned char inputtemp[256]; // secure copy of input tab36096
+// Registers of the 6502 original, kept per call so that contexts can
+// convert text on different tasks at once
+typedef struct Reciter
+{
+    unsigned char A, X, Y;
+    unsigned char inputtemp[256]; // secure copy of input tab36096
+} Reciter;
 
-void Code37055(unsigned char mem59)
+void Code37055(Reciter *r, unsigned char mem59)
 {
-    rX = mem59;
-    rX--;
-    rA = inputtemp[rX];
-    rY = rA;
-    rA = tab36376[rY];
+    r->X = mem59;
+    r->X--;
+    r->A = r->inputtemp[r->X];
+    r->Y = r->A;
+    r->A = tab36376[r->Y];
     return;
 }
 
-void Code37066(unsigned char mem58)
+void Code37066(Reciter *r, unsigned char mem58)
 {
-    rX = mem58;
-    rX++;
-    rA = inputtemp[rX];
-    rY = rA;
-    rA = tab36376[rY];
+    r->X = mem58;
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    r->Y = r->A;
+    r->A = tab36376[r->Y];
 }
 
 unsigned char GetRuleByte(unsigned short mem62, unsigned char rY)
@@ -61,88 +66,91 @@ int TextToPhonemes(unsigned char *input) // Code36484
     unsigned char mem66; // position of '('
     unsigned char mem36653;
 
-    inputtemp[0] = 32;
+    Reciter reciter;
+    Reciter *r = &reciter;
+
+    r->inputtemp[0] = 32;
 
     // secure copy of input
     // because input will be overwritten by phonemes
-    rX = 1;
-    rY = 0;
+    r->X = 1;
+    r->Y = 0;
     do
     {
         //pos36499:
-        rA = input[rY] & 127;
-        if (rA >= 112)
-            rA = rA & 95;
-        else if (rA >= 96)
-            rA = rA & 79;
-
-        inputtemp[rX] = rA;
-        rX++;
-        rY++;
-    } while (rY != 255);
-
-    rX = 255;
-    inputtemp[rX] = 27;
+        r->A = input[r->Y] & 127;
+        if (r->A >= 112)
+            r->A = r->A & 95;
+        else if (r->A >= 96)
+            r->A = r->A & 79;
+
+        r->inputtemp[r->X] = r->A;
+        r->X++;
+        r->Y++;
+    } while (r->Y != 255);
+
+    r->X = 255;
+    r->inputtemp[r->X] = 27;
     mem61 = 255;
 
 pos36550:
-    rA = 255;
+    r->A = 255;
     mem56 = 255;
 
 pos36554:
     while (1)
     {
         mem61++;
-        rX = mem61;
-        rA = inputtemp[rX];
-        mem64 = rA;
-        if (rA == '[')
+        r->X = mem61;
+        r->A = r->inputtemp[r->X];
+        mem64 = r->A;
+        if (r->A == '[')
         {
             mem56++;
-            rX = mem56;
-            rA = 155;
-            input[rX] = 155;
+            r->X = mem56;
+            r->A = 155;
+            input[r->X] = 155;
             //goto pos36542;
             //          Code39771();    //Code39777();
             return 1;
         }
 
         //pos36579:
-        if (rA != '.')
+        if (r->A != '.')
             break;
-        rX++;
-        rY = inputtemp[rX];
-        rA = tab36376[rY] & 1;
-        if (rA != 0)
+        r->X++;
+        r->Y = r->inputtemp[r->X];
+        r->A = tab36376[r->Y] & 1;
+        if (r->A != 0)
             break;
         mem56++;
-        rX = mem56;
-        rA = '.';
-        input[rX] = '.';
+        r->X = mem56;
+        r->A = '.';
+        input[r->X] = '.';
     } //while
 
     //pos36607:
-    rA = mem64;
-    rY = rA;
-    rA = tab36376[rA];
-    mem57 = rA;
-    if ((rA & 2) != 0)
+    r->A = mem64;
+    r->Y = r->A;
+    r->A = tab36376[r->A];
+    mem57 = r->A;
+    if ((r->A & 2) != 0)
     {
         mem62 = 37541;
         goto pos36700;
     }
 
     //pos36630:
-    rA = mem57;
-    if (rA != 0)
+    r->A = mem57;
+    if (r->A != 0)
         goto pos36677;
-    rA = 32;
-    inputtemp[rX] = ' ';
+    r->A = 32;
+    r->inputtemp[r->X] = ' ';
     mem56++;
-    rX = mem56;
-    if (rX > 120)
+    r->X = mem56;
+    if (r->X > 120)
         goto pos36654;
-    input[rX] = rA;
+    input[r->X] = r->A;
     goto pos36554;
 
     // -----
@@ -150,9 +158,9 @@ pos36554:
     //36653 is unknown. Contains position
 
 pos36654:
-    input[rX] = 155;
-    rA = mem61;
-    mem36653 = rA;
+    input[r->X] = 155;
+    r->A = mem61;
+    mem36653 = r->A;
     //  mem29 = rA; // not used
     //  Code36538(); das ist eigentlich
     return 1;
@@ -162,16 +170,16 @@ pos36654:
     goto pos36550;
 
 pos36677:
-    rA = mem57 & 128;
-    if (rA == 0)
+    r->A = mem57 & 128;
+    if (r->A == 0)
     {
         //36683: BRK
         return 0;
     }
 
     // go to the right rules for this character.
-    rX = mem64 - 'A';
-    mem62 = tab37489[rX] | (tab37515[rX] << 8);
+    r->X = mem64 - 'A';
+    mem62 = tab37489[r->X] | (tab37515[r->X] << 8);
 
     // -------------------------------------
     // go to next rule
@@ -180,108 +188,108 @@ pos36677:
 pos36700:
 
     // find next rule
-    rY = 0;
+    r->Y = 0;
     do
     {
         mem62 += 1;
-        rA = GetRuleByte(mem62, rY);
-    } while ((rA & 128) == 0);
-    rY++;
+        r->A = GetRuleByte(mem62, r->Y);
+    } while ((r->A & 128) == 0);
+    r->Y++;
 
     //pos36720:
     // find '('
     while (1)
     {
-        rA = GetRuleByte(mem62, rY);
-        if (rA == '(')
+        r->A = GetRuleByte(mem62, r->Y);
+        if (r->A == '(')
             break;
-        rY++;
+        r->Y++;
     }
-    mem66 = rY;
+    mem66 = r->Y;
 
     //pos36732:
     // find ')'
     do
     {
-        rY++;
-        rA = GetRuleByte(mem62, rY);
-    } while (rA != ')');
-    mem65 = rY;
+        r->Y++;
+        r->A = GetRuleByte(mem62, r->Y);
+    } while (r->A != ')');
+    mem65 = r->Y;
 
     //pos36741:
     // find '='
     do
     {
-        rY++;
-        rA = GetRuleByte(mem62, rY);
-        rA = rA & 127;
-    } while (rA != '=');
-    mem64 = rY;
+        r->Y++;
+        r->A = GetRuleByte(mem62, r->Y);
+        r->A = r->A & 127;
+    } while (r->A != '=');
+    mem64 = r->Y;
 
-    rX = mem61;
-    mem60 = rX;
+    r->X = mem61;
+    mem60 = r->X;
 
     // compare the string within the bracket
-    rY = mem66;
-    rY++;
+    r->Y = mem66;
+    r->Y++;
     //pos36759:
     while (1)
     {
-        mem57 = inputtemp[rX];
-        rA = GetRuleByte(mem62, rY);
-        if (rA != mem57)
+        mem57 = r->inputtemp[r->X];
+        r->A = GetRuleByte(mem62, r->Y);
+        if (r->A != mem57)
             goto pos36700;
-        rY++;
-        if (rY == mem65)
+        r->Y++;
+        if (r->Y == mem65)
             break;
-        rX++;
-        mem60 = rX;
+        r->X++;
+        mem60 = r->X;
     }
 
     // the string in the bracket is correct
 
     //pos36787:
-    rA = mem61;
+    r->A = mem61;
     mem59 = mem61;
 
 pos36791:
     while (1)
     {
         mem66--;
-        rY = mem66;
-        rA = GetRuleByte(mem62, rY);
-        mem57 = rA;
+        r->Y = mem66;
+        r->A = GetRuleByte(mem62, r->Y);
+        mem57 = r->A;
         //36800: BPL 36805
-        if ((rA & 128) != 0)
+        if ((r->A & 128) != 0)
             goto pos37180;
-        rX = rA & 127;
-        rA = tab36376[rX] & 128;
-        if (rA == 0)
+        r->X = r->A & 127;
+        r->A = tab36376[r->X] & 128;
+        if (r->A == 0)
             break;
-        rX = mem59 - 1;
-        rA = inputtemp[rX];
-        if (rA != mem57)
+        r->X = mem59 - 1;
+        r->A = r->inputtemp[r->X];
+        if (r->A != mem57)
             goto pos36700;
-        mem59 = rX;
+        mem59 = r->X;
     }
 
     //pos36833:
-    rA = mem57;
-    if (rA == ' ')
+    r->A = mem57;
+    if (r->A == ' ')
         goto pos36895;
-    if (rA == '#')
+    if (r->A == '#')
         goto pos36910;
-    if (rA == '.')
+    if (r->A == '.')
         goto pos36920;
-    if (rA == '&')
+    if (r->A == '&')
         goto pos36935;
-    if (rA == '@')
+    if (r->A == '@')
         goto pos36967;
-    if (rA == '^')
+    if (r->A == '^')
         goto pos37004;
-    if (rA == '+')
+    if (r->A == '+')
         goto pos37019;
-    if (rA == ':')
+    if (r->A == ':')
         goto pos37040;
     //  Code42041();    //Error
     //36894: BRK
@@ -290,150 +298,150 @@ pos36791:
     // --------------
 
 pos36895:
-    Code37055(mem59);
-    rA = rA & 128;
-    if (rA != 0)
+    Code37055(r, mem59);
+    r->A = r->A & 128;
+    if (r->A != 0)
         goto pos36700;
 pos36905:
-    mem59 = rX;
+    mem59 = r->X;
     goto pos36791;
 
     // --------------
 
 pos36910:
-    Code37055(mem59);
-    rA = rA & 64;
-    if (rA != 0)
+    Code37055(r, mem59);
+    r->A = r->A & 64;
+    if (r->A != 0)
         goto pos36905;
     goto pos36700;
 
     // --------------
 
 pos36920:
-    Code37055(mem59);
-    rA = rA & 8;
-    if (rA == 0)
+    Code37055(r, mem59);
+    r->A = r->A & 8;
+    if (r->A == 0)
         goto pos36700;
 pos36930:
-    mem59 = rX;
+    mem59 = r->X;
     goto pos36791;
 
     // --------------
 
 pos36935:
-    Code37055(mem59);
-    rA = rA & 16;
-    if (rA != 0)
+    Code37055(r, mem59);
+    r->A = r->A & 16;
+    if (r->A != 0)
         goto pos36930;
-    rA = inputtemp[rX];
-    if (rA != 72)
+    r->A = r->inputtemp[r->X];
+    if (r->A != 72)
         goto pos36700;
-    rX--;
-    rA = inputtemp[rX];
-    if ((rA == 67) || (rA == 83))
+    r->X--;
+    r->A = r->inputtemp[r->X];
+    if ((r->A == 67) || (r->A == 83))
         goto pos36930;
     goto pos36700;
 
     // --------------
 
 pos36967:
-    Code37055(mem59);
-    rA = rA & 4;
-    if (rA != 0)
+    Code37055(r, mem59);
+    r->A = r->A & 4;
+    if (r->A != 0)
         goto pos36930;
-    rA = inputtemp[rX];
-    if (rA != 72)
+    r->A = r->inputtemp[r->X];
+    if (r->A != 72)
         goto pos36700;
-    if ((rA != 84) && (rA != 67) && (rA != 83))
+    if ((r->A != 84) && (r->A != 67) && (r->A != 83))
         goto pos36700;
-    mem59 = rX;
+    mem59 = r->X;
     goto pos36791;
 
     // --------------
 
 pos37004:
-    Code37055(mem59);
-    rA = rA & 32;
-    if (rA == 0)
+    Code37055(r, mem59);
+    r->A = r->A & 32;
+    if (r->A == 0)
         goto pos36700;
 
 pos37014:
-    mem59 = rX;
+    mem59 = r->X;
     goto pos36791;
 
     // --------------
 
 pos37019:
-    rX = mem59;
-    rX--;
-    rA = inputtemp[rX];
-    if ((rA == 'E') || (rA == 'I') || (rA == 'Y'))
+    r->X = mem59;
+    r->X--;
+    r->A = r->inputtemp[r->X];
+    if ((r->A == 'E') || (r->A == 'I') || (r->A == 'Y'))
         goto pos37014;
     goto pos36700;
     // --------------
 
 pos37040:
-    Code37055(mem59);
-    rA = rA & 32;
-    if (rA == 0)
+    Code37055(r, mem59);
+    r->A = r->A & 32;
+    if (r->A == 0)
         goto pos36791;
-    mem59 = rX;
+    mem59 = r->X;
     goto pos37040;
 
     //---------------------------------------
 
 pos37077:
-    rX = mem58 + 1;
-    rA = inputtemp[rX];
-    if (rA != 'E')
+    r->X = mem58 + 1;
+    r->A = r->inputtemp[r->X];
+    if (r->A != 'E')
         goto pos37157;
-    rX++;
-    rY = inputtemp[rX];
-    rX--;
-    rA = tab36376[rY] & 128;
-    if (rA == 0)
+    r->X++;
+    r->Y = r->inputtemp[r->X];
+    r->X--;
+    r->A = tab36376[r->Y] & 128;
+    if (r->A == 0)
         goto pos37108;
-    rX++;
-    rA = inputtemp[rX];
-    if (rA != 'R')
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if (r->A != 'R')
         goto pos37113;
 pos37108:
-    mem58 = rX;
+    mem58 = r->X;
     goto pos37184;
 pos37113:
-    if ((rA == 83) || (rA == 68))
+    if ((r->A == 83) || (r->A == 68))
         goto pos37108; // 'S' 'D'
-    if (rA != 76)
+    if (r->A != 76)
         goto pos37135; // 'L'
-    rX++;
-    rA = inputtemp[rX];
-    if (rA != 89)
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if (r->A != 89)
         goto pos36700;
     goto pos37108;
 
 pos37135:
-    if (rA != 70)
+    if (r->A != 70)
         goto pos36700;
-    rX++;
-    rA = inputtemp[rX];
-    if (rA != 85)
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if (r->A != 85)
         goto pos36700;
-    rX++;
-    rA = inputtemp[rX];
-    if (rA == 76)
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if (r->A == 76)
         goto pos37108;
     goto pos36700;
 
 pos37157:
-    if (rA != 73)
+    if (r->A != 73)
         goto pos36700;
-    rX++;
-    rA = inputtemp[rX];
-    if (rA != 78)
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if (r->A != 78)
         goto pos36700;
-    rX++;
-    rA = inputtemp[rX];
-    if (rA == 71)
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if (r->A == 71)
         goto pos37108;
     //pos37177:
     goto pos36700;
@@ -442,49 +450,49 @@ pos37157:
 
 pos37180:
 
-    rA = mem60;
-    mem58 = rA;
+    r->A = mem60;
+    mem58 = r->A;
 
 pos37184:
-    rY = mem65 + 1;
+    r->Y = mem65 + 1;
 
     //37187: CPY 64
     //  if(? != 0) goto pos37194;
-    if (rY == mem64)
+    if (r->Y == mem64)
         goto pos37455;
-    mem65 = rY;
+    mem65 = r->Y;
     //37196: LDA (62),y
-    rA = GetRuleByte(mem62, rY);
-    mem57 = rA;
-    rX = rA;
-    rA = tab36376[rX] & 128;
-    if (rA == 0)
+    r->A = GetRuleByte(mem62, r->Y);
+    mem57 = r->A;
+    r->X = r->A;
+    r->A = tab36376[r->X] & 128;
+    if (r->A == 0)
         goto pos37226;
-    rX = mem58 + 1;
-    rA = inputtemp[rX];
-    if (rA != mem57)
+    r->X = mem58 + 1;
+    r->A = r->inputtemp[r->X];
+    if (r->A != mem57)
         goto pos36700;
-    mem58 = rX;
+    mem58 = r->X;
     goto pos37184;
 pos37226:
-    rA = mem57;
-    if (rA == 32)
+    r->A = mem57;
+    if (r->A == 32)
         goto pos37295; // ' '
-    if (rA == 35)
+    if (r->A == 35)
         goto pos37310; // '#'
-    if (rA == 46)
+    if (r->A == 46)
         goto pos37320; // '.'
-    if (rA == 38)
+    if (r->A == 38)
         goto pos37335; // '&'
-    if (rA == 64)
+    if (r->A == 64)
         goto pos37367; // ''
-    if (rA == 94)
+    if (r->A == 94)
         goto pos37404; // ''
-    if (rA == 43)
+    if (r->A == 43)
         goto pos37419; // '+'
-    if (rA == 58)
+    if (r->A == 58)
         goto pos37440; // ':'
-    if (rA == 37)
+    if (r->A == 37)
         goto pos37077; // '%'
     //pos37291:
     //  Code42041(); //Error
@@ -493,84 +501,84 @@ pos37226:
 
     // --------------
 pos37295:
-    Code37066(mem58);
-    rA = rA & 128;
-    if (rA != 0)
+    Code37066(r, mem58);
+    r->A = r->A & 128;
+    if (r->A != 0)
         goto pos36700;
 pos37305:
-    mem58 = rX;
+    mem58 = r->X;
     goto pos37184;
 
     // --------------
 
 pos37310:
-    Code37066(mem58);
-    rA = rA & 64;
-    if (rA != 0)
+    Code37066(r, mem58);
+    r->A = r->A & 64;
+    if (r->A != 0)
         goto pos37305;
     goto pos36700;
 
     // --------------
 
 pos37320:
-    Code37066(mem58);
-    rA = rA & 8;
-    if (rA == 0)
+    Code37066(r, mem58);
+    r->A = r->A & 8;
+    if (r->A == 0)
         goto pos36700;
 
 pos37330:
-    mem58 = rX;
+    mem58 = r->X;
     goto pos37184;
 
     // --------------
 
 pos37335:
-    Code37066(mem58);
-    rA = rA & 16;
-    if (rA != 0)
+    Code37066(r, mem58);
+    r->A = r->A & 16;
+    if (r->A != 0)
         goto pos37330;
-    rA = inputtemp[rX];
-    if (rA != 72)
+    r->A = r->inputtemp[r->X];
+    if (r->A != 72)
         goto pos36700;
-    rX++;
-    rA = inputtemp[rX];
-    if ((rA == 67) || (rA == 83))
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if ((r->A == 67) || (r->A == 83))
         goto pos37330;
     goto pos36700;
 
     // --------------
 
 pos37367:
-    Code37066(mem58);
-    rA = rA & 4;
-    if (rA != 0)
+    Code37066(r, mem58);
+    r->A = r->A & 4;
+    if (r->A != 0)
         goto pos37330;
-    rA = inputtemp[rX];
-    if (rA != 72)
+    r->A = r->inputtemp[r->X];
+    if (r->A != 72)
         goto pos36700;
-    if ((rA != 84) && (rA != 67) && (rA != 83))
+    if ((r->A != 84) && (r->A != 67) && (r->A != 83))
         goto pos36700;
-    mem58 = rX;
+    mem58 = r->X;
     goto pos37184;
 
     // --------------
 
 pos37404:
-    Code37066(mem58);
-    rA = rA & 32;
-    if (rA == 0)
+    Code37066(r, mem58);
+    r->A = r->A & 32;
+    if (r->A == 0)
         goto pos36700;
 pos37414:
-    mem58 = rX;
+    mem58 = r->X;
     goto pos37184;
 
     // --------------
 
 pos37419:
-    rX = mem58;
-    rX++;
-    rA = inputtemp[rX];
-    if ((rA == 69) || (rA == 73) || (rA == 89))
+    r->X = mem58;
+    r->X++;
+    r->A = r->inputtemp[r->X];
+    if ((r->A == 69) || (r->A == 73) || (r->A == 89))
         goto pos37414;
     goto pos36700;
 
@@ -578,14 +586,14 @@ pos37419:
 
 pos37440:
 
-    Code37066(mem58);
-    rA = rA & 32;
-    if (rA == 0)
+    Code37066(r, mem58);
+    r->A = r->A & 32;
+    if (r->A == 0)
         goto pos37184;
-    mem58 = rX;
+    mem58 = r->X;
     goto pos37440;
 pos37455:
-    rY = mem64;
+    r->Y = mem64;
     mem61 = mem60;
 
     if (debug)
@@ -593,14 +601,14 @@ pos37455:
 
 pos37461:
     //37461: LDA (62),y
-    rA = GetRuleByte(mem62, rY);
-    mem57 = rA;
-    rA = rA & 127;
-    if (rA != '=')
+    r->A = GetRuleByte(mem62, r->Y);
+    mem57 = r->A;
+    r->A = r->A & 127;
+    if (r->A != '=')
     {
         mem56++;
-        rX = mem56;
-        input[rX] = rA;
+        r->X = mem56;
+        input[r->X] = r->A;
     }
 
     //37478: BIT 57
@@ -609,6 +617,6 @@ pos37461:
         goto pos37485; //???
     goto pos36554;
 pos37485:
-    rY++;
+    r->Y++;
     goto pos37461;
 }
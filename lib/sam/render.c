@@ -9,48 +9,11 @@
 
 extern int debug;
 
-unsigned char wait1 = 7;
-unsigned char wait2 = 6;
-
-extern unsigned char A, X, Y;
-extern unsigned char mem44;
-extern unsigned char mem47;
-extern unsigned char mem49;
-extern unsigned char mem39;
-extern unsigned char mem50;
-extern unsigned char mem51;
-extern unsigned char mem53;
-extern unsigned char mem56;
-
-extern unsigned char speed;
-extern unsigned char pitch;
-extern int singmode;
-
-extern unsigned char phonemeIndexOutput[60];  //tab47296
-extern unsigned char stressOutput[60];        //tab47365
-extern unsigned char phonemeLengthOutput[60]; //tab47416
-
-unsigned char pitches[256]; // tab43008
-
-unsigned char frequency1[256];
-unsigned char frequency2[256];
-unsigned char frequency3[256];
-
-unsigned char amplitude1[256];
-unsigned char amplitude2[256];
-unsigned char amplitude3[256];
-
-unsigned char sampledConsonantFlag[256]; // tab44800
-
-void AddInflection(unsigned char mem48, unsigned char phase1);
-unsigned char trans(unsigned char mem39212, unsigned char mem39213);
-
-// contains the final soundbuffer
-extern int bufferpos;
-extern char *buffer;
+void AddInflection(SamContext *sam, unsigned char mem48, unsigned char phase1);
+unsigned char trans(SamContext *sam, unsigned char mem39212, unsigned char mem39213);
 
 //timetable for more accurate c64 simulation
-int timetable[5][5] =
+const int timetable[5][5] =
     {
         {162, 167, 167, 127, 128},
         {226, 60, 60, 0, 0},
@@ -58,24 +21,25 @@ int timetable[5][5] =
         {200, 0, 0, 54, 55},
         {199, 0, 0, 54, 54}};
 
-static unsigned oldtimetableindex = 0;
-void Output8BitAry(int index, unsigned char ary[5])
+// The samples go to the context's ring; SamRead() takes them from there
+// once bufferpos has moved past them.
+void Output8BitAry(SamContext *sam, int index, unsigned char ary[5])
 {
     // printf("Output8BitAry\r\n");
     int k;
-    bufferpos += timetable[oldtimetableindex][index];
-    oldtimetableindex = index;
+    sam->bufferpos += timetable[sam->oldtimetableindex][index];
+    sam->oldtimetableindex = index;
     // write a little bit in advance
     for (k = 0; k < 5; k++)
     {
         // printf("%d %d\r\n", bufferpos,k);
-        buffer[bufferpos / 50 + k] = ary[k];
+        sam->ring[(sam->bufferpos / 50 + k) & (SAM_RING_SIZE - 1)] = ary[k];
     }
 }
-void Output8Bit(int index, unsigned char A)
+void Output8Bit(SamContext *sam, int index, unsigned char A)
 {
     unsigned char ary[5] = {A, A, A, A, A};
-    Output8BitAry(index, ary);
+    Output8BitAry(sam, index, ary);
 }
 
 //written by me because of different table positions.
@@ -87,54 +51,54 @@ void Output8Bit(int index, unsigned char A)
 // 172=amplitude1
 // 173=amplitude2
 // 174=amplitude3
-unsigned char Read(unsigned char p, unsigned char Y)
+unsigned char Read(SamContext *sam, unsigned char p, unsigned char Y)
 {
     switch (p)
     {
     case 168:
-        return pitches[Y];
+        return sam->pitches[Y];
     case 169:
-        return frequency1[Y];
+        return sam->frequency1[Y];
     case 170:
-        return frequency2[Y];
+        return sam->frequency2[Y];
     case 171:
-        return frequency3[Y];
+        return sam->frequency3[Y];
     case 172:
-        return amplitude1[Y];
+        return sam->amplitude1[Y];
     case 173:
-        return amplitude2[Y];
+        return sam->amplitude2[Y];
     case 174:
-        return amplitude3[Y];
+        return sam->amplitude3[Y];
     }
     printf("Error reading to tables");
     return 0;
 }
 
-void Write(unsigned char p, unsigned char Y, unsigned char value)
+void Write(SamContext *sam, unsigned char p, unsigned char Y, unsigned char value)
 {
 
     switch (p)
     {
     case 168:
-        pitches[Y] = value;
+        sam->pitches[Y] = value;
         return;
     case 169:
-        frequency1[Y] = value;
+        sam->frequency1[Y] = value;
         return;
     case 170:
-        frequency2[Y] = value;
+        sam->frequency2[Y] = value;
         return;
     case 171:
-        frequency3[Y] = value;
+        sam->frequency3[Y] = value;
         return;
     case 172:
-        amplitude1[Y] = value;
+        sam->amplitude1[Y] = value;
         return;
     case 173:
-        amplitude2[Y] = value;
+        sam->amplitude2[Y] = value;
         return;
     case 174:
-        amplitude3[Y] = value;
+        sam->amplitude3[Y] = value;
         return;
     }
     printf("Error writing to tables\r\n");
@@ -195,19 +159,19 @@ void Write(unsigned char p, unsigned char Y, unsigned char value)
 // For voices samples, samples are interleaved between voiced output.
 
 // Code48227()
-void RenderSample(unsigned char *mem66)
+void RenderSample(SamContext *sam, unsigned char *mem66)
 {
     int tempA;
     // current phoneme's index
-    mem49 = Y;
+    sam->mem49 = sam->Y;
 
     // mask low three bits and subtract 1 get value to
     // convert 0 bits on unvoiced samples.
-    A = mem39 & 7;
-    X = A - 1;
+    sam->A = sam->mem39 & 7;
+    sam->X = sam->A - 1;
 
     // store the result
-    mem56 = X;
+    sam->mem56 = sam->X;
 
     // determine which offset to use from table { 0x18, 0x1A, 0x17, 0x17, 0x17 }
     // T, S, Z                0          0x18
@@ -217,73 +181,73 @@ void RenderSample(unsigned char *mem66)
     // /X                     4          0x17
 
     // get value from the table
-    mem53 = tab48426[X];
-    mem47 = X; //46016+mem[56]*256
+    sam->mem53 = tab48426[sam->X];
+    sam->mem47 = sam->X; //46016+mem[56]*256
 
     // voiced sample?
-    A = mem39 & 248;
-    if (A == 0)
+    sam->A = sam->mem39 & 248;
+    if (sam->A == 0)
     {
         // voiced phoneme: Z*, ZH, V*, DH
-        Y = mem49;
-        A = pitches[mem49] >> 4;
+        sam->Y = sam->mem49;
+        sam->A = sam->pitches[sam->mem49] >> 4;
 
         // jump to voiced portion
         goto pos48315;
     }
 
-    Y = A ^ 255;
+    sam->Y = sam->A ^ 255;
 pos48274:
 
     // step through the 8 bits in the sample
-    mem56 = 8;
+    sam->mem56 = 8;
 
     // get the next sample from the table
     // mem47*256 = offset to start of samples
-    A = sampleTable[mem47 * 256 + Y];
+    sam->A = sampleTable[sam->mem47 * 256 + sam->Y];
 pos48280:
 
     // left shift to get the high bit
-    tempA = A;
-    A = A << 1;
+    tempA = sam->A;
+    sam->A = sam->A << 1;
     //48281: BCC 48290
 
     // bit not set?
     if ((tempA & 128) == 0)
     {
         // convert the bit to value from table
-        X = mem53;
+        sam->X = sam->mem53;
         //mem[54296] = X;
         // output the byte
-        Output8Bit(1, (X & 0x0f) * 16);
+        Output8Bit(sam, 1, (sam->X & 0x0f) * 16);
         // if X != 0, exit loop
-        if (X != 0)
+        if (sam->X != 0)
             goto pos48296;
     }
 
     // output a 5 for the on bit
-    Output8Bit(2, 5 * 16);
+    Output8Bit(sam, 2, 5 * 16);
 
     //48295: NOP
 pos48296:
 
-    X = 0;
+    sam->X = 0;
 
     // decrement counter
-    mem56--;
+    sam->mem56--;
 
     // if not done, jump to top of loop
-    if (mem56 != 0)
+    if (sam->mem56 != 0)
         goto pos48280;
 
     // increment position
-    Y++;
-    if (Y != 0)
+    sam->Y++;
+    if (sam->Y != 0)
         goto pos48274;
 
     // restore values and return
-    mem44 = 1;
-    Y = mem49;
+    sam->mem44 = 1;
+    sam->Y = sam->mem49;
     return;
 
     unsigned char phase1;
@@ -292,19 +256,19 @@ pos48315:
     // handle voiced samples here
 
     // number of samples?
-    phase1 = A ^ 255;
+    phase1 = sam->A ^ 255;
 
-    Y = *mem66;
+    sam->Y = *mem66;
     do
     {
         //pos48321:
 
         // shift through all 8 bits
-        mem56 = 8;
+        sam->mem56 = 8;
         //A = Read(mem47, Y);
 
         // fetch value from table
-        A = sampleTable[mem47 * 256 + Y];
+        sam->A = sampleTable[sam->mem47 * 256 + sam->Y];
 
         // loop 8 times
         //pos48327:
@@ -314,27 +278,27 @@ pos48315:
             //48328: BCC 48337
 
             // left shift and check high bit
-            tempA = A;
-            A = A << 1;
+            tempA = sam->A;
+            sam->A = sam->A << 1;
             if ((tempA & 128) != 0)
             {
                 // if bit set, output 26
-                X = 26;
-                Output8Bit(3, (X & 0xf) * 16);
+                sam->X = 26;
+                Output8Bit(sam, 3, (sam->X & 0xf) * 16);
             }
             else
             {
                 //timetable 4
                 // bit is not set, output a 6
-                X = 6;
-                Output8Bit(4, (X & 0xf) * 16);
+                sam->X = 6;
+                Output8Bit(sam, 4, (sam->X & 0xf) * 16);
             }
 
-            mem56--;
-        } while (mem56 != 0);
+            sam->mem56--;
+        } while (sam->mem56 != 0);
 
         // move ahead in the table
-        Y++;
+        sam->Y++;
 
         // continue until counter done
         phase1++;
@@ -343,10 +307,10 @@ pos48315:
     //  if (phase1 != 0) goto pos48321;
 
     // restore values and return
-    A = 1;
-    mem44 = 1;
-    *mem66 = Y;
-    Y = mem49;
+    sam->A = 1;
+    sam->mem44 = 1;
+    *mem66 = sam->Y;
+    sam->Y = sam->mem49;
     return;
 }
 
@@ -365,7 +329,7 @@ pos48315:
 // 4. Render the each frame.
 
 //void Code47574()
-void Render()
+int RenderStart(SamContext *sam)
 {
     unsigned char phase1 = 0; //mem43
     unsigned char phase2 = 0;
@@ -376,12 +340,12 @@ void Render()
     unsigned char speedcounter = 0; //mem45
     unsigned char mem48 = 0;
     int i;
-    if (phonemeIndexOutput[0] == 255)
-        return; //exit if no data
+    if (sam->phonemeIndexOutput[0] == 255)
+        return 0; //exit if no data
 
-    A = 0;
-    X = 0;
-    mem44 = 0;
+    sam->A = 0;
+    sam->X = 0;
+    sam->mem44 = 0;
 
     // printf("Render 1\r\n");
 
@@ -399,67 +363,67 @@ void Render()
         // printf("Render 2\r\n");
 
         // get the index
-        Y = mem44;
+        sam->Y = sam->mem44;
         // get the phoneme at the index
-        A = phonemeIndexOutput[mem44];
-        mem56 = A;
+        sam->A = sam->phonemeIndexOutput[sam->mem44];
+        sam->mem56 = sam->A;
 
         // if terminal phoneme, exit the loop
-        if (A == 255)
+        if (sam->A == 255)
             break;
 
         // period phoneme *.
-        if (A == 1)
+        if (sam->A == 1)
         {
 
             // printf("Render 3\r\n");
 
             // add rising inflection
-            A = 1;
+            sam->A = 1;
             mem48 = 1;
             //goto pos48376;
-            AddInflection(mem48, phase1);
+            AddInflection(sam, mem48, phase1);
         }
         /*
     if (A == 2) goto pos48372;
     */
 
         // question mark phoneme?
-        if (A == 2)
+        if (sam->A == 2)
         {
             // printf("Render 4\r\n");
             // create falling inflection
             mem48 = 255;
-            AddInflection(mem48, phase1);
+            AddInflection(sam, mem48, phase1);
         }
         //  pos47615:
 
         // printf("Render 5\r\n");
 
         // get the stress amount (more stress = higher pitch)
-        phase1 = tab47492[stressOutput[Y] + 1];
+        phase1 = tab47492[sam->stressOutput[sam->Y] + 1];
 
         // get number of frames to write
-        phase2 = phonemeLengthOutput[Y];
-        Y = mem56;
+        phase2 = sam->phonemeLengthOutput[sam->Y];
+        sam->Y = sam->mem56;
 
         // copy from the source to the frames list
         do
         {
             // printf("Render 6\r\n");
-            frequency1[X] = freq1data[Y];                       // F1 frequency
-            frequency2[X] = freq2data[Y];                       // F2 frequency
-            frequency3[X] = freq3data[Y];                       // F3 frequency
-            amplitude1[X] = ampl1data[Y];                       // F1 amplitude
-            amplitude2[X] = ampl2data[Y];                       // F2 amplitude
-            amplitude3[X] = ampl3data[Y];                       // F3 amplitude
-            sampledConsonantFlag[X] = sampledConsonantFlags[Y]; // phoneme data for sampled consonants
-            pitches[X] = pitch + phase1;                        // pitch
-            X++;
+            sam->frequency1[sam->X] = sam->freq1data[sam->Y];                       // F1 frequency
+            sam->frequency2[sam->X] = sam->freq2data[sam->Y];                       // F2 frequency
+            sam->frequency3[sam->X] = freq3data[sam->Y];                       // F3 frequency
+            sam->amplitude1[sam->X] = ampl1data[sam->Y];                       // F1 amplitude
+            sam->amplitude2[sam->X] = ampl2data[sam->Y];                       // F2 amplitude
+            sam->amplitude3[sam->X] = ampl3data[sam->Y];                       // F3 amplitude
+            sam->sampledConsonantFlag[sam->X] = sampledConsonantFlags[sam->Y]; // phoneme data for sampled consonants
+            sam->pitches[sam->X] = sam->pitch + phase1;                        // pitch
+            sam->X++;
             phase2--;
         } while (phase2 != 0);
-        mem44++;
-    } while (mem44 != 0);
+        sam->mem44++;
+    } while (sam->mem44 != 0);
     // -------------------
     //pos47694:
 
@@ -592,63 +556,63 @@ void Render()
     //   241     2    10     2    65     1    96    59 * <-- OutBlendFrames = 1
     //   241     0     6     0    73     0    99    61
 
-    A = 0;
-    mem44 = 0;
-    mem49 = 0; // mem49 starts at as 0
-    X = 0;
+    sam->A = 0;
+    sam->mem44 = 0;
+    sam->mem49 = 0; // mem49 starts at as 0
+    sam->X = 0;
     while (1) //while No. 1
     {
 
         // get the current and following phoneme
-        Y = phonemeIndexOutput[X];
-        A = phonemeIndexOutput[X + 1];
-        X++;
+        sam->Y = sam->phonemeIndexOutput[sam->X];
+        sam->A = sam->phonemeIndexOutput[sam->X + 1];
+        sam->X++;
 
         // exit loop at end token
-        if (A == 255)
+        if (sam->A == 255)
             break; //goto pos47970;
 
         // get the ranking of each phoneme
-        X = A;
-        mem56 = blendRank[A];
-        A = blendRank[Y];
+        sam->X = sam->A;
+        sam->mem56 = blendRank[sam->A];
+        sam->A = blendRank[sam->Y];
 
         // compare the rank - lower rank value is stronger
-        if (A == mem56)
+        if (sam->A == sam->mem56)
         {
             // same rank, so use out blend lengths from each phoneme
-            phase1 = outBlendLength[Y];
-            phase2 = outBlendLength[X];
+            phase1 = outBlendLength[sam->Y];
+            phase2 = outBlendLength[sam->X];
         }
-        else if (A < mem56)
+        else if (sam->A < sam->mem56)
         {
             // first phoneme is stronger, so us it's blend lengths
-            phase1 = inBlendLength[X];
-            phase2 = outBlendLength[X];
+            phase1 = inBlendLength[sam->X];
+            phase2 = outBlendLength[sam->X];
         }
         else
         {
             // second phoneme is stronger, so use it's blend lengths
             // note the out/in are swapped
-            phase1 = outBlendLength[Y];
-            phase2 = inBlendLength[Y];
+            phase1 = outBlendLength[sam->Y];
+            phase2 = inBlendLength[sam->Y];
         }
 
-        Y = mem44;
-        A = mem49 + phonemeLengthOutput[mem44]; // A is mem49 + length
-        mem49 = A;                              // mem49 now holds length + position
-        A = A + phase2;                         //Maybe Problem because of carry flag
+        sam->Y = sam->mem44;
+        sam->A = sam->mem49 + sam->phonemeLengthOutput[sam->mem44]; // A is mem49 + length
+        sam->mem49 = sam->A;                              // mem49 now holds length + position
+        sam->A = sam->A + phase2;                         //Maybe Problem because of carry flag
 
         //47776: ADC 42
-        speedcounter = A;
-        mem47 = 168;
-        phase3 = mem49 - phase1; // what is mem49
-        A = phase1 + phase2;     // total transition?
-        mem38 = A;
-
-        X = A;
-        X -= 2;
-        if ((X & 128) == 0)
+        speedcounter = sam->A;
+        sam->mem47 = 168;
+        phase3 = sam->mem49 - phase1; // what is mem49
+        sam->A = phase1 + phase2;     // total transition?
+        mem38 = sam->A;
+
+        sam->X = sam->A;
+        sam->X -= 2;
+        if ((sam->X & 128) == 0)
             do //while No. 2
             {
                 //pos47810:
@@ -664,7 +628,7 @@ void Render()
 
                 mem40 = mem38;
 
-                if (mem47 == 168) // pitch
+                if (sam->mem47 == 168) // pitch
                 {
 
                     // unlike the other values, the pitches[] interpolates from
@@ -673,64 +637,64 @@ void Render()
 
                     unsigned char mem36, mem37;
                     // half the width of the current phoneme
-                    mem36 = phonemeLengthOutput[mem44] >> 1;
+                    mem36 = sam->phonemeLengthOutput[sam->mem44] >> 1;
                     // half the width of the next phoneme
-                    mem37 = phonemeLengthOutput[mem44 + 1] >> 1;
+                    mem37 = sam->phonemeLengthOutput[sam->mem44 + 1] >> 1;
                     // sum the values
                     mem40 = mem36 + mem37;  // length of both halves
-                    mem37 += mem49;         // center of next phoneme
-                    mem36 = mem49 - mem36;  // center index of current phoneme
-                    A = Read(mem47, mem37); // value at center of next phoneme - end interpolation value
+                    mem37 += sam->mem49;         // center of next phoneme
+                    mem36 = sam->mem49 - mem36;  // center index of current phoneme
+                    sam->A = Read(sam, sam->mem47, mem37); // value at center of next phoneme - end interpolation value
                     //A = mem[address];
 
-                    Y = mem36;                      // start index of interpolation
-                    mem53 = A - Read(mem47, mem36); // value to center of current phoneme
+                    sam->Y = mem36;                      // start index of interpolation
+                    sam->mem53 = sam->A - Read(sam, sam->mem47, mem36); // value to center of current phoneme
                 }
                 else
                 {
                     // value to interpolate to
-                    A = Read(mem47, speedcounter);
+                    sam->A = Read(sam, sam->mem47, speedcounter);
                     // position to start interpolation from
-                    Y = phase3;
+                    sam->Y = phase3;
                     // value to interpolate from
-                    mem53 = A - Read(mem47, phase3);
+                    sam->mem53 = sam->A - Read(sam, sam->mem47, phase3);
                 }
 
                 //Code47503(mem40);
                 // ML : Code47503 is division with remainder, and mem50 gets the sign
 
                 // calculate change per frame
-                signed char m53 = (signed char)mem53;
-                mem50 = mem53 & 128;
+                signed char m53 = (signed char)sam->mem53;
+                sam->mem50 = sam->mem53 & 128;
                 unsigned char m53abs = abs(m53);
-                mem51 = m53abs % mem40; //abs((char)m53) % mem40;
-                mem53 = (unsigned char)((signed char)(m53) / mem40);
+                sam->mem51 = m53abs % mem40; //abs((char)m53) % mem40;
+                sam->mem53 = (unsigned char)((signed char)(m53) / mem40);
 
                 // interpolation range
-                X = mem40;  // number of frames to interpolate over
-                Y = phase3; // starting frame
+                sam->X = mem40;  // number of frames to interpolate over
+                sam->Y = phase3; // starting frame
 
                 // linearly interpolate values
 
-                mem56 = 0;
+                sam->mem56 = 0;
                 //47907: CLC
                 //pos47908:
                 while (1) //while No. 3
                 {
-                    A = Read(mem47, Y) + mem53; //carry alway cleared
+                    sam->A = Read(sam, sam->mem47, sam->Y) + sam->mem53; //carry alway cleared
 
-                    mem48 = A;
-                    Y++;
-                    X--;
-                    if (X == 0)
+                    mem48 = sam->A;
+                    sam->Y++;
+                    sam->X--;
+                    if (sam->X == 0)
                         break;
 
-                    mem56 += mem51;
-                    if (mem56 >= mem40) //???
+                    sam->mem56 += sam->mem51;
+                    if (sam->mem56 >= mem40) //???
                     {
-                        mem56 -= mem40; //carry? is set
+                        sam->mem56 -= mem40; //carry? is set
                         //if ((mem56 & 128)==0)
-                        if ((mem50 & 128) == 0)
+                        if ((sam->mem50 & 128) == 0)
                         {
                             //47935: BIT 50
                             //47937: BMI 47943
@@ -741,23 +705,23 @@ void Render()
                             mem48--;
                     }
                     //pos47945:
-                    Write(mem47, Y, mem48);
+                    Write(sam, sam->mem47, sam->Y, mem48);
                 } //while No. 3
 
                 //pos47952:
-                mem47++;
+                sam->mem47++;
                 //if (mem47 != 175) goto pos47810;
-            } while (mem47 != 175); //while No. 2
+            } while (sam->mem47 != 175); //while No. 2
         //pos47963:
-        mem44++;
-        X = mem44;
+        sam->mem44++;
+        sam->X = sam->mem44;
     } //while No. 1
 
     //goto pos47701;
     //pos47970:
 
     // add the length of this phoneme
-    mem48 = mem49 + phonemeLengthOutput[mem44];
+    mem48 = sam->mem49 + sam->phonemeLengthOutput[sam->mem44];
 
     // ASSIGN PITCH CONTOUR
     //
@@ -766,21 +730,21 @@ void Render()
     // pitch level (monotone).
 
     // don't adjust pitch if in sing mode
-    if (!singmode)
+    if (!sam->singmode)
     {
         // iterate through the buffer
         for (i = 0; i < 256; i++)
         {
             // subtract half the frequency of the formant 1.
             // this adds variety to the voice
-            pitches[i] -= (frequency1[i] >> 1);
+            sam->pitches[i] -= (sam->frequency1[i] >> 1);
         }
     }
 
     phase1 = 0;
     phase2 = 0;
     phase3 = 0;
-    mem49 = 0;
+    sam->mem49 = 0;
     speedcounter = 72; //sam standard speed
 
     // RESCALE AMPLITUDE
@@ -791,22 +755,22 @@ void Render()
     //amplitude rescaling
     for (i = 255; i >= 0; i--)
     {
-        amplitude1[i] = amplitudeRescale[amplitude1[i]];
-        amplitude2[i] = amplitudeRescale[amplitude2[i]];
-        amplitude3[i] = amplitudeRescale[amplitude3[i]];
+        sam->amplitude1[i] = amplitudeRescale[sam->amplitude1[i]];
+        sam->amplitude2[i] = amplitudeRescale[sam->amplitude2[i]];
+        sam->amplitude3[i] = amplitudeRescale[sam->amplitude3[i]];
     }
 
-    Y = 0;
-    A = pitches[0];
-    mem44 = A;
-    X = A;
-    mem38 = A - (A >> 2); // 3/4*A ???
+    sam->Y = 0;
+    sam->A = sam->pitches[0];
+    sam->mem44 = sam->A;
+    sam->X = sam->A;
+    mem38 = sam->A - (sam->A >> 2); // 3/4*A ???
 
     // printf("Render 7\r\n");
 
     if (debug)
     {
-        PrintOutput(sampledConsonantFlag, frequency1, frequency2, frequency3, amplitude1, amplitude2, amplitude3, pitches);
+        PrintOutput(sam->sampledConsonantFlag, sam->frequency1, sam->frequency2, sam->frequency3, sam->amplitude1, sam->amplitude2, sam->amplitude3, sam->pitches);
     }
 
     // printf("Render 8\r\n");
@@ -820,237 +784,195 @@ void Render()
     // To simulate them being driven by the glottal pulse, the waveforms are
     // reset at the beginning of each glottal pulse.
 
-    //finally the loop for sound output
-    //pos48078:
-    while (1)
-    {
-        // printf("Render 9\r\n");
-
-        // get the sampled information on the phoneme
-        A = sampledConsonantFlag[Y];
-        mem39 = A;
-
-        // unvoiced sampled phoneme?
-        A = A & 248;
-        if (A != 0)
-        {
-            // printf("Render 10\r\n");
-
-            // render the sample for the phoneme
-            RenderSample(&mem66);
-
-            // skip ahead two in the phoneme buffer
-            Y += 2;
-            mem48 -= 2;
-        }
-        else
-        {
-            // printf("Render 11\r\n");
-
-            // simulate the glottal pulse and formants
-            unsigned char ary[5];
-            unsigned int p1 = phase1 * 256; // Fixed point integers because we need to divide later on
-            unsigned int p2 = phase2 * 256;
-            unsigned int p3 = phase3 * 256;
-            int k;
-            for (k = 0; k < 5; k++)
-            {
-                signed char sp1 = (signed char)sinus[0xff & (p1 >> 8)];
-                signed char sp2 = (signed char)sinus[0xff & (p2 >> 8)];
-                signed char rp3 = (signed char)rectangle[0xff & (p3 >> 8)];
-                signed int sin1 = sp1 * ((unsigned char)amplitude1[Y] & 0x0f);
-                signed int sin2 = sp2 * ((unsigned char)amplitude2[Y] & 0x0f);
-                signed int rect = rp3 * ((unsigned char)amplitude3[Y] & 0x0f);
-                signed int mux = sin1 + sin2 + rect;
-                mux /= 32;
-                mux += 128; // Go from signed to unsigned amplitude
-                ary[k] = mux;
-                p1 += frequency1[Y] * 256 / 4; // Compromise, this becomes a shift and works well
-                p2 += frequency2[Y] * 256 / 4;
-                p3 += frequency3[Y] * 256 / 4;
-            }
+    // the loop for sound output below runs a pass at a time
+    sam->phase1 = phase1;
+    sam->phase2 = phase2;
+    sam->phase3 = phase3;
+    sam->mem38 = mem38;
+    sam->mem48 = mem48;
+    sam->mem66 = mem66;
+    sam->speedcounter = speedcounter;
+    return 1;
+}
 
-            // printf("Render 12\r\n");
+// One pass of the sound output loop: a glottal pulse step, or a sampled
+// phoneme. Returns 0 once the last frame has been rendered.
+//pos48078:
+int RenderStep(SamContext *sam)
+{
+    // printf("Render 9\r\n");
 
-            // output the accumulated value
-            Output8BitAry(0, ary);
+    // get the sampled information on the phoneme
+    sam->A = sam->sampledConsonantFlag[sam->Y];
+    sam->mem39 = sam->A;
 
-            // printf("Render 13\r\n");
+    // unvoiced sampled phoneme?
+    sam->A = sam->A & 248;
+    if (sam->A != 0)
+    {
+        // printf("Render 10\r\n");
 
-            speedcounter--;
-            if (speedcounter != 0)
-                goto pos48155;
-            Y++; //go to next amplitude
+        // render the sample for the phoneme
+        RenderSample(sam, &sam->mem66);
 
-            // decrement the frame count
-            mem48--;
+        // skip ahead two in the phoneme buffer
+        sam->Y += 2;
+        sam->mem48 -= 2;
+    }
+    else
+    {
+        // printf("Render 11\r\n");
+
+        // simulate the glottal pulse and formants
+        unsigned char ary[5];
+        unsigned int p1 = sam->phase1 * 256; // Fixed point integers because we need to divide later on
+        unsigned int p2 = sam->phase2 * 256;
+        unsigned int p3 = sam->phase3 * 256;
+        int k;
+        for (k = 0; k < 5; k++)
+        {
+            signed char sp1 = (signed char)sinus[0xff & (p1 >> 8)];
+            signed char sp2 = (signed char)sinus[0xff & (p2 >> 8)];
+            signed char rp3 = (signed char)rectangle[0xff & (p3 >> 8)];
+            signed int sin1 = sp1 * ((unsigned char)sam->amplitude1[sam->Y] & 0x0f);
+            signed int sin2 = sp2 * ((unsigned char)sam->amplitude2[sam->Y] & 0x0f);
+            signed int rect = rp3 * ((unsigned char)sam->amplitude3[sam->Y] & 0x0f);
+            signed int mux = sin1 + sin2 + rect;
+            mux /= 32;
+            mux += 128; // Go from signed to unsigned amplitude
+            ary[k] = mux;
+            p1 += sam->frequency1[sam->Y] * 256 / 4; // Compromise, this becomes a shift and works well
+            p2 += sam->frequency2[sam->Y] * 256 / 4;
+            p3 += sam->frequency3[sam->Y] * 256 / 4;
         }
 
-        // if the frame count is zero, exit the loop
-        if (mem48 == 0)
-            return;
-        speedcounter = speed;
-    pos48155:
+        // printf("Render 12\r\n");
 
-        // printf("Render 14\r\n");
-
-        // decrement the remaining length of the glottal pulse
-        mem44--;
-
-        // finished with a glottal pulse?
-        if (mem44 == 0)
-        {
+        // output the accumulated value
+        Output8BitAry(sam, 0, ary);
 
-            // printf("Render 15\r\n");
-
-        pos48159:
-            // fetch the next glottal pulse length
-            A = pitches[Y];
-            mem44 = A;
-            A = A - (A >> 2);
-            mem38 = A;
-
-            // reset the formant wave generators to keep them in
-            // sync with the glottal pulse
-            phase1 = 0;
-            phase2 = 0;
-            phase3 = 0;
-            continue;
-        }
+        // printf("Render 13\r\n");
 
-        // decrement the count
-        mem38--;
+        sam->speedcounter--;
+        if (sam->speedcounter != 0)
+            goto pos48155;
+        sam->Y++; //go to next amplitude
 
-        // printf("Render 16\r\n");
+        // decrement the frame count
+        sam->mem48--;
+    }
 
-        // is the count non-zero and the sampled flag is zero?
-        if ((mem38 != 0) || (mem39 == 0))
-        {
+    // if the frame count is zero, exit the loop
+    if (sam->mem48 == 0)
+        return 0;
+    sam->speedcounter = sam->speed;
+pos48155:
 
-            // printf("Render 17\r\n");
+    // printf("Render 14\r\n");
 
-            // reset the phase of the formants to match the pulse
-            phase1 += frequency1[Y];
-            phase2 += frequency2[Y];
-            phase3 += frequency3[Y];
-            continue;
-        }
+    // decrement the remaining length of the glottal pulse
+    sam->mem44--;
 
-        // voiced sampled phonemes interleave the sample with the
-        // glottal pulse. The sample flag is non-zero, so render
-        // the sample for the phoneme.
+    // finished with a glottal pulse?
+    if (sam->mem44 == 0)
+    {
 
-        // printf("Render 18\r\n");
+        // printf("Render 15\r\n");
+
+    pos48159:
+        // fetch the next glottal pulse length
+        sam->A = sam->pitches[sam->Y];
+        sam->mem44 = sam->A;
+        sam->A = sam->A - (sam->A >> 2);
+        sam->mem38 = sam->A;
+
+        // reset the formant wave generators to keep them in
+        // sync with the glottal pulse
+        sam->phase1 = 0;
+        sam->phase2 = 0;
+        sam->phase3 = 0;
+        return 1;
+    }
 
-        RenderSample(&mem66);
+    // decrement the count
+    sam->mem38--;
 
-        // printf("Render 19\r\n");
+    // printf("Render 16\r\n");
 
-        goto pos48159;
-    } //while
+    // is the count non-zero and the sampled flag is zero?
+    if ((sam->mem38 != 0) || (sam->mem39 == 0))
+    {
 
-    // The following code is never reached. It's left over from when
-    // the voiced sample code was part of this loop, instead of part
-    // of RenderSample();
+        // printf("Render 17\r\n");
 
-    //pos48315:
-    int tempA;
-    phase1 = A ^ 255;
-    Y = mem66;
-    do
-    {
-        //pos48321:
+        // reset the phase of the formants to match the pulse
+        sam->phase1 += sam->frequency1[sam->Y];
+        sam->phase2 += sam->frequency2[sam->Y];
+        sam->phase3 += sam->frequency3[sam->Y];
+        return 1;
+    }
 
-        mem56 = 8;
-        A = Read(mem47, Y);
+    // voiced sampled phonemes interleave the sample with the
+    // glottal pulse. The sample flag is non-zero, so render
+    // the sample for the phoneme.
 
-        //pos48327:
-        do
-        {
-            //48327: ASL A
-            //48328: BCC 48337
-            tempA = A;
-            A = A << 1;
-            if ((tempA & 128) != 0)
-            {
-                X = 26;
-                // mem[54296] = X;
-                bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
-            }
-            else
-            {
-                //mem[54296] = 6;
-                X = 6;
-                bufferpos += 150;
-                buffer[bufferpos / 50] = (X & 15) * 16;
-            }
+    // printf("Render 18\r\n");
 
-            for (X = wait2; X > 0; X--)
-                ; //wait
-            mem56--;
-        } while (mem56 != 0);
+    RenderSample(sam, &sam->mem66);
 
-        Y++;
-        phase1++;
+    // printf("Render 19\r\n");
 
-    } while (phase1 != 0);
-    //  if (phase1 != 0) goto pos48321;
-    A = 1;
-    mem44 = 1;
-    mem66 = Y;
-    Y = mem49;
-    return;
+    goto pos48159;
 }
 
 // Create a rising or falling inflection 30 frames prior to
 // index X. A rising inflection is used for questions, and
 // a falling inflection is used for statements.
 
-void AddInflection(unsigned char mem48, unsigned char phase1)
+void AddInflection(SamContext *sam, unsigned char mem48, unsigned char phase1)
 {
     //pos48372:
     //  mem48 = 255;
     //pos48376:
 
     // store the location of the punctuation
-    mem49 = X;
-    A = X;
-    int Atemp = A;
+    sam->mem49 = sam->X;
+    sam->A = sam->X;
+    int Atemp = sam->A;
 
     // backup 30 frames
-    A = A - 30;
+    sam->A = sam->A - 30;
     // if index is before buffer, point to start of buffer
     if (Atemp <= 30)
-        A = 0;
-    X = A;
+        sam->A = 0;
+    sam->X = sam->A;
 
     // FIXME: Explain this fix better, it's not obvious
     // ML : A =, fixes a problem with invalid pitch with '.'
-    while ((A = pitches[X]) == 127)
-        X++;
+    while ((sam->A = sam->pitches[sam->X]) == 127)
+        sam->X++;
 
 pos48398:
     //48398: CLC
     //48399: ADC 48
 
     // add the inflection direction
-    A += mem48;
-    phase1 = A;
+    sam->A += mem48;
+    phase1 = sam->A;
 
     // set the inflection
-    pitches[X] = A;
+    sam->pitches[sam->X] = sam->A;
 pos48406:
 
     // increment the position
-    X++;
+    sam->X++;
 
     // exit if the punctuation has been reached
-    if (X == mem49)
+    if (sam->X == sam->mem49)
         return; //goto pos47615;
-    if (pitches[X] == 255)
+    if (sam->pitches[sam->X] == 255)
         goto pos48406;
-    A = phase1;
+    sam->A = phase1;
     goto pos48398;
 }
 
@@ -1059,7 +981,7 @@ pos48406:
     mouth formant (F1) and the throat formant (F2). Only the voiced
     phonemes (5-29 and 48-53) are altered.
 */
-void SetMouthThroat(unsigned char mouth, unsigned char throat)
+void SetMouthThroat(SamContext *sam, unsigned char mouth, unsigned char throat)
 {
     unsigned char initialFrequency;
     unsigned char newFrequency = 0;
@@ -1086,6 +1008,11 @@ void SetMouthThroat(unsigned char mouth, unsigned char throat)
     unsigned char throatFormants48_53[6] = {72, 39, 31, 43, 30, 34};
 
     unsigned char pos = 5; //mem39216
+
+    // the unaltered phonemes
+    memcpy(sam->freq1data, freq1data, sizeof(sam->freq1data));
+    memcpy(sam->freq2data, freq2data, sizeof(sam->freq2data));
+
                            //pos38942:
     // recalculate formant frequencies 5..29 for the mouth (F1) and throat (F2)
     while (pos != 30)
@@ -1093,48 +1020,48 @@ void SetMouthThroat(unsigned char mouth, unsigned char throat)
         // recalculate mouth frequency
         initialFrequency = mouthFormants5_29[pos];
         if (initialFrequency != 0)
-            newFrequency = trans(mouth, initialFrequency);
-        freq1data[pos] = newFrequency;
+            newFrequency = trans(sam, mouth, initialFrequency);
+        sam->freq1data[pos] = newFrequency;
 
         // recalculate throat frequency
         initialFrequency = throatFormants5_29[pos];
         if (initialFrequency != 0)
-            newFrequency = trans(throat, initialFrequency);
-        freq2data[pos] = newFrequency;
+            newFrequency = trans(sam, throat, initialFrequency);
+        sam->freq2data[pos] = newFrequency;
         pos++;
     }
 
     //pos39059:
     // recalculate formant frequencies 48..53
     pos = 48;
-    Y = 0;
+    sam->Y = 0;
     while (pos != 54)
     {
         // recalculate F1 (mouth formant)
-        initialFrequency = mouthFormants48_53[Y];
-        newFrequency = trans(mouth, initialFrequency);
-        freq1data[pos] = newFrequency;
+        initialFrequency = mouthFormants48_53[sam->Y];
+        newFrequency = trans(sam, mouth, initialFrequency);
+        sam->freq1data[pos] = newFrequency;
 
         // recalculate F2 (throat formant)
-        initialFrequency = throatFormants48_53[Y];
-        newFrequency = trans(throat, initialFrequency);
-        freq2data[pos] = newFrequency;
-        Y++;
+        initialFrequency = throatFormants48_53[sam->Y];
+        newFrequency = trans(sam, throat, initialFrequency);
+        sam->freq2data[pos] = newFrequency;
+        sam->Y++;
         pos++;
     }
 }
 
 //return = (mem39212*mem39213) >> 1
-unsigned char trans(unsigned char mem39212, unsigned char mem39213)
+unsigned char trans(SamContext *sam, unsigned char mem39212, unsigned char mem39213)
 {
     //pos39008:
     unsigned char carry;
     int temp;
     unsigned char mem39214, mem39215;
-    A = 0;
+    sam->A = 0;
     mem39215 = 0;
     mem39214 = 0;
-    X = 8;
+    sam->X = 8;
     do
     {
         carry = mem39212 & 1;
@@ -1146,19 +1073,19 @@ unsigned char trans(unsigned char mem39212, unsigned char mem39213)
                         39021: BCC 39033
                         */
             carry = 0;
-            A = mem39215;
-            temp = (int)A + (int)mem39213;
-            A = A + mem39213;
+            sam->A = mem39215;
+            temp = (int)sam->A + (int)mem39213;
+            sam->A = sam->A + mem39213;
             if (temp > 255)
                 carry = 1;
-            mem39215 = A;
+            mem39215 = sam->A;
         }
         temp = mem39215 & 1;
         mem39215 = (mem39215 >> 1) | (carry ? 128 : 0);
         carry = temp;
         //39033: ROR 39215
-        X--;
-    } while (X != 0);
+        sam->X--;
+    } while (sam->X != 0);
     temp = mem39214 & 128;
     mem39214 = (mem39214 << 1) | (carry ? 1 : 0);
     carry = temp;
@@ -1,7 +1,12 @@
 #ifndef RENDER_H
 #define RENDER_H
 
-void Render();
-void SetMouthThroat(unsigned char mouth, unsigned char throat);
+#include "samcontext.h"
+
+// Build the frames of the breath group PrepareOutput() copied out
+int RenderStart(SamContext *sam);
+// Render one glottal pulse or sampled phoneme; 0 once the group is done
+int RenderStep(SamContext *sam);
+void SetMouthThroat(SamContext *sam, unsigned char mouth, unsigned char throat);
 
 #endif
@@ -1,87 +1,32 @@
 
 #include "sam.h"
 
-#ifdef ESP_PLATFORM
-#include <esp_heap_caps.h>
-#endif
-
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+#include "samcontext.h"
 #include "samdebug.h"
 #include "render.h"
 #include "SamTabs.h"
 
-
-char input[256]; //tab39445
-//standard sam sound
-unsigned char speed = 72;
-unsigned char pitch = 64;
-unsigned char mouth = 128;
-unsigned char throat = 128;
-int singmode = 0;
-
 extern int debug;
 
-unsigned char mem39;
-unsigned char mem44;
-unsigned char mem47;
-unsigned char mem49;
-unsigned char mem50;
-unsigned char mem51;
-unsigned char mem53;
-unsigned char mem56;
-
-unsigned char mem59 = 0;
-
-unsigned char A, X, Y;
-
-unsigned char stress[256];        //numbers from 0 to 8
-unsigned char phonemeLength[256]; //tab40160
-unsigned char phonemeindex[256];
-
-unsigned char phonemeIndexOutput[60];  //tab47296
-unsigned char stressOutput[60];        //tab47365
-unsigned char phonemeLengthOutput[60]; //tab47416
-
-// contains the final soundbuffer
-int bufferpos = 0;
-char *buffer = NULL;
-
-void SetInput(char *_input)
-{
-    int i, l;
-    l = strlen(_input);
-    if (l > 254)
-        l = 254;
-    for (i = 0; i < l; i++)
-        input[i] = _input[i];
-    input[l] = 0;
-}
-
-void SetSpeed(unsigned char _speed) { speed = _speed; }
-void SetPitch(unsigned char _pitch) { pitch = _pitch; }
-void SetMouth(unsigned char _mouth) { mouth = _mouth; }
-void SetThroat(unsigned char _throat) { throat = _throat; }
-void EnableSingmode() { singmode = 1; }
-void DisableSingmode() { singmode = 0; }
-char *GetBuffer() { return buffer; }
-int GetBufferLength() { return bufferpos; }
-void FreeBuffer() { if (buffer) {free(buffer); buffer = NULL;} }
-
-void Init();
-int Parser1();
-void Parser2();
-int SAMMain();
-void CopyStress();
-void SetPhonemeLength();
-void AdjustLengths();
-void Code41240();
-void Insert(unsigned char position, unsigned char mem60, unsigned char mem59, unsigned char mem58);
-void InsertBreath();
-void PrepareOutput();
-void SetMouthThroat(unsigned char mouth, unsigned char throat);
+void SamSetSpeed(SamContext *sam, unsigned char _speed) { sam->speed = _speed; }
+void SamSetPitch(SamContext *sam, unsigned char _pitch) { sam->pitch = _pitch; }
+void SamSetMouth(SamContext *sam, unsigned char _mouth) { sam->mouth = _mouth; }
+void SamSetThroat(SamContext *sam, unsigned char _throat) { sam->throat = _throat; }
+void SamSetSingmode(SamContext *sam, int _singmode) { sam->singmode = _singmode; }
+
+void Init(SamContext *sam);
+int Parser1(SamContext *sam);
+void Parser2(SamContext *sam);
+void CopyStress(SamContext *sam);
+void SetPhonemeLength(SamContext *sam);
+void AdjustLengths(SamContext *sam);
+void Code41240(SamContext *sam);
+void Insert(SamContext *sam, unsigned char position, unsigned char mem60, unsigned char mem59, unsigned char mem58);
+void InsertBreath(SamContext *sam);
 
 // 168=pitches
 // 169=frequency1
@@ -91,31 +36,12 @@ void SetMouthThroat(unsigned char mouth, unsigned char throat);
 // 173=amplitude2
 // 174=amplitude3
 
-void Init()
+void Init(SamContext *sam)
 {
     int i;
 
     // printf("Initialize!\r\n");
 
-    SetMouthThroat(mouth, throat);
-
-    bufferpos = 0;
-    // TODO, check for free the memory, 10 seconds of output should be more than enough
-    //buffer = (char*)ps_malloc(22050 * 5);
-    // switch to ESP-IDF equivalent
-#ifdef ESP_PLATFORM
-    buffer = (char *)heap_caps_malloc(22050 * 10, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-#else
-    buffer = (char *)malloc(22050 * 10);
-#endif
-    /*
-    Due to a technical limitation, the maximum statically allocated DRAM usage is 160KB. 
-    The remaining 160KB (for a total of 320KB of DRAM) can only be allocated at runtime as heap.
-    https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/mem_alloc.html
-    */
-
-    // printf("buffer pointer %d\r\n", buffer);
-
     /*
     freq2data = &mem[45136];
     freq1data = &mem[45056];
@@ -141,155 +67,151 @@ void Init()
 
     for (i = 0; i < 256; i++)
     {
-        stress[i] = 0;
-        phonemeLength[i] = 0;
+        sam->stress[i] = 0;
+        sam->phonemeLength[i] = 0;
     }
 
     for (i = 0; i < 60; i++)
     {
-        phonemeIndexOutput[i] = 0;
-        stressOutput[i] = 0;
-        phonemeLengthOutput[i] = 0;
+        sam->phonemeIndexOutput[i] = 0;
+        sam->stressOutput[i] = 0;
+        sam->phonemeLengthOutput[i] = 0;
     }
-    phonemeindex[255] = 255; //to prevent buffer overflow // ML : changed from 32 to 255 to stop freezing with long inputs
+    sam->phonemeindex[255] = 255; //to prevent buffer overflow // ML : changed from 32 to 255 to stop freezing with long inputs
 }
 
 //int Code39771()
-int SAMMain()
+int SAMMain(SamContext *sam)
 {
-    Init(); // buffer is allocated here
-    phonemeindex[255] = 32; //to prevent buffer overflow
+    Init(sam);
+    sam->phonemeindex[255] = 32; //to prevent buffer overflow
 
-    if (!Parser1())
-    {
-        FreeBuffer();
+    if (!Parser1(sam))
         return 0;
-    }
     if (debug)
-        PrintPhonemes(phonemeindex, phonemeLength, stress);
-    Parser2();
-    CopyStress();
-    SetPhonemeLength();
-    AdjustLengths();
-    Code41240();
+        PrintPhonemes(sam->phonemeindex, sam->phonemeLength, sam->stress);
+    Parser2(sam);
+    CopyStress(sam);
+    SetPhonemeLength(sam);
+    AdjustLengths(sam);
+    Code41240(sam);
     do
     {
-        A = phonemeindex[X];
-        if (A > 80)
+        sam->A = sam->phonemeindex[sam->X];
+        if (sam->A > 80)
         {
-            phonemeindex[X] = 255;
+            sam->phonemeindex[sam->X] = 255;
             break; // error: delete all behind it
         }
-        X++;
-    } while (X != 0);
+        sam->X++;
+    } while (sam->X != 0);
 
     //pos39848:
-    InsertBreath();
+    InsertBreath(sam);
 
     //mem[40158] = 255;
     if (debug)
     {
-        PrintPhonemes(phonemeindex, phonemeLength, stress);
+        PrintPhonemes(sam->phonemeindex, sam->phonemeLength, sam->stress);
     }
 
-    PrepareOutput();
-
+    sam->outputPosition = 0;
+    sam->outputDone = 0;
     return 1;
 }
 
+// The parsed phonemes are rendered a breath group at a time; each 254 in
+// phonemeindex[] ends one.
 //void Code48547()
-void PrepareOutput()
+int PrepareOutput(SamContext *sam)
 {
-    A = 0;
-    X = 0;
-    Y = 0;
+    if (sam->outputDone)
+        return 0;
+
+    sam->A = 0;
+    sam->X = sam->outputPosition;
+    sam->Y = 0;
 
     //pos48551:
     while (1)
     {
-        A = phonemeindex[X];
-        if (A == 255)
+        sam->A = sam->phonemeindex[sam->X];
+        if (sam->A == 255)
         {
-            A = 255;
-            phonemeIndexOutput[Y] = 255;
-            Render();
-            return;
+            sam->phonemeIndexOutput[sam->Y] = 255;
+            sam->outputDone = 1;
+            return 1;
         }
-        if (A == 254)
+        if (sam->A == 254)
         {
-            X++;
-            int temp = X;
-            //mem[48546] = X;
-            phonemeIndexOutput[Y] = 255;
-            Render();
-            //X = mem[48546];
-            X = temp;
-            Y = 0;
-            continue;
+            sam->X++;
+            sam->phonemeIndexOutput[sam->Y] = 255;
+            sam->outputPosition = sam->X;
+            return 1;
         }
 
-        if (A == 0)
+        if (sam->A == 0)
         {
-            X++;
+            sam->X++;
             continue;
         }
 
-        phonemeIndexOutput[Y] = A;
-        phonemeLengthOutput[Y] = phonemeLength[X];
-        stressOutput[Y] = stress[X];
-        X++;
-        Y++;
+        sam->phonemeIndexOutput[sam->Y] = sam->A;
+        sam->phonemeLengthOutput[sam->Y] = sam->phonemeLength[sam->X];
+        sam->stressOutput[sam->Y] = sam->stress[sam->X];
+        sam->X++;
+        sam->Y++;
     }
 }
 
 //void Code48431()
-void InsertBreath()
+void InsertBreath(SamContext *sam)
 {
     unsigned char mem54;
     unsigned char mem55;
     unsigned char index; //variable Y
     mem54 = 255;
-    X++;
+    sam->X++;
     mem55 = 0;
     unsigned char mem66 = 0;
     while (1)
     {
         //pos48440:
-        X = mem66;
-        index = phonemeindex[X];
+        sam->X = mem66;
+        index = sam->phonemeindex[sam->X];
         if (index == 255)
             return;
-        mem55 += phonemeLength[X];
+        mem55 += sam->phonemeLength[sam->X];
 
         if (mem55 < 232)
         {
             if (index != 254) // ML : Prevents an index out of bounds problem
             {
-                A = flags2[index] & 1;
-                if (A != 0)
+                sam->A = flags2[index] & 1;
+                if (sam->A != 0)
                 {
-                    X++;
+                    sam->X++;
                     mem55 = 0;
-                    Insert(X, 254, mem59, 0);
+                    Insert(sam, sam->X, 254, sam->mem59, 0);
                     mem66++;
                     mem66++;
                     continue;
                 }
             }
             if (index == 0)
-                mem54 = X;
+                mem54 = sam->X;
             mem66++;
             continue;
         }
-        X = mem54;
-        phonemeindex[X] = 31; // 'Q*' glottal stop
-        phonemeLength[X] = 4;
-        stress[X] = 0;
-        X++;
+        sam->X = mem54;
+        sam->phonemeindex[sam->X] = 31; // 'Q*' glottal stop
+        sam->phonemeLength[sam->X] = 4;
+        sam->stress[sam->X] = 0;
+        sam->X++;
         mem55 = 0;
-        Insert(X, 254, mem59, 0);
-        X++;
-        mem66 = X;
+        Insert(sam, sam->X, 254, sam->mem59, 0);
+        sam->X++;
+        mem66 = sam->X;
     }
 }
 
@@ -307,59 +229,59 @@ void InsertBreath()
 // to the L that precedes it.
 
 //void Code41883()
-void CopyStress()
+void CopyStress(SamContext *sam)
 {
     // loop thought all the phonemes to be output
     unsigned char pos = 0; //mem66
     while (1)
     {
         // get the phomene
-        Y = phonemeindex[pos];
+        sam->Y = sam->phonemeindex[pos];
 
         // exit at end of buffer
-        if (Y == 255)
+        if (sam->Y == 255)
             return;
 
         // if CONSONANT_FLAG set, skip - only vowels get stress
-        if ((flags[Y] & 64) == 0)
+        if ((flags[sam->Y] & 64) == 0)
         {
             pos++;
             continue;
         }
         // get the next phoneme
-        Y = phonemeindex[pos + 1];
-        if (Y == 255) //prevent buffer overflow
+        sam->Y = sam->phonemeindex[pos + 1];
+        if (sam->Y == 255) //prevent buffer overflow
         {
             pos++;
             continue;
         }
         else
             // if the following phoneme is a vowel, skip
-            if ((flags[Y] & 128) == 0)
+            if ((flags[sam->Y] & 128) == 0)
         {
             pos++;
             continue;
         }
 
         // get the stress value at the next position
-        Y = stress[pos + 1];
+        sam->Y = sam->stress[pos + 1];
 
         // if next phoneme is not stressed, skip
-        if (Y == 0)
+        if (sam->Y == 0)
         {
             pos++;
             continue;
         }
 
         // if next phoneme is not a VOWEL OR ER, skip
-        if ((Y & 128) != 0)
+        if ((sam->Y & 128) != 0)
         {
             pos++;
             continue;
         }
 
         // copy stress from prior phoneme to this one
-        stress[pos] = Y + 1;
+        sam->stress[pos] = sam->Y + 1;
 
         // advance pointer
         pos++;
@@ -367,19 +289,19 @@ void CopyStress()
 }
 
 //void Code41014()
-void Insert(unsigned char position /*var57*/, unsigned char mem60, unsigned char mem59, unsigned char mem58)
+void Insert(SamContext *sam, unsigned char position /*var57*/, unsigned char mem60, unsigned char mem59, unsigned char mem58)
 {
     int i;
     for (i = 253; i >= position; i--) // ML : always keep last safe-guarding 255
     {
-        phonemeindex[i + 1] = phonemeindex[i];
-        phonemeLength[i + 1] = phonemeLength[i];
-        stress[i + 1] = stress[i];
+        sam->phonemeindex[i + 1] = sam->phonemeindex[i];
+        sam->phonemeLength[i + 1] = sam->phonemeLength[i];
+        sam->stress[i + 1] = sam->stress[i];
     }
 
-    phonemeindex[position] = mem60;
-    phonemeLength[position] = mem59;
-    stress[position] = mem58;
+    sam->phonemeindex[position] = mem60;
+    sam->phonemeLength[position] = mem59;
+    sam->stress[position] = mem58;
     return;
 }
 
@@ -434,38 +356,38 @@ void Insert(unsigned char position /*var57*/, unsigned char mem60, unsigned char
 // The character <0x9B> marks the end of text in input[]. When it is reached,
 // the index 255 is placed at the end of the phonemeIndexTable[], and the
 // function returns with a 1 indicating success.
-int Parser1()
+int Parser1(SamContext *sam)
 {
     int i;
     unsigned char sign1;
     unsigned char sign2;
     unsigned char position = 0;
-    X = 0;
-    A = 0;
-    Y = 0;
+    sam->X = 0;
+    sam->A = 0;
+    sam->Y = 0;
 
     // CLEAR THE STRESS TABLE
     for (i = 0; i < 256; i++)
-        stress[i] = 0;
+        sam->stress[i] = 0;
 
     // THIS CODE MATCHES THE PHONEME LETTERS TO THE TABLE
     // pos41078:
     while (1)
     {
         // GET THE FIRST CHARACTER FROM THE PHONEME BUFFER
-        sign1 = input[X];
+        sign1 = sam->input[sam->X];
         // TEST FOR 155 (�) END OF LINE MARKER
         if (sign1 == 155)
         {
             // MARK ENDPOINT AND RETURN
-            phonemeindex[position] = 255; //mark endpoint
+            sam->phonemeindex[position] = 255; //mark endpoint
             // REACHED END OF PHONEMES, SO EXIT
             return 1; //all ok
         }
 
         // GET THE NEXT CHARACTER FROM THE BUFFER
-        X++;
-        sign2 = input[X];
+        sam->X++;
+        sign2 = sam->input[sam->X];
 
         // NOW sign1 = FIRST CHARACTER OF PHONEME, AND sign2 = SECOND CHARACTER OF PHONEME
 
@@ -473,28 +395,28 @@ int Parser1()
         // IGNORE PHONEMES IN TABLE ENDING WITH WILDCARDS
 
         // SET INDEX TO 0
-        Y = 0;
+        sam->Y = 0;
     pos41095:
 
         // GET FIRST CHARACTER AT POSITION Y IN signInputTable
         // --> should change name to PhonemeNameTable1
-        A = signInputTable1[Y];
+        sam->A = signInputTable1[sam->Y];
 
         // FIRST CHARACTER MATCHES?
-        if (A == sign1)
+        if (sam->A == sign1)
         {
             // GET THE CHARACTER FROM THE PhonemeSecondLetterTable
-            A = signInputTable2[Y];
+            sam->A = signInputTable2[sam->Y];
             // NOT A SPECIAL AND MATCHES SECOND CHARACTER?
-            if ((A != '*') && (A == sign2))
+            if ((sam->A != '*') && (sam->A == sign2))
             {
                 // STORE THE INDEX OF THE PHONEME INTO THE phomeneIndexTable
-                phonemeindex[position] = Y;
+                sam->phonemeindex[position] = sam->Y;
 
                 // ADVANCE THE POINTER TO THE phonemeIndexTable
                 position++;
                 // ADVANCE THE POINTER TO THE phonemeInputBuffer
-                X++;
+                sam->X++;
 
                 // CONTINUE PARSING
                 continue;
@@ -504,25 +426,25 @@ int Parser1()
         // NO MATCH, TRY TO MATCH ON FIRST CHARACTER TO WILDCARD NAMES (ENDING WITH '*')
 
         // ADVANCE TO THE NEXT POSITION
-        Y++;
+        sam->Y++;
         // IF NOT END OF TABLE, CONTINUE
-        if (Y != 81)
+        if (sam->Y != 81)
             goto pos41095;
 
         // REACHED END OF TABLE WITHOUT AN EXACT (2 CHARACTER) MATCH.
         // THIS TIME, SEARCH FOR A 1 CHARACTER MATCH AGAINST THE WILDCARDS
 
         // RESET THE INDEX TO POINT TO THE START OF THE PHONEME NAME TABLE
-        Y = 0;
+        sam->Y = 0;
     pos41134:
         // DOES THE PHONEME IN THE TABLE END WITH '*'?
-        if (signInputTable2[Y] == '*')
+        if (signInputTable2[sam->Y] == '*')
         {
             // DOES THE FIRST CHARACTER MATCH THE FIRST LETTER OF THE PHONEME
-            if (signInputTable1[Y] == sign1)
+            if (signInputTable1[sam->Y] == sign1)
             {
                 // SAVE THE POSITION AND MOVE AHEAD
-                phonemeindex[position] = Y;
+                sam->phonemeindex[position] = sam->Y;
 
                 // ADVANCE THE POINTER
                 position++;
@@ -531,25 +453,25 @@ int Parser1()
                 continue;
             }
         }
-        Y++;
-        if (Y != 81)
+        sam->Y++;
+        if (sam->Y != 81)
             goto pos41134; //81 is size of PHONEME NAME table
 
         // FAILED TO MATCH WITH A WILDCARD. ASSUME THIS IS A STRESS
         // CHARACTER. SEARCH THROUGH THE STRESS TABLE
 
         // SET INDEX TO POSITION 8 (END OF STRESS TABLE)
-        Y = 8;
+        sam->Y = 8;
 
         // WALK BACK THROUGH TABLE LOOKING FOR A MATCH
-        while ((sign1 != stressInputTable[Y]) && (Y > 0))
+        while ((sign1 != stressInputTable[sam->Y]) && (sam->Y > 0))
         {
             // DECREMENT INDEX
-            Y--;
+            sam->Y--;
         }
 
         // REACHED THE END OF THE SEARCH WITHOUT BREAKING OUT OF LOOP?
-        if (Y == 0)
+        if (sam->Y == 0)
         {
             //mem[39444] = X;
             //41181: JSR 42043 //Error
@@ -557,41 +479,41 @@ int Parser1()
             return 0;
         }
         // SET THE STRESS FOR THE PRIOR PHONEME
-        stress[position - 1] = Y;
+        sam->stress[position - 1] = sam->Y;
     } //while
 }
 
 //change phonemelength depedendent on stress
 //void Code41203()
-void SetPhonemeLength()
+void SetPhonemeLength(SamContext *sam)
 {
     unsigned char A;
     int position = 0;
-    while (phonemeindex[position] != 255)
+    while (sam->phonemeindex[position] != 255)
     {
-        A = stress[position];
+        A = sam->stress[position];
         //41218: BMI 41229
         if ((A == 0) || ((A & 128) != 0))
         {
-            phonemeLength[position] = phonemeLengthTable[phonemeindex[position]];
+            sam->phonemeLength[position] = phonemeLengthTable[sam->phonemeindex[position]];
         }
         else
         {
-            phonemeLength[position] = phonemeStressedLengthTable[phonemeindex[position]];
+            sam->phonemeLength[position] = phonemeStressedLengthTable[sam->phonemeindex[position]];
         }
         position++;
     }
 }
 
-void Code41240()
+void Code41240(SamContext *sam)
 {
     unsigned char pos = 0;
 
-    while (phonemeindex[pos] != 255)
+    while (sam->phonemeindex[pos] != 255)
     {
         unsigned char index; //register AC
-        X = pos;
-        index = phonemeindex[pos];
+        sam->X = pos;
+        index = sam->phonemeindex[pos];
         if ((flags[index] & 2) == 0)
         {
             pos++;
@@ -599,34 +521,34 @@ void Code41240()
         }
         else if ((flags[index] & 1) == 0)
         {
-            Insert(pos + 1, index + 1, phonemeLengthTable[index + 1], stress[pos]);
-            Insert(pos + 2, index + 2, phonemeLengthTable[index + 2], stress[pos]);
+            Insert(sam, pos + 1, index + 1, phonemeLengthTable[index + 1], sam->stress[pos]);
+            Insert(sam, pos + 2, index + 2, phonemeLengthTable[index + 2], sam->stress[pos]);
             pos += 3;
             continue;
         }
 
         do
         {
-            X++;
-            A = phonemeindex[X];
-        } while (A == 0);
+            sam->X++;
+            sam->A = sam->phonemeindex[sam->X];
+        } while (sam->A == 0);
 
-        if (A != 255)
+        if (sam->A != 255)
         {
-            if ((flags[A] & 8) != 0)
+            if ((flags[sam->A] & 8) != 0)
             {
                 pos++;
                 continue;
             }
-            if ((A == 36) || (A == 37))
+            if ((sam->A == 36) || (sam->A == 37))
             {
                 pos++;
                 continue;
             } // '/H' '/X'
         }
 
-        Insert(pos + 1, index + 1, phonemeLengthTable[index + 1], stress[pos]);
-        Insert(pos + 2, index + 2, phonemeLengthTable[index + 2], stress[pos]);
+        Insert(sam, pos + 1, index + 1, phonemeLengthTable[index + 1], sam->stress[pos]);
+        Insert(sam, pos + 2, index + 2, phonemeLengthTable[index + 2], sam->stress[pos]);
         pos += 3;
     };
 }
@@ -656,7 +578,7 @@ void Code41240()
 //       <UNSTRESSED VOWEL> D <PAUSE>  -> <UNSTRESSED VOWEL> DX <PAUSE>
 
 //void Code41397()
-void Parser2()
+void Parser2(SamContext *sam)
 {
     if (debug)
         printf("Parser2\r\n");
@@ -667,16 +589,16 @@ void Parser2()
     while (1)
     {
         // SET X TO THE CURRENT POSITION
-        X = pos;
+        sam->X = pos;
         // GET THE PHONEME AT THE CURRENT POSITION
-        A = phonemeindex[pos];
+        sam->A = sam->phonemeindex[pos];
 
         // DEBUG: Print phoneme and index
-        if (debug && A != 255)
-            printf("%d: %c%c\r\n", X, signInputTable1[A], signInputTable2[A]);
+        if (debug && sam->A != 255)
+            printf("%d: %c%c\r\n", sam->X, signInputTable1[sam->A], signInputTable2[sam->A]);
 
         // Is phoneme pause?
-        if (A == 0)
+        if (sam->A == 0)
         {
             // Move ahead to the
             pos++;
@@ -684,11 +606,11 @@ void Parser2()
         }
 
         // If end of phonemes flag reached, exit routine
-        if (A == 255)
+        if (sam->A == 255)
             return;
 
         // Copy the current phoneme index to Y
-        Y = A;
+        sam->Y = sam->A;
 
         // RULE:
         //       <DIPHTONG ENDING WITH WX> -> <DIPHTONG ENDING WITH WX> WX
@@ -696,31 +618,31 @@ void Parser2()
         // Example: OIL, COW
 
         // Check for DIPHTONG
-        if ((flags[A] & 16) == 0)
+        if ((flags[sam->A] & 16) == 0)
             goto pos41457;
 
         // Not a diphthong. Get the stress
-        mem58 = stress[pos];
+        mem58 = sam->stress[pos];
 
         // End in IY sound?
-        A = flags[Y] & 32;
+        sam->A = flags[sam->Y] & 32;
 
         // If ends with IY, use YX, else use WX
-        if (A == 0)
-            A = 20;
+        if (sam->A == 0)
+            sam->A = 20;
         else
-            A = 21; // 'WX' = 20 'YX' = 21
+            sam->A = 21; // 'WX' = 20 'YX' = 21
         //pos41443:
         // Insert at WX or YX following, copying the stress
 
         if (debug)
-            if (A == 20)
+            if (sam->A == 20)
                 printf("RULE: insert WX following diphtong NOT ending in IY sound\r\n");
         if (debug)
-            if (A == 21)
+            if (sam->A == 21)
                 printf("RULE: insert YX following diphtong ending in IY sound\r\n");
-        Insert(pos + 1, A, mem59, mem58);
-        X = pos;
+        Insert(sam, pos + 1, sam->A, sam->mem59, mem58);
+        sam->X = pos;
         // Jump to ???
         goto pos41749;
 
@@ -731,23 +653,23 @@ void Parser2()
         // Example: MEDDLE
 
         // Get phoneme
-        A = phonemeindex[X];
+        sam->A = sam->phonemeindex[sam->X];
         // Skip this rule if phoneme is not UL
-        if (A != 78)
+        if (sam->A != 78)
             goto pos41487; // 'UL'
-        A = 24;            // 'L'                 //change 'UL' to 'AX L'
+        sam->A = 24;            // 'L'                 //change 'UL' to 'AX L'
 
         if (debug)
             printf("RULE: UL -> AX L\r\n");
 
     pos41466:
         // Get current phoneme stress
-        mem58 = stress[X];
+        mem58 = sam->stress[sam->X];
 
         // Change UL to AX
-        phonemeindex[X] = 13; // 'AX'
+        sam->phonemeindex[sam->X] = 13; // 'AX'
                               // Perform insert. Note code below may jump up here with different values
-        Insert(X + 1, A, mem59, mem58);
+        Insert(sam, sam->X + 1, sam->A, sam->mem59, mem58);
         pos++;
         // Move to next phoneme
         continue;
@@ -759,10 +681,10 @@ void Parser2()
         // Example: ASTRONOMY
 
         // Skip rule if phoneme != UM
-        if (A != 79)
+        if (sam->A != 79)
             goto pos41495; // 'UM'
         // Jump up to branch - replaces current phoneme with AX and continues
-        A = 27; // 'M'  //change 'UM' to  'AX M'
+        sam->A = 27; // 'M'  //change 'UM' to  'AX M'
         if (debug)
             printf("RULE: UM -> AX M\r\n");
         goto pos41466;
@@ -773,11 +695,11 @@ void Parser2()
         // Example: FUNCTION
 
         // Skip rule if phoneme != UN
-        if (A != 80)
+        if (sam->A != 80)
             goto pos41503; // 'UN'
 
         // Jump up to branch - replaces current phoneme with AX and continues
-        A = 28; // 'N' //change UN to 'AX N'
+        sam->A = 28; // 'N' //change UN to 'AX N'
         if (debug)
             printf("RULE: UN -> AX N\r\n");
         goto pos41466;
@@ -787,50 +709,50 @@ void Parser2()
         //       <STRESSED VOWEL> <SILENCE> <STRESSED VOWEL> -> <STRESSED VOWEL> <SILENCE> Q <VOWEL>
         // EXAMPLE: AWAY EIGHT
 
-        Y = A;
+        sam->Y = sam->A;
         // VOWEL set?
-        A = flags[A] & 128;
+        sam->A = flags[sam->A] & 128;
 
         // Skip if not a vowel
-        if (A != 0)
+        if (sam->A != 0)
         {
             // Get the stress
-            A = stress[X];
+            sam->A = sam->stress[sam->X];
 
             // If stressed...
-            if (A != 0)
+            if (sam->A != 0)
             {
                 // Get the following phoneme
-                X++;
-                A = phonemeindex[X];
+                sam->X++;
+                sam->A = sam->phonemeindex[sam->X];
                 // If following phoneme is a pause
 
-                if (A == 0)
+                if (sam->A == 0)
                 {
                     // Get the phoneme following pause
-                    X++;
-                    Y = phonemeindex[X];
+                    sam->X++;
+                    sam->Y = sam->phonemeindex[sam->X];
 
                     // Check for end of buffer flag
-                    if (Y == 255) //buffer overflow
+                    if (sam->Y == 255) //buffer overflow
                                   // ??? Not sure about these flags
-                        A = 65 & 128;
+                        sam->A = 65 & 128;
                     else
                         // And VOWEL flag to current phoneme's flags
-                        A = flags[Y] & 128;
+                        sam->A = flags[sam->Y] & 128;
 
                     // If following phonemes is not a pause
-                    if (A != 0)
+                    if (sam->A != 0)
                     {
                         // If the following phoneme is not stressed
-                        A = stress[X];
-                        if (A != 0)
+                        sam->A = sam->stress[sam->X];
+                        if (sam->A != 0)
                         {
                             // Insert a glottal stop and move forward
                             if (debug)
                                 printf("RULE: Insert glottal stop between two stressed vowels with space between them\r\n");
                             // 31 = 'Q'
-                            Insert(X, 31, mem59, 0);
+                            Insert(sam, sam->X, 31, sam->mem59, 0);
                             pos++;
                             continue;
                         }
@@ -844,21 +766,21 @@ void Parser2()
         // Example: TRACK
 
         // Get current position and phoneme
-        X = pos;
-        A = phonemeindex[pos];
-        if (A != 23)
+        sam->X = pos;
+        sam->A = sam->phonemeindex[pos];
+        if (sam->A != 23)
             goto pos41611; // 'R'
 
         // Look at prior phoneme
-        X--;
-        A = phonemeindex[pos - 1];
+        sam->X--;
+        sam->A = sam->phonemeindex[pos - 1];
         //pos41567:
-        if (A == 69) // 'T'
+        if (sam->A == 69) // 'T'
         {
             // Change T to CH
             if (debug)
                 printf("RULE: T R -> CH R\r\n");
-            phonemeindex[pos - 1] = 42;
+            sam->phonemeindex[pos - 1] = 42;
             goto pos41779;
         }
 
@@ -867,10 +789,10 @@ void Parser2()
         // Example: DRY
 
         // Prior phonemes D?
-        if (A == 57) // 'D'
+        if (sam->A == 57) // 'D'
         {
             // Change D to J
-            phonemeindex[pos - 1] = 44;
+            sam->phonemeindex[pos - 1] = 44;
             if (debug)
                 printf("RULE: D R -> J R\r\n");
             goto pos41788;
@@ -881,11 +803,11 @@ void Parser2()
         // Example: ART
 
         // If vowel flag is set change R to RX
-        A = flags[A] & 128;
+        sam->A = flags[sam->A] & 128;
         if (debug)
             printf("RULE: R -> RX\r\n");
-        if (A != 0)
-            phonemeindex[pos] = 18; // 'RX'
+        if (sam->A != 0)
+            sam->phonemeindex[pos] = 18; // 'RX'
 
         // continue to next phoneme
         pos++;
@@ -898,10 +820,10 @@ void Parser2()
         // Example: ALL
 
         // Is phoneme L?
-        if (A == 24) // 'L'
+        if (sam->A == 24) // 'L'
         {
             // If prior phoneme does not have VOWEL flag set, move to next phoneme
-            if ((flags[phonemeindex[pos - 1]] & 128) == 0)
+            if ((flags[sam->phonemeindex[pos - 1]] & 128) == 0)
             {
                 pos++;
                 continue;
@@ -909,7 +831,7 @@ void Parser2()
             // Prior phoneme has VOWEL flag set, so change L to LX and move to next phoneme
             if (debug)
                 printf("RULE: <VOWEL> L -> <VOWEL> LX\r\n");
-            phonemeindex[X] = 19; // 'LX'
+            sam->phonemeindex[sam->X] = 19; // 'LX'
             pos++;
             continue;
         }
@@ -922,10 +844,10 @@ void Parser2()
         //       2. Reciter already replaces GS -> GZ
 
         // Is current phoneme S?
-        if (A == 32) // 'S'
+        if (sam->A == 32) // 'S'
         {
             // If prior phoneme is not G, move to next phoneme
-            if (phonemeindex[pos - 1] != 60)
+            if (sam->phonemeindex[pos - 1] != 60)
             {
                 pos++;
                 continue;
@@ -933,7 +855,7 @@ void Parser2()
             // Replace S with Z and move on
             if (debug)
                 printf("RULE: G S -> G Z\r\n");
-            phonemeindex[pos] = 38; // 'Z'
+            sam->phonemeindex[pos] = 38; // 'Z'
             pos++;
             continue;
         }
@@ -943,23 +865,23 @@ void Parser2()
         // Example: COW
 
         // Is current phoneme K?
-        if (A == 72) // 'K'
+        if (sam->A == 72) // 'K'
         {
             // Get next phoneme
-            Y = phonemeindex[pos + 1];
+            sam->Y = sam->phonemeindex[pos + 1];
             // If at end, replace current phoneme with KX
-            if (Y == 255)
-                phonemeindex[pos] = 75; // ML : prevents an index out of bounds problem
+            if (sam->Y == 255)
+                sam->phonemeindex[pos] = 75; // ML : prevents an index out of bounds problem
             else
             {
                 // VOWELS AND DIPHTONGS ENDING WITH IY SOUND flag set?
-                A = flags[Y] & 32;
+                sam->A = flags[sam->Y] & 32;
                 if (debug)
-                    if (A == 0)
+                    if (sam->A == 0)
                         printf("RULE: K <VOWEL OR DIPHTONG NOT ENDING WITH IY> -> KX <VOWEL OR DIPHTONG NOT ENDING WITH IY>\r\n");
                 // Replace with KX
-                if (A == 0)
-                    phonemeindex[pos] = 75; // 'KX'
+                if (sam->A == 0)
+                    sam->phonemeindex[pos] = 75; // 'KX'
             }
         }
         else
@@ -969,10 +891,10 @@ void Parser2()
             // Example: GO
 
             // Is character a G?
-            if (A == 60) // 'G'
+            if (sam->A == 60) // 'G'
         {
             // Get the following character
-            unsigned char index = phonemeindex[pos + 1];
+            unsigned char index = sam->phonemeindex[pos + 1];
 
             // At end of buffer?
             if (index == 255) //prevent buffer overflow
@@ -990,7 +912,7 @@ void Parser2()
             // replace G with GX and continue processing next phoneme
             if (debug)
                 printf("RULE: G <VOWEL OR DIPHTONG NOT ENDING WITH IY> -> GX <VOWEL OR DIPHTONG NOT ENDING WITH IY>\r\n");
-            phonemeindex[pos] = 63; // 'GX'
+            sam->phonemeindex[pos] = 63; // 'GX'
             pos++;
             continue;
         }
@@ -1002,22 +924,22 @@ void Parser2()
         //      S KX -> S GX
         // Examples: SPY, STY, SKY, SCOWL
 
-        Y = phonemeindex[pos];
+        sam->Y = sam->phonemeindex[pos];
         //pos41719:
         // Replace with softer version?
-        A = flags[Y] & 1;
-        if (A == 0)
+        sam->A = flags[sam->Y] & 1;
+        if (sam->A == 0)
             goto pos41749;
-        A = phonemeindex[pos - 1];
-        if (A != 32) // 'S'
+        sam->A = sam->phonemeindex[pos - 1];
+        if (sam->A != 32) // 'S'
         {
-            A = Y;
+            sam->A = sam->Y;
             goto pos41812;
         }
         // Replace with softer version
         if (debug)
-            printf("RULE: S* %c%c -> S* %c%c\r\n", signInputTable1[Y], signInputTable2[Y], signInputTable1[Y - 12], signInputTable2[Y - 12]);
-        phonemeindex[pos] = Y - 12;
+            printf("RULE: S* %c%c -> S* %c%c\r\n", signInputTable1[sam->Y], signInputTable2[sam->Y], signInputTable1[sam->Y - 12], signInputTable2[sam->Y - 12]);
+        sam->phonemeindex[pos] = sam->Y - 12;
         pos++;
         continue;
 
@@ -1030,21 +952,21 @@ void Parser2()
 
         //       UW -> UX
 
-        A = phonemeindex[X];
-        if (A == 53) // 'UW'
+        sam->A = sam->phonemeindex[sam->X];
+        if (sam->A == 53) // 'UW'
         {
             // ALVEOLAR flag set?
-            Y = phonemeindex[X - 1];
-            A = flags2[Y] & 4;
+            sam->Y = sam->phonemeindex[sam->X - 1];
+            sam->A = flags2[sam->Y] & 4;
             // If not set, continue processing next phoneme
-            if (A == 0)
+            if (sam->A == 0)
             {
                 pos++;
                 continue;
             }
             if (debug)
                 printf("RULE: <ALVEOLAR> UW -> <ALVEOLAR> UX\r\n");
-            phonemeindex[X] = 16;
+            sam->phonemeindex[sam->X] = 16;
             pos++;
             continue;
         }
@@ -1054,12 +976,12 @@ void Parser2()
         //       CH -> CH CH' (CH requires two phonemes to represent it)
         // Example: CHEW
 
-        if (A == 42) // 'CH'
+        if (sam->A == 42) // 'CH'
         {
             //        pos41783:
             if (debug)
                 printf("CH -> CH CH+1\r\n");
-            Insert(X + 1, A + 1, mem59, stress[X]);
+            Insert(sam, sam->X + 1, sam->A + 1, sam->mem59, sam->stress[sam->X]);
             pos++;
             continue;
         }
@@ -1070,11 +992,11 @@ void Parser2()
         //       J -> J J' (J requires two phonemes to represent it)
         // Example: JAY
 
-        if (A == 44) // 'J'
+        if (sam->A == 44) // 'J'
         {
             if (debug)
                 printf("J -> J J+1\r\n");
-            Insert(X + 1, A + 1, mem59, stress[X]);
+            Insert(sam, sam->X + 1, sam->A + 1, sam->mem59, sam->stress[sam->X]);
             pos++;
             continue;
         }
@@ -1090,8 +1012,8 @@ void Parser2()
 
         // Past this point, only process if phoneme is T or D
 
-        if (A != 69) // 'T'
-            if (A != 57)
+        if (sam->A != 69) // 'T'
+            if (sam->A != 57)
             {
                 pos++;
                 continue;
@@ -1099,28 +1021,28 @@ void Parser2()
         //pos41825:
 
         // If prior phoneme is not a vowel, continue processing phonemes
-        if ((flags[phonemeindex[X - 1]] & 128) == 0)
+        if ((flags[sam->phonemeindex[sam->X - 1]] & 128) == 0)
         {
             pos++;
             continue;
         }
 
         // Get next phoneme
-        X++;
-        A = phonemeindex[X];
+        sam->X++;
+        sam->A = sam->phonemeindex[sam->X];
         //pos41841
         // Is the next phoneme a pause?
-        if (A != 0)
+        if (sam->A != 0)
         {
             // If next phoneme is not a pause, continue processing phonemes
-            if ((flags[A] & 128) == 0)
+            if ((flags[sam->A] & 128) == 0)
             {
                 pos++;
                 continue;
             }
             // If next phoneme is stressed, continue processing phonemes
             // FIXME: How does a pause get stressed?
-            if (stress[X] != 0)
+            if (sam->stress[sam->X] != 0)
             {
                 pos++;
                 continue;
@@ -1129,21 +1051,21 @@ void Parser2()
             // Set phonemes to DX
             if (debug)
                 printf("RULE: Soften T or D following vowel or ER and preceding a pause -> DX\r\n");
-            phonemeindex[pos] = 30; // 'DX'
+            sam->phonemeindex[pos] = 30; // 'DX'
         }
         else
         {
-            A = phonemeindex[X + 1];
-            if (A == 255) //prevent buffer overflow
-                A = 65 & 128;
+            sam->A = sam->phonemeindex[sam->X + 1];
+            if (sam->A == 255) //prevent buffer overflow
+                sam->A = 65 & 128;
             else
                 // Is next phoneme a vowel or ER?
-                A = flags[A] & 128;
+                sam->A = flags[sam->A] & 128;
             if (debug)
-                if (A != 0)
+                if (sam->A != 0)
                     printf("RULE: Soften T or D following vowel or ER and preceding a pause -> DX\r\n");
-            if (A != 0)
-                phonemeindex[pos] = 30; // 'DX'
+            if (sam->A != 0)
+                sam->phonemeindex[pos] = 30; // 'DX'
         }
 
         pos++;
@@ -1162,7 +1084,7 @@ void Parser2()
 //         <LIQUID CONSONANT> <DIPHTONG> - decrease by 2
 
 //void Code48619()
-void AdjustLengths()
+void AdjustLengths(SamContext *sam)
 {
 
     // LENGTHEN VOWELS PRECEDING PUNCTUATION
@@ -1173,7 +1095,7 @@ void AdjustLengths()
     // increased by (length * 1.5) + 1
 
     // loop index
-    X = 0;
+    sam->X = 0;
     unsigned char index;
 
     // iterate through the phoneme list
@@ -1181,7 +1103,7 @@ void AdjustLengths()
     while (1)
     {
         // get a phoneme
-        index = phonemeindex[X];
+        index = sam->phonemeindex[sam->X];
 
         // exit loop if end on buffer token
         if (index == 255)
@@ -1191,25 +1113,25 @@ void AdjustLengths()
         if ((flags2[index] & 1) == 0)
         {
             // skip
-            X++;
+            sam->X++;
             continue;
         }
 
         // hold index
-        loopIndex = X;
+        loopIndex = sam->X;
 
         // Loop backwards from this point
     pos48644:
 
         // back up one phoneme
-        X--;
+        sam->X--;
 
         // stop once the beginning is reached
-        if (X == 0)
+        if (sam->X == 0)
             break;
 
         // get the preceding phoneme
-        index = phonemeindex[X];
+        index = sam->phonemeindex[sam->X];
 
         if (index != 255) //inserted to prevent access overrun
             if ((flags[index] & 128) == 0)
@@ -1219,7 +1141,7 @@ void AdjustLengths()
         do
         {
             // test for vowel
-            index = phonemeindex[X];
+            index = sam->phonemeindex[sam->X];
 
             if (index != 255) //inserted to prevent access overrun
                 // test for fricative/unvoiced or not voiced
@@ -1229,29 +1151,29 @@ void AdjustLengths()
                     //if(A == 0) goto pos48688;
 
                     // get the phoneme length
-                    A = phonemeLength[X];
+                    sam->A = sam->phonemeLength[sam->X];
 
                     // change phoneme length to (length * 1.5) + 1
-                    A = (A >> 1) + A + 1;
+                    sam->A = (sam->A >> 1) + sam->A + 1;
                     if (debug)
                         printf("RULE: Lengthen <FRICATIVE> or <VOICED> between <VOWEL> and <PUNCTUATION> by 1.5\r\n");
                     if (debug)
                         printf("PRE\r\n");
                     if (debug)
-                        printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                        printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
 
-                    phonemeLength[X] = A;
+                    sam->phonemeLength[sam->X] = sam->A;
 
                     if (debug)
                         printf("POST\r\n");
                     if (debug)
-                        printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                        printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
                 }
             // keep moving forward
-            X++;
-        } while (X != loopIndex);
+            sam->X++;
+        } while (sam->X != loopIndex);
         //  if (X != loopIndex) goto pos48657;
-        X++;
+        sam->X++;
     } // while
 
     // Similar to the above routine, but shorten vowels under some circumstances
@@ -1263,26 +1185,26 @@ void AdjustLengths()
     while (1)
     {
         // get a phoneme
-        X = loopIndex;
-        index = phonemeindex[X];
+        sam->X = loopIndex;
+        index = sam->phonemeindex[sam->X];
 
         // exit routine at end token
         if (index == 255)
             return;
 
         // vowel?
-        A = flags[index] & 128;
-        if (A != 0)
+        sam->A = flags[index] & 128;
+        if (sam->A != 0)
         {
             // get next phoneme
-            X++;
-            index = phonemeindex[X];
+            sam->X++;
+            index = sam->phonemeindex[sam->X];
 
             // get flags
             if (index == 255)
-                mem56 = 65; // use if end marker
+                sam->mem56 = 65; // use if end marker
             else
-                mem56 = flags[index];
+                sam->mem56 = flags[index];
 
             // not a consonant
             /// @todo code above check if index == 255, if it is, then flags[index] is out of bounds
@@ -1292,8 +1214,8 @@ void AdjustLengths()
                 if ((index == 18) || (index == 19)) // 'RX' & 'LX'
                 {
                     // get the next phoneme
-                    X++;
-                    index = phonemeindex[X];
+                    sam->X++;
+                    index = sam->phonemeindex[sam->X];
 
                     // next phoneme a consonant?
                     if ((flags[index] & 64) != 0)
@@ -1305,15 +1227,15 @@ void AdjustLengths()
                         if (debug)
                             printf("PRE\r\n");
                         if (debug)
-                            printf("phoneme %d (%c%c) length %d\r\n", loopIndex, signInputTable1[phonemeindex[loopIndex]], signInputTable2[phonemeindex[loopIndex]], phonemeLength[loopIndex]);
+                            printf("phoneme %d (%c%c) length %d\r\n", loopIndex, signInputTable1[sam->phonemeindex[loopIndex]], signInputTable2[sam->phonemeindex[loopIndex]], sam->phonemeLength[loopIndex]);
 
                         // decrease length of vowel by 1 frame
-                        phonemeLength[loopIndex]--;
+                        sam->phonemeLength[loopIndex]--;
 
                         if (debug)
                             printf("POST\r\n");
                         if (debug)
-                            printf("phoneme %d (%c%c) length %d\r\n", loopIndex, signInputTable1[phonemeindex[loopIndex]], signInputTable2[phonemeindex[loopIndex]], phonemeLength[loopIndex]);
+                            printf("phoneme %d (%c%c) length %d\r\n", loopIndex, signInputTable1[sam->phonemeindex[loopIndex]], signInputTable2[sam->phonemeindex[loopIndex]], sam->phonemeLength[loopIndex]);
                     }
                     // move ahead
                     loopIndex++;
@@ -1327,14 +1249,14 @@ void AdjustLengths()
             // Got here if not <VOWEL>
 
             // not voiced
-            if ((mem56 & 4) == 0)
+            if ((sam->mem56 & 4) == 0)
             {
 
                 // Unvoiced
                 // *, .*, ?*, ,*, -*, DX, S*, SH, F*, TH, /H, /X, CH, P*, T*, K*, KX
 
                 // not an unvoiced plosive?
-                if ((mem56 & 1) == 0)
+                if ((sam->mem56 & 1) == 0)
                 {
                     // move ahead
                     loopIndex++;
@@ -1347,23 +1269,23 @@ void AdjustLengths()
                 // <VOWEL> <P*, T*, K*, KX>
 
                 // move back
-                X--;
+                sam->X--;
 
                 if (debug)
                     printf("RULE: <VOWEL> <UNVOICED PLOSIVE> - decrease vowel by 1/8th\r\n");
                 if (debug)
                     printf("PRE\r\n");
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
 
                 // decrease length by 1/8th
-                mem56 = phonemeLength[X] >> 3;
-                phonemeLength[X] -= mem56;
+                sam->mem56 = sam->phonemeLength[sam->X] >> 3;
+                sam->phonemeLength[sam->X] -= sam->mem56;
 
                 if (debug)
                     printf("POST\r\n");
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
 
                 // move ahead
                 loopIndex++;
@@ -1378,16 +1300,16 @@ void AdjustLengths()
             if (debug)
                 printf("PRE\r\n");
             if (debug)
-                printf("phoneme %d (%c%c) length %d\r\n", X - 1, signInputTable1[phonemeindex[X - 1]], signInputTable2[phonemeindex[X - 1]], phonemeLength[X - 1]);
+                printf("phoneme %d (%c%c) length %d\r\n", sam->X - 1, signInputTable1[sam->phonemeindex[sam->X - 1]], signInputTable2[sam->phonemeindex[sam->X - 1]], sam->phonemeLength[sam->X - 1]);
 
             // decrease length
-            A = phonemeLength[X - 1];
-            phonemeLength[X - 1] = (A >> 2) + A + 1; // 5/4*A + 1
+            sam->A = sam->phonemeLength[sam->X - 1];
+            sam->phonemeLength[sam->X - 1] = (sam->A >> 2) + sam->A + 1; // 5/4*A + 1
 
             if (debug)
                 printf("POST\r\n");
             if (debug)
-                printf("phoneme %d (%c%c) length %d\r\n", X - 1, signInputTable1[phonemeindex[X - 1]], signInputTable2[phonemeindex[X - 1]], phonemeLength[X - 1]);
+                printf("phoneme %d (%c%c) length %d\r\n", sam->X - 1, signInputTable1[sam->phonemeindex[sam->X - 1]], signInputTable2[sam->phonemeindex[sam->X - 1]], sam->phonemeLength[sam->X - 1]);
 
             // move ahead
             loopIndex++;
@@ -1409,17 +1331,17 @@ void AdjustLengths()
             // M*, N*, NX,
 
             // get the next phoneme
-            X++;
-            index = phonemeindex[X];
+            sam->X++;
+            index = sam->phonemeindex[sam->X];
 
             // end of buffer?
             if (index == 255)
-                A = 65 & 2; //prevent buffer overflow
+                sam->A = 65 & 2; //prevent buffer overflow
             else
-                A = flags[index] & 2; // check for stop consonant
+                sam->A = flags[index] & 2; // check for stop consonant
 
             // is next phoneme a stop consonant?
-            if (A != 0)
+            if (sam->A != 0)
 
             // B*, D*, G*, GX, P*, T*, K*, KX
 
@@ -1429,22 +1351,22 @@ void AdjustLengths()
                 if (debug)
                     printf("POST\r\n");
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X - 1, signInputTable1[phonemeindex[X - 1]], signInputTable2[phonemeindex[X - 1]], phonemeLength[X - 1]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X - 1, signInputTable1[sam->phonemeindex[sam->X - 1]], signInputTable2[sam->phonemeindex[sam->X - 1]], sam->phonemeLength[sam->X - 1]);
 
                 // set stop consonant length to 6
-                phonemeLength[X] = 6;
+                sam->phonemeLength[sam->X] = 6;
 
                 // set nasal length to 5
-                phonemeLength[X - 1] = 5;
+                sam->phonemeLength[sam->X - 1] = 5;
 
                 if (debug)
                     printf("POST\r\n");
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X - 1, signInputTable1[phonemeindex[X - 1]], signInputTable2[phonemeindex[X - 1]], phonemeLength[X - 1]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X - 1, signInputTable1[sam->phonemeindex[sam->X - 1]], signInputTable2[sam->phonemeindex[sam->X - 1]], sam->phonemeLength[sam->X - 1]);
             }
             // move to next phoneme
             loopIndex++;
@@ -1465,8 +1387,8 @@ void AdjustLengths()
             do
             {
                 // move ahead
-                X++;
-                index = phonemeindex[X];
+                sam->X++;
+                index = sam->phonemeindex[sam->X];
             } while (index == 0);
 
             // check for end of buffer
@@ -1492,24 +1414,24 @@ void AdjustLengths()
             if (debug)
                 printf("PRE\r\n");
             if (debug)
-                printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
             if (debug)
-                printf("phoneme %d (%c%c) length %d\r\n", X - 1, signInputTable1[phonemeindex[X - 1]], signInputTable2[phonemeindex[X - 1]], phonemeLength[X - 1]);
+                printf("phoneme %d (%c%c) length %d\r\n", sam->X - 1, signInputTable1[sam->phonemeindex[sam->X - 1]], signInputTable2[sam->phonemeindex[sam->X - 1]], sam->phonemeLength[sam->X - 1]);
             // X gets overwritten, so hold prior X value for debug statement
-            int debugX = X;
+            int debugX = sam->X;
             // shorten the prior phoneme length to (length/2 + 1)
-            phonemeLength[X] = (phonemeLength[X] >> 1) + 1;
-            X = loopIndex;
+            sam->phonemeLength[sam->X] = (sam->phonemeLength[sam->X] >> 1) + 1;
+            sam->X = loopIndex;
 
             // also shorten this phoneme length to (length/2 +1)
-            phonemeLength[loopIndex] = (phonemeLength[loopIndex] >> 1) + 1;
+            sam->phonemeLength[loopIndex] = (sam->phonemeLength[loopIndex] >> 1) + 1;
 
             if (debug)
                 printf("POST\r\n");
             if (debug)
-                printf("phoneme %d (%c%c) length %d\r\n", debugX, signInputTable1[phonemeindex[debugX]], signInputTable2[phonemeindex[debugX]], phonemeLength[debugX]);
+                printf("phoneme %d (%c%c) length %d\r\n", debugX, signInputTable1[sam->phonemeindex[debugX]], signInputTable2[sam->phonemeindex[debugX]], sam->phonemeLength[debugX]);
             if (debug)
-                printf("phoneme %d (%c%c) length %d\r\n", debugX - 1, signInputTable1[phonemeindex[debugX - 1]], signInputTable2[phonemeindex[debugX - 1]], phonemeLength[debugX - 1]);
+                printf("phoneme %d (%c%c) length %d\r\n", debugX - 1, signInputTable1[sam->phonemeindex[debugX - 1]], signInputTable2[sam->phonemeindex[debugX - 1]], sam->phonemeLength[debugX - 1]);
 
             // move ahead
             loopIndex++;
@@ -1527,7 +1449,7 @@ void AdjustLengths()
             // R*, L*, W*, Y*
 
             // get the prior phoneme
-            index = phonemeindex[X - 1];
+            index = sam->phonemeindex[sam->X - 1];
 
             // prior phoneme a stop consonant>
             if ((flags[index] & 2) != 0)
@@ -1539,15 +1461,15 @@ void AdjustLengths()
                 if (debug)
                     printf("PRE\r\n");
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
 
                 // decrease the phoneme length by 2 frames (20 ms)
-                phonemeLength[X] -= 2;
+                sam->phonemeLength[sam->X] -= 2;
 
                 if (debug)
                     printf("POST\r\n");
                 if (debug)
-                    printf("phoneme %d (%c%c) length %d\r\n", X, signInputTable1[phonemeindex[X]], signInputTable2[phonemeindex[X]], phonemeLength[X]);
+                    printf("phoneme %d (%c%c) length %d\r\n", sam->X, signInputTable1[sam->phonemeindex[sam->X]], signInputTable2[sam->phonemeindex[sam->X]], sam->phonemeLength[sam->X]);
             }
         }
 
@@ -1560,32 +1482,32 @@ void AdjustLengths()
 
 // -------------------------------------------------------------------------
 // ML : Code47503 is division with remainder, and mem50 gets the sign
-void Code47503(unsigned char mem52)
+void Code47503(SamContext *sam, unsigned char mem52)
 {
 
-    Y = 0;
-    if ((mem53 & 128) != 0)
+    sam->Y = 0;
+    if ((sam->mem53 & 128) != 0)
     {
-        mem53 = -mem53;
-        Y = 128;
+        sam->mem53 = -sam->mem53;
+        sam->Y = 128;
     }
-    mem50 = Y;
-    A = 0;
-    for (X = 8; X > 0; X--)
+    sam->mem50 = sam->Y;
+    sam->A = 0;
+    for (sam->X = 8; sam->X > 0; sam->X--)
     {
-        int temp = mem53;
-        mem53 = mem53 << 1;
-        A = A << 1;
+        int temp = sam->mem53;
+        sam->mem53 = sam->mem53 << 1;
+        sam->A = sam->A << 1;
         if (temp >= 128)
-            A++;
-        if (A >= mem52)
+            sam->A++;
+        if (sam->A >= mem52)
         {
-            A = A - mem52;
-            mem53++;
+            sam->A = sam->A - mem52;
+            sam->mem53++;
         }
     }
 
-    mem51 = A;
-    if ((mem50 & 128) != 0)
-        mem53 = -mem53;
+    sam->mem51 = sam->A;
+    if ((sam->mem50 & 128) != 0)
+        sam->mem53 = -sam->mem53;
 }
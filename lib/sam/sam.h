@@ -6,21 +6,38 @@ extern "C"
 {
 #endif
 
-    void SetInput(char *_input);
-    void SetSpeed(unsigned char _speed);
-    void SetPitch(unsigned char _pitch);
-    void SetMouth(unsigned char _mouth);
-    void SetThroat(unsigned char _throat);
-    void EnableSingmode();
-    void DisableSingmode();
-    void EnableDebug();
-
-    int SAMMain();
-
-    char *GetBuffer();
-    int GetBufferLength();
-    void FreeBuffer();
-    
+#define SAM_SAMPLE_RATE 22050
+
+    // One voice: its settings, the text queued for it and the speech being
+    // rendered. Contexts share nothing, so each can be driven from its own
+    // task, or several from one.
+    typedef struct SamContext SamContext;
+
+    SamContext *SamCreate();
+    void SamDestroy(SamContext *sam);
+
+    // Settings apply from the next segment of text to be rendered
+    void SamSetSpeed(SamContext *sam, unsigned char speed);
+    void SamSetPitch(SamContext *sam, unsigned char pitch);
+    void SamSetMouth(SamContext *sam, unsigned char mouth);
+    void SamSetThroat(SamContext *sam, unsigned char throat);
+    void SamSetSingmode(SamContext *sam, int singmode);
+
+    // Queue text, or phonemes when phonetic is set, to be said after
+    // anything already queued. Returns 0 if it could not be queued.
+    int SamSay(SamContext *sam, const char *text, int phonetic);
+
+    // Take up to len 8 bit unsigned samples at SAM_SAMPLE_RATE. Speech is
+    // rendered as it is read, a glottal pulse at a time. Returns the number
+    // of samples taken, 0 once everything queued has been said.
+    int SamRead(SamContext *sam, unsigned char *samples, int len);
+
+    // Drop the queued text and the speech being rendered
+    void SamStop(SamContext *sam);
+
+    // Segments whose phonemes came from the phoneme cache
+    unsigned int SamCacheHits(const SamContext *sam);
+
     //char input[]={"/HAALAOAO MAYN NAAMAEAE IHSTT SAEBAASTTIHAAN \x9b\x9b\0"};
     //unsigned char input[]={"/HAALAOAO \x9b\0"};
     //unsigned char input[]={"AA \x9b\0"};
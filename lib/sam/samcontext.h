@@ -0,0 +1,115 @@
+#ifndef SAM_CONTEXT_H
+#define SAM_CONTEXT_H
+
+#include "sam.h"
+
+// Samples rendered but not yet taken by SamRead(). The renderer is only
+// stepped once everything rendered so far has been taken, and no step writes
+// more than an unvoiced sampled phoneme (1984 outputs of at most 167/50
+// samples each) plus the five samples each output writes ahead, so 8K holds
+// any step.
+#define SAM_RING_SIZE 8192
+
+// The reciter writes its phonemes over its input in a 256 byte buffer, and a
+// line of English comes out about one and a half times as long in phonemes.
+// Longer text is said a segment at a time, broken after punctuation or
+// between words.
+#define SAM_SEGMENT_MAX 120
+#define SAM_PHONETIC_SEGMENT_MAX 250
+
+// Parsed phonemes of recently said segments
+#define SAM_CACHE_ENTRIES 8
+
+typedef struct SamCacheEntry
+{
+    char *key;                  // mode byte then the segment as given to the parser
+    unsigned char *phonemes;    // index, length and stress of each phoneme, up to the 255 end marker
+    int count;
+    unsigned int used;
+} SamCacheEntry;
+
+struct SamContext
+{
+    //standard sam sound
+    unsigned char speed;
+    unsigned char pitch;
+    unsigned char mouth;
+    unsigned char throat;
+    int singmode;
+
+    char input[256]; //tab39445
+
+    // registers and zero page of the 6502 original
+    unsigned char A, X, Y;
+    unsigned char mem39;
+    unsigned char mem44;
+    unsigned char mem47;
+    unsigned char mem49;
+    unsigned char mem50;
+    unsigned char mem51;
+    unsigned char mem53;
+    unsigned char mem56;
+    unsigned char mem59;
+
+    unsigned char stress[256];        //numbers from 0 to 8
+    unsigned char phonemeLength[256]; //tab40160
+    unsigned char phonemeindex[256];
+
+    unsigned char phonemeIndexOutput[60];  //tab47296
+    unsigned char stressOutput[60];        //tab47365
+    unsigned char phonemeLengthOutput[60]; //tab47416
+
+    // frames of the breath group being rendered
+    unsigned char pitches[256]; // tab43008
+    unsigned char frequency1[256];
+    unsigned char frequency2[256];
+    unsigned char frequency3[256];
+    unsigned char amplitude1[256];
+    unsigned char amplitude2[256];
+    unsigned char amplitude3[256];
+    unsigned char sampledConsonantFlag[256]; // tab44800
+
+    // formant tables with this voice's mouth and throat applied
+    unsigned char freq1data[80];
+    unsigned char freq2data[80];
+
+    // Render() loop state kept between RenderStep() calls
+    unsigned char phase1;
+    unsigned char phase2;
+    unsigned char phase3;
+    unsigned char mem38;
+    unsigned char mem48;
+    unsigned char mem66;
+    unsigned char speedcounter;
+    int rendering;
+
+    // PrepareOutput() position in phonemeindex[]
+    unsigned char outputPosition;
+    int outputDone;
+
+    // bufferpos counts 1/50ths of a sample; samples before bufferpos / 50
+    // are final, and emitted of them have been read
+    int bufferpos;
+    int emitted;
+    unsigned char oldtimetableindex;
+    unsigned char ring[SAM_RING_SIZE];
+
+    // text queued by SamSay(): records of a mode byte, the text and a NUL
+    char *text;
+    int textLength;
+    int textSize;
+    int textPosition;   // next segment starts here
+    int segmentActive;
+
+    SamCacheEntry cache[SAM_CACHE_ENTRIES];
+    unsigned int cacheClock;
+    unsigned int cacheHits;
+};
+
+// Parse input[] into phonemeindex[], phonemeLength[] and stress[]
+int SAMMain(SamContext *sam);
+
+// Copy the next breath group of the parsed phonemes to the output tables
+int PrepareOutput(SamContext *sam);
+
+#endif
@@ -15,15 +15,13 @@
   #include "compat_string.h"
 #endif
 
-#include "fnSystem.h"
+#include <mutex>
+#include <string>
 
-#ifdef __cplusplus
-extern char input[256];
-extern char *buffer;
-#endif
+#include "fnSystem.h"
 
 int debug = 0;
-const uint32_t sample_rate = 22050;//110000l;
+const uint32_t sample_rate = SAM_SAMPLE_RATE;//110000l;
 
 
 #ifdef CONFIG_IDF_TARGET_ESP32S3
@@ -39,39 +37,41 @@ const uint32_t sample_rate = 22050;//110000l;
 #endif
 
 
-void SendI2S (i2s_chan_handle_t tx_handle, char *s, size_t n)
+// Send what sam renders to each channel given, a block at a time, so the
+// first block plays while the rest is rendered
+void SendI2S (i2s_chan_handle_t *tx_handles, int channels, SamContext *sam)
 {
 // number of frames to try and send at once (a frame is a left and right sample)
         const size_t NUM_FRAMES_TO_SEND=1023;//1024;
         int16_t * m_tmp_frames = (int16_t *)malloc(sizeof(int16_t) * NUM_FRAMES_TO_SEND);
+        char * s = (char *)malloc(NUM_FRAMES_TO_SEND);
         int16_t iTmp;
         esp_err_t res;
         size_t bytes_written;
         int samples_to_send;
-        int sample_index = 0;
 
-        while (sample_index < n)
+        while ((samples_to_send = SamRead(sam, (unsigned char *)s, NUM_FRAMES_TO_SEND)) > 0)
         {
-          samples_to_send = 0;
-
-          for (int i = 0; i < NUM_FRAMES_TO_SEND && sample_index < n; i++)
+          for (int i = 0; i < samples_to_send; i++)
           {
             // shift up to 16 bit samples
-            iTmp = ((int16_t) (s[sample_index])) << 8;
+            iTmp = ((int16_t) (s[i])) << 8;
             m_tmp_frames[i] = iTmp;
-            samples_to_send++;
-            sample_index++;
           }
-          // write data to the i2s peripheral
-          bytes_written = 0;
-          res = i2s_channel_write(tx_handle, m_tmp_frames,  samples_to_send * sizeof(int16_t), &bytes_written, 1000 / portTICK_PERIOD_MS);
-          if (res != ESP_OK)
+          // write data to the i2s peripherals
+          for (int c = 0; c < channels; c++)
           {
-            printf ("Error sending audio data: %d", res);
+            bytes_written = 0;
+            res = i2s_channel_write(tx_handles[c], m_tmp_frames,  samples_to_send * sizeof(int16_t), &bytes_written, 1000 / portTICK_PERIOD_MS);
+            if (res != ESP_OK)
+            {
+              printf ("Error sending audio data: %d", res);
+            }
+            printf ("i2s write : Send %d Bytes of %d Samples \n", bytes_written, samples_to_send);
           }
-          printf ("i2s write : Send %d Bytes of %d/%d Samples \n", bytes_written, samples_to_send, n);
         }
-        
+
+        free(s);
         free(m_tmp_frames);
 
 }
@@ -79,44 +79,6 @@ void SendI2S (i2s_chan_handle_t tx_handle, char *s, size_t n)
 
 #endif
 
-#ifndef ESP_PLATFORM
-
-void WriteWav(char *filename, char *buffer, int bufferlength)
-{
-    FILE *file = fopen(filename, "wb");
-    if (file == NULL)
-        return;
-    //RIFF header
-    fwrite("RIFF", 4, 1, file);
-    unsigned int filesize = bufferlength + 12 + 16 + 8 - 8;
-    fwrite(&filesize, 4, 1, file);
-    fwrite("WAVE", 4, 1, file);
-
-    //format chunk
-    fwrite("fmt ", 4, 1, file);
-    unsigned int fmtlength = 16;
-    fwrite(&fmtlength, 4, 1, file);
-    unsigned short int format = 1; //PCM
-    fwrite(&format, 2, 1, file);
-    unsigned short int channels = 1;
-    fwrite(&channels, 2, 1, file);
-    unsigned int samplerate = 22050;
-    fwrite(&samplerate, 4, 1, file);
-    fwrite(&samplerate, 4, 1, file); // bytes/second
-    unsigned short int blockalign = 1;
-    fwrite(&blockalign, 2, 1, file);
-    unsigned short int bitspersample = 8;
-    fwrite(&bitspersample, 2, 1, file);
-
-    //data chunk
-    fwrite("data", 4, 1, file);
-    fwrite(&bufferlength, 4, 1, file);
-    fwrite(buffer, bufferlength, 1, file);
-
-    fclose(file);
-}
-#endif // NOT ESP_PLATFORM
-
 void PrintUsage()
 {
     /*
@@ -167,27 +129,19 @@ void PrintUsage()
 
 #ifdef USESDL
 
-int pos = 0;
-void MixAudio(void *unused, Uint8 *stream, int len)
+static bool done = false;
+void MixAudio(void *userdata, Uint8 *stream, int len)
 {
-    int bufferpos = GetBufferLength();
-    char *buffer = GetBuffer();
-    int i;
-    if (pos >= bufferpos)
+    SamContext *sam = (SamContext *)userdata;
+    if (done)
         return;
-    if ((bufferpos - pos) < len)
-        len = (bufferpos - pos);
-    for (i = 0; i < len; i++)
-    {
-        stream[i] = buffer[pos];
-        pos++;
-    }
+    if (SamRead(sam, stream, len) < len)
+        done = true;
 }
 
-void OutputSound()
+void OutputSound(SamContext *sam)
 {
-    int bufferpos = GetBufferLength();
-    bufferpos /= 50;
+    done = false;
     SDL_AudioSpec fmt;
 
     fmt.freq = 22050;
@@ -195,7 +149,7 @@ void OutputSound()
     fmt.channels = 1;
     fmt.samples = 2048;
     fmt.callback = MixAudio;
-    fmt.userdata = NULL;
+    fmt.userdata = sam;
 
     /* Open the audio device and start playing sound! */
     if (SDL_OpenAudio(&fmt, NULL) < 0)
@@ -206,7 +160,7 @@ void OutputSound()
     SDL_PauseAudio(0);
     //SDL_Delay((bufferpos)/7);
 
-    while (pos < bufferpos)
+    while (!done)
     {
         SDL_Delay(100);
     }
@@ -217,11 +171,11 @@ void OutputSound()
 #else //Not def USESDL
 
 #ifdef ESP_PLATFORM
-void OutputSound()
+void OutputSound(SamContext *sam)
 {
 #ifndef CONFIG_IDF_TARGET_ESP32S3
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
+    unsigned char s[256];
+    int n;
 
     dac_oneshot_handle_t dac_handle;
     dac_oneshot_config_t config = {
@@ -229,17 +183,19 @@ void OutputSound()
     };
 
     if (dac_oneshot_new_channel(&config, &dac_handle) == ESP_OK) {
-        for (int i = 0; i < n; i++) {
-            dac_oneshot_output_voltage(dac_handle, (uint8_t)s[i]); // ensure unsigned
-            fnSystem.delay_microseconds(40);
+        while ((n = SamRead(sam, s, sizeof(s))) > 0) {
+            for (int i = 0; i < n; i++) {
+                dac_oneshot_output_voltage(dac_handle, s[i]);
+                fnSystem.delay_microseconds(40);
+            }
         }
         dac_oneshot_del_channel(dac_handle);
     }
 #else //Defined CONFIG_IDF_TARGET_ESP32S3
 //SampleRate = 22050
 //8 Bits
-    int n = GetBufferLength() / 50;
-    char *s = GetBuffer();
+    i2s_chan_handle_t tx_handles[2];
+    int channels = 0;
     //PDMOutput *audioOutput = NULL;
 
 
@@ -294,13 +250,7 @@ void OutputSound()
 
         i2s_channel_init_pdm_tx_mode(tx_handle, &pdm_tx_cfg);
         i2s_channel_enable(tx_handle);
-
-        SendI2S (tx_handle, s, n);
-
-        /* Have to stop the channel before deleting it */
-        i2s_channel_disable(tx_handle);
-        /* If the handle is not needed any more, delete it to release the channel resources */
-        i2s_del_channel(tx_handle);
+        tx_handles[channels++] = tx_handle;
         
 //#ifdef ESP32S3_I2S_OUT
 //    }
@@ -343,19 +293,24 @@ void OutputSound()
         i2s_channel_enable(tx_handle);
 
         //i2s_channel_write(tx_handle, src_buf, bytes_to_write, bytes_written, ticks_to_wait);
-        //i2s_channel_write(tx_handle, s, n, &bytes_written, 1000 / portTICK_PERIOD_MS);
-        SendI2S (tx_handle, s, n);
-
-        /* Have to stop the channel before deleting it */
-        i2s_channel_disable(tx_handle);
-        /* If the handle is not needed any more, delete it to release the channel resources */
-        i2s_del_channel(tx_handle);
+        tx_handles[channels++] = tx_handle;
 
 // /I2S_STD
 
     }
 #endif    //ESP32S3_I2S_OUT
 
+    // Both outputs play each block as it is rendered
+    SendI2S (tx_handles, channels, sam);
+
+    for (int c = 0; c < channels; c++)
+    {
+        /* Have to stop the channel before deleting it */
+        i2s_channel_disable(tx_handles[c]);
+        /* If the handle is not needed any more, delete it to release the channel resources */
+        i2s_del_channel(tx_handles[c]);
+    }
+
 #endif //CONFIG_IDF_TARGET_ESP32S3
 }
 
@@ -363,37 +318,30 @@ void OutputSound()
 #else
 // !ESP_PLATFORM
 
-static int pos = 0;
+struct playback
+{
+    SamContext *sam;
+    bool done;
+};
+
 void data_callback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount)
 {
-    int bufferpos = GetBufferLength() / 50;
-    char *buffer = GetBuffer();
-    int i;
-    bool *done_ptr = static_cast<bool *>(pDevice->pUserData);
-    if (pos >= bufferpos)
-    {
-        *done_ptr = true;
+    playback *play = static_cast<playback *>(pDevice->pUserData);
+    if (play->done)
         return;
-    }
-    if ((bufferpos - pos) < frameCount)
-        frameCount = (bufferpos - pos);
-    for (i = 0; i < frameCount; i++)
-    {
-        ((char *)pOutput)[i] = buffer[pos];
-        pos++;
-    }
+    if (SamRead(play->sam, (unsigned char *)pOutput, frameCount) < (int)frameCount)
+        play->done = true;
 }
 
-void OutputSound()
+void OutputSound(SamContext *sam)
 {
-    pos = 0;
-    bool done = false;
+    playback play = { sam, false };
     ma_device_config config  = ma_device_config_init(ma_device_type_playback);
     config.playback.format   = ma_format_u8;    // Set to ma_format_unknown to use the device's native format.
     config.playback.channels = 1;               // Set to 0 to use the device's native channel count.
     config.sampleRate        = sample_rate;     // Set to 0 to use the device's native sample rate.
     config.dataCallback      = data_callback;   // This function will be called when miniaudio needs more data.
-    config.pUserData         = &done;           // Can be accessed from the device object (device.pUserData).
+    config.pUserData         = &play;           // Can be accessed from the device object (device.pUserData).
 
     ma_device device;
     if (ma_device_init(NULL, &config, &device) != MA_SUCCESS) {
@@ -403,7 +351,7 @@ void OutputSound()
     ma_device_start(&device);     // The device is sleeping by default so you'll need to start it manually.
 
     // Do something here.
-    while (!done) {
+    while (!play.done) {
         fnSystem.delay(100);
     }
 
@@ -417,29 +365,45 @@ void OutputSound()
 
 int sam(int argc, char **argv)
 {
+    // One voice for every caller, so that phrases said again come from its
+    // phoneme cache
+    static std::mutex voice_mutex;
+    static SamContext *voice = nullptr;
+
     int i;
     int phonetic = 0;
+    std::string phrase;
 
 #ifndef ESP_PLATFORM
     char *wavfilename = NULL;
 #endif
 
-    for (i = 0; i < 256; i++)
-        input[i] = 0;
-
     if (argc <= 1)
     {
         PrintUsage();
         return 1;
     }
 
+    std::lock_guard<std::mutex> lock(voice_mutex);
+    if (voice == nullptr)
+        voice = SamCreate();
+    if (voice == nullptr)
+        return 1;
+
+    //standard sam sound unless the arguments say otherwise
+    SamSetSpeed(voice, 72);
+    SamSetPitch(voice, 64);
+    SamSetMouth(voice, 128);
+    SamSetThroat(voice, 128);
+    SamSetSingmode(voice, 0);
+
     i = 1;
     while (i < argc)
     {
         if (argv[i][0] != '-')
         {
-            strlcat(input, argv[i], 255);
-            strlcat(input, " ", 255);
+            phrase += argv[i];
+            phrase += " ";
         }
         else
         {
@@ -455,11 +419,11 @@ int sam(int argc, char **argv)
 
             if (strcmp(&argv[i][1], "sing") == 0)
             {
-                EnableSingmode();
+                SamSetSingmode(voice, 1);
             }
             else if (strcmp(&argv[i][1], "no-sing") == 0)
             {
-                DisableSingmode();
+                SamSetSingmode(voice, 0);
             }
 //            else if (strcmp(&argv[i][1], "samplerate") == 0)
 //            {
@@ -479,22 +443,22 @@ int sam(int argc, char **argv)
             }
             else if (strcmp(&argv[i][1], "pitch") == 0)
             {
-                SetPitch(atoi(argv[i + 1]));
+                SamSetPitch(voice, atoi(argv[i + 1]));
                 i++;
             }
             else if (strcmp(&argv[i][1], "speed") == 0)
             {
-                SetSpeed(atoi(argv[i + 1]));
+                SamSetSpeed(voice, atoi(argv[i + 1]));
                 i++;
             }
             else if (strcmp(&argv[i][1], "mouth") == 0)
             {
-                SetMouth(atoi(argv[i + 1]));
+                SamSetMouth(voice, atoi(argv[i + 1]));
                 i++;
             }
             else if (strcmp(&argv[i][1], "throat") == 0)
             {
-                SetThroat(atoi(argv[i + 1]));
+                SamSetThroat(voice, atoi(argv[i + 1]));
                 i++;
             }
 #ifdef ESP32S3_I2S_OUT
@@ -515,31 +479,14 @@ int sam(int argc, char **argv)
 
     // printf("arg parsing done\r\n");
 
-    for (i = 0; input[i] != 0; i++)
-        input[i] = toupper((int)input[i]);
-
     if (debug)
     {
         if (phonetic)
-            printf("phonetic input: %s\r\n", input);
+            printf("phonetic input: %s\r\n", phrase.c_str());
         else
-            printf("text input: %s\r\n", input);
+            printf("text input: %s\r\n", phrase.c_str());
     }
 
-    if (!phonetic)
-    {
-        strlcat(input, "[", sizeof(input) - strlen(input));
-        // printf("TextToPhonemes\r\n");
-        if (!TextToPhonemes((unsigned char *)input))
-            return 1;
-        if (debug)
-            printf("phonetic input: %s\r\n", input);
-    }
-    else
-        strlcat(input, "\x9b", sizeof(input) - strlen(input));
-
-        // printf("done phonetic processing\r\n");
-
 #ifdef USESDL
     if (SDL_Init(SDL_INIT_AUDIO) < 0)
     {
@@ -549,28 +496,19 @@ int sam(int argc, char **argv)
     atexit(SDL_Quit);
 #endif
 
-#ifndef __cplusplus
-    SetInput(input);
-#endif
-
-    // printf("right before SAMMain");
-
-    if (!SAMMain()) // buffer is allocated in SAMMain, used by OutputSound and WriteWav
+    // Rendered as it plays: the first words sound while the rest is rendered
+    if (!SamSay(voice, phrase.c_str(), phonetic))
     {
         PrintUsage();
         return 1;
     }
-    // printf("right after SAMMain");
-
-// apc: any use of WriteWav on fujinet-pc?
-// #ifndef ESP_PLATFORM
-    
-//     if (wavfilename != NULL)
-//         WriteWav(wavfilename, GetBuffer(), GetBufferLength() / 50);
-//     else
-// #endif // ESP_PLATFORM
-        OutputSound();
-
-    FreeBuffer();
+
+#ifndef ESP_PLATFORM
+    if (wavfilename != NULL)
+        WriteWav(wavfilename, voice);
+    else
+#endif // ESP_PLATFORM
+        OutputSound(voice);
+
     return 0;
 }
@@ -16,21 +16,16 @@
 #include "../../include/pinmap.h"
 #endif
 
-#ifdef __cplusplus
-extern char input[256];
-#endif
-
 #ifndef ESP_PLATFORM
-void WriteWav(char *filename, char *buffer, int bufferlength);
+void WriteWav(char *filename, SamContext *sam);
 #endif // ESP_PLATFORM
 
 void PrintUsage();
 
 #ifdef USESDL
 void MixAudio(void *unused, Uint8 *stream, int len);
-void OutputSound();
-#else
-void OutputSound();
 #endif
+// Play what sam has queued, as it is rendered
+void OutputSound(SamContext *sam);
 
 int sam(int argc, char **argv);
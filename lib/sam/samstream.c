@@ -0,0 +1,311 @@
+#include "sam.h"
+
+#ifdef ESP_PLATFORM
+#include <esp_heap_caps.h>
+#endif
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "samcontext.h"
+#include "reciter.h"
+#include "render.h"
+
+// Rebase the sample counters after this many samples (a multiple of the
+// ring size) so that bufferpos, which counts 1/50ths, can't overflow
+#define SAM_REBASE (1 << 20)
+
+SamContext *SamCreate()
+{
+    SamContext *sam = NULL;
+#ifdef ESP_PLATFORM
+    sam = (SamContext *)heap_caps_calloc(1, sizeof(SamContext), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#endif
+    if (sam == NULL)
+        sam = (SamContext *)calloc(1, sizeof(SamContext));
+    if (sam == NULL)
+        return NULL;
+
+    //standard sam sound
+    sam->speed = 72;
+    sam->pitch = 64;
+    sam->mouth = 128;
+    sam->throat = 128;
+    return sam;
+}
+
+void SamDestroy(SamContext *sam)
+{
+    int i;
+    if (sam == NULL)
+        return;
+    for (i = 0; i < SAM_CACHE_ENTRIES; i++)
+    {
+        free(sam->cache[i].key);
+        free(sam->cache[i].phonemes);
+    }
+    free(sam->text);
+    free(sam);
+}
+
+unsigned int SamCacheHits(const SamContext *sam)
+{
+    return sam->cacheHits;
+}
+
+// Start the next utterance from silence, as a fresh buffer did
+static void ResetOutput(SamContext *sam)
+{
+    memset(sam->ring, 0, sizeof(sam->ring));
+    sam->bufferpos = 0;
+    sam->emitted = 0;
+    sam->oldtimetableindex = 0;
+}
+
+void SamStop(SamContext *sam)
+{
+    sam->textLength = 0;
+    sam->textPosition = 0;
+    sam->segmentActive = 0;
+    sam->rendering = 0;
+    ResetOutput(sam);
+}
+
+int SamSay(SamContext *sam, const char *text, int phonetic)
+{
+    int length = strlen(text);
+    int needed;
+
+    // Drop what has already been said
+    if (sam->textPosition > 0)
+    {
+        memmove(sam->text, sam->text + sam->textPosition, sam->textLength - sam->textPosition);
+        sam->textLength -= sam->textPosition;
+        sam->textPosition = 0;
+    }
+
+    needed = sam->textLength + length + 2;
+    if (needed > sam->textSize)
+    {
+        char *grown = (char *)realloc(sam->text, needed);
+        if (grown == NULL)
+            return 0;
+        sam->text = grown;
+        sam->textSize = needed;
+    }
+
+    sam->text[sam->textLength++] = phonetic ? 1 : 0;
+    memcpy(sam->text + sam->textLength, text, length + 1);
+    sam->textLength += length + 1;
+    return 1;
+}
+
+static SamCacheEntry *CacheFind(SamContext *sam, const char *key)
+{
+    int i;
+    for (i = 0; i < SAM_CACHE_ENTRIES; i++)
+    {
+        SamCacheEntry *entry = &sam->cache[i];
+        if (entry->key != NULL && strcmp(entry->key, key) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+static void CacheStore(SamContext *sam, const char *key)
+{
+    SamCacheEntry *entry = &sam->cache[0];
+    int count = 0;
+    int i;
+
+    while (count < 255 && sam->phonemeindex[count] != 255)
+        count++;
+
+    // the least recently used entry, or an empty one
+    for (i = 0; i < SAM_CACHE_ENTRIES; i++)
+    {
+        if (sam->cache[i].key == NULL)
+        {
+            entry = &sam->cache[i];
+            break;
+        }
+        if (sam->cache[i].used < entry->used)
+            entry = &sam->cache[i];
+    }
+    free(entry->key);
+    free(entry->phonemes);
+    entry->key = (char *)malloc(strlen(key) + 1);
+    entry->phonemes = (unsigned char *)malloc(count * 3 + 1);
+    if (entry->key == NULL || entry->phonemes == NULL)
+    {
+        free(entry->key);
+        free(entry->phonemes);
+        entry->key = NULL;
+        entry->phonemes = NULL;
+        return;
+    }
+    strcpy(entry->key, key);
+    memcpy(entry->phonemes, sam->phonemeindex, count);
+    memcpy(entry->phonemes + count, sam->phonemeLength, count);
+    memcpy(entry->phonemes + count * 2, sam->stress, count);
+    entry->count = count;
+    entry->used = ++sam->cacheClock;
+}
+
+// Length of the next segment of text, broken after the last punctuation
+// that fits, or else the last space
+static int SegmentLength(const char *text, int phonetic)
+{
+    int max = phonetic ? SAM_PHONETIC_SEGMENT_MAX : SAM_SEGMENT_MAX;
+    int punctuation = 0;
+    int space = 0;
+    int i;
+
+    if ((int)strlen(text) <= max)
+        return strlen(text);
+
+    for (i = 0; i < max; i++)
+    {
+        if (text[i] == ' ')
+            space = i;
+        else if (strchr(".?!,;:", text[i]) && text[i + 1] == ' ')
+            punctuation = i + 1;
+    }
+    if (punctuation > 0)
+        return punctuation;
+    if (space > 0)
+        return space;
+    return max;
+}
+
+// Parse the next segment of queued text, from the phoneme cache if it was
+// said lately. Returns 0 when nothing is left to say.
+static int StartSegment(SamContext *sam)
+{
+    char key[SAM_PHONETIC_SEGMENT_MAX + 2];
+    SamCacheEntry *entry;
+    const char *text;
+    int phonetic;
+    int length;
+    int i;
+
+    while (sam->textPosition < sam->textLength)
+    {
+        phonetic = sam->text[sam->textPosition];
+        text = sam->text + sam->textPosition + 1;
+        while (*text == ' ')
+            text++;
+
+        length = SegmentLength(text, phonetic);
+        key[0] = phonetic ? 'P' : 'T';
+        for (i = 0; i < length; i++)
+            key[i + 1] = toupper((unsigned char)text[i]);
+        key[length + 1] = 0;
+
+        if (text[length] == 0)
+        {
+            // the rest of this record
+            sam->textPosition = text + length + 1 - sam->text;
+        }
+        else
+        {
+            // the rest is a record of its own
+            sam->textPosition = text + length - 1 - sam->text;
+            sam->text[sam->textPosition] = phonetic;
+        }
+        if (length == 0)
+            continue;
+
+        SetMouthThroat(sam, sam->mouth, sam->throat);
+
+        entry = CacheFind(sam, key);
+        if (entry != NULL)
+        {
+            memcpy(sam->phonemeindex, entry->phonemes, entry->count);
+            memcpy(sam->phonemeLength, entry->phonemes + entry->count, entry->count);
+            memcpy(sam->stress, entry->phonemes + entry->count * 2, entry->count);
+            sam->phonemeindex[entry->count] = 255;
+            sam->outputPosition = 0;
+            sam->outputDone = 0;
+            entry->used = ++sam->cacheClock;
+            sam->cacheHits++;
+            return 1;
+        }
+
+        memset(sam->input, 0, sizeof(sam->input));
+        memcpy(sam->input, key + 1, length);
+        if (!phonetic)
+        {
+            strcat(sam->input, " [");
+            if (!TextToPhonemes((unsigned char *)sam->input))
+                continue;
+        }
+        else
+            strcat(sam->input, " \x9b");
+
+        if (!SAMMain(sam))
+            continue;
+
+        CacheStore(sam, key);
+        return 1;
+    }
+    return 0;
+}
+
+// Render a little more. Returns 0 when there is nothing left to render.
+static int Advance(SamContext *sam)
+{
+    if (sam->rendering)
+    {
+        sam->rendering = RenderStep(sam);
+        return 1;
+    }
+    if (sam->segmentActive)
+    {
+        if (PrepareOutput(sam))
+            sam->rendering = RenderStart(sam);
+        else
+            sam->segmentActive = 0;
+        return 1;
+    }
+    sam->segmentActive = StartSegment(sam);
+    return sam->segmentActive;
+}
+
+int SamRead(SamContext *sam, unsigned char *samples, int len)
+{
+    int n = 0;
+    while (n < len)
+    {
+        // samples before bufferpos / 50 won't be written again
+        int ready = sam->bufferpos / 50 - sam->emitted;
+        if (ready > 0)
+        {
+            int start = sam->emitted & (SAM_RING_SIZE - 1);
+            int take = ready < len - n ? ready : len - n;
+            int first = take < SAM_RING_SIZE - start ? take : SAM_RING_SIZE - start;
+            memcpy(samples + n, sam->ring + start, first);
+            memcpy(samples + n + first, sam->ring, take - first);
+            sam->emitted += take;
+            n += take;
+            continue;
+        }
+
+        if (sam->emitted >= SAM_REBASE)
+        {
+            sam->bufferpos -= SAM_REBASE * 50;
+            sam->emitted -= SAM_REBASE;
+        }
+
+        if (!Advance(sam))
+        {
+            // Everything queued has been said; the few samples written
+            // ahead of the last output are not part of it
+            if (n == 0 && sam->emitted > 0)
+                ResetOutput(sam);
+            break;
+        }
+    }
+    return n;
+}
@@ -0,0 +1,57 @@
+// WriteWav() lives apart from the rest of samlib so that it can be built
+// without the audio device code
+#include "samlib.h"
+
+#include <stdio.h>
+
+#ifndef ESP_PLATFORM
+
+void WriteWav(char *filename, SamContext *sam)
+{
+    FILE *file = fopen(filename, "wb");
+    if (file == NULL)
+        return;
+    //RIFF header, sizes filled in once the speech has been rendered
+    unsigned int bufferlength = 0;
+    fwrite("RIFF", 4, 1, file);
+    // the size of what follows it: WAVE, then the format and data chunks
+    unsigned int filesize = 4 + 8 + 16 + 8 + bufferlength;
+    fwrite(&filesize, 4, 1, file);
+    fwrite("WAVE", 4, 1, file);
+
+    //format chunk
+    fwrite("fmt ", 4, 1, file);
+    unsigned int fmtlength = 16;
+    fwrite(&fmtlength, 4, 1, file);
+    unsigned short int format = 1; //PCM
+    fwrite(&format, 2, 1, file);
+    unsigned short int channels = 1;
+    fwrite(&channels, 2, 1, file);
+    unsigned int samplerate = SAM_SAMPLE_RATE;
+    fwrite(&samplerate, 4, 1, file);
+    fwrite(&samplerate, 4, 1, file); // bytes/second
+    unsigned short int blockalign = 1;
+    fwrite(&blockalign, 2, 1, file);
+    unsigned short int bitspersample = 8;
+    fwrite(&bitspersample, 2, 1, file);
+
+    //data chunk
+    fwrite("data", 4, 1, file);
+    fwrite(&bufferlength, 4, 1, file);
+    unsigned char samples[1024];
+    int n;
+    while ((n = SamRead(sam, samples, sizeof(samples))) > 0)
+    {
+        fwrite(samples, n, 1, file);
+        bufferlength += n;
+    }
+
+    filesize = 4 + 8 + 16 + 8 + bufferlength;
+    fseek(file, 4, SEEK_SET);
+    fwrite(&filesize, 4, 1, file);
+    fseek(file, 40, SEEK_SET);
+    fwrite(&bufferlength, 4, 1, file);
+
+    fclose(file);
+}
+#endif // NOT ESP_PLATFORM
@@ -0,0 +1,438 @@
+#include "fnScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "debug.h"
+
+#ifdef ESP_PLATFORM
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+// global scheduler
+fnJobScheduler jobScheduler;
+
+/********************************************************
+ * Backend
+ ********************************************************/
+
+// What a worker is started with; it frees it
+struct WorkerArg
+{
+    fnJobScheduler *scheduler;
+    fnJobPriority priority;
+};
+
+#ifdef ESP_PLATFORM
+
+// The IEC bus task runs at priority 17 on core 1 (lib/bus/iec/iec.cpp); the
+// workers stay on core 0 with WiFi and the web server, below both.
+#define JOB_WORKER_CORE 0
+
+static const struct
+{
+    const char *name;
+    uint32_t stack;
+    UBaseType_t priority;
+} s_workers[JOB_PRIORITIES] = {
+    { "jobs_high", 4096, 6 },
+    { "jobs_normal", 6144, 4 },
+    // SessionBroker's keep-alives run here, and reconnecting an HTTP or
+    // TNFS session takes the 8 KB its own task used to have
+    { "jobs_bg", 8192, 2 },
+};
+
+bool fnJobScheduler::start_worker(fnJobPriority priority)
+{
+    struct Start
+    {
+        static void entry(void *arg)
+        {
+            WorkerArg a = *(WorkerArg *)arg;
+            delete (WorkerArg *)arg;
+            a.scheduler->worker(a.priority);
+            vTaskDelete(NULL);
+        }
+    };
+
+    TaskHandle_t handle = nullptr;
+    WorkerArg *arg = new WorkerArg{ this, priority };
+    if (xTaskCreatePinnedToCore(Start::entry, s_workers[priority].name, s_workers[priority].stack, arg,
+                                s_workers[priority].priority, &handle, JOB_WORKER_CORE) != pdTRUE)
+    {
+        delete arg;
+        return false;
+    }
+    _workers.push_back(handle);
+    return true;
+}
+
+// A FreeRTOS task cannot be joined: wait for the workers to say they are
+// leaving. The global scheduler is never destroyed, so the last lines of a
+// worker after that are safe.
+void fnJobScheduler::join_workers()
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _idle.wait(lock, [this] { return _alive == 0; });
+    _workers.clear();
+}
+
+uint64_t fnJobScheduler::now_us()
+{
+    return (uint64_t)esp_timer_get_time();
+}
+
+// FreeRTOS keeps no per-task CPU time without run time stats, which are off
+// in release builds; a job is charged for the time it ran.
+uint64_t fnJobScheduler::cpu_now_us()
+{
+    return now_us();
+}
+
+#else
+
+bool fnJobScheduler::start_worker(fnJobPriority priority)
+{
+    struct Start
+    {
+        static void *entry(void *arg)
+        {
+            WorkerArg a = *(WorkerArg *)arg;
+            delete (WorkerArg *)arg;
+            a.scheduler->worker(a.priority);
+            return nullptr;
+        }
+    };
+
+    pthread_t *thread = new pthread_t;
+    WorkerArg *arg = new WorkerArg{ this, priority };
+    if (pthread_create(thread, nullptr, Start::entry, arg) != 0)
+    {
+        delete arg;
+        delete thread;
+        return false;
+    }
+    _workers.push_back(thread);
+    return true;
+}
+
+void fnJobScheduler::join_workers()
+{
+    for (void *w : _workers)
+    {
+        pthread_join(*(pthread_t *)w, nullptr);
+        delete (pthread_t *)w;
+    }
+    _workers.clear();
+}
+
+uint64_t fnJobScheduler::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t fnJobScheduler::cpu_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
+
+/********************************************************
+ * Scheduler
+ ********************************************************/
+
+fnJobScheduler::fnJobScheduler()
+{
+    for (int i = 0; i < JOB_PRIORITIES; i++)
+        _active[i] = 0;
+    _alive = 0;
+    _next_id = 1;
+    _running = false;
+    _stopping = false;
+}
+
+fnJobScheduler::~fnJobScheduler()
+{
+    stop();
+}
+
+bool fnJobScheduler::start()
+{
+    if (_running)
+        return true;
+
+    _stopping = false;
+    for (int p = 0; p < JOB_PRIORITIES; p++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _alive++;
+        }
+        if (!start_worker((fnJobPriority)p))
+        {
+            Debug_printf("fnJobScheduler: cannot start worker %d\r\n", p);
+            std::lock_guard<std::mutex> lock(_mutex);
+            _alive--;
+        }
+    }
+    _running = true;
+    return _alive == JOB_PRIORITIES;
+}
+
+void fnJobScheduler::stop()
+{
+    if (!_running)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+        for (auto &live : _live)
+            live.second.cancel();
+        for (int p = 0; p < JOB_PRIORITIES; p++)
+        {
+            for (auto &e : _queue[p])
+                _stats[e.name].cancelled++;
+            _queue[p].clear();
+        }
+        _timers.clear();
+    }
+    _wake.notify_all();
+    _idle.notify_all();
+
+    join_workers();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _live.clear();
+    _running = false;
+    _stopping = false;
+}
+
+uint32_t fnJobScheduler::enqueue(const char *name, fnJobPriority priority, fnJob job, fnCancelToken token,
+                                 uint32_t delay_ms, uint32_t deadline_ms, uint32_t period_ms)
+{
+    uint64_t now = now_us();
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_stopping)
+        return 0;
+
+    uint32_t id = _next_id++;
+    if (_next_id == 0)
+        _next_id = 1;
+
+    Entry e;
+    e.id = id;
+    e.name = name;
+    e.priority = priority;
+    e.job = std::move(job);
+    e.token = token;
+    e.due_us = now + (uint64_t)delay_ms * 1000;
+    e.deadline_us = deadline_ms ? now + (uint64_t)deadline_ms * 1000 : 0;
+    e.period_ms = period_ms;
+
+    auto &stats = _stats[e.name];
+    stats.name = e.name;
+    stats.priority = priority;
+
+    _live[id] = token;
+    if (delay_ms)
+        _timers.push_back(std::move(e));
+    else
+        _queue[priority].push_back(std::move(e));
+    _wake.notify_all();
+    return id;
+}
+
+uint32_t fnJobScheduler::submit(const char *name, fnJobPriority priority, fnJob job,
+                                uint32_t deadline_ms, fnCancelToken token)
+{
+    return enqueue(name, priority, std::move(job), token, 0, deadline_ms, 0);
+}
+
+uint32_t fnJobScheduler::after(const char *name, fnJobPriority priority, uint32_t delay_ms, fnJob job,
+                               fnCancelToken token)
+{
+    return enqueue(name, priority, std::move(job), token, delay_ms, 0, 0);
+}
+
+uint32_t fnJobScheduler::every(const char *name, fnJobPriority priority, uint32_t period_ms, fnJob job,
+                               fnCancelToken token)
+{
+    return enqueue(name, priority, std::move(job), token, period_ms, 0, period_ms);
+}
+
+bool fnJobScheduler::cancel(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto live = _live.find(id);
+    if (live == _live.end())
+        return false;
+    live->second.cancel();
+    _live.erase(live);
+
+    auto drop = [this, id](Entry &e) {
+        if (e.id != id)
+            return false;
+        _stats[e.name].cancelled++;
+        return true;
+    };
+    _timers.erase(std::remove_if(_timers.begin(), _timers.end(), drop), _timers.end());
+    for (int p = 0; p < JOB_PRIORITIES; p++)
+        _queue[p].erase(std::remove_if(_queue[p].begin(), _queue[p].end(), drop), _queue[p].end());
+
+    _idle.notify_all();
+    return true;
+}
+
+size_t fnJobScheduler::pending(fnJobPriority priority)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t n = _queue[priority].size();
+    for (auto &t : _timers)
+        if (t.priority == priority)
+            n++;
+    return n;
+}
+
+std::vector<fnJobStats> fnJobScheduler::stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<fnJobStats> all;
+    for (auto &s : _stats)
+        all.push_back(s.second);
+    return all;
+}
+
+// Caller holds _mutex
+void fnJobScheduler::promote_timers(uint64_t now)
+{
+    auto due = std::stable_partition(_timers.begin(), _timers.end(),
+                                     [now](const Entry &e) { return e.due_us > now; });
+    if (due == _timers.end())
+        return;
+
+    std::sort(due, _timers.end(), [](const Entry &a, const Entry &b) { return a.due_us < b.due_us; });
+    for (auto it = due; it != _timers.end(); ++it)
+        _queue[it->priority].push_back(std::move(*it));
+    _timers.erase(due, _timers.end());
+    _wake.notify_all();
+}
+
+// Caller holds _mutex
+bool fnJobScheduler::busy_above(fnJobPriority priority)
+{
+    for (int p = 0; p < priority; p++)
+    {
+        if (!_queue[p].empty() || _active[p] > 0)
+            return true;
+    }
+    return false;
+}
+
+void fnJobScheduler::worker(fnJobPriority priority)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_stopping)
+    {
+        uint64_t now = now_us();
+        promote_timers(now);
+
+        auto &queue = _queue[priority];
+        if (queue.empty())
+        {
+            uint64_t next = 0;
+            for (auto &t : _timers)
+                if (next == 0 || t.due_us < next)
+                    next = t.due_us;
+            if (next)
+                _wake.wait_for(lock, std::chrono::microseconds(next - now));
+            else
+                _wake.wait(lock);
+            continue;
+        }
+
+        Entry entry = std::move(queue.front());
+        queue.pop_front();
+        _active[priority]++;
+        lock.unlock();
+
+        run(entry);
+
+        lock.lock();
+        _active[priority]--;
+        if (entry.period_ms && !entry.token.cancelled() && !_stopping)
+        {
+            // Keep to the period, but never queue a run that is already
+            // due because this one overran
+            uint64_t next = entry.due_us + (uint64_t)entry.period_ms * 1000;
+            entry.due_us = std::max(next, now_us());
+            _timers.push_back(std::move(entry));
+        }
+        else
+        {
+            _live.erase(entry.id);
+        }
+        _idle.notify_all();
+    }
+
+    _alive--;
+    _idle.notify_all();
+}
+
+void fnJobScheduler::run(Entry &entry)
+{
+    uint64_t started = now_us();
+    if (entry.token.cancelled())
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stats[entry.name].cancelled++;
+        return;
+    }
+
+    fnJobContext context(this, entry.name, entry.priority, entry.token);
+    uint64_t cpu = cpu_now_us();
+    entry.job(context);
+    cpu = cpu_now_us() - cpu;
+    uint64_t ran = now_us() - started;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &stats = _stats[entry.name];
+    uint64_t latency = started > entry.due_us ? started - entry.due_us : 0;
+    stats.runs++;
+    stats.cpu_us += cpu;
+    stats.max_run_us = std::max(stats.max_run_us, ran);
+    stats.latency_us += latency;
+    stats.max_latency_us = std::max(stats.max_latency_us, latency);
+    if (entry.deadline_us && started > entry.deadline_us)
+        stats.late++;
+}
+
+bool fnJobScheduler::checkpoint(const fnJobContext &context)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    bool waited = false;
+    while (!context.cancelled() && !_stopping && busy_above(context._priority))
+    {
+        waited = true;
+        // A token cancelled directly, not through cancel(), wakes nobody
+        _idle.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    if (waited)
+        _stats[context._name].yields++;
+    return !context.cancelled();
+}
+
+bool fnJobContext::checkpoint()
+{
+    return _scheduler->checkpoint(*this);
+}
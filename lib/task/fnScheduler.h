@@ -0,0 +1,175 @@
+#ifndef _FN_SCHEDULER_H
+#define _FN_SCHEDULER_H
+
+// Work-queue scheduler for background jobs.
+//
+// fnTaskManager steps its tasks one after another from a single loop, and
+// the services that need background work (SessionBroker's keep-alives, for
+// one) each create a FreeRTOS task of their own instead. Here there is one
+// queue per priority and one worker per queue, created once at boot: on the
+// ESP32 they are FreeRTOS tasks pinned to the core the IEC bus task is not
+// on, natively they are POSIX threads.
+//
+// A job that runs for long should call fnJobContext::checkpoint() between
+// steps. It returns false once the job is cancelled, and it holds the job
+// while anything of higher priority is queued or running, so a long scan
+// gives way to a short request however the OS schedules the workers.
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum fnJobPriority
+{
+    JOB_HIGH = 0,       // answers something waiting on it now
+    JOB_NORMAL,
+    JOB_BACKGROUND,     // housekeeping, scans, keep-alives
+    JOB_PRIORITIES
+};
+
+// Shared by everything holding a copy: cancelling one cancels them all
+class fnCancelToken
+{
+public:
+    fnCancelToken() : _flag(std::make_shared<std::atomic<bool>>(false)) {}
+
+    void cancel() const { _flag->store(true); }
+    bool cancelled() const { return _flag->load(); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> _flag;
+};
+
+class fnJobScheduler;
+
+class fnJobContext
+{
+public:
+    const fnCancelToken &token() const { return _token; }
+    bool cancelled() const { return _token.cancelled(); }
+
+    // Wait here while higher priority work is queued or running; false
+    // once the job has been cancelled
+    bool checkpoint();
+
+private:
+    fnJobContext(fnJobScheduler *scheduler, const std::string &name, fnJobPriority priority,
+                 const fnCancelToken &token)
+        : _scheduler(scheduler), _name(name), _priority(priority), _token(token) {}
+
+    fnJobScheduler *_scheduler;
+    const std::string &_name;
+    fnJobPriority _priority;
+    fnCancelToken _token;
+
+    friend fnJobScheduler;
+};
+
+typedef std::function<void(fnJobContext &)> fnJob;
+
+// Per job name, since the scheduler was started
+struct fnJobStats
+{
+    std::string name;
+    fnJobPriority priority = JOB_NORMAL;
+    uint32_t runs = 0;
+    uint32_t cancelled = 0;         // dropped before they ran
+    uint32_t late = 0;              // started after their deadline
+    uint32_t yields = 0;            // checkpoints that waited for higher priority work
+    uint64_t cpu_us = 0;            // thread CPU time natively, run time on the ESP32
+    uint64_t max_run_us = 0;
+    uint64_t latency_us = 0;        // due to started, summed over runs
+    uint64_t max_latency_us = 0;
+};
+
+class fnJobScheduler
+{
+public:
+    fnJobScheduler();
+    ~fnJobScheduler();
+
+    // Create the workers; jobs submitted before this wait for it
+    bool start();
+    // Cancel what is queued, wait for running jobs to return
+    void stop();
+    bool running() { return _running; }
+
+    // Run 'job' once, as soon as a worker for 'priority' is free. With a
+    // deadline, a job that has not started 'deadline_ms' after submission
+    // still runs but is counted late. Returns a job ID for cancel(), 0 if
+    // the scheduler is stopping.
+    uint32_t submit(const char *name, fnJobPriority priority, fnJob job,
+                    uint32_t deadline_ms = 0, fnCancelToken token = fnCancelToken());
+
+    // Run 'job' once, 'delay_ms' from now
+    uint32_t after(const char *name, fnJobPriority priority, uint32_t delay_ms, fnJob job,
+                   fnCancelToken token = fnCancelToken());
+
+    // Run 'job' every 'period_ms' until cancelled; a run is never started
+    // while the previous one is still going
+    uint32_t every(const char *name, fnJobPriority priority, uint32_t period_ms, fnJob job,
+                   fnCancelToken token = fnCancelToken());
+
+    // Cancel a job by ID: it will not start again, and a running one sees
+    // its token cancelled
+    bool cancel(uint32_t id);
+
+    size_t pending(fnJobPriority priority);
+    std::vector<fnJobStats> stats();
+
+private:
+    struct Entry
+    {
+        uint32_t id;
+        std::string name;
+        fnJobPriority priority;
+        fnJob job;
+        fnCancelToken token;
+        uint64_t due_us;        // when it may start
+        uint64_t deadline_us;   // 0: none
+        uint32_t period_ms;     // 0: runs once
+    };
+
+    uint32_t enqueue(const char *name, fnJobPriority priority, fnJob job, fnCancelToken token,
+                     uint32_t delay_ms, uint32_t deadline_ms, uint32_t period_ms);
+    void promote_timers(uint64_t now);
+    bool busy_above(fnJobPriority priority);
+    void worker(fnJobPriority priority);
+    void run(Entry &entry);
+    bool checkpoint(const fnJobContext &context);
+
+    // Backend: ESP32 FreeRTOS tasks or POSIX threads
+    bool start_worker(fnJobPriority priority);
+    void join_workers();
+    static uint64_t now_us();
+    static uint64_t cpu_now_us();
+
+    std::mutex _mutex;
+    std::condition_variable _wake;      // new work, a timer or stop
+    std::condition_variable _idle;      // a queue emptied or a job finished
+    std::deque<Entry> _queue[JOB_PRIORITIES];
+    std::vector<Entry> _timers;         // waiting for due_us
+    std::map<uint32_t, fnCancelToken> _live;
+    std::map<std::string, fnJobStats> _stats;
+    int _active[JOB_PRIORITIES];        // jobs running, per priority
+    int _alive;                         // workers that have not exited
+    uint32_t _next_id;
+    bool _running;
+    bool _stopping;
+    std::vector<void *> _workers;       // backend handles
+
+    friend fnJobContext;
+};
+
+// global scheduler
+extern fnJobScheduler jobScheduler;
+
+#endif // _FN_SCHEDULER_H
@@ -21,11 +21,14 @@
 #include "punycode.h"
 #include <algorithm>
 #include <cctype>
+#include <cstring>
 
 // https://style64.org/petscii/
 
+namespace {
+
 // PETSCII table in UTF8,  non-mappable characters mapped to Private Use Area E000-F8FF
-const char16_t U8Char::utf8map[] = {
+constexpr char16_t utf8map[256] = {
 // we can't touch standard ASCII (<127), even for codes missing in PETSCII, as this will cause all kinds of problems
 //  ---0,   ---1,   ---2,   ---3,   ---4,   ---5,   ---6,   ---7,   ---8,   ---9,   --10,   --11,   --12,   --13,   --14,   --15    
     0x00,   0x01,   0x02,   0x03,   0x04,   0x05,   0x06,   0x07,   0x08,   0x09,   0x0a,   0x0b,   0x0c,   0x0d,   0x0e,   0x0f,   // 0 ASCII control codes
@@ -58,8 +61,100 @@ const char16_t U8Char::utf8map[] = {
   0xE050, 0xE051, 0xE052, 0xE053, 0xE054, 0xE055, 0xE056, 0xE057, 0xE058, 0xE059, 0xE05a, 0xE05b, 0xE05c, 0xE05D, 0xE05E, 0xE05F,   // F PETSCII control codes
 };
 
-// std::unordered_map<char16_t, uint8_t> U8Char::ch_to_petascii_map;
-// std::once_flag U8Char::ch_to_petascii_init_flag;
+// The tables below are generated from utf8map by the compiler, so there is
+// still only the one table above to edit.
+
+// Reverse of utf8map, in two levels: the high byte of a code point picks a
+// page, the low byte the PETSCII code in it. Page 0 answers '?' for the
+// code points utf8map does not use, and takes the place of every page
+// utf8map has nothing on: 256 bytes each for the handful that are used.
+constexpr size_t countReversePages()
+{
+    bool used[256] = {};
+    size_t pages = 1;
+    for (size_t i = 0; i < 256; i++) {
+        uint8_t hi = utf8map[i] >> 8;
+        if (!used[hi]) {
+            used[hi] = true;
+            pages++;
+        }
+    }
+    return pages;
+}
+
+struct ReverseMap {
+    uint8_t page[256];
+    uint8_t code[countReversePages()][256];
+};
+
+constexpr ReverseMap buildReverseMap()
+{
+    ReverseMap map = {};
+    for (size_t lo = 0; lo < 256; lo++)
+        map.code[0][lo] = '?';
+
+    // Backwards, so that for a code point listed twice the lower PETSCII
+    // code wins, as it did when toPetscii() scanned utf8map from the start
+    uint8_t pages = 1;
+    for (int i = 255; i >= 0; i--) {
+        uint8_t hi = utf8map[i] >> 8;
+        if (map.page[hi] == 0) {
+            map.page[hi] = pages;
+            for (size_t lo = 0; lo < 256; lo++)
+                map.code[pages][lo] = '?';
+            pages++;
+        }
+        map.code[map.page[hi]][utf8map[i] & 0xFF] = static_cast<uint8_t>(i);
+    }
+    return map;
+}
+
+constexpr ReverseMap reverse_map = buildReverseMap();
+
+// utf8map already encoded: up to three bytes per PETSCII code, copied as a
+// block. PETSCII NUL encodes to nothing, see petsciiToUtf8().
+struct Utf8Code {
+    uint8_t len;
+    char bytes[U8Char::UTF8_PER_PETSCII];
+};
+
+struct Utf8Map {
+    Utf8Code code[256];
+};
+
+constexpr Utf8Map buildUtf8Map()
+{
+    Utf8Map map = {};
+    for (size_t i = 1; i < 256; i++) {
+        char16_t ch = utf8map[i];
+        Utf8Code& c = map.code[i];
+        if (ch <= 0x7f) {
+            c.len = 1;
+            c.bytes[0] = static_cast<char>(ch);
+        }
+        else if (ch <= 0x7ff) {
+            c.len = 2;
+            c.bytes[0] = static_cast<char>(((ch >> 6) & 0b11111) | 0b11000000);
+            c.bytes[1] = static_cast<char>((ch & 0b111111) | 0b10000000);
+        }
+        else {
+            c.len = 3;
+            c.bytes[0] = static_cast<char>(((ch >> 12) & 0b1111) | 0b11100000);
+            c.bytes[1] = static_cast<char>(((ch >> 6) & 0b111111) | 0b10000000);
+            c.bytes[2] = static_cast<char>((ch & 0b111111) | 0b10000000);
+        }
+    }
+    return map;
+}
+
+constexpr Utf8Map utf8_map = buildUtf8Map();
+
+static_assert(reverse_map.code[reverse_map.page[0x25]][0x0c] == 0xb0, "reverse map: U+250C is PETSCII $B0");
+static_assert(reverse_map.code[reverse_map.page[0x00]]['a'] == 0x41, "reverse map: 'a' is PETSCII $41");
+static_assert(reverse_map.code[reverse_map.page[0x12]][0x34] == '?', "reverse map: unused code points are '?'");
+static_assert(utf8_map.code[0xb0].len == 3 && utf8_map.code[0xb0].bytes[2] == '\x8c', "UTF-8 map: $B0 is E2 94 8C");
+
+} // namespace
 
 void U8Char::fromUtf8Stream(std::istream* reader) {
     uint8_t byte = reader->get();
@@ -156,15 +251,82 @@ std::string U8Char::toUtf8() {
 // }
 
 uint8_t U8Char::toPetscii() {
-    // but if we want to support conversion of many more UTF8 characters to PETSCII, 
-    // we can use this code instead of the simple range conversion above.
-    for (size_t i = 0; i < 256; ++i) {
-        if (utf8map[i] == ch) {
-            return static_cast<uint8_t>(i);
+    return unicodeToPetscii(ch);
+}
+
+char16_t U8Char::petsciiToUnicode(uint8_t petscii) {
+    return utf8map[petscii];
+}
+
+uint8_t U8Char::unicodeToPetscii(char16_t codepoint) {
+    return reverse_map.code[reverse_map.page[codepoint >> 8]][codepoint & 0xFF];
+}
+
+size_t U8Char::petsciiToUtf8(const uint8_t* in, size_t len, char* out, size_t out_size, size_t* consumed) {
+    size_t i = 0, o = 0;
+
+    // While there is room for the longest code, copy all three bytes and
+    // keep the ones that belong: no branch on the length
+    while (i < len && o + UTF8_PER_PETSCII <= out_size) {
+        const Utf8Code& c = utf8_map.code[in[i++]];
+        memcpy(out + o, c.bytes, UTF8_PER_PETSCII);
+        o += c.len;
+    }
+    while (i < len) {
+        const Utf8Code& c = utf8_map.code[in[i]];
+        if (o + c.len > out_size)
+            break;
+        memcpy(out + o, c.bytes, c.len);
+        o += c.len;
+        i++;
+    }
+
+    if (consumed)
+        *consumed = i;
+    return o;
+}
+
+size_t U8Char::utf8ToPetscii(const char* in, size_t len, uint8_t* out, size_t out_size, size_t* consumed) {
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(in);
+    const uint8_t* ascii = reverse_map.code[reverse_map.page[0]];
+    size_t i = 0, o = 0;
+
+    while (i < len && o < out_size) {
+        uint8_t byte = src[i];
+
+        // ASCII, nearly every name: one lookup, no decoding
+        if (byte <= 0x7f) {
+            out[o++] = ascii[byte];
+            i++;
+            continue;
+        }
+
+        // Decoded as fromCharArray() does: the continuation bytes are not
+        // checked, and one missing at the end of the input reads as 0
+        char16_t codepoint;
+        size_t n;
+        if ((byte & 0b11100000) == 0b11000000) {
+            uint8_t b1 = (i + 1 < len) ? src[i + 1] : 0;
+            codepoint = ((char16_t)(byte & 0b11111) << 6) | (b1 & 0b111111);
+            n = 2;
+        }
+        else if ((byte & 0b11110000) == 0b11100000) {
+            uint8_t b1 = (i + 1 < len) ? src[i + 1] : 0;
+            uint8_t b2 = (i + 2 < len) ? src[i + 2] : 0;
+            codepoint = ((char16_t)(byte & 0b1111) << 12) | ((char16_t)(b1 & 0b111111) << 6) | (b2 & 0b111111);
+            n = 3;
+        }
+        else {
+            codepoint = 0;
+            n = 1;
         }
+        out[o++] = unicodeToPetscii(codepoint);
+        i = std::min(i + n, len);
     }
 
-    return static_cast<uint8_t>(missing);
+    if (consumed)
+        *consumed = i;
+    return o;
 }
 
 // for punycode we need utf8 converted to uint32_t 
@@ -35,31 +35,39 @@
  ********************************************************/
 
 class U8Char {
-    static const char16_t utf8map[];
     const char missing = '?';
     void fromUtf8Stream(std::istream* reader);
-    // static std::once_flag ch_to_petascii_init_flag;
 
 public:
     char16_t ch;
     U8Char(const uint16_t codepoint): ch(codepoint) {};
-    // U8Char(const uint16_t codepoint): ch(codepoint) { ensureReverseMapInitialized(); };
     U8Char(std::istream* reader) {
-        // ensureReverseMapInitialized();
         fromUtf8Stream(reader);
     }
-    U8Char(const char petscii) : ch(utf8map[static_cast<uint8_t>(petscii)]) {
-        // ensureReverseMapInitialized();
-    }
-
-    // static void ensureReverseMapInitialized() {
-    //     std::call_once(ch_to_petascii_init_flag, initialize_ch_to_petascii_map);
-    // }
+    U8Char(const char petscii) : ch(petsciiToUnicode(static_cast<uint8_t>(petscii))) {}
 
     size_t fromCharArray(char* reader);
 
     std::string toUtf8();
     uint8_t toPetscii();
+
+    // One PETSCII code to its code point and back, by table lookup. A code
+    // point PETSCII has no code for gives '?'.
+    static char16_t petsciiToUnicode(uint8_t petscii);
+    static uint8_t unicodeToPetscii(char16_t codepoint);
+
+    // Most UTF-8 bytes one PETSCII code becomes
+    static const size_t UTF8_PER_PETSCII = 3;
+
+    // Bulk conversion into a caller's buffer, for directory listings and
+    // names: no U8Char per character and no allocation. Both return the
+    // bytes written and stop before the first character that does not fit
+    // in 'out'; 'consumed', if given, is set to the input bytes converted.
+    // PETSCII NUL is dropped, as mstr::toUTF8() always has. Each UTF-8
+    // sequence gives one PETSCII byte, NUL for a byte that cannot start one.
+    static size_t petsciiToUtf8(const uint8_t* in, size_t len, char* out, size_t out_size, size_t* consumed = nullptr);
+    static size_t utf8ToPetscii(const char* in, size_t len, uint8_t* out, size_t out_size, size_t* consumed = nullptr);
+
     size_t toUnicode32(std::string& input_utf8, uint32_t* output_unicode32, size_t max_output_length);
     std::string fromUnicode32(uint32_t* input_unicode32, size_t input_length);
     static std::string toPunycode(std::string utf8String);
@@ -68,15 +76,6 @@ public:
     static std::string encodeACE(std::string utf8String);
     // Decode ACE-prefixed punycode (checks for 'xn--' prefix case-insensitively) and return decoded UTF-8 or original string
     static std::string decodeACE(std::string aceOrPunycode);
-
-    // This is a reverse lookup map used to quickly find the petascci code from the ch value, making it O(1) complexity
-    // static std::unordered_map<char16_t, uint8_t> ch_to_petascii_map;
-
-    // static void initialize_ch_to_petascii_map() {
-    //     for (size_t i = 0; i < 256; ++i) {
-    //         ch_to_petascii_map.insert({utf8map[i], static_cast<uint8_t>(i)});
-    //     }
-    // }
 };
 
 #endif /* MEATLOAF_UTILS_U8CHAR */
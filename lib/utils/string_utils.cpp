@@ -368,34 +368,22 @@ namespace mstr {
     //                 [](unsigned char c) { return ascii2petscii(c); });
     // }
 
-    // convert PETSCII to UTF8, using methods from U8Char
+    // convert PETSCII to UTF8, a table lookup per byte (see U8Char::petsciiToUtf8)
     std::string toUTF8(const std::string &petsciiInput)
     {
-        std::string utf8string;
-        // iterate by index and use unsigned values so bytes >= 0x80 are handled correctly
-        for (size_t i = 0; i < petsciiInput.size(); ++i) {
-            uint8_t petscii = static_cast<uint8_t>(petsciiInput[i]);
-            if (petscii != 0) {
-                U8Char u8char(static_cast<char>(petscii));
-                utf8string += u8char.toUtf8();
-            }
-        }
+        std::string utf8string(petsciiInput.size() * U8Char::UTF8_PER_PETSCII, '\0');
+        utf8string.resize(U8Char::petsciiToUtf8((const uint8_t *)petsciiInput.data(), petsciiInput.size(),
+                                                &utf8string[0], utf8string.size()));
         return utf8string;
     }
 
-    // convert UTF8 to PETSCII, using methods from U8Char
+    // convert UTF8 to PETSCII, a table lookup per character (see U8Char::utf8ToPetscii)
     std::string toPETSCII2(const std::string &utfInputString)
     {
-        std::string petsciiString;
-        char* utfInput = (char*)utfInputString.c_str();
-        auto end = utfInput + utfInputString.length();
-
-        while(utfInput<end) {
-            U8Char u8char(' ');
-            size_t skip = u8char.fromCharArray(utfInput);
-            petsciiString+=u8char.toPetscii();
-            utfInput+=skip;
-        }
+        // Never more PETSCII bytes than UTF-8 ones
+        std::string petsciiString(utfInputString.size(), '\0');
+        petsciiString.resize(U8Char::utf8ToPetscii(utfInputString.data(), utfInputString.size(),
+                                                   (uint8_t *)&petsciiString[0], petsciiString.size()));
         return petsciiString;
     }
 
@@ -77,7 +77,11 @@ esp_err_t webdav_handler(httpd_req_t *httpd_req)
         break;
     case HTTP_GET:
         ret = server->doGet(req, resp);
-        if ( ret == 200 )
+        // doGet() sends its own 200/206/304/416. Below 0 it failed after the
+        // headers went out, and only closing the connection can say so.
+        if ( ret < 0 )
+            return ESP_FAIL;
+        if ( ret == 200 || ret == 206 || ret == 304 || ret == 416 )
             return finish(req);
         break;
     case HTTP_HEAD:
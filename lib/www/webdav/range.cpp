@@ -0,0 +1,167 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#include "range.h"
+
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+
+using namespace WebDav;
+
+static void skipSpace(const std::string &s, size_t &i)
+{
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t'))
+        i++;
+}
+
+// Digits at s[i..]; false when there are none. A number too big for 64 bits
+// stays at UINT64_MAX rather than wrapping into a small, valid-looking one:
+// past the end of any file is what it means.
+static bool parseNumber(const std::string &s, size_t &i, uint64_t &value)
+{
+    size_t start = i;
+    value = 0;
+    while (i < s.size() && isdigit((unsigned char)s[i]))
+    {
+        uint64_t d = s[i++] - '0';
+        if (value > (UINT64_MAX - d) / 10)
+            value = UINT64_MAX;
+        else
+            value = value * 10 + d;
+    }
+    return i > start;
+}
+
+RangeResult WebDav::parseRange(const std::string &header, uint32_t size, std::vector<ByteRange> &ranges)
+{
+    ranges.clear();
+
+    size_t i = 0;
+    skipSpace(header, i);
+    if (header.compare(i, 6, "bytes=") != 0)
+        return RANGE_NONE;
+    i += 6;
+
+    size_t specs = 0;
+    for (;;)
+    {
+        skipSpace(header, i);
+        uint64_t first = 0, last = 0;
+        bool hasFirst = parseNumber(header, i, first);
+        if (i >= header.size() || header[i] != '-')
+            return RANGE_NONE;
+        i++;
+        bool hasLast = parseNumber(header, i, last);
+        if (!hasFirst && !hasLast)
+            return RANGE_NONE;
+        if (hasFirst && hasLast && last < first)
+            return RANGE_NONE;
+        if (++specs > WEBDAV_MAX_RANGES)
+            return RANGE_NONE;
+
+        if (!hasFirst)
+        {
+            // Suffix: the last N bytes
+            if (last > 0 && size > 0)
+            {
+                uint32_t n = last > size ? size : (uint32_t)last;
+                ranges.push_back({ size - n, size - 1 });
+            }
+        }
+        else if (first < size)
+        {
+            if (!hasLast || last >= size)
+                last = size - 1;
+            ranges.push_back({ (uint32_t)first, (uint32_t)last });
+        }
+
+        skipSpace(header, i);
+        if (i >= header.size())
+            break;
+        if (header[i] != ',')
+            return RANGE_NONE;
+        i++;
+    }
+
+    return ranges.empty() ? RANGE_UNSATISFIABLE : RANGE_OK;
+}
+
+// The opaque part of an entity tag, without W/ and quotes
+static std::string opaqueTag(std::string tag)
+{
+    if (tag.compare(0, 2, "W/") == 0)
+        tag.erase(0, 2);
+    if (tag.size() >= 2 && tag.front() == '"' && tag.back() == '"')
+        tag = tag.substr(1, tag.size() - 2);
+    return tag;
+}
+
+bool WebDav::etagMatches(const std::string &header, const std::string &etag)
+{
+    std::string want = opaqueTag(etag);
+    size_t i = 0;
+    while (i < header.size())
+    {
+        size_t comma = header.find(',', i);
+        if (comma == std::string::npos)
+            comma = header.size();
+        size_t b = i, e = comma;
+        while (b < e && isspace((unsigned char)header[b])) b++;
+        while (e > b && isspace((unsigned char)header[e - 1])) e--;
+        std::string tag = header.substr(b, e - b);
+        if (tag == "*" || (!tag.empty() && opaqueTag(tag) == want))
+            return true;
+        i = comma + 1;
+    }
+    return false;
+}
+
+// Days from 1970-01-01 to y-m-d in the proleptic Gregorian calendar; timegm()
+// is not in every libc this builds against.
+static int64_t daysFromCivil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+bool WebDav::parseHttpDate(const std::string &value, time_t &t)
+{
+    static const char *months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+
+    char wday[4], mon[4], zone[4];
+    int day, year, hour, min, sec;
+    if (sscanf(value.c_str(), "%3s, %d %3s %d %d:%d:%d %3s",
+               wday, &day, mon, &year, &hour, &min, &sec, zone) != 8)
+        return false;
+    if (strcmp(zone, "GMT") != 0)
+        return false;
+
+    const char *m = strstr(months, mon);
+    if (m == nullptr || strlen(mon) != 3 || (m - months) % 3 != 0)
+        return false;
+    unsigned month = (unsigned)(m - months) / 3 + 1;
+    if (day < 1 || day > 31 || hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 || sec > 60)
+        return false;
+
+    t = (time_t)(daysFromCivil(year, month, (unsigned)day) * 86400 + hour * 3600 + min * 60 + sec);
+    return true;
+}
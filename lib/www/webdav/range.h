@@ -0,0 +1,70 @@
+// Meatloaf - A Commodore 64/128 multi-device emulator
+// https://github.com/idolpx/meatloaf
+// Copyright(C) 2020 James Johnston
+//
+// Meatloaf is free software : you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// Meatloaf is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+// Range requests and validators for WebDAV GET (RFC 9110 13-14).
+//
+// Mount clients (davfs2, Finder, the Windows mini-redirector) and emulators
+// re-read disk images constantly, either whole with a validator from the
+// last fetch or a few blocks at a time with Range. Answering those with 304
+// and 206 instead of the full image is what keeps them off the wire. These
+// are the parts that need no server: doGet() in webdav_server.cpp does the
+// sending.
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// More ranges than this in one request is not a client reading blocks, and
+// each costs a seek; the Range header is ignored and the whole file sent.
+#define WEBDAV_MAX_RANGES 16
+
+namespace WebDav
+{
+    // Inclusive, as written in Range and Content-Range
+    struct ByteRange
+    {
+        uint32_t first;
+        uint32_t last;
+
+        uint32_t length() const { return last - first + 1; }
+    };
+
+    enum RangeResult
+    {
+        RANGE_NONE,             // no usable Range header: send the whole file (200)
+        RANGE_OK,               // 'ranges' holds what to send (206)
+        RANGE_UNSATISFIABLE,    // valid, but nothing in it lies within the file (416)
+    };
+
+    // Parse a Range header value ("bytes=0-499,1000-,-200") against a file of
+    // 'size' bytes. Ranges are clamped to the file and returned in request
+    // order; ones starting past the end are dropped. A header that does not
+    // parse, is not in bytes, or asks for more than WEBDAV_MAX_RANGES ranges
+    // is RANGE_NONE, as RFC 9110 allows.
+    RangeResult parseRange(const std::string &header, uint32_t size, std::vector<ByteRange> &ranges);
+
+    // Does an If-None-Match (or If-Range) list name 'etag'? Weak comparison,
+    // which is what If-None-Match uses: W/ prefixes are ignored. "*" matches.
+    bool etagMatches(const std::string &header, const std::string &etag);
+
+    // An HTTP date, in the IMF-fixdate form every client sends
+    // ("Sun, 06 Nov 1994 08:49:37 GMT"), to a UTC time_t.
+    bool parseHttpDate(const std::string &value, time_t &t);
+}
@@ -56,3 +56,37 @@ void Response::flushHeaders() {
     // (i.e. until the first sendChunk/closeBody call). The map is cleaned up naturally
     // when the Response object goes out of scope at the end of the handler.
 }
+
+bool Response::beginBody(int64_t length) {
+    std::string head = "HTTP/1.1 ";
+    head += statusLine;
+    head += "\r\n";
+    if (length >= 0) {
+        head += "Content-Type: ";
+        head += contentType;
+        head += "\r\nContent-Length: ";
+        head += std::to_string(length);
+        head += "\r\n";
+    }
+    for (const auto &h: headers) {
+        head += h.first;
+        head += ": ";
+        head += h.second;
+        head += "\r\n";
+    }
+    head += "\r\n";
+    return sendBodyPart(head.data(), head.size());
+}
+
+bool Response::sendBodyPart(const char *buf, size_t len) {
+    // httpd_send() may take less than it was given; a negative return is one
+    // of the HTTPD_SOCK_ERR_* codes.
+    while (len > 0) {
+        int sent = httpd_send(req, buf, len);
+        if (sent <= 0)
+            return false;
+        buf += sent;
+        len -= sent;
+    }
+    return true;
+}
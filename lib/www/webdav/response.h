@@ -29,7 +29,9 @@
 #define HTTPD_200      "200 OK"                     /*!< HTTP Response 200 */
 #define HTTPD_201      "201 Created"
 #define HTTPD_204      "204 No Content"             /*!< HTTP Response 204 */
+#define HTTPD_206      "206 Partial Content"
 #define HTTPD_207      "207 Multi-Status"           /*!< HTTP Response 207 */
+#define HTTPD_304      "304 Not Modified"
 #define HTTPD_400      "400 Bad Request"            /*!< HTTP Response 400 */
 #define HTTPD_403      "403 Forbidden"
 #define HTTPD_404      "404 Not Found"              /*!< HTTP Response 404 */
@@ -38,6 +40,7 @@
 #define HTTPD_409      "409 Conflict"
 #define HTTPD_412      "412 Precondition Failed"
 #define HTTPD_415      "415 Unspported Media Type"
+#define HTTPD_416      "416 Range Not Satisfiable"
 #define HTTPD_500      "500 Internal Server Error"  /*!< HTTP Response 500 */
 #define HTTPD_501      "501 Not Implemented"
 #define HTTPD_507      "507 Insufficient Storage"
@@ -82,9 +85,15 @@ namespace WebDav
                 case 204:
                     status = HTTPD_204;
                     break;
+                case 206:
+                    status = HTTPD_206;
+                    break;
                 case 207:
                     status = HTTPD_207;
                     break;
+                case 304:
+                    status = HTTPD_304;
+                    break;
                 case 400:
                     status = HTTPD_400;
                     break;
@@ -109,6 +118,9 @@ namespace WebDav
                 case 415:
                     status = HTTPD_415;
                     break;
+                case 416:
+                    status = HTTPD_416;
+                    break;
                 case 500:
                     status = HTTPD_500;
                     break;
@@ -123,6 +135,7 @@ namespace WebDav
             }
 
             //Debug_printv("status[%s]", status);
+            statusLine = status ? status : HTTPD_500;
             httpd_resp_set_status(req, status);
             setDavHeaders();
         }
@@ -130,9 +143,18 @@ namespace WebDav
         void setContentType(const char *ct)
         {
             //Debug_printv("%s", ct);
+            contentType = ct;
             httpd_resp_set_type(req, ct);
         }
 
+        // A body of known length sent in pieces. esp_http_server only writes
+        // Content-Length for a body handed over in one buffer (sendBody), and
+        // sendChunk always means chunked encoding, so this writes the status
+        // line and headers to the socket itself and the pieces follow through
+        // sendBodyPart(). length < 0 sends no Content-Length and no body (304).
+        bool beginBody(int64_t length);
+        bool sendBodyPart(const char *buf, size_t len);
+
         bool sendChunk(const char *buf, ssize_t len = -1)
         {
             chunked = true;
@@ -170,6 +192,8 @@ private:
 
         httpd_req_t *req;
         bool chunked = false;
+        const char *statusLine = HTTPD_200;
+        const char *contentType = HTTPD_TYPE_TEXT;
 
         std::map<std::string, std::string> headers;
     };
@@ -16,8 +16,10 @@
 // along with Meatloaf. If not, see <http://www.gnu.org/licenses/>.
 
 #include "webdav_server.h"
+#include "range.h"
 
 #include <stdio.h>
+#include <algorithm>
 #include <sstream>
 #include <string.h>
 #include <errno.h>
@@ -474,6 +476,16 @@ std::string Server::formatTime(time_t t)
     return std::string(buf);
 }
 
+// The one ETag PROPFIND, GET and HEAD all give a file, quoted. Empty for a
+// file with no modification time: one built from 0 would stay the same
+// across changes.
+std::string Server::formatETag(const std::string &path, time_t lastWrite)
+{
+    if (lastWrite == 0)
+        return "";
+    return "\"" + mstr::sha1(path + std::to_string(lastWrite)) + "\"";
+}
+
 static void xmlElement(std::ostringstream &s, const char *name, const char *value)
 {
     s << "<" << name << ">" << value << "</" << name << ">\r\n";
@@ -530,8 +542,9 @@ int Server::sendPropResponse(Response &resp, std::string path, int recurse, MFil
         r.props["D:creationdate"] = formatTime(mfile->getCreationTime());
         r.props["D:getlastmodified"] = formatTime(mfile->getLastWrite());
 
-        std::string s = path + std::to_string(mfile->getLastWrite());
-        r.props["D:getetag"] = mstr::sha1(s);
+        std::string etag = formatETag(path, mfile->getLastWrite());
+        if (!etag.empty())
+            r.props["D:getetag"] = etag;
 
         r.isCollection = mfile->isDirectory();
         if (!r.isCollection)
@@ -570,7 +583,12 @@ int Server::sendPropResponse(Response &resp, std::string path, int recurse, MFil
             // Pass the entry as a hint: it already has is_dir and size set from
             // the directory listing, so sendPropResponse skips the MFSOwner::File()
             // lookup and the extra network round-trips for exists()/isDirectory().
-            sendPropResponse(resp, path + "/" + entry->name, recurse - 1, entry.get());
+            // No doubled slash under "/": the child's path is also what its
+            // ETag is built from, and has to match the one GET gives it.
+            std::string child = path;
+            if (child.empty() || child.back() != '/')
+                child += "/";
+            sendPropResponse(resp, child + entry->name, recurse - 1, entry.get());
         }
     }
 
@@ -676,18 +694,37 @@ int Server::doGet(Request &req, Response &resp)
     if (mfile->isDirectory())
         return 405;
 
+    // A file whose modification time isn't known (0) has no validators: an
+    // ETag or Last-Modified built from 0 would stay the same across changes,
+    // and a 304 or If-Range match against it would hand out stale bytes.
+    time_t lastWrite = mfile->getLastWrite();
+    bool validated = (lastWrite != 0);
+    std::string etag;
+    if (validated)
+    {
+        etag = formatETag(path, lastWrite);
+        resp.setHeader("ETag", etag);
+        resp.setHeader("Last-Modified", formatTime(lastWrite));
+
+        // The client's copy is current. If-None-Match wins over
+        // If-Modified-Since when both are sent (RFC 9110 13.1.3).
+        std::string ifNoneMatch = req.getHeader("If-None-Match");
+        std::string ifModifiedSince = req.getHeader("If-Modified-Since");
+        time_t since;
+        bool notModified = !ifNoneMatch.empty()
+                         ? etagMatches(ifNoneMatch, etag)
+                         : !ifModifiedSince.empty() && parseHttpDate(ifModifiedSince, since) && lastWrite <= since;
+        if (notModified)
+        {
+            resp.setStatus(304);
+            return resp.beginBody(-1) ? 304 : -1;
+        }
+    }
+
     auto stream = mfile->getSourceStream(std::ios_base::in);
     if (!stream || !stream->isOpen())
         return 404;
 
-    std::string s = path + std::to_string(mfile->getLastWrite());
-
-    resp.setStatus(200);
-    resp.setHeader("ETag", mstr::sha1(s));
-    resp.setHeader("Last-Modified", formatTime(mfile->getLastWrite()));
-    resp.flushHeaders();
-
-    int ret = 0;
     // 16 KB: halves the chunked-send round trips vs 8 KB. malloc lands in
     // PSRAM (above the SPIRAM_MALLOC_ALWAYSINTERNAL threshold).
     const int chunkSize = 16384;
@@ -697,24 +734,131 @@ int Server::doGet(Request &req, Response &resp)
         return 500;
     }
 
-    for (;;)
+    // Whatever the stream has for us next: a RAM-cached file lends its bytes
+    // and they go out from where they sit; chunk is only filled for streams
+    // that have to be read.
+    auto next = [&](const uint8_t *&data, uint32_t want) -> uint32_t {
+        return stream->readSpan(data, chunk, std::min(want, (uint32_t)chunkSize));
+    };
+
+    int ret = 200;
+    uint32_t size = stream->size();
+    if (size == 0 || !stream->isSizeExact())
     {
-        uint32_t r = stream->read(chunk, chunkSize);
-        if (r == 0)
-            break;
+        // Length unknown up front: chunked, and no ranges to map. A file in
+        // a disk image only gives an upper bound until it has been read, and
+        // a Content-Length or a suffix range taken from that would be wrong.
+        resp.setStatus(200);
+        resp.flushHeaders();
+        for (;;)
+        {
+            const uint8_t *data;
+            uint32_t r = next(data, chunkSize);
+            if (r == 0)
+                break;
 
-        if (!resp.sendChunk((char *)chunk, r))
+            if (!resp.sendChunk((const char *)data, r))
+            {
+                ret = -1;
+                break;
+            }
+        }
+        if (ret == 200)
+            resp.closeChunk();
+    }
+    else
+    {
+        // Ranges map onto seek(), so only a stream that can seek gets them.
+        // If-Range: a client holding a stale copy gets the whole new one.
+        // Without validators there is nothing to check it against, so it
+        // never matches and its Range is ignored (RFC 9110 13.1.5).
+        std::vector<ByteRange> ranges;
+        RangeResult range = RANGE_NONE;
+        std::string rangeHeader = req.getHeader("Range");
+        std::string ifRange = req.getHeader("If-Range");
+        time_t ifRangeDate;
+        bool rangeValid = ifRange.empty() ||
+                          (validated && (ifRange[0] == '"' ? etagMatches(ifRange, etag)
+                                                           : parseHttpDate(ifRange, ifRangeDate) && lastWrite == ifRangeDate));
+        if (!rangeHeader.empty() && rangeValid && stream->isRandomAccess())
+            range = parseRange(rangeHeader, size, ranges);
+
+        if (stream->isRandomAccess())
+            resp.setHeader("Accept-Ranges", "bytes");
+        std::string total = std::to_string(size);
+
+        // Send [first, last] of the stream as body bytes
+        auto sendRange = [&](const ByteRange &r) -> bool {
+            if (stream->position() != r.first && !stream->seek(r.first))
+                return false;
+            uint32_t left = r.length();
+            while (left > 0)
+            {
+                const uint8_t *data;
+                uint32_t n = next(data, left);
+                if (n == 0 || !resp.sendBodyPart((const char *)data, n))
+                    return false;
+                left -= n;
+            }
+            return true;
+        };
+
+        if (range == RANGE_UNSATISFIABLE)
         {
-            ret = -1;
-            break;
+            resp.setStatus(416);
+            resp.setHeader("Content-Range", "bytes */" + total);
+            ret = resp.beginBody(0) ? 416 : -1;
+        }
+        else if (range == RANGE_OK && ranges.size() == 1)
+        {
+            const ByteRange &r = ranges[0];
+            resp.setStatus(206);
+            resp.setHeader("Content-Range", "bytes " + std::to_string(r.first) + "-" + std::to_string(r.last) + "/" + total);
+            ret = resp.beginBody(r.length()) && sendRange(r) ? 206 : -1;
+        }
+        else if (range == RANGE_OK)
+        {
+            // multipart/byteranges: every part header is known before the
+            // first byte goes out, so the length is too.
+            static const char *boundary = "MEATLOAF_BYTERANGES";
+            std::vector<std::string> heads;
+            uint64_t length = 0;
+            for (auto &r : ranges)
+            {
+                heads.push_back(std::string("\r\n--") + boundary +
+                                "\r\nContent-Type: application/octet-stream"
+                                "\r\nContent-Range: bytes " + std::to_string(r.first) + "-" +
+                                std::to_string(r.last) + "/" + total + "\r\n\r\n");
+                length += heads.back().size() + r.length();
+            }
+            std::string tail = std::string("\r\n--") + boundary + "--\r\n";
+            length += tail.size();
+
+            std::string type = std::string("multipart/byteranges; boundary=") + boundary;
+            resp.setStatus(206);
+            resp.setContentType(type.c_str());
+            ret = resp.beginBody(length) ? 206 : -1;
+            for (size_t i = 0; ret == 206 && i < ranges.size(); i++)
+            {
+                if (!resp.sendBodyPart(heads[i].data(), heads[i].size()) || !sendRange(ranges[i]))
+                    ret = -1;
+            }
+            if (ret == 206 && !resp.sendBodyPart(tail.data(), tail.size()))
+                ret = -1;
+        }
+        else
+        {
+            resp.setStatus(200);
+            ret = resp.beginBody(size) && sendRange({ 0, size - 1 }) ? 200 : -1;
         }
     }
 
     free(chunk);
     stream->close();
-    resp.closeChunk();
 
-    return ret != 0 ? 500 : 200;
+    // Once the headers are out the status is spent: a failure part way can
+    // only be reported by dropping the connection.
+    return ret;
 }
 
 int Server::doHead(Request &req, Response &resp)
@@ -737,10 +881,24 @@ int Server::doHead(Request &req, Response &resp)
     if (!mfile || !mfile->exists())
         return 404;
 
-    std::string s = path + std::to_string(mfile->getLastWrite());
+    // Same validators as doGet(), so a HEAD can be followed by a conditional
+    // GET - and likewise none for a file with no modification time
+    time_t lastWrite = mfile->getLastWrite();
+    if (lastWrite != 0)
+    {
+        resp.setHeader("ETag", formatETag(path, lastWrite));
+        resp.setHeader("Last-Modified", formatTime(lastWrite));
+    }
 
-    resp.setHeader("ETag", mstr::sha1(s));
-    resp.setHeader("Last-Modified", formatTime(mfile->getLastWrite()));
+    // Ranges only where doGet() would serve them
+    if (!mfile->isDirectory())
+    {
+        auto stream = mfile->getSourceStream(std::ios_base::in);
+        if (stream && stream->isOpen() && stream->size() && stream->isSizeExact() && stream->isRandomAccess())
+            resp.setHeader("Accept-Ranges", "bytes");
+        if (stream)
+            stream->close();
+    }
 
     return 200;
 }
@@ -48,6 +48,7 @@ private:
         std::string rootURI, rootPath;
 
         std::string formatTime(time_t t);
+        std::string formatETag(const std::string &path, time_t lastWrite);
         int sendPropResponse(Response &resp, std::string path, int recurse, MFile* hint = nullptr);
         void sendMultiStatusResponse(Response &resp, MultiStatusResponse &msr);
 };
@@ -73,6 +73,7 @@ ps2dev::PS2Keyboard keyboard(PIN_KB_CLK, PIN_KB_DATA);
 #include "fnWiFi.h"
 #include "fnConfig.h"
 #include "mlConfig.h"
+#include "fnScheduler.h"
 
 #include "fsFlash.h"
 #include "fnFsSD.h"
@@ -158,6 +159,7 @@ void main_shutdown_handler()
     // Give devices an opportunity to clean up before rebooting
 
     SessionBroker::shutdown();
+    jobScheduler.stop();
     SYSTEM_BUS.shutdown();
 
 #ifdef SD_CARD
@@ -359,7 +361,8 @@ void main_setup()
     fnWiFi.start();
     //log_heap_checkpoint("after fnWiFi.start()");
 
-    // Start SessionBroker service task on CPU0
+    // Start the background job workers on CPU0, then the services using them
+    jobScheduler.start();
     SessionBroker::setup();
     //log_heap_checkpoint("after SessionBroker::setup()");
 
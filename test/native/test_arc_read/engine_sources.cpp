@@ -6,6 +6,7 @@
 #include "../../../lib/utils/U8Char.cpp"
 #include "../../../lib/utils/string_utils.cpp"
 #include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
 #include "../../../lib/meatloaf/media/archive/arc.cpp"
 
 #include "../test_disk_write/native_stubs.cpp"
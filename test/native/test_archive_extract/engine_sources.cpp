@@ -16,10 +16,18 @@
 #include "../../../lib/utils/string_utils.cpp"
 #include "../../../lib/utils/peoples_url_parser.cpp"
 #include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
+// The host has no CONFIG_SPIRAM; index as a PSRAM board would, so the
+// 2,000-entry benchmark zip is served from the index rather than refused.
+#define ZIP_INDEX_MAX_DIRECTORY (1024 * 1024)
+#define ZIP_INDEX_MAX_ENTRIES   8192
+
 // meat_session.cpp is NOT included here: it and archive.cpp each define a
 // file-static psram_malloc(), which is a redefinition once concatenated.
 // It gets its own translation unit in session_source.cpp.
 #include "../../../lib/meatloaf/media/archive/archive.cpp"
+#include "../../../lib/meatloaf/media/archive/zip_index.cpp"
+#include "../../../lib/meatloaf/network/http_range.cpp"
 
 // peoples_url_parser.cpp calls util_get_canonical_path()/util_tokenize()/
 // util_tolower(), whose real implementations live in lib/utils/utils.cpp.
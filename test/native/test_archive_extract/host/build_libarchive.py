@@ -1,6 +1,7 @@
 """
 Builds the C libraries the archive tests need (libarchive + zlib + bzip2 +
-lz4) for the NATIVE test host, and puts their headers on the include path.
+lz4, and the TAPClean engine for test_tap_scan) for the NATIVE test host,
+and puts their headers on the include path.
 
 Why a script instead of the usual engine_sources.cpp "unity build" trick the
 other native suites use: those concatenate C++ files into one translation
@@ -119,6 +120,16 @@ for src in sorted(glob(os.path.join(BZIP2, "*.c"))):
 for src in sorted(glob(os.path.join(LZ4, "*.c"))):
     build(z_env.Clone(CPPPATH=[LZ4]), src, "lz4")
 
+# TAPClean (test_tap_scan): the tape analysis engine is C with the same
+# file-static clash between its ~90 scanners, and is built the way its
+# ESP-IDF component does it - everything under the component, embedded mode.
+TAPCLEAN = os.path.join(PROJECT_DIR, "components", "tapclean")
+tc_env = env.Clone(CPPPATH=[os.path.join(TAPCLEAN, "include"), TAPCLEAN, os.path.join(TAPCLEAN, "src")])
+tc_env.Append(CPPDEFINES=["TAPCLEAN_EMBEDDED"], CFLAGS=["-w"])
+for src in sorted(glob(os.path.join(TAPCLEAN, "*.c")) + glob(os.path.join(TAPCLEAN, "src", "*.c")) +
+                  glob(os.path.join(TAPCLEAN, "src", "scanners", "*.c"))):
+    build(tc_env, src, "tapclean")
+
 # lib/compat: strlcpy/strlcat/compat_gettimeofday, which lib/utils/utils.cpp
 # calls and mingw does not provide. Plus localtime_r/gmtime_r for libarchive.
 COMPAT = os.path.join(PROJECT_DIR, "lib", "compat")
@@ -24,14 +24,19 @@
 
 #include <unity.h>
 
+#include <chrono>
 #include <cstdio>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 #include <cstring>
 
 #include "../test_disk_write/file_container_stream.h"
 #include "media/archive/archive.h"
+#include "network/http_range.h"
+
+#include <zlib.h>
 
 // A real multi-entry zip. Samples under .archive/ are gitignored, so tests
 // that need one skip when it isn't there (same convention as the container
@@ -54,6 +59,18 @@ public:
     using ArchiveMStream::nextEntrySimple;
     using ArchiveMStream::open;
     using ArchiveMStream::seekPath;
+    using ArchiveMStream::read;
+
+    // seekPath() as it was before the zip index: find the entry by walking
+    // libarchive's headers from the first, then extract.
+    bool seekByWalk(const std::string& name)
+    {
+        if (!seekEntry(name))
+            return false;
+        _size = entry.size;
+        _position = 0;
+        return true;
+    }
 };
 
 // A source stream that starts `skew` bytes into the file and hides it: seek(p)
@@ -800,6 +817,396 @@ void test_unimplemented_lzh_method_is_still_refused(void)
         "an unsupported method must report an error, not succeed empty");
 }
 
+// ---------------------------------------------------------------------------
+// Zip central-directory index (media/archive/zip_index.h)
+//
+// seekPath() into a zip used to find its entry by walking libarchive's
+// headers from the first one; over HTTP every local header it visits is a
+// range request. It now reads the central directory once per container and
+// seeks straight to the entry. The zips here are built in memory with zlib,
+// so the suite needs no samples, and are served by a stand-in server that
+// counts requests through the same HTTPRangeCache the HTTP client uses.
+// ---------------------------------------------------------------------------
+
+struct StandInServer
+{
+    std::vector<uint8_t> body;
+    uint32_t requests = 0;
+
+    uint32_t serve(uint32_t position, uint8_t* buf, uint32_t size)
+    {
+        requests++;
+        if (position >= body.size())
+            return 0;
+        uint32_t n = std::min<uint32_t>(size, (uint32_t)body.size() - position);
+        memcpy(buf, body.data() + position, n);
+        return n;
+    }
+};
+
+class RangedStream : public MStream
+{
+public:
+    RangedStream(const std::string& url, StandInServer& server)
+        : MStream(url), _server(server)
+    {
+        _size = (uint32_t)server.body.size();
+    }
+
+    bool isOpen() override { return true; }
+    bool isRandomAccess() override { return true; }
+    void close() override {}
+    bool open(std::ios_base::openmode) override { return true; }
+    uint32_t write(const uint8_t*, uint32_t) override { return 0; }
+
+    bool seek(uint32_t pos) override
+    {
+        if (pos > _size)
+            return false;
+        _position = pos;
+        return true;
+    }
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        uint32_t n = _cache.read(_position, buf, size, _size,
+            [this](uint32_t pos, uint8_t* dst, uint32_t len) { return _server.serve(pos, dst, len); });
+        _position += n;
+        return n;
+    }
+
+private:
+    StandInServer& _server;
+    HTTPRangeCache _cache;
+};
+
+struct ZipSpec
+{
+    std::string name;
+    std::vector<uint8_t> data;
+    bool store = false;
+    bool descriptor = false;   // general purpose bit 3: sizes after the data
+};
+
+static void put16(std::vector<uint8_t>& v, uint16_t x) { v.push_back(x & 0xff); v.push_back(x >> 8); }
+static void put32(std::vector<uint8_t>& v, uint32_t x) { put16(v, x & 0xffff); put16(v, x >> 16); }
+
+static std::vector<uint8_t> rawDeflate(const std::vector<uint8_t>& in)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, 9, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    std::vector<uint8_t> out(deflateBound(&zs, in.size()));
+    zs.next_in = (Bytef*)in.data();
+    zs.avail_in = in.size();
+    zs.next_out = out.data();
+    zs.avail_out = out.size();
+    deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return out;
+}
+
+// A zip as Info-ZIP on Unix writes one. Names ending in '/' are directories.
+// prefix is prepended without adjusting any offset, the way a self-extractor
+// stub is; the central directory can be written in reverse order to make sure
+// "first" means first in the file, not first in the directory.
+static std::vector<uint8_t> buildZip(const std::vector<ZipSpec>& specs, size_t prefix = 0,
+                                     bool reverseDirectory = false, size_t commentLength = 0)
+{
+    std::vector<uint8_t> zip(prefix, 0x4d);
+    std::vector<std::vector<uint8_t>> records;
+
+    for (const ZipSpec& spec : specs) {
+        const bool dir = !spec.name.empty() && spec.name.back() == '/';
+        const uint16_t method = (dir || spec.store) ? 0 : 8;
+        const uint16_t flags = spec.descriptor ? 0x0008 : 0;
+        const std::vector<uint8_t> packed = method ? rawDeflate(spec.data) : spec.data;
+        const uint32_t crc = crc32(0L, spec.data.data(), spec.data.size());
+        const uint32_t offset = zip.size() - prefix;
+
+        put32(zip, 0x04034b50);
+        put16(zip, 20);
+        put16(zip, flags);
+        put16(zip, method);
+        put16(zip, 0);
+        put16(zip, 0x0021);
+        put32(zip, spec.descriptor ? 0 : crc);
+        put32(zip, spec.descriptor ? 0 : packed.size());
+        put32(zip, spec.descriptor ? 0 : spec.data.size());
+        put16(zip, spec.name.size());
+        put16(zip, 0);
+        zip.insert(zip.end(), spec.name.begin(), spec.name.end());
+        zip.insert(zip.end(), packed.begin(), packed.end());
+        if (spec.descriptor) {
+            put32(zip, 0x08074b50);
+            put32(zip, crc);
+            put32(zip, packed.size());
+            put32(zip, spec.data.size());
+        }
+
+        std::vector<uint8_t> r;
+        put32(r, 0x02014b50);
+        put16(r, (3 << 8) | 20);
+        put16(r, 20);
+        put16(r, flags);
+        put16(r, method);
+        put16(r, 0);
+        put16(r, 0x0021);
+        put32(r, crc);
+        put32(r, packed.size());
+        put32(r, spec.data.size());
+        put16(r, spec.name.size());
+        put16(r, 0);
+        put16(r, 0);
+        put16(r, 0);
+        put16(r, 0);
+        put32(r, (uint32_t)(dir ? 040755 : 0100644) << 16);
+        put32(r, offset);
+        r.insert(r.end(), spec.name.begin(), spec.name.end());
+        records.push_back(r);
+    }
+    if (reverseDirectory)
+        std::reverse(records.begin(), records.end());
+
+    const uint32_t cdOffset = zip.size() - prefix;
+    for (const auto& r : records)
+        zip.insert(zip.end(), r.begin(), r.end());
+    const uint32_t cdSize = zip.size() - prefix - cdOffset;
+
+    put32(zip, 0x06054b50);
+    put16(zip, 0);
+    put16(zip, 0);
+    put16(zip, specs.size());
+    put16(zip, specs.size());
+    put32(zip, cdSize);
+    put32(zip, cdOffset);
+    put16(zip, commentLength);
+    zip.insert(zip.end(), commentLength, 'c');
+    return zip;
+}
+
+// Content that deflates somewhat, like a real program file.
+static std::vector<uint8_t> payload(uint32_t seed, size_t size)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (i % 7 == 0) ? (uint8_t)(seed >> 16) : (uint8_t)("LOAD\"*\",8,1 "[i % 12]);
+    }
+    return data;
+}
+
+static std::vector<ZipSpec> smallZip()
+{
+    std::vector<ZipSpec> specs;
+    specs.push_back({ "disks/", {} });
+    specs.push_back({ "disks/NESTED.D64", payload(1, 174848) });
+    specs.push_back({ "STORED.PRG", payload(2, 3000), true });
+    specs.push_back({ "DEFLATED.PRG", payload(3, 5000) });
+    specs.push_back({ "LATER.PRG", payload(4, 700), false, true });
+    specs.push_back({ "a/DUP.SEQ", payload(5, 100) });
+    specs.push_back({ "b/DUP.SEQ", payload(6, 200) });
+    return specs;
+}
+
+static std::vector<uint8_t> readAll(WalkableArchiveStream& stream)
+{
+    std::vector<uint8_t> out;
+    uint8_t buf[1024];
+    uint32_t n;
+    while ((n = stream.read(buf, sizeof(buf))) > 0)
+        out.insert(out.end(), buf, buf + n);
+    return out;
+}
+
+static std::vector<uint8_t> extractIndexed(StandInServer& server, const std::string& url, const std::string& name)
+{
+    WalkableArchiveStream stream(std::make_shared<RangedStream>(url, server));
+    if (!stream.seekPath(name))
+        return {};
+    return readAll(stream);
+}
+
+static std::vector<uint8_t> extractWalked(StandInServer& server, const std::string& url, const std::string& name)
+{
+    WalkableArchiveStream stream(std::make_shared<RangedStream>(url, server));
+    if (!stream.seekByWalk(name))
+        return {};
+    return readAll(stream);
+}
+
+void test_zip_index_reads_the_central_directory(void)
+{
+    StandInServer server;
+    server.body = buildZip(smallZip(), 0, true);
+    RangedStream src("http://stand.in/small.zip", server);
+
+    ZipIndex index;
+    TEST_ASSERT_TRUE(ZipIndex::handles(src.url));
+    TEST_ASSERT_FALSE(ZipIndex::handles("http://stand.in/small.7z"));
+    TEST_ASSERT_TRUE(index.build(&src));
+    TEST_ASSERT_TRUE(index.isBuilt());
+
+    // The directory entry is not a file
+    TEST_ASSERT_EQUAL(6, index.count());
+
+    const ZipIndex::Entry* nested = index.find("NESTED.D64");
+    TEST_ASSERT_NOT_NULL(nested);
+    TEST_ASSERT_EQUAL_STRING("disks/NESTED.D64", nested->pathname.c_str());
+    TEST_ASSERT_EQUAL_UINT32(174848, nested->size);
+    TEST_ASSERT_EQUAL_UINT16(8, nested->method);
+
+    // Written in reverse, still answered in file order
+    TEST_ASSERT_EQUAL_STRING("NESTED.D64", index.find("*")->filename().c_str());
+    TEST_ASSERT_EQUAL_STRING("a/DUP.SEQ", index.find("DUP.SEQ")->pathname.c_str());
+    TEST_ASSERT_EQUAL_STRING("DEFLATED.PRG", index.find("DEF*")->filename().c_str());
+    TEST_ASSERT_NULL(index.find("disks"));
+    TEST_ASSERT_NULL(index.find("MISSING.PRG"));
+    TEST_ASSERT_NULL(index.find("stored.prg"));
+
+    ZipIndex::Entry e = *index.find("STORED.PRG");
+    TEST_ASSERT_TRUE(ZipIndex::canExtract(e));
+    e.method = 12;   // bzip2 stays with libarchive
+    TEST_ASSERT_FALSE(ZipIndex::canExtract(e));
+    e.method = 8;
+    e.flags = 0x0001;   // encrypted
+    TEST_ASSERT_FALSE(ZipIndex::canExtract(e));
+
+    // Not a zip: refused, and not retried
+    StandInServer junk;
+    junk.body = payload(9, 4096);
+    RangedStream junkSrc("http://stand.in/junk.zip", junk);
+    ZipIndex none;
+    TEST_ASSERT_FALSE(none.build(&junkSrc));
+    TEST_ASSERT_TRUE(none.isBuilt());
+    TEST_ASSERT_EQUAL(0, none.count());
+}
+
+// Every kind of entry, through the index and through libarchive, byte for
+// byte - and both against what went into the zip.
+void test_zip_index_extracts_what_libarchive_does(void)
+{
+    auto specs = smallZip();
+    StandInServer server;
+    server.body = buildZip(specs, 0, true);
+
+    const char* names[] = { "NESTED.D64", "STORED.PRG", "DEFLATED.PRG", "LATER.PRG", "DUP.SEQ", "*" };
+    const size_t expect[] = { 1, 2, 3, 4, 5, 1 };
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        std::string n = names[i];
+        auto indexed = extractIndexed(server, "http://stand.in/idx" + std::to_string(i) + ".zip", n);
+        auto walked = extractWalked(server, "http://stand.in/walk" + std::to_string(i) + ".zip", n);
+        TEST_ASSERT_EQUAL_MESSAGE(specs[expect[i]].data.size(), indexed.size(), names[i]);
+        TEST_ASSERT_TRUE_MESSAGE(indexed == specs[expect[i]].data, names[i]);
+        // The walk answers "*" with the leading "disks/" directory entry
+        // (an empty name matches it) and extracts nothing; the index only
+        // holds files.
+        if (n == "*")
+            TEST_ASSERT_EQUAL(0, walked.size());
+        else
+            TEST_ASSERT_TRUE_MESSAGE(indexed == walked, names[i]);
+    }
+}
+
+// A self-extractor stub in front, and a comment too long for the first look
+// at the tail.
+void test_zip_index_handles_prefix_and_comment(void)
+{
+    auto specs = smallZip();
+    StandInServer server;
+    server.body = buildZip(specs, 12345, false, 3000);
+
+    RangedStream src("http://stand.in/sfx.zip", server);
+    ZipIndex index;
+    TEST_ASSERT_TRUE(index.build(&src));
+    TEST_ASSERT_EQUAL(6, index.count());
+
+    auto data = extractIndexed(server, "http://stand.in/sfx.zip", "LATER.PRG");
+    TEST_ASSERT_TRUE(data == specs[4].data);
+
+    // A damaged entry fails its CRC rather than coming back wrong
+    const ZipIndex::Entry* stored = index.find("STORED.PRG");
+    server.body[stored->offset + 30 + 10 + 100] ^= 0xff;
+    TEST_ASSERT_NULL(ZipIndex::extract(&src, *stored).get());
+}
+
+// Drives opening entries of one archive at once share its session, and with
+// it the index: it is built once, by whichever gets there first, and every
+// drive finds its entry in it.
+void test_zip_index_is_built_once_for_drives_at_once(void)
+{
+    auto specs = smallZip();
+    std::vector<uint8_t> zip = buildZip(specs, 0, true);
+    const char* names[] = { "NESTED.D64", "STORED.PRG", "DEFLATED.PRG", "LATER.PRG" };
+    const int DRIVES = 8;
+
+    ArchiveMSession session("http://stand.in/shared.zip");
+    std::vector<StandInServer> servers(DRIVES);
+    std::vector<ZipIndex::Entry> found(DRIVES);
+    std::vector<int> ok(DRIVES, 0);
+    std::vector<std::thread> drives;
+    for (int d = 0; d < DRIVES; d++) {
+        servers[d].body = zip;
+        drives.emplace_back([&, d]() {
+            RangedStream src("http://stand.in/shared.zip", servers[d]);
+            ok[d] = session.findIndexed(&src, names[d % 4], found[d]);
+        });
+    }
+    for (auto& t : drives)
+        t.join();
+
+    int built = 0;
+    for (int d = 0; d < DRIVES; d++) {
+        TEST_ASSERT_TRUE(ok[d]);
+        TEST_ASSERT_EQUAL_STRING(names[d % 4], found[d].filename().c_str());
+        built += servers[d].requests > 0;
+    }
+    TEST_ASSERT_EQUAL(1, built);
+    TEST_ASSERT_EQUAL(6, session.zipIndex.count());
+}
+
+// Benchmark: open the last entry of a 2,000-entry zip, before (walk every
+// header) and after (central directory). Request counts are what the HTTP
+// client would send; the time is host CPU only, with no network latency.
+void test_zip_index_benchmark_last_of_2000(void)
+{
+    std::vector<ZipSpec> specs;
+    for (uint32_t i = 0; i < 2000; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "games/GAME%04u.PRG", (unsigned)i);
+        specs.push_back({ name, payload(i, 300 + (i * 37) % 1200), (i % 3) == 0 });
+    }
+    StandInServer server;
+    server.body = buildZip(specs);
+    const std::vector<uint8_t>& last = specs.back().data;
+
+    auto started = std::chrono::steady_clock::now();
+    auto walked = extractWalked(server, "http://stand.in/bench-walk.zip", "GAME1999.PRG");
+    double walk_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    uint32_t walk_requests = server.requests;
+
+    server.requests = 0;
+    started = std::chrono::steady_clock::now();
+    auto indexed = extractIndexed(server, "http://stand.in/bench-index.zip", "GAME1999.PRG");
+    double index_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    uint32_t index_requests = server.requests;
+
+    // Same container again: the index is already on the session
+    server.requests = 0;
+    auto again = extractIndexed(server, "http://stand.in/bench-index.zip", "GAME1998.PRG");
+    uint32_t again_requests = server.requests;
+
+    printf("last of 2000 (%u byte zip): walk %u requests %.2f ms, index %u requests %.2f ms, next entry %u requests\n",
+           (unsigned)server.body.size(), walk_requests, walk_ms, index_requests, index_ms, again_requests);
+
+    TEST_ASSERT_TRUE(walked == last);
+    TEST_ASSERT_TRUE(indexed == last);
+    TEST_ASSERT_TRUE(again == specs[1998].data);
+    TEST_ASSERT_TRUE(index_requests * 10 <= walk_requests);
+    TEST_ASSERT_TRUE(again_requests <= 2);
+}
+
 int main(int, char**)
 {
     UNITY_BEGIN();
@@ -822,5 +1229,10 @@ int main(int, char**)
     RUN_TEST(test_lh1_short_origsize_still_leaves_the_walk_aligned);
     RUN_TEST(test_empty_entry_does_not_restart_the_walk);
     RUN_TEST(test_unimplemented_lzh_method_is_still_refused);
+    RUN_TEST(test_zip_index_reads_the_central_directory);
+    RUN_TEST(test_zip_index_extracts_what_libarchive_does);
+    RUN_TEST(test_zip_index_handles_prefix_and_comment);
+    RUN_TEST(test_zip_index_is_built_once_for_drives_at_once);
+    RUN_TEST(test_zip_index_benchmark_last_of_2000);
     return UNITY_END();
 }
@@ -0,0 +1,19 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// ImageBroker, SessionBroker and the leases that keep their entries.
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp leaks a bare min(a,b) macro into the rest of this unit.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
+#include "../../../lib/meatloaf/meat_session.cpp"
+
+// The suite resolves its own images, so obtain() has something to open.
+#define NATIVE_STUBS_REAL_MFSOWNER
+void MFSOwner::suspendResolveCache() {}
+void MFSOwner::resumeResolveCache() {}
+#include "../test_disk_write/native_stubs.cpp"
@@ -0,0 +1,707 @@
+// Tests for the leases that keep ImageBroker and SessionBroker entries
+// (lib/meatloaf/meat_lease.h), and for the brokers shared by many drives.
+//
+// Both brokers used to decide whether an entry was in use by matching it
+// against every drive's CWD (and the console's) - a suffix match for
+// images, a host match for sessions - once per entry they meant to drop,
+// with SessionBroker's one lock held throughout. ImageBroker had no lock at
+// all. A drive now holds a lease on its CWD, the brokers look leases up in a
+// table that takes no lock, and each broker is split into shards with a
+// lock of their own.
+//
+// LegacyBroker below is the old ImageBroker with the one lock it needed to
+// be shared, kept so that the stress numbers compare the two on the same
+// drives doing the same things.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "meat_media.h"
+#include "meat_lease.h"
+#include "meat_session.h"
+
+// Drives 8 to 30, as on the bus
+static const int DRIVES = 23;
+static const int IMAGES = 40;
+static const int OPS_PER_DRIVE = 1000;
+static const uint32_t IMAGE_BYTES = 8 * 1024;
+
+static std::atomic<uint32_t> opens{0};
+static std::atomic<uint32_t> connects{0};
+static uint32_t open_us = 100;
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static void spin_us(uint32_t us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static std::string image_url(int i)
+{
+    return "sd:/games/disk" + std::to_string(i) + ".d64";
+}
+
+// The container an image is read from; nothing here reads it.
+class FakeContainer : public MStream
+{
+public:
+    FakeContainer(std::string url) : MStream(url) {}
+    bool isOpen() override { return true; }
+    bool open(std::ios_base::openmode) override { return true; }
+    void close() override {}
+    uint32_t read(uint8_t*, uint32_t) override { return 0; }
+    uint32_t write(const uint8_t*, uint32_t) override { return 0; }
+    bool seek(uint32_t) override { return true; }
+};
+
+class FakeImage : public MMediaStream
+{
+public:
+    FakeImage(std::shared_ptr<MStream> container) : MMediaStream(container) {}
+    uint32_t readFile(uint8_t*, uint32_t) override { return 0; }
+    uint32_t writeFile(uint8_t*, uint32_t) override { return 0; }
+    uint32_t footprint() override { return bytes; }
+
+    uint32_t bytes = IMAGE_BYTES;   // what it has buffered so far
+};
+
+// Closing an image can mean closing a file or a connection, which must not
+// hold up a shard. Dropping this one looks at the broker from another thread
+// and notes whether it answered; it can't while any shard is locked.
+static std::atomic<uint32_t> closed{0};
+static std::atomic<uint32_t> closed_unlocked{0};
+
+class ClosingImage : public FakeImage
+{
+public:
+    using FakeImage::FakeImage;
+    ~ClosingImage()
+    {
+        auto answered = std::make_shared<std::atomic<bool>>(false);
+        std::thread([answered]() {
+            ImageBroker::count();
+            *answered = true;
+        }).detach();
+        for (int i = 0; i < 200 && !*answered; i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        closed++;
+        if (*answered)
+            closed_unlocked++;
+    }
+};
+
+static std::string closing_url(int i)
+{
+    return "sd:/games/closing" + std::to_string(i) + ".d64";
+}
+
+// An image that can be read: byte n of it is n & 0xFF. It notes whether two
+// threads were ever inside it at once, which is what a drive reading ahead
+// on one core while another reader moves the same stream would do.
+class ReadingImage : public FakeImage
+{
+public:
+    ReadingImage(std::shared_ptr<MStream> container) : FakeImage(container) { _size = 64 * 1024; }
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        Inside in(this);
+        uint32_t n = std::min(size, available());
+        for (uint32_t i = 0; i < n; i++)
+            buf[i] = (uint8_t)(_position + i);
+        spin_us(20);
+        _position += n;
+        return n;
+    }
+    bool seek(uint32_t pos) override
+    {
+        Inside in(this);
+        _position = pos;
+        return true;
+    }
+
+    std::atomic<bool> overlapped{false};
+
+private:
+    std::atomic<int> inside{0};
+    struct Inside
+    {
+        ReadingImage* image;
+        Inside(ReadingImage* i) : image(i)
+        {
+            if (image->inside++ > 0)
+                image->overlapped = true;
+        }
+        ~Inside() { image->inside--; }
+    };
+};
+
+static std::string reading_url()
+{
+    return "sd:/games/reading.d64";
+}
+
+// An image file on the card. Opening it takes open_us, as reading a D64's
+// BAM and first directory sector from SD would.
+class FakeFile : public MFile
+{
+public:
+    FakeFile(const std::string& path, bool source)
+    {
+        url = path;
+        if (!source)
+            sourceFile = new FakeFile(path, true);
+    }
+
+    std::shared_ptr<MStream> getSourceStream(std::ios_base::openmode) override
+    {
+        opens++;
+        spin_us(open_us);
+        if (url.find("closing") != std::string::npos)
+            return std::make_shared<ClosingImage>(std::make_shared<FakeContainer>(url));
+        if (url.find("reading") != std::string::npos)
+            return std::make_shared<ReadingImage>(std::make_shared<FakeContainer>(url));
+        return std::make_shared<FakeImage>(std::make_shared<FakeContainer>(url));
+    }
+    std::shared_ptr<MStream> getDecodedStream(std::shared_ptr<MStream> src) override { return src; }
+};
+
+MFile* MFSOwner::File(std::string path, bool default_to_flash)
+{
+    (void)default_to_flash;
+    return new FakeFile(path, false);
+}
+
+class FakeSession : public MSession
+{
+public:
+    FakeSession(std::string host, uint16_t port)
+        : MSession("fake://" + host + ":" + std::to_string(port), host, port)
+    {
+        idle_grace_period = 0;
+    }
+    static std::string getScheme() { return "fake"; }
+
+    bool connect() override
+    {
+        connects++;
+        spin_us(open_us);
+        connected = true;
+        return true;
+    }
+    void disconnect() override { connected = false; }
+    bool keep_alive() override { return true; }
+};
+
+// The old ImageBroker, locked: one mutex for everything, and an entry is in
+// use while some drive's CWD is a suffix of its key.
+class LegacyBroker
+{
+public:
+    struct Drive
+    {
+        std::mutex mutex;
+        std::string cwd;
+        std::string getCWD()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return cwd;
+        }
+    };
+    Drive drives[DRIVES];
+
+    std::shared_ptr<MMediaStream> obtain(const std::string& type, const std::string& url)
+    {
+        std::unique_ptr<MFile> file(MFSOwner::File(url));
+        std::string key = type + file->sourceFile->url;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = repo.find(key);
+            if (it != repo.end())
+            {
+                lru.splice(lru.begin(), lru, it->second);
+                return it->second->second;
+            }
+        }
+
+        auto stream = std::static_pointer_cast<MMediaStream>(file->getSourceStream());
+        uint32_t bytes = stream->footprint();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = repo.find(key);
+        if (it != repo.end())
+            return it->second->second;
+        auto e = lru.end();
+        while (e != lru.begin() && (cached + bytes > budget || lru.size() >= 50))
+        {
+            --e;
+            if (is_in_use(e->first))
+                continue;
+            auto victim = e++;
+            cached -= victim->second->footprint();
+            repo.erase(victim->first);
+            lru.erase(victim);
+        }
+        lru.emplace_front(key, stream);
+        repo[key] = lru.begin();
+        cached += bytes;
+        return stream;
+    }
+
+    size_t budget = 0;
+
+private:
+    std::mutex mutex;
+    std::list<std::pair<std::string, std::shared_ptr<MMediaStream>>> lru;
+    std::unordered_map<std::string, decltype(lru)::iterator> repo;
+    size_t cached = 0;
+
+    bool is_in_use(const std::string& key)
+    {
+        for (auto& drive : drives)
+        {
+            auto cwd = drive.getCWD();
+            if (cwd.empty())
+                continue;
+            if (cwd.back() == '/')
+                cwd.pop_back();
+            if (!cwd.empty() && mstr::endsWith(key, cwd.c_str()))
+                return true;
+        }
+        return false;
+    }
+};
+
+struct Percentiles
+{
+    double p50, p95, p99, max;
+};
+
+static Percentiles percentiles(std::vector<uint64_t> ns)
+{
+    std::sort(ns.begin(), ns.end());
+    auto at = [&](double q) { return ns[std::min(ns.size() - 1, (size_t)(q * ns.size()))] / 1000.0; };
+    return { at(0.50), at(0.95), at(0.99), ns.back() / 1000.0 };
+}
+
+struct StressResult
+{
+    Percentiles all;
+    double fairness;     // worst drive's p99 over the best drive's
+    uint32_t unstable;   // a leased image's stream changed under its drive
+    double seconds;
+};
+
+// Each drive changes to an image now and then, lists it most of the time
+// and loads from another image in between; one more task, WebDAV, browses
+// images with no lease at all.
+template <class Obtain, class Cd>
+static StressResult stress(Obtain obtain, Cd cd)
+{
+    std::vector<std::vector<uint64_t>> latency(DRIVES);
+    std::atomic<uint32_t> unstable{0};
+    std::atomic<bool> running{true};
+
+    uint64_t started = now_ns();
+    std::vector<std::thread> drives;
+    for (int d = 0; d < DRIVES; d++)
+    {
+        drives.emplace_back([&, d]() {
+            std::mt19937 rng(d + 8);
+            int image = d % IMAGES;
+            cd(d, image_url(image));
+            std::shared_ptr<MMediaStream> held = obtain(image_url(image));
+            latency[d].reserve(OPS_PER_DRIVE);
+
+            for (int op = 0; op < OPS_PER_DRIVE; op++)
+            {
+                int roll = rng() % 100;
+                uint64_t t = now_ns();
+                if (roll < 5)
+                {
+                    image = rng() % IMAGES;
+                    cd(d, image_url(image));
+                    held = obtain(image_url(image));
+                }
+                else if (roll < 70)
+                {
+                    if (obtain(image_url(image)) != held)
+                        unstable++;
+                }
+                else
+                {
+                    obtain(image_url(rng() % IMAGES));
+                }
+                latency[d].push_back(now_ns() - t);
+            }
+            cd(d, "");
+        });
+    }
+    std::thread webdav([&]() {
+        std::mt19937 rng(1);
+        while (running)
+            obtain(image_url(rng() % IMAGES));
+    });
+    for (auto& t : drives)
+        t.join();
+    running = false;
+    webdav.join();
+
+    StressResult r;
+    r.seconds = (now_ns() - started) / 1e9;
+    r.unstable = unstable;
+    std::vector<uint64_t> all;
+    double best = 1e18, worst = 0;
+    for (auto& l : latency)
+    {
+        all.insert(all.end(), l.begin(), l.end());
+        double p99 = percentiles(l).p99;
+        best = std::min(best, p99);
+        worst = std::max(worst, p99);
+    }
+    r.all = percentiles(all);
+    r.fairness = worst / std::max(best, 0.001);
+    return r;
+}
+
+static void print(const char* name, const StressResult& r)
+{
+    printf("%-8s %d drives x %d ops: p50 %.1f us, p95 %.1f us, p99 %.1f us, max %.1f us, "
+           "worst/best drive p99 %.1f, %.2f s\n",
+           name, DRIVES, OPS_PER_DRIVE, r.all.p50, r.all.p95, r.all.p99, r.all.max, r.fairness, r.seconds);
+}
+
+void setUp(void)
+{
+    ImageBroker::clear();
+    ImageBroker::setBudget(16 * IMAGE_BYTES);
+    SessionBroker::clear();
+    opens = 0;
+    connects = 0;
+    closed = 0;
+    closed_unlocked = 0;
+}
+
+void tearDown(void) {}
+
+void test_lease_holds_an_image_and_what_is_inside_it(void)
+{
+    MLease drive;
+    drive.hold("sd:/games/disk1.d81/PART2/");
+    TEST_ASSERT_TRUE(LeaseTable::image("sd:/games/disk1.d81"));
+    TEST_ASSERT_TRUE(LeaseTable::image("sd:/games/disk1.d81/PART2"));
+    TEST_ASSERT_FALSE(LeaseTable::image("sd:/games/disk2.d81"));
+    TEST_ASSERT_FALSE(LeaseTable::image("sd:/games/disk1.d81/PART3"));
+    TEST_ASSERT_EQUAL_UINT32(1, LeaseTable::count());
+
+    {
+        MLease console;
+        console.hold("sd:/games/disk2.d81");
+        TEST_ASSERT_TRUE(LeaseTable::image("sd:/games/disk2.d81"));
+        TEST_ASSERT_EQUAL_UINT32(2, LeaseTable::count());
+    }
+    TEST_ASSERT_FALSE(LeaseTable::image("sd:/games/disk2.d81"));
+
+    // Moving within the image never lets it go
+    drive.hold("sd:/games/disk1.d81");
+    TEST_ASSERT_TRUE(LeaseTable::image("sd:/games/disk1.d81"));
+    drive.release();
+    TEST_ASSERT_FALSE(LeaseTable::image("sd:/games/disk1.d81"));
+    TEST_ASSERT_EQUAL_UINT32(0, LeaseTable::count());
+}
+
+void test_lease_holds_sessions_as_cwd_matching_did(void)
+{
+    MLease drive;
+
+    // Same host under any scheme: sessions for https:// are keyed http://
+    drive.hold("https://example.com/c64/games.zip");
+    TEST_ASSERT_TRUE(LeaseTable::session("http://example.com:443"));
+    TEST_ASSERT_FALSE(LeaseTable::session("http://example.org:443"));
+    TEST_ASSERT_FALSE(LeaseTable::session("tnfs://server:16384"));
+
+    // A user and a port in the path don't change the host
+    drive.hold("ftp://anon@server:2121/pub");
+    TEST_ASSERT_TRUE(LeaseTable::session("ftp://server:21"));
+    TEST_ASSERT_FALSE(LeaseTable::session("http://example.com:443"));
+
+    // A hostless path uses its scheme's default host
+    drive.hold("csip:/games");
+    TEST_ASSERT_TRUE(LeaseTable::session("csip://commodoreserver.com:1541"));
+
+    // A port 0 session serves its whole scheme
+    drive.hold("mdns://");
+    TEST_ASSERT_TRUE(LeaseTable::session("mdns://mdns:0"));
+    drive.hold("mdns://c64-server.local/");
+    TEST_ASSERT_TRUE(LeaseTable::session("mdns://mdns:0"));
+    TEST_ASSERT_FALSE(LeaseTable::session("tnfs://server:0"));
+
+    // Local paths hold no session
+    drive.hold("/games");
+    TEST_ASSERT_FALSE(LeaseTable::session("mdns://mdns:0"));
+}
+
+void test_leased_images_are_kept_and_others_go(void)
+{
+    MLease drive8, drive9;
+    drive8.hold(image_url(0));
+    drive9.hold(image_url(1) + "/SUBDIR");
+    auto held8 = ImageBroker::obtain("d64", image_url(0));
+    auto held9 = ImageBroker::obtain("d64", image_url(1));
+
+    // Four times what the budget holds, twice over
+    for (int round = 0; round < 2; round++)
+        for (int i = 2; i < IMAGES; i++)
+            ImageBroker::obtain("d64", image_url(i));
+    TEST_ASSERT_TRUE(ImageBroker::bytes() <= ImageBroker::limit() + 2 * IMAGE_BYTES);
+    TEST_ASSERT_TRUE(ImageBroker::evictions > 0);
+    TEST_ASSERT_TRUE(held8 == ImageBroker::obtain("d64", image_url(0)));
+    TEST_ASSERT_TRUE(held9 == ImageBroker::obtain("d64", image_url(1)));
+
+    ImageBroker::validate();
+    TEST_ASSERT_EQUAL(2, ImageBroker::count());
+
+    drive9.release();
+    ImageBroker::validate();
+    TEST_ASSERT_EQUAL(1, ImageBroker::count());
+    TEST_ASSERT_TRUE(ImageBroker::exists("d64" + image_url(0)));
+}
+
+// A stream's buffers fill as it is read. One that grows past its shard's
+// share on a hit makes room behind it, as a new one would.
+void test_a_stream_that_grows_makes_room(void)
+{
+    for (int i = 0; i < IMAGES; i++)
+        ImageBroker::obtain("d64", image_url(i));
+    TEST_ASSERT_TRUE(ImageBroker::bytes() <= ImageBroker::limit());
+
+    auto grown = std::static_pointer_cast<FakeImage>(ImageBroker::obtain("d64", image_url(IMAGES - 1)));
+    grown->bytes = 2 * IMAGE_BYTES;
+    uint32_t evicted = ImageBroker::evictions;
+    TEST_ASSERT_TRUE(grown == ImageBroker::obtain("d64", image_url(IMAGES - 1)));
+
+    TEST_ASSERT_TRUE(ImageBroker::evictions > evicted);
+    TEST_ASSERT_TRUE(ImageBroker::bytes() <= ImageBroker::limit());
+    TEST_ASSERT_TRUE(ImageBroker::exists("d64" + image_url(IMAGES - 1)));
+}
+
+// The budget is the broker's, not a quarter of it per shard: images that
+// all hash to one shard may fill it, and only then does that shard evict.
+void test_one_busy_shard_may_use_the_whole_budget(void)
+{
+    const size_t fit = ImageBroker::limit() / IMAGE_BYTES;
+    auto shard_of = [](int i) {
+        return std::hash<std::string>()("d64" + image_url(i)) % IMAGE_BROKER_SHARDS;
+    };
+    std::vector<int> together;
+    for (int i = 0; together.size() < fit + 2; i++)
+        if (shard_of(i) == shard_of(0))
+            together.push_back(i);
+
+    uint32_t evicted = ImageBroker::evictions;
+    for (size_t n = 0; n < fit; n++)
+        ImageBroker::obtain("d64", image_url(together[n]));
+    TEST_ASSERT_EQUAL_UINT32(evicted, ImageBroker::evictions);
+    TEST_ASSERT_EQUAL(fit, ImageBroker::count());
+    TEST_ASSERT_EQUAL(ImageBroker::limit(), ImageBroker::bytes());
+
+    // One more, and the oldest goes
+    ImageBroker::obtain("d64", image_url(together[fit]));
+    TEST_ASSERT_EQUAL_UINT32(evicted + 1, ImageBroker::evictions);
+    TEST_ASSERT_EQUAL(fit, ImageBroker::count());
+    TEST_ASSERT_FALSE(ImageBroker::exists("d64" + image_url(together[0])));
+
+    // Any other shard makes room the same way, from its own entries
+    int elsewhere = 0;
+    while (shard_of(elsewhere) == shard_of(0))
+        elsewhere++;
+    ImageBroker::obtain("d64", image_url(elsewhere));
+    ImageBroker::obtain("d64", image_url(together[fit + 1]));
+    TEST_ASSERT_TRUE(ImageBroker::bytes() <= ImageBroker::limit() + IMAGE_BYTES);
+}
+
+void test_streams_are_closed_outside_the_lock(void)
+{
+    // Evicted for room
+    ImageBroker::obtain("d64", closing_url(0));
+    for (int i = 0; i < IMAGES; i++)
+        ImageBroker::obtain("d64", image_url(i));
+    TEST_ASSERT_FALSE(ImageBroker::exists("d64" + closing_url(0)));
+    TEST_ASSERT_EQUAL_UINT32(1, closed);
+
+    // Disposed of, and dropped by validate() and clear()
+    ImageBroker::obtain("d64", closing_url(1));
+    ImageBroker::dispose("d64" + closing_url(1));
+    ImageBroker::obtain("d64", closing_url(2));
+    ImageBroker::validate();
+    ImageBroker::obtain("d64", closing_url(3));
+    ImageBroker::clear();
+    TEST_ASSERT_EQUAL_UINT32(4, closed);
+    TEST_ASSERT_EQUAL_UINT32(closed, closed_unlocked);
+}
+
+void test_drives_opening_one_image_share_its_stream(void)
+{
+    std::vector<std::shared_ptr<MMediaStream>> streams(DRIVES);
+    std::vector<std::thread> drives;
+    for (int d = 0; d < DRIVES; d++)
+        drives.emplace_back([&, d]() { streams[d] = ImageBroker::obtain("d64", image_url(7)); });
+    for (auto& t : drives)
+        t.join();
+
+    for (int d = 0; d < DRIVES; d++)
+        TEST_ASSERT_TRUE(streams[d] == streams[0]);
+    TEST_ASSERT_EQUAL(1, ImageBroker::count());
+    printf("%d drives opening one image at once: %u opened, 1 kept\n", DRIVES, (unsigned)opens);
+}
+
+// A drive reads a file ahead on another task only once the broker lends it
+// the image stream; anyone else reading that image meanwhile - another
+// channel, WebDAV, the console - gets a stream of their own.
+void test_a_checked_out_stream_is_read_by_its_reader_alone(void)
+{
+    std::shared_ptr<MStream> channel = ImageBroker::obtain("d64", reading_url());
+    auto image = static_cast<ReadingImage*>(channel.get());
+
+    // Another reader holds it: not lent
+    auto other = ImageBroker::obtain("d64", reading_url());
+    TEST_ASSERT_TRUE(other == channel);
+    TEST_ASSERT_FALSE(ImageBroker::checkout(channel));
+    other.reset();
+    TEST_ASSERT_TRUE(ImageBroker::checkout(channel));
+
+    // The producer reads the file through while a second reader opens the
+    // same image and reads it too
+    std::atomic<bool> ahead{true};
+    std::atomic<uint32_t> wrong{0};
+    std::thread producer([&]() {
+        uint8_t buf[256];
+        uint32_t pos = 0, n;
+        while ((n = channel->read(buf, sizeof(buf))) > 0)
+        {
+            for (uint32_t i = 0; i < n; i++)
+                if (buf[i] != (uint8_t)(pos + i))
+                    wrong++;
+            pos += n;
+        }
+        ahead = false;
+    });
+
+    int reads = 0;
+    while (ahead)
+    {
+        auto second = ImageBroker::obtain("d64", reading_url());
+        TEST_ASSERT_NOT_NULL(second.get());
+        TEST_ASSERT_TRUE(second != channel);
+        uint8_t buf[16];
+        uint32_t pos = (reads * 997) % 60000;
+        second->seek(pos);
+        TEST_ASSERT_EQUAL_UINT32(sizeof(buf), second->read(buf, sizeof(buf)));
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)pos, buf[0]);
+        reads++;
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(reads > 0);
+    TEST_ASSERT_EQUAL_UINT32(0, wrong);
+    TEST_ASSERT_FALSE(image->overlapped);
+    TEST_ASSERT_EQUAL(1, ImageBroker::count());
+
+    // Back in: shared again
+    ImageBroker::checkin(channel);
+    TEST_ASSERT_TRUE(ImageBroker::obtain("d64", reading_url()) == channel);
+}
+
+void test_sessions_are_shared_and_dropped_without_a_lease(void)
+{
+    std::vector<std::shared_ptr<FakeSession>> sessions(DRIVES);
+    std::vector<std::thread> drives;
+    for (int d = 0; d < DRIVES; d++)
+        drives.emplace_back([&, d]() { sessions[d] = SessionBroker::obtain<FakeSession>("server" + std::to_string(d % 4), 6510); });
+    for (auto& t : drives)
+        t.join();
+
+    TEST_ASSERT_EQUAL(4, SessionBroker::count());
+    for (int d = 0; d < DRIVES; d++)
+    {
+        TEST_ASSERT_NOT_NULL(sessions[d].get());
+        TEST_ASSERT_TRUE(sessions[d] == SessionBroker::find<FakeSession>(sessions[d]->getKey()));
+    }
+
+    // (A port 0 session would be held by any lease in its scheme.)
+    MLease drive8;
+    drive8.hold("fake://server1/games");
+
+    // service() runs at most once a second
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    SessionBroker::service();
+    TEST_ASSERT_EQUAL(1, SessionBroker::count());
+    TEST_ASSERT_NOT_NULL(SessionBroker::find<FakeSession>("fake://server1:6510").get());
+}
+
+void test_stress_drives_with_leases_against_one_lock(void)
+{
+    StressResult sharded = stress(
+        [](const std::string& url) { return ImageBroker::obtain("d64", url); },
+        [](int d, const std::string& url) {
+            static MLease leases[DRIVES];
+            leases[d].hold(url);
+        });
+    uint32_t sharded_opens = opens;
+
+    opens = 0;
+    LegacyBroker legacy;
+    legacy.budget = ImageBroker::limit();
+    StressResult locked = stress(
+        [&](const std::string& url) { return legacy.obtain("d64", url); },
+        [&](int d, const std::string& url) {
+            std::lock_guard<std::mutex> lock(legacy.drives[d].mutex);
+            legacy.drives[d].cwd = url;
+        });
+
+    print("leases", sharded);
+    print("one lock", locked);
+    printf("images opened: %u with leases, %u with one lock\n", (unsigned)sharded_opens, (unsigned)opens);
+
+    TEST_ASSERT_EQUAL_UINT32(0, sharded.unstable);
+    TEST_ASSERT_EQUAL_UINT32(0, LeaseTable::count());
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lease_holds_an_image_and_what_is_inside_it);
+    RUN_TEST(test_lease_holds_sessions_as_cwd_matching_did);
+    RUN_TEST(test_leased_images_are_kept_and_others_go);
+    RUN_TEST(test_a_stream_that_grows_makes_room);
+    RUN_TEST(test_one_busy_shard_may_use_the_whole_budget);
+    RUN_TEST(test_streams_are_closed_outside_the_lock);
+    RUN_TEST(test_drives_opening_one_image_share_its_stream);
+    RUN_TEST(test_a_checked_out_stream_is_read_by_its_reader_alone);
+    RUN_TEST(test_sessions_are_shared_and_dropped_without_a_lease);
+    RUN_TEST(test_stress_drives_with_leases_against_one_lock);
+    return UNITY_END();
+}
+
+int main(int argc, char** argv)
+{
+    return runUnityTests();
+}
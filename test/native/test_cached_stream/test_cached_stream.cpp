@@ -0,0 +1,204 @@
+// Tests for MStream::borrow()/readSpan() over a RAM-backed
+// MSession::CachedFile, the zero-copy path a fully resident file takes to
+// the IEC channel, WebDAV GET, console cp and Meat::iostream (console cat).
+// Meat::iostream itself is not covered: meat_buffer.h relies on libstdc++
+// internals of the ESP toolchain and does not build on the host.
+//
+// Each of those used to read() the file into a buffer of its own, copying
+// bytes that were already sitting in RAM. A RAM CachedFile now lends its
+// memory; every other stream still reads, through the same readSpan() call.
+//
+// The benchmark runs a 1 MB file through each consumer's loop shape, with
+// its own chunk size, once through a stream that can only read() (the old
+// path) and once through the lending CachedFile stream.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "meatloaf.h"
+#include "meat_session.h"
+
+static const uint32_t FILE_SIZE = 1024 * 1024;
+
+// The same bytes, offered only through read(): what every consumer saw
+// before CachedFile streams could lend.
+class CopyOnlyStream : public MStream
+{
+public:
+    CopyOnlyStream(std::shared_ptr<MStream> inner) : MStream(""), m_inner(inner)
+    {
+        _size = inner->size();
+    }
+
+    bool isOpen() override { return m_inner->isOpen(); }
+    bool open(std::ios_base::openmode mode) override { return m_inner->open(mode); }
+    void close() override {}
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        uint32_t n = m_inner->read(buf, size);
+        _position = m_inner->position();
+        return n;
+    }
+    uint32_t write(const uint8_t*, uint32_t) override { return 0; }
+    bool seek(uint32_t pos) override
+    {
+        bool ok = m_inner->seek(pos);
+        _position = m_inner->position();
+        return ok;
+    }
+
+private:
+    std::shared_ptr<MStream> m_inner;
+};
+
+static uint8_t* pattern(uint32_t size)
+{
+    uint8_t* data = (uint8_t*)malloc(size);
+    for (uint32_t i = 0; i < size; i++)
+        data[i] = (uint8_t)(i * 7 + (i >> 8));
+    return data;
+}
+
+static std::shared_ptr<MSession::CachedFile> cached(uint32_t size)
+{
+    return std::make_shared<MSession::CachedFile>(pattern(size), size);
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+void test_ram_cached_stream_lends_in_place(void)
+{
+    auto cf = cached(1000);
+    auto stream = cf->openStream();
+    TEST_ASSERT_NOT_NULL(stream.get());
+
+    const uint8_t* first;
+    TEST_ASSERT_EQUAL_UINT32(512, stream->borrow(first, 512));
+    TEST_ASSERT_EQUAL_UINT32(512, stream->position());
+
+    // The next run sits right after the first one in the same memory:
+    // nothing was copied anywhere.
+    const uint8_t* second;
+    TEST_ASSERT_EQUAL_UINT32(488, stream->borrow(second, 512));
+    TEST_ASSERT_EQUAL_PTR(first + 512, second);
+    TEST_ASSERT_EQUAL_UINT32(1000, stream->position());
+
+    uint8_t* expected = pattern(1000);
+    TEST_ASSERT_EQUAL_MEMORY(expected, first, 1000);
+    free(expected);
+
+    const uint8_t* end;
+    TEST_ASSERT_EQUAL_UINT32(0, stream->borrow(end, 512));
+    TEST_ASSERT_TRUE(stream->eos());
+}
+
+void test_borrow_follows_seek(void)
+{
+    auto cf = cached(1000);
+    auto stream = cf->openStream();
+
+    const uint8_t* base;
+    stream->borrow(base, 1);
+    TEST_ASSERT_TRUE(stream->seek(900));
+    const uint8_t* data;
+    TEST_ASSERT_EQUAL_UINT32(100, stream->borrow(data, 512));
+    TEST_ASSERT_EQUAL_PTR(base + 900, data);
+}
+
+void test_read_only_stream_falls_back_to_copy(void)
+{
+    auto cf = cached(1000);
+    auto stream = std::make_shared<CopyOnlyStream>(cf->openStream());
+
+    const uint8_t* data;
+    TEST_ASSERT_EQUAL_UINT32(0, stream->borrow(data, 512));
+    TEST_ASSERT_NULL(data);
+
+    uint8_t buf[512];
+    TEST_ASSERT_EQUAL_UINT32(512, stream->readSpan(data, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_PTR(buf, data);
+    TEST_ASSERT_EQUAL_UINT32(488, stream->readSpan(data, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_UINT32(0, stream->readSpan(data, buf, sizeof(buf)));
+}
+
+// One pass of a consumer's loop: readSpan() chunks of 'chunk' bytes and
+// hand each to a sink that takes its own copy, as the bus, the socket send
+// or the file write does. That last copy stays; the one before it is what
+// lending removes.
+static uint64_t drain(MStream& stream, uint8_t* buf, uint8_t* sink, uint32_t chunk)
+{
+    uint64_t sum = 0;
+    const uint8_t* data;
+    uint32_t n;
+    stream.seek(0);
+    while ((n = stream.readSpan(data, buf, chunk)) > 0) {
+        memcpy(sink, data, n);
+        sum += sink[0] + sink[n - 1];
+    }
+    return sum;
+}
+
+static double rate(double seconds, int passes)
+{
+    return (double)FILE_SIZE * passes / seconds / (1024 * 1024);
+}
+
+void test_consumer_throughput_benchmark(void)
+{
+    auto cf = cached(FILE_SIZE);
+    auto lending = cf->openStream();
+    CopyOnlyStream copying(cf->openStream());
+    uint8_t* buf = (uint8_t*)malloc(16384);
+    uint8_t* sink = (uint8_t*)malloc(16384);
+
+    struct Consumer {
+        const char* name;
+        uint32_t chunk;
+    } consumers[] = {
+        { "iec channel (512 B refills)", 512 },
+        { "webdav GET (16 KB chunks)", 16384 },
+        { "console cp (4 KB chunks)", 4096 },
+    };
+
+    const int passes = 50;
+    for (auto& c : consumers) {
+        double seconds[2];
+        MStream* streams[2] = { &copying, lending.get() };
+        uint64_t sums[2] = { 0, 0 };
+        for (int s = 0; s < 2; s++) {
+            auto started = std::chrono::steady_clock::now();
+            for (int i = 0; i < passes; i++)
+                sums[s] += drain(*streams[s], buf, sink, c.chunk);
+            seconds[s] = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        }
+        TEST_ASSERT_EQUAL_UINT64(sums[0], sums[1]);
+        printf("%s: copied %.0f MB/s, lent %.0f MB/s\n",
+               c.name, rate(seconds[0], passes), rate(seconds[1], passes));
+    }
+
+    free(buf);
+    free(sink);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ram_cached_stream_lends_in_place);
+    RUN_TEST(test_borrow_follows_seek);
+    RUN_TEST(test_read_only_stream_falls_back_to_copy);
+    RUN_TEST(test_consumer_throughput_benchmark);
+    return UNITY_END();
+}
+
+int main(int argc, char** argv)
+{
+    return runUnityTests();
+}
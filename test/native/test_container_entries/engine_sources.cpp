@@ -10,6 +10,7 @@
 #include "../../../lib/utils/U8Char.cpp"
 #include "../../../lib/utils/string_utils.cpp"
 #include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
 #include "../../../lib/meatloaf/media/archive/ark.cpp"
 #include "../../../lib/meatloaf/media/archive/lbr.cpp"
 #include "../../../lib/meatloaf/media/archive/lnx.cpp"
@@ -0,0 +1,23 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp leaks a bare min(a,b) macro into the rest of this unit.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/meatloaf/scanner/content_index.cpp"
+
+// MFileSystem's constructor and destructor live in meatloaf.cpp as well.
+MFileSystem::MFileSystem(const char* s)
+{
+    symbol = s;
+}
+
+MFileSystem::~MFileSystem() {}
+
+// The suite opens its fixture tree through its own MFSOwner::File().
+#define NATIVE_STUBS_REAL_MFSOWNER
+void MFSOwner::suspendResolveCache() {}
+void MFSOwner::resumeResolveCache() {}
+#include "../test_disk_write/native_stubs.cpp"
@@ -0,0 +1,408 @@
+// Tests for ContentIndexer (lib/meatloaf/scanner/content_index.h), which
+// lists the inside of disk images and archives for updatedb/locate.
+//
+// The fixture is a volume of nested containers, served through this suite's
+// MFSOwner::File() the way the real filesystems serve them: an entry of a
+// container is MFSOwner::File(container url + "/" + name), and an entry that
+// is itself an image reports isDirectory(). The catalog is an in-memory one
+// with the same contract as the locate database's.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "meatloaf.h"
+#include "scanner/content_index.h"
+
+/********************************************************
+ * Fixture volume
+ ********************************************************/
+
+struct Node
+{
+    std::string name;
+    std::string type;
+    uint32_t size;
+    std::vector<Node> children;   // non-empty: a container
+};
+
+// Every node by url, rebuilt by setUp()
+static std::map<std::string, const Node*> s_nodes;
+static Node s_volume;
+static int s_opens = 0;
+
+class FixtureFile : public MFile
+{
+public:
+    FixtureFile(const std::string& u, const Node* node) : m_node(node)
+    {
+        url = u;
+        name = node->name;
+        extension = node->type;
+        size = node->size;
+        is_dir = node->children.empty() ? 0 : 1;
+    }
+
+    std::shared_ptr<MStream> getDecodedStream(std::shared_ptr<MStream>) override { return nullptr; }
+
+    bool rewindDirectory() override
+    {
+        m_next = 0;
+        return true;
+    }
+
+    MFile* getNextFileInDir() override
+    {
+        if (m_next >= m_node->children.size())
+            return nullptr;
+        return MFSOwner::File(url + "/" + m_node->children[m_next++].name);
+    }
+
+private:
+    const Node* m_node;
+    size_t m_next = 0;
+};
+
+MFile* MFSOwner::File(std::string path, bool default_to_flash)
+{
+    (void)default_to_flash;
+    auto found = s_nodes.find(path);
+    if (found == s_nodes.end())
+        return nullptr;
+    if (!found->second->children.empty())
+        s_opens++;
+    return new FixtureFile(path, found->second);
+}
+
+// The default filesystem first, as in meatloaf.cpp, then one that claims
+// images and archives by extension
+class FixtureFileSystem : public MFileSystem
+{
+public:
+    FixtureFileSystem(const char* symbol, std::vector<std::string> extensions)
+        : MFileSystem(symbol), m_extensions(extensions) {}
+
+    bool handles(std::string path) override
+    {
+        return m_extensions.empty() || byExtension(m_extensions, path);
+    }
+    MFile* getFile(std::string path) override { return MFSOwner::File(path); }
+
+private:
+    std::vector<std::string> m_extensions;
+};
+
+static FixtureFileSystem s_flashFS("flash", {});
+static FixtureFileSystem s_mediaFS("media", { ".d64", ".d71", ".d81", ".t64", ".zip" });
+std::vector<MFileSystem*> MFSOwner::availableFS { &s_flashFS, &s_mediaFS };
+
+static void addNodes(const std::string& url, const Node& node)
+{
+    s_nodes[url] = &node;
+    for (const auto& child : node.children)
+        addNodes(url + "/" + child.name, child);
+}
+
+static Node file(const char* name, const char* type, uint32_t size)
+{
+    return { name, type, size, {} };
+}
+
+static Node container(const char* name, const char* type, uint32_t size, std::vector<Node> children)
+{
+    return { name, type, size, children };
+}
+
+// /sd/games/collection.zip
+//     elite.d64            ELITE (PRG), ELITE DOCS (SEQ)
+//     readme.txt
+//     disk2.d71            MENU (PRG), tapes.t64
+//                              tapes.t64   TAPE GAME (PRG), inner.d64 (too deep)
+//     huge.d81             bigger than the nested budget
+// /sd/demos/intro.t64      INTRO (PRG)
+static void buildVolume()
+{
+    Node zip = container("collection.zip", "zip", 400000, {
+        container("elite.d64", "d64", 174848, {
+            file("ELITE", "PRG", 30000),
+            file("ELITE DOCS", "SEQ", 2000),
+        }),
+        file("readme.txt", "txt", 1200),
+        container("disk2.d71", "d71", 349696, {
+            file("MENU", "PRG", 1000),
+            container("tapes.t64", "t64", 60000, {
+                file("TAPE GAME", "PRG", 40000),
+                container("inner.d64", "d64", 174848, {
+                    file("TOO DEEP", "PRG", 100),
+                }),
+            }),
+        }),
+        container("huge.d81", "d81", 2 * 1024 * 1024, {
+            file("HIDDEN", "PRG", 100),
+        }),
+    });
+    Node tape = container("intro.t64", "t64", 9000, {
+        file("INTRO", "PRG", 8000),
+    });
+
+    s_volume = { "sd", "", 0, { zip, tape } };
+    s_nodes.clear();
+    addNodes("/sd/games/collection.zip", s_volume.children[0]);
+    addNodes("/sd/demos/intro.t64", s_volume.children[1]);
+}
+
+/********************************************************
+ * In-memory catalog
+ ********************************************************/
+
+class MemoryCatalog : public ContentCatalog
+{
+public:
+    struct Stamp
+    {
+        uint32_t size;
+        time_t mtime;
+    };
+
+    bool unchanged(const std::string& path, uint32_t size, time_t mtime) override
+    {
+        auto found = stamps.find(path);
+        return found != stamps.end() && found->second.size == size && found->second.mtime == mtime;
+    }
+
+    void forget(const std::string& path) override
+    {
+        std::vector<ContentEntry> kept;
+        for (auto& e : entries)
+            if (e.container != path && e.container.compare(0, path.size() + 1, path + "/") != 0)
+                kept.push_back(e);
+        entries.swap(kept);
+    }
+
+    bool add(const ContentEntry& entry) override
+    {
+        entries.push_back(entry);
+        return true;
+    }
+
+    void stamp(const std::string& path, uint32_t size, time_t mtime) override
+    {
+        stamps[path] = { size, mtime };
+    }
+
+    // Full paths of the entries named 'name'
+    std::vector<std::string> locate(const std::string& name) const
+    {
+        std::vector<std::string> found;
+        for (auto& e : entries)
+            if (mstr::equals(e.name.c_str(), name.c_str(), false))
+                found.push_back(e.container + "/" + e.name);
+        return found;
+    }
+
+    const ContentEntry* find(const std::string& container, const std::string& name) const
+    {
+        for (auto& e : entries)
+            if (e.container == container && e.name == name)
+                return &e;
+        return nullptr;
+    }
+
+    std::vector<ContentEntry> entries;
+    std::map<std::string, Stamp> stamps;
+};
+
+static const char* ZIP_URL = "/sd/games/collection.zip";
+static const char* ZIP_PATH = "/games/collection.zip";
+static const char* TAPE_URL = "/sd/demos/intro.t64";
+static const char* TAPE_PATH = "/demos/intro.t64";
+
+void setUp(void)
+{
+    buildVolume();
+    s_opens = 0;
+}
+
+void tearDown(void) {}
+
+/********************************************************
+ * Tests
+ ********************************************************/
+
+void test_containers_are_recognised_by_extension(void)
+{
+    TEST_ASSERT_TRUE(ContentIndexer::isContainer("collection.zip"));
+    TEST_ASSERT_TRUE(ContentIndexer::isContainer("ELITE.D64"));
+    TEST_ASSERT_FALSE(ContentIndexer::isContainer("readme.txt"));
+    TEST_ASSERT_FALSE(ContentIndexer::isContainer("ELITE"));
+}
+
+void test_nested_images_are_indexed_with_their_container_path(void)
+{
+    MemoryCatalog catalog;
+    ContentIndexer indexer(catalog);
+
+    TEST_ASSERT_EQUAL(ContentIndexer::INDEXED, indexer.index(ZIP_URL, ZIP_PATH, 400000, 1000));
+
+    auto found = catalog.locate("elite");
+    TEST_ASSERT_EQUAL(1, (int)found.size());
+    TEST_ASSERT_EQUAL_STRING("/games/collection.zip/elite.d64/ELITE", found[0].c_str());
+
+    const ContentEntry* elite = catalog.find("/games/collection.zip/elite.d64", "ELITE");
+    TEST_ASSERT_NOT_NULL(elite);
+    TEST_ASSERT_EQUAL_STRING("PRG", elite->type.c_str());
+    TEST_ASSERT_EQUAL_UINT32(30000, elite->size);
+    TEST_ASSERT_FALSE(elite->is_dir);
+
+    const ContentEntry* image = catalog.find(ZIP_PATH, "elite.d64");
+    TEST_ASSERT_NOT_NULL(image);
+    TEST_ASSERT_TRUE(image->is_dir);
+
+    TEST_ASSERT_NOT_NULL(catalog.find(ZIP_PATH, "readme.txt"));
+    TEST_ASSERT_NOT_NULL(catalog.find("/games/collection.zip/disk2.d71/tapes.t64", "TAPE GAME"));
+    TEST_ASSERT_TRUE(catalog.stamps.count(ZIP_PATH) == 1);
+}
+
+void test_budget_bounds_depth_and_nested_size(void)
+{
+    MemoryCatalog catalog;
+    ContentIndexer indexer(catalog);
+    indexer.index(ZIP_URL, ZIP_PATH, 400000, 1000);
+
+    // Listed where they are, not looked into
+    TEST_ASSERT_NOT_NULL(catalog.find("/games/collection.zip/disk2.d71/tapes.t64", "inner.d64"));
+    TEST_ASSERT_NOT_NULL(catalog.find(ZIP_PATH, "huge.d81"));
+    TEST_ASSERT_EQUAL(0, (int)catalog.locate("TOO DEEP").size());
+    TEST_ASSERT_EQUAL(0, (int)catalog.locate("HIDDEN").size());
+    TEST_ASSERT_EQUAL_UINT32(2, indexer.truncated());
+
+    // A cap on entries per container ends the listing there, and the
+    // container still counts as indexed
+    MemoryCatalog capped;
+    ContentBudget budget;
+    budget.max_entries = 3;
+    ContentIndexer small(capped, budget);
+    TEST_ASSERT_EQUAL(ContentIndexer::INDEXED, small.index(ZIP_URL, ZIP_PATH, 400000, 1000));
+    TEST_ASSERT_EQUAL(3, (int)capped.entries.size());
+}
+
+void test_unchanged_containers_are_not_opened(void)
+{
+    MemoryCatalog catalog;
+    ContentIndexer indexer(catalog);
+    indexer.index(ZIP_URL, ZIP_PATH, 400000, 1000);
+    indexer.index(TAPE_URL, TAPE_PATH, 9000, 1000);
+    size_t indexed = catalog.entries.size();
+
+    s_opens = 0;
+    TEST_ASSERT_EQUAL(ContentIndexer::UNCHANGED, indexer.index(ZIP_URL, ZIP_PATH, 400000, 1000));
+    TEST_ASSERT_EQUAL(ContentIndexer::UNCHANGED, indexer.index(TAPE_URL, TAPE_PATH, 9000, 1000));
+    TEST_ASSERT_EQUAL(0, s_opens);
+    TEST_ASSERT_EQUAL(indexed, catalog.entries.size());
+
+    // Rewritten: what was recorded before goes, the new contents come in
+    Node tape = container("intro.t64", "t64", 9100, { file("INTRO V2", "PRG", 8100) });
+    s_nodes["/sd/demos/intro.t64"] = &tape;
+    s_nodes["/sd/demos/intro.t64/INTRO V2"] = &tape.children[0];
+
+    TEST_ASSERT_EQUAL(ContentIndexer::INDEXED, indexer.index(TAPE_URL, TAPE_PATH, 9100, 2000));
+    TEST_ASSERT_EQUAL(0, (int)catalog.locate("INTRO").size());
+    TEST_ASSERT_EQUAL(1, (int)catalog.locate("INTRO V2").size());
+    TEST_ASSERT_EQUAL(indexed, catalog.entries.size());
+}
+
+void test_stopped_index_is_not_stamped_and_resumes_cleanly(void)
+{
+    MemoryCatalog catalog;
+    ContentIndexer indexer(catalog);
+    int polls = 0;
+    indexer.stopRequested = [&polls] { return ++polls > 4; };
+
+    TEST_ASSERT_EQUAL(ContentIndexer::STOPPED, indexer.index(ZIP_URL, ZIP_PATH, 400000, 1000));
+    TEST_ASSERT_EQUAL(0, (int)catalog.stamps.count(ZIP_PATH));
+    TEST_ASSERT_EQUAL(4, (int)catalog.entries.size());
+
+    // The next pass starts that container over rather than adding to it
+    MemoryCatalog full;
+    ContentIndexer whole(full);
+    whole.index(ZIP_URL, ZIP_PATH, 400000, 1000);
+
+    indexer.stopRequested = nullptr;
+    TEST_ASSERT_EQUAL(ContentIndexer::INDEXED, indexer.index(ZIP_URL, ZIP_PATH, 400000, 1000));
+    TEST_ASSERT_EQUAL(full.entries.size(), catalog.entries.size());
+}
+
+void test_unreadable_container_is_stamped_as_failed(void)
+{
+    MemoryCatalog catalog;
+    ContentIndexer indexer(catalog);
+
+    TEST_ASSERT_EQUAL(ContentIndexer::FAILED, indexer.index("/sd/missing.d64", "/missing.d64", 174848, 1000));
+    TEST_ASSERT_EQUAL(ContentIndexer::UNCHANGED, indexer.index("/sd/missing.d64", "/missing.d64", 174848, 1000));
+}
+
+// A catalog the size of a well-stocked card, and the lookup locate makes:
+// by name, across every entry of every container.
+void test_index_throughput_benchmark(void)
+{
+    const int IMAGES = 200;
+    const int PER_IMAGE = 144;   // a full D64 directory
+
+    std::vector<Node> images;
+    for (int i = 0; i < IMAGES; i++)
+    {
+        std::vector<Node> files;
+        for (int f = 0; f < PER_IMAGE; f++)
+        {
+            char name[17];
+            snprintf(name, sizeof(name), "GAME %03d-%03d", i, f);
+            files.push_back(file(name, "PRG", 2540));
+        }
+        char image[24];
+        snprintf(image, sizeof(image), "disk%03d.d64", i);
+        images.push_back(container(image, "d64", 174848, files));
+    }
+    Node zip = container("library.zip", "zip", 10000000, images);
+    s_nodes.clear();
+    addNodes("/sd/library.zip", zip);
+
+    MemoryCatalog catalog;
+    ContentBudget budget;
+    budget.max_entries = IMAGES * (PER_IMAGE + 1);
+    ContentIndexer indexer(catalog, budget);
+    auto started = std::chrono::steady_clock::now();
+    TEST_ASSERT_EQUAL(ContentIndexer::INDEXED, indexer.index("/sd/library.zip", "/library.zip", 10000000, 1000));
+    double first = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    started = std::chrono::steady_clock::now();
+    TEST_ASSERT_EQUAL(ContentIndexer::UNCHANGED, indexer.index("/sd/library.zip", "/library.zip", 10000000, 1000));
+    double again = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    TEST_ASSERT_EQUAL_UINT32(IMAGES * (PER_IMAGE + 1), indexer.entries());
+    TEST_ASSERT_EQUAL(1, (int)catalog.locate("GAME 123-045").size());
+    printf("indexed %u entries in %.1f ms, unchanged pass %.3f ms\n",
+           (unsigned)indexer.entries(), first * 1000, again * 1000);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_containers_are_recognised_by_extension);
+    RUN_TEST(test_nested_images_are_indexed_with_their_container_path);
+    RUN_TEST(test_budget_bounds_depth_and_nested_size);
+    RUN_TEST(test_unchanged_containers_are_not_opened);
+    RUN_TEST(test_stopped_index_is_not_stamped_and_resumes_cleanly);
+    RUN_TEST(test_unreadable_container_is_stamped_as_failed);
+    RUN_TEST(test_index_throughput_benchmark);
+    return UNITY_END();
+}
+
+int main(int argc, char** argv)
+{
+    return runUnityTests();
+}
@@ -0,0 +1,803 @@
+// Tests for the copy engine (lib/meatloaf/meat_copy.h).
+//
+// Sources and destinations are real: files in the working directory, and an
+// HTTP server on a loopback socket that answers "Range: bytes=N-" the way a web server does
+// (or ignores it, the way some do). The copy runs with jobScheduler started,
+// as it does on the device, so the writes really are on another thread.
+//
+// The benchmark at the end prints MB/s for file-to-file and HTTP-to-file
+// copies at several buffer sizes, serial and overlapped. Loopback is far
+// faster than WiFi and a local disk faster than an SD card, so the numbers
+// only compare the settings with each other; the overlap test uses streams
+// that take a fixed time per call to show what the second buffer buys.
+//
+// The server is written to POSIX sockets, and [env:native] links no winsock:
+// under mingw the tests that need it are ignored and the benchmark copies
+// files only.
+
+#include <unity.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "meat_copy.h"
+#include "fnScheduler.h"
+#include "media/disk/d64.h"
+#include "../test_disk_write/file_container_stream.h"
+
+static uint64_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void sleep_ms(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static std::vector<uint8_t> pattern(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> v(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        v[i] = (uint8_t)(seed >> 16);
+    }
+    return v;
+}
+
+static std::vector<uint8_t> slurp(const std::string& path)
+{
+    std::vector<uint8_t> v;
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (fp == nullptr)
+        return v;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+        v.insert(v.end(), buf, buf + n);
+    fclose(fp);
+    return v;
+}
+
+static void spit(const std::string& path, const uint8_t* data, size_t size)
+{
+    FILE* fp = fopen(path.c_str(), "wb");
+    fwrite(data, 1, size, fp);
+    fclose(fp);
+}
+
+/********************************************************
+ * Streams
+ ********************************************************/
+
+// A local file opened the way FlashMStream opens one: read, truncate or append
+class PosixStream : public MStream
+{
+public:
+    PosixStream(const std::string& path, std::ios_base::openmode mode) : MStream(path)
+    {
+        open(mode);
+    }
+    ~PosixStream() override { close(); }
+
+    bool isOpen() override { return m_fp != nullptr; }
+    bool isRandomAccess() override { return true; }
+
+    bool open(std::ios_base::openmode mode) override
+    {
+        const char* how = (mode & std::ios_base::app) ? "ab" : (mode & std::ios_base::out) ? "wb" : "rb";
+        m_fp = fopen(url.c_str(), how);
+        if (m_fp == nullptr)
+            return false;
+        fseek(m_fp, 0, SEEK_END);
+        _size = (uint32_t)ftell(m_fp);
+        _position = (mode & std::ios_base::app) ? _size : 0;
+        if (!(mode & std::ios_base::app))
+            fseek(m_fp, 0, SEEK_SET);
+        return true;
+    }
+
+    void close() override
+    {
+        if (m_fp != nullptr)
+            fclose(m_fp);
+        m_fp = nullptr;
+    }
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        uint32_t n = (uint32_t)fread(buf, 1, size, m_fp);
+        _position += n;
+        return n;
+    }
+
+    uint32_t write(const uint8_t* buf, uint32_t size) override
+    {
+        uint32_t n = (uint32_t)fwrite(buf, 1, size, m_fp);
+        _position += n;
+        if (_position > _size)
+            _size = _position;
+        return n;
+    }
+
+    bool seek(uint32_t pos) override
+    {
+        if (fseek(m_fp, (long)pos, SEEK_SET) != 0)
+            return false;
+        _position = pos;
+        return true;
+    }
+
+private:
+    FILE* m_fp = nullptr;
+};
+
+#ifndef _WIN32
+
+// An HTTP server on 127.0.0.1, one request per connection. With 'ranges'
+// off it answers every request with the whole body, as a server without
+// range support does.
+class LoopbackServer
+{
+public:
+    std::vector<uint8_t> body;
+    bool ranges = true;
+    std::atomic<int> requests{ 0 };
+
+    LoopbackServer()
+    {
+        m_listen = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(m_listen, (sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(m_listen, (sockaddr*)&addr, &len);
+        port = ntohs(addr.sin_port);
+        listen(m_listen, 4);
+        m_thread = std::thread([this] { serve(); });
+    }
+
+    ~LoopbackServer()
+    {
+        m_stopping = true;
+        shutdown(m_listen, SHUT_RDWR);
+        close(m_listen);
+        m_thread.join();
+    }
+
+    uint16_t port = 0;
+
+private:
+    int m_listen = -1;
+    std::atomic<bool> m_stopping{ false };
+    std::thread m_thread;
+
+    void serve()
+    {
+        while (!m_stopping)
+        {
+            int fd = accept(m_listen, nullptr, nullptr);
+            if (fd < 0)
+                continue;
+            answer(fd);
+            close(fd);
+        }
+    }
+
+    void answer(int fd)
+    {
+        std::string request;
+        char c;
+        while (request.find("\r\n\r\n") == std::string::npos && recv(fd, &c, 1, 0) == 1)
+            request += c;
+        requests++;
+
+        uint32_t from = 0;
+        size_t range = request.find("Range: bytes=");
+        if (ranges && range != std::string::npos)
+            from = (uint32_t)strtoul(request.c_str() + range + 13, nullptr, 10);
+        if (from > body.size())
+            from = (uint32_t)body.size();
+
+        char header[256];
+        if (ranges && range != std::string::npos)
+            snprintf(header, sizeof(header),
+                     "HTTP/1.1 206 Partial Content\r\nContent-Length: %u\r\nContent-Range: bytes %u-%u/%u\r\n\r\n",
+                     (unsigned)(body.size() - from), from, (unsigned)body.size() - 1, (unsigned)body.size());
+        else
+            snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Length: %u\r\n\r\n", (unsigned)body.size());
+        send(fd, header, strlen(header), MSG_NOSIGNAL);
+
+        size_t at = from;
+        while (at < body.size())
+        {
+            ssize_t n = send(fd, body.data() + at, std::min<size_t>(16384, body.size() - at), MSG_NOSIGNAL);
+            if (n <= 0)
+                break;
+            at += n;
+        }
+    }
+};
+
+// An HTTP client stream: a seek is a new GET with a Range header, and a
+// server that answers 200 to it has refused the seek
+class LoopbackHttpStream : public MStream
+{
+public:
+    LoopbackHttpStream(uint16_t port) : MStream("http://127.0.0.1/body"), m_port(port)
+    {
+        get(0);
+    }
+    ~LoopbackHttpStream() override { close(); }
+
+    bool isOpen() override { return m_fd >= 0; }
+    bool isNetwork() override { return true; }
+    bool open(std::ios_base::openmode) override { return isOpen(); }
+    uint32_t write(const uint8_t*, uint32_t) override { return 0; }
+
+    void close() override
+    {
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+    }
+
+    bool seek(uint32_t pos) override
+    {
+        if (pos == m_at)
+            return true;
+        if (!get(pos) || m_at != pos)
+            return false;
+        _position = pos;
+        return true;
+    }
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        uint32_t got = 0;
+        while (got < size && m_at < _size)
+        {
+            ssize_t n = recv(m_fd, buf + got, size - got, 0);
+            if (n <= 0)
+                break;
+            got += n;
+            m_at += n;
+        }
+        _position += got;
+        return got;
+    }
+
+private:
+    uint16_t m_port;
+    int m_fd = -1;
+    uint32_t m_at = 0;
+
+    bool get(uint32_t from)
+    {
+        close();
+        m_fd = socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(m_port);
+        if (connect(m_fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+        {
+            close();
+            return false;
+        }
+
+        char request[128];
+        snprintf(request, sizeof(request), "GET /body HTTP/1.1\r\nHost: 127.0.0.1\r\nRange: bytes=%u-\r\n\r\n", from);
+        send(m_fd, request, strlen(request), MSG_NOSIGNAL);
+
+        std::string header;
+        char c;
+        while (header.find("\r\n\r\n") == std::string::npos && recv(m_fd, &c, 1, 0) == 1)
+            header += c;
+
+        uint32_t length = 0;
+        size_t at = header.find("Content-Length: ");
+        if (at != std::string::npos)
+            length = (uint32_t)strtoul(header.c_str() + at + 16, nullptr, 10);
+        m_at = header.compare(9, 3, "206") == 0 ? from : 0;
+        _size = m_at + length;
+        _position = m_at;
+        return true;
+    }
+};
+
+// A stream over a vector that can be told to come up short or to take a
+// fixed time per call, as a slow card or a slow network does
+class ModelStream : public MStream
+{
+public:
+    // Each model is a container of its own unless given a url to share
+    ModelStream(std::vector<uint8_t>* data, const std::string& url = "")
+        : MStream(url.empty() ? "model://" + std::to_string((uintptr_t)data) : url), m_data(data)
+    {
+        _size = (uint32_t)data->size();
+    }
+
+    int delay_ms = 0;
+    uint32_t limit = UINT32_MAX;    // bytes it will accept or give before failing
+    uint32_t calls = 0;
+    std::thread::id writer;         // the thread the last write came from
+
+    bool isOpen() override { return true; }
+    bool open(std::ios_base::openmode) override { return true; }
+    void close() override {}
+
+    bool seek(uint32_t pos) override
+    {
+        _position = pos;
+        return true;
+    }
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        calls++;
+        if (delay_ms)
+            sleep_ms(delay_ms);
+        uint32_t end = std::min<uint32_t>(limit, (uint32_t)m_data->size());
+        uint32_t n = _position < end ? std::min<uint32_t>(size, end - _position) : 0;
+        memcpy(buf, m_data->data() + _position, n);
+        _position += n;
+        return n;
+    }
+
+    uint32_t write(const uint8_t* buf, uint32_t size) override
+    {
+        calls++;
+        writer = std::this_thread::get_id();
+        if (delay_ms)
+            sleep_ms(delay_ms);
+        uint32_t n = std::min<uint32_t>(size, limit > _position ? limit - _position : 0);
+        m_data->insert(m_data->end(), buf, buf + n);
+        _position += n;
+        return n;
+    }
+
+private:
+    std::vector<uint8_t>* m_data;
+};
+
+#endif // !_WIN32
+
+/********************************************************
+ * Files
+ ********************************************************/
+
+class TestFile : public MFile
+{
+public:
+    TestFile(const std::string& path)
+    {
+        url = path;
+        name = path.substr(path.rfind('/') + 1);
+    }
+
+    std::shared_ptr<MStream> getDecodedStream(std::shared_ptr<MStream>) override { return nullptr; }
+
+    std::shared_ptr<MStream> getSourceStream(std::ios_base::openmode mode) override
+    {
+        auto stream = std::make_shared<PosixStream>(url, mode);
+        return stream->isOpen() ? stream : nullptr;
+    }
+
+    bool exists() override
+    {
+        FILE* fp = fopen(url.c_str(), "rb");
+        if (fp == nullptr)
+            return false;
+        fclose(fp);
+        return true;
+    }
+};
+
+#ifndef _WIN32
+
+// The same, with its bytes fetched from the loopback server
+class HttpFile : public TestFile
+{
+public:
+    HttpFile(LoopbackServer& server) : TestFile("http://127.0.0.1/body"), m_server(server) {}
+
+    std::shared_ptr<MStream> getSourceStream(std::ios_base::openmode) override
+    {
+        return std::make_shared<LoopbackHttpStream>(m_server.port);
+    }
+
+private:
+    LoopbackServer& m_server;
+};
+
+#endif // !_WIN32
+
+MFile* MFSOwner::File(std::string path, bool default_to_flash)
+{
+    (void)default_to_flash;
+    return new TestFile(path);
+}
+
+static const std::string SRC = "build_test_copy_engine.src";
+static const std::string DST = "build_test_copy_engine.dst";
+
+void setUp(void)
+{
+    TEST_ASSERT_TRUE(jobScheduler.start());
+    remove(SRC.c_str());
+    remove(DST.c_str());
+}
+
+void tearDown(void)
+{
+    jobScheduler.stop();
+}
+
+/********************************************************
+ * Tests
+ ********************************************************/
+
+void test_crc32_is_the_ieee_one(void)
+{
+    const char* check = "123456789";
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, MCopy::crc32(0, (const uint8_t*)check, 9));
+
+    // And it continues across calls
+    uint32_t crc = MCopy::crc32(0, (const uint8_t*)check, 4);
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, MCopy::crc32(crc, (const uint8_t*)check + 4, 5));
+}
+
+void test_copies_every_byte_overlapped_and_serial(void)
+{
+    auto data = pattern(300001, 1);
+    uint32_t expect = MCopy::crc32(0, data.data(), data.size());
+
+    for (bool overlap : { true, false })
+    {
+        for (uint32_t buffer : { 509u, 4096u, 65536u })
+        {
+            std::vector<uint8_t> out;
+            ModelStream in(&data), sink(&out);
+            MCopyOptions options;
+            options.overlap = overlap;
+            options.buffer_size = buffer;
+
+            MCopyResult result = MCopy::stream(&in, &sink, options);
+            TEST_ASSERT_TRUE_MESSAGE(result.ok(), result.message());
+            TEST_ASSERT_EQUAL_UINT32(data.size(), result.copied);
+            TEST_ASSERT_EQUAL_HEX32(expect, result.crc);
+            TEST_ASSERT_TRUE(out == data);
+        }
+    }
+}
+
+void test_overlap_hides_the_slower_side(void)
+{
+    auto data = pattern(40 * 4096, 2);
+    uint64_t took[2];
+
+    for (int overlap = 0; overlap < 2; overlap++)
+    {
+        std::vector<uint8_t> out;
+        ModelStream in(&data), sink(&out);
+        in.delay_ms = 3;
+        sink.delay_ms = 3;
+        MCopyOptions options;
+        options.overlap = overlap;
+        options.buffer_size = 4096;
+
+        uint64_t started = now_ms();
+        TEST_ASSERT_TRUE(MCopy::stream(&in, &sink, options).ok());
+        took[overlap] = now_ms() - started;
+        TEST_ASSERT_TRUE(out == data);
+    }
+
+    printf("40 reads and 40 writes of 3 ms: %llu ms serial, %llu ms overlapped\n",
+           (unsigned long long)took[0], (unsigned long long)took[1]);
+    TEST_ASSERT_TRUE(took[1] * 10 < took[0] * 8);
+}
+
+void test_write_and_read_failures_are_reported(void)
+{
+    auto data = pattern(100000, 3);
+
+    for (bool overlap : { true, false })
+    {
+        std::vector<uint8_t> out;
+        ModelStream in(&data), sink(&out);
+        sink.limit = 30000;
+        MCopyOptions options;
+        options.overlap = overlap;
+        options.buffer_size = 4096;
+
+        MCopyResult result = MCopy::stream(&in, &sink, options);
+        TEST_ASSERT_EQUAL(MCopyResult::WRITE_ERROR, result.status);
+        TEST_ASSERT_EQUAL_UINT32(30000, result.copied);
+
+        // A source that ends before the size it gave
+        std::vector<uint8_t> out2;
+        ModelStream short_in(&data), sink2(&out2);
+        short_in.limit = 50000;
+        result = MCopy::stream(&short_in, &sink2, options);
+        TEST_ASSERT_EQUAL(MCopyResult::READ_ERROR, result.status);
+        TEST_ASSERT_EQUAL_UINT32(50000, result.copied);
+    }
+}
+
+// A file in a disk image gives blocks * 254 as its size until its last
+// block has been read; ending at the real size is not a short read
+void test_copies_a_file_out_of_a_d64(void)
+{
+    const char* path = "build_test_copy_engine.d64";
+    remove(path);
+    auto data = pattern(600, 8);
+    {
+        D64MStream image(std::make_shared<FileContainerStream>(path, 174848));
+        TEST_ASSERT_TRUE(image.formatImage("copytest", "01"));
+    }
+    {
+        D64MStream image(std::make_shared<FileContainerStream>(path));
+        image.mode = std::ios_base::out;
+        TEST_ASSERT_TRUE(image.seekPath("partial"));
+        TEST_ASSERT_EQUAL_UINT32(data.size(), image.write(data.data(), (uint32_t)data.size()));
+        image.close();
+        TEST_ASSERT_EQUAL(0, image.error());
+    }
+
+    for (bool overlap : { true, false })
+    {
+        D64MStream image(std::make_shared<FileContainerStream>(path));
+        image.mode = std::ios_base::in;
+        TEST_ASSERT_TRUE(image.seekPath("partial"));
+        TEST_ASSERT_EQUAL_UINT32(3 * 254, image.size());
+
+        std::vector<uint8_t> out;
+        ModelStream sink(&out);
+        MCopyOptions options;
+        options.overlap = overlap;
+        MCopyResult result = MCopy::stream(&image, &sink, options);
+        TEST_ASSERT_TRUE_MESSAGE(result.ok(), result.message());
+        TEST_ASSERT_EQUAL_UINT32(data.size(), result.copied);
+        TEST_ASSERT_TRUE(out == data);
+    }
+    remove(path);
+}
+
+void test_progress_is_throttled_and_ends_complete(void)
+{
+    auto data = pattern(64 * 1024, 4);
+    std::vector<uint8_t> out;
+    ModelStream in(&data), sink(&out);
+    in.delay_ms = 2;
+
+    std::vector<MCopyProgress> reports;
+    MCopyOptions options;
+    options.buffer_size = 512;     // 128 reads, ~260 ms
+    options.progress_ms = 50;
+    options.progress = [&](const MCopyProgress& p) { reports.push_back(p); };
+
+    MCopyResult result = MCopy::stream(&in, &sink, options);
+    TEST_ASSERT_TRUE(result.ok());
+
+    printf("%u reads, %u progress reports\n", (unsigned)in.calls, (unsigned)reports.size());
+    TEST_ASSERT_TRUE(reports.size() >= 2);
+    TEST_ASSERT_TRUE(reports.size() <= result.elapsed_ms / 50 + 2);
+    for (size_t i = 1; i < reports.size(); i++)
+        TEST_ASSERT_TRUE(reports[i].copied >= reports[i - 1].copied);
+    TEST_ASSERT_EQUAL_UINT32(data.size(), reports.back().copied);
+    TEST_ASSERT_EQUAL(100, reports.back().percent());
+}
+
+void test_writes_on_the_caller_when_the_worker_is_unavailable(void)
+{
+    auto data = pattern(200000, 5);
+
+    // The normal worker is busy for longer than the copy takes
+    std::atomic<bool> release{ false };
+    jobScheduler.submit("hog", JOB_NORMAL, [&](fnJobContext&) {
+        while (!release)
+            sleep_ms(1);
+    });
+
+    std::vector<uint8_t> out;
+    ModelStream in(&data), sink(&out);
+    MCopyOptions options;
+    options.buffer_size = 4096;
+    MCopyResult result = MCopy::stream(&in, &sink, options);
+    release = true;
+    TEST_ASSERT_TRUE(result.ok());
+    TEST_ASSERT_TRUE(out == data);
+
+    // And with no scheduler at all
+    jobScheduler.stop();
+    std::vector<uint8_t> out2;
+    ModelStream in2(&data), sink2(&out2);
+    result = MCopy::stream(&in2, &sink2, options);
+    TEST_ASSERT_TRUE(result.ok());
+    TEST_ASSERT_TRUE(out2 == data);
+}
+
+// A copy from one entry of a disk image to another goes through a single
+// container stream, so it must not be read and written at the same time.
+void test_no_overlap_within_one_container(void)
+{
+    auto data = pattern(100000, 9);
+
+    std::vector<uint8_t> out;
+    ModelStream in(&data, "sd:/disk.d64"), sink(&out, "sd:/disk.d64");
+    MCopyOptions options;
+    options.buffer_size = 4096;
+    TEST_ASSERT_TRUE(MCopy::stream(&in, &sink, options).ok());
+    TEST_ASSERT_TRUE(out == data);
+    TEST_ASSERT_TRUE(sink.writer == std::this_thread::get_id());
+
+    // An archive and an image inside it are one container too
+    std::vector<uint8_t> out2;
+    ModelStream in2(&data, "sd:/games.zip"), sink2(&out2, "sd:/games.zip/disk.d64");
+    TEST_ASSERT_TRUE(MCopy::stream(&in2, &sink2, options).ok());
+    TEST_ASSERT_TRUE(sink2.writer == std::this_thread::get_id());
+
+    // Different containers still overlap
+    std::vector<uint8_t> out3;
+    ModelStream in3(&data, "sd:/disk.d64"), sink3(&out3, "sd:/disk.d64x");
+    TEST_ASSERT_TRUE(MCopy::stream(&in3, &sink3, options).ok());
+    TEST_ASSERT_TRUE(out3 == data);
+    TEST_ASSERT_TRUE(sink3.writer != std::this_thread::get_id());
+}
+
+void test_file_copy_verifies(void)
+{
+    auto data = pattern(150000, 6);
+    spit(SRC, data.data(), data.size());
+
+    TestFile src(SRC), dst(DST);
+    MCopyOptions options;
+    options.verify = true;
+    MCopyResult result = MCopy::file(&src, &dst, options);
+    TEST_ASSERT_TRUE_MESSAGE(result.ok(), result.message());
+    TEST_ASSERT_EQUAL_UINT32(0, result.resumed);
+    TEST_ASSERT_TRUE(slurp(DST) == data);
+
+    TestFile missing("build_test_copy_engine.none");
+    TEST_ASSERT_EQUAL(MCopyResult::NO_SOURCE, MCopy::file(&missing, &dst, options).status);
+}
+
+void test_resume_continues_a_partial_download(void)
+{
+#ifdef _WIN32
+    TEST_IGNORE_MESSAGE("the loopback server needs POSIX sockets");
+#else
+    LoopbackServer server;
+    server.body = pattern(500000, 7);
+    spit(DST, server.body.data(), 123456);
+
+    HttpFile src(server);
+    TestFile dst(DST);
+    MCopyOptions options;
+    options.resume = true;
+    options.verify = true;
+    MCopyResult result = MCopy::file(&src, &dst, options);
+    TEST_ASSERT_TRUE_MESSAGE(result.ok(), result.message());
+    TEST_ASSERT_EQUAL_UINT32(123456, result.resumed);
+    TEST_ASSERT_EQUAL_UINT32(500000 - 123456, result.copied);
+    TEST_ASSERT_EQUAL_HEX32(MCopy::crc32(0, server.body.data(), server.body.size()), result.crc);
+    TEST_ASSERT_TRUE(slurp(DST) == server.body);
+
+    // Already complete: nothing to resume, so it is copied again
+    result = MCopy::file(&src, &dst, options);
+    TEST_ASSERT_TRUE(result.ok());
+    TEST_ASSERT_EQUAL_UINT32(0, result.resumed);
+    TEST_ASSERT_TRUE(slurp(DST) == server.body);
+#endif
+}
+
+void test_resume_starts_over_when_the_source_cannot_seek(void)
+{
+#ifdef _WIN32
+    TEST_IGNORE_MESSAGE("the loopback server needs POSIX sockets");
+#else
+    LoopbackServer server;
+    server.body = pattern(300000, 8);
+    server.ranges = false;
+    std::vector<uint8_t> stale(100000, 0xEE);
+    spit(DST, stale.data(), stale.size());
+
+    HttpFile src(server);
+    TestFile dst(DST);
+    MCopyOptions options;
+    options.resume = true;
+    MCopyResult result = MCopy::file(&src, &dst, options);
+    TEST_ASSERT_TRUE_MESSAGE(result.ok(), result.message());
+    TEST_ASSERT_EQUAL_UINT32(0, result.resumed);
+    TEST_ASSERT_EQUAL_UINT32(300000, result.copied);
+    TEST_ASSERT_TRUE(slurp(DST) == server.body);
+#endif
+}
+
+void test_benchmark_buffer_sizes(void)
+{
+    const size_t size = 8 * 1024 * 1024;
+    auto data = pattern(size, 9);
+    spit(SRC, data.data(), size);
+#ifdef _WIN32
+    const int kinds = 2;
+#else
+    const int kinds = 4;
+    LoopbackServer server;
+    server.body = data;
+#endif
+
+    printf("%-6s %12s %10s %10s %10s\n", "buffer", "file s", "file o", "http s", "http o");
+    for (uint32_t buffer : { 1024u, 4096u, 16384u, 65536u })
+    {
+        double mbs[4] = { 0, 0, 0, 0 };
+        for (int kind = 0; kind < kinds; kind++)
+        {
+            std::unique_ptr<TestFile> src;
+            if (kind < 2)
+                src.reset(new TestFile(SRC));
+#ifndef _WIN32
+            else
+                src.reset(new HttpFile(server));
+#endif
+            TestFile dst(DST);
+
+            MCopyOptions options;
+            options.buffer_size = buffer;
+            options.overlap = kind & 1;
+            MCopyResult result = MCopy::file(src.get(), &dst, options);
+            TEST_ASSERT_TRUE_MESSAGE(result.ok(), result.message());
+            TEST_ASSERT_EQUAL_UINT32(size, result.copied);
+            mbs[kind] = result.elapsed_ms ? (double)size / 1048576.0 * 1000.0 / result.elapsed_ms : 0;
+        }
+        printf("%-6u %7.1f MB/s %5.1f MB/s %5.1f MB/s %5.1f MB/s\n", (unsigned)buffer,
+               mbs[0], mbs[1], mbs[2], mbs[3]);
+    }
+    TEST_ASSERT_TRUE(slurp(DST) == data);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32_is_the_ieee_one);
+    RUN_TEST(test_copies_every_byte_overlapped_and_serial);
+    RUN_TEST(test_overlap_hides_the_slower_side);
+    RUN_TEST(test_write_and_read_failures_are_reported);
+    RUN_TEST(test_copies_a_file_out_of_a_d64);
+    RUN_TEST(test_progress_is_throttled_and_ends_complete);
+    RUN_TEST(test_writes_on_the_caller_when_the_worker_is_unavailable);
+    RUN_TEST(test_no_overlap_within_one_container);
+    RUN_TEST(test_file_copy_verifies);
+    RUN_TEST(test_resume_continues_a_partial_download);
+    RUN_TEST(test_resume_starts_over_when_the_source_cannot_seek);
+    RUN_TEST(test_benchmark_buffer_sizes);
+    remove(SRC.c_str());
+    remove(DST.c_str());
+    return UNITY_END();
+}
+
+int main(int argc, char** argv)
+{
+    return runUnityTests();
+}
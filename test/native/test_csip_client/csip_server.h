@@ -0,0 +1,235 @@
+#ifndef TEST_CSIP_SERVER
+#define TEST_CSIP_SERVER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// POSIX sockets only: test_csip_client.cpp skips the suite under mingw
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "string_utils.h"
+
+// A local stand-in for commodoreserver.com:1541, answering the commands
+// CSIPClient sends the way the real server does: "00 - OK" or "?500 - ..."
+// for CF and INSERT, a folder listing ended by the " >[FOLDER]" prompt for
+// DISKS, a 1541-style directory for $, and two length bytes then the file
+// for LOAD. Every reply waits 'rtt_ms' first, standing in for the Internet.
+//
+// Paths are folders ("/GAMES/ACTION") holding subfolders and .D64 images;
+// an image holds files. Like the real server, replies are in PETSCII's
+// unshifted upper case, which comes out as lower case UTF-8.
+class CSIPServer
+{
+public:
+    struct Image
+    {
+        std::map<std::string, std::vector<uint8_t>> files;
+    };
+
+    uint32_t rtt_ms = 20;
+    bool send_prompt = true;    // end DISKS listings with the prompt, or just stop
+
+    std::map<std::string, std::vector<std::string>> folders;   // path -> subfolder names
+    std::map<std::string, Image> images;                       // "/GAMES/X.D64" -> files
+
+    CSIPServer()
+    {
+        _listen = socket(AF_INET, SOCK_STREAM, 0);
+        int one = 1;
+        setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(_listen, (sockaddr*)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_listen, (sockaddr*)&addr, &len);
+        _port = ntohs(addr.sin_port);
+        listen(_listen, 4);
+    }
+
+    ~CSIPServer()
+    {
+        stop();
+    }
+
+    uint16_t port() const { return _port; }
+
+    void start()
+    {
+        _thread = std::thread([this] { serve(); });
+    }
+
+    void stop()
+    {
+        if (_listen >= 0) {
+            shutdown(_listen, SHUT_RDWR);
+            ::close(_listen);
+            _listen = -1;
+        }
+        if (_client >= 0)
+            shutdown(_client, SHUT_RDWR);
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    std::vector<std::string> commands()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _commands;
+    }
+
+    void clearCommands()
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _commands.clear();
+    }
+
+private:
+    void serve()
+    {
+        while (true) {
+            int c = accept(_listen, nullptr, nullptr);
+            if (c < 0)
+                return;
+            _client = c;
+            _cwd = "/";
+            _image.clear();
+            std::string line;
+            uint8_t ch;
+            while (recv(c, &ch, 1, 0) == 1) {
+                if (ch != '\r') {
+                    line += (char)ch;
+                    continue;
+                }
+                handle(c, mstr::toUTF8(line));
+                line.clear();
+            }
+            ::close(c);
+            _client = -1;
+        }
+    }
+
+    static std::string upper(std::string s)
+    {
+        for (auto& ch : s)
+            ch = (char)toupper((unsigned char)ch);
+        return s;
+    }
+
+    static std::string leaf(const std::string& path)
+    {
+        return path == "/" ? "ROOT" : path.substr(path.find_last_of('/') + 1);
+    }
+
+    void reply(int c, const std::string& text)
+    {
+        ::send(c, text.data(), text.size(), 0);
+    }
+
+    void handle(int c, const std::string& received)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _commands.push_back(received);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(rtt_ms));
+
+        std::string cmd = upper(received);
+        std::string arg;
+        size_t space = cmd.find(' ');
+        if (space != std::string::npos) {
+            arg = cmd.substr(space + 1);
+            cmd = cmd.substr(0, space);
+        }
+
+        if (cmd == "CF" && !arg.empty()) {
+            std::string target = (arg[0] == '/') ? arg : (_cwd == "/" ? "/" : _cwd + "/") + arg;
+            if (target.size() > 1 && target.back() == '/')
+                target.pop_back();
+            if (folders.count(target)) {
+                _cwd = target;
+                reply(c, "\r\n > 00 - OK\r\n");
+            } else {
+                reply(c, "\r\n > ?500 - CANNOT CHANGE TO " + arg + "\r\n");
+            }
+        } else if (cmd == "DISKS") {
+            std::string text = "\r\n >[" + leaf(_cwd) + "]\r\n";
+            for (auto& sub : folders[_cwd])
+                text += "[" + sub + "]\r\n";
+            std::string prefix = (_cwd == "/") ? "/" : _cwd + "/";
+            for (auto& img : images) {
+                if (img.first.compare(0, prefix.size(), prefix) == 0 &&
+                    img.first.find('/', prefix.size()) == std::string::npos)
+                    text += img.first.substr(prefix.size()) + "\r\n";
+            }
+            if (send_prompt)
+                text += "\r\n >[" + leaf(_cwd) + "]\r";
+            reply(c, text);
+        } else if (cmd == "INSERT") {
+            if (images.count(arg)) {
+                _image = arg;
+                reply(c, "\r\n > 00 - OK\r\n");
+            } else {
+                reply(c, "\r\n > ?500 - DISK NOT FOUND.\r\n");
+            }
+        } else if (cmd == "$") {
+            std::string name = leaf(_image);
+            std::string text = "DISK " + name + "\r\n";
+            text += "0 \x12\"" + pad(name.substr(0, name.size() - 4)) + "\" ZX 2A\r\n";
+            uint32_t used = 0;
+            for (auto& f : images[_image].files) {
+                uint32_t blocks = (uint32_t)(f.second.size() + 253) / 254;
+                used += blocks;
+                std::string n = std::to_string(blocks);
+                text += n + std::string(4 - n.size(), ' ') + "\"" + pad(f.first) + "\" PRG\r\n";
+            }
+            text += std::to_string(664 - used) + " BLOCKS FREE.\r\n";
+            reply(c, text);
+        } else if (cmd == "LOAD") {
+            auto img = images.find(_image);
+            auto f = (img == images.end()) ? decltype(img->second.files.end())() : img->second.files.find(arg);
+            if (img == images.end() || f == img->second.files.end()) {
+                reply(c, "?500 - FILE NOT FOUND\r\n");
+                return;
+            }
+            const std::vector<uint8_t>& data = f->second;
+            uint8_t len[2] = { (uint8_t)(data.size() & 0xFF), (uint8_t)(data.size() >> 8) };
+            ::send(c, len, 2, 0);
+            ::send(c, data.data(), data.size(), 0);
+        } else if (cmd == "USER" || cmd == "LOGIN" || cmd == "LOGOUT") {
+            reply(c, "\r\n > 00 - OK\r\n");
+        } else if (cmd == "QUIT") {
+            shutdown(c, SHUT_RDWR);
+        } else {
+            reply(c, "\r\n > ?500 - UNKNOWN COMMAND\r\n");
+        }
+    }
+
+    static std::string pad(const std::string& s)
+    {
+        std::string p = s.substr(0, 16);
+        return p + std::string(16 - p.size(), ' ');
+    }
+
+    int _listen = -1;
+    std::atomic<int> _client{-1};
+    uint16_t _port = 0;
+    std::thread _thread;
+    std::mutex _mutex;
+    std::vector<std::string> _commands;
+    std::string _cwd = "/";
+    std::string _image;
+};
+
+#endif
@@ -0,0 +1,15 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// csip_client.cpp runs on plain BSD sockets, here against the stand-in
+// server in csip_server.h rather than commodoreserver.com. Not under mingw,
+// where the suite is skipped (see test_csip_client.cpp).
+#ifndef _WIN32
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp #define's a bare `min(a,b)` macro with no matching #undef.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/meatloaf/service/csip_client.cpp"
+#endif
@@ -0,0 +1,303 @@
+// Tests for the CommodoreServer client (lib/meatloaf/service/csip_client.cpp)
+// that CSIPMSession talks through, against the local stand-in server in
+// csip_server.h: round trips are counted there, and each costs a simulated
+// 20 ms of Internet.
+//
+// The stand-in server is written to POSIX sockets, and [env:native] links no
+// winsock, so under mingw the suite is a single ignored test.
+
+#include <unity.h>
+
+#ifdef _WIN32
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_needs_posix_sockets(void)
+{
+    TEST_IGNORE_MESSAGE("the stand-in server needs POSIX sockets");
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_needs_posix_sockets);
+    return UNITY_END();
+}
+
+#else
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "service/csip_client.h"
+#include "csip_server.h"
+
+static std::unique_ptr<CSIPServer> server;
+
+static const char* IMAGE = "/GAMES/ACTION/SHOOTERS/ZAXXON.D64";
+
+static std::vector<uint8_t> body(size_t n, uint8_t seed)
+{
+    std::vector<uint8_t> b(n);
+    for (size_t i = 0; i < n; i++)
+        b[i] = (uint8_t)(seed + i * 13 + (i >> 7));
+    return b;
+}
+
+void setUp(void)
+{
+    server.reset(new CSIPServer());
+    server->folders["/"] = { "GAMES", "UTILS" };
+    server->folders["/GAMES"] = { "ACTION", "PUZZLE" };
+    server->folders["/GAMES/ACTION"] = { "SHOOTERS" };
+    server->folders["/GAMES/ACTION/SHOOTERS"] = {};
+    server->folders["/GAMES/PUZZLE"] = {};
+    server->folders["/UTILS"] = {};
+    server->images["/DEMO.D64"].files["DEMO"] = body(300, 1);
+    server->images["/UTILS/TOOLS.D64"].files["COPY"] = body(2000, 2);
+    server->images[IMAGE].files["ZAXXON"] = body(12000, 3);
+    server->images[IMAGE].files["ZAXXON DOCS"] = body(900, 4);
+    server->start();
+}
+
+void tearDown(void)
+{
+    server.reset();
+}
+
+static bool connect(CSIPClient& client)
+{
+    return client.open("127.0.0.1", server->port());
+}
+
+static std::vector<uint8_t> loadAll(CSIPClient& client, const std::string& path)
+{
+    std::vector<uint8_t> data;
+    uint32_t size = 0;
+    if (!client.load(path, size))
+        return data;
+    uint8_t buf[256];
+    while (data.size() < size) {
+        size_t n = client.read(buf, std::min<size_t>(sizeof(buf), size - data.size()));
+        if (n == 0)
+            break;
+        data.insert(data.end(), buf, buf + n);
+    }
+    return data;
+}
+
+static void checkNames(const CSIPListing& listing, const std::vector<std::string>& names)
+{
+    TEST_ASSERT_EQUAL(names.size(), listing.entries.size());
+    for (size_t i = 0; i < names.size(); i++)
+        TEST_ASSERT_EQUAL_STRING(names[i].c_str(), listing.entries[i].name.c_str());
+}
+
+// Each step down sends only the folder below the current one; the listings,
+// the image's directory and the file all arrive whole
+void test_browse_three_levels_and_load(void)
+{
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+
+    CSIPListing listing;
+    TEST_ASSERT_TRUE(client.list("/", listing));
+    TEST_ASSERT_EQUAL_STRING("[root]", listing.header.c_str());
+    checkNames(listing, { "games", "utils", "demo.d64" });
+    TEST_ASSERT_TRUE(listing.entries[0].is_dir);
+    TEST_ASSERT_FALSE(listing.entries[2].is_dir);
+
+    TEST_ASSERT_TRUE(client.list("/GAMES", listing));
+    checkNames(listing, { "action", "puzzle" });
+    TEST_ASSERT_TRUE(client.list("/GAMES/ACTION", listing));
+    TEST_ASSERT_TRUE(client.list("/GAMES/ACTION/SHOOTERS", listing));
+    checkNames(listing, { "zaxxon.d64" });
+    TEST_ASSERT_EQUAL_STRING("/GAMES/ACTION/SHOOTERS", client.folder().c_str());
+
+    TEST_ASSERT_TRUE(client.list(IMAGE, listing));
+    TEST_ASSERT_TRUE(listing.is_image);
+    TEST_ASSERT_EQUAL_STRING("ZAXXON.D64", listing.image.c_str());
+    checkNames(listing, { "zaxxon", "zaxxon docs" });
+    TEST_ASSERT_EQUAL_UINT32(48 * 256, listing.entries[0].size);
+    TEST_ASSERT_EQUAL_UINT16(664 - 48 - 4, listing.blocks_free);
+
+    std::vector<uint8_t> want = body(12000, 3);
+    std::vector<uint8_t> got = loadAll(client, std::string(IMAGE) + "/ZAXXON");
+    TEST_ASSERT_EQUAL(want.size(), got.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(want.data(), got.data(), want.size());
+
+    std::vector<std::string> sent = server->commands();
+    std::vector<std::string> expected = {
+        "disks",
+        "cf /GAMES", "disks",
+        "cf /GAMES/ACTION", "disks",
+        "cf /GAMES/ACTION/SHOOTERS", "disks",
+        std::string("insert ") + IMAGE, "$",
+        "load ZAXXON",
+    };
+    TEST_ASSERT_EQUAL(expected.size(), sent.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), sent[i].c_str());
+}
+
+// Back up the tree and down again: every listing from the cache, and the
+// image already in - only the LOAD goes to the server
+void test_revisit_is_served_from_cache(void)
+{
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+    CSIPListing listing;
+    for (const char* path : { "/", "/GAMES", "/GAMES/ACTION", "/GAMES/ACTION/SHOOTERS", IMAGE })
+        TEST_ASSERT_TRUE(client.list(path, listing));
+    TEST_ASSERT_EQUAL(900, loadAll(client, std::string(IMAGE) + "/ZAXXON DOCS").size());
+    server->clearCommands();
+
+    for (const char* path : { "/", "/GAMES", "/GAMES/ACTION", "/GAMES/ACTION/SHOOTERS", IMAGE })
+        TEST_ASSERT_TRUE(client.list(path, listing));
+    TEST_ASSERT_EQUAL(12000, loadAll(client, std::string(IMAGE) + "/ZAXXON").size());
+
+    std::vector<std::string> sent = server->commands();
+    TEST_ASSERT_EQUAL(1, sent.size());
+    TEST_ASSERT_EQUAL_STRING("load ZAXXON", sent[0].c_str());
+    TEST_ASSERT_EQUAL_UINT32(5, client.listingHits());
+
+    // A file opened by name gets its size from its folder's listing
+    uint32_t size = 0;
+    TEST_ASSERT_TRUE(client.cachedSize(std::string(IMAGE) + "/zaxxon", size));
+    TEST_ASSERT_EQUAL_UINT32(48 * 256, size);
+    TEST_ASSERT_FALSE(client.cachedSize("/GAMES/NOSUCH.D64", size));
+}
+
+// Down, sideways or up is one CF with the whole path; the current folder
+// itself is none
+void test_changes_use_absolute_path(void)
+{
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+    TEST_ASSERT_TRUE(client.changeTo("/GAMES/ACTION"));
+    TEST_ASSERT_TRUE(client.changeTo("/GAMES/ACTION/"));
+    TEST_ASSERT_TRUE(client.changeTo("/GAMES/PUZZLE"));
+    TEST_ASSERT_TRUE(client.changeTo("/GAMES"));
+    TEST_ASSERT_TRUE(client.changeTo("/"));
+
+    std::vector<std::string> sent = server->commands();
+    std::vector<std::string> expected = { "cf /GAMES/ACTION", "cf /GAMES/PUZZLE", "cf /GAMES", "cf /" };
+    TEST_ASSERT_EQUAL(expected.size(), sent.size());
+    for (size_t i = 0; i < expected.size(); i++)
+        TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), sent[i].c_str());
+}
+
+// After a failed CF the server could be anywhere: even the folder it was
+// in is asked for again
+void test_failed_change_forgets_folder(void)
+{
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+    TEST_ASSERT_TRUE(client.changeTo("/GAMES"));
+    TEST_ASSERT_FALSE(client.changeTo("/GAMES/NOSUCH"));
+    TEST_ASSERT_TRUE(client.changeTo("/GAMES"));
+    TEST_ASSERT_FALSE(client.changeTo("/NOSUCH.D64"));
+
+    std::vector<std::string> sent = server->commands();
+    TEST_ASSERT_EQUAL(4, sent.size());
+    TEST_ASSERT_EQUAL_STRING("cf /GAMES/NOSUCH", sent[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("cf /GAMES", sent[2].c_str());
+    TEST_ASSERT_EQUAL_STRING("", client.image().c_str());
+}
+
+// A LOAD abandoned part way doesn't leave its bytes to be read as the
+// next reply
+void test_abandoned_load_is_skipped(void)
+{
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+    uint32_t size = 0;
+    TEST_ASSERT_TRUE(client.load(std::string(IMAGE) + "/ZAXXON", size));
+    TEST_ASSERT_EQUAL_UINT32(12000, size);
+    uint8_t buf[100];
+    TEST_ASSERT_TRUE(client.read(buf, sizeof(buf)) > 0);
+
+    CSIPListing listing;
+    TEST_ASSERT_TRUE(client.list("/GAMES", listing));
+    checkNames(listing, { "action", "puzzle" });
+
+    TEST_ASSERT_FALSE(client.load("/UTILS/TOOLS.D64/NOSUCH", size));
+    std::vector<uint8_t> want = body(2000, 2);
+    std::vector<uint8_t> got = loadAll(client, "/UTILS/TOOLS.D64/COPY");
+    TEST_ASSERT_EQUAL(want.size(), got.size());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(want.data(), got.data(), want.size());
+}
+
+// A listing with no prompt after it still ends, on silence
+void test_listing_without_prompt_ends_on_silence(void)
+{
+    server->send_prompt = false;
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+    CSIPListing listing;
+    TEST_ASSERT_TRUE(client.list("/", listing));
+    checkNames(listing, { "games", "utils", "demo.d64" });
+    TEST_ASSERT_TRUE(client.changeTo("/UTILS"));
+}
+
+// Logging in as someone else, the listings go
+void test_forget_drops_listings(void)
+{
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+    CSIPListing listing;
+    TEST_ASSERT_TRUE(client.list("/GAMES", listing));
+    client.forget();
+    server->clearCommands();
+    TEST_ASSERT_TRUE(client.list("/GAMES", listing));
+    std::vector<std::string> sent = server->commands();
+    TEST_ASSERT_EQUAL(2, sent.size());
+    TEST_ASSERT_EQUAL_STRING("cf /GAMES", sent[0].c_str());
+}
+
+// Benchmark: browse three folders deep into an image and load a file,
+// then do it again, at 20 ms a round trip
+void test_browse_latency_benchmark(void)
+{
+    double ms[2] = { 0, 0 };
+    size_t trips[2] = { 0, 0 };
+    CSIPClient client;
+    TEST_ASSERT_TRUE(connect(client));
+    for (int pass = 0; pass < 2; pass++) {
+        server->clearCommands();
+        auto started = std::chrono::steady_clock::now();
+        CSIPListing listing;
+        for (const char* path : { "/", "/GAMES", "/GAMES/ACTION", "/GAMES/ACTION/SHOOTERS", IMAGE })
+            TEST_ASSERT_TRUE(client.list(path, listing));
+        TEST_ASSERT_EQUAL(12000, loadAll(client, std::string(IMAGE) + "/ZAXXON").size());
+        ms[pass] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        trips[pass] = server->commands().size();
+    }
+
+    printf("browse 3 deep + load, %u ms RTT: first %u round trips %.0f ms, again %u round trips %.0f ms\n",
+           (unsigned)server->rtt_ms, (unsigned)trips[0], ms[0], (unsigned)trips[1], ms[1]);
+
+    TEST_ASSERT_EQUAL(10, trips[0]);
+    TEST_ASSERT_EQUAL(1, trips[1]);
+    TEST_ASSERT_TRUE(ms[0] < 10 * (server->rtt_ms + 50));
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_browse_three_levels_and_load);
+    RUN_TEST(test_revisit_is_served_from_cache);
+    RUN_TEST(test_changes_use_absolute_path);
+    RUN_TEST(test_failed_change_forgets_folder);
+    RUN_TEST(test_abandoned_load_is_skipped);
+    RUN_TEST(test_listing_without_prompt_ends_on_silence);
+    RUN_TEST(test_forget_drops_listings);
+    RUN_TEST(test_browse_latency_benchmark);
+    return UNITY_END();
+}
+
+#endif // _WIN32
@@ -0,0 +1,16 @@
+// Pulls in the exact translation units the directory cache tests need, by
+// #include-ing the real .cpp files by relative path. See
+// test/native/test_disk_write/engine_sources.cpp for the full explanation of
+// why PlatformIO's library dependency finder can't be used here.
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp #define's a bare `min(a,b)` macro with no matching #undef, and
+// this file concatenates several .cpp files into ONE translation unit, so it
+// would otherwise leak forward into later std::min(...) calls.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
+#include "../../../lib/meatloaf/media/disk/d64.cpp"
+
+#include "../test_disk_write/native_stubs.cpp"
@@ -0,0 +1,245 @@
+// Tests for DirectoryCache (lib/meatloaf/meat_media.h), the rendered
+// directory listings D64MFile::rewindDirectory() replays instead of walking
+// the directory chain again.
+//
+// A cached listing is only useful while it is right. These tests pin the two
+// ways it stops being right - the container changed underneath it (size or
+// modification time), or the image was written through D64MStream - and that
+// the cache stays bounded.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "media/disk/d64.h"
+#include "../test_disk_write/file_container_stream.h"
+
+static const char* D64_PATH = "build_test_dircache.d64";
+
+void setUp(void)
+{
+    DirectoryCache::clear();
+    DirectoryCache::setUnverifiedAge(0);
+}
+
+void tearDown(void)
+{
+    remove(D64_PATH);
+}
+
+static std::shared_ptr<DirectoryListing> listing(const std::string& header, size_t entries)
+{
+    auto l = std::make_shared<DirectoryListing>();
+    l->header = header;
+    l->id = "01 2A";
+    l->blocks_free = 664;
+    for (size_t i = 0; i < entries; i++)
+        l->entries.push_back({ "FILE" + std::to_string(i), "PRG", 254, false, false });
+    return l;
+}
+
+void test_listing_is_served_while_the_container_is_unchanged(void)
+{
+    DirectoryCache::store("sd:/games.d64", "sd:/games.d64", 174848, 1700000000, listing("GAMES", 3));
+
+    auto hit = DirectoryCache::find("sd:/games.d64", 174848, 1700000000);
+    TEST_ASSERT_NOT_NULL(hit.get());
+    TEST_ASSERT_EQUAL_STRING("GAMES", hit->header.c_str());
+    TEST_ASSERT_EQUAL(3, hit->entries.size());
+
+    TEST_ASSERT_NULL(DirectoryCache::find("sd:/other.d64", 174848, 1700000000).get());
+}
+
+void test_changed_container_misses_and_is_dropped(void)
+{
+    DirectoryCache::store("sd:/games.d64", "sd:/games.d64", 174848, 1700000000, listing("GAMES", 3));
+    TEST_ASSERT_NULL(DirectoryCache::find("sd:/games.d64", 175531, 1700000000).get());
+    TEST_ASSERT_EQUAL(0, DirectoryCache::count());
+
+    DirectoryCache::store("sd:/games.d64", "sd:/games.d64", 174848, 1700000000, listing("GAMES", 3));
+    TEST_ASSERT_NULL(DirectoryCache::find("sd:/games.d64", 174848, 1700000002).get());
+    TEST_ASSERT_EQUAL(0, DirectoryCache::count());
+}
+
+// No modification time to compare (HTTP): trusted only for a while.
+void test_unverified_listing_expires(void)
+{
+    DirectoryCache::setUnverifiedAge(20);
+    DirectoryCache::store("http://host/games.d64", "http://host/games.d64", 0, 0, listing("GAMES", 3));
+
+    TEST_ASSERT_NOT_NULL(DirectoryCache::find("http://host/games.d64", 0, 0).get());
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    TEST_ASSERT_NULL(DirectoryCache::find("http://host/games.d64", 0, 0).get());
+}
+
+void test_invalidate_drops_the_container_and_paths_inside_it(void)
+{
+    DirectoryCache::store("sd:/a.dnp", "sd:/a.dnp", 0, 1, listing("ROOT", 1));
+    DirectoryCache::store("sd:/a.dnp/GAMES", "sd:/a.dnp", 0, 1, listing("GAMES", 1));
+    DirectoryCache::store("sd:/a.dnpx", "sd:/a.dnpx", 0, 1, listing("OTHER", 1));
+    DirectoryCache::store("sd:/zip.zip/a.dnp", "sd:/zip.zip/a.dnp", 0, 1, listing("ZIPPED", 1));
+
+    DirectoryCache::invalidate("sd:/a.dnp");
+
+    TEST_ASSERT_NULL(DirectoryCache::find("sd:/a.dnp", 0, 1).get());
+    TEST_ASSERT_NULL(DirectoryCache::find("sd:/a.dnp/GAMES", 0, 1).get());
+    TEST_ASSERT_NOT_NULL(DirectoryCache::find("sd:/a.dnpx", 0, 1).get());
+    TEST_ASSERT_NOT_NULL(DirectoryCache::find("sd:/zip.zip/a.dnp", 0, 1).get());
+}
+
+void test_least_recently_used_listing_goes_first(void)
+{
+    for (int i = 0; i < DIRECTORY_CACHE_MAX_LISTINGS; i++)
+        DirectoryCache::store("sd:/" + std::to_string(i) + ".d64", "sd:/" + std::to_string(i) + ".d64", 0, 1,
+                              listing("D", 1));
+    // Touch the oldest so the second oldest is the one to go
+    TEST_ASSERT_NOT_NULL(DirectoryCache::find("sd:/0.d64", 0, 1).get());
+
+    DirectoryCache::store("sd:/new.d64", "sd:/new.d64", 0, 1, listing("NEW", 1));
+
+    TEST_ASSERT_EQUAL(DIRECTORY_CACHE_MAX_LISTINGS, DirectoryCache::count());
+    TEST_ASSERT_NOT_NULL(DirectoryCache::find("sd:/0.d64", 0, 1).get());
+    TEST_ASSERT_NULL(DirectoryCache::find("sd:/1.d64", 0, 1).get());
+    TEST_ASSERT_NOT_NULL(DirectoryCache::find("sd:/new.d64", 0, 1).get());
+}
+
+// The same SAVE path test_disk_write drives: seekPath() in out mode claims
+// the entry, close() commits it through finalizeFileWrite().
+static bool saveFile(D64MStream& image, const std::string& name, uint32_t size)
+{
+    std::vector<uint8_t> data(size, 0x42);
+    image.mode = std::ios_base::out;
+    if (!image.seekPath(name))
+        return false;
+    if (image.write(data.data(), size) != size)
+        return false;
+    image.close();
+    return image.error() == 0;
+}
+
+// The block-level calls the drive's B-A/B-F and the format code make
+struct BlockD64MStream : public D64MStream
+{
+    using D64MStream::D64MStream;
+    using D64MStream::setBlockAllocation;
+    using D64MStream::writeBlock;
+};
+
+static void cacheImageListing()
+{
+    DirectoryCache::store(D64_PATH, D64_PATH, 0, 1, listing("TESTDISK", 1));
+    DirectoryCache::store(std::string(D64_PATH) + "/SUB", D64_PATH, 0, 1, listing("SUB", 1));
+    TEST_ASSERT_EQUAL(2, DirectoryCache::count());
+}
+
+void test_writes_through_the_image_invalidate_its_listings(void)
+{
+    remove(D64_PATH);
+
+    // Closing a D64MStream closes its container, so each step opens its own
+    {
+        cacheImageListing();
+        D64MStream image(std::make_shared<FileContainerStream>(D64_PATH, 174848));
+        TEST_ASSERT_TRUE(image.formatImage("testdisk", "01"));
+        TEST_ASSERT_EQUAL_MESSAGE(0, DirectoryCache::count(), "format");
+    }
+    {
+        cacheImageListing();
+        D64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+        TEST_ASSERT_TRUE(saveFile(image, "hello", 600));
+        TEST_ASSERT_EQUAL_MESSAGE(0, DirectoryCache::count(), "save");
+    }
+    {
+        cacheImageListing();
+        D64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+        image.mode = std::ios_base::in | std::ios_base::out;
+        TEST_ASSERT_TRUE(image.removeFile("hello"));
+        TEST_ASSERT_EQUAL_MESSAGE(0, DirectoryCache::count(), "scratch");
+    }
+    {
+        cacheImageListing();
+        D64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+        image.mode = std::ios_base::in | std::ios_base::out;
+        TEST_ASSERT_TRUE(image.unremoveFile("hello"));
+        TEST_ASSERT_EQUAL_MESSAGE(0, DirectoryCache::count(), "unscratch");
+    }
+    {
+        cacheImageListing();
+        BlockD64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+        image.mode = std::ios_base::in | std::ios_base::out;
+        TEST_ASSERT_TRUE(image.setBlockAllocation(20, 3, true));
+        TEST_ASSERT_EQUAL_MESSAGE(0, DirectoryCache::count(), "B-A");
+    }
+    {
+        cacheImageListing();
+        BlockD64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+        image.mode = std::ios_base::in | std::ios_base::out;
+        TEST_ASSERT_TRUE(image.writeBlock(20, 3, std::string(256, 'x')));
+        TEST_ASSERT_EQUAL_MESSAGE(0, DirectoryCache::count(), "block write");
+    }
+    {
+        // U2 and B-W position the image stream on the block and write
+        // through it, past the format
+        cacheImageListing();
+        D64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+        image.mode = std::ios_base::in | std::ios_base::out;
+        uint8_t block[256] = { 0 };
+        TEST_ASSERT_TRUE(image.seek(image.sectorByteOffset(20, 4)));
+        TEST_ASSERT_EQUAL_UINT32(sizeof(block), image.write(block, sizeof(block)));
+        TEST_ASSERT_EQUAL_MESSAGE(0, DirectoryCache::count(), "raw write");
+    }
+
+    // Reading leaves them alone
+    cacheImageListing();
+    D64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+    image.mode = std::ios_base::in;
+    TEST_ASSERT_TRUE(image.seekPath("hello"));
+    TEST_ASSERT_EQUAL(2, DirectoryCache::count());
+}
+
+// The drive, the console and WebDAV each list from a task of their own.
+void test_concurrent_use(void)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([t] {
+            const std::string container = "sd:/disk" + std::to_string(t % 2) + ".d64";
+            for (int i = 0; i < 2000; i++)
+            {
+                DirectoryCache::store(container + "/DIR" + std::to_string(i % 40), container, 0, 1, listing("D", 2));
+                auto hit = DirectoryCache::find(container + "/DIR" + std::to_string((i * 7) % 40), 0, 1);
+                if (hit)
+                    TEST_ASSERT_EQUAL_STRING("D", hit->header.c_str());
+                if (i % 50 == 0)
+                    DirectoryCache::invalidate(container);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    TEST_ASSERT_TRUE(DirectoryCache::count() <= DIRECTORY_CACHE_MAX_LISTINGS);
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc; (void)argv;
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_listing_is_served_while_the_container_is_unchanged);
+    RUN_TEST(test_changed_container_misses_and_is_dropped);
+    RUN_TEST(test_unverified_listing_expires);
+    RUN_TEST(test_invalidate_drops_the_container_and_paths_inside_it);
+    RUN_TEST(test_least_recently_used_listing_goes_first);
+    RUN_TEST(test_writes_through_the_image_invalidate_its_listings);
+    RUN_TEST(test_concurrent_use);
+
+    return UNITY_END();
+}
@@ -25,6 +25,11 @@ MFile* MFSOwner::File(std::string path, bool default_to_flash)
     fprintf(stderr, "native_stubs: MFSOwner::File called unexpectedly\n");
     abort();
 }
+
+// The disk image registries bracket their MFSOwner::File() with these, and
+// that File() call is what aborts if it is ever reached.
+void MFSOwner::suspendResolveCache() {}
+void MFSOwner::resumeResolveCache() {}
 #endif
 
 std::shared_ptr<MStream> MFile::getSourceStream(std::ios_base::openmode mode)
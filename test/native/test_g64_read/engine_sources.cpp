@@ -8,6 +8,7 @@
 #include "../../../lib/utils/U8Char.cpp"
 #include "../../../lib/utils/string_utils.cpp"
 #include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
 #include "../../../lib/meatloaf/media/disk/d64.cpp"
 #include "../../../lib/meatloaf/media/disk/g64.cpp"
 
@@ -4,7 +4,9 @@
 // reachable by any existing test - there is no .g64 anywhere in .archive, and
 // the firmware has a GCR decoder but no encoder, so it cannot produce one
 // either. The fixture is therefore generated from a real .d64 by
-// host/make_g64.py; the tests skip cleanly when it has not been run.
+// host/make_g64.py: .archive/disk/g64/wolf64.g64 from
+// .archive/disk/d64/wolf64.d64, both committed. The tests skip cleanly when
+// either is missing.
 //
 // What is being pinned, in order of how badly it used to break:
 //
@@ -17,6 +19,8 @@
 //      and it spins forever. On the IEC task.
 //   3. readSector() returned true when the block id was not $07, leaving the
 //      PREVIOUS sector's bytes in the buffer to be served as this one's.
+//   4. A data block was taken as good without its checksum, so a damaged
+//      sector was cached and served as if it were whole.
 //
 // The fixture is round-tripped through this project's own GCR decoder, so it
 // proves the read path and the multi-block behaviour rather than the format
@@ -25,6 +29,7 @@
 
 #include <unity.h>
 
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <memory>
@@ -51,6 +56,28 @@ class TestG64Stream : public G64MStream
 public:
     using G64MStream::G64MStream;
     using G64MStream::sector_buffer;
+    using G64MStream::seekEntry;
+    using G64MStream::track_cache;
+    using G64MStream::DecodedTrack;
+    using G64MStream::decodeTrack;
+    using G64MStream::SECTOR_HEADER_OK;
+    using G64MStream::SECTOR_DATA_OK;
+};
+
+// Counts what the decoder asks of the container: on a remote image every
+// read() behind a seek is a request, so this is the figure that matters.
+class CountingContainerStream : public FileContainerStream
+{
+public:
+    using FileContainerStream::FileContainerStream;
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        reads++;
+        return FileContainerStream::read(buf, size);
+    }
+
+    uint32_t reads = 0;
 };
 
 static std::shared_ptr<TestG64Stream> openImage(std::shared_ptr<FileContainerStream>& src)
@@ -84,6 +111,50 @@ static bool referenceBlock(uint8_t track, uint8_t sector, uint8_t* out)
     return ok;
 }
 
+// GCR, as a 1541 writes it: four bytes to five, each nibble to five bits.
+static const uint8_t GCR_ENCODE[16] = {
+    0x0a, 0x0b, 0x12, 0x13, 0x0e, 0x0f, 0x16, 0x17,
+    0x09, 0x19, 0x1a, 0x1b, 0x0d, 0x1d, 0x1e, 0x15
+};
+
+static void appendGCR(std::vector<uint8_t>& out, const uint8_t* plain, size_t len)
+{
+    for (size_t i = 0; i < len; i += 4)
+    {
+        uint64_t bits = 0;
+        for (size_t j = 0; j < 4; j++)
+            bits = (bits << 10) | (GCR_ENCODE[plain[i + j] >> 4] << 5) | GCR_ENCODE[plain[i + j] & 0x0f];
+        for (int j = 4; j >= 0; j--)
+            out.push_back((uint8_t)(bits >> (j * 8)));
+    }
+}
+
+// One track of `sectors` sectors, each a sync, a header block, a gap, a sync
+// and a data block; sector n holds n in every byte.
+static std::vector<uint8_t> buildTrack(uint8_t track, uint8_t sectors)
+{
+    std::vector<uint8_t> gcr;
+    for (uint8_t sector = 0; sector < sectors; sector++)
+    {
+        uint8_t header[8] = { 0x08, 0, sector, track, 0x41, 0x41, 0x0f, 0x0f };
+        header[1] = header[2] ^ header[3] ^ header[4] ^ header[5];
+        gcr.insert(gcr.end(), 5, 0xff);
+        appendGCR(gcr, header, sizeof(header));
+        gcr.insert(gcr.end(), 9, 0x55);
+
+        uint8_t block[260] = { 0x07 };
+        for (int i = 1; i <= 256; i++)
+        {
+            block[i] = sector;
+            block[257] ^= sector;
+        }
+        gcr.insert(gcr.end(), 5, 0xff);
+        appendGCR(gcr, block, sizeof(block));
+        gcr.insert(gcr.end(), 8, 0x55);
+    }
+    return gcr;
+}
+
 void setUp(void) {}
 void tearDown(void) {}
 
@@ -215,6 +286,48 @@ void test_file_chain_walks_and_matches_the_source(void)
     TEST_ASSERT_EQUAL_UINT16(blocks, counted);
 }
 
+// Defect 4. One bit flipped in a sector's data, on a track built here, and
+// only that sector is refused.
+void test_damaged_data_block_is_not_served(void)
+{
+    // decodeTrack() is pure RAM; the container is never read
+    auto image = std::make_shared<TestG64Stream>(std::make_shared<FileContainerStream>("build_test_g64_unused.g64"));
+    std::vector<uint8_t> gcr = buildTrack(18, 19);
+
+    TestG64Stream::DecodedTrack whole;
+    image->decodeTrack(gcr.data(), (uint32_t)gcr.size(), whole);
+    for (uint8_t sector = 0; sector < 19; sector++)
+    {
+        TEST_ASSERT_TRUE(whole.status[sector] & TestG64Stream::SECTOR_DATA_OK);
+        TEST_ASSERT_EQUAL_UINT8(sector, whole.data[sector][0]);
+        TEST_ASSERT_EQUAL_UINT8(sector, whole.data[sector][255]);
+    }
+
+    // Sector 5's data block starts after five whole sectors and its own
+    // sync, header and gap. Its first data byte goes from 5 to 4: still
+    // valid GCR, so only the checksum can tell.
+    const size_t per_sector = 5 + 10 + 9 + 5 + 325 + 8;
+    size_t data = 5 * per_sector + 5 + 10 + 9 + 5;
+    uint8_t plain[4] = { 0x07, 5, 5, 5 };
+    uint8_t changed[4] = { 0x07, 4, 5, 5 };
+    std::vector<uint8_t> a, b;
+    appendGCR(a, plain, 4);
+    appendGCR(b, changed, 4);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(a.data(), &gcr[data], 5);
+    memcpy(&gcr[data], b.data(), 5);
+
+    TestG64Stream::DecodedTrack damaged;
+    image->decodeTrack(gcr.data(), (uint32_t)gcr.size(), damaged);
+    for (uint8_t sector = 0; sector < 19; sector++)
+    {
+        TEST_ASSERT_TRUE(damaged.status[sector] & TestG64Stream::SECTOR_HEADER_OK);
+        if (sector == 5)
+            TEST_ASSERT_FALSE(damaged.status[sector] & TestG64Stream::SECTOR_DATA_OK);
+        else
+            TEST_ASSERT_TRUE(damaged.status[sector] & TestG64Stream::SECTOR_DATA_OK);
+    }
+}
+
 // The whole disk, every sector of every track, byte for byte against the .d64
 // the fixture was made from. This is what would catch a sector served from the
 // wrong place, a stale buffer (defect 3), or an off-by-one in the track table.
@@ -344,6 +457,78 @@ void test_reading_a_file_through_the_stream_matches_the_source(void)
 
     TEST_ASSERT_EQUAL_UINT32_MESSAGE((uint32_t)expected.size(), (uint32_t)got.size(), name);
     TEST_ASSERT_EQUAL_UINT8_ARRAY_MESSAGE(expected.data(), got.data(), expected.size(), name);
+
+    // What ImageBroker is told it holds covers the file's chain and the
+    // sector read last, which D64MStream keeps for it, not only the tracks.
+    uint32_t tracks = image->track_cache.size() * sizeof(TestG64Stream::DecodedTrack);
+    TEST_ASSERT_TRUE(image->footprint() - tracks >= sizeof(G64MStream) + 256 + (blocks * 2));
+}
+
+// Benchmark: LOAD"$" followed by LOAD of the largest file, the way a user
+// actually touches an image. Before the track cache every seekSector() rescanned
+// the raw track one container read per byte, so this cost tens of thousands of
+// reads; now each track the walk visits is read in one piece and decoded once.
+// The timing is printed for comparison, the read count is what is asserted.
+void test_benchmark_directory_and_file_read(void)
+{
+    auto src = std::make_shared<CountingContainerStream>(IMAGE);
+    if (!src->isOpen())
+        TEST_IGNORE_MESSAGE("fixture missing - run test/native/test_g64_read/host/make_g64.py");
+
+    auto image = std::make_shared<TestG64Stream>(src);
+    image->mode = std::ios_base::in;
+
+    auto started = std::chrono::steady_clock::now();
+
+    TEST_ASSERT_TRUE(image->readHeader());
+
+    std::string largest;
+    uint16_t largest_blocks = 0;
+    uint16_t entries = 0;
+    for (uint16_t index = 1; index < 512 && image->seekEntry(index); index++)
+    {
+        entries++;
+        if (image->entry.blocks <= largest_blocks)
+            continue;
+
+        char name[17] = { 0 };
+        std::memcpy(name, image->entry.filename, 16);
+        for (int c = 15; c >= 0 && (uint8_t)name[c] == 0xa0; c--)
+            name[c] = 0;
+
+        largest = mstr::toUTF8(std::string(name));
+        largest_blocks = image->entry.blocks;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(entries > 0, "empty directory");
+
+    TEST_ASSERT_TRUE_MESSAGE(image->seekPath(largest), largest.c_str());
+
+    uint32_t bytes = 0;
+    uint8_t buffer[256];
+    for (int guard = 0; guard < 4096; guard++)
+    {
+        uint32_t n = image->read(buffer, sizeof(buffer));
+        if (n == 0)
+            break;
+        bytes += n;
+    }
+
+    double elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count();
+
+    printf("g64 directory (%u entries) + %u-block file (%lu bytes): %.2f ms, "
+           "%lu container reads, %lu tracks decoded, %lu track hits\n",
+           (unsigned)entries, (unsigned)largest_blocks, (unsigned long)bytes, elapsed,
+           (unsigned long)src->reads, (unsigned long)image->track_decodes,
+           (unsigned long)image->track_hits);
+
+    TEST_ASSERT_TRUE(bytes > 0);
+
+    // Three reads per decoded track - table entry, length, raw track - and
+    // every decode past the first G64_TRACK_CACHE_TRACKS is an eviction the
+    // walk forced, not a rescan.
+    TEST_ASSERT_TRUE(image->track_hits > image->track_decodes);
+    TEST_ASSERT_TRUE(src->reads <= (image->track_decodes * 3) + 1);
 }
 
 int main(int argc, char** argv)
@@ -358,6 +543,8 @@ int main(int argc, char** argv)
     RUN_TEST(test_file_chain_walks_and_matches_the_source);
     RUN_TEST(test_reading_a_file_through_the_stream_matches_the_source);
     RUN_TEST(test_every_sector_matches_the_source_image);
+    RUN_TEST(test_damaged_data_block_is_not_served);
+    RUN_TEST(test_benchmark_directory_and_file_read);
 
     return UNITY_END();
 }
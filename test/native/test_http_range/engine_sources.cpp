@@ -0,0 +1,18 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// network/http.cpp itself cannot be built natively (esp_http_client), which is
+// why the range engine lives on its own in network/http_range.cpp: that file is
+// the one under test, and the D64 engine is pulled in to drive it with the same
+// seek/read pattern a LOAD"$" and a LOAD of a file produce on the drive.
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp leaks a bare min(a,b) macro into the rest of this unit.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
+#include "../../../lib/meatloaf/media/disk/d64.cpp"
+#include "../../../lib/meatloaf/network/http_range.cpp"
+#include "../test_disk_write/native_stubs.cpp"
@@ -0,0 +1,485 @@
+// Request-count tests for HTTPRangeCache (lib/meatloaf/network/http_range.h).
+//
+// A D64 mounted over HTTP used to cost one range request per seek: the media
+// engine seeks before every sector, BAM record and directory entry, and the
+// client answered each with a fresh "bytes=pos-(pos+256+5)" GET. These tests
+// replay the same engine over two model streams sitting on one stand-in
+// server that counts requests:
+//
+//   LegacyStream - the old HTTPMStream/MeatHttpClient behaviour: a seek to
+//                  anywhere but the current read cursor is a new request for
+//                  HTTP_BLOCK_SIZE + 6 bytes, and a read that runs off the end
+//                  of a response re-pages with the caller's size.
+//   RangedStream - the new one: seek is bookkeeping, read goes through
+//                  HTTPRangeCache with the server as its fetcher.
+//
+// Both serve the same bytes; only the number of round trips may differ.
+
+#include <unity.h>
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "media/disk/d64.h"
+#include "network/http_range.h"
+#include "../test_disk_write/file_container_stream.h"
+
+// The remote end. Every call to serve() is one HTTP request.
+struct StandInServer
+{
+    std::vector<uint8_t> body;
+    uint32_t requests = 0;
+
+    uint32_t serve(uint32_t position, uint8_t* buf, uint32_t size)
+    {
+        requests++;
+        if (position >= body.size())
+            return 0;
+        uint32_t n = std::min<uint32_t>(size, (uint32_t)body.size() - position);
+        memcpy(buf, body.data() + position, n);
+        return n;
+    }
+};
+
+class LegacyStream : public MStream
+{
+public:
+    LegacyStream(StandInServer& server) : MStream("http://stand.in/image.d64"), _server(server)
+    {
+        _size = (uint32_t)server.body.size();
+        request(0, HTTP_RANGE_WINDOW_MIN);   // the probe open() sends
+    }
+
+    bool isOpen() override { return true; }
+    void close() override {}
+    bool open(std::ios_base::openmode) override { return true; }
+    uint32_t write(const uint8_t*, uint32_t) override { return 0; }
+
+    bool seek(uint32_t pos) override
+    {
+        if (pos > _size)
+            return false;
+        if (pos != _at || _cursor == _response.size())
+            request(pos, HTTP_RANGE_WINDOW_MIN);
+        _position = pos;
+        return true;
+    }
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        if (_position >= _size)
+            return 0;
+        if (_cursor == _response.size())
+            request(_position, size);
+
+        uint32_t n = std::min<uint32_t>(size, (uint32_t)_response.size() - _cursor);
+        memcpy(buf, _response.data() + _cursor, n);
+        _cursor += n;
+        _at += n;
+        _position += n;
+
+        // Short read on a drained range: MeatHttpClient::read() re-pages.
+        if (n < size && _position < _size)
+            request(_position, size);
+        return n;
+    }
+
+private:
+    StandInServer& _server;
+    std::vector<uint8_t> _response;
+    uint32_t _cursor = 0;
+    uint32_t _at = 0;   // offset of the next byte the open response yields
+
+    // "bytes=pos-(pos+size+5)" is inclusive: size + 6 bytes.
+    void request(uint32_t pos, uint32_t size)
+    {
+        _response.assign(size + 6, 0);
+        _response.resize(_server.serve(pos, _response.data(), size + 6));
+        _cursor = 0;
+        _at = pos;
+    }
+};
+
+class RangedStream : public MStream
+{
+public:
+    RangedStream(StandInServer& server, HTTPRangeCache& cache)
+        : MStream("http://stand.in/image.d64"), _server(server), _cache(cache)
+    {
+        _size = (uint32_t)server.body.size();
+        _server.requests++;   // the probe open() sends; its bytes are not reused here
+    }
+
+    bool isOpen() override { return true; }
+    void close() override {}
+    bool open(std::ios_base::openmode) override { return true; }
+    uint32_t write(const uint8_t*, uint32_t) override { return 0; }
+
+    bool seek(uint32_t pos) override
+    {
+        if (pos > _size)
+            return false;
+        _position = pos;
+        return true;
+    }
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        uint32_t n = _cache.read(_position, buf, size, _size,
+            [this](uint32_t pos, uint8_t* dst, uint32_t len) { return _server.serve(pos, dst, len); });
+        _position += n;
+        return n;
+    }
+
+private:
+    StandInServer& _server;
+    HTTPRangeCache& _cache;
+};
+
+// readHeader()/seekEntry()/entry are protected; the drive reaches them through
+// D64MFile, which needs ImageBroker and MFSOwner. Expose them instead.
+class TestD64 : public D64MStream
+{
+public:
+    using D64MStream::D64MStream;
+    using D64MStream::readHeader;
+    using D64MStream::seekEntry;
+    using D64MStream::entry;
+};
+
+static const char* IMAGE_PATH = "build_test_http_range.d64";
+static const uint32_t BIG_SIZE = 30 * 254;   // a 30-block PRG
+
+static std::vector<uint8_t> big_payload()
+{
+    std::vector<uint8_t> p(BIG_SIZE);
+    for (uint32_t i = 0; i < BIG_SIZE; i++)
+        p[i] = (uint8_t)(i * 7 + (i >> 8));
+    return p;
+}
+
+// One SAVE, on a fresh stream as the drive would open it - close() drops the
+// BAM state a second save on the same stream would need.
+static void save_file(const std::string& name, const std::vector<uint8_t>& data)
+{
+    auto src = std::make_shared<FileContainerStream>(IMAGE_PATH);
+    D64MStream image(src);
+    image.mode = std::ios_base::out;
+    TEST_ASSERT_TRUE(image.seekPath(name));
+    TEST_ASSERT_EQUAL_UINT32(data.size(), image.write(data.data(), (uint32_t)data.size()));
+    image.close();
+    TEST_ASSERT_EQUAL_UINT32(0, image.error());
+}
+
+// A 1541 image holding eleven small files and one 30-block file, so the
+// directory spans two sectors and the big file's chain crosses tracks.
+static std::vector<uint8_t> build_image()
+{
+    remove(IMAGE_PATH);
+    {
+        auto src = std::make_shared<FileContainerStream>(IMAGE_PATH, 174848);
+        D64MStream image(src);
+        TEST_ASSERT_TRUE(image.formatImage("rangetest", "01"));
+        src->close();
+    }
+    for (int i = 0; i < 11; i++)
+        save_file("file" + std::to_string(i), std::vector<uint8_t>(300 + i * 40, (uint8_t)('A' + i)));
+    save_file("bigfile", big_payload());
+
+    std::vector<uint8_t> bytes;
+    FILE* f = fopen(IMAGE_PATH, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        bytes.insert(bytes.end(), chunk, chunk + n);
+    fclose(f);
+    remove(IMAGE_PATH);
+    TEST_ASSERT_EQUAL_UINT32(174848, bytes.size());
+    return bytes;
+}
+
+// LOAD"$" followed by LOAD"BIGFILE": header, every directory entry, the BAM
+// for BLOCKS FREE, then the file's chain end to end.
+struct Workload
+{
+    std::vector<std::string> names;
+    uint16_t blocks_free = 0;
+    std::vector<uint8_t> big;
+};
+
+static Workload run_workload(std::shared_ptr<MStream> container)
+{
+    Workload w;
+    TestD64 image(container);
+
+    TEST_ASSERT_TRUE(image.readHeader());
+    for (uint16_t i = 1; image.seekEntry(i); i++)
+    {
+        if (image.entry.file_type == 0x00)
+            continue;
+        w.names.push_back(std::string((const char*)image.entry.filename, 16));
+    }
+    w.blocks_free = image.blocksFree();
+
+    image.mode = std::ios_base::in;
+    TEST_ASSERT_TRUE(image.seekPath("bigfile"));
+    uint8_t buf[256];
+    uint32_t n;
+    while ((n = image.read(buf, sizeof(buf))) > 0)
+        w.big.insert(w.big.end(), buf, buf + n);
+    return w;
+}
+
+void setUp(void) {}
+void tearDown(void) { remove(IMAGE_PATH); }
+
+void test_directory_and_load_need_a_fraction_of_the_requests(void)
+{
+    StandInServer server;
+    server.body = build_image();
+
+    auto legacy = run_workload(std::make_shared<LegacyStream>(server));
+    uint32_t legacy_requests = server.requests;
+
+    // Sized as on a PSRAM board, whatever this host's defaults are: that is
+    // where the 64 KB step, and so the full saving, is available.
+    server.requests = 0;
+    HTTPRangeCache cache(128 * 1024, 64 * 1024);
+    auto ranged = run_workload(std::make_shared<RangedStream>(server, cache));
+    uint32_t ranged_requests = server.requests;
+
+    printf("legacy: %u requests, ranged: %u requests (%u hits, %u misses, %u bytes cached)\n",
+           legacy_requests, ranged_requests, cache.hits, cache.misses, cache.bytes());
+
+    // Same answers...
+    TEST_ASSERT_EQUAL_UINT32(12, ranged.names.size());
+    TEST_ASSERT_EQUAL_UINT32(legacy.names.size(), ranged.names.size());
+    for (size_t i = 0; i < ranged.names.size(); i++)
+        TEST_ASSERT_EQUAL_STRING(legacy.names[i].c_str(), ranged.names[i].c_str());
+    TEST_ASSERT_EQUAL_UINT16(legacy.blocks_free, ranged.blocks_free);
+    auto expected = big_payload();
+    TEST_ASSERT_EQUAL_UINT32(BIG_SIZE, ranged.big.size());
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected.data(), ranged.big.data(), BIG_SIZE);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(legacy.big.data(), ranged.big.data(), BIG_SIZE);
+
+    // ...for a fraction of the round trips: the probe and two windows. The
+    // engine reads a file in runs of sectors (D64_PREFETCH_RUN), so the
+    // legacy client pays a request per run for the LOAD rather than one per
+    // block as it once did; it still pays one per seek for the directory.
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(3, ranged_requests);
+    TEST_ASSERT_TRUE(ranged_requests * 3 <= legacy_requests);
+}
+
+// The window grows only while accesses stay local, and one far jump drops it
+// straight back to a single block.
+void test_window_grows_while_local_and_resets_on_jump(void)
+{
+    StandInServer server;
+    server.body.assign(1024 * 1024, 0x5A);
+    auto fetch = [&](uint32_t pos, uint8_t* dst, uint32_t len) { return server.serve(pos, dst, len); };
+
+    HTTPRangeCache cache(1024 * 1024, 64 * 1024);
+    uint8_t buf[256];
+    uint32_t total = (uint32_t)server.body.size();
+
+    // No history yet: the middle step.
+    TEST_ASSERT_EQUAL_UINT32(256, cache.read(0, buf, 256, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(4 * 1024, cache.window());
+
+    TEST_ASSERT_EQUAL_UINT32(256, cache.read(4 * 1024, buf, 256, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(64 * 1024, cache.window());
+    TEST_ASSERT_EQUAL_UINT32(2, server.requests);
+
+    // Everything up to 68 KB is now resident.
+    for (uint32_t pos = 256; pos < 68 * 1024; pos += 256)
+        TEST_ASSERT_EQUAL_UINT32(256, cache.read(pos, buf, 256, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(2, server.requests);
+
+    TEST_ASSERT_EQUAL_UINT32(256, cache.read(900 * 1024, buf, 256, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(HTTP_RANGE_WINDOW_MIN, cache.window());
+
+    // Back in the neighbourhood of that jump, the ladder climbs again.
+    TEST_ASSERT_EQUAL_UINT32(256, cache.read(900 * 1024 + 256, buf, 256, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(4 * 1024, cache.window());
+    TEST_ASSERT_EQUAL_UINT32(4, server.requests);
+}
+
+// A window never asks past EOF, and a read at EOF costs no request.
+void test_reads_are_clamped_to_the_resource(void)
+{
+    StandInServer server;
+    server.body.assign(1000, 0x11);
+    auto fetch = [&](uint32_t pos, uint8_t* dst, uint32_t len) {
+        TEST_ASSERT_TRUE(pos + len <= 1000);
+        return server.serve(pos, dst, len);
+    };
+
+    HTTPRangeCache cache;
+    uint8_t buf[512];
+    TEST_ASSERT_EQUAL_UINT32(232, cache.read(768, buf, 512, 1000, fetch));
+    TEST_ASSERT_EQUAL_UINT32(1, server.requests);
+    TEST_ASSERT_EQUAL_UINT32(0, cache.read(1000, buf, 512, 1000, fetch));
+    TEST_ASSERT_EQUAL_UINT32(1, server.requests);
+}
+
+// A failed fetch is reported as a short read, not retried forever.
+void test_failed_fetch_returns_short_read(void)
+{
+    uint32_t calls = 0;
+    auto fetch = [&](uint32_t, uint8_t*, uint32_t) { calls++; return (uint32_t)0; };
+
+    HTTPRangeCache cache;
+    uint8_t buf[256];
+    TEST_ASSERT_EQUAL_UINT32(0, cache.read(0, buf, sizeof(buf), 4096, fetch));
+    TEST_ASSERT_EQUAL_UINT32(1, calls);
+}
+
+// The byte budget holds: the stalest windows go first, the newest stays.
+void test_budget_evicts_least_recently_used(void)
+{
+    StandInServer server;
+    server.body.resize(64 * 1024);
+    for (size_t i = 0; i < server.body.size(); i++)
+        server.body[i] = (uint8_t)(i >> 8);
+    auto fetch = [&](uint32_t pos, uint8_t* dst, uint32_t len) { return server.serve(pos, dst, len); };
+
+    // Far-apart reads keep every window at one block.
+    HTTPRangeCache cache(3 * HTTP_RANGE_WINDOW_MIN, HTTP_RANGE_WINDOW_MIN);
+    uint8_t b;
+    uint32_t total = (uint32_t)server.body.size();
+    TEST_ASSERT_EQUAL_UINT32(1, cache.read(0,         &b, 1, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(1, cache.read(20 * 1024, &b, 1, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(1, cache.read(40 * 1024, &b, 1, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(1, cache.read(0,         &b, 1, total, fetch));   // refresh block 0
+    TEST_ASSERT_EQUAL_UINT32(3, server.requests);
+
+    TEST_ASSERT_EQUAL_UINT32(1, cache.read(60 * 1024, &b, 1, total, fetch));   // evicts 20 KB
+    TEST_ASSERT_EQUAL_UINT32(3 * HTTP_RANGE_WINDOW_MIN, cache.bytes());
+    TEST_ASSERT_EQUAL_UINT32(4, server.requests);
+
+    TEST_ASSERT_EQUAL_UINT32(1, cache.read(0, &b, 1, total, fetch));
+    TEST_ASSERT_EQUAL_UINT32(4, server.requests);
+    TEST_ASSERT_EQUAL_UINT32(1, cache.read(20 * 1024, &b, 1, total, fetch));
+    TEST_ASSERT_EQUAL_UINT8(20 * 4, b);
+    TEST_ASSERT_EQUAL_UINT32(5, server.requests);
+}
+
+// A copy or an unpacked archive turns sequential access on and off again
+// around its read. The stream must go back to the cache afterwards; it used
+// to stay on the streaming path for the rest of its life.
+void test_sequential_access_comes_back_to_the_cache(void)
+{
+    HTTPRangeMode mode;
+    mode.reset(true);
+    for (int round = 0; round < 2; round++)
+    {
+        TEST_ASSERT_TRUE(mode.setSequential(true));    // client must catch up
+        TEST_ASSERT_FALSE(mode.ranged());
+        TEST_ASSERT_FALSE(mode.setSequential(true));   // already streaming
+        TEST_ASSERT_FALSE(mode.setSequential(false));
+        TEST_ASSERT_TRUE(mode.ranged());
+    }
+
+    // Turning it off when it was never on changes nothing
+    TEST_ASSERT_FALSE(mode.setSequential(false));
+    TEST_ASSERT_TRUE(mode.ranged());
+
+    // A resource that was not ranged doesn't become so
+    mode.reset(false);
+    TEST_ASSERT_FALSE(mode.setSequential(true));
+    mode.setSequential(false);
+    TEST_ASSERT_FALSE(mode.ranged());
+
+    // A failed fetch is for good, sequential or not
+    mode.reset(true);
+    mode.setSequential(true);
+    mode.fail();
+    mode.setSequential(false);
+    TEST_ASSERT_FALSE(mode.ranged());
+    mode.reset(true);
+    mode.fail();
+    TEST_ASSERT_FALSE(mode.ranged());
+
+    // and a new open() decides afresh
+    mode.reset(true);
+    TEST_ASSERT_TRUE(mode.ranged());
+}
+
+// Drives on one host share the session's caches. Each reads its own URL
+// while others push theirs out of the set; a reader's cache must outlive the
+// eviction and serve the server's bytes to the end of its read.
+void test_concurrent_readers_keep_their_cache(void)
+{
+    StandInServer server;
+    server.body.resize(64 * 1024);
+    for (size_t i = 0; i < server.body.size(); i++)
+        server.body[i] = (uint8_t)(i * 7);
+    uint32_t total = (uint32_t)server.body.size();
+
+    HTTPRangeCacheSet caches(2);
+    std::atomic<uint32_t> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 6; t++)
+    {
+        threads.emplace_back([&, t] {
+            std::string url = "http://stand.in/disk" + std::to_string(t) + ".d64";
+            uint8_t buf[700];
+            for (int i = 0; i < 300; i++)
+            {
+                uint32_t pos = (uint32_t)((i * 4099 + t * 977) % (total - sizeof(buf)));
+                auto cache = caches.get(url);
+                uint32_t n = cache->read(pos, buf, sizeof(buf), total,
+                    [&](uint32_t at, uint8_t* dst, uint32_t len) {
+                        // A slow fetch, so the others evict this cache meanwhile
+                        std::this_thread::yield();
+                        uint32_t got = std::min<uint32_t>(len, total - at);
+                        memcpy(dst, server.body.data() + at, got);
+                        return got;
+                    });
+                if (n != sizeof(buf) || memcmp(buf, server.body.data() + pos, n) != 0)
+                    wrong++;
+                if (i % 40 == t)
+                    caches.invalidate(url);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, wrong);
+    TEST_ASSERT_TRUE(caches.size() <= 2);
+}
+
+// The set is bounded and most recently used stays
+void test_cache_set_is_bounded(void)
+{
+    HTTPRangeCacheSet caches(2);
+    auto a = caches.get("a");
+    auto b = caches.get("b");
+    TEST_ASSERT_TRUE(caches.get("a") == a);
+    caches.get("c");                         // evicts b
+    TEST_ASSERT_EQUAL(2, caches.size());
+    TEST_ASSERT_TRUE(caches.get("a") == a);
+    TEST_ASSERT_TRUE(caches.get("b") != b);  // b was a fresh cache
+    caches.invalidate("b");
+    TEST_ASSERT_EQUAL(1, caches.size());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_directory_and_load_need_a_fraction_of_the_requests);
+    RUN_TEST(test_window_grows_while_local_and_resets_on_jump);
+    RUN_TEST(test_reads_are_clamped_to_the_resource);
+    RUN_TEST(test_failed_fetch_returns_short_read);
+    RUN_TEST(test_budget_evicts_least_recently_used);
+    RUN_TEST(test_sequential_access_comes_back_to_the_cache);
+    RUN_TEST(test_cache_set_is_bounded);
+    RUN_TEST(test_concurrent_readers_keep_their_cache);
+    return UNITY_END();
+}
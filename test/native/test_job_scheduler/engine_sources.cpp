@@ -0,0 +1,6 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// Natively the scheduler runs on its POSIX thread backend.
+#include "../../../lib/task/fnScheduler.cpp"
@@ -0,0 +1,271 @@
+// Tests for fnJobScheduler (lib/task/fnScheduler.h) on its POSIX thread
+// backend: priorities, checkpoints, timers, deadlines and cancellation.
+//
+// The preemption test is the one that matters. A background job that runs
+// for a long time in checkpointed steps must not delay a high priority job
+// submitted while it runs, and must make no progress while that job is
+// queued or running.
+//
+// Timings are generous: the assertions are about ordering, and the numbers
+// only need to hold on a loaded CI machine.
+
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fnScheduler.h"
+
+static fnJobScheduler* s_scheduler = nullptr;
+
+static void sleep_ms(int ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+static uint64_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Poll until 'done' or 'timeout_ms' has passed
+template <typename F>
+static bool wait_for(F done, int timeout_ms = 5000)
+{
+    uint64_t until = now_ms() + timeout_ms;
+    while (!done())
+    {
+        if (now_ms() > until)
+            return false;
+        sleep_ms(1);
+    }
+    return true;
+}
+
+static fnJobStats stats_for(const char* name)
+{
+    for (auto& s : s_scheduler->stats())
+        if (s.name == name)
+            return s;
+    return fnJobStats();
+}
+
+void setUp(void)
+{
+    s_scheduler = new fnJobScheduler();
+    TEST_ASSERT_TRUE(s_scheduler->start());
+}
+
+void tearDown(void)
+{
+    s_scheduler->stop();
+    delete s_scheduler;
+    s_scheduler = nullptr;
+}
+
+void test_jobs_run_in_submission_order_per_priority(void)
+{
+    std::mutex m;
+    std::vector<int> order;
+    std::atomic<int> done{ 0 };
+
+    for (int i = 0; i < 5; i++)
+    {
+        s_scheduler->submit("ordered", JOB_NORMAL, [&, i](fnJobContext&) {
+            std::lock_guard<std::mutex> lock(m);
+            order.push_back(i);
+            done++;
+        });
+    }
+
+    TEST_ASSERT_TRUE(wait_for([&] { return done == 5; }));
+    for (int i = 0; i < 5; i++)
+        TEST_ASSERT_EQUAL(i, order[i]);
+    TEST_ASSERT_TRUE(wait_for([] { return stats_for("ordered").runs == 5; }));
+}
+
+void test_high_priority_preempts_long_background_job(void)
+{
+    std::atomic<int> progress{ 0 };
+    std::atomic<bool> background_done{ false };
+    std::atomic<bool> high_done{ false };
+    std::atomic<int> progress_when_high_started{ -1 };
+    std::atomic<int> progress_when_high_ended{ -1 };
+    uint64_t high_submitted = 0, high_started = 0;
+
+    // 400 steps of ~2 ms: most of a second of background work
+    s_scheduler->submit("scan", JOB_BACKGROUND, [&](fnJobContext& job) {
+        for (int step = 0; step < 400; step++)
+        {
+            if (!job.checkpoint())
+                break;
+            uint64_t until = now_ms() + 2;
+            while (now_ms() < until) {}
+            progress++;
+        }
+        background_done = true;
+    });
+
+    TEST_ASSERT_TRUE(wait_for([&] { return progress > 20; }));
+
+    high_submitted = now_ms();
+    s_scheduler->submit("request", JOB_HIGH, [&](fnJobContext&) {
+        high_started = now_ms();
+        progress_when_high_started = progress.load();
+        sleep_ms(60);
+        progress_when_high_ended = progress.load();
+        high_done = true;
+    });
+
+    TEST_ASSERT_TRUE(wait_for([&] { return high_done.load(); }));
+    TEST_ASSERT_FALSE(background_done.load());
+
+    // The background job took at most the one step it was in when the
+    // request arrived, then waited at its next checkpoint
+    TEST_ASSERT_TRUE(progress_when_high_ended - progress_when_high_started <= 1);
+
+    TEST_ASSERT_TRUE(wait_for([&] { return background_done.load(); }));
+    TEST_ASSERT_EQUAL(400, progress.load());
+    TEST_ASSERT_TRUE(stats_for("scan").yields >= 1);
+
+    printf("high priority job started %llu ms after submission, background paused at step %d of 400\n",
+           (unsigned long long)(high_started - high_submitted), progress_when_high_started.load());
+    TEST_ASSERT_TRUE(high_started - high_submitted < 50);
+}
+
+void test_cancel_stops_queued_and_running_jobs(void)
+{
+    std::atomic<bool> started{ false };
+    std::atomic<bool> stopped{ false };
+    std::atomic<int> ran{ 0 };
+
+    uint32_t running = s_scheduler->submit("long", JOB_BACKGROUND, [&](fnJobContext& job) {
+        started = true;
+        while (job.checkpoint())
+            sleep_ms(1);
+        stopped = true;
+    });
+    uint32_t queued = s_scheduler->submit("queued", JOB_BACKGROUND, [&](fnJobContext&) { ran++; });
+
+    TEST_ASSERT_TRUE(wait_for([&] { return started.load(); }));
+    TEST_ASSERT_TRUE(s_scheduler->cancel(queued));
+    TEST_ASSERT_TRUE(s_scheduler->cancel(running));
+    TEST_ASSERT_TRUE(wait_for([&] { return stopped.load(); }));
+
+    sleep_ms(20);
+    TEST_ASSERT_EQUAL(0, ran.load());
+    TEST_ASSERT_EQUAL_UINT32(1, stats_for("queued").cancelled);
+    TEST_ASSERT_FALSE(s_scheduler->cancel(queued));
+
+    // A token shared with the caller cancels without the job ID
+    fnCancelToken token;
+    std::atomic<bool> saw_cancel{ false };
+    s_scheduler->submit("token", JOB_NORMAL, [&](fnJobContext& job) {
+        while (job.checkpoint())
+            sleep_ms(1);
+        saw_cancel = job.cancelled();
+    }, 0, token);
+    sleep_ms(10);
+    token.cancel();
+    TEST_ASSERT_TRUE(wait_for([&] { return saw_cancel.load(); }));
+}
+
+void test_timers_run_after_delay_and_periodically(void)
+{
+    std::atomic<uint64_t> fired_at{ 0 };
+    uint64_t submitted = now_ms();
+    s_scheduler->after("once", JOB_NORMAL, 50, [&](fnJobContext&) { fired_at = now_ms(); });
+
+    std::atomic<int> ticks{ 0 };
+    std::atomic<int> overlapping{ 0 };
+    std::atomic<bool> inside{ false };
+    uint32_t periodic = s_scheduler->every("tick", JOB_BACKGROUND, 10, [&](fnJobContext&) {
+        if (inside.exchange(true))
+            overlapping++;
+        ticks++;
+        sleep_ms(15);   // overruns its period
+        inside = false;
+    });
+
+    TEST_ASSERT_TRUE(wait_for([&] { return fired_at.load() != 0; }));
+    TEST_ASSERT_TRUE(fired_at - submitted >= 50);
+
+    TEST_ASSERT_TRUE(wait_for([&] { return ticks >= 5; }));
+    TEST_ASSERT_TRUE(s_scheduler->cancel(periodic));
+    sleep_ms(40);
+    int after_cancel = ticks.load();
+    sleep_ms(60);
+    TEST_ASSERT_EQUAL(after_cancel, ticks.load());
+    TEST_ASSERT_EQUAL(0, overlapping.load());
+    TEST_ASSERT_TRUE(wait_for([] { return stats_for("once").runs == 1; }));
+}
+
+void test_deadline_misses_and_latency_are_accounted(void)
+{
+    std::atomic<int> done{ 0 };
+    s_scheduler->submit("hog", JOB_NORMAL, [&](fnJobContext&) {
+        sleep_ms(80);
+        done++;
+    });
+    s_scheduler->submit("urgent", JOB_NORMAL, [&](fnJobContext&) { done++; }, 10);
+    s_scheduler->submit("relaxed", JOB_NORMAL, [&](fnJobContext&) { done++; }, 5000);
+
+    // Accounted as each job returns, just after it counted itself done
+    TEST_ASSERT_TRUE(wait_for([&] { return done == 3; }));
+    TEST_ASSERT_TRUE(wait_for([] { return stats_for("relaxed").runs == 1; }));
+
+    fnJobStats urgent = stats_for("urgent");
+    TEST_ASSERT_EQUAL_UINT32(1, urgent.late);
+    TEST_ASSERT_TRUE(urgent.max_latency_us >= 50000);
+    TEST_ASSERT_EQUAL_UINT32(0, stats_for("relaxed").late);
+
+    // Sleeping is not CPU time
+    fnJobStats hog = stats_for("hog");
+    TEST_ASSERT_TRUE(hog.max_run_us >= 80000);
+    TEST_ASSERT_TRUE(hog.cpu_us < hog.max_run_us / 2);
+}
+
+void test_stop_cancels_pending_work(void)
+{
+    std::atomic<int> ran{ 0 };
+    s_scheduler->after("later", JOB_NORMAL, 10000, [&](fnJobContext&) { ran++; });
+    s_scheduler->submit("blocker", JOB_BACKGROUND, [&](fnJobContext& job) {
+        while (job.checkpoint())
+            sleep_ms(1);
+    });
+    for (int i = 0; i < 3; i++)
+        s_scheduler->submit("behind", JOB_BACKGROUND, [&](fnJobContext&) { ran++; });
+
+    sleep_ms(10);
+    s_scheduler->stop();
+    TEST_ASSERT_EQUAL(0, ran.load());
+    TEST_ASSERT_EQUAL_UINT32(3, stats_for("behind").cancelled);
+
+    // And it starts again
+    TEST_ASSERT_TRUE(s_scheduler->start());
+    s_scheduler->submit("again", JOB_HIGH, [&](fnJobContext&) { ran++; });
+    TEST_ASSERT_TRUE(wait_for([&] { return ran == 1; }));
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_jobs_run_in_submission_order_per_priority);
+    RUN_TEST(test_high_priority_preempts_long_background_job);
+    RUN_TEST(test_cancel_stops_queued_and_running_jobs);
+    RUN_TEST(test_timers_run_after_delay_and_periodically);
+    RUN_TEST(test_deadline_misses_and_latency_are_accounted);
+    RUN_TEST(test_stop_cancels_pending_work);
+    return UNITY_END();
+}
+
+int main(int argc, char** argv)
+{
+    return runUnityTests();
+}
@@ -10,6 +10,7 @@
 #include "../../../lib/utils/U8Char.cpp"
 #include "../../../lib/utils/string_utils.cpp"
 #include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
 #include "../../../lib/meatloaf/media/disk/m2i.cpp"
 
 // Link-only stubs for symbols meatloaf.h/m2i.cpp reference but these tests
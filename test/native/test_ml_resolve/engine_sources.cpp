@@ -0,0 +1,4 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+#include "../../../lib/meatloaf/service/ml_cache.cpp"
@@ -0,0 +1,285 @@
+// Tests for the ML:// short code cache (lib/meatloaf/service/ml_cache.cpp)
+// that MLMFileSystem::resolve() goes through.
+//
+// The HTTP client does not build on the host, so FakeApi stands in for
+// api.meatloaf.cc: it answers from a table the way MLMFileSystem::fetch()
+// turns a response into an Answer, with whatever Cache-Control the test
+// sets, and counts the lookups that reach it. Time is passed in explicitly.
+
+#include <unity.h>
+
+#include <cstdio>
+#include <map>
+#include <string>
+
+#include "service/ml_cache.h"
+
+static const char* PERSIST = "test_ml_resolve.codes";
+
+class FakeApi
+{
+public:
+    std::map<std::string, std::string> codes;
+    std::string cache_control;
+    bool reachable = true;
+    uint32_t requests = 0;
+
+    MLResolveCache::Fetch fetch()
+    {
+        return [this](const std::string& key) {
+            requests++;
+            MLResolveCache::Answer answer;
+            if (!reachable) {
+                answer.definitive = false;
+                return answer;
+            }
+            answer.max_age = MLResolveCache::maxAge(cache_control);
+            auto it = codes.find(key);
+            if (it != codes.end()) {
+                answer.found = true;
+                answer.url = it->second;
+            }
+            return answer;
+        };
+    }
+};
+
+static const std::string KEY = "https://api.meatloaf.cc/?elite";
+static const std::string TARGET = "https://csdb.dk/getinternalfile.php/1234/elite.d64";
+
+static FakeApi api()
+{
+    FakeApi a;
+    a.codes[KEY] = TARGET;
+    return a;
+}
+
+void setUp(void) { remove(PERSIST); }
+void tearDown(void) { remove(PERSIST); }
+
+// Opening the same ml: path again - and again - asks the API once
+void test_repeat_resolve_hits_api_once(void)
+{
+    FakeApi a = api();
+    MLResolveCache cache;
+    for (int i = 0; i < 10; i++)
+        TEST_ASSERT_EQUAL_STRING(TARGET.c_str(), cache.resolve(KEY, a.fetch(), 1000 + i).c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, a.requests);
+    TEST_ASSERT_EQUAL_UINT32(9, cache.hits());
+}
+
+// The answer is kept as long as Cache-Control says, and no longer
+void test_cache_control_lifetime(void)
+{
+    FakeApi a = api();
+    a.cache_control = "public, max-age=300";
+    MLResolveCache cache;
+    cache.resolve(KEY, a.fetch(), 1000);
+    cache.resolve(KEY, a.fetch(), 1299);
+    TEST_ASSERT_EQUAL_UINT32(1, a.requests);
+
+    a.codes[KEY] = "https://example.com/moved.d64";
+    TEST_ASSERT_EQUAL_STRING("https://example.com/moved.d64", cache.resolve(KEY, a.fetch(), 1300).c_str());
+    TEST_ASSERT_EQUAL_UINT32(2, a.requests);
+
+    // no-store: every lookup goes to the API
+    MLResolveCache uncached;
+    a.cache_control = "no-store";
+    uncached.resolve(KEY, a.fetch(), 1000);
+    uncached.resolve(KEY, a.fetch(), 1000);
+    TEST_ASSERT_EQUAL_UINT32(4, a.requests);
+}
+
+// An unknown code is remembered for a minute; a failed lookup not at all
+void test_negative_and_failed_lookups(void)
+{
+    FakeApi a = api();
+    MLResolveCache cache;
+    std::string unknown = "https://api.meatloaf.cc/?nosuch";
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(unknown, a.fetch(), 1000).c_str());
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(unknown, a.fetch(), 1000 + ML_RESOLVE_NEGATIVE_TTL - 1).c_str());
+    TEST_ASSERT_EQUAL_UINT32(1, a.requests);
+
+    a.codes[unknown] = TARGET;
+    TEST_ASSERT_EQUAL_STRING(TARGET.c_str(), cache.resolve(unknown, a.fetch(), 1000 + ML_RESOLVE_NEGATIVE_TTL).c_str());
+    TEST_ASSERT_EQUAL_UINT32(2, a.requests);
+
+    a.reachable = false;
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(KEY, a.fetch(), 2000).c_str());
+    a.reachable = true;
+    TEST_ASSERT_EQUAL_STRING(TARGET.c_str(), cache.resolve(KEY, a.fetch(), 2000).c_str());
+    TEST_ASSERT_EQUAL_UINT32(4, a.requests);
+}
+
+static int count_lines(const char* path)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return -1;
+    int lines = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f))
+        lines++;
+    fclose(f);
+    return lines;
+}
+
+// What MLMFileSystem::fetch() gets back from HTTPMFile: a stream that has
+// its url set by the constructor whether or not it ever opened
+struct FakeStream
+{
+    std::string url;
+    bool open;
+    bool isOpen() { return open; }
+};
+
+// Only a stream that opened on a 2xx/3xx resolves, is cached and is saved;
+// a 404 is remembered as unknown but not saved; a stream that never opened
+// - DNS failure, timeout - or a 5xx is neither cached nor saved
+void test_response_to_answer(void)
+{
+    MLResolveCache cache;
+    cache.setPersistPath(PERSIST);
+    uint32_t requests = 0;
+    auto respond = [&requests](FakeStream stream, int rc) -> MLResolveCache::Fetch {
+        return [&requests, stream, rc](const std::string&) {
+            requests++;
+            FakeStream s = stream;
+            return MLResolveCache::answer(&s, rc, ML_RESOLVE_DEFAULT_TTL);
+        };
+    };
+
+    TEST_ASSERT_EQUAL_STRING(TARGET.c_str(), cache.resolve(KEY, respond({ TARGET, true }, 200), 1000).c_str());
+    TEST_ASSERT_EQUAL(1, cache.size());
+    TEST_ASSERT_EQUAL_INT(1, count_lines(PERSIST));
+
+    const std::string unknown = "https://api.meatloaf.cc/?nosuch";
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(unknown, respond({ unknown, true }, 404), 1000).c_str());
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(unknown, respond({ unknown, true }, 404), 1001).c_str());
+    TEST_ASSERT_EQUAL_UINT32(2, requests);
+    TEST_ASSERT_EQUAL(2, cache.size());
+    TEST_ASSERT_EQUAL_INT(1, count_lines(PERSIST));
+
+    const std::string down = "https://api.meatloaf.cc/?down";
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(down, respond({ down, false }, 0), 1000).c_str());
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(down, respond({ down, false }, 0), 1001).c_str());
+    TEST_ASSERT_EQUAL_STRING("", cache.resolve(down, respond({ down, true }, 503), 1002).c_str());
+    TEST_ASSERT_EQUAL_UINT32(5, requests);
+    TEST_ASSERT_EQUAL(2, cache.size());
+    TEST_ASSERT_EQUAL_INT(1, count_lines(PERSIST));
+
+    // Once the API answers, the code resolves
+    TEST_ASSERT_EQUAL_STRING(TARGET.c_str(), cache.resolve(down, respond({ TARGET, true }, 200), 1003).c_str());
+    TEST_ASSERT_EQUAL_INT(2, count_lines(PERSIST));
+}
+
+// What resolved before a reboot resolves after it without the API; what
+// expired in the meantime does not
+void test_persisted_across_instances(void)
+{
+    FakeApi a = api();
+    a.codes["https://api.meatloaf.cc/?short"] = "https://example.com/short.prg";
+    {
+        MLResolveCache before;
+        before.setPersistPath(PERSIST);
+        before.resolve(KEY, a.fetch(), 1000);
+        a.cache_control = "max-age=10";
+        before.resolve("https://api.meatloaf.cc/?short", a.fetch(), 1000);
+        before.resolve("https://api.meatloaf.cc/?nosuch", a.fetch(), 1000);
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, a.requests);
+
+    MLResolveCache after;
+    after.setPersistPath(PERSIST);
+    TEST_ASSERT_EQUAL_STRING(TARGET.c_str(), after.resolve(KEY, a.fetch(), 1100).c_str());
+    TEST_ASSERT_EQUAL_UINT32(3, a.requests);
+    TEST_ASSERT_EQUAL(1, after.size());
+
+    after.resolve("https://api.meatloaf.cc/?short", a.fetch(), 1100);
+    after.resolve("https://api.meatloaf.cc/?nosuch", a.fetch(), 1100);
+    TEST_ASSERT_EQUAL_UINT32(5, a.requests);
+}
+
+
+// A new code adds a line rather than writing the file over; a code taken
+// out stays out after a reboot; and the file is written over with just the
+// live codes once it has grown long
+void test_persist_file_is_appended(void)
+{
+    FakeApi a = api();
+    MLResolveCache cache;
+    cache.setPersistPath(PERSIST);
+    cache.resolve(KEY, a.fetch(), 1000);
+    TEST_ASSERT_EQUAL_INT(1, count_lines(PERSIST));
+
+    const std::string other = "https://api.meatloaf.cc/?other";
+    a.codes[other] = "https://example.com/other.prg";
+    cache.resolve(other, a.fetch(), 1000);
+    TEST_ASSERT_EQUAL_INT(2, count_lines(PERSIST));
+
+    cache.invalidate(KEY);
+    TEST_ASSERT_EQUAL_INT(3, count_lines(PERSIST));
+    {
+        MLResolveCache after;
+        after.setPersistPath(PERSIST);
+        TEST_ASSERT_TRUE(after.load(1100));
+        MLResolveCache::Answer answer;
+        TEST_ASSERT_FALSE(after.lookup(KEY, answer, 1100));
+        TEST_ASSERT_TRUE(after.lookup(other, answer, 1100));
+    }
+
+    // The same code answered again and again, as its lifetime runs out
+    a.cache_control = "max-age=10";
+    for (int i = 0; i < ML_RESOLVE_CACHE_LINES; i++)
+        cache.resolve(KEY, a.fetch(), 2000 + i * 20);
+    TEST_ASSERT_TRUE(count_lines(PERSIST) < 8);
+
+    MLResolveCache after;
+    after.setPersistPath(PERSIST);
+    uint32_t requests = a.requests;
+    TEST_ASSERT_EQUAL_STRING(TARGET.c_str(), after.resolve(KEY, a.fetch(), 2000 + (ML_RESOLVE_CACHE_LINES - 1) * 20).c_str());
+    TEST_ASSERT_EQUAL_UINT32(requests, a.requests);
+}
+
+void test_max_age_parsing(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(600, MLResolveCache::maxAge("max-age=600"));
+    TEST_ASSERT_EQUAL_UINT32(600, MLResolveCache::maxAge("Public, Max-Age=600, must-revalidate"));
+    TEST_ASSERT_EQUAL_UINT32(30, MLResolveCache::maxAge("max-age=600, s-maxage=30"));
+    TEST_ASSERT_EQUAL_UINT32(0, MLResolveCache::maxAge("max-age=600, no-cache"));
+    TEST_ASSERT_EQUAL_UINT32(0, MLResolveCache::maxAge("private, no-store"));
+    TEST_ASSERT_EQUAL_UINT32(ML_RESOLVE_DEFAULT_TTL, MLResolveCache::maxAge(""));
+    TEST_ASSERT_EQUAL_UINT32(42, MLResolveCache::maxAge("public", 42));
+}
+
+// Bounded: the entry closest to expiring makes room
+void test_cache_is_bounded(void)
+{
+    FakeApi a;
+    MLResolveCache cache;
+    for (int i = 0; i < ML_RESOLVE_CACHE_ENTRIES + 5; i++) {
+        std::string key = "https://api.meatloaf.cc/?c" + std::to_string(i);
+        a.codes[key] = "https://example.com/" + std::to_string(i);
+        a.cache_control = "max-age=" + std::to_string(1000 + i);
+        cache.resolve(key, a.fetch(), 1000);
+    }
+    TEST_ASSERT_EQUAL(ML_RESOLVE_CACHE_ENTRIES, cache.size());
+
+    MLResolveCache::Answer answer;
+    TEST_ASSERT_FALSE(cache.lookup("https://api.meatloaf.cc/?c0", answer, 1000));
+    TEST_ASSERT_TRUE(cache.lookup("https://api.meatloaf.cc/?c5", answer, 1000));
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_repeat_resolve_hits_api_once);
+    RUN_TEST(test_cache_control_lifetime);
+    RUN_TEST(test_negative_and_failed_lookups);
+    RUN_TEST(test_response_to_answer);
+    RUN_TEST(test_persisted_across_instances);
+    RUN_TEST(test_persist_file_is_appended);
+    RUN_TEST(test_max_age_parsing);
+    RUN_TEST(test_cache_is_bounded);
+    return UNITY_END();
+}
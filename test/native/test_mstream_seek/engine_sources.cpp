@@ -6,6 +6,9 @@
 #undef min
 #include "../../../lib/utils/U8Char.cpp"
 #include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
+#include "../../../lib/meatloaf/media/disk/d64.cpp"
 
 // Link-only stubs for symbols meatloaf.h references but these tests never
 // call. Shared verbatim with the disk-write suite rather than copied.
@@ -11,13 +11,23 @@
 //
 // Found while tracing an archive over HTTP that was handed bytes from the
 // middle of the file (see test_archive_extract).
+//
+// The second half covers D64MStream::seek() and readFile() over a file's
+// block chain, read in runs of sectors and sector by sector, and a load
+// benchmark.
 
 #include <unity.h>
 
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "meatloaf.h"
+#include "media/disk/d64.h"
+#include "../test_disk_write/file_container_stream.h"
 
 // Minimal MStream whose one-argument seek() can be made to fail on demand,
 // and which records the position it observed when it was entered.
@@ -115,6 +125,244 @@ void test_seek_modes_resolve_expected_targets(void)
     TEST_ASSERT_EQUAL_UINT32(900, s.observed_target);
 }
 
+// --- D64 file streams ------------------------------------------------------
+
+static const char* D64_PATH = "build_test_mstream_seek.d64";
+
+// Counts what a network container would turn into requests.
+class CountingFileStream : public FileContainerStream
+{
+public:
+    using FileContainerStream::FileContainerStream;
+    using MStream::seek;
+
+    uint32_t reads = 0;
+    uint32_t seeks = 0;
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        reads++;
+        return FileContainerStream::read(buf, size);
+    }
+    bool seek(uint32_t pos) override
+    {
+        seeks++;
+        return FileContainerStream::seek(pos);
+    }
+};
+
+static std::vector<uint8_t> pattern(uint32_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (uint32_t i = 0; i < size; i++)
+        data[i] = (uint8_t)((i * 7) + (i / 251) + seed);
+    return data;
+}
+
+// SMALL is a typical LOAD; BIG (about 40 KB) spans several tracks.
+static const uint32_t SMALL_SIZE = 20 * 254 - 77;
+static const uint32_t BIG_SIZE = 160 * 254 + 13;
+
+static void buildImage()
+{
+    remove(D64_PATH);
+    D64MStream image(std::make_shared<FileContainerStream>(D64_PATH, 174848));
+    TEST_ASSERT_TRUE(image.formatImage("seektest", "01"));
+
+    struct { const char* name; uint32_t size; uint32_t seed; } files[] = {
+        { "SMALL", SMALL_SIZE, 1 },
+        { "BIG", BIG_SIZE, 2 },
+    };
+    for (auto& f : files)
+    {
+        D64MStream writer(std::make_shared<FileContainerStream>(D64_PATH));
+        std::vector<uint8_t> data = pattern(f.size, f.seed);
+        writer.mode = std::ios_base::out;
+        TEST_ASSERT_TRUE(writer.seekPath(f.name));
+        TEST_ASSERT_EQUAL_UINT32(f.size, writer.write(data.data(), f.size));
+        writer.close();
+        TEST_ASSERT_EQUAL(0, writer.error());
+    }
+}
+
+static std::vector<uint8_t> readAll(D64MStream& s, uint32_t chunk)
+{
+    std::vector<uint8_t> out;
+    std::vector<uint8_t> buf(chunk);
+    uint32_t n;
+    while ((n = s.read(buf.data(), chunk)) > 0)
+        out.insert(out.end(), buf.begin(), buf.begin() + n);
+    return out;
+}
+
+// The GCR formats prefetch one sector at a time; their suites skip without
+// fixture images, so drive that path on a plain D64.
+class SectorwiseD64MStream : public D64MStream
+{
+public:
+    using D64MStream::D64MStream;
+protected:
+    bool sectorsAreLinear() override { return false; }
+};
+
+// in|out opens a file without prefetch: the per-sector path every load used
+// to take, kept as the reference.
+static std::ios_base::openmode PER_SECTOR = std::ios_base::in | std::ios_base::out;
+
+// Seeks anywhere in the file land on the right byte: block boundaries,
+// inside the last block, backwards, and refuse past the end.
+static void checkSeeks(D64MStream& s, uint32_t size, uint32_t seed)
+{
+    std::vector<uint8_t> want = pattern(size, seed);
+    const uint32_t offsets[] = { size - 1, 0, 254, 253, 508 + 17, size - 300, 1000, size - (size % 254), 3 };
+    for (uint32_t offset : offsets)
+    {
+        TEST_ASSERT_TRUE(s.seek(offset));
+        TEST_ASSERT_EQUAL_UINT32(offset, s.position());
+        uint8_t buf[300];
+        uint32_t expect = std::min<uint32_t>(sizeof(buf), size - offset);
+        uint32_t got = 0, n;
+        while (got < expect && (n = s.read(buf + got, expect - got)) > 0)
+            got += n;
+        TEST_ASSERT_EQUAL_UINT32(expect, got);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(want.data() + offset, buf, expect);
+    }
+    TEST_ASSERT_FALSE(s.seek(size + 254));
+}
+
+void test_d64_run_read_file_reads_identically(void)
+{
+    buildImage();
+    for (auto mode : { std::ios_base::in, PER_SECTOR })
+    {
+        D64MStream s(std::make_shared<FileContainerStream>(D64_PATH));
+        s.mode = mode;
+        TEST_ASSERT_TRUE(s.seekPath("SMALL"));
+        std::vector<uint8_t> got = readAll(s, 100);
+        TEST_ASSERT_EQUAL_UINT32(SMALL_SIZE, got.size());
+        TEST_ASSERT_TRUE(got == pattern(SMALL_SIZE, 1));
+        TEST_ASSERT_EQUAL_UINT32(SMALL_SIZE, s.size());
+    }
+
+    SectorwiseD64MStream s(std::make_shared<FileContainerStream>(D64_PATH));
+    s.mode = std::ios_base::in;
+    TEST_ASSERT_TRUE(s.seekPath("SMALL"));
+    TEST_ASSERT_TRUE(readAll(s, 100) == pattern(SMALL_SIZE, 1));
+    TEST_ASSERT_EQUAL_UINT32(SMALL_SIZE, s.size());
+    checkSeeks(s, SMALL_SIZE, 1);
+}
+
+void test_d64_seek_within_run_read_file(void)
+{
+    buildImage();
+    D64MStream s(std::make_shared<FileContainerStream>(D64_PATH));
+    s.mode = std::ios_base::in;
+    TEST_ASSERT_TRUE(s.seekPath("SMALL"));
+    checkSeeks(s, SMALL_SIZE, 1);
+}
+
+void test_d64_seek_within_large_file(void)
+{
+    buildImage();
+    for (auto mode : { std::ios_base::in, PER_SECTOR })
+    {
+        D64MStream s(std::make_shared<FileContainerStream>(D64_PATH));
+        s.mode = mode;
+        TEST_ASSERT_TRUE(s.seekPath("BIG"));
+        checkSeeks(s, BIG_SIZE, 2);
+
+        // A whole read after all that seeking is still intact
+        TEST_ASSERT_TRUE(s.seek(0));
+        TEST_ASSERT_TRUE(readAll(s, 254) == pattern(BIG_SIZE, 2));
+    }
+}
+
+// Opening a file reads nothing, and the first read holds one run of
+// sectors, however large the file.
+void test_d64_open_reads_nothing_until_asked(void)
+{
+    buildImage();
+    auto container = std::make_shared<CountingFileStream>(D64_PATH);
+    D64MStream s(container);
+    s.mode = std::ios_base::in;
+    container->reads = 0;
+    TEST_ASSERT_TRUE(s.seekPath("BIG"));
+    uint32_t open_reads = container->reads;
+
+    container->reads = 0;
+    uint8_t head[2];
+    TEST_ASSERT_EQUAL_UINT32(2, s.read(head, 2));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(pattern(BIG_SIZE, 2).data(), head, 2);
+    TEST_ASSERT_EQUAL_UINT32(1, container->reads);
+    TEST_ASSERT_TRUE(s.footprint() < sizeof(D64MStream) + 256 * (D64_PREFETCH_RUN + 1));
+
+    // No more than the per-sector path, which reads only the directory to
+    // open a file: the file's own sectors wait for the read
+    auto per_sector = std::make_shared<CountingFileStream>(D64_PATH);
+    D64MStream probe(per_sector);
+    probe.mode = PER_SECTOR;
+    per_sector->reads = 0;
+    TEST_ASSERT_TRUE(probe.seekPath("BIG"));
+    TEST_ASSERT_EQUAL_UINT32(per_sector->reads, open_reads);
+}
+
+// Once the chain is known a seek to the far end costs a fixed handful of
+// container operations, not one per block on the way.
+void test_d64_seek_does_not_walk_a_known_chain(void)
+{
+    buildImage();
+    auto container = std::make_shared<CountingFileStream>(D64_PATH);
+    D64MStream s(container);
+    s.mode = std::ios_base::in;
+    TEST_ASSERT_TRUE(s.seekPath("BIG"));
+    TEST_ASSERT_TRUE(s.seek(BIG_SIZE - 5));
+    TEST_ASSERT_TRUE(s.seek(0));
+
+    container->reads = 0;
+    container->seeks = 0;
+    TEST_ASSERT_TRUE(s.seek(BIG_SIZE - 5));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(4, container->reads);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(4, container->seeks);
+
+    uint8_t tail[5];
+    TEST_ASSERT_EQUAL_UINT32(5, s.read(tail, 5));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(pattern(BIG_SIZE, 2).data() + BIG_SIZE - 5, tail, 5);
+}
+
+// Benchmark: load a 20-block file the way a LOAD does, per sector and in
+// runs. Container operations are what a network container would turn
+// into requests; the time is host CPU only, with no latency.
+void test_d64_load_throughput_benchmark(void)
+{
+    buildImage();
+    uint32_t ops[2] = { 0, 0 };
+    double ms[2] = { 0, 0 };
+    int i = 0;
+    for (auto mode : { PER_SECTOR, std::ios_base::in })
+    {
+        auto container = std::make_shared<CountingFileStream>(D64_PATH);
+        D64MStream s(container);
+        s.mode = mode;
+        container->reads = 0;
+        container->seeks = 0;
+        auto started = std::chrono::steady_clock::now();
+        const int passes = 200;
+        for (int pass = 0; pass < passes; pass++)
+        {
+            TEST_ASSERT_TRUE(s.seekPath("SMALL"));
+            TEST_ASSERT_EQUAL_UINT32(SMALL_SIZE, readAll(s, 254).size());
+        }
+        ms[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count() / passes;
+        ops[i] = (container->reads + container->seeks) / passes;
+        i++;
+    }
+
+    printf("load %u bytes: per sector %u container ops %.3f ms, in runs %u container ops %.3f ms\n",
+           (unsigned)SMALL_SIZE, ops[0], ms[0], ops[1], ms[1]);
+
+    TEST_ASSERT_TRUE(ops[1] * 4 <= ops[0]);
+}
+
 int main(int, char**)
 {
     UNITY_BEGIN();
@@ -122,5 +370,12 @@ int main(int, char**)
     RUN_TEST(test_failed_relative_seek_leaves_position_unchanged);
     RUN_TEST(test_successful_seek_commits_position);
     RUN_TEST(test_seek_modes_resolve_expected_targets);
+    RUN_TEST(test_d64_run_read_file_reads_identically);
+    RUN_TEST(test_d64_seek_within_run_read_file);
+    RUN_TEST(test_d64_seek_within_large_file);
+    RUN_TEST(test_d64_open_reads_nothing_until_asked);
+    RUN_TEST(test_d64_seek_does_not_walk_a_known_chain);
+    RUN_TEST(test_d64_load_throughput_benchmark);
+    remove(D64_PATH);
     return UNITY_END();
 }
@@ -0,0 +1,30 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// The channel's receive path and the protocol base class it drives, with the
+// Test protocol the firmware ships. The command frame comes from this
+// suite's bus stand-in, which has to be seen before Protocol.h asks for one.
+#include "host/bus.h"
+
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp leaks a bare min(a,b) macro into the rest of this unit.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/network-protocol/network_ring.cpp"
+#include "../../../lib/network-protocol/network_data.cpp"
+#include "../../../lib/network-protocol/Protocol.cpp"
+#include "../../../lib/network-protocol/Test.cpp"
+
+#include <cstdarg>
+#include <cstdio>
+
+// utils.cpp is not built natively; see test_disk_write/native_stubs.cpp
+void util_debug_printf(const char *fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+}
@@ -0,0 +1,426 @@
+// Tests for the network channel receive path (lib/network-protocol/
+// network_ring.h, network_data.h) and the protocol translation tables
+// (Protocol.cpp).
+//
+// The host reads a channel 254 bytes at a time. It used to take each read
+// from the front of a std::string with erase(0, n), moving everything
+// behind it, and a protocol's status() would read all the socket had into
+// that string. The channel now reads through a fixed ring and lets the
+// protocol read only as much as the ring has room for.
+//
+// LegacyChannel below is the old iecNetwork::read()/receive() pair, kept so
+// that the throughput numbers compare the two paths on the same protocol.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "host/bus.h"
+#include "network_data.h"
+#include "Protocol.h"
+#include "Test.h"
+#include "string_utils.h"
+
+// fnjson.h needs cJSON, which native builds don't have. NetworkData only
+// needs FNJSON to be complete to destroy its json member, which these tests
+// never set.
+class FNJSON
+{
+public:
+    virtual ~FNJSON() {}
+};
+
+static const uint8_t IEC_READ = 254;
+
+static uint64_t now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/********************************************************
+ * Protocols
+ ********************************************************/
+
+// A TCP connection's worth of protocol: status() reports what the "socket"
+// holds, read() takes it, as NetworkProtocolTCP does
+class SocketProtocol : public NetworkProtocol
+{
+public:
+    std::string socket;
+    size_t pulled = 0;      // bytes taken off the socket so far
+    uint32_t reads = 0;
+
+    SocketProtocol(std::string *rx, std::string *tx, std::string *sp) : NetworkProtocol(rx, tx, sp) {}
+
+    bool read(unsigned short len) override
+    {
+        if (receiveBuffer->length() == 0)
+        {
+            len = (unsigned short)std::min<size_t>(len, socket.size() - pulled);
+            receiveBuffer->append(socket, pulled, len);
+            pulled += len;
+            reads++;
+        }
+        return NetworkProtocol::read(len);
+    }
+
+    bool status(NetworkStatus *status) override
+    {
+        status->rxBytesWaiting = (uint16_t)std::min<size_t>(socket.size() - pulled, 65535);
+        status->connected = 1;
+        NetworkProtocol::status(status);
+        return false;
+    }
+
+    using NetworkProtocol::translate_receive_buffer;
+    using NetworkProtocol::translate_transmit_buffer;
+};
+
+/********************************************************
+ * Channels
+ ********************************************************/
+
+// iecNetwork::read() and receive() before the ring
+struct LegacyChannel
+{
+    std::string receiveBuffer;
+    NetworkProtocol *protocol = nullptr;
+
+    uint8_t read(uint8_t *buffer, uint8_t bufferSize)
+    {
+        if (receiveBuffer.size() < bufferSize)
+        {
+            NetworkStatus ns;
+            protocol->status(&ns);
+            if (ns.rxBytesWaiting > 0)
+                protocol->read(std::min<uint16_t>(ns.rxBytesWaiting, 2048));
+        }
+
+        uint8_t n = std::min((int)receiveBuffer.size(), (int)bufferSize);
+        memcpy(buffer, receiveBuffer.data(), n);
+        receiveBuffer.erase(0, n);
+        return n;
+    }
+};
+
+// iecNetwork::read() as it is now
+static uint8_t channel_read(NetworkData &data, uint8_t *buffer, uint8_t bufferSize)
+{
+    data.stageReceived();
+    if (data.receiveRing.size() < bufferSize)
+    {
+        NetworkStatus ns;
+        if (!data.receive(ns, 2048))
+            return 0;
+    }
+    return data.receiveRing.read(buffer, bufferSize);
+}
+
+static std::string random_text(size_t size, uint32_t seed)
+{
+    // Heavy on the bytes the translations touch
+    static const uint8_t alphabet[] = { 'a', 'b', ' ', 0x0D, 0x0A, 0x9B, 0x07, 0x08, 0x09, 0x7E, 0x7F, 0xFD, 0xC1 };
+    std::string s(size, '\0');
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        s[i] = (char)alphabet[(seed >> 16) % sizeof(alphabet)];
+    }
+    return s;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/********************************************************
+ * Tests
+ ********************************************************/
+
+void test_ring_keeps_order_across_the_wrap(void)
+{
+    NetworkRing ring(16);
+    TEST_ASSERT_TRUE(ring.empty());
+    TEST_ASSERT_EQUAL(16, ring.space());
+
+    const uint8_t *in = (const uint8_t *)"0123456789abcdefghij";
+    uint8_t out[32];
+
+    TEST_ASSERT_EQUAL(10, ring.write(in, 10));
+    TEST_ASSERT_EQUAL(6, ring.read(out, 6));
+    TEST_ASSERT_EQUAL_MEMORY("012345", out, 6);
+
+    // 12 more only fit by wrapping; 14 fill it and the rest is refused
+    TEST_ASSERT_EQUAL(12, ring.write(in + 8, 12));
+    TEST_ASSERT_EQUAL(16, ring.size());
+    TEST_ASSERT_TRUE(ring.full());
+    TEST_ASSERT_EQUAL(0, ring.write(in, 1));
+
+    // The contiguous front ends at the end of the storage
+    size_t len;
+    const uint8_t *front = ring.front(len);
+    TEST_ASSERT_EQUAL(10, len);
+    TEST_ASSERT_EQUAL_MEMORY("6789", front, 4);
+    ring.consume(4);
+
+    TEST_ASSERT_EQUAL(12, ring.read(out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY("89abcdefghij", out, 12);
+    TEST_ASSERT_TRUE(ring.empty());
+
+    // Emptied, it starts from the front of its storage again
+    ring.write(in, 16);
+    ring.front(len);
+    TEST_ASSERT_EQUAL(16, len);
+}
+
+// Protocol.cpp's translations before the tables: one replace() pass per
+// substitution, then an erase/remove for CRLF. Native builds are neither
+// Atari nor Apple, so EOL is 0x9B and there are no ATASCII substitutions.
+static std::string legacy_receive(std::string s, uint8_t mode)
+{
+    if (mode == 0)
+        return s;
+    switch (mode)
+    {
+    case 1:
+        std::replace(s.begin(), s.end(), '\x0d', '\x9b');
+        break;
+    case 2:
+        std::replace(s.begin(), s.end(), '\x0a', '\x9b');
+        break;
+    case 3:
+        std::replace(s.begin(), s.end(), '\x0d', '\x9b');
+        break;
+    case 4:
+        s = mstr::toUTF8(s);
+        break;
+    }
+    if (mode == 3)
+        s.erase(std::remove(s.begin(), s.end(), '\n'), s.end());
+    return s;
+}
+
+static void replace_all(std::string &s, const std::string &from, const std::string &to)
+{
+    size_t at = 0;
+    while ((at = s.find(from, at)) != std::string::npos)
+    {
+        s.replace(at, from.size(), to);
+        at += to.size();
+    }
+}
+
+static std::string legacy_transmit(std::string s, uint8_t mode)
+{
+    switch (mode)
+    {
+    case 1:
+        replace_all(s, "\x9b", "\x0d");
+        break;
+    case 2:
+        replace_all(s, "\x9b", "\x0a");
+        break;
+    case 3:
+        replace_all(s, "\x9b", "\x0d\x0a");
+        break;
+    case 4:
+        s = mstr::toUTF8(s);
+        break;
+    }
+    return s;
+}
+
+void test_translation_tables_match_the_replace_passes(void)
+{
+    std::string rx, tx, sp;
+    SocketProtocol protocol(&rx, &tx, &sp);
+
+    for (uint8_t mode = 0; mode <= 5; mode++)
+    {
+        protocol.translation_mode = mode;
+        for (uint32_t seed = 1; seed <= 20; seed++)
+        {
+            std::string text = random_text(1 + seed * 37, seed + mode * 100);
+
+            rx = text;
+            protocol.translate_receive_buffer();
+            TEST_ASSERT_TRUE_MESSAGE(rx == legacy_receive(text, mode), "receive");
+
+            tx = text;
+            unsigned short len = protocol.translate_transmit_buffer();
+            std::string expect = legacy_transmit(text, mode);
+            TEST_ASSERT_EQUAL(expect.size(), len);
+            TEST_ASSERT_TRUE_MESSAGE(tx == expect, "transmit");
+        }
+    }
+}
+
+void test_full_ring_stops_reading_the_socket(void)
+{
+    NetworkData data;
+    data.protocol.reset(new SocketProtocol(&data.receiveBuffer, &data.transmitBuffer, &data.specialBuffer));
+    auto *protocol = (SocketProtocol *)data.protocol.get();
+    protocol->socket = random_text(100000, 7);
+    protocol->receiveWindow = data.receiveRing.capacity();
+
+    // The host is not reading; status polls and receives keep coming
+    NetworkStatus ns;
+    for (int i = 0; i < 50; i++)
+    {
+        protocol->status(&ns);
+        TEST_ASSERT_TRUE(data.receive(ns, 2048));
+    }
+    TEST_ASSERT_TRUE(data.receiveRing.full());
+    TEST_ASSERT_EQUAL(data.receiveRing.capacity(), protocol->pulled);
+    TEST_ASSERT_EQUAL(0, data.receiveBuffer.size());
+
+    // Reading 1000 makes room for no more than 1000
+    uint8_t buf[1000];
+    TEST_ASSERT_EQUAL(1000, data.receiveRing.read(buf, sizeof(buf)));
+    TEST_ASSERT_TRUE(data.receive(ns, 2048));
+    protocol->status(&ns);
+    TEST_ASSERT_EQUAL(data.receiveRing.capacity() + 1000, protocol->pulled);
+
+    // And everything arrives, in order
+    std::string got((char *)buf, sizeof(buf));
+    uint8_t chunk[IEC_READ];
+    uint8_t n;
+    while ((n = channel_read(data, chunk, IEC_READ)) > 0)
+        got.append((char *)chunk, n);
+    TEST_ASSERT_TRUE(got == protocol->socket);
+}
+
+void test_receive_stages_query_results_and_unstages_for_rework(void)
+{
+    NetworkData data;
+    data.receiveBuffer = "query result";
+    TEST_ASSERT_EQUAL(12, data.stageReceived());
+    TEST_ASSERT_EQUAL(12, data.received());
+
+    uint8_t buf[6];
+    data.receiveRing.read(buf, 6);
+    data.receiveBuffer = "+more";
+    data.unstageReceived();
+    TEST_ASSERT_EQUAL_STRING("result+more", data.receiveBuffer.c_str());
+    TEST_ASSERT_TRUE(data.receiveRing.empty());
+
+    data.clearReceived();
+    TEST_ASSERT_EQUAL(0, data.received());
+}
+
+// Sustained N: throughput with the firmware's Test protocol, which hands
+// over one ~100 byte line per read
+void test_throughput_with_test_protocol(void)
+{
+    const size_t total = 4 * 1024 * 1024;
+    cmdFrame_t frame = {};
+    frame.aux1 = 12;
+    frame.aux2 = 1;     // CR translation
+
+    NetworkData data;
+    data.protocol.reset(new NetworkProtocolTest(&data.receiveBuffer, &data.transmitBuffer, &data.specialBuffer));
+    data.protocol->open(nullptr, &frame);
+    data.protocol->receiveWindow = data.receiveRing.capacity();
+
+    LegacyChannel legacy;
+    std::string legacy_tx, legacy_sp;
+    NetworkProtocolTest legacy_protocol(&legacy.receiveBuffer, &legacy_tx, &legacy_sp);
+    legacy_protocol.open(nullptr, &frame);
+    legacy.protocol = &legacy_protocol;
+
+    uint8_t chunk[IEC_READ];
+    std::string first_ring, first_legacy;
+
+    uint64_t started = now_us();
+    size_t got = 0;
+    while (got < total)
+    {
+        uint8_t n = channel_read(data, chunk, IEC_READ);
+        TEST_ASSERT_TRUE(n > 0);
+        if (first_ring.size() < 1000)
+            first_ring.append((char *)chunk, n);
+        got += n;
+    }
+    uint64_t ring_us = now_us() - started;
+
+    started = now_us();
+    got = 0;
+    while (got < total)
+    {
+        uint8_t n = legacy.read(chunk, IEC_READ);
+        TEST_ASSERT_TRUE(n > 0);
+        if (first_legacy.size() < 1000)
+            first_legacy.append((char *)chunk, n);
+        got += n;
+    }
+    uint64_t legacy_us = now_us() - started;
+
+    TEST_ASSERT_TRUE(first_ring == first_legacy);
+    printf("Test protocol, 4 MB in %u byte reads: ring %.1f MB/s, string erase %.1f MB/s\n", IEC_READ,
+           total / (double)ring_us, total / (double)legacy_us);
+}
+
+// A protocol with a lot waiting: the old path took all of it into the
+// string, and every host read then moved what was left behind it
+void test_throughput_with_a_full_socket(void)
+{
+    const size_t total = 16 * 1024 * 1024;
+    std::string stream = random_text(total, 11);
+
+    NetworkData data;
+    data.protocol.reset(new SocketProtocol(&data.receiveBuffer, &data.transmitBuffer, &data.specialBuffer));
+    auto *protocol = (SocketProtocol *)data.protocol.get();
+    protocol->socket = stream;
+    protocol->receiveWindow = data.receiveRing.capacity();
+
+    LegacyChannel legacy;
+    std::string legacy_tx, legacy_sp;
+    SocketProtocol legacy_protocol(&legacy.receiveBuffer, &legacy_tx, &legacy_sp);
+    legacy_protocol.socket = stream;
+    legacy.protocol = &legacy_protocol;
+
+    std::vector<uint8_t> out(total);
+    uint8_t n;
+
+    uint64_t started = now_us();
+    size_t got = 0;
+    while ((n = channel_read(data, out.data() + got, IEC_READ)) > 0)
+        got += n;
+    uint64_t ring_us = now_us() - started;
+    TEST_ASSERT_EQUAL(total, got);
+    TEST_ASSERT_EQUAL_MEMORY(stream.data(), out.data(), total);
+
+    started = now_us();
+    got = 0;
+    while ((n = legacy.read(out.data() + got, IEC_READ)) > 0)
+        got += n;
+    uint64_t legacy_us = now_us() - started;
+    TEST_ASSERT_EQUAL(total, got);
+    TEST_ASSERT_EQUAL_MEMORY(stream.data(), out.data(), total);
+
+    printf("64 KB waiting, 16 MB in %u byte reads: ring %.1f MB/s, string erase %.1f MB/s\n", IEC_READ,
+           total / (double)ring_us, total / (double)legacy_us);
+    TEST_ASSERT_TRUE(ring_us < legacy_us);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_ring_keeps_order_across_the_wrap);
+    RUN_TEST(test_translation_tables_match_the_replace_passes);
+    RUN_TEST(test_full_ring_stops_reading_the_socket);
+    RUN_TEST(test_receive_stages_query_results_and_unstages_for_rework);
+    RUN_TEST(test_throughput_with_test_protocol);
+    RUN_TEST(test_throughput_with_a_full_socket);
+    return UNITY_END();
+}
+
+int main(int argc, char** argv)
+{
+    return runUnityTests();
+}
@@ -0,0 +1,340 @@
+// Tests for MPathResolver (lib/meatloaf/meat_resolve.h), the memoized path
+// resolution behind MFSOwner::File().
+//
+// File() used to run the whole resolution on every call: split the path, ask
+// every filesystem in availableFS whether it handles each segment, right to
+// left, and again for the container part of a nested path. The resolver has
+// to give exactly the answers that scan gave - same filesystem, same split -
+// while asking handles() only the first time. The reference below is the old
+// scan, kept verbatim in shape, and every resolution is checked against it.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "meatloaf.h"
+#include "meat_resolve.h"
+#include "string_utils.h"
+
+// A filesystem that claims a scheme or a list of extensions and counts how
+// often it is asked.
+class StandInFS : public MFileSystem
+{
+public:
+    StandInFS(const char* symbol, std::vector<std::string> ext, const char* scheme = nullptr)
+        : MFileSystem(symbol), _ext(ext), _scheme(scheme) {}
+
+    bool handles(std::string name) override
+    {
+        asked++;
+        if (_scheme != nullptr)
+            return mstr::equals(name, (char*)_scheme, false);
+        return byExtension(_ext, name);
+    }
+
+    MFile* getFile(std::string path) override
+    {
+        (void)path;
+        return nullptr;
+    }
+
+    uint32_t asked = 0;
+
+private:
+    std::vector<std::string> _ext;
+    const char* _scheme;
+};
+
+class DefaultFS : public MFileSystem
+{
+public:
+    DefaultFS() : MFileSystem("flash") { isRootFS = true; }
+    bool handles(std::string name) override { (void)name; return true; }
+    MFile* getFile(std::string path) override { (void)path; return nullptr; }
+};
+
+static DefaultFS flashFS;
+static StandInFS zipFS("zip", { ".zip", ".7z" });
+static StandInFS d64FS("d64", { ".d64", ".d41" });
+static StandInFS g64FS("g64", { ".g64" });
+static StandInFS t64FS("t64", { ".t64" });
+static StandInFS httpFS("http", {}, "http:");
+static StandInFS ftpFS("ftp", {}, "ftp:");
+
+static std::vector<MFileSystem*> filesystems {
+    &flashFS, &zipFS, &d64FS, &g64FS, &t64FS, &httpFS, &ftpFS
+};
+
+static uint32_t asked()
+{
+    return zipFS.asked + d64FS.asked + g64FS.asked + t64FS.asked + httpFS.asked + ftpFS.asked;
+}
+
+// The scan MFSOwner::findParentFS() did before the resolver.
+static MFileSystem* referenceParentFS(std::vector<std::string>::iterator& begin,
+                                      std::vector<std::string>::iterator& pathIterator,
+                                      bool use_vdrive)
+{
+    while (pathIterator != begin)
+    {
+        pathIterator--;
+
+        auto part = *pathIterator;
+        mstr::toLower(part);
+        if (part.size())
+        {
+            auto foundFS = std::find_if(filesystems.begin() + 1, filesystems.end(), [&](MFileSystem* fs) {
+                if (!fs->handles(part))
+                    return false;
+                return !(use_vdrive && fs->vdrive_compatible);
+            });
+
+            if (foundFS != filesystems.end())
+            {
+                pathIterator++;
+                return (*foundFS);
+            }
+        }
+    }
+
+    pathIterator++;
+    return filesystems.front();
+}
+
+// The split MFSOwner::File() did before the resolver.
+static MResolvedPath referenceResolve(const std::string& path, bool use_vdrive)
+{
+    MResolvedPath r;
+
+    std::vector<std::string> paths = mstr::split(path, '/');
+    auto pathIterator = paths.end();
+    auto begin = paths.begin();
+    auto end = paths.end();
+
+    r.target_fs = referenceParentFS(begin, pathIterator, use_vdrive);
+    r.target_path = mstr::joinToString(&begin, &pathIterator, "/");
+    r.target_in_stream = mstr::joinToString(&pathIterator, &end, "/");
+
+    end = pathIterator;
+    pathIterator--;
+
+    if (begin == pathIterator)
+    {
+        r.target_path = path;
+        r.target_in_stream.clear();
+        return r;
+    }
+
+    r.nested = true;
+    r.source_path = mstr::joinToString(&begin, &pathIterator, "/");
+    r.source_in_stream = mstr::joinToString(&pathIterator, &end, "/");
+    r.source_fs = referenceParentFS(begin, pathIterator, use_vdrive);
+    return r;
+}
+
+static void assertSame(const MResolvedPath& expected, const MResolvedPath& got, const std::string& path)
+{
+    const char* m = path.c_str();
+    TEST_ASSERT_TRUE_MESSAGE(expected.target_fs == got.target_fs, m);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.target_path.c_str(), got.target_path.c_str(), m);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.target_in_stream.c_str(), got.target_in_stream.c_str(), m);
+    TEST_ASSERT_EQUAL_MESSAGE(expected.nested, got.nested, m);
+    TEST_ASSERT_TRUE_MESSAGE(expected.source_fs == got.source_fs, m);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.source_path.c_str(), got.source_path.c_str(), m);
+    TEST_ASSERT_EQUAL_STRING_MESSAGE(expected.source_in_stream.c_str(), got.source_in_stream.c_str(), m);
+}
+
+static const char* PATHS[] = {
+    "http://host/a.zip/b.d64/file",
+    "http://host/games/GAME.D64",
+    "http://host/games/game.d64/prg",
+    "/sd/disks/demo.g64",
+    "/sd/disks/demo.g64/intro",
+    "/sd/tapes/pack.zip/one.t64/loader",
+    "/sd/.hidden.d64/x",
+    "/sd/noext/file",
+    "ftp://mirror/pub/c64/a.7z/b.d41/c",
+    "/",
+    "file",
+};
+
+void setUp(void) {}
+void tearDown(void) {}
+
+
+// Every path, twice each (miss then hit) and under both vdrive settings,
+// resolves exactly as the old scan did.
+void test_resolution_matches_the_linear_scan(void)
+{
+    MPathResolver resolver(filesystems);
+
+    d64FS.vdrive_compatible = true;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (bool vdrive : { false, true })
+        {
+            for (const char* p : PATHS)
+                assertSame(referenceResolve(p, vdrive), resolver.resolve(p, vdrive), p);
+        }
+    }
+    d64FS.vdrive_compatible = false;
+}
+
+// The point of the cache: a path resolved once is not scanned again, and a
+// new path with a known extension costs no handles() calls either.
+void test_repeat_resolution_asks_no_filesystem(void)
+{
+    MPathResolver resolver(filesystems);
+
+    resolver.resolve("http://host/a.zip/b.d64/file", false);
+    uint32_t first = asked();
+    TEST_ASSERT_TRUE(first > 0);
+
+    resolver.resolve("http://host/a.zip/b.d64/file", false);
+    TEST_ASSERT_EQUAL_UINT32(first, asked());
+    TEST_ASSERT_EQUAL_UINT32(1, resolver.hits);
+
+    // Different names, same scheme and extensions: the segment table answers.
+    // Only "other" - a bare name never seen before - is scanned.
+    uint32_t before = asked();
+    resolver.resolve("http://host/c.zip/d.d64/other", false);
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)(filesystems.size() - 1), asked() - before);
+}
+
+// With vdrive in use a vdrive compatible filesystem must not claim its
+// images, and the segment table has to keep the two answers apart.
+void test_vdrive_setting_is_part_of_the_key(void)
+{
+    MPathResolver resolver(filesystems);
+    d64FS.vdrive_compatible = true;
+
+    auto plain = resolver.resolve("/sd/game.d64/prg", false);
+    auto vdrive = resolver.resolve("/sd/game.d64/prg", true);
+
+    TEST_ASSERT_TRUE(plain.target_fs == &d64FS);
+    TEST_ASSERT_TRUE(vdrive.target_fs == &flashFS);
+    TEST_ASSERT_FALSE(vdrive.nested);
+
+    d64FS.vdrive_compatible = false;
+}
+
+// The LRU is bounded, and clear() - what mount/umount and a .config edit
+// call - forgets everything.
+void test_cache_is_bounded_and_cleared(void)
+{
+    MPathResolver resolver(filesystems, 4);
+
+    for (int i = 0; i < 20; i++)
+        resolver.resolve("/sd/dir" + std::to_string(i) + "/x.d64/f", false);
+    TEST_ASSERT_EQUAL_UINT32(4, (uint32_t)resolver.size());
+
+    // The four most recent survive.
+    uint32_t hits = resolver.hits;
+    resolver.resolve("/sd/dir19/x.d64/f", false);
+    TEST_ASSERT_EQUAL_UINT32(hits + 1, resolver.hits);
+    resolver.resolve("/sd/dir0/x.d64/f", false);
+    TEST_ASSERT_EQUAL_UINT32(hits + 1, resolver.hits);
+
+    resolver.clear();
+    TEST_ASSERT_EQUAL_UINT32(0, (uint32_t)resolver.size());
+}
+
+// While a disk image registry probes raw bytes its filesystem declines every
+// path, and nothing learned then may be remembered.
+void test_suspended_resolver_neither_reads_nor_writes(void)
+{
+    MPathResolver resolver(filesystems);
+    resolver.resolve("/sd/a.d64/f", false);
+
+    resolver.suspend();
+    uint32_t before = asked();
+    resolver.resolve("/sd/a.d64/f", false);
+    TEST_ASSERT_TRUE(asked() > before);
+    resolver.resolve("/sd/b.t64/f", false);
+    resolver.resume();
+
+    // Still only the path resolved before the suspension.
+    TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)resolver.size());
+    TEST_ASSERT_EQUAL_UINT32(0, resolver.hits);
+}
+
+// The .config redirect rides along with a cached resolution and expires on
+// the same TTL as the config cache.
+void test_redirect_is_memoized_until_the_ttl(void)
+{
+    MPathResolver resolver(filesystems);
+    std::string url;
+
+    // Nothing to attach to before the path is resolved.
+    resolver.setRedirect("/sd/zimmers.net/bin", false, 1000, "http://zimmers.net/bin");
+    TEST_ASSERT_FALSE(resolver.redirect("/sd/zimmers.net/bin", false, 1000, &url));
+
+    resolver.resolve("/sd/zimmers.net/bin", false);
+    TEST_ASSERT_FALSE(resolver.redirect("/sd/zimmers.net/bin", false, 1000, &url));
+
+    resolver.setRedirect("/sd/zimmers.net/bin", false, 1000, "http://zimmers.net/bin");
+    TEST_ASSERT_TRUE(resolver.redirect("/sd/zimmers.net/bin", false, 1000 + MFS_RESOLVE_REDIRECT_TTL_MS - 1, &url));
+    TEST_ASSERT_EQUAL_STRING("http://zimmers.net/bin", url.c_str());
+
+    TEST_ASSERT_FALSE(resolver.redirect("/sd/zimmers.net/bin", false, 1000 + MFS_RESOLVE_REDIRECT_TTL_MS, &url));
+
+    // "No redirect" is an answer too.
+    resolver.setRedirect("/sd/zimmers.net/bin", false, 50000, "");
+    TEST_ASSERT_TRUE(resolver.redirect("/sd/zimmers.net/bin", false, 50001, &url));
+    TEST_ASSERT_TRUE(url.empty());
+}
+
+// Microbenchmark: the same deep path resolved 10k times, the way repeated
+// ImageBroker::obtain() calls and a PROPFIND over one image resolve it. The
+// timings are printed for comparison; the handles() counts are asserted.
+void test_benchmark_deep_path(void)
+{
+    const std::string path = "http://host/a.zip/b.d64/file";
+    const int rounds = 10000;
+
+    uint32_t before = asked();
+    auto started = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+        referenceResolve(path, false);
+    double scan_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count();
+    uint32_t scan_asked = asked() - before;
+
+    MPathResolver resolver(filesystems);
+    before = asked();
+    started = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++)
+        resolver.resolve(path, false);
+    double cached_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count();
+    uint32_t cached_asked = asked() - before;
+
+    printf("resolve x%d [%s]: scan %.2f ms (%lu handles() calls), cached %.2f ms (%lu)\n",
+           rounds, path.c_str(), scan_ms, (unsigned long)scan_asked,
+           cached_ms, (unsigned long)cached_asked);
+
+    // One resolution's worth of scanning, then nothing.
+    TEST_ASSERT_EQUAL_UINT32(scan_asked / rounds, cached_asked);
+    TEST_ASSERT_EQUAL_UINT32(rounds - 1, resolver.hits);
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc; (void)argv;
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_resolution_matches_the_linear_scan);
+    RUN_TEST(test_repeat_resolution_asks_no_filesystem);
+    RUN_TEST(test_vdrive_setting_is_part_of_the_key);
+    RUN_TEST(test_cache_is_bounded_and_cleared);
+    RUN_TEST(test_suspended_resolver_neither_reads_nor_writes);
+    RUN_TEST(test_redirect_is_memoized_until_the_ttl);
+    RUN_TEST(test_benchmark_deep_path);
+
+    return UNITY_END();
+}
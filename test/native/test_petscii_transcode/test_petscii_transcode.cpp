@@ -0,0 +1,286 @@
+// Tests for the table-driven PETSCII <-> UTF-8 conversion in U8Char
+// (lib/utils/U8Char.cpp) and the mstr::toUTF8() / toPETSCII2() built on it.
+//
+// The reference is the conversion it replaced, kept here: a U8Char per
+// character, and toPetscii() as a scan of the 256 entry table for the first
+// code that maps to the code point. The generated tables must agree with it
+// for every code point, and the bulk routines for any input.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "U8Char.h"
+#include "string_utils.h"
+
+/********************************************************
+ * Reference: the per-character conversion
+ ********************************************************/
+
+static uint8_t ref_toPetscii(char16_t ch)
+{
+    for (size_t i = 0; i < 256; ++i)
+    {
+        if (U8Char::petsciiToUnicode((uint8_t)i) == ch)
+            return (uint8_t)i;
+    }
+    return '?';
+}
+
+static std::string ref_toUTF8(const std::string &petsciiInput)
+{
+    std::string utf8string;
+    for (size_t i = 0; i < petsciiInput.size(); ++i)
+    {
+        uint8_t petscii = static_cast<uint8_t>(petsciiInput[i]);
+        if (petscii != 0)
+        {
+            U8Char u8char(static_cast<char>(petscii));
+            utf8string += u8char.toUtf8();
+        }
+    }
+    return utf8string;
+}
+
+// Only for input that ends on a whole sequence: fromCharArray() reads past
+// a truncated one
+static std::string ref_toPETSCII2(const std::string &utfInputString)
+{
+    std::string petsciiString;
+    char *utfInput = (char *)utfInputString.c_str();
+    auto end = utfInput + utfInputString.length();
+
+    while (utfInput < end)
+    {
+        U8Char u8char(' ');
+        size_t skip = u8char.fromCharArray(utfInput);
+        petsciiString += (char)ref_toPetscii(u8char.ch);
+        utfInput += skip;
+    }
+    return petsciiString;
+}
+
+/********************************************************
+ * Input
+ ********************************************************/
+
+static uint32_t s_seed = 1;
+
+static uint32_t next_random()
+{
+    s_seed = s_seed * 1103515245 + 12345;
+    return (s_seed >> 8) & 0xFFFFFF;
+}
+
+static std::string encode_utf8(char16_t ch)
+{
+    return U8Char((uint16_t)ch).toUtf8();
+}
+
+// Code points a name might hold: the ones PETSCII has, others it has not,
+// and now and then a stray continuation byte. Never a lead byte on its
+// own, which could end the input on a truncated sequence.
+static std::string random_utf8(size_t chars)
+{
+    std::string s;
+    for (size_t i = 0; i < chars; i++)
+    {
+        switch (next_random() % 6)
+        {
+        case 0:
+        case 1:
+            s += (char)(0x20 + next_random() % 0x5f);
+            break;
+        case 2:
+            s += encode_utf8(U8Char::petsciiToUnicode((uint8_t)(1 + next_random() % 255)));
+            break;
+        case 3:
+            s += encode_utf8((char16_t)(0x80 + next_random() % 0x780));
+            break;
+        case 4:
+            s += encode_utf8((char16_t)(0x800 + next_random() % 0xf000));
+            break;
+        case 5:
+            s += (char)(0x80 + next_random() % 0x40);
+            break;
+        }
+    }
+    return s;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+/********************************************************
+ * Tests
+ ********************************************************/
+
+void test_reverse_table_matches_linear_scan_for_every_code_point(void)
+{
+    uint32_t mapped = 0;
+    for (uint32_t cp = 0; cp <= 0xFFFF; cp++)
+    {
+        uint8_t expected = ref_toPetscii((char16_t)cp);
+        uint8_t got = U8Char::unicodeToPetscii((char16_t)cp);
+        if (expected != got)
+        {
+            char message[48];
+            snprintf(message, sizeof(message), "U+%04X", cp);
+            TEST_FAIL_MESSAGE(message);
+        }
+        if (expected != '?')
+            mapped++;
+        TEST_ASSERT_EQUAL_UINT8(expected, U8Char((uint16_t)cp).toPetscii());
+    }
+
+    // Every PETSCII code has its own code point, '?' included
+    TEST_ASSERT_EQUAL_UINT32(255, mapped);
+}
+
+void test_every_petscii_code_round_trips(void)
+{
+    for (int c = 1; c < 256; c++)
+    {
+        std::string petscii(1, (char)c);
+        std::string utf8 = mstr::toUTF8(petscii);
+        TEST_ASSERT_EQUAL_STRING(ref_toUTF8(petscii).c_str(), utf8.c_str());
+        TEST_ASSERT_TRUE(utf8.size() >= 1 && utf8.size() <= U8Char::UTF8_PER_PETSCII);
+
+        std::string back = mstr::toPETSCII2(utf8);
+        TEST_ASSERT_EQUAL_UINT32(1, back.size());
+        TEST_ASSERT_EQUAL_UINT8(c, (uint8_t)back[0]);
+    }
+
+    // NUL is dropped on the way to UTF-8, as it always was
+    TEST_ASSERT_EQUAL_STRING("ab", mstr::toUTF8(std::string("\x41\0\x42", 3)).c_str());
+}
+
+void test_bulk_conversion_matches_reference(void)
+{
+    for (int round = 0; round < 2000; round++)
+    {
+        std::string petscii;
+        size_t len = next_random() % 40;
+        for (size_t i = 0; i < len; i++)
+            petscii += (char)(next_random() & 0xFF);
+        TEST_ASSERT_TRUE(ref_toUTF8(petscii) == mstr::toUTF8(petscii));
+
+        std::string utf8 = random_utf8(next_random() % 40);
+        TEST_ASSERT_TRUE(ref_toPETSCII2(utf8) == mstr::toPETSCII2(utf8));
+    }
+
+    // Plain ASCII takes the fast path: case is swapped as before
+    TEST_ASSERT_EQUAL_STRING("\x48\x45\x4c\x4c\x4f\xd7\x4f\x52\x4c\x44 64", mstr::toPETSCII2("helloWorld 64").c_str());
+}
+
+void test_bulk_conversion_stops_on_a_whole_character(void)
+{
+    // $41 is one UTF-8 byte, $B0 three
+    const uint8_t petscii[] = { 0x41, 0xb0, 0x42 };
+    char out[8];
+    size_t consumed = 99;
+
+    TEST_ASSERT_EQUAL_UINT32(1, U8Char::petsciiToUtf8(petscii, 3, out, 3, &consumed));
+    TEST_ASSERT_EQUAL_UINT32(1, consumed);
+    TEST_ASSERT_EQUAL_UINT32(4, U8Char::petsciiToUtf8(petscii, 3, out, 4, &consumed));
+    TEST_ASSERT_EQUAL_UINT32(2, consumed);
+    TEST_ASSERT_EQUAL_UINT32(5, U8Char::petsciiToUtf8(petscii, 3, out, sizeof(out), &consumed));
+    TEST_ASSERT_EQUAL_UINT32(3, consumed);
+    TEST_ASSERT_EQUAL_MEMORY("a\xe2\x94\x8c" "b", out, 5);
+
+    // One PETSCII byte per sequence, whatever its length
+    uint8_t back[8];
+    TEST_ASSERT_EQUAL_UINT32(2, U8Char::utf8ToPetscii(out, 5, back, 2, &consumed));
+    TEST_ASSERT_EQUAL_UINT32(4, consumed);
+    TEST_ASSERT_EQUAL_MEMORY(petscii, back, 2);
+
+    // A sequence cut short by the end of the input reads its missing bytes
+    // as 0, and is consumed whole
+    TEST_ASSERT_EQUAL_UINT32(2, U8Char::utf8ToPetscii("a\xe2\x94", 3, back, sizeof(back), &consumed));
+    TEST_ASSERT_EQUAL_UINT32(3, consumed);
+    TEST_ASSERT_EQUAL_UINT8(U8Char::unicodeToPetscii(0x2500), back[1]);
+}
+
+// A 10,000 entry directory, each name converted to UTF-8 as the media
+// layer lists it and back to PETSCII as the listing is sent
+void test_directory_transcode_benchmark(void)
+{
+    const size_t ENTRIES = 10000;
+    std::vector<std::string> names;
+    for (size_t i = 0; i < ENTRIES; i++)
+    {
+        std::string name;
+        for (int c = 0; c < 16; c++)
+        {
+            uint32_t r = next_random() % 8;
+            if (r < 5)
+                name += (char)(0x41 + next_random() % 26);     // letters
+            else if (r < 7)
+                name += (char)(0x20 + next_random() % 32);     // digits, punctuation
+            else
+                name += (char)(0xa0 + next_random() % 96);     // graphics, shifted
+        }
+        names.push_back(name);
+    }
+
+    std::vector<std::string> ref_utf8(ENTRIES), ref_back(ENTRIES);
+    auto started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ENTRIES; i++)
+    {
+        ref_utf8[i] = ref_toUTF8(names[i]);
+        ref_back[i] = ref_toPETSCII2(ref_utf8[i]);
+    }
+    double before = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    std::vector<std::string> utf8(ENTRIES), back(ENTRIES);
+    started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ENTRIES; i++)
+    {
+        utf8[i] = mstr::toUTF8(names[i]);
+        back[i] = mstr::toPETSCII2(utf8[i]);
+    }
+    double after = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    // And into one buffer, as a listing would
+    std::vector<uint8_t> listing(ENTRIES * 16);
+    char scratch[16 * U8Char::UTF8_PER_PETSCII];
+    started = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ENTRIES; i++)
+    {
+        size_t n = U8Char::petsciiToUtf8((const uint8_t *)names[i].data(), 16, scratch, sizeof(scratch));
+        U8Char::utf8ToPetscii(scratch, n, &listing[i * 16], 16);
+    }
+    double spans = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    printf("%u entries both ways: per character %.2f ms, tables %.2f ms, into buffers %.2f ms\n",
+           (unsigned)ENTRIES, before * 1000, after * 1000, spans * 1000);
+
+    for (size_t i = 0; i < ENTRIES; i++)
+    {
+        TEST_ASSERT_TRUE(ref_utf8[i] == utf8[i]);
+        TEST_ASSERT_TRUE(ref_back[i] == back[i]);
+        TEST_ASSERT_TRUE(names[i] == back[i]);
+        TEST_ASSERT_EQUAL_MEMORY(names[i].data(), &listing[i * 16], 16);
+    }
+    TEST_ASSERT_TRUE(after < before);
+}
+
+int runUnityTests(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_reverse_table_matches_linear_scan_for_every_code_point);
+    RUN_TEST(test_every_petscii_code_round_trips);
+    RUN_TEST(test_bulk_conversion_matches_reference);
+    RUN_TEST(test_bulk_conversion_stops_on_a_whole_character);
+    RUN_TEST(test_directory_transcode_benchmark);
+    return UNITY_END();
+}
+
+int main(int argc, char **argv)
+{
+    return runUnityTests();
+}
@@ -0,0 +1,5 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO. zlib is
+// built by test/native/test_archive_extract/host/build_libarchive.py.
+#include "../../../lib/printer-emulator/png_writer.cpp"
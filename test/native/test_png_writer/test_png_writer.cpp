@@ -0,0 +1,333 @@
+// Tests for PngWriter (lib/printer-emulator/png_writer.cpp): whatever goes
+// in must come back out of a plain PNG decode - chunk CRCs, one zlib stream
+// across the IDAT chunks, the five filter types undone - and printer pages
+// must come out far smaller than the stored blocks pngPrinter used to write.
+
+#include <unity.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "../../../lib/printer-emulator/png_writer.h"
+
+static const char* PNG = "test_png_writer.png";
+
+struct Decoded
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t bit_depth = 0;
+    uint8_t color_type = 0;
+    std::vector<uint8_t> palette;
+    std::vector<std::vector<uint8_t>> rows;  // one byte per pixel
+    std::vector<uint32_t> idat_sizes;
+    bool iend = false;
+};
+
+static std::vector<uint8_t> readFile(const char* path)
+{
+    std::vector<uint8_t> data;
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return data;
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return (pb <= pc) ? b : c;
+}
+
+// A minimal decoder, independent of the writer
+static Decoded decode(const char* path)
+{
+    Decoded d;
+    std::vector<uint8_t> file = readFile(path);
+    const uint8_t sig[] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    TEST_ASSERT_TRUE(file.size() > 8);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(sig, file.data(), 8);
+
+    std::vector<uint8_t> zdata;
+    size_t pos = 8;
+    while (pos + 12 <= file.size() && !d.iend) {
+        uint32_t len = get32(&file[pos]);
+        TEST_ASSERT_TRUE(pos + 12 + len <= file.size());
+        std::string type((const char*)&file[pos + 4], 4);
+        const uint8_t* data = &file[pos + 8];
+        uint32_t crc = (uint32_t)crc32(0, &file[pos + 4], len + 4);
+        TEST_ASSERT_EQUAL_HEX32(crc, get32(&file[pos + 8 + len]));
+
+        if (type == "IHDR") {
+            d.width = get32(data);
+            d.height = get32(data + 4);
+            d.bit_depth = data[8];
+            d.color_type = data[9];
+        } else if (type == "PLTE") {
+            d.palette.assign(data, data + len);
+        } else if (type == "IDAT") {
+            zdata.insert(zdata.end(), data, data + len);
+            d.idat_sizes.push_back(len);
+        } else if (type == "IEND") {
+            d.iend = true;
+        }
+        pos += 12 + len;
+    }
+    TEST_ASSERT_EQUAL(file.size(), pos);
+
+    uint32_t stride = (d.width * d.bit_depth + 7) / 8;
+    std::vector<uint8_t> raw((stride + 1) * d.height);
+    uLongf raw_len = raw.size();
+    TEST_ASSERT_EQUAL(Z_OK, uncompress(raw.data(), &raw_len, zdata.data(), zdata.size()));
+    TEST_ASSERT_EQUAL(raw.size(), raw_len);
+
+    std::vector<uint8_t> prev(stride, 0), cur(stride);
+    for (uint32_t y = 0; y < d.height; y++) {
+        const uint8_t* line = &raw[y * (stride + 1)];
+        uint8_t filter = line[0];
+        TEST_ASSERT_TRUE(filter <= 4);
+        for (uint32_t i = 0; i < stride; i++) {
+            int a = i ? cur[i - 1] : 0, b = prev[i], c = i ? prev[i - 1] : 0;
+            int pred[] = { 0, a, b, (a + b) / 2, paeth(a, b, c) };
+            cur[i] = (uint8_t)(line[1 + i] + pred[filter]);
+        }
+        std::vector<uint8_t> pixels(d.width);
+        for (uint32_t x = 0; x < d.width; x++) {
+            uint32_t bit = x * d.bit_depth;
+            pixels[x] = (uint8_t)((cur[bit / 8] >> (8 - d.bit_depth - bit % 8)) & ((1u << d.bit_depth) - 1));
+        }
+        d.rows.push_back(pixels);
+        prev = cur;
+    }
+    return d;
+}
+
+static std::vector<std::vector<uint8_t>> pattern(uint32_t width, uint32_t height, uint8_t bit_depth)
+{
+    std::vector<std::vector<uint8_t>> rows(height, std::vector<uint8_t>(width));
+    uint32_t seed = 12345;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            seed = seed * 1103515245 + 12345;
+            // noise, runs and repeated lines all in one image
+            if (y % 7 == 3)
+                rows[y][x] = rows[y - 1][x];
+            else if (y % 3 == 0)
+                rows[y][x] = (uint8_t)((x / 5) & ((1u << bit_depth) - 1));
+            else
+                rows[y][x] = (uint8_t)((seed >> 16) & ((1u << bit_depth) - 1));
+        }
+    }
+    return rows;
+}
+
+static void roundTrip(uint32_t width, uint32_t height, uint8_t bit_depth, bool with_palette)
+{
+    std::vector<uint8_t> palette;
+    uint16_t colors = 1u << bit_depth;
+    for (uint16_t i = 0; i < colors; i++) {
+        palette.push_back((uint8_t)i);
+        palette.push_back((uint8_t)(i * 3));
+        palette.push_back((uint8_t)(255 - i));
+    }
+    auto rows = pattern(width, height, bit_depth);
+
+    FILE* f = fopen(PNG, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    PngWriter w;
+    TEST_ASSERT_TRUE(w.begin(f, width, height, bit_depth, with_palette ? palette.data() : nullptr, colors));
+    for (auto& row : rows)
+        TEST_ASSERT_TRUE(w.addRow(f, row.data()));
+    TEST_ASSERT_TRUE(w.end(f));
+    fclose(f);
+
+    Decoded d = decode(PNG);
+    TEST_ASSERT_TRUE(d.iend);
+    TEST_ASSERT_EQUAL_UINT32(width, d.width);
+    TEST_ASSERT_EQUAL_UINT32(height, d.height);
+    TEST_ASSERT_EQUAL_UINT8(bit_depth, d.bit_depth);
+    TEST_ASSERT_EQUAL_UINT8(with_palette ? 3 : 0, d.color_type);
+    if (with_palette)
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(palette.data(), d.palette.data(), palette.size());
+    else
+        TEST_ASSERT_EQUAL(0, d.palette.size());
+    for (uint32_t y = 0; y < height; y++)
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(rows[y].data(), d.rows[y].data(), width);
+}
+
+void setUp(void) { remove(PNG); }
+void tearDown(void) { remove(PNG); }
+
+// pngPrinter's format: 320x192, 8-bit palette indices
+void test_palette_8bit_round_trip(void)
+{
+    roundTrip(320, 192, 8, true);
+}
+
+// Packed rows, including widths that leave a partial byte
+void test_packed_depths_round_trip(void)
+{
+    roundTrip(480, 60, 1, true);
+    roundTrip(13, 9, 1, true);
+    roundTrip(101, 17, 2, true);
+    roundTrip(77, 21, 4, false);
+    roundTrip(5, 3, 8, false);
+}
+
+// The compressed stream is split into chunks no bigger than the buffer
+void test_idat_chunks_bounded(void)
+{
+    roundTrip(1024, 300, 8, false);
+    Decoded d = decode(PNG);
+    TEST_ASSERT_TRUE(d.idat_sizes.size() > 1);
+    for (uint32_t n : d.idat_sizes)
+        TEST_ASSERT_TRUE(n > 0 && n <= PNG_IDAT_CHUNK_SIZE);
+}
+
+// A page that stops short is padded out, so the file is still a whole PNG
+void test_short_image_is_padded(void)
+{
+    FILE* f = fopen(PNG, "wb");
+    PngWriter w;
+    TEST_ASSERT_TRUE(w.begin(f, 40, 30, 8));
+    std::vector<uint8_t> row(40, 0x7F);
+    for (int y = 0; y < 10; y++)
+        TEST_ASSERT_TRUE(w.addRow(f, row.data()));
+    TEST_ASSERT_EQUAL_UINT32(10, w.rowsWritten());
+    TEST_ASSERT_TRUE(w.end(f));
+    TEST_ASSERT_FALSE(w.isOpen());
+    fclose(f);
+
+    Decoded d = decode(PNG);
+    TEST_ASSERT_EQUAL_UINT32(30, d.rows.size());
+    TEST_ASSERT_EQUAL_HEX8(0x7F, d.rows[9][39]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, d.rows[10][0]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, d.rows[29][39]);
+}
+
+// Rows past the height are dropped rather than corrupting the stream
+void test_extra_rows_ignored(void)
+{
+    FILE* f = fopen(PNG, "wb");
+    PngWriter w;
+    TEST_ASSERT_TRUE(w.begin(f, 8, 2, 8));
+    uint8_t row[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+    for (int y = 0; y < 5; y++)
+        TEST_ASSERT_TRUE(w.addRow(f, row));
+    TEST_ASSERT_TRUE(w.end(f));
+    fclose(f);
+    TEST_ASSERT_EQUAL_UINT32(2, decode(PNG).rows.size());
+}
+
+// Renders an MPS-803-like page: 480 dots across, 66 lines of 80 columns,
+// each character a 6x7 cell from a made-up font under two dots of spacing
+static void printPage(std::vector<std::vector<uint8_t>>& rows, int page)
+{
+    static const char* listing[] = {
+        "10 PRINT CHR$(147);\"MEATLOAF PRINTER TEST\"",
+        "20 FOR I=1 TO 10:PRINT I,I*I,SQR(I):NEXT I",
+        "30 OPEN 4,4:CMD 4:LIST:CLOSE 4",
+        "",
+        "40 REM ****************************************",
+        "50 GOSUB 1000:IF A$=\"\" THEN 50",
+        "60 POKE 53280,0:POKE 53281,0",
+    };
+    const uint32_t width = 480;
+    rows.assign(66 * 9, std::vector<uint8_t>(width, 0));
+    for (int line = 0; line < 66; line++) {
+        std::string text = listing[(line + page) % 7];
+        if (line % 11 == 0)
+            text = "PAGE " + std::to_string(page + 1) + " LINE " + std::to_string(line + 1);
+        for (size_t col = 0; col < text.size() && col < 80; col++) {
+            uint8_t c = (uint8_t)text[col];
+            if (c == ' ')
+                continue;
+            for (int gy = 0; gy < 7; gy++) {
+                uint8_t bits = (uint8_t)((c * 37 + gy * 11) ^ (c >> 1));
+                for (int gx = 0; gx < 5; gx++) {
+                    if (bits & (1 << gx))
+                        rows[line * 9 + gy][col * 6 + gx] = 1;
+                }
+            }
+        }
+    }
+}
+
+// What pngPrinter wrote before: zlib stored blocks of at most 65535 bytes
+static size_t storedSize(uint32_t width, uint32_t height, uint16_t colors)
+{
+    size_t raw = (size_t)(width + 1) * height;
+    size_t blocks = (raw + 0xFFFE) / 0xFFFF;
+    return 8 + 25 + (12 + colors * 3) + (12 + 2 + blocks * 5 + raw + 4) + 12;
+}
+
+// Benchmark: a ten-page printout, one PNG per page, at 8 bits per pixel
+// as pngPrinter writes and packed to 1 bit as a two-color printer could
+void test_printout_benchmark(void)
+{
+    const uint8_t palette[] = {0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00};
+    std::vector<std::vector<uint8_t>> rows;
+    size_t bytes[2] = { 0, 0 };
+    double ms[2] = { 0, 0 };
+    size_t stored = 0;
+    int i = 0;
+    for (uint8_t depth : { 8, 1 }) {
+        auto started = std::chrono::steady_clock::now();
+        for (int page = 0; page < 10; page++) {
+            printPage(rows, page);
+            FILE* f = fopen(PNG, "wb");
+            PngWriter w;
+            TEST_ASSERT_TRUE(w.begin(f, 480, rows.size(), depth, palette, 2));
+            for (auto& row : rows)
+                TEST_ASSERT_TRUE(w.addRow(f, row.data()));
+            TEST_ASSERT_TRUE(w.end(f));
+            bytes[i] += ftell(f);
+            fclose(f);
+            if (i == 0)
+                stored += storedSize(480, rows.size(), 2);
+        }
+        ms[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+        i++;
+    }
+
+    // The last page decodes to what was printed
+    Decoded d = decode(PNG);
+    for (size_t y = 0; y < rows.size(); y++)
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(rows[y].data(), d.rows[y].data(), 480);
+
+    printf("10 pages 480x%u: stored %u bytes, 8-bit %u bytes %.1f ms, 1-bit %u bytes %.1f ms\n",
+           (unsigned)rows.size(), (unsigned)stored, (unsigned)bytes[0], ms[0], (unsigned)bytes[1], ms[1]);
+
+    TEST_ASSERT_TRUE(bytes[0] * 10 <= stored);
+    TEST_ASSERT_TRUE(bytes[1] * 10 <= stored);
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_palette_8bit_round_trip);
+    RUN_TEST(test_packed_depths_round_trip);
+    RUN_TEST(test_idat_chunks_bounded);
+    RUN_TEST(test_short_image_is_padded);
+    RUN_TEST(test_extra_rows_ignored);
+    RUN_TEST(test_printout_benchmark);
+    return UNITY_END();
+}
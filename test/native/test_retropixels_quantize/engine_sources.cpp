@@ -0,0 +1,16 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// Only the quantizer and the model it reads: the rest of the retropixels
+// component (stb_image, the writers) has nothing to do with palette matching.
+// IImageData.cpp and Palette.cpp use a bare size_t that only the ESP-IDF
+// toolchain's headers happen to bring in.
+#include <stddef.h>
+
+#include "../../../components/retropixels/src/model/IImageData.cpp"
+#include "../../../components/retropixels/src/model/Palette.cpp"
+#include "../../../components/retropixels/src/model/Pixels.cpp"
+#include "../../../components/retropixels/src/profiles/ColorSpaces.cpp"
+#include "../../../components/retropixels/src/profiles/Palettes.cpp"
+#include "../../../components/retropixels/src/conversion/Quantizer.cpp"
@@ -0,0 +1,287 @@
+// Tests for Quantizer (components/retropixels/src/conversion/Quantizer.h), the
+// palette matching behind RetroPixelsMStream::convertImage().
+//
+// quantizeImage() used to peek() every pixel into a fresh vector and call
+// distanceSquared() once per palette entry, which ran the colorspace again on
+// the same pixel each time - a 320x200 image cost around a million heap
+// allocations. It now converts each pixel once, matches batches of them
+// against the palette laid out channel by channel, and can remember answers
+// per RGBA. None of that may change a single palette index: the reference
+// below is the old loop, kept verbatim in shape, and every image is compared
+// against it pixel for pixel.
+
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../../../components/retropixels/src/conversion/Quantizer.h"
+#include "../../../components/retropixels/src/profiles/ColorSpaces.h"
+#include "../../../components/retropixels/src/profiles/Palettes.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+typedef std::function<std::vector<double>(const std::vector<int>&)> ColorspaceFn;
+
+// The wrapper RetroPixelsMStream::convertImage() builds around a ColorSpace.
+static ColorspaceFn wrap(const std::string& name)
+{
+    auto colorspaceFunc = ColorSpace::ColorSpaces.at(name);
+    return [colorspaceFunc](const std::vector<int>& pixel) -> std::vector<double> {
+        std::vector<double> pixelDouble(pixel.begin(), pixel.end());
+        return colorspaceFunc(pixelDouble);
+    };
+}
+
+// The old Quantizer::quantizeImage(): peek, then distanceSquared() - and with
+// it a colorspace conversion of the pixel - for every enabled entry.
+static std::vector<int> referenceQuantize(const Quantizer& quantizer, const Palette& palette, const IImageData& image)
+{
+    std::vector<int> result(image.width * image.height);
+    for (int y = 0; y < image.height; ++y) {
+        for (int x = 0; x < image.width; ++x) {
+            const std::vector<int> pixel = peek(image, x, y);
+            int bestIndex = 0;
+            double minDistSq = std::numeric_limits<double>::max();
+            for (size_t i = 0; i < palette.enabled.size(); ++i) {
+                const int index = palette.enabled[i];
+                const double distSq = quantizer.distanceSquared(pixel, index);
+                if (distSq < minDistSq) {
+                    minDistSq = distSq;
+                    bestIndex = index;
+                }
+            }
+            result[y * image.width + x] = bestIndex;
+        }
+    }
+    return result;
+}
+
+// Something photo-like: smooth gradients with noise on top, so nearly every
+// pixel is a colour of its own. Deterministic, so failures reproduce.
+static IImageData photo(int width, int height, uint32_t seed)
+{
+    IImageData image(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            seed = seed * 1103515245 + 12345;
+            int noise = (int)((seed >> 16) & 0x1f) - 16;
+            image.setPixel(x, y,
+                           (uint8_t)cap(x * 255 / width + noise),
+                           (uint8_t)cap(y * 255 / height - noise),
+                           (uint8_t)cap(((x + y) * 128) / (width + height) + 64 + noise),
+                           0xff);
+        }
+    }
+    return image;
+}
+
+// Something drawn: flat blocks of a few colours, where most pixels repeat.
+static IImageData cartoon(int width, int height)
+{
+    static const uint8_t inks[6][3] = {
+        { 0x00, 0x00, 0x00 }, { 0xff, 0xff, 0xff }, { 0xd0, 0x40, 0x30 },
+        { 0x30, 0x80, 0xe0 }, { 0xf0, 0xe0, 0x40 }, { 0x60, 0xa0, 0x50 },
+    };
+    IImageData image(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            const uint8_t* ink = inks[((x / 24) + (y / 20) * 3) % 6];
+            image.setPixel(x, y, ink[0], ink[1], ink[2], 0xff);
+        }
+    }
+    return image;
+}
+
+static void assertSameIndices(const std::vector<int>& expected, const std::vector<int>& actual, const char* message)
+{
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(expected.size(), actual.size(), message);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i] != actual[i]) {
+            char detail[128];
+            snprintf(detail, sizeof(detail), "%s: pixel %u", message, (unsigned)i);
+            TEST_ASSERT_EQUAL_INT_MESSAGE(expected[i], actual[i], detail);
+        }
+    }
+}
+
+// Every colorspace the converter offers, against two palettes, with the
+// lookup off and on.
+void test_quantize_image_matches_reference(void)
+{
+    const Palette* palettes[] = { &colodore, &pepto };
+    IImageData image = photo(96, 60, 1);
+
+    for (auto& colorspace : ColorSpace::ColorSpaces) {
+        for (const Palette* palette : palettes) {
+            Quantizer quantizer(*palette, wrap(colorspace.first));
+            std::vector<int> expected = referenceQuantize(quantizer, *palette, image);
+
+            std::string message = colorspace.first + ", no lookup";
+            assertSameIndices(expected, quantizer.quantizeImage(image), message.c_str());
+
+            quantizer.setLookupBits(15);
+            message = colorspace.first + ", 15-bit lookup";
+            assertSameIndices(expected, quantizer.quantizeImage(image), message.c_str());
+            // And again with the lookup warm.
+            assertSameIndices(expected, quantizer.quantizeImage(image), message.c_str());
+        }
+    }
+}
+
+// A coarse lookup puts many colours in one slot; a slot only ever answers for
+// the exact RGBA it was filled with.
+void test_lookup_collisions_do_not_leak(void)
+{
+    Quantizer quantizer(colodore, wrap("oklab"));
+    quantizer.setLookupBits(3);
+
+    IImageData image = photo(64, 64, 7);
+    std::vector<int> expected = referenceQuantize(quantizer, colodore, image);
+    assertSameIndices(expected, quantizer.quantizeImage(image), "3-bit lookup");
+}
+
+// Palette.enabled is public and the converter's callers narrow it; the next
+// image has to be matched against the new set, not the remembered one. Equal
+// distances still go to the earliest enabled entry.
+void test_enabled_set_changes_and_ties(void)
+{
+    Palette palette({
+        { 0x00, 0x00, 0x00, 0xff },
+        { 0xff, 0xff, 0xff, 0xff },
+        { 0x00, 0x00, 0x00, 0xff },     // duplicate of 0
+        { 0x80, 0x80, 0x80, 0xff },
+    });
+    Quantizer quantizer(palette, wrap("rgb"));
+    quantizer.setLookupBits(15);
+
+    IImageData image = photo(40, 40, 3);
+    assertSameIndices(referenceQuantize(quantizer, palette, image), quantizer.quantizeImage(image), "all enabled");
+
+    palette.enabled = { 3, 2, 0 };
+    std::vector<int> narrowed = quantizer.quantizeImage(image);
+    assertSameIndices(referenceQuantize(quantizer, palette, image), narrowed, "narrowed");
+    for (int index : narrowed)
+        TEST_ASSERT_NOT_EQUAL(1, index);
+
+    TEST_ASSERT_EQUAL_INT(2, quantizer.quantizePixel({ 0, 0, 0, 0xff }));
+}
+
+void test_quantize_pixel_matches_reference(void)
+{
+    Quantizer quantizer(pepto, wrap("lab"));
+    IImageData image = photo(32, 32, 11);
+    std::vector<int> expected = referenceQuantize(quantizer, pepto, image);
+
+    for (int y = 0; y < image.height; ++y)
+        for (int x = 0; x < image.width; ++x)
+            TEST_ASSERT_EQUAL_INT(expected[y * image.width + x], quantizer.quantizePixel(peek(image, x, y)));
+}
+
+// Converter::mapToExistingColorMaps() hands leftover pixels over in batches,
+// each with the palette index every colour map holds at its spot (-1 where a
+// map has none). The answer has to be the map the old per-pixel loop - one
+// distanceSquared() per map - would have picked, ties to the first.
+void test_nearest_candidate_matches_reference(void)
+{
+    Quantizer quantizer(colodore, wrap("xyz"));
+    IImageData image = photo(48, 8, 5);
+
+    const size_t maps = 3;
+    std::vector<uint32_t> colors;
+    std::vector<int> candidates;
+    uint32_t seed = 9;
+    for (int y = 0; y < image.height; ++y) {
+        for (int x = 0; x < image.width; ++x) {
+            const std::vector<int> p = peek(image, x, y);
+            colors.push_back(p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+            for (size_t i = 0; i < maps; ++i) {
+                seed = seed * 1103515245 + 12345;
+                const int pick = (int)((seed >> 16) % 18);
+                // Now and then a map with nothing there, or the same colour twice.
+                candidates.push_back(pick >= 16 ? -1 : (i == 2 && pick < 2) ? candidates[candidates.size() - 2] : pick);
+            }
+        }
+    }
+
+    std::vector<int> actual(colors.size());
+    for (size_t k = 0; k < colors.size(); k += QUANTIZER_BATCH) {
+        const size_t n = std::min((size_t)QUANTIZER_BATCH, colors.size() - k);
+        quantizer.nearestCandidate(&colors[k], n, &candidates[k * maps], maps, &actual[k]);
+    }
+
+    for (size_t k = 0; k < colors.size(); ++k) {
+        const std::vector<int> pixel = peek(image, (int)(k % image.width), (int)(k / image.width));
+        int closest = 0;
+        double minDistance = std::numeric_limits<double>::max();
+        for (size_t i = 0; i < maps; ++i) {
+            const int index = candidates[k * maps + i];
+            if (index == -1) continue;
+            const double distance = quantizer.distanceSquared(pixel, index);
+            if (distance < minDistance) {
+                minDistance = distance;
+                closest = (int)i;
+            }
+        }
+        TEST_ASSERT_EQUAL_INT(closest, actual[k]);
+    }
+}
+
+// Benchmark: full 320x200 frames, the size convertImage() scales to, in the
+// oklab colorspace it uses. The timings are printed for comparison; the
+// output is asserted identical.
+static void benchmark(const char* name, const IImageData& image)
+{
+    const ColorspaceFn colorspace = wrap("oklab");
+    Quantizer reference(colodore, colorspace);
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<int> expected = referenceQuantize(reference, colodore, image);
+    double reference_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - started).count();
+
+    printf("quantize %s %dx%d: reference %.2f ms", name, image.width, image.height, reference_ms);
+
+    const int bits[] = { 0, 12, 15, 18 };
+    for (int b : bits) {
+        Quantizer quantizer(colodore, colorspace);
+        quantizer.setLookupBits(b);
+
+        started = std::chrono::steady_clock::now();
+        std::vector<int> actual = quantizer.quantizeImage(image);
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - started).count();
+
+        printf(", %d-bit %.2f ms", b, ms);
+        assertSameIndices(expected, actual, name);
+    }
+    printf("\n");
+}
+
+void test_benchmark_image(void)
+{
+    benchmark("photo", photo(320, 200, 42));
+    benchmark("cartoon", cartoon(320, 200));
+}
+
+int main(int argc, char** argv)
+{
+    (void)argc; (void)argv;
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_quantize_image_matches_reference);
+    RUN_TEST(test_lookup_collisions_do_not_leak);
+    RUN_TEST(test_enabled_set_changes_and_ties);
+    RUN_TEST(test_quantize_pixel_matches_reference);
+    RUN_TEST(test_nearest_candidate_matches_reference);
+    RUN_TEST(test_benchmark_image);
+
+    return UNITY_END();
+}
@@ -0,0 +1,15 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real sources
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// The SAM engine is C, so it gets a C unit of its own. samlib.cpp is left
+// out: it plays through the audio device, and the tests read samples
+// straight from the context.
+#include "../../../lib/sam/reciter.c"
+#include "../../../lib/sam/sam.c"
+#include "../../../lib/sam/render.c"
+#include "../../../lib/sam/samstream.c"
+#include "../../../lib/sam/samdebug.c"
+
+// samlib.cpp defines this for the firmware
+int debug = 0;
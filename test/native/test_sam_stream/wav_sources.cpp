@@ -0,0 +1,4 @@
+// samlib's WriteWav(), for the suite to write a file with; see
+// engine_sources.c for why the real sources are #include'd here. It gets a
+// C++ unit of its own, as the rest of samlib is left out.
+#include "../../../lib/sam/samwav.cpp"
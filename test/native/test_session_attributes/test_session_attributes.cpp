@@ -0,0 +1,354 @@
+// Tests for the attribute (stat) cache on MSession (lib/meatloaf/meat_session.h),
+// which SMBMFile, NFSMFile and SFTPMFile consult before a round trip.
+//
+// Those three cannot build on the host (libsmb2, libnfs, libssh), so FakeFile
+// below is a stand-in with the same shape: every attribute getter goes through
+// MSession::statCached(), a listing fills the cache for its entries, and
+// anything that changes a path invalidates it. FakeSession counts the stats
+// that reach the "server".
+
+#include <unity.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "meat_session.h"
+
+class FakeSession : public MSession
+{
+public:
+    FakeSession() : MSession("fake://server:1", "server", 1) { connected = true; }
+
+    bool connect() override { connected = true; return true; }
+    void disconnect() override { connected = false; }
+    bool keep_alive() override { return true; }
+
+    // What the server holds, and how often it was asked
+    std::map<std::string, MSession::Attributes> files;
+    std::atomic<uint32_t> stats{0};
+    bool offline = false;
+
+    // Runs inside a stat, after the server has answered - where another
+    // thread's invalidation can slip in
+    std::function<void()> during_stat;
+
+    MSession::StatResult serverStat(const std::string& path, MSession::Attributes& a)
+    {
+        stats++;
+        if (offline)
+            return MSession::StatResult::Error;
+        auto it = files.find(path);
+        MSession::StatResult r = MSession::StatResult::Missing;
+        if (it != files.end())
+        {
+            a = it->second;
+            r = MSession::StatResult::Found;
+        }
+        if (during_stat)
+            during_stat();
+        return r;
+    }
+};
+
+// Mirrors SMBMFile: the getters an IEC open() and a WebDAV PROPFIND call.
+class FakeFile
+{
+public:
+    FakeFile(std::shared_ptr<FakeSession> session, std::string path)
+        : session(session), path(path) {}
+
+    bool exists() { return stat().exists; }
+    bool isDirectory() { return stat().is_dir; }
+    time_t getLastWrite() { return stat().mtime; }
+    time_t getCreationTime() { return stat().ctime; }
+    uint64_t size() { return stat().size; }
+
+    // One readdir round trip; its entries' attributes come with it
+    std::vector<std::string> list()
+    {
+        std::vector<std::string> names;
+        std::string prefix = path + "/";
+        for (auto& f : session->files)
+        {
+            if (f.first.compare(0, prefix.size(), prefix) != 0 ||
+                f.first.find('/', prefix.size()) != std::string::npos)
+                continue;
+            names.push_back(f.first);
+            session->cacheAttributes(f.first, f.second);
+        }
+        return names;
+    }
+
+    bool remove()
+    {
+        bool ok = session->files.erase(path) > 0;
+        session->invalidateAttributes(path);
+        return ok;
+    }
+
+private:
+    MSession::Attributes stat()
+    {
+        return session->statCached(path, [&](MSession::Attributes& a) {
+            return session->serverStat(path, a);
+        });
+    }
+
+    std::shared_ptr<FakeSession> session;
+    std::string path;
+};
+
+static MSession::Attributes file(uint64_t size, time_t mtime)
+{
+    MSession::Attributes a;
+    a.exists = true;
+    a.size = size;
+    a.mtime = mtime;
+    a.ctime = mtime - 100;
+    return a;
+}
+
+static MSession::Attributes dir()
+{
+    MSession::Attributes a;
+    a.exists = true;
+    a.is_dir = true;
+    return a;
+}
+
+static std::shared_ptr<FakeSession> server()
+{
+    auto s = std::make_shared<FakeSession>();
+    s->files["/share"] = dir();
+    s->files["/share/games"] = dir();
+    for (int i = 0; i < 20; i++)
+        s->files["/share/games/GAME" + std::to_string(i) + ".D64"] = file(174848, 1700000000 + i);
+    s->files["/share/games/sub"] = dir();
+    s->files["/share/games/sub/INNER.PRG"] = file(1000, 1700000100);
+    return s;
+}
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// The getters a single open() makes, in the order it makes them.
+static void openSequence(FakeFile& f)
+{
+    f.exists();
+    f.isDirectory();
+    f.getLastWrite();
+    f.size();
+    f.getCreationTime();
+}
+
+// LOAD"$" then LOAD"GAME7.D64": the listing answers everything the load asks
+void test_directory_then_load_needs_no_stat(void)
+{
+    auto s = server();
+    FakeFile games(s, "/share/games");
+    TEST_ASSERT_EQUAL(21, games.list().size());
+
+    FakeFile game(s, "/share/games/GAME7.D64");
+    openSequence(game);
+
+    TEST_ASSERT_EQUAL_UINT32(0, s->stats);
+    TEST_ASSERT_EQUAL_UINT32(5, s->attributeHits());
+    TEST_ASSERT_EQUAL(1700000007, game.getLastWrite());
+    TEST_ASSERT_EQUAL_UINT64(174848, game.size());
+}
+
+// Without a listing first: one stat, however many getters follow
+void test_cold_open_stats_once(void)
+{
+    auto s = server();
+    FakeFile game(s, "/share/games/GAME3.D64");
+    openSequence(game);
+    openSequence(game);
+    TEST_ASSERT_EQUAL_UINT32(1, s->stats);
+    TEST_ASSERT_EQUAL_UINT32(1, s->attributeMisses());
+
+    // Trailing slash is the same path
+    FakeFile again(s, "/share/games/GAME3.D64/");
+    TEST_ASSERT_TRUE(again.exists());
+    TEST_ASSERT_EQUAL_UINT32(1, s->stats);
+}
+
+// A missing name is remembered too, until something creates it
+void test_missing_path_is_cached_until_invalidated(void)
+{
+    auto s = server();
+    FakeFile missing(s, "/share/games/NEW.PRG");
+    TEST_ASSERT_FALSE(missing.exists());
+    TEST_ASSERT_FALSE(missing.exists());
+    TEST_ASSERT_EQUAL_UINT32(1, s->stats);
+
+    // What a write stream does on open and close
+    s->files["/share/games/NEW.PRG"] = file(10, 1700000200);
+    s->invalidateAttributes("/share/games/NEW.PRG");
+
+    TEST_ASSERT_TRUE(missing.exists());
+    TEST_ASSERT_EQUAL_UINT64(10, missing.size());
+    TEST_ASSERT_EQUAL_UINT32(2, s->stats);
+}
+
+// Invalidation drops the path, everything under it and its parent - and
+// nothing else
+void test_invalidation_scope(void)
+{
+    auto s = server();
+    FakeFile games(s, "/share/games");
+    games.list();
+    FakeFile(s, "/share/games/sub").list();
+    FakeFile(s, "/share/games").exists();
+    FakeFile(s, "/share").exists();
+    uint32_t before = s->stats;
+
+    s->invalidateAttributes("/share/games/sub");
+
+    FakeFile(s, "/share/games/GAME1.D64").exists();
+    TEST_ASSERT_EQUAL_UINT32(before, s->stats);
+    FakeFile(s, "/share").exists();
+    TEST_ASSERT_EQUAL_UINT32(before, s->stats);
+
+    FakeFile(s, "/share/games/sub").exists();
+    FakeFile(s, "/share/games/sub/INNER.PRG").exists();
+    FakeFile(s, "/share/games").exists();
+    TEST_ASSERT_EQUAL_UINT32(before + 3, s->stats);
+
+    // A removed file is gone at once, not a TTL later
+    FakeFile doomed(s, "/share/games/GAME2.D64");
+    TEST_ASSERT_TRUE(doomed.exists());
+    TEST_ASSERT_TRUE(doomed.remove());
+    TEST_ASSERT_FALSE(doomed.exists());
+}
+
+// A change made by another client is seen once the TTL runs out
+void test_entries_expire(void)
+{
+    auto s = server();
+    s->setAttributeTTL(20);
+    FakeFile game(s, "/share/games/GAME4.D64");
+    TEST_ASSERT_EQUAL(1700000004, game.getLastWrite());
+
+    s->files["/share/games/GAME4.D64"].mtime = 1800000000;
+    TEST_ASSERT_EQUAL(1700000004, game.getLastWrite());
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    TEST_ASSERT_EQUAL(1800000000, game.getLastWrite());
+    TEST_ASSERT_EQUAL_UINT32(2, s->stats);
+}
+
+// Bounded: the least recently used entry makes room
+void test_cache_is_bounded(void)
+{
+    auto s = std::make_shared<FakeSession>();
+    for (size_t i = 0; i < MSession::max_attribute_cache_entries + 10; i++)
+        s->cacheAttributes("/f" + std::to_string(i), file(i, 0));
+    TEST_ASSERT_EQUAL(MSession::max_attribute_cache_entries, s->attributeCacheCount());
+
+    MSession::Attributes a;
+    TEST_ASSERT_FALSE(s->getCachedAttributes("/f0", a));
+    TEST_ASSERT_TRUE(s->getCachedAttributes("/f10", a));
+    TEST_ASSERT_EQUAL_UINT64(10, a.size);
+
+    // Touching the oldest keeps it past the next eviction
+    s->cacheAttributes("/g", file(1, 0));
+    TEST_ASSERT_TRUE(s->getCachedAttributes("/f10", a));
+    TEST_ASSERT_FALSE(s->getCachedAttributes("/f11", a));
+}
+
+// Drives, WebDAV and the console share one session. Several stat, list and
+// invalidate in one directory at once; every answer must still be the
+// server's.
+void test_concurrent_use(void)
+{
+    auto s = server();
+    std::atomic<uint32_t> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([&, t] {
+            FakeFile games(s, "/share/games");
+            for (int i = 0; i < 2000; i++)
+            {
+                int n = (i * 7 + t) % 20;
+                FakeFile f(s, "/share/games/GAME" + std::to_string(n) + ".D64");
+                if (!f.exists() || f.isDirectory() || f.getLastWrite() != 1700000000 + n)
+                    wrong++;
+                if (i % 100 == t)
+                    games.list();
+                if (i % 50 == t)
+                    s->invalidateAttributes("/share/games/GAME" + std::to_string(n) + ".D64");
+                if (i % 500 == t)
+                    s->clearAttributeCache();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    TEST_ASSERT_EQUAL_UINT32(0, wrong);
+    TEST_ASSERT_TRUE(s->attributeCacheCount() <= MSession::max_attribute_cache_entries);
+    TEST_ASSERT_EQUAL_UINT32(4 * 2000 * 3, s->attributeHits() + s->attributeMisses());
+}
+
+// A timeout or a dropped connection is not "does not exist": it is not
+// cached, and the file is found as soon as the server answers again
+void test_errors_are_not_cached(void)
+{
+    auto s = server();
+    FakeFile game(s, "/share/games/GAME3.D64");
+    s->offline = true;
+    TEST_ASSERT_FALSE(game.exists());
+    TEST_ASSERT_FALSE(game.exists());
+    TEST_ASSERT_EQUAL_UINT32(2, s->stats);
+    TEST_ASSERT_EQUAL(0, s->attributeCacheCount());
+
+    s->offline = false;
+    TEST_ASSERT_TRUE(game.exists());
+    TEST_ASSERT_TRUE(game.exists());
+    TEST_ASSERT_EQUAL_UINT32(3, s->stats);
+}
+
+// A stat that started before a remove or a write close is not stored after
+// it: the next look goes back to the server
+void test_stat_overtaken_by_invalidation_is_dropped(void)
+{
+    auto s = server();
+    FakeFile game(s, "/share/games/GAME5.D64");
+    s->during_stat = [&] {
+        s->during_stat = nullptr;
+        s->files.erase("/share/games/GAME5.D64");
+        s->invalidateAttributes("/share/games/GAME5.D64");
+    };
+    TEST_ASSERT_TRUE(game.exists());    // what the server said at the time
+    TEST_ASSERT_EQUAL(0, s->attributeCacheCount());
+    TEST_ASSERT_FALSE(game.exists());
+    TEST_ASSERT_EQUAL_UINT32(2, s->stats);
+
+    // and the same for a listing's entry
+    uint32_t generation = s->attributeGeneration();
+    s->clearAttributeCache();
+    s->cacheAttributes("/share/games/GAME6.D64", file(1, 0), generation);
+    TEST_ASSERT_EQUAL(0, s->attributeCacheCount());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_directory_then_load_needs_no_stat);
+    RUN_TEST(test_cold_open_stats_once);
+    RUN_TEST(test_missing_path_is_cached_until_invalidated);
+    RUN_TEST(test_invalidation_scope);
+    RUN_TEST(test_entries_expire);
+    RUN_TEST(test_cache_is_bounded);
+    RUN_TEST(test_concurrent_use);
+    RUN_TEST(test_errors_are_not_cached);
+    RUN_TEST(test_stat_overtaken_by_invalidation_is_dropped);
+    return UNITY_END();
+}
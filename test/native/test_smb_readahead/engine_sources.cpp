@@ -0,0 +1,12 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// libsmb2 itself is not built for the host: the handful of its calls that
+// SMBReadAhead makes are answered by the simulated server in
+// test_smb_readahead.cpp.
+//
+// Not under mingw, where the suite is skipped (see test_smb_readahead.cpp).
+#ifndef _WIN32
+#include "../../../lib/meatloaf/network/smb_readahead.cpp"
+#endif
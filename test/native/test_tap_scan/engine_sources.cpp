@@ -0,0 +1,35 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO. The TAPClean
+// engine itself is C with colliding file-statics, so it is built as a library
+// by test/native/test_archive_extract/host/build_libarchive.py instead.
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp #define's a bare `min(a,b)` macro with no matching #undef.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+
+// string_utils.cpp's crc32() is the ESP ROM's; zlib has the same CRC-32
+#include <sstream>
+#include <zlib.h>
+namespace mstr {
+    std::string crc32(const std::string &s)
+    {
+        std::stringstream ss;
+        ss << std::hex << ::crc32(0L, (const Bytef *)s.data(), (uInt)s.size());
+        return ss.str();
+    }
+}
+
+// tape_decoder.cpp reports scan progress on Serial, which debug.h maps to the
+// ESP's debug UART - a class with no printf() on the host. Quiet stand-in.
+#include "../../../include/debug.h"
+#undef Serial
+#define Serial tape_test_serial
+static struct {
+    int printf(const char*, ...) { return 0; }
+} tape_test_serial;
+#include "../../../lib/meatloaf/media/tape/tape_decoder.cpp"
+#undef Serial
+
+#include "../test_disk_write/native_stubs.cpp"
@@ -0,0 +1,123 @@
+#ifndef TEST_TAP_WRITER
+#define TEST_TAP_WRITER
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Writes C64 TAP v1 images the way the Kernal's SAVE to tape records them,
+// so TAPClean's C64 ROM-TAPE scanner recognizes every block: a leader of
+// short pulses, a countdown sync, the bytes (marker, 8 bits LSB first, odd
+// parity), an XOR checkbyte and an end-of-data marker - then the whole
+// block again as the repeat copy.
+class TapWriter
+{
+public:
+    TapWriter()
+    {
+        const char sig[] = "C64-TAPE-RAW";
+        tap.assign(sig, sig + 12);
+        tap.push_back(1);   // version: v1 (long pauses as 0 + 24-bit cycles)
+        tap.push_back(0);   // C64
+        tap.push_back(0);   // PAL
+        tap.push_back(0);
+        tap.resize(20, 0);  // data length, patched by data()
+    }
+
+    // One program: its tape header block, then its data block
+    void save(const std::string& name, uint16_t load_addr, const std::vector<uint8_t>& body)
+    {
+        std::vector<uint8_t> header(192, 0x20);
+        uint16_t end_addr = (uint16_t)(load_addr + body.size());
+        header[0] = 0x03;   // non-relocatable program
+        header[1] = load_addr & 0xFF;
+        header[2] = load_addr >> 8;
+        header[3] = end_addr & 0xFF;
+        header[4] = end_addr >> 8;
+        for (size_t i = 0; i < 16 && i < name.size(); i++)
+            header[5 + i] = (uint8_t)name[i];
+
+        block(header, 0x6A00);
+        pause(300000);
+        block(body, 0x1A00);
+        pause(1000000);
+    }
+
+    void pause(uint32_t cycles)
+    {
+        tap.push_back(0);
+        tap.push_back(cycles & 0xFF);
+        tap.push_back((cycles >> 8) & 0xFF);
+        tap.push_back((cycles >> 16) & 0xFF);
+    }
+
+    const std::vector<uint8_t>& data()
+    {
+        uint32_t n = (uint32_t)tap.size() - 20;
+        tap[16] = n & 0xFF;
+        tap[17] = (n >> 8) & 0xFF;
+        tap[18] = (n >> 16) & 0xFF;
+        tap[19] = (n >> 24) & 0xFF;
+        return tap;
+    }
+
+    bool writeTo(const std::string& path)
+    {
+        FILE* f = fopen(path.c_str(), "wb");
+        if (f == nullptr)
+            return false;
+        const std::vector<uint8_t>& d = data();
+        bool ok = fwrite(d.data(), 1, d.size(), f) == d.size();
+        fclose(f);
+        return ok;
+    }
+
+private:
+    enum : uint8_t { S = 0x30, M = 0x42, L = 0x56 };
+
+    void bit(int b)
+    {
+        tap.push_back(b ? M : S);
+        tap.push_back(b ? S : M);
+    }
+
+    void byte(uint8_t v)
+    {
+        tap.push_back(L);
+        tap.push_back(M);
+        int parity = 1;
+        for (int i = 0; i < 8; i++) {
+            int b = (v >> i) & 1;
+            parity ^= b;
+            bit(b);
+        }
+        bit(parity);
+    }
+
+    void copy(const std::vector<uint8_t>& payload, uint32_t leader, uint8_t countdown)
+    {
+        tap.insert(tap.end(), leader, S);
+        for (int i = 0; i < 9; i++)
+            byte((uint8_t)(countdown - i));
+        uint8_t check = 0;
+        for (uint8_t b : payload) {
+            byte(b);
+            check ^= b;
+        }
+        byte(check);
+        tap.push_back(L);   // end of data
+        tap.push_back(S);
+        tap.insert(tap.end(), 0x4E, S);
+    }
+
+    void block(const std::vector<uint8_t>& payload, uint32_t leader)
+    {
+        copy(payload, leader, 0x89);
+        copy(payload, 0x4F, 0x09);
+    }
+
+    std::vector<uint8_t> tap;
+};
+
+#endif
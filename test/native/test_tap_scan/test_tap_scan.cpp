@@ -0,0 +1,243 @@
+// Tests for TapeDecoder (lib/meatloaf/media/tape/tape_decoder.cpp) over
+// Kernal-format TAP images written by TapWriter: the sliding window must
+// list exactly what a scan of the whole image does, wherever its edges
+// fall, and a second open must serve from the scan index.
+
+#include <unity.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "media/tape/tape_decoder.h"
+#include "string_utils.h"
+#include "../test_disk_write/file_container_stream.h"
+#include "tap_writer.h"
+
+static const char* TAP = "test_tap_scan.tap";
+
+// Counts what the decoder actually reads from the image
+class CountingStream : public FileContainerStream
+{
+public:
+    using FileContainerStream::FileContainerStream;
+    uint64_t bytes_read = 0;
+
+    uint32_t read(uint8_t* buf, uint32_t size) override
+    {
+        uint32_t n = FileContainerStream::read(buf, size);
+        bytes_read += n;
+        return n;
+    }
+};
+
+static std::string indexFile()
+{
+    return "./tape-" + mstr::crc32(TAP) + ".tix";
+}
+
+static std::vector<uint8_t> body(size_t n, uint8_t seed)
+{
+    std::vector<uint8_t> b(n);
+    for (size_t i = 0; i < n; i++)
+        b[i] = (uint8_t)(seed * 31 + i * 7 + (i >> 8));
+    return b;
+}
+
+static std::string progName(int i)
+{
+    char name[17];
+    snprintf(name, sizeof(name), "PROGRAM %02d", i);
+    return name;
+}
+
+static void writeTape(int programs, size_t size, uint8_t seed = 0)
+{
+    TapWriter w;
+    for (int i = 0; i < programs; i++)
+        w.save(progName(i + seed), 0x0801, body(size, (uint8_t)(i + seed)));
+    TEST_ASSERT_TRUE(w.writeTo(TAP));
+}
+
+static std::vector<TapeEntry> listAll(TapeDecoder& d)
+{
+    std::vector<TapeEntry> all;
+    TapeEntry e;
+    uint32_t from = 0;
+    while (d.nextProgram(from, e)) {
+        from = e.tape_end_offset;
+        all.push_back(e);
+    }
+    return all;
+}
+
+static void checkPrograms(const std::vector<TapeEntry>& all, int programs, size_t size, uint8_t seed = 0)
+{
+    TEST_ASSERT_EQUAL(programs, all.size());
+    for (int i = 0; i < programs; i++) {
+        TEST_ASSERT_EQUAL_STRING(mstr::toUTF8(progName(i + seed)).c_str(), all[i].name.c_str());
+        TEST_ASSERT_TRUE(all[i].checksum_ok);
+        TEST_ASSERT_EQUAL_HEX16(0x0801, all[i].start_addr);
+        std::vector<uint8_t> want = body(size, (uint8_t)(i + seed));
+        TEST_ASSERT_EQUAL(size + 2, all[i].prg.size());
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(want.data(), all[i].prg.data() + 2, size);
+        if (i > 0) {
+            TEST_ASSERT_TRUE(all[i].tape_offset >= all[i - 1].tape_end_offset);
+            TEST_ASSERT_TRUE(all[i].start_time_ms >= all[i - 1].end_time_ms);
+        }
+    }
+}
+
+static void checkSame(const std::vector<TapeEntry>& want, const std::vector<TapeEntry>& got)
+{
+    TEST_ASSERT_EQUAL(want.size(), got.size());
+    for (size_t i = 0; i < want.size(); i++) {
+        TEST_ASSERT_EQUAL_STRING(want[i].name.c_str(), got[i].name.c_str());
+        TEST_ASSERT_EQUAL_STRING(want[i].loader.c_str(), got[i].loader.c_str());
+        TEST_ASSERT_EQUAL_UINT32(want[i].tape_offset, got[i].tape_offset);
+        TEST_ASSERT_EQUAL_UINT32(want[i].tape_end_offset, got[i].tape_end_offset);
+        TEST_ASSERT_EQUAL_UINT32(want[i].start_time_ms, got[i].start_time_ms);
+        TEST_ASSERT_EQUAL_UINT32(want[i].end_time_ms, got[i].end_time_ms);
+        TEST_ASSERT_EQUAL(want[i].checksum_ok, got[i].checksum_ok);
+        TEST_ASSERT_EQUAL(want[i].prg.size(), got[i].prg.size());
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(want[i].prg.data(), got[i].prg.data(), want[i].prg.size());
+    }
+}
+
+void setUp(void)
+{
+    remove(TAP);
+    remove(indexFile().c_str());
+}
+
+void tearDown(void)
+{
+    remove(TAP);
+    remove(indexFile().c_str());
+}
+
+void test_lists_every_program(void)
+{
+    writeTape(3, 1024);
+    FileContainerStream s(TAP);
+    TapeDecoder d;
+    TEST_ASSERT_TRUE(d.open(&s));
+    checkPrograms(listAll(d), 3, 1024);
+}
+
+// A long tape through a small window: the same programs, offsets and
+// times as one buffer holding it all, in a fraction of the memory
+void test_sliding_window_matches_whole_scan(void)
+{
+    writeTape(12, 1024);
+    FileContainerStream whole_s(TAP);
+    TapeDecoder whole;
+    whole.setWindowLimit(64 * 1024 * 1024);
+    TEST_ASSERT_TRUE(whole.open(&whole_s));
+    std::vector<TapeEntry> want = listAll(whole);
+    checkPrograms(want, 12, 1024);
+
+    FileContainerStream sliding_s(TAP);
+    TapeDecoder sliding;
+    sliding.setWindowLimit(256 * 1024);
+    TEST_ASSERT_TRUE(sliding.open(&sliding_s));
+    checkSame(want, listAll(sliding));
+    TEST_ASSERT_TRUE(whole.bufferPeak() >= sliding_s.size());
+    TEST_ASSERT_TRUE(sliding.bufferPeak() <= 256 * 1024 + 4096);
+
+    // (each slice adds up its times anew: a few ms of rounding)
+    TEST_ASSERT_UINT32_WITHIN(100, whole.totalMs(), sliding.totalMs());
+}
+
+// Wherever a window edge falls - mid-leader, mid-block, between a block
+// and its repeat copy - no program is lost, cut short or listed twice
+void test_window_edges_anywhere(void)
+{
+    writeTape(8, 1024);
+    FileContainerStream whole_s(TAP);
+    TapeDecoder whole;
+    whole.setWindowLimit(64 * 1024 * 1024);
+    TEST_ASSERT_TRUE(whole.open(&whole_s));
+    std::vector<TapeEntry> want = listAll(whole);
+    checkPrograms(want, 8, 1024);
+
+    for (uint32_t limit = 160 * 1024; limit < 320 * 1024; limit += 23 * 1024) {
+        FileContainerStream s(TAP);
+        TapeDecoder d;
+        d.setWindowLimit(limit);
+        TEST_ASSERT_TRUE(d.open(&s));
+        checkSame(want, listAll(d));
+    }
+}
+
+// A fully scanned tape leaves an index; the next open lists from it and
+// decodes each program from its own stretch of the image
+void test_second_open_uses_index(void)
+{
+    writeTape(6, 2048);
+    std::vector<TapeEntry> want;
+    uint32_t total;
+    {
+        FileContainerStream s(TAP);
+        TapeDecoder first;
+        first.setIndexDir(".");
+        TEST_ASSERT_TRUE(first.open(&s));
+        want = listAll(first);
+        checkPrograms(want, 6, 2048);
+        total = first.totalMs();
+    }
+    FILE* f = fopen(indexFile().c_str(), "r");
+    TEST_ASSERT_NOT_NULL(f);
+    fclose(f);
+
+    CountingStream s(TAP);
+    TapeDecoder again;
+    again.setIndexDir(".");
+    TEST_ASSERT_TRUE(again.open(&s));
+    uint64_t opened = s.bytes_read;
+
+    // The tape's length, its counter and the fourth program: no scan
+    TEST_ASSERT_EQUAL_UINT32(total, again.totalMs());
+    TEST_ASSERT_EQUAL_UINT32(want[3].tape_offset, again.offsetAtTime(want[3].start_time_ms + 1));
+    TapeEntry e;
+    TEST_ASSERT_TRUE(again.nextProgram(want[3].tape_offset, e));
+    TEST_ASSERT_EQUAL_STRING(want[3].name.c_str(), e.name.c_str());
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(want[3].prg.data(), e.prg.data(), want[3].prg.size());
+    TEST_ASSERT_TRUE(s.bytes_read - opened < s.size() / 4);
+
+    checkSame(want, listAll(again));
+}
+
+// An index that no longer matches the image is dropped, and the tape
+// scanned after all
+void test_stale_index_rescans(void)
+{
+    writeTape(4, 1024);
+    {
+        FileContainerStream s(TAP);
+        TapeDecoder first;
+        first.setIndexDir(".");
+        TEST_ASSERT_TRUE(first.open(&s));
+        checkPrograms(listAll(first), 4, 1024);
+    }
+
+    // Same length, other programs
+    writeTape(4, 1024, 40);
+    FileContainerStream s(TAP);
+    TapeDecoder again;
+    again.setIndexDir(".");
+    TEST_ASSERT_TRUE(again.open(&s));
+    checkPrograms(listAll(again), 4, 1024, 40);
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_lists_every_program);
+    RUN_TEST(test_sliding_window_matches_whole_scan);
+    RUN_TEST(test_window_edges_anywhere);
+    RUN_TEST(test_second_open_uses_index);
+    RUN_TEST(test_stale_index_rescans);
+    return UNITY_END();
+}
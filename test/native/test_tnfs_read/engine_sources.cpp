@@ -0,0 +1,28 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// tnfslib.cpp is built against the real fnUDP (plain BSD sockets off the
+// ESP); fnSystem and the system bus come from the stand-ins in host/.
+// They are included by path ahead of everything else, so their guards are
+// the ones that count when tnfslib.cpp asks for "fnSystem.h" and "bus.h"
+// (the real headers, found last on the search path, then add nothing).
+// strlcpy() is the one from lib/compat, as on the PC builds. Not under
+// mingw, where the suite is skipped (see test_tnfs_read.cpp).
+#ifndef _WIN32
+#include "host/fnSystem.h"
+#include "host/bus.h"
+
+extern "C" {
+#include "../../../lib/compat/strlcpy.c"
+}
+#include "../../../lib/utils/cbuf.cpp"
+#include "../../../lib/tcpip/fnDNS.cpp"
+#include "../../../lib/tcpip/fnUDP.cpp"
+#include "../../../lib/tcpip/fnTcpClient.cpp"
+#include "../../../lib/TNFSlib/tnfslibMountInfo.cpp"
+#include "../../../lib/TNFSlib/tnfslib.cpp"
+
+SystemManager fnSystem;
+systemBus IEC;
+#endif
@@ -0,0 +1,25 @@
+// Host stand-in for lib/hardware/fnSystem.h, which drags in the ESP-IDF
+// drivers. tnfslib.cpp only needs the clock and the delays.
+#ifndef FNSYSTEM_H
+#define FNSYSTEM_H
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+class SystemManager
+{
+public:
+    uint64_t millis()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void delay_microseconds(uint32_t us) { std::this_thread::sleep_for(std::chrono::microseconds(us)); }
+    void delay(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+    void yield() { std::this_thread::yield(); }
+};
+
+extern SystemManager fnSystem;
+
+#endif // FNSYSTEM_H
@@ -0,0 +1,709 @@
+// Tests for the TNFS read path (lib/TNFSlib/tnfslib.cpp): the per-handle
+// cache and the pipelined fill that keeps several READs in flight over UDP.
+//
+// The client talks to a small TNFS server running on a thread of its own on
+// 127.0.0.1, over real sockets. It answers STAT, OPEN, READ, WRITE, LSEEK and
+// CLOSE the way tnfsd does - including resending its last reply when a
+// request comes in again with the same sequence number - and can hold each
+// packet back for a fixed latency or drop it outright, in either direction,
+// or hold a request back long enough for the next one to overtake it.
+//
+// READ has no offset: the server hands out whatever is at its file pointer.
+// A lost request or reply therefore can't just be asked for again, and the
+// tests check the bytes against the file, not only the counts.
+//
+// The server is written to POSIX sockets, and [env:native] links no winsock
+// for fnUDP, so under mingw the suite is a single ignored test.
+
+#include <unity.h>
+
+#ifdef _WIN32
+
+void setUp(void) {}
+void tearDown(void) {}
+
+static void test_needs_posix_sockets(void)
+{
+    TEST_IGNORE_MESSAGE("the test server needs POSIX sockets");
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_needs_posix_sockets);
+    return UNITY_END();
+}
+
+#else
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "tnfslib.h"
+
+void setUp(void) {}
+void tearDown(void) {}
+
+// Deterministic contents, so a byte out of place shows up where it landed.
+static std::vector<uint8_t> make_file(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+    return data;
+}
+
+class TestTnfsServer
+{
+public:
+    // One-way delay applied to every packet, and the chance (in 1/1000) a
+    // packet is dropped instead.
+    uint32_t latency_ms = 0;
+    uint32_t loss_permille = 0;
+    // The chance (in 1/1000) a request is held back a few ms more, so the
+    // server handles whatever the client sent next first.
+    uint32_t reorder_permille = 0;
+
+    std::map<std::string, std::vector<uint8_t>> files;
+    std::atomic<uint32_t> reads{0};
+    std::atomic<uint32_t> dropped{0};
+    std::atomic<uint32_t> reordered{0};
+
+    TestTnfsServer()
+    {
+        _fd = socket(AF_INET, SOCK_DGRAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = 0;
+        bind(_fd, (sockaddr *)&addr, sizeof(addr));
+        socklen_t len = sizeof(addr);
+        getsockname(_fd, (sockaddr *)&addr, &len);
+        port = ntohs(addr.sin_port);
+
+        timeval tv = { 0, 1000 };
+        setsockopt(_fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+
+    ~TestTnfsServer()
+    {
+        stop();
+        close(_fd);
+    }
+
+    void start()
+    {
+        _running = true;
+        _thread = std::thread([this] { run(); });
+    }
+
+    void stop()
+    {
+        _running = false;
+        if (_thread.joinable())
+            _thread.join();
+    }
+
+    uint16_t port = 0;
+
+private:
+    struct Delayed
+    {
+        uint64_t due;
+        bool inbound;
+        sockaddr_in peer;
+        std::vector<uint8_t> data;
+    };
+
+    struct Handle
+    {
+        std::string name;
+        uint32_t pos = 0;
+    };
+
+    int _fd = -1;
+    std::thread _thread;
+    std::atomic<bool> _running{false};
+    std::vector<Delayed> _queue;
+    std::map<uint8_t, Handle> _handles;
+    uint8_t _next_handle = 1;
+    uint32_t _rng = 2024;
+
+    int _last_seq = -1;
+    std::vector<uint8_t> _last_reply;
+
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    bool chance(uint32_t permille)
+    {
+        if (permille == 0)
+            return false;
+        _rng = _rng * 1103515245 + 12345;
+        return ((_rng >> 16) % 1000) < permille;
+    }
+
+    bool lose()
+    {
+        if (!chance(loss_permille))
+            return false;
+        dropped++;
+        return true;
+    }
+
+    uint32_t hold_back()
+    {
+        if (!chance(reorder_permille))
+            return 0;
+        reordered++;
+        return 5;
+    }
+
+    void run()
+    {
+        uint8_t buf[1024];
+        while (_running)
+        {
+            sockaddr_in peer;
+            socklen_t peerlen = sizeof(peer);
+            ssize_t n = recvfrom(_fd, buf, sizeof(buf), 0, (sockaddr *)&peer, &peerlen);
+            if (n >= TNFS_HEADER_SIZE && !lose())
+                _queue.push_back({ now() + latency_ms + hold_back(), true, peer, std::vector<uint8_t>(buf, buf + n) });
+
+            // Everything that's waited long enough, in the order it arrived
+            uint64_t t = now();
+            for (size_t i = 0; i < _queue.size();)
+            {
+                if (_queue[i].due > t)
+                {
+                    i++;
+                    continue;
+                }
+                Delayed d = std::move(_queue[i]);
+                _queue.erase(_queue.begin() + i);
+                if (d.inbound)
+                {
+                    std::vector<uint8_t> reply = handle(d.data);
+                    if (!lose())
+                        _queue.push_back({ now() + latency_ms, false, d.peer, reply });
+                }
+                else
+                    sendto(_fd, d.data.data(), d.data.size(), 0, (sockaddr *)&d.peer, sizeof(d.peer));
+            }
+        }
+    }
+
+    std::vector<uint8_t> handle(const std::vector<uint8_t> &req)
+    {
+        // tnfsd answers a repeated sequence number with the reply it already
+        // gave, without doing the work again
+        if (req[2] == _last_seq)
+            return _last_reply;
+
+        std::vector<uint8_t> reply(req.begin(), req.begin() + TNFS_HEADER_SIZE);
+        const uint8_t *payload = req.data() + TNFS_HEADER_SIZE;
+
+        switch (req[3])
+        {
+        case TNFS_CMD_STAT:
+        {
+            auto f = files.find((const char *)payload);
+            if (f == files.end())
+            {
+                reply.push_back(TNFS_RESULT_FILE_NOT_FOUND);
+                break;
+            }
+            reply.resize(TNFS_HEADER_SIZE + 23, 0);
+            reply[TNFS_HEADER_SIZE + 1] = 0xa4; // 0100644
+            reply[TNFS_HEADER_SIZE + 2] = 0x81;
+            TNFS_UINT32_TO_LOHI_BYTEPTR((uint32_t)f->second.size(), reply.data() + TNFS_HEADER_SIZE + 7);
+            break;
+        }
+        case TNFS_CMD_OPEN:
+        {
+            std::string name((const char *)payload + 4);
+            if (files.find(name) == files.end())
+            {
+                reply.push_back(TNFS_RESULT_FILE_NOT_FOUND);
+                break;
+            }
+            uint8_t h = _next_handle++;
+            _handles[h] = { name, 0 };
+            reply.push_back(TNFS_RESULT_SUCCESS);
+            reply.push_back(h);
+            break;
+        }
+        case TNFS_CMD_READ:
+        {
+            reads++;
+            auto h = _handles.find(payload[0]);
+            if (h == _handles.end())
+            {
+                reply.push_back(TNFS_RESULT_BAD_FILENUM);
+                break;
+            }
+            const std::vector<uint8_t> &data = files[h->second.name];
+            uint16_t len = TNFS_UINT16_FROM_LOHI_BYTEPTR(payload + 1);
+            if (h->second.pos >= data.size())
+            {
+                reply.push_back(TNFS_RESULT_END_OF_FILE);
+                break;
+            }
+            if (len > data.size() - h->second.pos)
+                len = data.size() - h->second.pos;
+            reply.push_back(TNFS_RESULT_SUCCESS);
+            reply.push_back(TNFS_LOBYTE_FROM_UINT16(len));
+            reply.push_back(TNFS_HIBYTE_FROM_UINT16(len));
+            reply.insert(reply.end(), data.begin() + h->second.pos, data.begin() + h->second.pos + len);
+            h->second.pos += len;
+            break;
+        }
+        case TNFS_CMD_WRITE:
+        {
+            auto h = _handles.find(payload[0]);
+            if (h == _handles.end())
+            {
+                reply.push_back(TNFS_RESULT_BAD_FILENUM);
+                break;
+            }
+            std::vector<uint8_t> &data = files[h->second.name];
+            uint16_t len = TNFS_UINT16_FROM_LOHI_BYTEPTR(payload + 1);
+            if (h->second.pos + len > data.size())
+                data.resize(h->second.pos + len);
+            memcpy(data.data() + h->second.pos, payload + 3, len);
+            h->second.pos += len;
+            reply.push_back(TNFS_RESULT_SUCCESS);
+            reply.push_back(TNFS_LOBYTE_FROM_UINT16(len));
+            reply.push_back(TNFS_HIBYTE_FROM_UINT16(len));
+            break;
+        }
+        case TNFS_CMD_LSEEK:
+        {
+            auto h = _handles.find(payload[0]);
+            if (h == _handles.end())
+            {
+                reply.push_back(TNFS_RESULT_BAD_FILENUM);
+                break;
+            }
+            int32_t offset = (int32_t)TNFS_UINT32_FROM_LOHI_BYTEPTR(payload + 2);
+            if (payload[1] == SEEK_SET)
+                h->second.pos = offset;
+            else if (payload[1] == SEEK_CUR)
+                h->second.pos += offset;
+            else
+                h->second.pos = files[h->second.name].size() + offset;
+            reply.resize(TNFS_HEADER_SIZE + 5);
+            reply[TNFS_HEADER_SIZE] = TNFS_RESULT_SUCCESS;
+            TNFS_UINT32_TO_LOHI_BYTEPTR(h->second.pos, reply.data() + TNFS_HEADER_SIZE + 1);
+            break;
+        }
+        case TNFS_CMD_CLOSE:
+            reply.push_back(_handles.erase(payload[0]) ? TNFS_RESULT_SUCCESS : TNFS_RESULT_BAD_FILENUM);
+            break;
+        default:
+            reply.push_back(TNFS_RESULT_FUNCTION_UNIMPLEMENTED);
+            break;
+        }
+
+        _last_seq = req[2];
+        _last_reply = reply;
+        return reply;
+    }
+};
+
+static void mount(tnfsMountInfo &info, const TestTnfsServer &server, uint8_t window)
+{
+    info.protocol = TNFS_PROTOCOL_UDP;
+    info.host_ip = inet_addr("127.0.0.1");
+    info.port = server.port;
+    info.session = 0x1234;
+    info.min_retry_ms = 5;
+    info.timeout_ms = 200;
+    info.read_window = window;
+    strcpy(info.current_working_directory, "/");
+}
+
+// Reads the whole of an open file in the block sizes the IEC side asks for
+static std::vector<uint8_t> read_all(tnfsMountInfo &info, int16_t handle, uint16_t block)
+{
+    std::vector<uint8_t> out;
+    uint8_t buf[TNFS_MAX_READWRITE_PAYLOAD];
+    while (true)
+    {
+        uint16_t got = 0;
+        int result = tnfs_read(&info, handle, buf, block, &got);
+        out.insert(out.end(), buf, buf + got);
+        if (result != 0)
+        {
+            TEST_ASSERT_EQUAL_INT_MESSAGE(TNFS_RESULT_END_OF_FILE, result, "read stopped on an error");
+            break;
+        }
+    }
+    return out;
+}
+
+static void assert_same_bytes(const std::vector<uint8_t> &expected, const std::vector<uint8_t> &actual, const char *message)
+{
+    TEST_ASSERT_EQUAL_size_t_MESSAGE(expected.size(), actual.size(), message);
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        if (expected[i] != actual[i])
+        {
+            char detail[128];
+            snprintf(detail, sizeof(detail), "%s: byte %u", message, (unsigned)i);
+            TEST_ASSERT_EQUAL_HEX8_MESSAGE(expected[i], actual[i], detail);
+        }
+    }
+}
+
+// A window of 1 is the old one-READ-at-a-time fill, and has to stay byte-exact
+void test_stop_and_wait_reads_file(void)
+{
+    TestTnfsServer server;
+    server.files["/data.bin"] = make_file(40000, 1);
+    server.start();
+
+    tnfsMountInfo info;
+    mount(info, server, 1);
+
+    int16_t handle;
+    TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/data.bin", TNFS_OPENMODE_READ, 0, &handle));
+    assert_same_bytes(server.files["/data.bin"], read_all(info, handle, 254), "window 1");
+    TEST_ASSERT_EQUAL_INT(0, tnfs_close(&info, handle));
+    TEST_ASSERT_EQUAL_UINT32(0, info.read_resyncs);
+}
+
+void test_pipelined_reads_file(void)
+{
+    TestTnfsServer server;
+    server.files["/data.bin"] = make_file(300000, 2);
+    server.start();
+
+    const uint8_t windows[] = { 2, 4, 8, TNFS_MAX_READ_WINDOW };
+    for (uint8_t window : windows)
+    {
+        tnfsMountInfo info;
+        mount(info, server, window);
+
+        int16_t handle;
+        TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/data.bin", TNFS_OPENMODE_READ, 0, &handle));
+        assert_same_bytes(server.files["/data.bin"], read_all(info, handle, 512), "pipelined");
+        TEST_ASSERT_EQUAL_INT(0, tnfs_close(&info, handle));
+        TEST_ASSERT_EQUAL_UINT32(0, info.read_resyncs);
+    }
+}
+
+// A file that ends part way through a READ and part way through a fill, and
+// one that's an exact number of fills long
+void test_pipelined_read_to_eof(void)
+{
+    TestTnfsServer server;
+    server.files["/odd.prg"] = make_file(TNFS_FILE_CACHE_SIZE * 3 + 700, 3);
+    server.files["/even.prg"] = make_file(TNFS_FILE_CACHE_SIZE * 4, 4);
+    server.files["/empty.prg"] = std::vector<uint8_t>();
+    server.start();
+
+    tnfsMountInfo info;
+    mount(info, server, 4);
+
+    const char *names[] = { "/odd.prg", "/even.prg", "/empty.prg" };
+    for (const char *name : names)
+    {
+        int16_t handle;
+        TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, name, TNFS_OPENMODE_READ, 0, &handle));
+        assert_same_bytes(server.files[name], read_all(info, handle, 500), name);
+
+        // And it stays at the end
+        uint8_t buf[16];
+        uint16_t got = 0;
+        TEST_ASSERT_EQUAL_INT(TNFS_RESULT_END_OF_FILE, tnfs_read(&info, handle, buf, sizeof(buf), &got));
+        TEST_ASSERT_EQUAL_UINT16(0, got);
+        TEST_ASSERT_EQUAL_INT(0, tnfs_close(&info, handle));
+    }
+}
+
+// Requests and replies go missing; each gap costs a resync, never a byte
+void test_pipelined_read_survives_loss(void)
+{
+    TestTnfsServer server;
+    server.files["/lossy.d64"] = make_file(174848, 5);
+    server.loss_permille = 30;
+    server.start();
+
+    tnfsMountInfo info;
+    mount(info, server, 8);
+    info.timeout_ms = 50;
+    info.max_retries = 20;
+
+    int16_t handle;
+    TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/lossy.d64", TNFS_OPENMODE_READ, 0, &handle));
+    assert_same_bytes(server.files["/lossy.d64"], read_all(info, handle, 256), "with loss");
+    tnfs_close(&info, handle);
+
+    printf("loss: %u packets dropped, %u resyncs\n", (unsigned)server.dropped, (unsigned)info.read_resyncs);
+    TEST_ASSERT_TRUE(server.dropped > 0);
+    TEST_ASSERT_TRUE(info.read_resyncs > 0);
+}
+
+// A request overtaken by the next one is answered with the bytes meant for
+// that one. The reply that comes back first then answers the wrong READ; the
+// fill has to notice, back up, and read the rest of the file one READ at a
+// time.
+void test_reordered_reads_fall_back_to_single_reads(void)
+{
+    TestTnfsServer server;
+    server.files["/reorder.prg"] = make_file(65536, 7);
+    server.reorder_permille = 50;
+    server.start();
+
+    tnfsMountInfo info;
+    mount(info, server, 8);
+    info.max_retries = 20;
+
+    int16_t handle;
+    TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/reorder.prg", TNFS_OPENMODE_READ, 0, &handle));
+    assert_same_bytes(server.files["/reorder.prg"], read_all(info, handle, 256), "with reordering");
+    TEST_ASSERT_TRUE(info.get_filehandleinfo(handle)->pipeline_fallback);
+    tnfs_close(&info, handle);
+
+    printf("reorder: %u requests held back, %u resyncs\n", (unsigned)server.reordered, (unsigned)info.read_resyncs);
+    TEST_ASSERT_TRUE(server.reordered > 0);
+    TEST_ASSERT_TRUE(info.read_resyncs > 0);
+
+    // A handle opened afterwards gets the window again
+    TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/reorder.prg", TNFS_OPENMODE_READ, 0, &handle));
+    TEST_ASSERT_FALSE(info.get_filehandleinfo(handle)->pipeline_fallback);
+    tnfs_close(&info, handle);
+}
+
+// Reading straight through sends the next fill's READs ahead. Seeking away,
+// writing or closing must not leave the server's pointer where they put it.
+void test_prefetch_dropped_on_seek_and_write(void)
+{
+    TestTnfsServer server;
+    server.files["/seek.bin"] = make_file(100000, 6);
+    server.start();
+    const std::vector<uint8_t> original = server.files["/seek.bin"];
+
+    tnfsMountInfo info;
+    mount(info, server, 4);
+
+    int16_t handle;
+    TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/seek.bin", TNFS_OPENMODE_READWRITE, 0, &handle));
+    tnfsFileHandleInfo *pFHI = info.get_filehandleinfo(handle);
+
+    uint8_t buf[512];
+    uint16_t got;
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_EQUAL_INT(0, tnfs_read(&info, handle, buf, sizeof(buf), &got));
+    TEST_ASSERT_TRUE(pFHI->prefetch_count > 0);
+
+    // Out of the cache: absolute seek
+    uint32_t pos = 0;
+    TEST_ASSERT_EQUAL_INT(0, tnfs_lseek(&info, handle, 70001, SEEK_SET, &pos, false));
+    TEST_ASSERT_EQUAL_UINT32(70001, pos);
+    TEST_ASSERT_EQUAL_UINT8(0, pFHI->prefetch_count);
+    TEST_ASSERT_EQUAL_INT(0, tnfs_read(&info, handle, buf, 300, &got));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(original.data() + 70001, buf, 300);
+
+    // Back to the start and through again, then from the end
+    TEST_ASSERT_EQUAL_INT(0, tnfs_lseek(&info, handle, 0, SEEK_SET, &pos, false));
+    for (int i = 0; i < 16; i++)
+    {
+        TEST_ASSERT_EQUAL_INT(0, tnfs_read(&info, handle, buf, sizeof(buf), &got));
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(original.data() + i * sizeof(buf), buf, sizeof(buf));
+    }
+    TEST_ASSERT_EQUAL_INT(0, tnfs_lseek(&info, handle, -1000, SEEK_END, &pos, false));
+    TEST_ASSERT_EQUAL_INT(0, tnfs_read(&info, handle, buf, 200, &got));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(original.data() + 99000, buf, 200);
+
+    // Sequential again, then a write where the reader is
+    TEST_ASSERT_EQUAL_INT(0, tnfs_lseek(&info, handle, 0, SEEK_SET, &pos, false));
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_EQUAL_INT(0, tnfs_read(&info, handle, buf, sizeof(buf), &got));
+    TEST_ASSERT_TRUE(pFHI->prefetch_count > 0);
+
+    const uint8_t patch[] = "MEATLOAF";
+    TEST_ASSERT_EQUAL_INT(0, tnfs_write(&info, handle, (uint8_t *)patch, 8, &got));
+    TEST_ASSERT_EQUAL_UINT16(8, got);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(patch, server.files["/seek.bin"].data() + 16 * sizeof(buf), 8);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(original.data(), server.files["/seek.bin"].data(), 16 * sizeof(buf));
+
+    TEST_ASSERT_EQUAL_INT(0, tnfs_close(&info, handle));
+}
+
+// A mount as it comes, with nothing set, pipelines; reading straight through
+// sends the next fill's READs ahead
+void test_default_mount_pipelines(void)
+{
+    TEST_ASSERT_TRUE(TNFS_READ_WINDOW > 1);
+
+    TestTnfsServer server;
+    server.files["/data.bin"] = make_file(100000, 9);
+    server.start();
+
+    tnfsMountInfo info("127.0.0.1", server.port);
+    TEST_ASSERT_EQUAL_UINT8(TNFS_READ_WINDOW, info.read_window);
+    uint8_t window = info.read_window;
+    mount(info, server, window);
+
+    int16_t handle;
+    TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/data.bin", TNFS_OPENMODE_READ, 0, &handle));
+    tnfsFileHandleInfo *pFHI = info.get_filehandleinfo(handle);
+    uint8_t buf[512];
+    uint16_t got;
+    for (int i = 0; i < 16; i++)
+        TEST_ASSERT_EQUAL_INT(0, tnfs_read(&info, handle, buf, sizeof(buf), &got));
+    TEST_ASSERT_TRUE(pFHI->prefetch_count > 0);
+    TEST_ASSERT_EQUAL_INT(0, tnfs_close(&info, handle));
+}
+
+// ?window= and ?cache= from a tnfs:// URL; anything else, or out of range,
+// leaves the mount as it was
+void test_mount_options(void)
+{
+    tnfsMountInfo info;
+    info.set_options("window=8&cache=8192");
+    TEST_ASSERT_EQUAL_UINT8(8, info.read_window);
+    TEST_ASSERT_EQUAL_UINT32(8192, info.cache_size);
+
+    info.set_options("window=1");
+    TEST_ASSERT_EQUAL_UINT8(1, info.read_window);
+    TEST_ASSERT_EQUAL_UINT32(8192, info.cache_size);
+
+    info.set_options("window=0&cache=100&other=3");
+    TEST_ASSERT_EQUAL_UINT8(1, info.read_window);
+    TEST_ASSERT_EQUAL_UINT32(8192, info.cache_size);
+
+    info.set_options("window=99&cache=1048576&&window");
+    TEST_ASSERT_EQUAL_UINT8(1, info.read_window);
+    TEST_ASSERT_EQUAL_UINT32(8192, info.cache_size);
+
+    info.set_options("name=x&cache=512&window=16");
+    TEST_ASSERT_EQUAL_UINT8(TNFS_MAX_READ_WINDOW, info.read_window);
+    TEST_ASSERT_EQUAL_UINT32(512, info.cache_size);
+
+    info.set_options("");
+    info.set_options(nullptr);
+    TEST_ASSERT_EQUAL_UINT8(TNFS_MAX_READ_WINDOW, info.read_window);
+}
+
+// A smaller or larger cache per mount
+void test_cache_size_per_mount(void)
+{
+    TestTnfsServer server;
+    server.files["/data.bin"] = make_file(50000, 7);
+    server.start();
+
+    const uint32_t sizes[] = { 512, 1000, 8192 };
+    for (uint32_t size : sizes)
+    {
+        tnfsMountInfo info;
+        mount(info, server, 4);
+        info.cache_size = size;
+
+        int16_t handle;
+        TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/data.bin", TNFS_OPENMODE_READ, 0, &handle));
+        TEST_ASSERT_EQUAL_UINT32(size, info.get_filehandleinfo(handle)->cache_size);
+        assert_same_bytes(server.files["/data.bin"], read_all(info, handle, 333), "cache size");
+        TEST_ASSERT_EQUAL_INT(0, tnfs_close(&info, handle));
+    }
+}
+
+// Benchmark: a 1 MB file at 2 ms each way (a LAN with a busy access point).
+// Stop-and-wait is timed over the first 128 KB only - it's that slow - and
+// every run is compared byte for byte. The first figure is the old 512 byte
+// cache filled one READ at a time.
+static double timed_read(TestTnfsServer &server, uint8_t window, uint32_t cache_size, uint32_t limit)
+{
+    tnfsMountInfo info;
+    mount(info, server, window);
+    info.cache_size = cache_size;
+
+    int16_t handle;
+    TEST_ASSERT_EQUAL_INT(0, tnfs_open(&info, "/bench.bin", TNFS_OPENMODE_READ, 0, &handle));
+
+    const std::vector<uint8_t> &expected = server.files["/bench.bin"];
+    std::vector<uint8_t> buf(512);
+    uint32_t total = 0;
+    auto started = std::chrono::steady_clock::now();
+    while (total < limit)
+    {
+        uint16_t got = 0;
+        int result = tnfs_read(&info, handle, buf.data(), buf.size(), &got);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected.data() + total, buf.data(), got);
+        total += got;
+        if (result != 0)
+            break;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    TEST_ASSERT_EQUAL_UINT32(limit, total);
+    tnfs_close(&info, handle);
+
+    return total / 1024.0 / seconds;
+}
+
+void test_benchmark_read(void)
+{
+    TestTnfsServer server;
+    server.files["/bench.bin"] = make_file(1024 * 1024, 8);
+    server.latency_ms = 2;
+    server.start();
+
+    printf("tnfs read, 2 ms latency: baseline %.0f KB/s", timed_read(server, 1, 512, 128 * 1024));
+
+    // A fill never has more READs in flight than fit in the cache, so the
+    // wider windows get the cache to go with them
+    const struct { uint8_t window; uint32_t cache_size; } runs[] = {
+        { 1, TNFS_FILE_CACHE_SIZE }, { 4, TNFS_FILE_CACHE_SIZE }, { 8, 4096 }, { 16, 8192 },
+    };
+    for (auto &run : runs)
+    {
+        uint32_t limit = run.window == 1 ? 128 * 1024 : 1024 * 1024;
+        printf(", window %u/%u KB cache %.0f KB/s", run.window, (unsigned)(run.cache_size / 1024),
+               timed_read(server, run.window, run.cache_size, limit));
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    (void)argc; (void)argv;
+
+    UNITY_BEGIN();
+
+    RUN_TEST(test_stop_and_wait_reads_file);
+    RUN_TEST(test_pipelined_reads_file);
+    RUN_TEST(test_pipelined_read_to_eof);
+    RUN_TEST(test_pipelined_read_survives_loss);
+    RUN_TEST(test_reordered_reads_fall_back_to_single_reads);
+    RUN_TEST(test_prefetch_dropped_on_seek_and_write);
+    RUN_TEST(test_default_mount_pipelines);
+    RUN_TEST(test_mount_options);
+    RUN_TEST(test_cache_size_per_mount);
+    RUN_TEST(test_benchmark_read);
+
+    return UNITY_END();
+}
+
+#endif // _WIN32
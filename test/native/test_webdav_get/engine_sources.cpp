@@ -0,0 +1,60 @@
+// Unity build of the translation units this suite needs; see
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd here instead of being discovered by PlatformIO.
+//
+// The WebDAV server as the firmware builds it, over this suite's
+// esp_http_server stand-in (host/), and the D64 engine its files come from.
+#include "host/esp_http_server.h"
+
+#include "../../../lib/utils/punycode.cpp"
+// punycode.cpp leaks a bare min(a,b) macro into the rest of this unit.
+#undef min
+#include "../../../lib/utils/U8Char.cpp"
+#include "../../../lib/utils/string_utils.cpp"
+#include "../../../lib/meatloaf/meat_media.cpp"
+#include "../../../lib/meatloaf/meat_lease.cpp"
+#include "../../../lib/meatloaf/media/disk/d64.cpp"
+#include "../../../lib/www/webdav/range.cpp"
+#include "../../../lib/www/webdav/body_capture.cpp"
+#include "../../../lib/www/webdav/request.cpp"
+#include "../../../lib/www/webdav/response.cpp"
+
+// device/flash.h is empty under TEST_NATIVE. The server opens local paths
+// as FlashMFile; here that is whatever MFSOwner::File() gives for the path.
+class FlashMFile : public MFile
+{
+public:
+    FlashMFile(std::string path) : m_file(MFSOwner::File(path)) { url = path; }
+
+    std::shared_ptr<MStream> getDecodedStream(std::shared_ptr<MStream>) override { return nullptr; }
+    std::shared_ptr<MStream> getSourceStream(std::ios_base::openmode mode) override { return m_file->getSourceStream(mode); }
+    bool exists() override { return m_file->exists(); }
+    bool isDirectory() override { return m_file->isDirectory(); }
+    time_t getLastWrite() override { return m_file->getLastWrite(); }
+
+private:
+    std::unique_ptr<MFile> m_file;
+};
+
+#include "../../../lib/www/webdav/webdav_server.cpp"
+
+// string_utils.cpp leaves sha1() to mbedtls, which the native build lacks.
+// The ETags only have to tell one file version from another here.
+std::string mstr::sha1(const std::string &s)
+{
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)std::hash<std::string>()(s));
+    return hex;
+}
+
+// No socket behind the stand-in's requests
+extern "C" int httpd_default_recv(httpd_handle_t, int, char *, size_t, int)
+{
+    return HTTPD_SOCK_ERR_FAIL;
+}
+
+// The suite hands the server its own files; see test_webdav_get.cpp
+#define NATIVE_STUBS_REAL_MFSOWNER
+void MFSOwner::suspendResolveCache() {}
+void MFSOwner::resumeResolveCache() {}
+#include "../test_disk_write/native_stubs.cpp"
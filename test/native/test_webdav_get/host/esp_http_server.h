@@ -0,0 +1,130 @@
+// Host stand-in for ESP-IDF's esp_http_server.h: just what lib/www/webdav
+// calls, answered from an httpd_exchange the test sets up per request. The
+// request headers come from it, and everything the server sends - status,
+// headers, chunks and raw socket writes - is recorded in it.
+//
+// Found last on the search path (-idirafter), where nothing else on the
+// native build provides this header.
+#ifndef _ESP_HTTP_SERVER_H_
+#define _ESP_HTTP_SERVER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <string>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK      0
+#define ESP_FAIL    -1
+#endif
+
+#define HTTPD_TYPE_JSON     "application/json"
+#define HTTPD_TYPE_TEXT     "text/html"
+#define HTTPD_TYPE_OCTET    "application/octet-stream"
+
+#define HTTPD_SOCK_ERR_FAIL     -1
+#define HTTPD_SOCK_ERR_INVALID  -2
+#define HTTPD_SOCK_ERR_TIMEOUT  -3
+
+#define HTTPD_MAX_URI_LEN   512
+
+typedef void *httpd_handle_t;
+typedef void (*httpd_free_ctx_fn_t)(void *ctx);
+typedef int (*httpd_recv_func_t)(httpd_handle_t hd, int sockfd, char *buf, size_t buf_len, int flags);
+
+struct httpd_exchange
+{
+    std::map<std::string, std::string> request_headers;
+
+    std::string status;
+    std::string type;
+    std::map<std::string, std::string> headers;
+    std::string chunked;        // body sent with httpd_resp_send_chunk()
+    bool chunks_closed = false;
+    std::string raw;            // status line, headers and body written by httpd_send()
+};
+
+typedef struct httpd_req
+{
+    httpd_handle_t handle;
+    int method;
+    char uri[HTTPD_MAX_URI_LEN + 1];
+    size_t content_len;
+    void *aux;                  // the httpd_exchange
+} httpd_req_t;
+
+static inline httpd_exchange &httpd_exchange_of(httpd_req_t *r)
+{
+    return *(httpd_exchange *)r->aux;
+}
+
+static inline size_t httpd_req_get_hdr_value_len(httpd_req_t *r, const char *field)
+{
+    auto &h = httpd_exchange_of(r).request_headers;
+    auto it = h.find(field);
+    return it == h.end() ? 0 : it->second.size();
+}
+
+static inline esp_err_t httpd_req_get_hdr_value_str(httpd_req_t *r, const char *field, char *val, size_t val_size)
+{
+    auto &h = httpd_exchange_of(r).request_headers;
+    auto it = h.find(field);
+    if (it == h.end() || val_size == 0)
+        return ESP_FAIL;
+    size_t n = std::min(it->second.size(), val_size - 1);
+    memcpy(val, it->second.data(), n);
+    val[n] = '\0';
+    return ESP_OK;
+}
+
+static inline int httpd_req_recv(httpd_req_t *, char *, size_t) { return 0; }
+static inline int httpd_req_to_sockfd(httpd_req_t *) { return 0; }
+
+static inline esp_err_t httpd_resp_set_status(httpd_req_t *r, const char *status)
+{
+    httpd_exchange_of(r).status = status;
+    return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_set_type(httpd_req_t *r, const char *type)
+{
+    httpd_exchange_of(r).type = type;
+    return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_set_hdr(httpd_req_t *r, const char *field, const char *value)
+{
+    httpd_exchange_of(r).headers[field] = value;
+    return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_send_chunk(httpd_req_t *r, const char *buf, ssize_t len)
+{
+    if (buf == nullptr)
+        httpd_exchange_of(r).chunks_closed = true;
+    else
+        httpd_exchange_of(r).chunked.append(buf, len < 0 ? strlen(buf) : (size_t)len);
+    return ESP_OK;
+}
+
+static inline esp_err_t httpd_resp_send(httpd_req_t *r, const char *buf, ssize_t len)
+{
+    httpd_exchange_of(r).raw.append(buf, len < 0 ? strlen(buf) : (size_t)len);
+    return ESP_OK;
+}
+
+static inline int httpd_send(httpd_req_t *r, const char *buf, size_t len)
+{
+    httpd_exchange_of(r).raw.append(buf, len);
+    return (int)len;
+}
+
+// The session hooks body_capture.cpp installs; no session to hang them on here
+static inline void *httpd_sess_get_transport_ctx(httpd_handle_t, int) { return nullptr; }
+static inline void httpd_sess_set_transport_ctx(httpd_handle_t, int, void *, httpd_free_ctx_fn_t) {}
+static inline esp_err_t httpd_sess_set_recv_override(httpd_handle_t, int, httpd_recv_func_t) { return ESP_OK; }
+extern "C" int httpd_default_recv(httpd_handle_t hd, int sockfd, char *buf, size_t buf_len, int flags);
+
+#endif // _ESP_HTTP_SERVER_H_
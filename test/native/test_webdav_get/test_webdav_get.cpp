@@ -0,0 +1,233 @@
+// Tests for WebDAV GET and HEAD (lib/www/webdav/webdav_server.cpp) on what
+// they send, rather than the Range parsing test_webdav_range covers.
+//
+// Requests go through the server's own doGet()/doHead() over the
+// esp_http_server stand-in in host/, which records the response. The files
+// are real: one in the working directory, and one inside a D64 there, whose
+// stream only learns the file's exact size when it reads the last block.
+
+#include <unity.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "host/esp_http_server.h"
+#include "../../../lib/www/webdav/webdav_server.h"
+#include "media/disk/d64.h"
+#include "../test_disk_write/file_container_stream.h"
+
+using namespace WebDav;
+
+static const char* D64_PATH = "build_test_webdav_get.d64";
+static const char* PLAIN_PATH = "build_test_webdav_get.bin";
+
+static std::vector<uint8_t> pattern(size_t size, uint32_t seed)
+{
+    std::vector<uint8_t> data(size);
+    uint32_t x = seed * 2654435761u + 1;
+    for (auto& b : data)
+    {
+        x = x * 1103515245u + 12345u;
+        b = (uint8_t)(x >> 16);
+    }
+    return data;
+}
+
+// 600 bytes: two full blocks and 92 bytes of a third
+static const std::vector<uint8_t> PARTIAL = pattern(600, 1);
+static const std::vector<uint8_t> PLAIN = pattern(5000, 2);
+
+/********************************************************
+ * Files
+ ********************************************************/
+
+// "/image.d64/partial" is the file in the D64, anything else the plain file
+class TestFile : public MFile
+{
+public:
+    TestFile(const std::string& path)
+    {
+        url = path;
+        scheme = "test";
+        name = path.substr(path.rfind('/') + 1);
+    }
+
+    std::shared_ptr<MStream> getDecodedStream(std::shared_ptr<MStream>) override { return nullptr; }
+
+    std::shared_ptr<MStream> getSourceStream(std::ios_base::openmode) override
+    {
+        if (name == "partial")
+        {
+            auto image = std::make_shared<D64MStream>(std::make_shared<FileContainerStream>(D64_PATH));
+            image->mode = std::ios_base::in;
+            return image->seekPath("partial") ? image : nullptr;
+        }
+        auto stream = std::make_shared<FileContainerStream>(PLAIN_PATH);
+        return stream->isOpen() ? stream : nullptr;
+    }
+
+    bool exists() override { return true; }
+    bool isDirectory() override { return false; }
+    time_t getLastWrite() override { return 1700000000; }
+};
+
+MFile* MFSOwner::File(std::string path, bool default_to_flash)
+{
+    (void)default_to_flash;
+    return new TestFile(path);
+}
+
+/********************************************************
+ * Requests
+ ********************************************************/
+
+struct Exchange
+{
+    httpd_exchange x;
+    int ret = 0;
+
+    // The body, however it was sent: chunked, or after the headers written
+    // to the socket with a Content-Length
+    std::string body() const
+    {
+        if (!x.chunked.empty() || x.chunks_closed)
+            return x.chunked;
+        size_t end = x.raw.find("\r\n\r\n");
+        return end == std::string::npos ? "" : x.raw.substr(end + 4);
+    }
+
+    // A header, from whichever of the two it went out with
+    std::string header(const std::string& name) const
+    {
+        auto it = x.headers.find(name);
+        if (it != x.headers.end())
+            return it->second;
+        size_t end = x.raw.find("\r\n\r\n");
+        std::string head = "\r\n" + x.raw.substr(0, end) + "\r\n";
+        size_t at = head.find("\r\n" + name + ": ");
+        if (at == std::string::npos)
+            return "";
+        at += name.size() + 4;
+        return head.substr(at, head.find("\r\n", at) - at);
+    }
+};
+
+static Exchange request(bool head, const std::string& uri, const std::string& range = "")
+{
+    Exchange e;
+    if (!range.empty())
+        e.x.request_headers["Range"] = range;
+
+    httpd_req_t req = {};
+    snprintf(req.uri, sizeof(req.uri), "%s", uri.c_str());
+    req.aux = &e.x;
+
+    Server server("/dav", "/");
+    Request request(&req);
+    Response response(&req);
+    if (!head)
+    {
+        e.ret = server.doGet(request, response);
+        return e;
+    }
+
+    // doHead() only sets headers; the handler sends them
+    e.ret = server.doHead(request, response);
+    response.setStatus(e.ret);
+    response.flushHeaders();
+    return e;
+}
+
+static std::string text(const std::vector<uint8_t>& data, size_t first = 0, size_t length = std::string::npos)
+{
+    std::string s((const char*)data.data(), data.size());
+    return s.substr(first, length);
+}
+
+void setUp(void)
+{
+    remove(D64_PATH);
+    {
+        D64MStream image(std::make_shared<FileContainerStream>(D64_PATH, 174848));
+        TEST_ASSERT_TRUE(image.formatImage("davtest", "01"));
+    }
+    {
+        D64MStream image(std::make_shared<FileContainerStream>(D64_PATH));
+        image.mode = std::ios_base::out;
+        TEST_ASSERT_TRUE(image.seekPath("partial"));
+        TEST_ASSERT_EQUAL_UINT32(PARTIAL.size(), image.write(PARTIAL.data(), (uint32_t)PARTIAL.size()));
+        image.close();
+        TEST_ASSERT_EQUAL(0, image.error());
+    }
+
+    FILE* f = fopen(PLAIN_PATH, "wb");
+    TEST_ASSERT_NOT_NULL(f);
+    fwrite(PLAIN.data(), 1, PLAIN.size(), f);
+    fclose(f);
+}
+
+void tearDown(void)
+{
+    remove(D64_PATH);
+    remove(PLAIN_PATH);
+}
+
+/********************************************************
+ * Tests
+ ********************************************************/
+
+// The whole file, though its stream said 762 bytes when the GET began
+void test_get_d64_entry_sends_every_byte(void)
+{
+    Exchange e = request(false, "/dav/image.d64/partial");
+    TEST_ASSERT_EQUAL(200, e.ret);
+    TEST_ASSERT_TRUE(e.x.chunks_closed);
+    TEST_ASSERT_EQUAL(PARTIAL.size(), e.body().size());
+    TEST_ASSERT_TRUE(e.body() == text(PARTIAL));
+    TEST_ASSERT_EQUAL_STRING("", e.header("Content-Length").c_str());
+    TEST_ASSERT_EQUAL_STRING("", e.header("Accept-Ranges").c_str());
+}
+
+// A suffix range can't be placed without the real end: the whole file
+void test_get_d64_entry_ignores_range(void)
+{
+    Exchange e = request(false, "/dav/image.d64/partial", "bytes=-100");
+    TEST_ASSERT_EQUAL(200, e.ret);
+    TEST_ASSERT_TRUE(e.body() == text(PARTIAL));
+    TEST_ASSERT_EQUAL_STRING("", e.header("Content-Range").c_str());
+
+    Exchange h = request(true, "/dav/image.d64/partial");
+    TEST_ASSERT_EQUAL(200, h.ret);
+    TEST_ASSERT_EQUAL_STRING("", h.header("Accept-Ranges").c_str());
+}
+
+// A file that knows its size still gets a Content-Length and its ranges
+void test_get_plain_file_with_length_and_ranges(void)
+{
+    Exchange e = request(false, "/dav/plain.bin");
+    TEST_ASSERT_EQUAL(200, e.ret);
+    TEST_ASSERT_EQUAL_STRING("5000", e.header("Content-Length").c_str());
+    TEST_ASSERT_EQUAL_STRING("bytes", e.header("Accept-Ranges").c_str());
+    TEST_ASSERT_TRUE(e.body() == text(PLAIN));
+
+    Exchange r = request(false, "/dav/plain.bin", "bytes=-100");
+    TEST_ASSERT_EQUAL(206, r.ret);
+    TEST_ASSERT_EQUAL_STRING("bytes 4900-4999/5000", r.header("Content-Range").c_str());
+    TEST_ASSERT_TRUE(r.body() == text(PLAIN, 4900));
+
+    Exchange h = request(true, "/dav/plain.bin");
+    TEST_ASSERT_EQUAL(200, h.ret);
+    TEST_ASSERT_EQUAL_STRING("bytes", h.header("Accept-Ranges").c_str());
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_get_d64_entry_sends_every_byte);
+    RUN_TEST(test_get_d64_entry_ignores_range);
+    RUN_TEST(test_get_plain_file_with_length_and_ranges);
+    return UNITY_END();
+}
@@ -0,0 +1,4 @@
+// Translation units the WebDAV range tests need. See
+// test/native/test_disk_write/engine_sources.cpp for why the real .cpp files
+// are #include'd rather than discovered by PlatformIO's LDF.
+#include "../../../lib/www/webdav/range.cpp"
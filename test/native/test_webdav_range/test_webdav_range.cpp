@@ -0,0 +1,124 @@
+// Tests for the Range and validator parsing behind WebDAV GET's 206 and 304
+// answers (lib/www/webdav/range.cpp). The sending side is test_webdav_get's.
+
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+#include "../../../lib/www/webdav/range.h"
+
+using namespace WebDav;
+
+static std::vector<ByteRange> ranges;
+
+void setUp(void) { ranges.clear(); }
+void tearDown(void) {}
+
+static void assertRange(size_t i, uint32_t first, uint32_t last)
+{
+    TEST_ASSERT_TRUE(i < ranges.size());
+    TEST_ASSERT_EQUAL_UINT32(first, ranges[i].first);
+    TEST_ASSERT_EQUAL_UINT32(last, ranges[i].last);
+}
+
+void test_single_ranges(void)
+{
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=0-499", 174848, ranges));
+    TEST_ASSERT_EQUAL(1, ranges.size());
+    assertRange(0, 0, 499);
+    TEST_ASSERT_EQUAL_UINT32(500, ranges[0].length());
+
+    // Open-ended and suffix forms, both clamped to the file
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=174000-", 174848, ranges));
+    assertRange(0, 174000, 174847);
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=-256", 174848, ranges));
+    assertRange(0, 174592, 174847);
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=-999999", 1000, ranges));
+    assertRange(0, 0, 999);
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=900-5000", 1000, ranges));
+    assertRange(0, 900, 999);
+}
+
+void test_multiple_ranges_keep_request_order(void)
+{
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=512-767, 0-255,-10", 1000, ranges));
+    TEST_ASSERT_EQUAL(3, ranges.size());
+    assertRange(0, 512, 767);
+    assertRange(1, 0, 255);
+    assertRange(2, 990, 999);
+}
+
+void test_ranges_past_the_end(void)
+{
+    // One inside the file is enough to answer; the rest are dropped
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=5000-6000,0-0", 1000, ranges));
+    TEST_ASSERT_EQUAL(1, ranges.size());
+    assertRange(0, 0, 0);
+
+    TEST_ASSERT_EQUAL(RANGE_UNSATISFIABLE, parseRange("bytes=1000-", 1000, ranges));
+    TEST_ASSERT_EQUAL(RANGE_UNSATISFIABLE, parseRange("bytes=-0", 1000, ranges));
+
+    // 2^64 + 100 must not wrap round to byte 100
+    TEST_ASSERT_EQUAL(RANGE_UNSATISFIABLE, parseRange("bytes=18446744073709551716-", 1000, ranges));
+    TEST_ASSERT_EQUAL(RANGE_UNSATISFIABLE, parseRange("bytes=99999999999999999999999-", 1000, ranges));
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=0-18446744073709551716", 1000, ranges));
+    assertRange(0, 0, 999);
+    TEST_ASSERT_EQUAL(RANGE_OK, parseRange("bytes=-18446744073709551716", 1000, ranges));
+    assertRange(0, 0, 999);
+}
+
+void test_unusable_headers_mean_whole_file(void)
+{
+    const char* bad[] = {
+        "", "bytes", "bytes=", "items=0-1", "bytes=a-b", "bytes=5-1",
+        "bytes=-", "bytes=0-1;2-3", "bytes=0-1,", "bytes=0-1 x",
+    };
+    for (auto h : bad) {
+        TEST_ASSERT_EQUAL_MESSAGE(RANGE_NONE, parseRange(h, 1000, ranges), h);
+    }
+
+    std::string many = "bytes=0-0";
+    for (int i = 1; i <= WEBDAV_MAX_RANGES; i++)
+        many += "," + std::to_string(i * 2) + "-" + std::to_string(i * 2);
+    TEST_ASSERT_EQUAL(RANGE_NONE, parseRange(many, 1000, ranges));
+}
+
+void test_etag_matching(void)
+{
+    const std::string etag = "\"3f786850e387550fdab836ed7e6dc881de23001b\"";
+    TEST_ASSERT_TRUE(etagMatches(etag, etag));
+    TEST_ASSERT_TRUE(etagMatches("W/" + etag, etag));
+    TEST_ASSERT_TRUE(etagMatches("\"abc\", " + etag, etag));
+    TEST_ASSERT_TRUE(etagMatches("*", etag));
+    // Unquoted, as this server sent them before they were quoted
+    TEST_ASSERT_TRUE(etagMatches("3f786850e387550fdab836ed7e6dc881de23001b", etag));
+    TEST_ASSERT_FALSE(etagMatches("\"abc\"", etag));
+    TEST_ASSERT_FALSE(etagMatches("", etag));
+}
+
+void test_http_dates(void)
+{
+    time_t t;
+    TEST_ASSERT_TRUE(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", t));
+    TEST_ASSERT_EQUAL_INT64(784111777, (int64_t)t);
+    TEST_ASSERT_TRUE(parseHttpDate("Tue, 29 Feb 2028 00:00:00 GMT", t));
+    TEST_ASSERT_EQUAL_INT64(1835395200, (int64_t)t);
+
+    TEST_ASSERT_FALSE(parseHttpDate("Sunday, 06-Nov-94 08:49:37 GMT", t));
+    TEST_ASSERT_FALSE(parseHttpDate("Sun, 06 Foo 1994 08:49:37 GMT", t));
+    TEST_ASSERT_FALSE(parseHttpDate("Sun, 06 Nov 1994 08:49:37 PST", t));
+    TEST_ASSERT_FALSE(parseHttpDate("", t));
+}
+
+int main(int, char**)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_single_ranges);
+    RUN_TEST(test_multiple_ranges_keep_request_order);
+    RUN_TEST(test_ranges_past_the_end);
+    RUN_TEST(test_unusable_headers_mean_whole_file);
+    RUN_TEST(test_etag_matching);
+    RUN_TEST(test_http_dates);
+    return UNITY_END();
+}